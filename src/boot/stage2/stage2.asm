@@ -17,9 +17,9 @@
 ; 0x0500      - E820 memory map (safe low memory, up to 2KB)
 ; 0x7C00      - Stage1 (512 bytes)
 ; 0x8000      - Stage2 (4096 bytes) - THIS CODE
-; 0x9000      - Boot info for kernel (256 bytes)
-; 0x10000     - Kernel (262144 bytes = 512 sectors = 256KB)
-; 0x50000     - End of kernel
+; 0x9000      - Boot info for kernel (256 bytes, +24: TSC stamps фаз stage2)
+; 0x10000     - Kernel (524288 bytes = 1024 sectors = 512KB, LBA load)
+; 0x90000     - End of kernel image (below EBDA)
 ; 0x33000     - BSS section (3.9MB uninitialized data)
 ; 0x3F0000    - End of BSS (~4MB mark)
 ; 0x820000    - Page tables (16KB: PML4, PDPT, PD, PT) - AFTER BSS!
@@ -28,9 +28,14 @@
 ; === CONSTANTS ===
 KERNEL_LOAD_ADDR      equ 0x10000
 KERNEL_SECTOR_START   equ 10
-KERNEL_SECTOR_COUNT   equ 290
-KERNEL_SIZE_BYTES     equ 148480        ; 290 * 512
-KERNEL_END_ADDR       equ 0x34400       ; 0x10000 + 0x24400 (148480 bytes)
+; Секторов образа kernel: Makefile передаёт -DKERNEL_LOAD_SECTORS по размеру
+; kernel.bin (BSS обнуляет kernel_main), без него - всё окно 0x10000-0x90000
+%ifndef KERNEL_LOAD_SECTORS
+%define KERNEL_LOAD_SECTORS 1024
+%endif
+KERNEL_END_ADDR       equ KERNEL_LOAD_ADDR + KERNEL_LOAD_SECTORS * 512
+KERNEL_LBA_CHUNK      equ 127           ; Максимум секторов за AH=42h (EDD/Phoenix)
+KERNEL_LBA_CHUNK_PARAS equ 127 * 512 / 16 ; Шаг segment: 63.5KB, не пересекает 64KB
 
 PAGE_TABLE_BASE       equ 0x820000      ; CRITICAL: AFTER BSS (BSS ends at 0x810198)
 E820_MAP_ADDR         equ 0x500         ; Low memory (safe after BIOS data area)
@@ -40,6 +45,18 @@ STACK_BASE            equ 0x900000      ; CRITICAL: Stack AFTER BSS section (BSS
 BOOT_INFO_ADDR        equ 0x9000        ; After Stage2
 
 BOOT_DISK             equ 0x80
+
+; Boot profile: rdtsc в конце каждой фазы stage2 (kernel: boot_profile.h)
+BOOT_INFO_TSC_MAGIC   equ 0x30435354    ; 'TSC0' в BOOT_INFO_ADDR+16
+BOOT_INFO_TSC         equ BOOT_INFO_ADDR + 24
+BOOT_TSC_STAMPS       equ 6             ; entry, a20, e820, kernel_load, cpu_check, long_mode
+
+; DS = 0 в real mode, в long mode адрес абсолютный
+%macro BOOT_STAMP 1
+    rdtsc
+    mov [BOOT_INFO_TSC + %1 * 8], eax
+    mov [BOOT_INFO_TSC + %1 * 8 + 4], edx
+%endmacro
 STAGE2_SIGNATURE      equ 0x2907
 
 ; Signature for Stage1 verification
@@ -66,21 +83,27 @@ start_stage2:
     ; Re-enable interrupts for BIOS calls
     sti
 
+    BOOT_STAMP 0
+
     ; Print startup message
     mov si, msg_stage2_start
     call print_string_16
 
     ; Enable A20 line
     call enable_a20_enhanced
+    BOOT_STAMP 1
 
     ; Detect memory with E820
     call detect_memory_e820
+    BOOT_STAMP 2
 
     ; Load kernel from disk
     call load_kernel_simple
+    BOOT_STAMP 3
 
     ; Check CPU compatibility (long mode support)
     call check_long_mode_support
+    BOOT_STAMP 4
 
     ; Entering protected mode
     mov si, msg_entering_protected
@@ -174,6 +197,9 @@ long_mode_start:
     mov [BOOT_INFO_ADDR+4], ax                  ; E820 entry count
     mov [BOOT_INFO_ADDR+8], dword KERNEL_LOAD_ADDR ; Kernel load address
     mov [BOOT_INFO_ADDR+12], dword KERNEL_END_ADDR ; Kernel end address
+    BOOT_STAMP 5
+    mov [BOOT_INFO_ADDR+16], dword BOOT_INFO_TSC_MAGIC
+    mov [BOOT_INFO_ADDR+20], dword BOOT_TSC_STAMPS
 
     ; Jump to kernel entry point
     jmp KERNEL_LOAD_ADDR
@@ -421,119 +447,81 @@ load_kernel_simple:
     jc .use_chs          ; Если не поддерживается, используем CHS
 
     ; Используем INT 13h Extensions (LBA)
-    ; Загружаем 384 сектора (192KB) начиная с LBA 10
-    ; По 64 сектора за раз (безопасное значение для BIOS compatibility)
-
-    ; Часть 1: 64 сектора
-    mov si, dap1
-    mov ah, 0x42
-    mov dl, 0x80
-    int 0x13
-    jc .disk_error
-
-    ; Часть 2: 64 сектора
-    mov si, dap2
-    mov ah, 0x42
-    mov dl, 0x80
-    int 0x13
-    jc .disk_error
-
-    ; Часть 3: 64 сектора
-    mov si, dap3
-    mov ah, 0x42
-    mov dl, 0x80
-    int 0x13
-    jc .disk_error
-
-    ; Часть 4: 64 сектора
-    mov si, dap4
-    mov ah, 0x42
-    mov dl, 0x80
-    int 0x13
-    jc .disk_error
-
-    ; Часть 5: 64 сектора
-    mov si, dap5
+    ; Загружаем KERNEL_LOAD_SECTORS секторов начиная с LBA 10 - только
+    ; сам образ, по KERNEL_LBA_CHUNK (127) секторов за вызов - больше
+    ; многие BIOS не принимают. Один DAP, после каждого чтения
+    ; segment += 63.5KB, LBA += 127; последний кусок - остаток
+    mov cx, KERNEL_LOAD_SECTORS
+.lba_loop:
+    mov ax, KERNEL_LBA_CHUNK
+    cmp cx, ax
+    jae .lba_read
+    mov ax, cx                          ; Хвост образа
+.lba_read:
+    mov [kernel_dap + 2], ax            ; BIOS мог переписать count
+    push cx
+    push ax
+    mov si, kernel_dap
     mov ah, 0x42
     mov dl, 0x80
     int 0x13
+    pop ax
+    pop cx
     jc .disk_error
 
-    ; Часть 6: 64 сектора
-    mov si, dap6
-    mov ah, 0x42
-    mov dl, 0x80
-    int 0x13
-    jc .disk_error
+    add word [kernel_dap + 6], KERNEL_LBA_CHUNK_PARAS   ; Segment: следующие 63.5KB
+    add dword [kernel_dap + 8], KERNEL_LBA_CHUNK        ; LBA: следующие 127 секторов
+    sub cx, ax
+    jnz .lba_loop
     jmp .check_kernel
 
 .use_chs:
-    ; Загружаем меньшими порциями, не переходя границу дорожки
-    ; Total: 250 sectors (53+63+63+63+8)
-    ; Часть 1: 53 сектора (сектора 11-63 на головке 0) → 0x10000
-    mov ah, 0x02
-    mov al, 53
-    mov ch, 0
-    mov cl, 11
-    mov dh, 0
-    mov dl, 0x80
-    mov bx, 0x1000
-    mov es, bx
-    mov bx, 0x0000
-    int 0x13
-    jc .disk_error
-
-    ; Часть 2: 63 сектора (вся головка 1) → 0x16A00
-    mov ah, 0x02
-    mov al, 63
-    mov ch, 0
-    mov cl, 1
-    mov dh, 1
+    ; Без Extensions - CHS по геометрии из AH=08h. По одному сектору:
+    ; чтение не пересекает ни дорожку, ни границу 64KB, и LBA → CHS
+    ; считается для всех KERNEL_LOAD_SECTORS (до 1024), а не для фиксированных
+    ; головок 0-4
+    mov ah, 0x08
     mov dl, 0x80
-    mov bx, 0x16A0
-    mov es, bx
-    mov bx, 0x0000
-    int 0x13
-    jc .disk_error
-
-    ; Часть 3: 63 сектора (вся головка 2) → 0x1E800
-    mov ah, 0x02
-    mov al, 63
-    mov ch, 0
-    mov cl, 1
-    mov dh, 2
-    mov dl, 0x80
-    mov bx, 0x1E80
-    mov es, bx
-    mov bx, 0x0000
+    xor di, di
+    mov es, di                          ; ES:DI = 0 - обход багов BIOS
     int 0x13
     jc .disk_error
-
-    ; Часть 4: 63 сектора (вся головка 3) → 0x26600
-    mov ah, 0x02
-    mov al, 63
-    mov ch, 0
-    mov cl, 1
-    mov dh, 3
+    and cx, 0x3F                        ; Секторов на дорожку: биты 0-5 CL
+    jz .disk_error
+    mov [chs_spt], cx
+    movzx ax, dh
+    inc ax                              ; Головок = DH + 1
+    mov [chs_heads], ax
+
+    mov word [chs_lba], KERNEL_SECTOR_START
+    mov word [chs_segment], KERNEL_LOAD_ADDR / 16
+    mov cx, KERNEL_LOAD_SECTORS
+.chs_loop:
+    push cx
+    ; sector = LBA % spt + 1, head = LBA / spt % heads, cylinder = LBA / spt / heads
+    mov ax, [chs_lba]
+    xor dx, dx
+    div word [chs_spt]                  ; AX = LBA / spt, DX = LBA % spt
+    inc dx
+    mov cl, dl                          ; Sector (1-based)
+    xor dx, dx
+    div word [chs_heads]                ; AX = cylinder, DX = head
+    mov dh, dl
+    mov ch, al                          ; Cylinder биты 0-7
+    shl ah, 6
+    or cl, ah                           ; Cylinder биты 8-9 → CL биты 6-7
     mov dl, 0x80
-    mov bx, 0x2660
+    mov bx, [chs_segment]
     mov es, bx
-    mov bx, 0x0000
+    xor bx, bx
+    mov ax, 0x0201                      ; AH=02h, один сектор
     int 0x13
+    pop cx
     jc .disk_error
 
-    ; Часть 5: 8 секторов (головка 4) → 0x2E400
-    mov ah, 0x02
-    mov al, 8
-    mov ch, 0
-    mov cl, 1
-    mov dh, 4
-    mov dl, 0x80
-    mov bx, 0x2E40
-    mov es, bx
-    mov bx, 0x0000
-    int 0x13
-    jc .disk_error
+    add word [chs_segment], 512 / 16
+    inc word [chs_lba]
+    loop .chs_loop
 
 .check_kernel:
     
@@ -785,62 +773,23 @@ gdt_descriptor:
     dw gdt_end - gdt_start - 1    ; Limit
     dd gdt_start                  ; Base address (32-bit в 16-bit режиме)
 
-; ===== DAP STRUCTURES FOR INT 13h EXTENSIONS (LBA MODE) =====
-; Total: 384 sectors = 192KB
-; 6 chunks of 64 sectors each (BIOS-safe size)
+; ===== DAP STRUCTURE FOR INT 13h EXTENSIONS (LBA MODE) =====
+; Total: KERNEL_LOAD_SECTORS sectors (до 1024 = 512KB)
+; Segment и LBA двигаются в .lba_loop
 align 4
-dap1:
+kernel_dap:
     db 0x10             ; DAP size (16 bytes)
     db 0                ; Reserved
-    dw 64               ; Sector count: 64
+    dw KERNEL_LBA_CHUNK ; Sector count (ставит .lba_loop)
     dw 0x0000           ; Offset
     dw 0x1000           ; Segment (0x1000:0x0000 = 0x10000 physical)
     dq 10               ; Starting LBA sector: 10
 
-align 4
-dap2:
-    db 0x10             ; DAP size (16 bytes)
-    db 0                ; Reserved
-    dw 64               ; Sector count: 64
-    dw 0x0000           ; Offset
-    dw 0x1800           ; Segment (0x1800:0x0000 = 0x18000 physical)
-    dq 74               ; Starting LBA sector: 74 (10 + 64)
-
-align 4
-dap3:
-    db 0x10             ; DAP size (16 bytes)
-    db 0                ; Reserved
-    dw 64               ; Sector count: 64
-    dw 0x0000           ; Offset
-    dw 0x2000           ; Segment (0x2000:0x0000 = 0x20000 physical)
-    dq 138              ; Starting LBA sector: 138 (10 + 64 + 64)
-
-align 4
-dap4:
-    db 0x10             ; DAP size (16 bytes)
-    db 0                ; Reserved
-    dw 64               ; Sector count: 64
-    dw 0x0000           ; Offset
-    dw 0x2800           ; Segment (0x2800:0x0000 = 0x28000 physical)
-    dq 202              ; Starting LBA sector: 202 (10 + 64 + 64 + 64)
-
-align 4
-dap5:
-    db 0x10             ; DAP size (16 bytes)
-    db 0                ; Reserved
-    dw 64               ; Sector count: 64
-    dw 0x0000           ; Offset
-    dw 0x3000           ; Segment (0x3000:0x0000 = 0x30000 physical)
-    dq 266              ; Starting LBA sector: 266 (10 + 64*4)
-
-align 4
-dap6:
-    db 0x10             ; DAP size (16 bytes)
-    db 0                ; Reserved
-    dw 64               ; Sector count: 64
-    dw 0x0000           ; Offset
-    dw 0x3800           ; Segment (0x3800:0x0000 = 0x38000 physical)
-    dq 330              ; Starting LBA sector: 330 (10 + 64*5)
+; ===== CHS FALLBACK (load_kernel_simple.use_chs) =====
+chs_spt      dw 0
+chs_heads    dw 0
+chs_lba      dw 0
+chs_segment  dw 0
 
 ; ===== MESSAGES =====
 msg_stage2_start      db 'BoxKernel Stage2 Started', 13, 10, 0
@@ -850,8 +799,8 @@ msg_e820_success      db '[OK] E820 memory map created', 13, 10, 0
 msg_e820_fail         db '[WARN] E820 failed, using fallback', 13, 10, 0
 msg_memory_fallback   db '[OK] Fallback memory detection', 13, 10, 0
 msg_memory_error      db '[ERROR] Memory detection failed!', 13, 10, 0
-msg_loading_kernel    db 'Loading kernel (512 sectors)...', 13, 10, 0
-msg_kernel_loaded     db '[OK] Kernel loaded (256KB)', 13, 10, 0
+msg_loading_kernel    db 'Loading kernel (LBA, 127-sector reads)...', 13, 10, 0
+msg_kernel_loaded     db '[OK] Kernel loaded', 13, 10, 0
 msg_kernel_empty      db '[WARN] Kernel appears empty', 13, 10, 0
 msg_disk_error        db '[ERROR] Disk read failed!', 13, 10, 0
 msg_long_mode_ok      db '[OK] CPU supports 64-bit mode', 13, 10, 0
@@ -0,0 +1,123 @@
+#include "ioapic.h"
+#include "io.h"
+#include "vmm.h"
+#include "klib.h"
+
+static uintptr_t ioapic_base = 0;
+static uint32_t ioapic_gsi_base = 0;
+static uint32_t ioapic_entries = 0;
+static spinlock_t ioapic_lock;
+
+// legacy IRQ → GSI/flags (по умолчанию identity, edge, active high)
+static uint32_t irq_to_gsi[IOAPIC_LEGACY_IRQS];
+static uint16_t irq_flags[IOAPIC_LEGACY_IRQS];
+
+static inline uint32_t ioapic_read(uint32_t reg) {
+    mmio_write32(ioapic_base + IOAPIC_REGSEL, reg);
+    return mmio_read32(ioapic_base + IOAPIC_WINDOW);
+}
+
+static inline void ioapic_write(uint32_t reg, uint32_t value) {
+    mmio_write32(ioapic_base + IOAPIC_REGSEL, reg);
+    mmio_write32(ioapic_base + IOAPIC_WINDOW, value);
+}
+
+static void ioapic_write_redir(uint32_t entry, uint64_t value) {
+    // Маскируем через low первым, чтобы не доставить полузаписанный entry
+    ioapic_write(IOAPIC_REG_REDTBL + 2 * entry, (uint32_t)IOAPIC_REDIR_MASKED);
+    ioapic_write(IOAPIC_REG_REDTBL + 2 * entry + 1, (uint32_t)(value >> 32));
+    ioapic_write(IOAPIC_REG_REDTBL + 2 * entry, (uint32_t)value);
+}
+
+int ioapic_init(uint32_t phys_base, uint32_t gsi_base) {
+    if (phys_base == 0) {
+        phys_base = IOAPIC_DEFAULT_BASE;
+    }
+
+    void* mapped = vmm_map_mmio(phys_base, IOAPIC_MMIO_SIZE);
+    if (!mapped) {
+        kprintf("[IOAPIC] %[E]ERROR: Failed to map IOAPIC at 0x%x%[D]\n", phys_base);
+        return 0;
+    }
+
+    spinlock_init(&ioapic_lock);
+    ioapic_base = (uintptr_t)mapped;
+    ioapic_gsi_base = gsi_base;
+
+    for (int i = 0; i < IOAPIC_LEGACY_IRQS; i++) {
+        // Не затираем overrides, пришедшие из MADT до init
+        if (irq_to_gsi[i] == 0 && irq_flags[i] == 0) {
+            irq_to_gsi[i] = (uint32_t)i;
+        }
+    }
+
+    uint32_t version = ioapic_read(IOAPIC_REG_VERSION);
+    ioapic_entries = ((version >> 16) & 0xFF) + 1;
+
+    // Всё замаскировано - PIC остаётся источником legacy IRQ
+    for (uint32_t i = 0; i < ioapic_entries; i++) {
+        ioapic_write_redir(i, IOAPIC_REDIR_MASKED);
+    }
+
+    kprintf("[IOAPIC] IOAPIC id=%u version=0x%x entries=%u gsi_base=%u (all masked)\n",
+            (ioapic_read(IOAPIC_REG_ID) >> 24) & 0x0F, version & 0xFF,
+            ioapic_entries, gsi_base);
+    return 1;
+}
+
+int ioapic_available(void) {
+    return ioapic_base != 0;
+}
+
+uint32_t ioapic_get_max_entries(void) {
+    return ioapic_entries;
+}
+
+void ioapic_set_override(uint8_t irq, uint32_t gsi, uint16_t flags) {
+    if (irq >= IOAPIC_LEGACY_IRQS) {
+        return;
+    }
+    irq_to_gsi[irq] = gsi;
+    irq_flags[irq] = flags;
+    kprintf("[IOAPIC] Override: IRQ %u -> GSI %u (flags=0x%x)\n", irq, gsi, flags);
+}
+
+int ioapic_route_irq(uint8_t irq, uint8_t vector, uint8_t apic_id) {
+    if (!ioapic_base || irq >= IOAPIC_LEGACY_IRQS) {
+        return 0;
+    }
+
+    uint32_t gsi = irq_to_gsi[irq];
+    if (gsi < ioapic_gsi_base || gsi - ioapic_gsi_base >= ioapic_entries) {
+        kprintf("[IOAPIC] ERROR: GSI %u for IRQ %u is outside this IOAPIC\n", gsi, irq);
+        return 0;
+    }
+
+    uint64_t redir = vector | ((uint64_t)apic_id << IOAPIC_REDIR_DEST_SHIFT);
+    if ((irq_flags[irq] & IOAPIC_ISO_POLARITY_MASK) == IOAPIC_ISO_POLARITY_LOW) {
+        redir |= IOAPIC_REDIR_ACTIVE_LOW;
+    }
+    if ((irq_flags[irq] & IOAPIC_ISO_TRIGGER_MASK) == IOAPIC_ISO_TRIGGER_LEVEL) {
+        redir |= IOAPIC_REDIR_LEVEL;
+    }
+
+    spin_lock(&ioapic_lock);
+    ioapic_write_redir(gsi - ioapic_gsi_base, redir);
+    spin_unlock(&ioapic_lock);
+    return 1;
+}
+
+void ioapic_mask_irq(uint8_t irq) {
+    if (!ioapic_base || irq >= IOAPIC_LEGACY_IRQS) {
+        return;
+    }
+
+    uint32_t gsi = irq_to_gsi[irq];
+    if (gsi < ioapic_gsi_base || gsi - ioapic_gsi_base >= ioapic_entries) {
+        return;
+    }
+
+    spin_lock(&ioapic_lock);
+    ioapic_write_redir(gsi - ioapic_gsi_base, IOAPIC_REDIR_MASKED);
+    spin_unlock(&ioapic_lock);
+}
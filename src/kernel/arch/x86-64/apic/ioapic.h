@@ -0,0 +1,59 @@
+#ifndef IOAPIC_H
+#define IOAPIC_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// I/O APIC - system-wide IRQ router
+// ============================================================================
+//
+// При инициализации все redirection entries маскируются: legacy IRQ
+// продолжают идти через 8259 PIC → LINT0 BSP. ioapic_route_irq() позволяет
+// перевести конкретный IRQ на IOAPIC (с учётом Interrupt Source Override)
+// и направить его на нужный CPU.
+//
+// ============================================================================
+
+#define IOAPIC_DEFAULT_BASE   0xFEC00000
+#define IOAPIC_MMIO_SIZE      0x20
+
+// Индексный доступ: IOREGSEL (+0x00), IOWIN (+0x10)
+#define IOAPIC_REGSEL         0x00
+#define IOAPIC_WINDOW         0x10
+
+#define IOAPIC_REG_ID         0x00
+#define IOAPIC_REG_VERSION    0x01
+#define IOAPIC_REG_REDTBL     0x10   // + 2 * entry (low), + 2 * entry + 1 (high)
+
+// Redirection entry bits
+#define IOAPIC_REDIR_MASKED        (1ULL << 16)
+#define IOAPIC_REDIR_LEVEL         (1ULL << 15)
+#define IOAPIC_REDIR_ACTIVE_LOW    (1ULL << 13)
+#define IOAPIC_REDIR_DEST_SHIFT    56
+
+// Interrupt Source Override flags (MPS INTI flags)
+#define IOAPIC_ISO_POLARITY_MASK   0x03
+#define IOAPIC_ISO_POLARITY_LOW    0x03
+#define IOAPIC_ISO_TRIGGER_MASK    0x0C
+#define IOAPIC_ISO_TRIGGER_LEVEL   0x0C
+
+#define IOAPIC_LEGACY_IRQS         16
+
+// Инициализация (все входы замаскированы)
+// Возвращает 1 при успехе, 0 если IOAPIC не отображён
+int ioapic_init(uint32_t phys_base, uint32_t gsi_base);
+
+// 1 если ioapic_init() отработал
+int ioapic_available(void);
+
+// Override из MADT: legacy IRQ → GSI + flags
+void ioapic_set_override(uint8_t irq, uint32_t gsi, uint16_t flags);
+
+// Направить legacy IRQ (0-15) на vector указанного CPU / замаскировать
+int ioapic_route_irq(uint8_t irq, uint8_t vector, uint8_t apic_id);
+void ioapic_mask_irq(uint8_t irq);
+
+// Количество входов (redirection entries)
+uint32_t ioapic_get_max_entries(void);
+
+#endif // IOAPIC_H
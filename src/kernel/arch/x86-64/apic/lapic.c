@@ -0,0 +1,212 @@
+#include "lapic.h"
+#include "cpu.h"
+#include "io.h"
+#include "idt.h"
+#include "gdt.h"
+#include "vmm.h"
+#include "klib.h"
+#include "pit.h"
+
+// Spurious vector stub (isr.asm): просто iretq, без EOI
+extern void lapic_spurious_isr(void);
+
+// Виртуальный адрес регистров (общий для всех CPU - у каждого свой LAPIC
+// по одному и тому же физическому адресу)
+static uintptr_t lapic_base = 0;
+
+// Сколько раз опрашивать delivery status перед таймаутом
+#define LAPIC_IPI_TIMEOUT 1000000
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return mmio_read32(lapic_base + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    mmio_write32(lapic_base + reg, value);
+}
+
+// Общая часть для BSP и AP: глобальное + программное включение
+static void lapic_enable_local(void) {
+    uint64_t apic_msr = cpu_read_msr(IA32_APIC_BASE_MSR);
+    if (!(apic_msr & IA32_APIC_BASE_ENABLE)) {
+        cpu_write_msr(IA32_APIC_BASE_MSR, apic_msr | IA32_APIC_BASE_ENABLE);
+    }
+
+    // Принимаем все приоритеты
+    lapic_write(LAPIC_REG_TPR, 0);
+
+    // Ошибки и таймер нам пока не нужны
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED);
+
+    // Software enable + spurious vector
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+    // ESR требует back-to-back запись перед чтением
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_write(LAPIC_REG_ESR, 0);
+}
+
+int lapic_init(uint32_t phys_base) {
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0x00000001, 0, &eax, &ebx, &ecx, &edx);
+
+    if (!(edx & (1 << 9))) {
+        kprintf("[LAPIC] %[W]CPU has no local APIC - staying on PIC only%[D]\n");
+        return 0;
+    }
+
+    // MADT может не сообщить адрес - берём из MSR
+    uint64_t apic_msr = cpu_read_msr(IA32_APIC_BASE_MSR);
+    if (phys_base == 0) {
+        phys_base = (uint32_t)(apic_msr & IA32_APIC_BASE_ADDR_MASK);
+    }
+    if (phys_base == 0) {
+        phys_base = LAPIC_DEFAULT_BASE;
+    }
+
+    void* mapped = vmm_map_mmio(phys_base, LAPIC_MMIO_SIZE);
+    if (!mapped) {
+        kprintf("[LAPIC] %[E]ERROR: Failed to map LAPIC at 0x%x%[D]\n", phys_base);
+        return 0;
+    }
+    lapic_base = (uintptr_t)mapped;
+
+    // Spurious interrupts не должны попадать в GPF handler
+    idt_set_entry(LAPIC_SPURIOUS_VECTOR, (uint64_t)lapic_spurious_isr,
+                  GDT_KERNEL_CODE, IDT_TYPE_INTERRUPT_GATE, 0);
+
+    lapic_enable_local();
+
+    // BSP: legacy PIC через LINT0 (virtual wire), NMI через LINT1
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_DELIVERY_EXTINT);
+    lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_DELIVERY_NMI);
+
+    kprintf("[LAPIC] BSP LAPIC enabled: phys=0x%x id=%u version=0x%x\n",
+            phys_base, lapic_get_id(), lapic_read(LAPIC_REG_VERSION) & 0xFF);
+    return 1;
+}
+
+int lapic_init_ap(void) {
+    if (!lapic_base) {
+        return 0;
+    }
+
+    lapic_enable_local();
+
+    // AP: legacy IRQ идут только на BSP
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_DELIVERY_NMI);
+    return 1;
+}
+
+int lapic_available(void) {
+    return lapic_base != 0;
+}
+
+uint8_t lapic_get_id(void) {
+    if (!lapic_base) {
+        // До lapic_init: initial APIC ID из CPUID
+        uint32_t eax, ebx, ecx, edx;
+        cpu_cpuid(0x00000001, 0, &eax, &ebx, &ecx, &edx);
+        return (uint8_t)(ebx >> 24);
+    }
+    return (uint8_t)(lapic_read(LAPIC_REG_ID) >> 24);
+}
+
+void lapic_eoi(void) {
+    if (lapic_base) {
+        lapic_write(LAPIC_REG_EOI, 0);
+    }
+}
+
+// ============================================================================
+// IPI
+// ============================================================================
+
+static int lapic_wait_delivery(void) {
+    for (int i = 0; i < LAPIC_IPI_TIMEOUT; i++) {
+        if (!(lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_DELIVERY_STATUS)) {
+            return 1;
+        }
+        asm volatile("pause");
+    }
+    return 0;
+}
+
+static int lapic_send_ipi(uint8_t apic_id, uint32_t icr_low) {
+    if (!lapic_base) {
+        return 0;
+    }
+
+    // ICR_HIGH первым: запись ICR_LOW отправляет IPI
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)apic_id << LAPIC_ICR_DEST_SHIFT);
+    lapic_write(LAPIC_REG_ICR_LOW, icr_low);
+    return lapic_wait_delivery();
+}
+
+int lapic_send_init(uint8_t apic_id) {
+    // INIT assert, затем de-assert (нужно старым CPU, безвредно новым)
+    if (!lapic_send_ipi(apic_id, LAPIC_ICR_DELIVERY_INIT | LAPIC_ICR_LEVEL_ASSERT |
+                                 LAPIC_ICR_TRIGGER_LEVEL)) {
+        return 0;
+    }
+    return lapic_send_ipi(apic_id, LAPIC_ICR_DELIVERY_INIT | LAPIC_ICR_TRIGGER_LEVEL);
+}
+
+int lapic_send_startup(uint8_t apic_id, uint8_t vector_page) {
+    return lapic_send_ipi(apic_id, LAPIC_ICR_DELIVERY_STARTUP | vector_page);
+}
+
+int lapic_send_fixed_ipi(uint8_t apic_id, uint8_t vector) {
+    return lapic_send_ipi(apic_id, LAPIC_ICR_DELIVERY_FIXED | vector);
+}
+
+// ============================================================================
+// TIMER
+// ============================================================================
+
+uint64_t lapic_timer_calibrate(uint32_t microseconds) {
+    if (!lapic_base || microseconds == 0) {
+        return 0;
+    }
+
+    // One-shot, замаскирован: только считаем
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_LVT_TIMER_ONESHOT);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0xFFFFFFFF);
+
+    pit_udelay(microseconds);
+
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CURRENT);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+
+    return (uint64_t)elapsed * 1000000 / microseconds;
+}
+
+void lapic_timer_start(uint8_t vector, int tsc_deadline) {
+    if (!lapic_base) {
+        return;
+    }
+
+    if (tsc_deadline) {
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_TIMER_DEADLINE | vector);
+        // Запись LVT должна стать видна до первой записи MSR (SDM 10.5.4.1)
+        asm volatile("mfence" ::: "memory");
+        cpu_write_msr(IA32_TSC_DEADLINE_MSR, 0);
+    } else {
+        lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_TIMER_ONESHOT | vector);
+        lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+    }
+}
+
+void lapic_timer_arm_deadline(uint64_t tsc) {
+    cpu_write_msr(IA32_TSC_DEADLINE_MSR, tsc);
+}
+
+void lapic_timer_arm_count(uint32_t count) {
+    if (lapic_base) {
+        lapic_write(LAPIC_REG_TIMER_INITIAL, count);
+    }
+}
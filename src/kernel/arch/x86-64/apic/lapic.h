@@ -0,0 +1,97 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// LOCAL APIC - per-CPU interrupt controller (xAPIC, MMIO)
+// ============================================================================
+//
+// BSP остаётся в virtual wire mode: legacy PIC приходит через LINT0 (ExtINT),
+// поэтому pic_send_eoi() по-прежнему корректен для IRQ 0-15.
+// LAPIC нужен для IPI (INIT/SIPI при старте AP, kick таймера), идентификации
+// CPU и как clock event BSP (timer, см. clock.h).
+//
+// ============================================================================
+
+#define IA32_APIC_BASE_MSR        0x1B
+#define IA32_APIC_BASE_BSP        (1ULL << 8)
+#define IA32_APIC_BASE_ENABLE     (1ULL << 11)
+#define IA32_APIC_BASE_ADDR_MASK  0xFFFFFF000ULL
+
+#define LAPIC_DEFAULT_BASE        0xFEE00000
+#define LAPIC_MMIO_SIZE           0x1000
+
+// Регистры (смещения от base)
+#define LAPIC_REG_ID              0x020
+#define LAPIC_REG_VERSION         0x030
+#define LAPIC_REG_TPR             0x080
+#define LAPIC_REG_EOI             0x0B0
+#define LAPIC_REG_SVR             0x0F0
+#define LAPIC_REG_ESR             0x280
+#define LAPIC_REG_ICR_LOW         0x300
+#define LAPIC_REG_ICR_HIGH        0x310
+#define LAPIC_REG_LVT_TIMER       0x320
+#define LAPIC_REG_LVT_LINT0       0x350
+#define LAPIC_REG_LVT_LINT1       0x360
+#define LAPIC_REG_LVT_ERROR       0x370
+#define LAPIC_REG_TIMER_INITIAL   0x380
+#define LAPIC_REG_TIMER_CURRENT   0x390
+#define LAPIC_REG_TIMER_DIVIDE    0x3E0
+
+// SVR
+#define LAPIC_SVR_ENABLE          0x100
+#define LAPIC_SPURIOUS_VECTOR     0xFF
+
+// LVT
+#define LAPIC_LVT_MASKED          0x10000
+#define LAPIC_LVT_DELIVERY_NMI    0x400
+#define LAPIC_LVT_DELIVERY_EXTINT 0x700
+#define LAPIC_LVT_TIMER_ONESHOT   0x00000
+#define LAPIC_LVT_TIMER_DEADLINE  0x40000
+
+// Timer
+#define IA32_TSC_DEADLINE_MSR     0x6E0
+#define LAPIC_TIMER_DIVIDE_16     0x3
+
+// ICR
+#define LAPIC_ICR_DELIVERY_FIXED   0x000
+#define LAPIC_ICR_DELIVERY_INIT    0x500
+#define LAPIC_ICR_DELIVERY_STARTUP 0x600
+#define LAPIC_ICR_DELIVERY_STATUS  0x1000
+#define LAPIC_ICR_LEVEL_ASSERT     0x4000
+#define LAPIC_ICR_TRIGGER_LEVEL    0x8000
+#define LAPIC_ICR_DEST_SHIFT       24
+
+// Инициализация
+// lapic_init:    BSP - отображает MMIO, включает LAPIC, LINT0 = ExtINT
+// lapic_init_ap: AP - включает свой LAPIC, LINT0 замаскирован
+// Возвращают 1 при успехе, 0 если LAPIC недоступен
+int lapic_init(uint32_t phys_base);
+int lapic_init_ap(void);
+
+// 1 если lapic_init() отработал
+int lapic_available(void);
+
+// APIC ID текущего CPU
+uint8_t lapic_get_id(void);
+
+// End of interrupt (для векторов, доставленных через LAPIC)
+void lapic_eoi(void);
+
+// IPI
+// Возвращают 1 если IPI принят (delivery status сброшен), 0 при таймауте
+int lapic_send_init(uint8_t apic_id);
+int lapic_send_startup(uint8_t apic_id, uint8_t vector_page);
+int lapic_send_fixed_ipi(uint8_t apic_id, uint8_t vector);
+
+// Timer текущего CPU (IF=0)
+// lapic_timer_calibrate: счёт в секунду при divide 16 (по PIT), 0 = не считает
+// lapic_timer_start:     LVT timer = vector, TSC-deadline или one-shot, не взведён
+// lapic_timer_arm_*:     взвести (0 = остановить)
+uint64_t lapic_timer_calibrate(uint32_t microseconds);
+void lapic_timer_start(uint8_t vector, int tsc_deadline);
+void lapic_timer_arm_deadline(uint64_t tsc);
+void lapic_timer_arm_count(uint32_t count);
+
+#endif // LAPIC_H
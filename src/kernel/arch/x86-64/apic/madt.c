@@ -0,0 +1,253 @@
+#include "madt.h"
+#include "ioapic.h"
+#include "vmm.h"
+#include "klib.h"
+
+// ============================================================================
+// ACPI STRUCTURES
+// ============================================================================
+
+typedef struct {
+    char signature[8];                 // "RSD PTR "
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;                  // 0 = ACPI 1.0, 2+ = XSDT есть
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+    uint8_t entries[];
+} __attribute__((packed)) acpi_madt_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) madt_entry_header_t;
+
+typedef struct {
+    madt_entry_header_t header;
+    uint8_t acpi_processor_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} __attribute__((packed)) madt_lapic_t;
+
+typedef struct {
+    madt_entry_header_t header;
+    uint8_t ioapic_id;
+    uint8_t reserved;
+    uint32_t ioapic_address;
+    uint32_t gsi_base;
+} __attribute__((packed)) madt_ioapic_t;
+
+typedef struct {
+    madt_entry_header_t header;
+    uint8_t bus;
+    uint8_t source;                    // Legacy IRQ
+    uint32_t gsi;
+    uint16_t flags;
+} __attribute__((packed)) madt_iso_t;
+
+typedef struct {
+    madt_entry_header_t header;
+    uint16_t reserved;
+    uint64_t lapic_address;
+} __attribute__((packed)) madt_lapic_override_t;
+
+// vmm_init() identity-map'ит первые 256MB - таблицы выше отображаем явно
+#define MADT_IDENTITY_LIMIT (256ULL * 1024 * 1024)
+
+#define EBDA_SEGMENT_PTR   0x40E
+#define BIOS_ROM_START     0xE0000
+#define BIOS_ROM_END       0x100000
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static void* acpi_map(uint64_t phys, uint32_t length) {
+    if (phys + length <= MADT_IDENTITY_LIMIT) {
+        return (void*)(uintptr_t)phys;
+    }
+    return vmm_map_mmio((uintptr_t)phys, length);
+}
+
+static int acpi_checksum_ok(const void* data, uint32_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+static acpi_rsdp_t* acpi_scan_rsdp(uintptr_t start, uintptr_t end) {
+    for (uintptr_t addr = start; addr + sizeof(acpi_rsdp_t) <= end; addr += 16) {
+        acpi_rsdp_t* rsdp = (acpi_rsdp_t*)addr;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 &&
+            acpi_checksum_ok(rsdp, 20)) {
+            return rsdp;
+        }
+    }
+    return 0;
+}
+
+static acpi_rsdp_t* acpi_find_rsdp(void) {
+    // 1. Первый KB EBDA
+    uintptr_t ebda = (uintptr_t)(*(volatile uint16_t*)EBDA_SEGMENT_PTR) << 4;
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        acpi_rsdp_t* rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+        if (rsdp) {
+            return rsdp;
+        }
+    }
+
+    // 2. BIOS ROM
+    return acpi_scan_rsdp(BIOS_ROM_START, BIOS_ROM_END);
+}
+
+// Отобразить SDT целиком (сначала header, чтобы узнать length)
+static acpi_sdt_header_t* acpi_map_sdt(uint64_t phys) {
+    acpi_sdt_header_t* header = (acpi_sdt_header_t*)acpi_map(phys, sizeof(acpi_sdt_header_t));
+    if (!header) {
+        return 0;
+    }
+    if (phys + header->length > MADT_IDENTITY_LIMIT) {
+        header = (acpi_sdt_header_t*)acpi_map(phys, header->length);
+    }
+    return header;
+}
+
+static acpi_madt_t* acpi_find_madt(acpi_rsdp_t* rsdp) {
+    int use_xsdt = rsdp->revision >= 2 && rsdp->xsdt_address != 0;
+    uint64_t root_phys = use_xsdt ? rsdp->xsdt_address : rsdp->rsdt_address;
+
+    acpi_sdt_header_t* root = acpi_map_sdt(root_phys);
+    if (!root || !acpi_checksum_ok(root, root->length)) {
+        kprintf("[MADT] ERROR: %s checksum invalid\n", use_xsdt ? "XSDT" : "RSDT");
+        return 0;
+    }
+
+    uint32_t entry_size = use_xsdt ? 8 : 4;
+    uint32_t count = (root->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    uint8_t* entries = (uint8_t*)root + sizeof(acpi_sdt_header_t);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t table_phys = use_xsdt ? *(uint64_t*)(entries + i * 8)
+                                       : *(uint32_t*)(entries + i * 4);
+
+        acpi_sdt_header_t* table = acpi_map_sdt(table_phys);
+        if (table && memcmp(table->signature, "APIC", 4) == 0) {
+            if (!acpi_checksum_ok(table, table->length)) {
+                kprintf("[MADT] ERROR: MADT checksum invalid\n");
+                return 0;
+            }
+            return (acpi_madt_t*)table;
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// MADT PARSING
+// ============================================================================
+
+int madt_parse(madt_info_t* info) {
+    memset(info, 0, sizeof(madt_info_t));
+
+    acpi_rsdp_t* rsdp = acpi_find_rsdp();
+    if (!rsdp) {
+        kprintf("[MADT] %[W]No ACPI RSDP found - single CPU mode%[D]\n");
+        return 0;
+    }
+
+    acpi_madt_t* madt = acpi_find_madt(rsdp);
+    if (!madt) {
+        kprintf("[MADT] %[W]No MADT in ACPI tables - single CPU mode%[D]\n");
+        return 0;
+    }
+
+    info->lapic_phys = madt->lapic_address;
+
+    uint8_t* ptr = madt->entries;
+    uint8_t* end = (uint8_t*)madt + madt->header.length;
+
+    while (ptr + sizeof(madt_entry_header_t) <= end) {
+        madt_entry_header_t* entry = (madt_entry_header_t*)ptr;
+
+        // DEFENSIVE: битая запись - прекращаем разбор
+        if (entry->length < sizeof(madt_entry_header_t) || ptr + entry->length > end) {
+            kprintf("[MADT] WARNING: Malformed entry (type=%u len=%u)\n",
+                    entry->type, entry->length);
+            break;
+        }
+
+        switch (entry->type) {
+            case MADT_ENTRY_LAPIC: {
+                madt_lapic_t* lapic = (madt_lapic_t*)entry;
+                if (!(lapic->flags & (MADT_LAPIC_ENABLED | MADT_LAPIC_ONLINE_CAPABLE))) {
+                    break;
+                }
+                if (info->cpu_count >= MADT_MAX_CPUS) {
+                    kprintf("[MADT] WARNING: CPU limit %d reached, APIC ID %u ignored\n",
+                            MADT_MAX_CPUS, lapic->apic_id);
+                    break;
+                }
+                info->apic_ids[info->cpu_count++] = lapic->apic_id;
+                break;
+            }
+
+            case MADT_ENTRY_IOAPIC: {
+                madt_ioapic_t* ioapic = (madt_ioapic_t*)entry;
+                // Используем первый IOAPIC (legacy IRQ живут на нём)
+                if (info->ioapic_phys == 0) {
+                    info->ioapic_phys = ioapic->ioapic_address;
+                    info->ioapic_gsi_base = ioapic->gsi_base;
+                    info->ioapic_id = ioapic->ioapic_id;
+                }
+                break;
+            }
+
+            case MADT_ENTRY_ISO: {
+                madt_iso_t* iso = (madt_iso_t*)entry;
+                ioapic_set_override(iso->source, iso->gsi, iso->flags);
+                break;
+            }
+
+            case MADT_ENTRY_LAPIC_OVERRIDE: {
+                madt_lapic_override_t* override = (madt_lapic_override_t*)entry;
+                info->lapic_phys = (uint32_t)override->lapic_address;
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        ptr += entry->length;
+    }
+
+    info->found = 1;
+    kprintf("[MADT] ACPI rev %u: %u CPU(s), LAPIC=0x%x, IOAPIC=0x%x (gsi_base=%u)\n",
+            rsdp->revision, info->cpu_count, info->lapic_phys,
+            info->ioapic_phys, info->ioapic_gsi_base);
+    return 1;
+}
@@ -0,0 +1,42 @@
+#ifndef MADT_H
+#define MADT_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// ACPI MADT - перечисление CPU (LAPIC) и IOAPIC
+// ============================================================================
+//
+// Минимальный ACPI: RSDP (EBDA / 0xE0000-0xFFFFF) → RSDT/XSDT → "APIC".
+// Без MADT система работает на одном BSP.
+//
+// ============================================================================
+
+#define MADT_MAX_CPUS        16
+
+// Типы записей MADT
+#define MADT_ENTRY_LAPIC           0
+#define MADT_ENTRY_IOAPIC          1
+#define MADT_ENTRY_ISO             2   // Interrupt Source Override
+#define MADT_ENTRY_LAPIC_OVERRIDE  5
+
+#define MADT_LAPIC_ENABLED         0x01
+#define MADT_LAPIC_ONLINE_CAPABLE  0x02
+
+typedef struct {
+    int found;                          // 1 если MADT найден и разобран
+
+    uint32_t lapic_phys;                // Адрес LAPIC (с учётом override)
+    uint32_t cpu_count;                 // Включённые CPU (включая BSP)
+    uint8_t apic_ids[MADT_MAX_CPUS];    // APIC ID в порядке MADT
+
+    uint32_t ioapic_phys;               // Первый IOAPIC (0 если нет)
+    uint32_t ioapic_gsi_base;
+    uint8_t ioapic_id;
+} madt_info_t;
+
+// Найти и разобрать MADT. Interrupt Source Overrides передаются
+// в ioapic_set_override(). Возвращает 1 если MADT найден.
+int madt_parse(madt_info_t* info);
+
+#endif // MADT_H
@@ -53,11 +53,11 @@ void gdt_init(void) {
     // Kernel Data Segment (индекс 2, селектор 0x10)  
     gdt_set_entry(2, 0, 0xFFFFF, 0x92, 0xC0);
     
-    // User Code Segment (индекс 3, селектор 0x18 | 3)
-    gdt_set_entry(3, 0, 0xFFFFF, 0xFA, 0xA0);
+    // User Data Segment (индекс 3, селектор 0x18 | 3) - до code ради SYSRET
+    gdt_set_entry(3, 0, 0xFFFFF, 0xF2, 0xC0);
     
-    // User Data Segment (индекс 4, селектор 0x20 | 3)  
-    gdt_set_entry(4, 0, 0xFFFFF, 0xF2, 0xC0);
+    // User Code Segment (индекс 4, селектор 0x20 | 3)
+    gdt_set_entry(4, 0, 0xFFFFF, 0xFA, 0xA0);
     
     // TSS будет настроен позже через gdt_set_tss_entry()
     // Индексы 5 и 6 зарезервированы для TSS (16 байт в x86-64)
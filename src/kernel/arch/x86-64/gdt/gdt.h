@@ -8,8 +8,9 @@
 // RPL (Requested Privilege Level): 0=Ring0 (kernel), 3=Ring3 (user)
 #define GDT_KERNEL_CODE   0x08              // Index 1, RPL=0
 #define GDT_KERNEL_DATA   0x10              // Index 2, RPL=0
-#define GDT_USER_CODE     (0x18 | 3)        // Index 3, RPL=3 (0x1B)
-#define GDT_USER_DATA     (0x20 | 3)        // Index 4, RPL=3 (0x23)
+// User data ПЕРЕД user code: SYSRET берёт SS = STAR[63:48] + 8, CS = + 16
+#define GDT_USER_DATA     (0x18 | 3)        // Index 3, RPL=3 (0x1B)
+#define GDT_USER_CODE     (0x20 | 3)        // Index 4, RPL=3 (0x23)
 #define GDT_TSS           0x28              // Index 5
 
 // Структура GDT записи
@@ -12,6 +12,10 @@ static uint8_t ist_stacks[7][IST_STACK_SIZE] __attribute__((aligned(16)));
 // Основной kernel стек для ring 0
 static uint8_t kernel_stack[8192] __attribute__((aligned(16)));
 
+// RSP0 для SYSCALL entry (isr.asm): SYSCALL стек не переключает, берёт
+// тот же kernel стек, что int 0x80 через TSS
+uint64_t tss_syscall_rsp0 = 0;
+
 // Внешние функции из gdt.c
 extern void gdt_set_tss_entry(int index, uint64_t base, uint64_t limit);
 
@@ -23,6 +27,7 @@ void tss_init(void) {
     
     // Настройка основных стеков
     kernel_tss.rsp0 = (uint64_t)kernel_stack + sizeof(kernel_stack) - 16;  // Ring 0 stack
+    tss_syscall_rsp0 = kernel_tss.rsp0;
     kernel_tss.rsp1 = 0;  // Ring 1 не используется в 64-bit
     kernel_tss.rsp2 = 0;  // Ring 2 не используется в 64-bit
     
@@ -73,6 +78,7 @@ void tss_init(void) {
 
 void tss_set_rsp0(uint64_t rsp0) {
     kernel_tss.rsp0 = rsp0;
+    tss_syscall_rsp0 = rsp0;
     kprintf("[TSS] RSP0 updated to 0x%p\n", (void*)rsp0);
 }
 
@@ -2,17 +2,26 @@
 #include "gdt.h"
 #include "klib.h"
 #include "io.h"
+#include "cpu.h"  // MSR (SYSCALL/SYSRET)
 #include "pic.h"
 #include "pit.h"  // PIT timer driver
+#include "clock.h"  // Tickless clock events (LAPIC timer)
+#include "lapic.h"  // EOI LAPIC timer
 #include "keyboard.h" // Keyboard driver
+#include "serial.h"  // COM1 TX (IRQ 4)
 #include "vmm.h"  // VMM for page fault handling
 #include "workflow_rings.h"  // EventRing, ResultRing structures
 #include "syscall.h"  // NOTIFY_* flags
 #include "workflow.h"  // Workflow API
 #include "routing_table.h"  // Routing table
 #include "process.h"  // Process management
+#include "kdata.h"  // Kernel data page (ulib_now)
 #include "scheduler.h"  // Scheduler stats (for watchdog)
 #include "atomics.h"  // Atomic operations
+#include "trace.h"  // Hot path trace points
+#include "fpu.h"  // Lazy FPU (#NM)
+#include "guide.h"  // guide_has_pending, pinned decks
+#include "hardware_timer.h"  // Ближайший таймер wheel
 
 static idt_entry_t idt[IDT_ENTRIES];
 static idt_descriptor_t idt_desc;
@@ -95,8 +104,12 @@ void idt_init(void) {
     idt_set_entry(COMPLETION_IRQ_VECTOR, (uint64_t)isr_table[COMPLETION_IRQ_VECTOR],
                   GDT_KERNEL_CODE, IDT_TYPE_INTERRUPT_GATE, 0);
 
-    // Оставшиеся записи (48-127, 130-255, except 0x80-0x81) пустые - будут вызывать General Protection Fault
-    for (int i = 48; i < SYSCALL_VECTOR; i++) {
+    // LAPIC timer (vector 0x30) - clock events BSP, см. clock.h
+    idt_set_entry(LAPIC_TIMER_VECTOR, (uint64_t)isr_table[LAPIC_TIMER_VECTOR],
+                  GDT_KERNEL_CODE, IDT_TYPE_INTERRUPT_GATE, 0);
+
+    // Оставшиеся записи (49-127, 130-255, except 0x80-0x81) пустые - будут вызывать General Protection Fault
+    for (int i = LAPIC_TIMER_VECTOR + 1; i < SYSCALL_VECTOR; i++) {
         idt_set_entry(i, (uint64_t)isr_table[13], GDT_KERNEL_CODE, IDT_TYPE_INTERRUPT_GATE, 0);
     }
     for (int i = COMPLETION_IRQ_VECTOR + 1; i < IDT_ENTRIES; i++) {
@@ -108,6 +121,7 @@ void idt_init(void) {
     kprintf("[IDT] Syscall gate: INT 0x80 (DPL=3, user-callable)\n");
 
     idt_load();
+    syscall_fast_init();
 
     kprintf("[IDT] %[S]IDT loaded successfully!%[D]\n");
 }
@@ -168,13 +182,32 @@ void exception_handler(interrupt_frame_t* frame) {
     // If CPL == 3, it's user-space; if CPL == 0, it's kernel-space
     int from_user_space = (frame->cs & 3) == 3;
 
+    // Lazy FPU (CR0.TS): не ошибка - загрузить SIMD state текущего процесса
+    // (trap из ядра только освобождает регистры, user state не грузит).
+    // Неудача (нет памяти под state) у user процесса - обычный crash ниже
+    if (frame->vector == EXCEPTION_DEVICE_NOT_AVAIL) {
+        if (fpu_handle_device_not_available(from_user_space)) {
+            return;
+        }
+    }
+
     // Special handling for page faults - try to handle silently
     if (frame->vector == EXCEPTION_PAGE_FAULT) {
         uint64_t cr2;
         asm volatile("mov %%cr2, %0" : "=r" (cr2));
 
+        // Lazy страницы user адресов - в контексте, чей CR3 загружен
+        // (fault мог случиться и в ядре, при копировании в буфер процесса)
+        uint64_t cr3;
+        asm volatile("mov %%cr3, %0" : "=r" (cr3));
+        process_t* faulting = process_get_current();
+        vmm_context_t* fault_ctx = NULL;
+        if (faulting && faulting->vmm_context && (faulting->cr3 & VMM_PAGE_MASK) == (cr3 & VMM_PAGE_MASK)) {
+            fault_ctx = (vmm_context_t*)faulting->vmm_context;
+        }
+
         // Try to handle the page fault
-        if (vmm_handle_page_fault(cr2, frame->error_code) == 0) {
+        if (vmm_handle_page_fault(fault_ctx, cr2, frame->error_code) == 0) {
             // Successfully handled - no need to print anything
             return;
         }
@@ -307,44 +340,111 @@ void exception_handler(interrupt_frame_t* frame) {
 }
 
 // Обработчик аппаратных прерываний (ИСПРАВЛЕНО)
+// ============================================================================
+// TIMER INTERRUPT (PIT IRQ 0 или LAPIC timer, см. clock.h)
+// ============================================================================
+
+// Следующий срок: граница tick, пока есть процессы или события в очередях,
+// иначе простой - не позже CLOCK_IDLE_MAX_MS. И ближайший таймер Hardware
+// deck, если его wheel крутит timer interrupt (sub-ms EVENT_TIMER_SLEEP)
+static uint64_t timer_next_deadline(uint64_t now) {
+    uint64_t deadline;
+    if (scheduler_needs_tick() || guide_has_pending()) {
+        deadline = clock_next_tick_tsc();
+    } else {
+        deadline = now + clock_tsc_hz() / 1000 * CLOCK_IDLE_MAX_MS;
+    }
+
+    if (!guide_deck_is_pinned(DECK_PREFIX_HARDWARE)) {
+        uint64_t timer = hardware_timer_next_deadline();
+        if (timer && timer < deadline) {
+            deadline = timer;
+        }
+    }
+    return deadline;
+}
+
+static void timer_interrupt(interrupt_frame_t* frame) {
+    int tick = clock_tick_due(rdtsc());
+
+    // EVENT_MEMORY_FREE с AP: снятие и сброс TLB - здесь, на BSP
+    extern void storage_deck_drain_frees(void);
+    storage_deck_drain_frees();
+
+    // ASYNC WORKFLOW PROCESSING: Process events in background
+    // Каждое прерывание: tick, срок таймера Hardware deck или kick (wake / I/O)
+    guide_process_all();
+
+    // PREEMPTIVE SCHEDULING: раз в tick (hybrid: cooperative + preemptive).
+    // Простаивающий CPU берёт разбуженный процесс сразу, не ждёт tick
+    if (tick || (!process_get_current() && scheduler_needs_tick())) {
+        scheduler_tick(frame);
+    }
+
+    // Снимок времени для ulib_now() (kernel data page)
+    kdata_update();
+
+    // Kicks во время прохода уже учтены - перевзводим с нуля
+    if (clock_event_mode() != CLOCK_EVENT_PIT) {
+        clock_event_fired();
+        clock_event_program(timer_next_deadline(rdtsc()));
+    }
+}
+
 void irq_handler(interrupt_frame_t* frame) {
     uint8_t irq = frame->vector - 32;
     
     if (irq < 16) {
         irq_count[irq]++;
     }
+
+    // LAPIC timer / kick IPI - EOI в LAPIC, PIC этого вектора не видел
+    if (frame->vector == LAPIC_TIMER_VECTOR) {
+        timer_interrupt(frame);
+        lapic_eoi();
+        return;
+    }
     
     // Обработчики для основных IRQ
     switch(frame->vector) {
         case IRQ_TIMER:
-            // Increment PIT tick counter
+            // PIT 100 Hz - пока clock_event_init() не перевёл на LAPIC timer
             pit_tick();
-
-            // ASYNC WORKFLOW PROCESSING: Process events in background
-            // Run guide EVERY tick (10ms at 100Hz) for responsive async processing
-            extern void guide_process_all(void);
-            guide_process_all();
-
-            // PREEMPTIVE SCHEDULING: Call scheduler on timer tick
-            // This enables hybrid scheduling (cooperative + preemptive)
-            extern void scheduler_tick(interrupt_frame_t* frame);
-            scheduler_tick(frame);
-
-            // Таймер - уменьшили частоту логирования
-            if (irq_count[0] % 1000 == 0) {  // Каждые ~55 секунд вместо 5.5
-                uint64_t minutes = irq_count[0] > 1100 ? irq_count[0] / 1100 : 0;
-                // kprintf("%[H]Timer: %llu ticks (~%llu minutes)%[D]\n",
-                //        irq_count[0], minutes);
-            }
+            timer_interrupt(frame);
             break;
             
         case IRQ_KEYBOARD:
             // Клавиатура - читаем scancode и обрабатываем
             uint8_t scancode = inb(0x60);
-            keyboard_handle_scancode(scancode);
+            if (keyboard_handle_scancode(scancode)) {
+                clock_event_kick();  // Ждущий READ_LINE/READ_CHAR - Hardware deck не ждёт срока
+            }
+            break;
+
+        case IRQ_COM1:
+            // THR пуст - следующая порция TX ring в FIFO
+            serial_irq_handler();
+            break;
+
+        case IRQ_ATA_PRIMARY:
+            // Async DMA запрос завершён - в done list, done() вызовет Storage Deck
+            extern void ata_irq_handler(void);
+            ata_irq_handler();
+            clock_event_kick();  // Storage Deck (timer interrupt) - не ждать срока
             break;
             
         default:
+            // AHCI / virtio-blk / virtio-net - PCI INTx, линию назначил BIOS.
+            // Линия может быть общей - спрашиваем всех
+            extern int ata_backend_irq_handler(uint8_t irq);
+            extern int virtio_net_irq_handler(uint8_t irq);
+            int handled = ata_backend_irq_handler(irq);
+            handled |= virtio_net_irq_handler(irq);  // Принят кадр - Network deck раздаст ждущим
+            if (handled) {
+                clock_event_kick();
+                break;
+            }
+
             // Остальные IRQ - логируем только первые несколько раз
             if (irq_count[irq] <= 3) {  // Только первые 3 раза
                 kprintf("%[H]IRQ %d triggered (vector %d, count=%llu)%[D]\n", 
@@ -357,6 +457,273 @@ void irq_handler(interrupt_frame_t* frame) {
     pic_send_eoi(irq);
 }
 
+// ============================================================================
+// EVENT RING INGESTION (SUBMIT + SQPOLL)
+// ============================================================================
+
+// Payload события копируется в RoutingEntry (слот user может переписать
+// в любой момент), слот отпускается сразу после ingestion. Kernel читает по
+// своему курсору event_ring_consumed, а EventRing.head (видимый user'у)
+// двигает только syscall_release_event_slot().
+//
+// BACKPRESSURE: событие принимаем, только если под его результат
+// гарантированно есть место в ResultRing (остальные ждут в EventRing)
+//
+// ID: слот (FIXED) или запись (COMPACT) получает назначенный id (или
+// RING_EVENT_ID_REJECTED) раньше, чем EventRing.head его отпустит - user
+// сопоставляет ответы по id без угадывания
+//
+// SMP: SUBMIT идёт на BSP, SQPOLL poller - на своём AP. Consumer у ring
+// один за раз: event_ring_consumed и bitmap слотов под event_ring_lock
+uint64_t syscall_ingest_event_ring(process_t* proc, uint64_t workflow_id) {
+    if (!proc) {
+        return 0;
+    }
+
+    spin_lock(&proc->event_ring_lock);
+    uint64_t processed = syscall_ingest_event_ring_locked(proc, workflow_id);
+    spin_unlock(&proc->event_ring_lock);
+    return processed;
+}
+
+// Нет ResultRing credit: в trace только начало эпизода, не каждый SUBMIT/проход
+static void syscall_ingest_throttle(process_t* proc, uint64_t waiting) {
+    if (!proc->event_ring_throttled) {
+        proc->event_ring_throttled = 1;
+        TRACE_INFO(TRACE_SYSCALL_THROTTLE, proc->pid, waiting);
+    }
+}
+
+// FIXED формат: RingEvent по 576 байт
+static uint64_t syscall_ingest_fixed(process_t* proc, uint64_t workflow_id, uint64_t credit) {
+    extern RoutingTable global_routing_table;
+
+    EventRing* event_ring = (EventRing*)proc->event_ring;
+    uint64_t tail = atomic_load_u64(&event_ring->tail);
+
+    // DEFENSIVE: tail пишет user - не доверяем
+    if (tail - proc->event_ring_consumed > EVENT_RING_SIZE) {
+        kprintf("[SYSCALL] ERROR: Corrupt EventRing tail=%lu (consumed=%lu), ignoring batch\n",
+                tail, proc->event_ring_consumed);
+        return 0;
+    }
+
+    uint64_t processed = 0;
+
+    // Process ALL events from EventRing (batch processing)
+    while (proc->event_ring_consumed != tail) {
+        if (credit == 0) {
+            syscall_ingest_throttle(proc, tail - proc->event_ring_consumed);
+            break;
+        }
+        proc->event_ring_throttled = 0;
+
+        uint64_t slot = proc->event_ring_consumed++;
+        RingEvent* user_event = &event_ring->events[slot % EVENT_RING_SIZE];
+
+        // Validate event data - SECURITY CRITICAL!
+        // 1. Check workflow_id matches
+        if (user_event->workflow_id != workflow_id) {
+            kprintf("[SYSCALL] WARNING: Event workflow_id=%lu != %lu\n",
+                    user_event->workflow_id, workflow_id);
+            user_event->id = RING_EVENT_ID_REJECTED;
+            syscall_release_event_slot(proc, proc->pid, slot);
+            continue;
+        }
+
+        // 2. Validate payload size (max 512 bytes as per RingEvent definition)
+        #define MAX_EVENT_PAYLOAD_SIZE 512
+        if (user_event->payload_size > MAX_EVENT_PAYLOAD_SIZE) {
+            kprintf("[SYSCALL] ERROR: Invalid payload size %u (max %d), skipping event\n",
+                    user_event->payload_size, MAX_EVENT_PAYLOAD_SIZE);
+            user_event->id = RING_EVENT_ID_REJECTED;
+            syscall_release_event_slot(proc, proc->pid, slot);
+            continue;
+        }
+
+        // 3. Validate event type (basic sanity check)
+        #define MAX_EVENT_TYPE 255
+        if (user_event->type > MAX_EVENT_TYPE) {
+            kprintf("[SYSCALL] WARNING: Suspicious event type %u, continuing anyway\n",
+                    user_event->type);
+        }
+
+        // Assign unique ID and timestamp
+        user_event->id = atomic_increment_u64(&global_event_id_counter);
+        user_event->timestamp = rdtsc();
+
+        TRACE_INFO(TRACE_SYSCALL_EVENT, user_event->id, user_event->type);
+
+        // Add to Routing Table (payload копируется - слот больше не нужен)
+        if (!routing_table_add_ring_event(&global_routing_table, user_event, proc, slot)) {
+            user_event->id = RING_EVENT_ID_REJECTED;
+            syscall_release_event_slot(proc, proc->pid, slot);
+            continue;
+        }
+        syscall_release_event_slot(proc, proc->pid, slot);
+
+        credit--;
+        processed++;
+    }
+
+    return processed;
+}
+
+// COMPACT формат: variable-length записи, позиции в 64-байтных units
+static uint64_t syscall_ingest_compact(process_t* proc, uint64_t workflow_id, uint64_t credit) {
+    extern RoutingTable global_routing_table;
+
+    CompactRing* ring = (CompactRing*)proc->event_ring;
+    uint32_t size_units = proc->event_ring_units;       // Не ring->size_units (пишет user)
+    uint64_t tail = atomic_load_u64(&ring->tail);
+
+    // DEFENSIVE: tail пишет user - не доверяем
+    if (tail - proc->event_ring_consumed > size_units) {
+        kprintf("[SYSCALL] ERROR: Corrupt CompactRing tail=%lu (consumed=%lu), ignoring batch\n",
+                tail, proc->event_ring_consumed);
+        return 0;
+    }
+
+    uint64_t processed = 0;
+
+    while (proc->event_ring_consumed != tail) {
+        if (credit == 0) {
+            syscall_ingest_throttle(proc, tail - proc->event_ring_consumed);
+            break;
+        }
+        proc->event_ring_throttled = 0;
+
+        uint64_t pos = proc->event_ring_consumed;
+        CompactEvent* user_event = (CompactEvent*)wf_compact_at(ring, size_units, pos);
+
+        // Validate record framing - SECURITY CRITICAL! Длину читаем один раз
+        uint32_t units = user_event->header.units;
+        uint32_t flags = user_event->header.flags;
+        uint64_t offset = pos & (size_units - 1);
+        uint32_t max_units = (flags & COMPACT_FLAG_PAD) ? size_units : proc->ring_max_entry_units;
+
+        if (units == 0 || units > max_units || offset + units > size_units ||
+            units > tail - pos) {
+            // Границу следующей записи найти нельзя - отбрасываем всё до tail
+            kprintf("[SYSCALL] ERROR: Corrupt CompactRing record at %lu (units=%u), dropping %lu unit(s)\n",
+                    pos, units, tail - pos);
+            proc->event_ring_consumed = tail;
+            syscall_release_event_slot(proc, proc->pid, COMPACT_SLOT(pos, tail - pos));
+            break;
+        }
+
+        proc->event_ring_consumed = pos + units;
+        uint64_t slot = COMPACT_SLOT(pos, units);
+
+        if (flags & COMPACT_FLAG_PAD) {
+            syscall_release_event_slot(proc, proc->pid, slot);
+            continue;
+        }
+
+        // 1. Check workflow_id matches
+        if (user_event->workflow_id != workflow_id) {
+            kprintf("[SYSCALL] WARNING: Event workflow_id=%lu != %lu\n",
+                    user_event->workflow_id, workflow_id);
+            user_event->id = RING_EVENT_ID_REJECTED;
+            syscall_release_event_slot(proc, proc->pid, slot);
+            continue;
+        }
+
+        // 2. Payload обязан лежать внутри своей записи
+        if (user_event->payload_size > EVENT_PAYLOAD_SIZE) {
+            kprintf("[SYSCALL] ERROR: Invalid payload size %u (max %d), skipping event\n",
+                    user_event->payload_size, EVENT_PAYLOAD_SIZE);
+            user_event->id = RING_EVENT_ID_REJECTED;
+            syscall_release_event_slot(proc, proc->pid, slot);
+            continue;
+        }
+
+        uint64_t event_id = atomic_increment_u64(&global_event_id_counter);
+        uint64_t timestamp = rdtsc();
+
+        TRACE_INFO(TRACE_SYSCALL_EVENT, event_id, user_event->header.type);
+
+        // Как у FIXED: id в запись до того, как head её отпустит
+        int added = routing_table_add_compact_event(&global_routing_table, user_event, proc,
+                                                    slot, event_id, timestamp);
+        user_event->id = added ? event_id : RING_EVENT_ID_REJECTED;
+        syscall_release_event_slot(proc, proc->pid, slot);
+        if (!added) {
+            continue;
+        }
+
+        credit--;
+        processed++;
+    }
+
+    return processed;
+}
+
+// Забирает все события из EventRing процесса в routing table (под
+// event_ring_lock). Вызывается из syscall_ingest_event_ring и SQPOLL-поллера
+uint64_t syscall_ingest_event_ring_locked(process_t* proc, uint64_t workflow_id) {
+    // DEFENSIVE: Validate input
+    if (!proc || !proc->event_ring) {
+        return 0;
+    }
+
+    extern uint64_t execution_deck_result_credit(process_t* proc);
+    uint64_t credit = execution_deck_result_credit(proc);
+
+    if (proc->ring_format == PROCESS_RING_FORMAT_COMPACT) {
+        return syscall_ingest_compact(proc, workflow_id, credit);
+    }
+    return syscall_ingest_fixed(proc, workflow_id, credit);
+}
+
+int syscall_event_ring_pending(process_t* proc) {
+    if (!proc || !proc->event_ring) {
+        return 0;
+    }
+    EventRing* event_ring = (EventRing*)proc->event_ring;
+    return atomic_load_u64(&event_ring->tail) != proc->event_ring_consumed;
+}
+
+void syscall_release_event_slot(process_t* proc, uint64_t pid, uint64_t slot) {
+    // DEFENSIVE: процесс мог умереть (и слот таблицы переиспользоваться),
+    // пока событие было в полёте - тогда ring уже освобождён
+    if (!proc || proc->pid != pid || !proc->event_ring) {
+        return;
+    }
+
+    // COMPACT и FIXED используют общий header (head/tail на тех же смещениях)
+    EventRing* event_ring = (EventRing*)proc->event_ring;
+    uint64_t head = event_ring->head;
+    uint64_t size_units = proc->event_ring_units;
+    uint64_t pos = COMPACT_SLOT_POS(slot);
+    uint32_t units = COMPACT_SLOT_UNITS(slot);
+
+    if (pos < head || pos + units > proc->event_ring_consumed) {
+        return;  // Уже освобождён или чужой слот
+    }
+
+    // Запись COMPACT занимает несколько units - отмечаем все
+    uint64_t idx;
+    for (uint32_t i = 0; i < units; i++) {
+        idx = (pos + i) % size_units;
+        proc->event_slot_done[idx / 64] |= (1ULL << (idx % 64));
+    }
+
+    // In-order: двигаем head через все подряд освобождённые слоты
+    while (head < proc->event_ring_consumed) {
+        idx = head % size_units;
+        uint64_t bit = 1ULL << (idx % 64);
+        if (!(proc->event_slot_done[idx / 64] & bit)) {
+            break;
+        }
+        proc->event_slot_done[idx / 64] &= ~bit;
+        head++;
+    }
+
+    MEMORY_BARRIER();
+    atomic_store_u64(&event_ring->head, head);
+}
+
 // ============================================================================
 // KERNEL_NOTIFY SYSCALL HANDLER
 // ============================================================================
@@ -368,6 +735,12 @@ void irq_handler(interrupt_frame_t* frame) {
 //   NOTIFY_SUBMIT - process events from EventRing
 //   NOTIFY_WAIT   - block until workflow completes
 //   NOTIFY_POLL   - check workflow status (non-blocking)
+//   NOTIFY_INSTANCE - вместе с WAIT/POLL: RDX = instance_id, состояние этого
+//                   instance (0 = COMPLETED, 1 = работает, 2 = ERROR,
+//                   -1 = не его instance); завершённый instance освобождается
+//   NOTIFY_SQPOLL - let Guide poll EventRing.tail (no SUBMIT per batch)
+//   NOTIFY_REGISTER_BUFFER - allocate/map registered buffer (RDX = size)
+//   NOTIFY_ACTIVATE - new instance of workflow RDI (RAX = instance_id)
 //
 // ============================================================================
 
@@ -395,22 +768,27 @@ void syscall_handler(interrupt_frame_t* frame) {
     proc->last_syscall_tick = scheduler_stats.total_ticks;
     proc->syscall_count++;
 
-    // 2. Validate workflow_id bounds (max 16 workflows)
-    #define MAX_WORKFLOWS 16
-    if (workflow_id >= MAX_WORKFLOWS) {
-        kprintf("[SYSCALL] ERROR: Invalid workflow_id %lu (max %d)\n",
-                workflow_id, MAX_WORKFLOWS);
-        frame->rax = (uint64_t)-2;
-        return;
+    // BACKPRESSURE: процесс в syscall - скорее всего уже прочитал results,
+    // дописываем parked results в освободившиеся слоты ResultRing
+    if (proc->result_overflow_count > 0) {
+        extern uint32_t execution_deck_flush_overflow(process_t* proc);
+        execution_deck_flush_overflow(proc);
     }
 
-    // 3. Validate flags (NOTIFY_SUBMIT, NOTIFY_WAIT, NOTIFY_POLL, NOTIFY_YIELD, NOTIFY_EXIT allowed)
+    // 2. workflow_id не ограничен: registry - hash-таблица, WAIT/POLL/ACTIVATE
+    //    проверяют существование через workflow_get()
+
+    // 3. Validate flags (NOTIFY_SUBMIT, NOTIFY_WAIT, NOTIFY_POLL, NOTIFY_YIELD, NOTIFY_EXIT, NOTIFY_SQPOLL, NOTIFY_REGISTER_BUFFER, NOTIFY_ACTIVATE, NOTIFY_INSTANCE allowed)
     #define NOTIFY_SUBMIT 0x01
     #define NOTIFY_WAIT   0x02
     #define NOTIFY_POLL   0x04
     #define NOTIFY_YIELD  0x08
     #define NOTIFY_EXIT   0x10
-    #define VALID_FLAGS_MASK (NOTIFY_SUBMIT | NOTIFY_WAIT | NOTIFY_POLL | NOTIFY_YIELD | NOTIFY_EXIT)
+    #define NOTIFY_SQPOLL 0x20
+    #define NOTIFY_REGISTER_BUFFER 0x40
+    #define NOTIFY_ACTIVATE 0x80
+    #define NOTIFY_INSTANCE 0x100
+    #define VALID_FLAGS_MASK (NOTIFY_SUBMIT | NOTIFY_WAIT | NOTIFY_POLL | NOTIFY_YIELD | NOTIFY_EXIT | NOTIFY_SQPOLL | NOTIFY_REGISTER_BUFFER | NOTIFY_ACTIVATE | NOTIFY_INSTANCE)
 
     if (flags & ~VALID_FLAGS_MASK) {
         kprintf("[SYSCALL] ERROR: Invalid flags 0x%lx (valid mask: 0x%x)\n",
@@ -435,71 +813,60 @@ void syscall_handler(interrupt_frame_t* frame) {
 
     // External references
     extern Workflow* workflow_get(uint64_t workflow_id);
-    extern RoutingTable global_routing_table;
 
     // ========================================================================
-    // MODE 1: SUBMIT - Process events from EventRing
+    // MODE 0: REGISTER_BUFFER - Shared buffer for bulk event data
     // ========================================================================
 
-    if (flags & NOTIFY_SUBMIT) {
-        // Ring buffers already validated in input validation section
-        EventRing* event_ring = (EventRing*)proc->event_ring;
-
-        kprintf("[SYSCALL] kernel_notify(SUBMIT) from RIP=0x%lx, RSP=0x%lx\n",
-                frame->rip, frame->rsp);
-        kprintf("[SYSCALL] EventRing: head=%u tail=%u empty=%d\n",
-                event_ring->head, event_ring->tail,
-                wf_event_ring_is_empty(event_ring));
-
-        uint64_t processed = 0;
+    if (flags & NOTIFY_REGISTER_BUFFER) {
+        // RDX = size; RAX = index (-6 при ошибке). Буфер доступен user'у
+        // по REG_BUFFER_USER_BASE + index * REG_BUFFER_MAX_SIZE
+        int64_t index = process_register_buffer(proc, frame->rdx);
+        frame->rax = index >= 0 ? (uint64_t)index : (uint64_t)-6;
+        return;
+    }
 
-        // Process ALL events from EventRing (batch processing)
-        while (!wf_event_ring_is_empty(event_ring)) {
-            RingEvent* user_event = wf_event_ring_pop(event_ring);
+    // ========================================================================
+    // MODE 0: ACTIVATE - New instance of a registered workflow
+    // ========================================================================
 
-            if (!user_event) {
-                break;  // Empty
-            }
+    if (flags & NOTIFY_ACTIVATE) {
+        // RAX = instance_id (0 при ошибке). Результаты nodes идут в
+        // ResultRing вызывающего; активации одного workflow независимы
+        extern uint64_t workflow_activate(uint64_t workflow_id, const void* params,
+                                          uint64_t param_size, uint64_t owner_pid);
+        frame->rax = workflow_activate(workflow_id, 0, 0, proc->pid);
+        return;
+    }
 
-            // Validate event data - SECURITY CRITICAL!
-            // 1. Check workflow_id matches
-            if (user_event->workflow_id != workflow_id) {
-                kprintf("[SYSCALL] WARNING: Event workflow_id=%lu != %lu\n",
-                        user_event->workflow_id, workflow_id);
-                continue;
-            }
+    // ========================================================================
+    // MODE 0: SQPOLL - Register process for kernel-side EventRing polling
+    // ========================================================================
 
-            // 2. Validate payload size (max 512 bytes as per RingEvent definition)
-            #define MAX_EVENT_PAYLOAD_SIZE 512
-            if (user_event->payload_size > MAX_EVENT_PAYLOAD_SIZE) {
-                kprintf("[SYSCALL] ERROR: Invalid payload size %u (max %d), skipping event\n",
-                        user_event->payload_size, MAX_EVENT_PAYLOAD_SIZE);
-                continue;
-            }
+    if (flags & NOTIFY_SQPOLL) {
+        EventRing* event_ring = (EventRing*)proc->event_ring;
 
-            // 3. Validate event type (basic sanity check)
-            #define MAX_EVENT_TYPE 255
-            if (user_event->type > MAX_EVENT_TYPE) {
-                kprintf("[SYSCALL] WARNING: Suspicious event type %u, continuing anyway\n",
-                        user_event->type);
-            }
+        proc->sqpoll_workflow_id = workflow_id;
+        proc->sqpoll_last_active = 0;  // Поллер начнёт отсчёт простоя заново
+        atomic_store_u32(&event_ring->flags, event_ring->flags & ~EVENT_RING_FLAG_NEED_WAKEUP);
+        atomic_store_u32(&proc->sqpoll_active, 1);
 
-            // Assign unique ID and timestamp
-            user_event->id = atomic_increment_u64(&global_event_id_counter);
-            user_event->timestamp = rdtsc();
+        TRACE_INFO(TRACE_SYSCALL_SQPOLL, proc->pid, workflow_id);
 
-            kprintf("[SYSCALL] Event ID=%lu, type=%u, route=[%u,%u,%u,%u]\n",
-                    user_event->id, user_event->type,
-                    user_event->route[0], user_event->route[1],
-                    user_event->route[2], user_event->route[3]);
+        if (!(flags & NOTIFY_SUBMIT)) {
+            frame->rax = 0;
+            return;
+        }
+    }
 
-            // Add to Routing Table
-            routing_table_add_event(&global_routing_table, user_event);
+    // ========================================================================
+    // MODE 1: SUBMIT - Process events from EventRing
+    // ========================================================================
 
-            processed++;
-        }
+    if (flags & NOTIFY_SUBMIT) {
+        uint64_t processed = syscall_ingest_event_ring(proc, workflow_id);
 
-        kprintf("[SYSCALL] Processed %lu events from EventRing\n", processed);
+        TRACE_INFO(TRACE_SYSCALL_SUBMIT, proc->pid, processed);
 
         // Events are now in routing table.
         // ASYNC: They will be processed by guide_process_all() in timer IRQ (every tick)
@@ -513,20 +880,43 @@ void syscall_handler(interrupt_frame_t* frame) {
     // MODE 2: WAIT - Block until workflow completes (COOPERATIVE YIELD!)
     // ========================================================================
 
+    if ((flags & NOTIFY_INSTANCE) && (flags & (NOTIFY_WAIT | NOTIFY_POLL))) {
+        extern int64_t workflow_instance_poll(uint64_t instance_id, uint64_t owner_pid,
+                                              uint64_t* workflow_id);
+        uint64_t instance_workflow = 0;
+        int64_t status = workflow_instance_poll(frame->rdx, proc->pid, &instance_workflow);
+        frame->rax = (uint64_t)status;
+        if (status != 1 || !(flags & NOTIFY_WAIT)) {
+            return;
+        }
+
+        // Instance ещё работает: RAX = 1 уже в сохраняемом контексте - после
+        // пробуждения user повторяет WAIT и получает итог. Завершение
+        // instance будит владельца по ключу шаблона (workflow_instance_finish)
+        extern int scheduler_wait_enqueue(process_t* proc, uint64_t workflow_id);
+        if (!scheduler_wait_enqueue(proc, instance_workflow)) {
+            atomic_store_u32(&proc->completion_ready, 0);
+            return;
+        }
+
+        extern void scheduler_yield_cooperative(interrupt_frame_t* frame);
+        scheduler_yield_cooperative(frame);
+        return;
+    }
+
     if (flags & NOTIFY_WAIT) {
         Workflow* workflow = workflow_get(workflow_id);
 
+        // WAIT/YIELD идут на каждый batch - только trace, не kprintf
         if (!workflow) {
-            kprintf("[SYSCALL] ERROR: Workflow ID=%lu not found\n", workflow_id);
+            TRACE_INFO(TRACE_SYSCALL_BAD_WORKFLOW, proc->pid, workflow_id);
             frame->rax = (uint64_t)-1;
             return;
         }
 
-        kprintf("[SYSCALL] kernel_notify(WAIT) - checking completion\n");
-
         // Check if already completed (completion IRQ came during SUBMIT)
         if (atomic_load_u32(&proc->completion_ready)) {
-            kprintf("[SYSCALL] Already completed (completion IRQ arrived during SUBMIT)\n");
+            TRACE_INFO(TRACE_SYSCALL_WAKE, proc->pid, workflow_id);
             atomic_store_u32(&proc->completion_ready, 0);  // Clear for next time
             frame->rax = 0;
             return;
@@ -536,20 +926,23 @@ void syscall_handler(interrupt_frame_t* frame) {
         // Instead of busy-waiting, YIELD CPU to other processes!
         // This is the PRIMARY scheduling mechanism - not timer preemption!
 
-        kprintf("[SYSCALL] Workflow not ready - COOPERATIVE YIELD (event-driven scheduling)\n");
-
-        // Mark process as WAITING (so it won't be re-scheduled yet)
-        proc->state = PROCESS_STATE_WAITING;
-
-        // Save workflow ID so completion IRQ knows which process to wake
-        proc->current_workflow_id = workflow_id;
+        // Mark process as WAITING and queue it under (pid, workflow_id):
+        // completion IRQ wakes only the process whose result landed
+        extern int scheduler_wait_enqueue(process_t* proc, uint64_t workflow_id);
+        if (!scheduler_wait_enqueue(proc, workflow_id)) {
+            TRACE_INFO(TRACE_SYSCALL_WAKE, proc->pid, workflow_id);  // Completed while queueing
+            atomic_store_u32(&proc->completion_ready, 0);  // Clear for next time
+            frame->rax = 0;
+            return;
+        }
 
         // YIELD CPU - let other processes run while we wait for event
+        TRACE_INFO(TRACE_SYSCALL_WAIT, proc->pid, workflow_id);
         extern void scheduler_yield_cooperative(interrupt_frame_t* frame);
         scheduler_yield_cooperative(frame);
 
         // When we return here, completion IRQ has woken us up!
-        kprintf("[SYSCALL] Woke up from WAIT - workflow %lu completed\n", workflow_id);
+        TRACE_INFO(TRACE_SYSCALL_WAKE, proc->pid, workflow_id);
         atomic_store_u32(&proc->completion_ready, 0);  // Clear for next time
         frame->rax = 0;  // Success
         return;
@@ -563,7 +956,7 @@ void syscall_handler(interrupt_frame_t* frame) {
         Workflow* workflow = workflow_get(workflow_id);
 
         if (!workflow) {
-            kprintf("[SYSCALL] ERROR: Workflow ID=%lu not found\n", workflow_id);
+            TRACE_INFO(TRACE_SYSCALL_BAD_WORKFLOW, proc->pid, workflow_id);
             frame->rax = (uint64_t)-1;
             return;
         }
@@ -582,7 +975,7 @@ void syscall_handler(interrupt_frame_t* frame) {
     // ========================================================================
 
     if (flags & NOTIFY_YIELD) {
-        kprintf("[SYSCALL] kernel_notify(YIELD) - explicit cooperative yield\n");
+        TRACE_INFO(TRACE_SYSCALL_YIELD, proc->pid, 0);
 
         // Explicitly give up CPU to other processes
         // This allows well-behaved processes to voluntarily yield
@@ -592,7 +985,6 @@ void syscall_handler(interrupt_frame_t* frame) {
         scheduler_yield_cooperative(frame);
 
         // When we return here, scheduler has run other processes
-        kprintf("[SYSCALL] Resumed after YIELD\n");
         frame->rax = 0;  // Success
         return;
     }
@@ -628,47 +1020,102 @@ void syscall_handler(interrupt_frame_t* frame) {
 }
 
 // ============================================================================
-// COMPLETION IRQ HANDLER - Workflow completion notification
+// SYSCALL/SYSRET FAST PATH
 // ============================================================================
+//
+// kernel_notify через инструкцию SYSCALL: без IDT dispatch и iretq (выход -
+// SYSRET, см. syscall_entry в isr.asm). Регистровый ABI тот же, что у
+// int 0x80 - RDI = workflow_id, RSI = flags, RDX = arg, RAX = результат -
+// плюс RCX/R11 портятся. int 0x80 остаётся для совместимости.
+//
+// Горячие режимы - ровно один флаг, без kprintf и разбора остальных:
+//   SUBMIT             - ingestion EventRing
+//   POLL               - состояние workflow
+//   WAIT               - результат уже пришёл (иначе - общий путь с yield)
+//   YIELD              - сразу в scheduler
+// Всё остальное (и любые ошибки - ради диагностики) - syscall_handler.
+
+void syscall_fast_init(void) {
+    extern void syscall_entry(void);
+
+    cpu_write_msr(MSR_EFER, cpu_read_msr(MSR_EFER) | EFER_SCE);
+    // SYSRET: SS = base + 8, CS = base + 16 (RPL 3) -> GDT_USER_DATA / GDT_USER_CODE
+    cpu_write_msr(MSR_STAR, ((uint64_t)(GDT_USER_DATA - 8 - 3) << 48) |
+                            ((uint64_t)GDT_KERNEL_CODE << 32));
+    cpu_write_msr(MSR_LSTAR, (uint64_t)syscall_entry);
+    cpu_write_msr(MSR_SFMASK, SYSCALL_RFLAGS_MASK);
+
+    kprintf("[IDT] SYSCALL/SYSRET fast path enabled (LSTAR=0x%p)\n", (void*)syscall_entry);
+}
 
-void completion_irq_handler(interrupt_frame_t* frame) {
-    // Workflow completion notification from Execution Deck
-    // This IRQ wakes up processes waiting in kernel_notify(WAIT)
+void syscall_fast_handler(interrupt_frame_t* frame) {
+    process_t* proc = process_get_current();
+
+    if (!proc || !proc->event_ring || !proc->result_ring || proc->result_overflow_count > 0) {
+        syscall_handler(frame);
+        return;
+    }
 
-    kprintf("[COMPLETION_IRQ] Workflow completion - waking waiting processes\n");
+    uint64_t workflow_id = frame->rdi;
 
-    // EVENT-DRIVEN INNOVATION: Wake up ALL waiting processes!
-    // Each process will check its completion_ready flag
-    // This is cooperative scheduling in action!
+    switch (frame->rsi) {
+        case NOTIFY_SUBMIT: {
+            proc->last_syscall_tick = scheduler_stats.total_ticks;
+            proc->syscall_count++;
 
-    // Get current running process
-    process_t* current = process_get_current();
+            uint64_t processed = syscall_ingest_event_ring(proc, workflow_id);
+            TRACE_INFO(TRACE_SYSCALL_SUBMIT, proc->pid, processed);
+            frame->rax = processed;
+            return;
+        }
+
+        case NOTIFY_POLL: {
+            Workflow* workflow = workflow_get(workflow_id);
+            if (!workflow) {
+                break;
+            }
+            proc->last_syscall_tick = scheduler_stats.total_ticks;
+            proc->syscall_count++;
+            frame->rax = workflow->state == WORKFLOW_STATE_COMPLETED ? 0 : 1;
+            return;
+        }
+
+        case NOTIFY_WAIT:
+            if (!atomic_load_u32(&proc->completion_ready) || !workflow_get(workflow_id)) {
+                break;
+            }
+            proc->last_syscall_tick = scheduler_stats.total_ticks;
+            proc->syscall_count++;
+            atomic_store_u32(&proc->completion_ready, 0);
+            frame->rax = 0;
+            return;
 
-    // Set completion flag for current process (if any)
-    if (current) {
-        atomic_store_u32(&current->completion_ready, 1);
-        kprintf("[COMPLETION_IRQ] Marked current PID=%lu as completed\n", current->pid);
+        case NOTIFY_YIELD:
+            proc->last_syscall_tick = scheduler_stats.total_ticks;
+            proc->syscall_count++;
+            scheduler_yield_cooperative(frame);
+            frame->rax = 0;
+            return;
     }
 
-    // Wake up ALL waiting processes by adding them to ready queue
-    // They will check their completion_ready flag when scheduled
-    extern void scheduler_add_process(process_t* proc);
-    extern process_t* process_get_by_index(int index);
+    syscall_handler(frame);
+}
 
-    int woken = 0;
-    for (int i = 0; i < PROCESS_MAX_COUNT; i++) {
-        process_t* proc = process_get_by_index(i);
+// ============================================================================
+// COMPLETION IRQ HANDLER - Workflow completion notification
+// ============================================================================
 
-        if (proc && proc->state == PROCESS_STATE_WAITING) {
-            // Wake up this process!
-            scheduler_add_process(proc);
-            woken++;
-            kprintf("[COMPLETION_IRQ] Woke PID=%lu from WAITING\n", proc->pid);
-        }
-    }
+void completion_irq_handler(interrupt_frame_t* frame) {
+    // Workflow completion notification from Execution Deck
+    // Execution Deck уже выставил completion_ready получателям и
+    // записал ключи (pid, workflow_id) через scheduler_notify_completion()
+
+    // Targeted wakeup: только процессы, чей результат попал в их ResultRing
+    extern int scheduler_wake_pending(void);
+    int woken = scheduler_wake_pending();
 
     if (woken > 0) {
-        kprintf("[COMPLETION_IRQ] Total processes woken: %d\n", woken);
+        TRACE_INFO(TRACE_COMPLETION_IRQ, woken, 0);
     }
 
     // No EOI needed - this is a software interrupt
@@ -15,9 +15,20 @@
 // System call vector
 #define SYSCALL_VECTOR          0x80  // INT 0x80 - kernel_notify()
 
+// SYSCALL/SYSRET - быстрый kernel_notify (syscall_entry в isr.asm)
+#define MSR_EFER                0xC0000080
+#define MSR_STAR                0xC0000081  // [47:32] kernel CS, [63:48] база user SS/CS
+#define MSR_LSTAR               0xC0000082  // RIP входа
+#define MSR_SFMASK              0xC0000084  // Сбрасываемые биты RFLAGS
+#define EFER_SCE                (1ULL << 0)
+#define SYSCALL_RFLAGS_MASK     0x47700     // TF, IF, DF, IOPL, NT, AC
+
 // Workflow completion notification
 #define COMPLETION_IRQ_VECTOR   0x81  // INT 0x81 - workflow completion
 
+// LAPIC timer BSP (clock events, clock.h) - сразу за IRQ 0-15
+#define LAPIC_TIMER_VECTOR      0x30  // INT 0x30 - tickless timer / kick IPI
+
 // Исключения CPU (0-31)
 #define EXCEPTION_DIVIDE_ERROR      0
 #define EXCEPTION_DEBUG             1
@@ -95,6 +106,10 @@ void idt_test(void);
 void exception_handler(interrupt_frame_t* frame);
 void irq_handler(interrupt_frame_t* frame);
 void syscall_handler(interrupt_frame_t* frame);
+void syscall_fast_handler(interrupt_frame_t* frame);
+
+// MSR SYSCALL/SYSRET на текущем CPU (BSP - user-код только там)
+void syscall_fast_init(void);
 
 // Внешние ASM обработчики (объявляем как массив)
 extern void* isr_table[IDT_ENTRIES];
@@ -87,12 +87,20 @@ IRQ 13, 45      ; FPU
 IRQ 14, 46      ; ATA Primary
 IRQ 15, 47      ; ATA Secondary
 
+; LAPIC timer (vector 48) - EOI в LAPIC, не в PIC (irq_handler)
+IRQ 16, 48      ; LAPIC timer / kick IPI
+
 ; System call (INT 0x80)
 ISR_NOERROR 128  ; kernel_notify syscall
 
 ; Completion IRQ (INT 0x81)
 ISR_NOERROR 129  ; workflow completion notification
 
+; LAPIC spurious interrupt (vector 0xFF) - EOI не нужен, регистры не трогаем
+global lapic_spurious_isr
+lapic_spurious_isr:
+    iretq
+
 ; Общий обработчик прерываний
 isr_common:
     ; Сохраняем все регистры в том же порядке что и в struct
@@ -166,7 +174,17 @@ isr_common:
     ; Восстанавливаем выравнивание стека
     pop rax
     add rsp, rax
-    
+
+; Общий выход через iretq (frame на вершине стека) - и для SYSCALL entry
+extern fpu_ts_rearm_pending
+extern fpu_return_check
+
+isr_restore:
+    ; Kernel-mode #NM снял CR0.TS: вернуть TS до выхода в user (fpu.c)
+    cmp qword [rel fpu_ts_rearm_pending], 0
+    jne .fpu_rearm
+
+.restore_regs:
     ; Восстанавливаем регистры в обратном порядке
     pop r15
     pop r14
@@ -190,6 +208,125 @@ isr_common:
     ; Возвращаемся из прерывания
     iretq
 
+.fpu_rearm:
+    mov rdi, [rsp + FRAME_CS]
+    mov rax, rsp
+    and rax, 15
+    sub rsp, rax
+    push rax
+    call fpu_return_check
+    pop rax
+    add rsp, rax
+    jmp .restore_regs
+
+; ============================================================================
+; SYSCALL entry (MSR LSTAR) - kernel_notify без IDT и iretq
+; ============================================================================
+; CPU при SYSCALL: RCX = user RIP, R11 = user RFLAGS, IF/TF/DF/AC сброшены
+; (SFMASK), CS/SS - kernel из STAR, стек НЕ переключён. Строим тот же
+; interrupt_frame_t, что int 0x80 (vector 128): handler, yield и
+; переключение процессов не знают, каким путём вошли.
+;
+; User-код выполняется только на BSP - scratch для user RSP один (IF=0).
+;
+; Выход - SYSRET, если возвращаемся ровно туда, откуда пришли (CS/SS user,
+; RCX == RIP, R11 == RFLAGS, RIP канонический - иначе SYSRET #GP в ring 0).
+; Иначе (переключились на другой процесс) - iretq через isr_restore.
+
+USER_DATA_SEL equ 0x1B          ; GDT_USER_DATA
+USER_CODE_SEL equ 0x23          ; GDT_USER_CODE
+
+; Смещения в interrupt_frame_t
+FRAME_R11    equ 4*8
+FRAME_RCX    equ 12*8
+FRAME_RIP    equ 17*8
+FRAME_CS     equ 18*8
+FRAME_RFLAGS equ 19*8
+FRAME_RSP    equ 20*8
+FRAME_SS     equ 21*8
+
+extern tss_syscall_rsp0
+extern syscall_fast_handler
+
+global syscall_entry
+syscall_entry:
+    mov [rel syscall_user_rsp], rsp
+    mov rsp, [rel tss_syscall_rsp0]
+
+    ; То, что CPU кладёт при int 0x80, и ISR_NOERROR 128
+    push USER_DATA_SEL                  ; ss
+    push qword [rel syscall_user_rsp]   ; rsp
+    push r11                            ; rflags
+    push USER_CODE_SEL                  ; cs
+    push rcx                            ; rip
+    push 0                              ; error code
+    push 128                            ; vector
+
+    push rax
+    push rbx
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push rbp
+    push r8
+    push r9
+    push r10
+    push r11
+    push r12
+    push r13
+    push r14
+    push r15
+
+    mov rdi, rsp
+
+    ; Выравнивание - как в isr_common
+    mov rax, rsp
+    and rax, 15
+    sub rsp, rax
+    push rax
+
+    call syscall_fast_handler
+
+    pop rax
+    add rsp, rax
+
+    ; TS после kernel-mode #NM возвращает только медленный путь
+    cmp qword [rel fpu_ts_rearm_pending], 0
+    jne isr_restore
+    cmp qword [rsp + FRAME_CS], USER_CODE_SEL
+    jne isr_restore
+    cmp qword [rsp + FRAME_SS], USER_DATA_SEL
+    jne isr_restore
+    mov rax, [rsp + FRAME_RIP]
+    cmp rax, [rsp + FRAME_RCX]
+    jne isr_restore
+    shr rax, 47
+    jnz isr_restore
+    mov rax, [rsp + FRAME_RFLAGS]
+    cmp rax, [rsp + FRAME_R11]
+    jne isr_restore
+
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rbp
+    pop rdi
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rbx
+    pop rax
+
+    ; Теперь [rsp] = vector: user RSP на 5 слотов выше
+    mov rsp, [rsp + FRAME_RSP - 15*8]
+    o64 sysret
+
 ; Таблица указателей на ISR (256 элементов)
 section .data
 isr_table:
@@ -201,11 +338,18 @@ isr_table:
     ; IRQs (32-47)
     dq irq0, irq1, irq2, irq3, irq4, irq5, irq6, irq7
     dq irq8, irq9, irq10, irq11, irq12, irq13, irq14, irq15
-    ; Unimplemented (48-127) - use GPF handler
-    times 80 dq isr13
+    ; LAPIC timer (48)
+    dq irq16
+    ; Unimplemented (49-127) - use GPF handler
+    times 79 dq isr13
     ; Syscall (128)
     dq isr128
     ; Completion IRQ (129)
     dq isr129
     ; Unimplemented (130-255) - use GPF handler
-    times 126 dq isr13
\ No newline at end of file
+    times 126 dq isr13
+
+; User RSP на время входа в SYSCALL entry (до переключения на kernel стек)
+section .bss
+syscall_user_rsp:
+    resq 1
@@ -37,6 +37,22 @@ static inline void outl(uint16_t port, uint32_t val) {
 
 // ========== MMIO ==========
 
+static inline uint8_t mmio_read8(uintptr_t addr) {
+    return *((volatile uint8_t*)addr);
+}
+
+static inline void mmio_write8(uintptr_t addr, uint8_t value) {
+    *((volatile uint8_t*)addr) = value;
+}
+
+static inline uint16_t mmio_read16(uintptr_t addr) {
+    return *((volatile uint16_t*)addr);
+}
+
+static inline void mmio_write16(uintptr_t addr, uint16_t value) {
+    *((volatile uint16_t*)addr) = value;
+}
+
 static inline uint32_t mmio_read32(uintptr_t addr) {
     return *((volatile uint32_t*)addr);
 }
@@ -0,0 +1,159 @@
+#include "bench.h"
+
+#ifdef USE_BENCH
+
+#include "clock.h"
+#include "serial.h"
+#include "io.h"
+#include "atomics.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+static uint64_t bench_series = 0;
+static uint64_t bench_failures = 0;
+
+// ============================================================================
+// OUTPUT (serial only, key=value)
+// ============================================================================
+
+static void bench_put_str(const char* key, const char* value) {
+    serial_print(" ");
+    serial_print(key);
+    serial_print("=");
+    serial_print(value);
+}
+
+static void bench_put_u64(const char* key, uint64_t value) {
+    char buf[24];
+    utoa64(value, buf, 10);
+    bench_put_str(key, buf);
+}
+
+static uint64_t bench_tsc_hz(void) {
+    return clock_tsc_hz() ? clock_tsc_hz() : CLOCK_TSC_HZ_FALLBACK;
+}
+
+// ============================================================================
+// SERIES
+// ============================================================================
+
+void bench_init(bench_t* b, const char* suite, const char* name, uint64_t iters) {
+    memset(b, 0, sizeof(bench_t));
+    b->suite = suite;
+    b->name = name;
+    b->iters = iters ? iters : 1;
+    b->min_round = ~0ULL;
+}
+
+uint64_t bench_round_begin(void) {
+    // lfence: предыдущие инструкции не попадают в раунд
+    asm volatile("lfence" ::: "memory");
+    return rdtsc();
+}
+
+void bench_round_end(bench_t* b, uint64_t start) {
+    asm volatile("lfence" ::: "memory");
+    uint64_t cycles = rdtsc() - start;
+
+    b->cycles += cycles;
+    b->rounds++;
+    if (cycles < b->min_round) {
+        b->min_round = cycles;
+    }
+}
+
+void bench_report(bench_t* b) {
+    if (b->rounds == 0) {
+        bench_fail(b->suite, b->name, "no_rounds");
+        return;
+    }
+
+    uint64_t ops = b->iters * b->rounds;
+    uint64_t per_op = b->cycles / ops;
+
+    serial_print("BENCH");
+    bench_put_str("suite", b->suite);
+    bench_put_str("name", b->name);
+    bench_put_u64("ops", ops);
+    bench_put_u64("cycles", b->cycles);
+    bench_put_u64("cycles_per_op", per_op);
+    bench_put_u64("min_cycles_per_op", b->min_round / b->iters);
+    bench_put_u64("ns_per_op", per_op * 1000000000ULL / bench_tsc_hz());
+    if (b->bytes && b->cycles) {
+        // bytes * hz < 2^64 при раундах до нескольких MB
+        bench_put_u64("mb_per_sec", b->bytes * b->rounds * bench_tsc_hz() / b->cycles / 1000000);
+    }
+    serial_print("\n");
+
+    bench_series++;
+}
+
+void bench_skip(const char* suite, const char* reason) {
+    serial_print("BENCH skip");
+    bench_put_str("suite", suite);
+    bench_put_str("reason", reason);
+    serial_print("\n");
+}
+
+void bench_fail(const char* suite, const char* name, const char* reason) {
+    serial_print("BENCH fail");
+    bench_put_str("suite", suite);
+    bench_put_str("name", name);
+    bench_put_str("reason", reason);
+    serial_print("\n");
+
+    bench_failures++;
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static __attribute__((noreturn)) void bench_exit(int ok) {
+    serial_flush();
+
+    // QEMU с isa-debug-exit выходит здесь; на железе - просто стоим
+    outl(BENCH_EXIT_PORT, ok ? BENCH_EXIT_OK : BENCH_EXIT_FAILED);
+
+    kprintf_mute(0);
+    kprintf("[BENCH] Done (%s) - halting\n", ok ? "ok" : "failed");
+    asm volatile("cli");
+    while (1) {
+        asm volatile("hlt");
+    }
+}
+
+void bench_run_all(void) {
+    kprintf("[BENCH] Running microbenchmarks (results on serial)...\n");
+
+    serial_print("BENCH begin");
+    bench_put_u64("version", BENCH_VERSION);
+    bench_put_u64("tsc_khz", bench_tsc_hz() / 1000);
+    bench_put_u64("rounds", BENCH_ROUNDS);
+    serial_print("\n");
+
+    kprintf_mute(1);
+
+    bench_suite_ring();
+    bench_suite_routing();
+    bench_suite_guide();
+    bench_suite_decks();
+    bench_suite_memory();
+    bench_suite_tagfs();
+    bench_suite_ata();
+
+    kprintf_mute(0);
+
+    serial_print("BENCH end");
+    bench_put_str("status", bench_failures ? "failed" : "ok");
+    bench_put_u64("series", bench_series);
+    bench_put_u64("failures", bench_failures);
+    serial_print("\n");
+
+    bench_exit(bench_failures == 0);
+}
+
+#endif // USE_BENCH
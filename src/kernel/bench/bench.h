@@ -0,0 +1,79 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// BENCH - встроенные microbenchmarks (сборка с -DUSE_BENCH, `make bench`)
+// ============================================================================
+//
+// Kernel после init (до SMP и sti, один CPU, IF=0) прогоняет suites и
+// выходит из QEMU через isa-debug-exit. Каждая серия - BENCH_ROUNDS раундов
+// по iters операций, раунд целиком под RDTSC (без rdtsc на каждую операцию -
+// ring push/pop стоит меньше, чем сам rdtsc).
+//
+// Вывод - только serial, по строке на серию (kprintf на время прогона
+// заглушён - decks логируют каждое событие):
+//
+//   BENCH begin version=1 tsc_khz=2995200
+//   BENCH suite=ring name=event_push_pop ops=32768 cycles=393216 cycles_per_op=12 min_cycles_per_op=11 ns_per_op=4
+//   BENCH suite=ata name=read_blocks ops=64 ... mb_per_sec=412
+//   BENCH skip suite=ata reason=no_device
+//   BENCH end status=ok series=27
+//
+// Поля только дописываются - скрипты сравнения между релизами парсят key=value.
+//
+// ============================================================================
+
+#define BENCH_VERSION       1
+#define BENCH_ROUNDS        8
+
+// isa-debug-exit (make bench): QEMU выходит с кодом (value << 1) | 1
+#define BENCH_EXIT_PORT     0xF4
+#define BENCH_EXIT_OK       0x10        // exit 33
+#define BENCH_EXIT_FAILED   0x11        // exit 35
+
+typedef struct {
+    const char* suite;
+    const char* name;
+    uint64_t iters;             // Операций в раунде
+    uint64_t rounds;
+    uint64_t cycles;            // Сумма по раундам
+    uint64_t min_round;         // Самый быстрый раунд
+    uint64_t bytes;             // Байт за раунд (0 = без mb_per_sec)
+} bench_t;
+
+// Серия suite/name по iters операций в раунде
+void bench_init(bench_t* b, const char* suite, const char* name, uint64_t iters);
+
+// Начало раунда (serializing rdtsc)
+uint64_t bench_round_begin(void);
+
+// Конец раунда, начатого в start
+void bench_round_end(bench_t* b, uint64_t start);
+
+// Строка результата в serial
+void bench_report(bench_t* b);
+
+// Серия не выполнялась (нет устройства и т.п.)
+void bench_skip(const char* suite, const char* reason);
+
+// Серия сломалась - итог прогона станет status=failed
+void bench_fail(const char* suite, const char* name, const char* reason);
+
+// Все suites, затем выход из QEMU. Не возвращается
+__attribute__((noreturn)) void bench_run_all(void);
+
+// ============================================================================
+// SUITES (bench_suites.c)
+// ============================================================================
+
+void bench_suite_ring(void);        // EventRingBuffer, DeckQueue, ResultRing
+void bench_suite_routing(void);     // global_routing_table insert/lookup/remove
+void bench_suite_guide(void);       // mark_ready + dispatch в DeckQueue
+void bench_suite_decks(void);       // process функция каждого deck
+void bench_suite_memory(void);      // kmalloc, pmm, vmalloc, memcpy/memset
+void bench_suite_tagfs(void);       // create/read/query
+void bench_suite_ata(void);         // Block transfer
+
+#endif // BENCH_H
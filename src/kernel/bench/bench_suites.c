@@ -0,0 +1,668 @@
+#include "bench.h"
+
+#ifdef USE_BENCH
+
+#include "ringbuffer.h"
+#include "workflow_rings.h"
+#include "routing_table.h"
+#include "routing_pool.h"
+#include "guide.h"
+#include "deck_interface.h"
+#include "result_buffer.h"
+#include "tagfs.h"
+#include "ata.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "klib.h"
+
+#define BENCH_PAGES(bytes)      (((bytes) + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE)
+
+// event_id бенчмарков - вне диапазона global_event_id_counter
+#define BENCH_EVENT_ID_BASE     (1ULL << 60)
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+// Entry вне routing table: ready_queued = 1, чтобы deck_complete() и
+// routing_table_link_entry() не ставили его в настоящую ready queue
+static void bench_entry_reset(RoutingEntry* entry, uint8_t prefix, uint32_t type) {
+    entry->state = EVENT_STATUS_PROCESSING;
+    entry->abort_flag = 0;
+    entry->completion_flags = 0;
+    entry->ready_queued = 1;
+    entry->error_code = 0;
+    entry->current_index = 0;
+    entry->fusion_budget = 0;
+    entry->fusion_pending = 0;
+    entry->deck_step = 0;
+    entry->priority = EVENT_PRIORITY_NORMAL;
+    entry->prefixes[0] = prefix;
+    entry->payload = entry->event_copy.data;
+    entry->payload_size = EVENT_DATA_SIZE;
+    entry->event_copy.type = type;
+}
+
+// Результаты decks - как Execution Deck после публикации
+static void bench_entry_drop_results(RoutingEntry* entry) {
+    for (int i = 0; i < MAX_ROUTING_STEPS; i++) {
+        if (entry->deck_results[i]) {
+            if (entry->result_types[i] == RESULT_TYPE_KMALLOC) {
+                kfree(entry->deck_results[i]);
+            } else if (entry->result_types[i] == RESULT_TYPE_BUFFER) {
+                result_buffer_release((ResultBuffer*)entry->deck_results[i]);
+            }
+        }
+        entry->deck_results[i] = 0;
+        entry->result_types[i] = RESULT_TYPE_NONE;
+    }
+}
+
+// ============================================================================
+// RING BUFFERS
+// ============================================================================
+
+#define BENCH_RING_ITERS 4096
+
+static DeckQueue bench_deck_queue;
+static RoutingEntry bench_deck_token;   // Push читает entry->priority (lane)
+
+void bench_suite_ring(void) {
+    bench_t b;
+
+    // EventRingBuffer: push + pop одного Event (256 байт туда и обратно)
+    uint64_t event_pages = BENCH_PAGES(sizeof(EventRingBuffer));
+    EventRingBuffer* events = (EventRingBuffer*)pmm_alloc_zero(event_pages);
+    if (events) {
+        Event in, out;
+        event_init(&in, EVENT_NONE, 1);
+        event_ring_init(events);
+
+        bench_init(&b, "ring", "event_push_pop", BENCH_RING_ITERS);
+        for (int r = 0; r < BENCH_ROUNDS; r++) {
+            uint64_t t = bench_round_begin();
+            for (uint64_t i = 0; i < b.iters; i++) {
+                in.id = i;
+                event_ring_push(events, &in);
+                event_ring_pop(events, &out);
+            }
+            bench_round_end(&b, t);
+        }
+        if (out.id != BENCH_RING_ITERS - 1) {
+            bench_fail("ring", "event_push_pop", "lost_event");
+        } else {
+            bench_report(&b);
+        }
+        pmm_free(events, event_pages);
+    } else {
+        bench_fail("ring", "event_push_pop", "no_memory");
+    }
+
+    // DeckQueue: Guide -> deck (указатели на RoutingEntry)
+    deck_queue_init(&bench_deck_queue);
+    RoutingEntry* token = &bench_deck_token;
+    token->priority = EVENT_PRIORITY_NORMAL;
+    RoutingEntry* popped = 0;
+
+    bench_init(&b, "ring", "deck_queue_push_pop", BENCH_RING_ITERS);
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            deck_queue_push(&bench_deck_queue, token);
+            popped = deck_queue_pop(&bench_deck_queue);
+        }
+        bench_round_end(&b, t);
+    }
+    if (popped != token) {
+        bench_fail("ring", "deck_queue_push_pop", "lost_entry");
+    } else {
+        bench_report(&b);
+    }
+
+    // ResultRing: kernel push (576 байт) + user pop
+    uint64_t result_pages = BENCH_PAGES(sizeof(ResultRing));
+    ResultRing* results = (ResultRing*)pmm_alloc_zero(result_pages);
+    if (!results) {
+        bench_fail("ring", "result_push_pop", "no_memory");
+        return;
+    }
+
+    RingResult result;
+    memset(&result, 0, sizeof(result));
+    uint64_t last_id = 0;
+
+    bench_init(&b, "ring", "result_push_pop", BENCH_RING_ITERS);
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            result.event_id = i;
+            wf_result_ring_push(results, &result);
+            last_id = wf_result_ring_pop(results)->event_id;
+        }
+        bench_round_end(&b, t);
+    }
+    if (last_id != BENCH_RING_ITERS - 1) {
+        bench_fail("ring", "result_push_pop", "lost_result");
+    } else {
+        bench_report(&b);
+    }
+    pmm_free(results, result_pages);
+}
+
+// ============================================================================
+// ROUTING TABLE
+// ============================================================================
+
+// Больше начальных ROUTING_TABLE_SIZE * 4 слотов - первый раунд проходит resize
+#define BENCH_ROUTING_ENTRIES 1024
+
+static RoutingEntry* bench_routing_entries[BENCH_ROUTING_ENTRIES];
+
+void bench_suite_routing(void) {
+    RoutingTable* table = &global_routing_table;
+    bench_t insert, lookup, remove;
+    int failed = 0;
+
+    bench_init(&insert, "routing", "insert", BENCH_ROUTING_ENTRIES);
+    bench_init(&lookup, "routing", "lookup", BENCH_ROUTING_ENTRIES);
+    bench_init(&remove, "routing", "remove", BENCH_ROUTING_ENTRIES);
+
+    for (int r = 0; r < BENCH_ROUNDS && !failed; r++) {
+        uint64_t inserted = 0;
+
+        // Insert = entry из pool + link (как ingestion)
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < BENCH_ROUTING_ENTRIES; i++) {
+            RoutingEntry* entry = routing_table_alloc_entry();
+            if (!entry) {
+                break;
+            }
+            entry->event_id = BENCH_EVENT_ID_BASE + i;
+            entry->ready_queued = 1;
+            if (!routing_table_link_entry(table, entry)) {
+                routing_table_release_entry(entry, ROUTING_POOL_CACHE_GUIDE);
+                break;
+            }
+            bench_routing_entries[i] = entry;
+            inserted++;
+        }
+        bench_round_end(&insert, t);
+
+        if (inserted != BENCH_ROUTING_ENTRIES) {
+            bench_fail("routing", "insert", "table_full");
+            failed = 1;
+        }
+
+        // Lookup (lock-free путь decks и Execution)
+        uint64_t found = 0;
+        t = bench_round_begin();
+        for (uint64_t i = 0; i < inserted; i++) {
+            found += routing_table_lookup(table, BENCH_EVENT_ID_BASE + i) != 0;
+        }
+        bench_round_end(&lookup, t);
+
+        if (found != inserted && !failed) {
+            bench_fail("routing", "lookup", "missing_entry");
+            failed = 1;
+        }
+
+        // Remove = detach + возврат в pool
+        t = bench_round_begin();
+        for (uint64_t i = 0; i < inserted; i++) {
+            RoutingEntry* entry = routing_table_detach(table, BENCH_EVENT_ID_BASE + i);
+            routing_table_release_entry(entry, ROUTING_POOL_CACHE_GUIDE);
+        }
+        bench_round_end(&remove, t);
+    }
+
+    if (!failed) {
+        bench_report(&insert);
+        bench_report(&lookup);
+        bench_report(&remove);
+    }
+}
+
+// ============================================================================
+// GUIDE
+// ============================================================================
+
+// Меньше DECK_QUEUE_SIZE - dispatch не упирается в полную очередь deck
+#define BENCH_GUIDE_BATCH 64
+
+void bench_suite_guide(void) {
+    RoutingEntry* entries[BENCH_GUIDE_BATCH];
+    DeckQueue* queue = guide_get_deck_queue(DECK_PREFIX_NETWORK);
+    bench_t b;
+    int count = 0;
+
+    for (; count < BENCH_GUIDE_BATCH; count++) {
+        entries[count] = routing_table_alloc_entry();
+        if (!entries[count]) {
+            break;
+        }
+        entries[count]->event_id = BENCH_EVENT_ID_BASE + count;
+    }
+
+    if (count != BENCH_GUIDE_BATCH || !queue) {
+        bench_fail("guide", "dispatch", "no_memory");
+    } else {
+        // mark_ready + один проход dispatch: entry -> DeckQueue Network deck
+        // (до SMP её никто не разбирает - забираем сами, вне раунда)
+        bench_init(&b, "guide", "dispatch", BENCH_GUIDE_BATCH);
+        int lost = 0;
+
+        for (int r = 0; r < BENCH_ROUNDS; r++) {
+            for (int i = 0; i < count; i++) {
+                bench_entry_reset(entries[i], DECK_PREFIX_NETWORK, EVENT_NET_POLL);
+                entries[i]->ready_queued = 0;
+            }
+
+            uint64_t t = bench_round_begin();
+            for (int i = 0; i < count; i++) {
+                guide_mark_ready(entries[i]);
+            }
+            guide_dispatch_ready(&guide_context);
+            bench_round_end(&b, t);
+
+            int drained = 0;
+            while (deck_queue_pop(queue)) {
+                drained++;
+            }
+            lost += drained != count;
+        }
+
+        if (lost) {
+            bench_fail("guide", "dispatch", "entry_not_routed");
+        } else {
+            bench_report(&b);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        routing_table_release_entry(entries[i], ROUTING_POOL_CACHE_GUIDE);
+    }
+}
+
+// ============================================================================
+// DECKS
+// ============================================================================
+//
+// Process функция deck'а на одном entry: deck_complete() + освобождение
+// результата. Execution Deck не входит - ему нужен процесс-владелец с
+// ResultRing.
+//
+// ============================================================================
+
+#define BENCH_DECK_ITERS        1024
+#define BENCH_OP_HASH_CRC32     100     // EVENT_OP_HASH_CRC32 (operations_deck.c)
+#define BENCH_CRC32_BYTES       192
+
+extern int operations_deck_process(RoutingEntry* entry);
+extern int storage_deck_process(RoutingEntry* entry);
+extern int hardware_deck_process(RoutingEntry* entry);
+extern int network_deck_process(RoutingEntry* entry);
+
+static void bench_deck(RoutingEntry* entry, const char* name, uint8_t prefix,
+                       uint32_t type, DeckProcessFunc process, uint64_t iters) {
+    bench_t b;
+    bench_init(&b, "deck", name, iters);
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < iters; i++) {
+            bench_entry_reset(entry, prefix, type);
+            process(entry);
+            if (entry->abort_flag) {
+                break;
+            }
+            bench_entry_drop_results(entry);
+        }
+        bench_round_end(&b, t);
+
+        if (entry->abort_flag) {
+            bench_entry_drop_results(entry);
+            bench_fail("deck", name, "deck_error");
+            return;
+        }
+    }
+
+    bench_report(&b);
+}
+
+void bench_suite_decks(void) {
+    RoutingEntry* entry = routing_table_alloc_entry();
+    if (!entry) {
+        bench_fail("deck", "all", "no_memory");
+        return;
+    }
+    entry->event_id = BENCH_EVENT_ID_BASE;
+    uint8_t* payload = entry->event_copy.data;
+
+    // Operations: CRC32 по payload. Payload: [size:8][data:...]
+    memset(payload, 0, EVENT_DATA_SIZE);
+    *(uint64_t*)payload = BENCH_CRC32_BYTES;
+    for (int i = 0; i < BENCH_CRC32_BYTES; i++) {
+        payload[8 + i] = (uint8_t)(i * 31);
+    }
+    bench_deck(entry, "operations_crc32", DECK_PREFIX_OPERATIONS, BENCH_OP_HASH_CRC32,
+               operations_deck_process, BENCH_DECK_ITERS);
+
+    // Storage: TagFS query по одному тегу. Payload: [tag_count:4][operator:1][pad:3][tags...]
+    memset(payload, 0, EVENT_DATA_SIZE);
+    *(uint32_t*)payload = 1;
+    payload[4] = QUERY_OP_AND;
+    Tag tag = tagfs_tag_from_string("type:bench");
+    memcpy(payload + 8, &tag, sizeof(Tag));
+    bench_deck(entry, "storage_query", DECK_PREFIX_STORAGE, EVENT_FILE_QUERY,
+               storage_deck_process, BENCH_DECK_ITERS / 4);
+
+    // Hardware: getticks (без payload)
+    memset(payload, 0, EVENT_DATA_SIZE);
+    bench_deck(entry, "hardware_getticks", DECK_PREFIX_HARDWARE, EVENT_TIMER_GETTICKS,
+               hardware_deck_process, BENCH_DECK_ITERS);
+
+    // Network: poll (make bench без NIC - 0 кадров, стоимость самого шага)
+    bench_deck(entry, "network_poll", DECK_PREFIX_NETWORK, EVENT_NET_POLL,
+               network_deck_process, BENCH_DECK_ITERS);
+
+    routing_table_release_entry(entry, ROUTING_POOL_CACHE_GUIDE);
+}
+
+// ============================================================================
+// MEMORY
+// ============================================================================
+
+#define BENCH_MEM_ITERS     2048
+#define BENCH_MEM_BURST     256
+#define BENCH_VMALLOC_SIZE  (16 * 1024)
+
+static void* bench_mem_burst[BENCH_MEM_BURST];
+
+// memcpy/memset по size: mb_per_sec - главная цифра для больших копий
+static void bench_mem_copy(const char* name, uint8_t* dst, const uint8_t* src, size_t size) {
+    bench_t b;
+    bench_init(&b, "memory", name, BENCH_MEM_ITERS);
+    b.bytes = BENCH_MEM_ITERS * size;
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            memcpy(dst, src, size);
+            __asm__ volatile("" ::: "memory");
+        }
+        bench_round_end(&b, t);
+    }
+    bench_report(&b);
+}
+
+static void bench_mem_set(const char* name, uint8_t* dst, size_t size) {
+    bench_t b;
+    bench_init(&b, "memory", name, BENCH_MEM_ITERS);
+    b.bytes = BENCH_MEM_ITERS * size;
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            memset(dst, (int)i, size);
+            __asm__ volatile("" ::: "memory");
+        }
+        bench_round_end(&b, t);
+    }
+    bench_report(&b);
+}
+
+static void bench_kmalloc_pair(const char* name, size_t size) {
+    bench_t b;
+    bench_init(&b, "memory", name, BENCH_MEM_ITERS);
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            void* p = kmalloc(size);
+            if (!p) {
+                bench_fail("memory", name, "no_memory");
+                return;
+            }
+            kfree(p);
+        }
+        bench_round_end(&b, t);
+    }
+    bench_report(&b);
+}
+
+void bench_suite_memory(void) {
+    bench_t b;
+
+    bench_kmalloc_pair("kmalloc_free_64", 64);
+    bench_kmalloc_pair("kmalloc_free_4096", 4096);
+
+    // Burst: BENCH_MEM_BURST живых объектов - slab выходит за per-CPU cache
+    bench_init(&b, "memory", "kmalloc_burst_64", BENCH_MEM_BURST);
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (int i = 0; i < BENCH_MEM_BURST; i++) {
+            bench_mem_burst[i] = kmalloc(64);
+        }
+        for (int i = 0; i < BENCH_MEM_BURST; i++) {
+            kfree(bench_mem_burst[i]);
+        }
+        bench_round_end(&b, t);
+    }
+    bench_report(&b);
+
+    bench_init(&b, "memory", "pmm_alloc_free_1", BENCH_MEM_ITERS);
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            void* page = pmm_alloc(1);
+            if (!page) {
+                bench_fail("memory", "pmm_alloc_free_1", "no_memory");
+                return;
+            }
+            pmm_free(page, 1);
+        }
+        bench_round_end(&b, t);
+    }
+    bench_report(&b);
+
+    // Две страницы: src и dst, dst + 1 - невыровненная копия
+    uint8_t* pages = (uint8_t*)pmm_alloc_zero(2);
+    if (!pages) {
+        bench_fail("memory", "memcpy", "no_memory");
+        return;
+    }
+    uint8_t* src = pages;
+    uint8_t* dst = pages + PMM_PAGE_SIZE;
+    bench_mem_copy("memcpy_16", dst, src, 16);
+    bench_mem_copy("memcpy_256", dst, src, 256);
+    bench_mem_copy("memcpy_4096", dst, src, PMM_PAGE_SIZE);
+    bench_mem_copy("memcpy_4095_unaligned", dst + 1, src, PMM_PAGE_SIZE - 1);
+    bench_mem_set("memset_256", dst, 256);
+    bench_mem_set("memset_4096", dst, PMM_PAGE_SIZE);
+    pmm_free(pages, 2);
+
+    bench_init(&b, "memory", "vmalloc_vfree_16k", BENCH_MEM_ITERS / 8);
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            void* p = vmalloc(BENCH_VMALLOC_SIZE);
+            if (!p) {
+                bench_fail("memory", "vmalloc_vfree_16k", "no_memory");
+                return;
+            }
+            vfree(p);
+        }
+        bench_round_end(&b, t);
+    }
+    bench_report(&b);
+}
+
+// ============================================================================
+// TAGFS
+// ============================================================================
+
+#define BENCH_TAGFS_FILES       16
+#define BENCH_TAGFS_FILE_SIZE   4096
+#define BENCH_TAGFS_RESULTS     256
+
+static uint64_t bench_tagfs_inodes[BENCH_TAGFS_FILES];
+static uint64_t bench_tagfs_results[BENCH_TAGFS_RESULTS];
+
+void bench_suite_tagfs(void) {
+    bench_t create, read, query;
+    Tag tags[2];
+    tags[0] = tagfs_tag_from_string("type:bench");
+    tags[1] = tagfs_tag_from_string("bench:tagfs");
+
+    uint8_t* data = (uint8_t*)kmalloc(BENCH_TAGFS_FILE_SIZE);
+    uint8_t* buf = (uint8_t*)kmalloc(BENCH_TAGFS_FILE_SIZE);
+    if (!data || !buf) {
+        bench_fail("tagfs", "all", "no_memory");
+        kfree(data);
+        kfree(buf);
+        return;
+    }
+    for (int i = 0; i < BENCH_TAGFS_FILE_SIZE; i++) {
+        data[i] = (uint8_t)i;
+    }
+
+    bench_init(&create, "tagfs", "create_4k", BENCH_TAGFS_FILES);
+    bench_init(&read, "tagfs", "read_4k", BENCH_TAGFS_FILES);
+    bench_init(&query, "tagfs", "query_and", BENCH_TAGFS_FILES);
+    create.bytes = BENCH_TAGFS_FILES * BENCH_TAGFS_FILE_SIZE;
+    read.bytes = BENCH_TAGFS_FILES * BENCH_TAGFS_FILE_SIZE;
+
+    const char* failure = 0;
+
+    for (int r = 0; r < BENCH_ROUNDS && !failure; r++) {
+        int created = 0;
+
+        uint64_t t = bench_round_begin();
+        for (; created < BENCH_TAGFS_FILES; created++) {
+            bench_tagfs_inodes[created] = tagfs_create_file_with_data(tags, 2, data,
+                                                                      BENCH_TAGFS_FILE_SIZE);
+            if (bench_tagfs_inodes[created] == TAGFS_INVALID_INODE) {
+                break;
+            }
+        }
+        bench_round_end(&create, t);
+
+        if (created != BENCH_TAGFS_FILES) {
+            failure = "create_failed";
+        }
+
+        int short_reads = 0;
+        t = bench_round_begin();
+        for (int i = 0; i < created; i++) {
+            short_reads += tagfs_read_file(bench_tagfs_inodes[i], 0, buf,
+                                           BENCH_TAGFS_FILE_SIZE) != BENCH_TAGFS_FILE_SIZE;
+        }
+        bench_round_end(&read, t);
+
+        if (short_reads && !failure) {
+            failure = "short_read";
+        }
+
+        uint32_t matched = 0;
+        t = bench_round_begin();
+        for (int i = 0; i < BENCH_TAGFS_FILES; i++) {
+            TagQuery q;
+            q.tags = tags;
+            q.tag_count = 2;
+            q.op = QUERY_OP_AND;
+            q.result_inodes = bench_tagfs_results;
+            q.result_count = 0;
+            q.result_capacity = BENCH_TAGFS_RESULTS;
+            tagfs_query(&q);
+            matched = q.result_count;
+        }
+        bench_round_end(&query, t);
+
+        if (matched < (uint32_t)created && !failure) {
+            failure = "query_missed_files";
+        }
+
+        // Вне раунда: следующий раунд начинает с той же ФС
+        for (int i = 0; i < created; i++) {
+            tagfs_erase_file(bench_tagfs_inodes[i]);
+        }
+    }
+
+    if (failure) {
+        bench_fail("tagfs", "all", failure);
+    } else {
+        bench_report(&create);
+        bench_report(&read);
+        bench_report(&query);
+    }
+
+    kfree(data);
+    kfree(buf);
+}
+
+// ============================================================================
+// ATA (block interface: virtio-blk / AHCI / IDE)
+// ============================================================================
+
+#define BENCH_ATA_SINGLE_ITERS  64
+#define BENCH_ATA_BULK_ITERS    8
+#define BENCH_ATA_BULK_BLOCKS   32      // 128KB - одна команда и на LBA28
+#define BENCH_ATA_SPAN_BLOCKS   1024    // Читаем первые 4MB диска
+
+void bench_suite_ata(void) {
+    uint32_t max_blocks = ata_max_transfer_blocks();
+    if (max_blocks == 0) {
+        bench_skip("ata", "no_device");
+        return;
+    }
+    uint32_t bulk = max_blocks < BENCH_ATA_BULK_BLOCKS ? max_blocks : BENCH_ATA_BULK_BLOCKS;
+
+    // DMA: буфер физически смежный
+    uint8_t* buf = (uint8_t*)pmm_alloc(bulk);
+    if (!buf) {
+        bench_fail("ata", "all", "no_memory");
+        return;
+    }
+
+    bench_t b;
+    int errors = 0;
+
+    // Один блок TagFS (4KB) на команду - латентность
+    bench_init(&b, "ata", "read_block", BENCH_ATA_SINGLE_ITERS);
+    b.bytes = BENCH_ATA_SINGLE_ITERS * PMM_PAGE_SIZE;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            uint32_t block = (uint32_t)((r * b.iters + i) % BENCH_ATA_SPAN_BLOCKS);
+            errors += ata_read_blocks(block, 1, buf) != 0;
+        }
+        bench_round_end(&b, t);
+    }
+    if (errors) {
+        bench_fail("ata", "read_block", "io_error");
+    } else {
+        bench_report(&b);
+    }
+
+    // Bulk - пропускная способность
+    errors = 0;
+    bench_init(&b, "ata", "read_blocks", BENCH_ATA_BULK_ITERS);
+    b.bytes = (uint64_t)BENCH_ATA_BULK_ITERS * bulk * PMM_PAGE_SIZE;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t = bench_round_begin();
+        for (uint64_t i = 0; i < b.iters; i++) {
+            uint32_t block = (uint32_t)(((r * b.iters + i) * bulk) % BENCH_ATA_SPAN_BLOCKS);
+            errors += ata_read_blocks(block, bulk, buf) != 0;
+        }
+        bench_round_end(&b, t);
+    }
+    if (errors) {
+        bench_fail("ata", "read_blocks", "io_error");
+    } else {
+        bench_report(&b);
+    }
+
+    pmm_free(buf, bulk);
+}
+
+#endif // USE_BENCH
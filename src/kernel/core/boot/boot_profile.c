@@ -0,0 +1,98 @@
+#include "boot_profile.h"
+#include "atomics.h"
+#include "clock.h"
+#include "klib.h"
+
+typedef struct {
+    const char* name;
+    uint64_t tsc;
+} boot_mark_t;
+
+static boot_mark_t boot_marks[BOOT_PROFILE_MAX_MARKS];
+static uint32_t boot_mark_count = 0;
+static uint32_t boot_marks_dropped = 0;
+
+// Порядок - как BOOT_STAMP в stage2.asm
+static const char* boot_stage2_names[BOOT_STAGE2_STAMPS] = {
+    "stage2.entry",
+    "stage2.a20",
+    "stage2.e820",
+    "stage2.kernel_load",
+    "stage2.cpu_check",
+    "stage2.long_mode",
+};
+
+static void boot_mark_at(const char* name, uint64_t tsc) {
+    if (boot_mark_count >= BOOT_PROFILE_MAX_MARKS) {
+        boot_marks_dropped++;
+        return;
+    }
+    boot_marks[boot_mark_count].name = name;
+    boot_marks[boot_mark_count].tsc = tsc;
+    boot_mark_count++;
+}
+
+void boot_profile_init(void) {
+    uint64_t now = rdtsc();
+    const uint8_t* info = (const uint8_t*)BOOT_INFO_ADDR;
+
+    // Старый stage2 (без stamps) - профиль начинается с kernel_main
+    if (*(const uint32_t*)(info + BOOT_INFO_TSC_MAGIC_OFFSET) == BOOT_INFO_TSC_MAGIC) {
+        uint32_t count = *(const uint32_t*)(info + BOOT_INFO_TSC_COUNT_OFFSET);
+        const uint64_t* stamps = (const uint64_t*)(info + BOOT_INFO_TSC_OFFSET);
+
+        if (count > BOOT_STAGE2_STAMPS) {
+            count = BOOT_STAGE2_STAMPS;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            // TSC не должен идти назад - иначе stamp мусор
+            if (stamps[i] == 0 || stamps[i] > now) {
+                break;
+            }
+            boot_mark_at(boot_stage2_names[i], stamps[i]);
+        }
+    }
+
+    // Вход + обнуление BSS (kernel_entry.asm, PHASE 0)
+    boot_mark_at("kernel.bss", now);
+}
+
+void boot_mark(const char* name) {
+    boot_mark_at(name, rdtsc());
+}
+
+// TSC delta → ns без переполнения (как clock_tsc_to_ns)
+static uint64_t boot_tsc_to_ns(uint64_t delta, uint64_t hz) {
+    return (delta / hz) * 1000000000ULL + ((delta % hz) * 1000000000ULL) / hz;
+}
+
+void boot_profile_report(void) {
+    if (boot_mark_count == 0) {
+        return;
+    }
+
+    uint64_t hz = clock_tsc_hz();
+    if (hz == 0) {
+        hz = CLOCK_TSC_HZ_FALLBACK;     // clock_init не прошёл
+    }
+    uint64_t origin = boot_marks[0].tsc;
+
+    kprintf("\n=== Boot Profile (TSC %lu MHz, 0 = %s) ===\n",
+            hz / 1000000, boot_marks[0].name);
+
+    for (uint32_t i = 1; i < boot_mark_count; i++) {
+        uint64_t phase_ns = boot_tsc_to_ns(boot_marks[i].tsc - boot_marks[i - 1].tsc, hz);
+        uint64_t at_ns = boot_tsc_to_ns(boot_marks[i].tsc - origin, hz);
+
+        // ms с тремя знаками - kprintf без float
+        kprintf("[BOOT] %-22s %5lu.%03lu ms   (at %lu.%03lu ms)\n",
+                boot_marks[i].name,
+                phase_ns / 1000000, (phase_ns / 1000) % 1000,
+                at_ns / 1000000, (at_ns / 1000) % 1000);
+    }
+
+    if (boot_marks_dropped) {
+        kprintf("[BOOT] %u marks dropped (BOOT_PROFILE_MAX_MARKS = %u)\n",
+                boot_marks_dropped, BOOT_PROFILE_MAX_MARKS);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// BOOT PROFILE - TSC на каждой вехе загрузки
+// ============================================================================
+//
+// Stage2 пишет rdtsc в boot info (0x9000) в конце каждой своей фазы,
+// kernel_main дописывает свои вехи через boot_mark(). Отчёт - после того,
+// как clock_init откалибровал TSC, перед запуском процессов:
+//
+//   [BOOT] stage2.a20             0.214 ms   (at 0.214 ms)
+//   [BOOT] stage2.kernel_load     3.870 ms   (at 4.511 ms)
+//   [BOOT] kernel.tagfs          12.043 ms   (at 31.950 ms)
+//
+// Время каждой фазы - от предыдущей вехи. Ноль - вход в stage2 (BIOS и
+// stage1 не видны). В фазы входит и вывод kprintf: до serial_enable_irq
+// serial пишется polling'ом.
+//
+// ============================================================================
+
+// Boot info stage2 (src/boot/stage2/stage2.asm, BOOT_INFO_ADDR)
+#define BOOT_INFO_ADDR              0x9000
+#define BOOT_INFO_TSC_MAGIC_OFFSET  16
+#define BOOT_INFO_TSC_COUNT_OFFSET  20
+#define BOOT_INFO_TSC_OFFSET        24      // uint64_t[count]
+#define BOOT_INFO_TSC_MAGIC         0x30435354  // 'TSC0'
+
+#define BOOT_STAGE2_STAMPS          6       // Вход + 5 фаз stage2
+#define BOOT_PROFILE_MAX_MARKS      40
+
+// Первым делом после обнуления BSS: забрать stamps stage2, пока
+// страница 0x9000 не ушла в pmm
+void boot_profile_init(void);
+
+// Конец фазы name (строка должна жить всё время работы kernel)
+void boot_mark(const char* name);
+
+// Таблица фаз в kprintf. Нужен откалиброванный TSC (после clock_init)
+void boot_profile_report(void);
+
+#endif // BOOT_PROFILE_H
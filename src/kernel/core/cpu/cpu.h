@@ -48,4 +48,15 @@ static inline void cpu_cpuid(uint32_t eax, uint32_t ecx, uint32_t* a, uint32_t*
         : "a"(eax), "c"(ecx));
 }
 
+// MSR доступ (APIC base, EFER, ...)
+static inline uint64_t cpu_read_msr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void cpu_write_msr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr" :: "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
 #endif // CPU_H
\ No newline at end of file
@@ -1,5 +1,86 @@
 #include "ktypes.h"
 #include "fpu.h"
+#include "cpu.h"
+#include "pmm.h"
+#include "smp.h"
+#include "process.h"
+#include "atomics.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+#define CPUID_ECX_XSAVE       (1 << 26)
+#define CPUID_ECX_OSXSAVE     (1 << 27)
+#define CPUID_ECX_AVX         (1 << 28)
+
+#define CR0_TS                (1ULL << 3)
+#define CR4_OSXSAVE           (1ULL << 18)
+
+// Legacy область FXSAVE/XSAVE: FCW +0, MXCSR +24
+#define FPU_FCW_DEFAULT       0x037F
+#define FPU_MXCSR_DEFAULT     0x1F80
+
+// Владелец регистров и вложенность kernel секций - per-CPU
+// (user процессы сейчас живут только на BSP, но AP тоже входят в секции)
+typedef struct {
+    struct process* owner;
+    uint32_t kernel_depth;
+    uint32_t ts_rearm;                  // kernel-mode #NM снял TS - вернуть до user
+    uint64_t kernel_rflags;             // IF до внешнего kernel_fpu_begin
+} fpu_cpu_t;
+
+static fpu_cpu_t fpu_cpus[SMP_MAX_CPUS];
+static int fpu_use_xsave = 0;
+static uint64_t fpu_xcr0 = FPU_XCR0_X87 | FPU_XCR0_SSE;
+static uint32_t fpu_state_size = 512;
+static fpu_stats_t fpu_stats;
+
+// Число CPU с ts_rearm: isr_restore проверяет одно слово, не per-CPU
+volatile uint64_t fpu_ts_rearm_pending = 0;
+
+// ============================================================================
+// LOW LEVEL
+// ============================================================================
+
+static inline void fpu_clts(void) {
+    asm volatile("clts");
+}
+
+static inline void fpu_stts(void) {
+    uint64_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    asm volatile("mov %0, %%cr0" :: "r"(cr0 | CR0_TS));
+}
+
+static inline void fpu_save(void* area) {
+    if (fpu_use_xsave) {
+        asm volatile("xsave64 (%0)"
+                     :: "r"(area), "a"((uint32_t)fpu_xcr0), "d"((uint32_t)(fpu_xcr0 >> 32))
+                     : "memory");
+    } else {
+        asm volatile("fxsave64 (%0)" :: "r"(area) : "memory");
+    }
+}
+
+static inline void fpu_restore(const void* area) {
+    if (fpu_use_xsave) {
+        asm volatile("xrstor64 (%0)"
+                     :: "r"(area), "a"((uint32_t)fpu_xcr0), "d"((uint32_t)(fpu_xcr0 >> 32))
+                     : "memory");
+    } else {
+        asm volatile("fxrstor64 (%0)" :: "r"(area) : "memory");
+    }
+}
+
+static inline fpu_cpu_t* fpu_this_cpu(void) {
+    return &fpu_cpus[smp_current_cpu()];
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
 
 void enable_fpu(void) {
     uint64_t cr0, cr4;
@@ -7,15 +88,225 @@ void enable_fpu(void) {
     // CR0: разрешаем FPU
     asm volatile("mov %%cr0, %0" : "=r"(cr0));
     cr0 &= ~(1 << 2); // EM = 0 (разрешить FPU)
-    cr0 |=  (1 << 1); // MP = 1
+    cr0 |=  (1 << 1); // MP = 1 (WAIT/FWAIT тоже видят TS)
+    cr0 &= ~CR0_TS;   // До первого процесса регистры ничьи
     asm volatile("mov %0, %%cr0" :: "r"(cr0));
 
     // CR4: разрешить SSE и FXSR
     asm volatile("mov %%cr4, %0" : "=r"(cr4));
     cr4 |= (1 << 9);  // OSFXSR — включить поддержку fxsave/fxrstor
     cr4 |= (1 << 10); // OSXMMEXCPT — разрешить SSE-исключения
+
+    // XSAVE: нужен для AVX (без XCR0.AVX инструкции VEX дают #UD)
+    uint32_t a, b, c, d;
+    cpu_cpuid(1, 0, &a, &b, &c, &d);
+    if (c & CPUID_ECX_XSAVE) {
+        cr4 |= CR4_OSXSAVE;
+    }
     asm volatile("mov %0, %%cr4" :: "r"(cr4));
 
+    if (c & CPUID_ECX_XSAVE) {
+        uint64_t xcr0 = FPU_XCR0_X87 | FPU_XCR0_SSE;
+        if (c & CPUID_ECX_AVX) {
+            xcr0 |= FPU_XCR0_AVX;
+        }
+        asm volatile("xsetbv" :: "c"(0), "a"((uint32_t)xcr0), "d"((uint32_t)(xcr0 >> 32)));
+
+        // EBX = размер области для включённых компонент
+        cpu_cpuid(0xD, 0, &a, &b, &c, &d);
+
+        // DEFENSIVE: область не влезла бы в страницу - остаёмся на FXSAVE
+        if (b <= FPU_STATE_PAGES * PMM_PAGE_SIZE) {
+            fpu_use_xsave = 1;
+            fpu_xcr0 = xcr0;
+            fpu_state_size = b;
+        }
+    }
+
     // Сбросить FPU
     asm volatile("fninit");
 }
+
+int fpu_avx_enabled(void) {
+    return fpu_use_xsave && (fpu_xcr0 & FPU_XCR0_AVX);
+}
+
+// ============================================================================
+// LAZY SWITCHING
+// ============================================================================
+
+void fpu_switch_to(struct process* next) {
+    fpu_cpu_t* cpu = fpu_this_cpu();
+
+    // Регистры уже принадлежат next - trap не нужен
+    if (next && cpu->owner == next) {
+        fpu_clts();
+    } else {
+        fpu_stts();
+    }
+}
+
+// Чистое состояние: XSTATE_BV = 0 (init), FCW/MXCSR по умолчанию
+// (FXRSTOR и XRSTOR берут MXCSR из legacy области)
+static void* fpu_state_alloc(void) {
+    uint8_t* area = (uint8_t*)pmm_alloc_zero(FPU_STATE_PAGES);
+    if (!area) {
+        return 0;
+    }
+
+    *(uint16_t*)(area + 0) = FPU_FCW_DEFAULT;
+    *(uint32_t*)(area + 24) = FPU_MXCSR_DEFAULT;
+
+    atomic_increment_u64(&fpu_stats.state_allocs);
+    return area;
+}
+
+int fpu_handle_device_not_available(int from_user_space) {
+    fpu_cpu_t* cpu = fpu_this_cpu();
+    process_t* current = process_get_current();
+
+    atomic_increment_u64(&fpu_stats.nm_traps);
+    fpu_clts();
+
+    // Kernel-mode #NM: SIMD вне kernel_fpu_begin (ядро собрано с
+    // -mgeneral-regs-only - это баг). User state владельца сохраняем и НЕ
+    // грузим ничей: регистры дальше портит ядро. TS вернёт fpu_return_check
+    if (!from_user_space) {
+        if (cpu->owner) {
+            fpu_save(cpu->owner->fpu_state);
+            atomic_increment_u64(&fpu_stats.lazy_saves);
+            cpu->owner = 0;
+        }
+        if (current && !cpu->ts_rearm) {
+            cpu->ts_rearm = 1;
+            atomic_increment_u64(&fpu_ts_rearm_pending);
+        }
+        atomic_increment_u64(&fpu_stats.kernel_nm_traps);
+        kprintf("[FPU] %[W]#NM in kernel mode outside kernel_fpu_begin%[D]\n");
+        return 1;
+    }
+
+    if (cpu->owner == current) {
+        return 1;
+    }
+
+    if (cpu->owner) {
+        fpu_save(cpu->owner->fpu_state);
+        atomic_increment_u64(&fpu_stats.lazy_saves);
+        cpu->owner = 0;
+    }
+
+    // DEFENSIVE: user trap без процесса - регистры просто свободны
+    if (!current) {
+        return 1;
+    }
+
+    if (!current->fpu_state) {
+        current->fpu_state = fpu_state_alloc();
+        if (!current->fpu_state) {
+            kprintf("[FPU] %[E]PID=%lu: no memory for FPU state%[D]\n", current->pid);
+            return 0;
+        }
+    }
+
+    fpu_restore(current->fpu_state);
+    atomic_increment_u64(&fpu_stats.lazy_restores);
+    cpu->owner = current;
+    return 1;
+}
+
+void fpu_return_check(uint64_t cs) {
+    fpu_cpu_t* cpu = fpu_this_cpu();
+
+    // Возврат во вложенный kernel код - TS пока не трогаем
+    if (!cpu->ts_rearm || (cs & 3) != 3) {
+        return;
+    }
+    cpu->ts_rearm = 0;
+    atomic_decrement_u64(&fpu_ts_rearm_pending);
+
+    if (cpu->owner != process_get_current()) {
+        fpu_stts();
+    }
+}
+
+void fpu_process_release(struct process* proc) {
+    if (!proc) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (fpu_cpus[i].owner == proc) {
+            fpu_cpus[i].owner = 0;
+        }
+    }
+
+    if (proc->fpu_state) {
+        pmm_free(proc->fpu_state, FPU_STATE_PAGES);
+        proc->fpu_state = 0;
+    }
+}
+
+// ============================================================================
+// KERNEL SIMD SECTIONS
+// ============================================================================
+
+void kernel_fpu_begin(void) {
+    uint64_t rflags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(rflags) :: "memory");
+
+    fpu_cpu_t* cpu = fpu_this_cpu();
+    if (cpu->kernel_depth++ > 0) {
+        return;
+    }
+    cpu->kernel_rflags = rflags;
+
+    // CRITICAL: clts до fxsave - при TS = 1 сам save дал бы #NM
+    fpu_clts();
+    if (cpu->owner) {
+        fpu_save(cpu->owner->fpu_state);
+        atomic_increment_u64(&fpu_stats.lazy_saves);
+        cpu->owner = 0;
+    }
+    atomic_increment_u64(&fpu_stats.kernel_sections);
+}
+
+void kernel_fpu_end(void) {
+    fpu_cpu_t* cpu = fpu_this_cpu();
+
+    // DEFENSIVE: end без begin
+    if (cpu->kernel_depth == 0) {
+        kprintf("[FPU] %[W]kernel_fpu_end without begin%[D]\n");
+        return;
+    }
+    if (--cpu->kernel_depth > 0) {
+        return;
+    }
+
+    // Регистры испорчены секцией - процесс перезагрузит свой state по #NM
+    if (process_get_current()) {
+        fpu_stts();
+    }
+
+    if (cpu->kernel_rflags & (1 << 9)) {
+        asm volatile("sti" ::: "memory");
+    }
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+void fpu_print_stats(void) {
+    kprintf("\n%[H]=== FPU ===%[D]\n");
+    kprintf("  save=%s size=%u xcr0=0x%lx avx=%s\n",
+            fpu_use_xsave ? "XSAVE" : "FXSAVE", fpu_state_size, fpu_xcr0,
+            fpu_avx_enabled() ? "yes" : "no");
+    kprintf("  nm_traps=%lu kernel_nm=%lu restores=%lu saves=%lu kernel_sections=%lu states=%lu\n",
+            atomic_load_u64(&fpu_stats.nm_traps),
+            atomic_load_u64(&fpu_stats.kernel_nm_traps),
+            atomic_load_u64(&fpu_stats.lazy_restores),
+            atomic_load_u64(&fpu_stats.lazy_saves),
+            atomic_load_u64(&fpu_stats.kernel_sections),
+            atomic_load_u64(&fpu_stats.state_allocs));
+}
@@ -1,6 +1,75 @@
 #ifndef FPU_H
 #define FPU_H
 
+#include "ktypes.h"
+
+// ============================================================================
+// FPU / SSE CONTEXT - ленивое переключение через CR0.TS и #NM
+// ============================================================================
+//
+// Каждый процесс получает свою область FXSAVE/XSAVE (страница pmm,
+// выделяется при первом SIMD-обращении). Регистры CPU принадлежат
+// максимум одному процессу (fpu owner):
+//
+//   context switch    → TS = 1, если следующий процесс не owner
+//   #NM (TS = 1)      → clts, save owner, restore current, owner = current
+//   kernel_fpu_begin  → IF = 0, save owner (owner = NULL), clts
+//   kernel_fpu_end    → TS = 1, IF восстановлен - user state вернётся по #NM
+//   #NM из ядра       → save owner (owner = NULL), clts, TS = 1 перед iretq в user
+//
+// Ядро собрано с -mgeneral-regs-only: компилятор сам SIMD не генерирует.
+// Deck-код, явно использующий SIMD (PCLMULQDQ, векторные kernels), включает
+// ISA атрибутом target(...) на функции и ОБЯЗАН быть внутри
+// kernel_fpu_begin/end - иначе он портит регистры текущего user-процесса.
+// Секции вкладываются (счётчик per-CPU).
+//
+// XSAVE (если есть OSXSAVE): XCR0 = x87 | SSE [| AVX] - AVX для decks
+// и user кода доступен только через этот путь.
+//
+// ============================================================================
+
+struct process;
+
+#define FPU_STATE_PAGES   1          // XSAVE x87+SSE+AVX = 832 байт, FXSAVE = 512
+
+#define FPU_XCR0_X87      (1ULL << 0)
+#define FPU_XCR0_SSE      (1ULL << 1)
+#define FPU_XCR0_AVX      (1ULL << 2)
+
+typedef struct {
+    volatile uint64_t nm_traps;          // #NM всего
+    volatile uint64_t kernel_nm_traps;   // #NM из ядра вне kernel_fpu_begin (баг)
+    volatile uint64_t lazy_restores;     // Загрузка state процесса
+    volatile uint64_t lazy_saves;        // Выгрузка state предыдущего owner
+    volatile uint64_t kernel_sections;   // kernel_fpu_begin (внешний уровень)
+    volatile uint64_t state_allocs;      // Области FPU, выделенные процессам
+} fpu_stats_t;
+
+// CR0/CR4 (и XCR0) текущего CPU. Вызывается на BSP и на каждом AP
 void enable_fpu(void);
 
-#endif // FPU_H
\ No newline at end of file
+// 1 = регистры AVX доступны (XCR0.AVX включён)
+int fpu_avx_enabled(void);
+
+// Scheduler: процесс next сейчас получит CPU (TS по владельцу регистров)
+void fpu_switch_to(struct process* next);
+
+// #NM: 1 = обработано, 0 = нет памяти под state (caller убивает процесс)
+// Kernel-mode #NM никогда не грузит user state
+int fpu_handle_device_not_available(int from_user_space);
+
+// isr_restore (если fpu_ts_rearm_pending): выход в user (cs & 3 == 3) после
+// kernel-mode #NM - вернуть TS, если регистры не принадлежат current
+extern volatile uint64_t fpu_ts_rearm_pending;
+void fpu_return_check(uint64_t cs);
+
+// process_destroy: отдать область и владение регистрами
+void fpu_process_release(struct process* proc);
+
+// Секция kernel SIMD (IF = 0 на время секции)
+void kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+
+void fpu_print_stats(void);
+
+#endif // FPU_H
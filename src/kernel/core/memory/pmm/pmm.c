@@ -1,23 +1,59 @@
 #include "pmm.h"
 #include "e820.h"
 #include "klib.h"
+#include "bitmap_alloc.h"
+#include "smp.h"
+#include "atomics.h"
+
+#define PMM_BUDDY_NONE      0xFFFFFFFFu     // Конец списка
+#define PMM_BUDDY_NOT_HEAD  0xFF            // Страница - не начало свободного блока
+#define PMM_BUDDY_CACHED    0xFE            // В magazine CPU / zero pool (занята в bitmap)
 
 typedef struct {
     uintptr_t base;
     size_t pages;
+    uint64_t base_pfn;      // Выравнивание блоков - по физическому номеру страницы
     uint8_t* bitmap;
+    BitmapAlloc alloc;      // Занятость каждой страницы: double free, integrity
     spinlock_t lock;
-    size_t last_free;
+
+    // Buddy metadata за bitmap: страницы выше identity map недоступны,
+    // поэтому списки не внутри свободных блоков, а в массивах по странице
+    uint8_t* order;         // Порядок свободного блока с этой страницы / NOT_HEAD
+    uint32_t* next;
+    uint32_t* prev;
+    uint32_t free_head[PMM_BUDDY_ORDERS];
+    size_t free_blocks[PMM_BUDDY_ORDERS];
 } pmm_zone_t;
 
 static pmm_zone_t pmm_zone;
 static bool pmm_initialized = false;
 
+// Magazine CPU: трогает только свой CPU при IF = 0
+typedef struct {
+    uint32_t count;
+    uintptr_t pages[PMM_PCP_HIGH];      // [0] - самая старая
+    uint64_t hits;
+    uint64_t refills;
+    uint64_t drains;
+} __attribute__((aligned(64))) pmm_pcp_t;
+
+static pmm_pcp_t pmm_pcp[SMP_MAX_CPUS];
+
+static uintptr_t pmm_zero_pool[PMM_ZERO_POOL];
+static uint32_t pmm_zero_count = 0;
+static spinlock_t pmm_zero_lock;
+static volatile uint64_t pmm_zero_hits = 0;
+
 // Внутренние функции
 static void pmm_reserve_region(uintptr_t base, uintptr_t end, const char* name);
-static void pmm_set_bit(size_t bit, pmm_frame_state_t state);
 static pmm_frame_state_t pmm_get_bit(size_t bit);
-static size_t pmm_find_free_sequence(size_t count);
+static void buddy_free_range(size_t first, size_t count);
+static void buddy_init_free_lists(void);
+static size_t buddy_alloc(size_t pages);
+static void* pmm_pcp_alloc(void);
+static void pmm_pcp_free(size_t page);
+static bool pmm_reclaim_caches(void);
 
 
 void pmm_init(void) {
@@ -74,9 +110,14 @@ void pmm_init(void) {
         panic("[PMM] ERROR: No usable pages!");
     }
 
-    // Bitmap size (1 bit per page)
-    size_t bitmap_size = (pmm_zone.pages + 7) / 8;
-    kprintf("[PMM] Bitmap size = %d bytes\n", (int)bitmap_size);
+    // Bitmap size (1 bit per page, кратно 8 байтам) + chunk summary сразу за ним
+    size_t bitmap_size = BITMAP_ALLOC_BYTES(pmm_zone.pages);
+    size_t summary_size = BITMAP_ALLOC_SUMMARY_BYTES(pmm_zone.pages);
+    kprintf("[PMM] Bitmap size = %d bytes (+%d summary)\n", (int)bitmap_size, (int)summary_size);
+
+    // Buddy: порядок (1 байт) + next/prev (по 4) на страницу
+    size_t buddy_size = pmm_zone.pages * (sizeof(uint8_t) + 2 * sizeof(uint32_t));
+    kprintf("[PMM] Buddy metadata = %d bytes\n", (int)buddy_size);
 
     // Place bitmap at the end of RAM
     // pmm_zone.bitmap = (uint8_t*)(mem_end - bitmap_size);
@@ -91,6 +132,14 @@ void pmm_init(void) {
 
     // Mark all pages as used (safe default)
     memset(pmm_zone.bitmap, 0xFF, bitmap_size);
+    bitmap_alloc_init(&pmm_zone.alloc, pmm_zone.bitmap,
+                      (uint32_t*)(pmm_zone.bitmap + bitmap_size), pmm_zone.pages);
+
+    uint8_t* buddy = (uint8_t*)ALIGN_UP((uintptr_t)pmm_zone.bitmap + bitmap_size + summary_size, 8);
+    pmm_zone.next = (uint32_t*)buddy;
+    pmm_zone.prev = pmm_zone.next + pmm_zone.pages;
+    pmm_zone.order = (uint8_t*)(pmm_zone.prev + pmm_zone.pages);
+    pmm_zone.base_pfn = pmm_zone.base / PMM_PAGE_SIZE;
 
     // Free all usable regions from e820 (except below 1MB)
     for (size_t i = 0; i < entry_count; i++) {
@@ -107,8 +156,8 @@ void pmm_init(void) {
 
             kprintf("[PMM] Freeing pages: %d .. %d\n", (int)start_page, (int)end_page - 1);
 
-            for (size_t j = start_page; j < end_page; j++) {
-                pmm_set_bit(j, PMM_FRAME_FREE);
+            if (start_page < end_page) {
+                bitmap_alloc_clear(&pmm_zone.alloc, start_page, end_page - start_page);
             }
         }
     }
@@ -117,9 +166,15 @@ void pmm_init(void) {
     extern uintptr_t _kernel_start;
     extern uintptr_t _kernel_end;
     pmm_reserve_region((uintptr_t)&_kernel_start, (uintptr_t)&_kernel_end, "Kernel");
-    pmm_reserve_region((uintptr_t)pmm_zone.bitmap, (uintptr_t)pmm_zone.bitmap + bitmap_size, "Bitmap");
+    pmm_reserve_region((uintptr_t)pmm_zone.bitmap, (uintptr_t)pmm_zone.bitmap + bitmap_size + summary_size, "Bitmap");
+    pmm_reserve_region((uintptr_t)buddy, (uintptr_t)buddy + buddy_size, "Buddy metadata");
+
+    // Свободное по bitmap (usable минус зарезервированное) - в списки
+    buddy_init_free_lists();
 
     spinlock_init(&pmm_zone.lock);
+    spinlock_init(&pmm_zero_lock);
+    memset(pmm_pcp, 0, sizeof(pmm_pcp));
     pmm_initialized = true;
 
     kprintf("[PMM] Initialized: %d MB available, %d pages.\n",
@@ -188,18 +243,24 @@ void pmm_init(void) {
 
 void* pmm_alloc(size_t pages) {
     if (!pages || !pmm_initialized) return NULL;
+
+    if (pages == 1) {
+        void* page = pmm_pcp_alloc();
+        if (page) {
+            return page;
+        }
+    }
     
     spin_lock(&pmm_zone.lock);
     
-    size_t start = pmm_find_free_sequence(pages);
+    size_t start = buddy_alloc(pages);
     if (start == (size_t)-1) {
         spin_unlock(&pmm_zone.lock);
-        return NULL;
+        // Страницы в magazine / zero pool могли закрыть нужный run
+        return pmm_reclaim_caches() ? pmm_alloc(pages) : NULL;
     }
     
-    for (size_t i = 0; i < pages; i++) {
-        pmm_set_bit(start + i, PMM_FRAME_USED);
-    }
+    bitmap_alloc_set(&pmm_zone.alloc, start, pages);
     
     void* addr = (void*)(pmm_zone.base + start * PMM_PAGE_SIZE);
     spin_unlock(&pmm_zone.lock);
@@ -207,6 +268,20 @@ void* pmm_alloc(size_t pages) {
 }
 
 void* pmm_alloc_zero(size_t pages) {
+    if (pages == 1 && pmm_zero_count > 0) {
+        uintptr_t page = 0;
+        spin_lock(&pmm_zero_lock);
+        if (pmm_zero_count > 0) {
+            page = pmm_zero_pool[--pmm_zero_count];
+            pmm_zone.order[(page - pmm_zone.base) / PMM_PAGE_SIZE] = PMM_BUDDY_NOT_HEAD;
+        }
+        spin_unlock(&pmm_zero_lock);
+        if (page) {
+            atomic_increment_u64(&pmm_zero_hits);
+            return (void*)page;
+        }
+    }
+
     void* addr = pmm_alloc(pages);
     if (addr) memset(addr, 0, pages * PMM_PAGE_SIZE);
     return addr;
@@ -221,30 +296,32 @@ void pmm_free(void* addr, size_t pages) {
     }
     
     size_t first = (base - pmm_zone.base) / PMM_PAGE_SIZE;
-    
-    spin_lock(&pmm_zone.lock);
-    
-    // Проверка на двойное освобождение
-    for (size_t i = first; i < first + pages; i++) {
-        if (pmm_get_bit(i) == PMM_FRAME_FREE) {
-            kprintf("[PMM] ERROR: Double free detected!\n");
-            kprintf("[PMM]   Address: 0x%lx\n", base + (i - first) * PMM_PAGE_SIZE);
-            kprintf("[PMM]   Page index: %lu (of %lu)\n", i, pmm_zone.pages);
-            kprintf("[PMM]   Pages requested: %lu\n", pages);
-            panic("PMM: Double free detected at page %d", i);
+
+    if (pages == 1) {
+        // Бит занятой страницы меняет только её владелец - читаем без lock
+        if (pmm_zone.order[first] == PMM_BUDDY_CACHED || !bitmap_alloc_test(&pmm_zone.alloc, first)) {
+            panic("PMM: Double free detected at page %d", first);
         }
+        pmm_pcp_free(first);
+        return;
     }
     
-    // Освобождение
-    for (size_t i = first; i < first + pages; i++) {
-        pmm_set_bit(i, PMM_FRAME_FREE);
-    }
+    spin_lock(&pmm_zone.lock);
     
-    // Обновляем last_free для оптимизации
-    if (first < pmm_zone.last_free) {
-        pmm_zone.last_free = first;
+    // Проверка на двойное освобождение (первый свободный бит диапазона)
+    size_t i = (size_t)bitmap_alloc_next_free(&pmm_zone.alloc, first, first + pages);
+    if (i != (size_t)BITMAP_ALLOC_NONE) {
+        kprintf("[PMM] ERROR: Double free detected!\n");
+        kprintf("[PMM]   Address: 0x%lx\n", base + (i - first) * PMM_PAGE_SIZE);
+        kprintf("[PMM]   Page index: %lu (of %lu)\n", i, pmm_zone.pages);
+        kprintf("[PMM]   Pages requested: %lu\n", pages);
+        panic("PMM: Double free detected at page %d", i);
     }
     
+    // Освобождение: любой диапазон, не обязательно целый блок pmm_alloc
+    bitmap_alloc_clear(&pmm_zone.alloc, first, pages);
+    buddy_free_range(first, pages);
+    
     spin_unlock(&pmm_zone.lock);
 }
 
@@ -262,67 +339,308 @@ static void pmm_reserve_region(uintptr_t base, uintptr_t end, const char* name)
     if (start_page >= pmm_zone.pages) return; // Регион начинается за пределами зоны PMM
     if (end_page > pmm_zone.pages) end_page = pmm_zone.pages; // Регион выходит за пределы зоны PMM
 
-    for (size_t i = start_page; i < end_page; i++) {
-        pmm_set_bit(i, PMM_FRAME_RESERVED); // Пометить как занятое (1)
+    if (start_page < end_page) {
+        bitmap_alloc_set(&pmm_zone.alloc, start_page, end_page - start_page); // Пометить как занятое (1)
     }
 
     kprintf("PMM: Reserved %s at %p-%p\n", name, (void*)base, (void*)end);
 }
 
-static void pmm_set_bit(size_t bit, pmm_frame_state_t state) {
-    size_t byte = bit / PMM_BITMAP_ALIGN;
-    size_t offset = bit % PMM_BITMAP_ALIGN; // offset = bit % 8
+static pmm_frame_state_t pmm_get_bit(size_t bit) {
+    // Возвращает PMM_FRAME_USED (1) или PMM_FRAME_FREE (0)
+    // Другие состояния не различаются
+    return bitmap_alloc_test(&pmm_zone.alloc, bit) ? PMM_FRAME_USED : PMM_FRAME_FREE;
+}
+
+// ============================================================================
+// BUDDY (под pmm_zone.lock, кроме init)
+// ============================================================================
 
-    switch(state) {
-        case PMM_FRAME_FREE:
-            pmm_zone.bitmap[byte] &= ~(1 << offset); // Сбросить бит в 0
-            break;
-        default: // PMM_FRAME_USED, PMM_FRAME_RESERVED, PMM_FRAME_KERNEL, PMM_FRAME_BAD
-            pmm_zone.bitmap[byte] |= (1 << offset); // Установить бит в 1
+static inline int buddy_aligned(size_t page, uint32_t order) {
+    return ((pmm_zone.base_pfn + page) & (((uint64_t)1 << order) - 1)) == 0;
+}
+
+static void buddy_push(size_t page, uint32_t order) {
+    uint32_t head = pmm_zone.free_head[order];
+    pmm_zone.order[page] = (uint8_t)order;
+    pmm_zone.prev[page] = PMM_BUDDY_NONE;
+    pmm_zone.next[page] = head;
+    if (head != PMM_BUDDY_NONE) {
+        pmm_zone.prev[head] = (uint32_t)page;
+    }
+    pmm_zone.free_head[order] = (uint32_t)page;
+    pmm_zone.free_blocks[order]++;
+}
+
+static void buddy_remove(size_t page, uint32_t order) {
+    uint32_t next = pmm_zone.next[page];
+    uint32_t prev = pmm_zone.prev[page];
+    if (prev != PMM_BUDDY_NONE) {
+        pmm_zone.next[prev] = next;
+    } else {
+        pmm_zone.free_head[order] = next;
+    }
+    if (next != PMM_BUDDY_NONE) {
+        pmm_zone.prev[next] = prev;
+    }
+    pmm_zone.order[page] = PMM_BUDDY_NOT_HEAD;
+    pmm_zone.free_blocks[order]--;
+}
+
+// Свободный блок: склеиваем с buddy, пока тот - свободный блок того же порядка
+static void buddy_free_block(size_t page, uint32_t order) {
+    while (order < PMM_BUDDY_MAX_ORDER) {
+        // Buddy вне зоны (в том числе ниже base) - index за pages
+        size_t buddy = ((pmm_zone.base_pfn + page) ^ ((uint64_t)1 << order)) - pmm_zone.base_pfn;
+        if (buddy >= pmm_zone.pages || pmm_zone.order[buddy] != order) {
             break;
+        }
+        buddy_remove(buddy, order);
+        if (buddy < page) {
+            page = buddy;
+        }
+        order++;
     }
+    buddy_push(page, order);
 }
 
-static pmm_frame_state_t pmm_get_bit(size_t bit) {
-    size_t byte = bit / PMM_BITMAP_ALIGN;
-    size_t offset = bit % PMM_BITMAP_ALIGN; // offset = bit % 8
-    // Возвращает PMM_FRAME_USED (1) или PMM_FRAME_FREE (0)
-    // Другие состояния не различаются
-    return (pmm_zone.bitmap[byte] & (1 << offset)) ? PMM_FRAME_USED : PMM_FRAME_FREE;
+// [first, first + count) - выровненными блоками наибольшего порядка
+static void buddy_free_range(size_t first, size_t count) {
+    while (count) {
+        uint32_t order = 0;
+        while (order < PMM_BUDDY_MAX_ORDER && buddy_aligned(first, order + 1) &&
+               ((size_t)2 << order) <= count) {
+            order++;
+        }
+        buddy_free_block(first, order);
+        first += (size_t)1 << order;
+        count -= (size_t)1 << order;
+    }
+}
+
+// Больше блока старшего порядка (большие DMA буферы, vmalloc): подряд
+// идущие свободные блоки PMM_BUDDY_MAX_ORDER. Редко - линейный проход
+// по блокам старшего порядка, не по страницам
+static size_t buddy_alloc_large(size_t pages) {
+    size_t block = (size_t)1 << PMM_BUDDY_MAX_ORDER;
+    size_t need = (pages + block - 1) / block;
+    size_t first = (size_t)((block - (pmm_zone.base_pfn & (block - 1))) & (block - 1));
+    size_t run = 0;
+    size_t start = 0;
+
+    for (size_t page = first; page + block <= pmm_zone.pages; page += block) {
+        if (pmm_zone.order[page] != PMM_BUDDY_MAX_ORDER) {
+            run = 0;
+            continue;
+        }
+        if (run++ == 0) {
+            start = page;
+        }
+        if (run == need) {
+            for (size_t k = 0; k < need; k++) {
+                buddy_remove(start + k * block, PMM_BUDDY_MAX_ORDER);
+            }
+            buddy_free_range(start + pages, need * block - pages);
+            return start;
+        }
+    }
+    return (size_t)-1;
+}
+
+static size_t buddy_alloc(size_t pages) {
+    uint32_t order = 0;
+    while (((size_t)1 << order) < pages) {
+        order++;
+    }
+    if (order > PMM_BUDDY_MAX_ORDER) {
+        return buddy_alloc_large(pages);
+    }
+
+    uint32_t found = order;
+    while (found <= PMM_BUDDY_MAX_ORDER && pmm_zone.free_head[found] == PMM_BUDDY_NONE) {
+        found++;
+    }
+    if (found > PMM_BUDDY_MAX_ORDER) {
+        return (size_t)-1;
+    }
+
+    size_t page = pmm_zone.free_head[found];
+    buddy_remove(page, found);
+
+    // Split: верхние половины - в списки младших порядков
+    while (found > order) {
+        found--;
+        buddy_push(page + ((size_t)1 << found), found);
+    }
+
+    // Хвост сверх pages - обратно, pmm_alloc(3) не держит 4-ю страницу
+    buddy_free_range(page + pages, ((size_t)1 << order) - pages);
+    return page;
 }
 
-static size_t pmm_find_free_sequence(size_t count) {
-    size_t consecutive = 0;
-    size_t start_search_from = pmm_zone.last_free; // Изменил имя переменной для ясности
-
-    // Ищем от last_free до конца
-    for (size_t i = start_search_from; i < pmm_zone.pages; i++) {
-        if (pmm_get_bit(i) == PMM_FRAME_FREE) {
-            consecutive++;
-            if (consecutive == count) {
-                pmm_zone.last_free = i - count + 1; // Обновляем last_free на место найденного блока
-                return i - count + 1;
+// Списки из bitmap. Окна старшего порядка - с конца зоны: последним в
+// голову списка попадает нижняя память, pmm_alloc отдаёт её первой
+// (identity map покрывает только низ)
+static void buddy_init_free_lists(void) {
+    uint64_t block = (uint64_t)1 << PMM_BUDDY_MAX_ORDER;
+
+    memset(pmm_zone.order, PMM_BUDDY_NOT_HEAD, pmm_zone.pages);
+    for (uint32_t order = 0; order < PMM_BUDDY_ORDERS; order++) {
+        pmm_zone.free_head[order] = PMM_BUDDY_NONE;
+        pmm_zone.free_blocks[order] = 0;
+    }
+
+    size_t end = pmm_zone.pages;
+    while (end > 0) {
+        uint64_t window = (pmm_zone.base_pfn + end - 1) & ~(block - 1);
+        size_t start = window > pmm_zone.base_pfn ? (size_t)(window - pmm_zone.base_pfn) : 0;
+
+        for (size_t page = start; page < end; ) {
+            uint64_t free = bitmap_alloc_next_free(&pmm_zone.alloc, page, end);
+            if (free == BITMAP_ALLOC_NONE) {
+                break;
+            }
+            uint64_t used = bitmap_alloc_next_used(&pmm_zone.alloc, free, end);
+            if (used == BITMAP_ALLOC_NONE) {
+                used = end;
             }
-        } else {
-            consecutive = 0;
+            buddy_free_range(free, used - free);
+            page = used;
         }
+        end = start;
+    }
+}
+
+// ============================================================================
+// PER-CPU MAGAZINES + ZERO POOL
+// ============================================================================
+
+static inline uint64_t pmm_irq_save(void) {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void pmm_irq_restore(uint64_t flags) {
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+// Первые count страниц magazine - обратно в buddy
+static void pmm_pcp_drain(pmm_pcp_t* pcp, uint32_t count) {
+    spin_lock(&pmm_zone.lock);
+    for (uint32_t i = 0; i < count; i++) {
+        size_t page = (pcp->pages[i] - pmm_zone.base) / PMM_PAGE_SIZE;
+        pmm_zone.order[page] = PMM_BUDDY_NOT_HEAD;
+        bitmap_alloc_clear(&pmm_zone.alloc, page, 1);
+        buddy_free_range(page, 1);
     }
+    spin_unlock(&pmm_zone.lock);
+
+    pcp->count -= count;
+    memmove(pcp->pages, pcp->pages + count, pcp->count * sizeof(uintptr_t));
+    pcp->drains++;
+}
 
-    // Если не нашли, сбрасываем consecutive и ищем с начала до last_free
-    consecutive = 0; // Сброс для нового прохода
-    for (size_t i = 0; i < start_search_from; i++) { // Ищем только до last_free
-        if (pmm_get_bit(i) == PMM_FRAME_FREE) {
-            consecutive++;
-            if (consecutive == count) {
-                pmm_zone.last_free = i - count + 1; // Обновляем last_free на место найденного блока
-                return i - count + 1;
+static void* pmm_pcp_alloc(void) {
+    uint64_t flags = pmm_irq_save();
+    pmm_pcp_t* pcp = &pmm_pcp[smp_current_cpu()];
+
+    if (pcp->count == 0) {
+        // Refill: PMM_PCP_BATCH страниц за один захват lock'а
+        spin_lock(&pmm_zone.lock);
+        while (pcp->count < PMM_PCP_BATCH) {
+            size_t page = buddy_alloc(1);
+            if (page == (size_t)-1) {
+                break;
             }
-        } else {
-            consecutive = 0;
+            bitmap_alloc_set(&pmm_zone.alloc, page, 1);
+            pmm_zone.order[page] = PMM_BUDDY_CACHED;
+            pcp->pages[pcp->count++] = pmm_zone.base + page * PMM_PAGE_SIZE;
         }
+        spin_unlock(&pmm_zone.lock);
+        pcp->refills++;
     }
 
-    return (size_t)-1;
+    void* addr = NULL;
+    if (pcp->count > 0) {
+        uintptr_t page = pcp->pages[--pcp->count];  // Последняя освобождённая - ещё в cache
+        pmm_zone.order[(page - pmm_zone.base) / PMM_PAGE_SIZE] = PMM_BUDDY_NOT_HEAD;
+        pcp->hits++;
+        addr = (void*)page;
+    }
+
+    pmm_irq_restore(flags);
+    return addr;
+}
+
+static void pmm_pcp_free(size_t page) {
+    uint64_t flags = pmm_irq_save();
+    pmm_pcp_t* pcp = &pmm_pcp[smp_current_cpu()];
+
+    if (pcp->count == PMM_PCP_HIGH) {
+        pmm_pcp_drain(pcp, PMM_PCP_BATCH);
+    }
+    pmm_zone.order[page] = PMM_BUDDY_CACHED;
+    pcp->pages[pcp->count++] = pmm_zone.base + page * PMM_PAGE_SIZE;
+
+    pmm_irq_restore(flags);
+}
+
+// pmm_alloc не нашёл места: magazine этого CPU и zero pool - в buddy.
+// Чужие magazines не трогаем (их CPU может быть внутри pmm_pcp_alloc),
+// это не больше PMM_PCP_HIGH страниц на CPU. false = возвращать нечего
+static bool pmm_reclaim_caches(void) {
+    bool reclaimed = false;
+
+    uint64_t flags = pmm_irq_save();
+    pmm_pcp_t* pcp = &pmm_pcp[smp_current_cpu()];
+    if (pcp->count > 0) {
+        pmm_pcp_drain(pcp, pcp->count);
+        reclaimed = true;
+    }
+    pmm_irq_restore(flags);
+
+    spin_lock(&pmm_zero_lock);
+    if (pmm_zero_count > 0) {
+        spin_lock(&pmm_zone.lock);
+        while (pmm_zero_count > 0) {
+            size_t page = (pmm_zero_pool[--pmm_zero_count] - pmm_zone.base) / PMM_PAGE_SIZE;
+            pmm_zone.order[page] = PMM_BUDDY_NOT_HEAD;
+            bitmap_alloc_clear(&pmm_zone.alloc, page, 1);
+            buddy_free_range(page, 1);
+        }
+        spin_unlock(&pmm_zone.lock);
+        reclaimed = true;
+    }
+    spin_unlock(&pmm_zero_lock);
+
+    return reclaimed;
+}
+
+void pmm_zero_idle(void) {
+    if (!pmm_initialized) return;
+
+    for (uint32_t i = 0; i < PMM_ZERO_IDLE_BATCH && pmm_zero_count < PMM_ZERO_POOL; i++) {
+        uintptr_t page = (uintptr_t)pmm_alloc(1);
+        if (!page) {
+            return;
+        }
+
+        // memset - без lock'ов и с IF = 1
+        memset((void*)page, 0, PMM_PAGE_SIZE);
+
+        spin_lock(&pmm_zero_lock);
+        if (pmm_zero_count < PMM_ZERO_POOL) {
+            pmm_zone.order[(page - pmm_zone.base) / PMM_PAGE_SIZE] = PMM_BUDDY_CACHED;
+            pmm_zero_pool[pmm_zero_count++] = page;
+            page = 0;
+        }
+        spin_unlock(&pmm_zero_lock);
+
+        if (page) {
+            pmm_free((void*)page, 1);  // Пул заполнил другой CPU
+        }
+    }
 }
 
 // Утилиты
@@ -331,13 +649,16 @@ size_t pmm_total_pages(void) {
 }
 
 size_t pmm_free_pages(void) {
-    size_t count = 0;
+    // Счётчик ведут bitmap_alloc_set/clear. Magazines и zero pool заняты в
+    // bitmap, но свободны для pmm_alloc - тоже считаем
     spin_lock(&pmm_zone.lock);
-    for (size_t i = 0; i < pmm_zone.pages; i++) {
-        if (pmm_get_bit(i) == PMM_FRAME_FREE) count++;
-    }
+    size_t count = pmm_zone.alloc.free;
     spin_unlock(&pmm_zone.lock);
-    return count;
+
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        count += pmm_pcp[cpu].count;
+    }
+    return count + pmm_zero_count;
 }
 
 size_t pmm_used_pages(void) {
@@ -355,6 +676,22 @@ void pmm_dump_stats(void) {
     kprintf("  Free pages:  %d (%d MB)\n",
            pmm_free_pages(),
            (pmm_free_pages() * PMM_PAGE_SIZE) / (1024 * 1024));
+
+    kprintf("  Free blocks by order:");
+    spin_lock(&pmm_zone.lock);
+    for (uint32_t order = 0; order < PMM_BUDDY_ORDERS; order++) {
+        kprintf(" %u:%lu", order, pmm_zone.free_blocks[order]);
+    }
+    spin_unlock(&pmm_zone.lock);
+    kprintf("\n");
+
+    for (uint32_t cpu = 0; cpu < smp_cpu_count(); cpu++) {
+        pmm_pcp_t* pcp = &pmm_pcp[cpu];
+        kprintf("  CPU %u magazine: %u pages, hits=%lu refills=%lu drains=%lu\n",
+                cpu, pcp->count, pcp->hits, pcp->refills, pcp->drains);
+    }
+    kprintf("  Zero pool:   %u/%d pages, hits=%lu\n",
+            pmm_zero_count, PMM_ZERO_POOL, atomic_load_u64(&pmm_zero_hits));
 }
 
 // Отладочные функции
@@ -382,5 +719,22 @@ bool pmm_check_integrity(void) {
             return false;
         }
     }
-    return true;
+
+    // Свободные блоки buddy - ровно свободные страницы bitmap
+    size_t free = 0;
+    spin_lock(&pmm_zone.lock);
+    for (uint32_t order = 0; order < PMM_BUDDY_ORDERS; order++) {
+        for (uint32_t page = pmm_zone.free_head[order]; page != PMM_BUDDY_NONE; page = pmm_zone.next[page]) {
+            size_t size = (size_t)1 << order;
+            if (!buddy_aligned(page, order) || page + size > pmm_zone.pages ||
+                bitmap_alloc_next_used(&pmm_zone.alloc, page, page + size) != BITMAP_ALLOC_NONE) {
+                spin_unlock(&pmm_zone.lock);
+                return false;
+            }
+            free += size;
+        }
+    }
+    bool consistent = free == pmm_zone.alloc.free;
+    spin_unlock(&pmm_zone.lock);
+    return consistent;
 }
\ No newline at end of file
@@ -7,6 +7,24 @@
 #define PMM_BITMAP_ALIGN    8
 #define PMM_MAX_MEMORY      (128ULL * 1024 * 1024 * 1024) // 128GB
 
+// Binary buddy: свободная память - выровненные по физическому адресу блоки
+// 2^order страниц, списки по порядку. pmm_alloc(n) - блок порядка
+// ceil(log2 n), остаток сверх n сразу возвращается; pmm_free склеивает
+// блок с buddy, пока тот свободен. Больше блока PMM_BUDDY_MAX_ORDER -
+// несколько подряд идущих блоков старшего порядка
+#define PMM_BUDDY_MAX_ORDER 10      // 4MB
+#define PMM_BUDDY_ORDERS    (PMM_BUDDY_MAX_ORDER + 1)
+
+// Одиночные страницы (page tables, user pages) - из magazine текущего CPU
+// без pmm_zone.lock. Пустой - refill PMM_PCP_BATCH страниц одним захватом
+// lock'а, полный - самые старые PMM_PCP_BATCH обратно в buddy
+#define PMM_PCP_BATCH       16
+#define PMM_PCP_HIGH        64      // Страниц в magazine максимум
+
+// Pre-zeroed страницы для pmm_alloc_zero(1): заполняются в idle
+#define PMM_ZERO_POOL       64
+#define PMM_ZERO_IDLE_BATCH 8       // Страниц за один вызов pmm_zero_idle
+
 typedef enum {
     PMM_FRAME_FREE = 0,
     PMM_FRAME_USED,
@@ -23,6 +41,9 @@ void* pmm_alloc(size_t pages);
 void* pmm_alloc_zero(size_t pages);
 void pmm_free(void* addr, size_t pages);
 
+// Из idle loop (IF = 1): обнулить до PMM_ZERO_IDLE_BATCH страниц в пул
+void pmm_zero_idle(void);
+
 // Утилиты
 size_t pmm_total_pages(void);
 size_t pmm_free_pages(void);
@@ -2,6 +2,10 @@
 #include "pmm.h"
 #include "klib.h"
 #include "io.h"
+#include "trace.h"
+#include "cpu.h"
+#include "smp.h"
+#include "atomics.h"
 
 
 // ========== GLOBAL VARIABLES ==========
@@ -12,19 +16,34 @@ static char last_error[256] = {0};
 static vmm_stats_t global_stats = {0};
 static spinlock_t vmm_global_lock = {0};
 
-// Kernel heap tracking
-static uintptr_t kernel_heap_current = VMM_KERNEL_HEAP_BASE;
-static spinlock_t kernel_heap_lock = {0};
-
-// vmalloc tracking (simple linked list)
-typedef struct vmalloc_entry {
-    void* virt_base;
-    size_t pages;
-    struct vmalloc_entry* next;
-} vmalloc_entry_t;
-
-static vmalloc_entry_t* vmalloc_list = NULL;
-static spinlock_t vmalloc_lock = {0};
+// MMIO window tracking (bump allocator, mappings are never torn down)
+static uintptr_t mmio_current = VMM_MMIO_BASE;
+static spinlock_t mmio_lock = {0};
+
+// PCID: у каждого CPU свои VMM_PCID_SLOTS PCID, занятые контекстами по кругу.
+// Slot помнит tlb_id контекста и его tlb_gen, до которого TLB актуален
+#define VMM_CR4_PGE             (1ULL << 7)
+#define VMM_CR4_PCIDE           (1ULL << 17)
+#define VMM_CR3_NOFLUSH         (1ULL << 63)
+#define VMM_INVPCID_ADDRESS     0
+#define VMM_INVPCID_CONTEXT     1
+#define VMM_PCID_NONE           VMM_PCID_SLOTS   // current_slot: PCID 0
+
+typedef struct {
+    uint64_t tlb_id[VMM_PCID_SLOTS];        // 0 = slot свободен / сброшен
+    uint64_t tlb_gen[VMM_PCID_SLOTS];
+    uint64_t kernel_gen;                    // vmm_kernel_tlb_gen, учтённый всеми slots
+    uint32_t current_slot;
+    uint32_t next_slot;
+    uint64_t switches;
+    uint64_t preserved;
+} __attribute__((aligned(64))) vmm_cpu_tlb_t;
+
+static vmm_cpu_tlb_t vmm_cpu_tlb[SMP_MAX_CPUS];
+static bool vmm_pcid_enabled = false;
+static bool vmm_invpcid_supported = false;
+static volatile uint64_t vmm_next_tlb_id = 0;
+static volatile uint64_t vmm_kernel_tlb_gen = 0;  // Снятия в PML4[256..511] - общих для всех PCID
 
 // ========== ERROR HANDLING ==========
 void vmm_set_error(const char* error) {
@@ -82,6 +101,210 @@ void vmm_invalidate_page(uintptr_t virt_addr) {
     vmm_flush_tlb_page(virt_addr);
 }
 
+static inline uint64_t vmm_irq_save(void) {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void vmm_irq_restore(uint64_t flags) {
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+static inline void vmm_invpcid(uint64_t type, uint64_t pcid, uintptr_t virt_addr) {
+    struct { uint64_t pcid; uint64_t addr; } desc = { pcid, virt_addr };
+    asm volatile("invpcid %0, %1" : : "m"(desc), "r"(type) : "memory");
+}
+
+// TLB этого CPU для [start, start + pages): до VMM_TLB_FLUSH_ALL_PAGES -
+// invlpg по странице, больше - весь текущий PCID (reload CR3; identity map -
+// global и не меняется)
+static void vmm_tlb_flush_local(uint64_t pcid, bool loaded, uintptr_t start, size_t pages) {
+    bool all = pages > VMM_TLB_FLUSH_ALL_PAGES;
+
+    if (loaded && all) {
+        uintptr_t cr3;
+        asm volatile("mov %%cr3, %0" : "=r"(cr3));
+        asm volatile("mov %0, %%cr3" : : "r"(cr3 & ~VMM_CR3_NOFLUSH) : "memory");
+    } else if (loaded) {
+        for (size_t i = 0; i < pages; i++) {
+            asm volatile("invlpg (%0)" : : "r"(start + i * VMM_PAGE_SIZE) : "memory");
+        }
+    } else if (all) {
+        vmm_invpcid(VMM_INVPCID_CONTEXT, pcid, 0);
+    } else {
+        for (size_t i = 0; i < pages; i++) {
+            vmm_invpcid(VMM_INVPCID_ADDRESS, pcid, start + i * VMM_PAGE_SIZE);
+        }
+    }
+
+    spin_lock(&vmm_global_lock);
+    global_stats.tlb_flushes++;
+    spin_unlock(&vmm_global_lock);
+}
+
+// PTE [start, end) в ctx сняты или ослаблены (запись PTE - до вызова).
+// TLB этого CPU - сразу: загруженный контекст - invlpg / reload CR3, другой
+// PCID этого ctx - INVPCID; без PCID у не загруженного контекста в TLB
+// ничего нет. С PCID поколение ctx (kernel адреса - общее) вперёд: прочие
+// PCID и CPU сбросятся при следующем переключении на ctx
+static void vmm_tlb_flush_range(vmm_context_t* ctx, uintptr_t start, uintptr_t end) {
+    size_t pages = (end - start) / VMM_PAGE_SIZE;
+    bool kernel = start >= VMM_KERNEL_BASE || !ctx || ctx == kernel_context;
+
+    uint64_t irq = vmm_irq_save();
+
+    if (kernel) {
+        if (vmm_pcid_enabled) {
+            atomic_increment_u64(&vmm_kernel_tlb_gen);
+        }
+        vmm_tlb_flush_local(0, true, start, pages);
+        vmm_irq_restore(irq);
+        return;
+    }
+
+    if (!vmm_pcid_enabled) {
+        uintptr_t cr3;
+        asm volatile("mov %%cr3, %0" : "=r"(cr3));
+        if ((cr3 & VMM_PAGE_MASK) == ctx->pml4_phys) {
+            vmm_tlb_flush_local(0, true, start, pages);
+        }
+        vmm_irq_restore(irq);
+        return;
+    }
+
+    uint64_t gen = atomic_increment_u64(&ctx->tlb_gen);
+    vmm_cpu_tlb_t* cpu = &vmm_cpu_tlb[smp_current_cpu()];
+    for (uint32_t slot = 0; slot < VMM_PCID_SLOTS; slot++) {
+        if (cpu->tlb_id[slot] != ctx->tlb_id) {
+            continue;
+        }
+        bool loaded = slot == cpu->current_slot;
+        if (!loaded && !vmm_invpcid_supported) {
+            break;  // Сбросится при переключении
+        }
+        vmm_tlb_flush_local(slot + 1, loaded, start, pages);
+        // Slot актуален, только если не пропустил чужих изменений
+        if (cpu->tlb_gen[slot] == gen - 1) {
+            cpu->tlb_gen[slot] = gen;
+        }
+        break;
+    }
+    vmm_irq_restore(irq);
+}
+
+// ========== TLB BATCH ==========
+
+void vmm_tlb_batch_init(vmm_tlb_batch_t* batch, vmm_context_t* ctx) {
+    batch->ctx = ctx;
+    batch->start = 0;
+    batch->end = 0;
+    batch->free_count = 0;
+}
+
+void vmm_tlb_batch_add(vmm_tlb_batch_t* batch, uintptr_t virt_addr, size_t size) {
+    uintptr_t end = virt_addr + size;
+    if (batch->start == batch->end) {
+        batch->start = virt_addr;
+        batch->end = end;
+        return;
+    }
+    if (virt_addr < batch->start) batch->start = virt_addr;
+    if (end > batch->end) batch->end = end;
+}
+
+// Сброс TLB, затем страницы - в PMM (до сброса их ещё видит чей-то TLB)
+static void vmm_tlb_batch_flush(vmm_tlb_batch_t* batch) {
+    if (batch->start != batch->end) {
+        vmm_tlb_flush_range(batch->ctx, batch->start, batch->end);
+        batch->start = batch->end = 0;
+    }
+
+    for (size_t i = 0; i < batch->free_count; i++) {
+        pmm_free((void*)batch->free[i].phys, batch->free[i].pages);
+    }
+    batch->free_count = 0;
+}
+
+void vmm_tlb_batch_free(vmm_tlb_batch_t* batch, uintptr_t phys, size_t pages) {
+    // Подряд идущие физические страницы - одним pmm_free
+    if (batch->free_count > 0) {
+        vmm_tlb_batch_page_t* last = &batch->free[batch->free_count - 1];
+        if (last->phys + last->pages * VMM_PAGE_SIZE == phys) {
+            last->pages += pages;
+            return;
+        }
+    }
+
+    if (batch->free_count == VMM_TLB_BATCH_FREE) {
+        vmm_tlb_batch_flush(batch);
+    }
+    batch->free[batch->free_count].phys = phys;
+    batch->free[batch->free_count].pages = pages;
+    batch->free_count++;
+}
+
+void vmm_tlb_batch_finish(vmm_tlb_batch_t* batch) {
+    vmm_tlb_batch_flush(batch);
+}
+
+// CR3 для ctx на этом CPU (IF = 0): PCID slot'а + NOFLUSH, если TLB этого
+// PCID ещё актуален. Kernel context - PCID 0, всегда со сбросом
+static uint64_t vmm_pcid_select(vmm_context_t* ctx) {
+    vmm_cpu_tlb_t* cpu = &vmm_cpu_tlb[smp_current_cpu()];
+    cpu->switches++;
+
+    // Снятое в kernel heap могло остаться в любом PCID этого CPU
+    uint64_t kernel_gen = atomic_load_u64(&vmm_kernel_tlb_gen);
+    if (cpu->kernel_gen != kernel_gen) {
+        memset(cpu->tlb_id, 0, sizeof(cpu->tlb_id));
+        cpu->kernel_gen = kernel_gen;
+    }
+
+    if (ctx == kernel_context) {
+        cpu->current_slot = VMM_PCID_NONE;
+        return ctx->pml4_phys;
+    }
+
+    uint64_t gen = atomic_load_u64(&ctx->tlb_gen);
+    uint32_t slot = 0;
+    while (slot < VMM_PCID_SLOTS && cpu->tlb_id[slot] != ctx->tlb_id) {
+        slot++;
+    }
+
+    if (slot == VMM_PCID_SLOTS) {
+        // Новый для этого CPU: следующий slot по кругу, его PCID сбрасывается
+        slot = cpu->next_slot;
+        cpu->next_slot = (slot + 1) % VMM_PCID_SLOTS;
+        cpu->tlb_id[slot] = ctx->tlb_id;
+    } else if (cpu->tlb_gen[slot] == gen) {
+        cpu->current_slot = slot;
+        cpu->preserved++;
+        return ctx->pml4_phys | (slot + 1) | VMM_CR3_NOFLUSH;
+    }
+
+    cpu->tlb_gen[slot] = gen;
+    cpu->current_slot = slot;
+    return ctx->pml4_phys | (slot + 1);
+}
+
+void vmm_init_cpu(void) {
+    uint64_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+
+    // Global: identity map (в нём код и данные ядра) переживает смену CR3.
+    // Она одинакова во всех контекстах и после vmm_init не меняется
+    cr4 |= VMM_CR4_PGE;
+
+    // PCIDE - только при CR3[11:0] = 0: здесь загружен kernel context
+    if (vmm_pcid_enabled) {
+        cr4 |= VMM_CR4_PCIDE;
+    }
+    asm volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+
+    vmm_cpu_tlb[smp_current_cpu()].current_slot = VMM_PCID_NONE;
+}
+
 // ========== PAGE TABLE MANIPULATION (helpers) ==========
 
 // Internal: walk and create intermediate tables up to `level` (1..3). Return pointer to that table (virtual).
@@ -112,6 +335,10 @@ page_table_t* vmm_get_or_create_table(vmm_context_t* ctx, uintptr_t virt_addr, i
             // Map it with kernel + user flags (intermediate tables need USER bit!)
             // CRITICAL: All levels of page tables must have USER bit for Ring 3 access
             *entry = vmm_make_pte(new_table_phys, VMM_FLAGS_KERNEL_RW | VMM_FLAG_USER);
+        } else if (*entry & VMM_FLAG_LARGE_PAGE) {
+            // 2MB/1GB страница на пути: таблицы ниже нет (см. vmm_split_large_page)
+            vmm_set_error("Address is covered by a large page");
+            return NULL;
         }
 
         // Move to next level (phys -> virtual pointer)
@@ -173,6 +400,95 @@ pte_t* vmm_get_pte(vmm_context_t* ctx, uintptr_t virt_addr) {
     return vmm_get_pte_noalloc(ctx, virt_addr);
 }
 
+// vmm_get_leaf -> entry that actually maps virt_addr, whatever its level (no allocation)
+pte_t* vmm_get_leaf(vmm_context_t* ctx, uintptr_t virt_addr, size_t* size) {
+    if (!ctx || !ctx->pml4) return NULL;
+
+    pte_t pml4_entry = ctx->pml4->entries[VMM_PML4_INDEX(virt_addr)];
+    if (!(pml4_entry & VMM_FLAG_PRESENT)) return NULL;
+
+    page_table_t* pdpt = (page_table_t*)vmm_phys_to_virt(vmm_pte_to_phys(pml4_entry));
+    pte_t* pdpt_entry = &pdpt->entries[VMM_PDPT_INDEX(virt_addr)];
+    if (!(*pdpt_entry & VMM_FLAG_PRESENT)) return NULL;
+    if (*pdpt_entry & VMM_FLAG_LARGE_PAGE) {
+        if (size) *size = VMM_HUGE_PAGE_SIZE;
+        return pdpt_entry;
+    }
+
+    page_table_t* pd = (page_table_t*)vmm_phys_to_virt(vmm_pte_to_phys(*pdpt_entry));
+    pte_t* pd_entry = &pd->entries[VMM_PD_INDEX(virt_addr)];
+    if (!(*pd_entry & VMM_FLAG_PRESENT)) return NULL;
+    if (*pd_entry & VMM_FLAG_LARGE_PAGE) {
+        if (size) *size = VMM_LARGE_PAGE_SIZE;
+        return pd_entry;
+    }
+
+    page_table_t* pt = (page_table_t*)vmm_phys_to_virt(vmm_pte_to_phys(*pd_entry));
+    pte_t* pte = &pt->entries[VMM_PT_INDEX(virt_addr)];
+    if (!(*pte & VMM_FLAG_PRESENT)) return NULL;
+    if (size) *size = VMM_PAGE_SIZE;
+    return pte;
+}
+
+// Internal (ctx->lock held): 2MB PD entry -> PT из 512 PTE с теми же флагами,
+// чтобы менять одну 4KB страницу внутри. 1GB страницы не дробим.
+static bool vmm_split_large_page(pte_t* pd_entry, uintptr_t virt_addr) {
+    uintptr_t pt_phys = vmm_alloc_page_table();
+    if (!pt_phys) return false;
+
+    page_table_t* pt = (page_table_t*)vmm_phys_to_virt(pt_phys);
+    uintptr_t phys_base = vmm_pte_to_phys(*pd_entry) & ~(VMM_LARGE_PAGE_SIZE - 1);
+    uint64_t flags = vmm_pte_to_flags(*pd_entry) & ~VMM_FLAG_LARGE_PAGE;
+    for (size_t i = 0; i < VMM_LARGE_PAGE_PAGES; i++) {
+        pt->entries[i] = vmm_make_pte(phys_base + i * VMM_PAGE_SIZE, flags);
+    }
+
+    *pd_entry = vmm_make_pte(pt_phys, VMM_FLAGS_KERNEL_RW | VMM_FLAG_USER);
+    // invlpg любого адреса внутри сбрасывает всю 2MB запись TLB
+    vmm_flush_tlb_page(virt_addr & ~(VMM_LARGE_PAGE_SIZE - 1));
+    return true;
+}
+
+// Internal (ctx->lock held): 4KB PTE для virt_addr, 2MB страница дробится
+static pte_t* vmm_get_pte_split(vmm_context_t* ctx, uintptr_t virt_addr) {
+    size_t size = 0;
+    pte_t* leaf = vmm_get_leaf(ctx, virt_addr, &size);
+    if (!leaf) return NULL;
+    if (size == VMM_PAGE_SIZE) return leaf;
+    if (size != VMM_LARGE_PAGE_SIZE || !vmm_split_large_page(leaf, virt_addr)) {
+        vmm_set_error("Failed to split large page");
+        return NULL;
+    }
+    return vmm_get_pte_noalloc(ctx, virt_addr);
+}
+
+// Internal (ctx->lock held): учёт mapped/kernel/user страниц
+static void vmm_account_pages(vmm_context_t* ctx, uint64_t flags, size_t pages, bool mapped) {
+    spin_lock(&vmm_global_lock);
+    if (mapped) {
+        ctx->mapped_pages += pages;
+        if (flags & VMM_FLAG_USER) {
+            ctx->user_pages += pages;
+            global_stats.user_mapped_pages += pages;
+        } else {
+            ctx->kernel_pages += pages;
+            global_stats.kernel_mapped_pages += pages;
+        }
+        global_stats.total_mapped_pages += pages;
+    } else {
+        ctx->mapped_pages -= MIN(ctx->mapped_pages, pages);
+        if (flags & VMM_FLAG_USER) {
+            ctx->user_pages -= MIN(ctx->user_pages, pages);
+            global_stats.user_mapped_pages -= MIN(global_stats.user_mapped_pages, pages);
+        } else {
+            ctx->kernel_pages -= MIN(ctx->kernel_pages, pages);
+            global_stats.kernel_mapped_pages -= MIN(global_stats.kernel_mapped_pages, pages);
+        }
+        global_stats.total_mapped_pages -= MIN(global_stats.total_mapped_pages, pages);
+    }
+    spin_unlock(&vmm_global_lock);
+}
+
 
 
 // ========== CONTEXT MANAGEMENT ==========
@@ -195,12 +511,22 @@ vmm_context_t* vmm_create_context(void) {
 
     ctx->pml4 = (page_table_t*)pml4_phys;
     ctx->pml4_phys = pml4_phys;
+    ctx->tlb_id = atomic_increment_u64(&vmm_next_tlb_id);
     ctx->heap_start = VMM_USER_HEAP_BASE;
     ctx->heap_end = VMM_USER_HEAP_BASE;
     ctx->stack_top = VMM_USER_STACK_TOP;
 
     spinlock_init(&ctx->lock);
 
+    // vmm_init заменяет окно kernel context на kernel heap
+    if (!vmm_region_space_init(&ctx->regions, VMM_USER_REGION_BASE,
+                               VMM_USER_REGION_END - VMM_USER_REGION_BASE)) {
+        vmm_free_page_table(pml4_phys);
+        kfree(ctx);
+        vmm_set_error("Failed to allocate VMM region tree");
+        return NULL;
+    }
+
     // Copy kernel mappings from kernel_context if we have one
     if (kernel_context && kernel_context->pml4) {
 
@@ -214,6 +540,7 @@ vmm_context_t* vmm_create_context(void) {
         // Allocate new PDPT for this context
         uintptr_t new_pdpt_phys = vmm_alloc_page_table();
         if (!new_pdpt_phys) {
+            vmm_region_space_destroy(&ctx->regions);
             vmm_free_page_table(pml4_phys);
             kfree(ctx);
             vmm_set_error("Failed to allocate PDPT for new context");
@@ -241,6 +568,7 @@ vmm_context_t* vmm_create_context(void) {
                     uintptr_t new_pd_phys = vmm_alloc_page_table();
                     if (!new_pd_phys) {
                         vmm_free_page_table(new_pdpt_phys);
+                        vmm_region_space_destroy(&ctx->regions);
                         vmm_free_page_table(pml4_phys);
                         kfree(ctx);
                         vmm_set_error("Failed to allocate PD for identity mapping");
@@ -283,56 +611,45 @@ vmm_context_t* vmm_create_context(void) {
     return ctx;
 }
 
-// Helper: free user-space page tables & mapped pages for a context
+// Helper: free user-space page tables & mapped pages for a context.
+// Контекст уже не загружен ни на одном CPU (process_destroy переключается на
+// kernel CR3, tlb_id не переиспользуется) - TLB сбрасывать не нужно, записи
+// таблиц не чистим: таблицы освобождаются целиком. Страницы и таблицы - в
+// PMM через batch, подряд идущие - одним pmm_free
 static void vmm_free_user_space_tables(vmm_context_t* ctx) {
     if (!ctx || !ctx->pml4) return;
 
-    kprintf("[VMM] Freeing user space tables for context CR3=0x%lx\n", ctx->pml4_phys);
-
-    // Only iterate low half (user space): PML4 indices 0..255
-        // NOTE: After the fix, PML4[0] has its own PDPT/PD per context (not shared)
-
-    // We still skip freeing kernel identity-mapped large pages (0-256MB)
+    vmm_tlb_batch_t batch;
+    vmm_tlb_batch_init(&batch, ctx);
+    size_t freed_pages = 0;
+    size_t freed_tables = 0;
 
+    // Only iterate low half (user space): PML4 indices 0..255.
+    // PML4[0] has its own PDPT/PD per context (not shared); kernel identity
+    // 2MB pages (0-256MB) in it are skipped
     for (int p4 = 0; p4 < 256; p4++) {
-
         pte_t pml4_entry = ctx->pml4->entries[p4];
         if (!(pml4_entry & VMM_FLAG_PRESENT)) continue;
- 
+
         uintptr_t pdpt_phys = vmm_pte_to_phys(pml4_entry);
         page_table_t* pdpt = (page_table_t*)vmm_phys_to_virt(pdpt_phys);
 
-        // No longer shared - this context owns its PDPT for PML4[0]
-        int is_shared_kernel = 0;  // Always free PDPT/PD now
-
-        // iterate PDPT entries
         for (int p3 = 0; p3 < 512; p3++) {
             pte_t pdpt_entry = pdpt->entries[p3];
-            if (!(pdpt_entry & VMM_FLAG_PRESENT)) continue;
-
             // SKIP 1GB large pages - these are kernel mappings
-            if (pdpt_entry & VMM_FLAG_LARGE_PAGE) {
-                continue;  // Skip kernel large pages
-            }
+            if (!(pdpt_entry & VMM_FLAG_PRESENT) || (pdpt_entry & VMM_FLAG_LARGE_PAGE)) continue;
 
             uintptr_t pd_phys = vmm_pte_to_phys(pdpt_entry);
             page_table_t* pd = (page_table_t*)vmm_phys_to_virt(pd_phys);
 
-            // iterate PD entries
             for (int p2 = 0; p2 < 512; p2++) {
                 pte_t pd_entry = pd->entries[p2];
-                if (!(pd_entry & VMM_FLAG_PRESENT)) continue;
-
                 // SKIP 2MB large pages - these are kernel identity mappings
-                if (pd_entry & VMM_FLAG_LARGE_PAGE) {
-                    continue;  // Skip kernel large pages
-                }
+                if (!(pd_entry & VMM_FLAG_PRESENT) || (pd_entry & VMM_FLAG_LARGE_PAGE)) continue;
 
                 uintptr_t pt_phys = vmm_pte_to_phys(pd_entry);
                 page_table_t* pt = (page_table_t*)vmm_phys_to_virt(pt_phys);
 
-                // iterate PT entries (leaf pages) - FREE DATA PAGES
-                int freed_pages = 0;
                 for (int p1 = 0; p1 < 512; p1++) {
                     pte_t pt_entry = pt->entries[p1];
                     if (!(pt_entry & VMM_FLAG_PRESENT)) continue;
@@ -340,39 +657,35 @@ static void vmm_free_user_space_tables(vmm_context_t* ctx) {
                     uintptr_t phys = vmm_pte_to_phys(pt_entry);
 
                     // CRITICAL: Only free if it's a user page (not kernel/shared)
-                    // User pages are below 0x20000000 (512MB) in our memory map
-                    if (phys >= 0x100000 && phys < 0x20000000) {
-                        pmm_free((void*)phys, 1);
+                    // User pages are below 0x20000000 (512MB) in our memory map.
+                    // VMM_FLAG_SHARED - страницы кэша ELF образов, их отпускает elf_image_release
+                    if (phys >= 0x100000 && phys < 0x20000000 && !(pt_entry & VMM_FLAG_SHARED)) {
+                        vmm_tlb_batch_free(&batch, phys, 1);
                         freed_pages++;
                     }
-
-                    pt->entries[p1] = 0;
-                }
-
-                if (freed_pages > 0) {
-                    kprintf("[VMM]   Freed %d data pages from PT\n", freed_pages);
                 }
 
-                // Free PT table itself (always safe - user-allocated)
-                vmm_free_page_table(pt_phys);
-                pd->entries[p2] = 0;
+                vmm_tlb_batch_free(&batch, pt_phys, 1);
+                freed_tables++;
             }
 
-            // Free PD table (only if not shared with kernel)
-            if (!is_shared_kernel) {
-                vmm_free_page_table(pd_phys);
-                pdpt->entries[p3] = 0;
-            }
+            vmm_tlb_batch_free(&batch, pd_phys, 1);
+            freed_tables++;
         }
 
-        // Free PDPT table (only if not shared with kernel)
-        if (!is_shared_kernel) {
-            vmm_free_page_table(pdpt_phys);
-            ctx->pml4->entries[p4] = 0;
-        }
+        vmm_tlb_batch_free(&batch, pdpt_phys, 1);
+        freed_tables++;
+        ctx->pml4->entries[p4] = 0;
     }
 
-    kprintf("[VMM] User space tables freed\n");
+    vmm_tlb_batch_finish(&batch);
+
+    spin_lock(&vmm_global_lock);
+    global_stats.page_tables_allocated -= MIN(global_stats.page_tables_allocated, freed_tables);
+    spin_unlock(&vmm_global_lock);
+
+    kprintf("[VMM] Freed user space of CR3=0x%lx: %zu pages, %zu page tables\n",
+            ctx->pml4_phys, freed_pages, freed_tables);
 }
 
 void vmm_destroy_context(vmm_context_t* ctx) {
@@ -390,6 +703,7 @@ void vmm_destroy_context(vmm_context_t* ctx) {
 
     spin_unlock(&ctx->lock);
 
+    vmm_region_space_destroy(&ctx->regions);
     kfree(ctx);
 
     spin_lock(&vmm_global_lock);
@@ -408,9 +722,15 @@ vmm_context_t* vmm_get_current_context(void) {
 void vmm_switch_context(vmm_context_t* ctx) {
     if (!ctx || !ctx->pml4_phys) return;
 
+    uint64_t irq = vmm_irq_save();
     current_context = ctx;
-    asm volatile("mov %0, %%cr3" : : "r"(ctx->pml4_phys) : "memory");
-    vmm_flush_tlb();
+    uint64_t cr3 = vmm_pcid_enabled ? vmm_pcid_select(ctx) : ctx->pml4_phys;
+    asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+    vmm_irq_restore(irq);
+
+    if (!vmm_pcid_enabled) {
+        vmm_cpu_tlb[smp_current_cpu()].switches++;
+    }
 }
 
 // ========== MEMORY MAPPING ==========
@@ -495,6 +815,53 @@ vmm_map_result_t vmm_map_page(vmm_context_t* ctx, uintptr_t virt_addr,
     return result;
 }
 
+vmm_map_result_t vmm_map_large_page(vmm_context_t* ctx, uintptr_t virt_addr,
+                                    uintptr_t phys_addr, uint64_t flags) {
+    vmm_map_result_t result = {0};
+
+    if (!ctx) {
+        result.error_msg = "Invalid context";
+        return result;
+    }
+
+    if ((virt_addr | phys_addr) & (VMM_LARGE_PAGE_SIZE - 1)) {
+        result.error_msg = "Address not 2MB-aligned";
+        return result;
+    }
+
+    spin_lock(&ctx->lock);
+
+    page_table_t* pd = vmm_get_or_create_table(ctx, virt_addr, 2);
+    if (!pd) {
+        spin_unlock(&ctx->lock);
+        result.error_msg = "Failed to get/create page directory";
+        return result;
+    }
+
+    // Занятая запись (PT с 4KB страницами или другая 2MB) - не трогаем:
+    // PT мог бы остаться без владельца
+    pte_t* pd_entry = &pd->entries[VMM_PD_INDEX(virt_addr)];
+    if (*pd_entry & VMM_FLAG_PRESENT) {
+        spin_unlock(&ctx->lock);
+        result.error_msg = "Page directory entry already in use";
+        return result;
+    }
+
+    *pd_entry = vmm_make_pte(phys_addr, flags | VMM_FLAG_LARGE_PAGE);
+    vmm_account_pages(ctx, flags, VMM_LARGE_PAGE_PAGES, true);
+
+    spin_unlock(&ctx->lock);
+
+    vmm_flush_tlb_page(virt_addr);
+
+    result.success = true;
+    result.virt_addr = virt_addr;
+    result.phys_addr = phys_addr;
+    result.pages_mapped = VMM_LARGE_PAGE_PAGES;
+
+    return result;
+}
+
 vmm_map_result_t vmm_map_pages(vmm_context_t* ctx, uintptr_t virt_addr,
                                uintptr_t phys_addr, size_t page_count, uint64_t flags) {
     vmm_map_result_t result = {0};
@@ -509,9 +876,7 @@ vmm_map_result_t vmm_map_pages(vmm_context_t* ctx, uintptr_t virt_addr,
 
         if (!single_result.success) {
             // Rollback previous mappings
-            for (size_t j = 0; j < i; j++) {
-                vmm_unmap_page(ctx, virt_addr + j * VMM_PAGE_SIZE);
-            }
+            vmm_unmap_pages(ctx, virt_addr, i);
             result.error_msg = single_result.error_msg;
             return result;
         }
@@ -523,55 +888,68 @@ vmm_map_result_t vmm_map_pages(vmm_context_t* ctx, uintptr_t virt_addr,
     return result;
 }
 
-bool vmm_unmap_page(vmm_context_t* ctx, uintptr_t virt_addr) {
-    if (!ctx || !vmm_is_page_aligned(virt_addr)) return false;
+// Internal: снять [virt_addr, +page_count) одним захватом ctx->lock, сброс TLB
+// и (free_phys) освобождение страниц - через batch. 2MB страница, которую
+// диапазон покрывает целиком, снимается одной записью, иначе дробится.
+// VMM_FLAG_SHARED страницы не освобождаются. false = не всё было отображено
+static bool vmm_unmap_range(vmm_context_t* ctx, uintptr_t virt_addr, size_t page_count,
+                            vmm_tlb_batch_t* batch, bool free_phys) {
+    bool success = true;
 
     spin_lock(&ctx->lock);
 
-    pte_t* pte = vmm_get_pte(ctx, virt_addr); // noalloc
-    if (!pte || !(*pte & VMM_FLAG_PRESENT)) {
-        spin_unlock(&ctx->lock);
-        return false;
-    }
-
-    // Update statistics (only counts, do not free physical pages here)
-    uint64_t flags = vmm_pte_to_flags(*pte);
-    if (flags & VMM_FLAG_USER) {
-        if (ctx->user_pages > 0) ctx->user_pages--;
-        spin_lock(&vmm_global_lock);
-        if (global_stats.user_mapped_pages > 0) global_stats.user_mapped_pages--;
-        if (global_stats.total_mapped_pages > 0) global_stats.total_mapped_pages--;
-        spin_unlock(&vmm_global_lock);
-    } else {
-        if (ctx->kernel_pages > 0) ctx->kernel_pages--;
-        spin_lock(&vmm_global_lock);
-        if (global_stats.kernel_mapped_pages > 0) global_stats.kernel_mapped_pages--;
-        if (global_stats.total_mapped_pages > 0) global_stats.total_mapped_pages--;
-        spin_unlock(&vmm_global_lock);
-    }
+    for (size_t i = 0; i < page_count; ) {
+        uintptr_t addr = virt_addr + i * VMM_PAGE_SIZE;
+
+        size_t size = 0;
+        pte_t* leaf = vmm_get_leaf(ctx, addr, &size);
+        if (leaf && size == VMM_LARGE_PAGE_SIZE &&
+            !(addr & (VMM_LARGE_PAGE_SIZE - 1)) && page_count - i >= VMM_LARGE_PAGE_PAGES) {
+            uintptr_t phys = vmm_pte_to_phys(*leaf);
+            vmm_account_pages(ctx, vmm_pte_to_flags(*leaf), VMM_LARGE_PAGE_PAGES, false);
+            *leaf = 0;
+            vmm_tlb_batch_add(batch, addr, VMM_LARGE_PAGE_SIZE);
+            if (free_phys) {
+                vmm_tlb_batch_free(batch, phys, VMM_LARGE_PAGE_PAGES);
+            }
+            i += VMM_LARGE_PAGE_PAGES;
+            continue;
+        }
 
-    if (ctx->mapped_pages > 0) ctx->mapped_pages--;
+        // Страница внутри 2MB mapping'а: сначала дробим его
+        pte_t* pte = leaf ? vmm_get_pte_split(ctx, addr) : NULL;
+        if (!pte || !(*pte & VMM_FLAG_PRESENT)) {
+            success = false;
+            i++;
+            continue;
+        }
 
-    // Clear the PTE
-    *pte = 0;
+        pte_t old = *pte;
+        vmm_account_pages(ctx, vmm_pte_to_flags(old), 1, false);
+        *pte = 0;
+        vmm_tlb_batch_add(batch, addr, VMM_PAGE_SIZE);
+        if (free_phys && !(old & VMM_FLAG_SHARED)) {
+            vmm_tlb_batch_free(batch, vmm_pte_to_phys(old), 1);
+        }
+        i++;
+    }
 
     spin_unlock(&ctx->lock);
+    return success;
+}
 
-    // Invalidate TLB
-    vmm_flush_tlb_page(virt_addr);
-
-    return true;
+bool vmm_unmap_page(vmm_context_t* ctx, uintptr_t virt_addr) {
+    return vmm_unmap_pages(ctx, virt_addr, 1);
 }
 
 bool vmm_unmap_pages(vmm_context_t* ctx, uintptr_t virt_addr, size_t page_count) {
-    bool success = true;
-
-    for (size_t i = 0; i < page_count; i++) {
-        if (!vmm_unmap_page(ctx, virt_addr + i * VMM_PAGE_SIZE)) {
-            success = false;
-        }
-    }
+    if (!ctx || !vmm_is_page_aligned(virt_addr)) return false;
 
+    // Only counts, do not free physical pages here
+    vmm_tlb_batch_t batch;
+    vmm_tlb_batch_init(&batch, ctx);
+    bool success = vmm_unmap_range(ctx, virt_addr, page_count, &batch, false);
+    vmm_tlb_batch_finish(&batch);
     return success;
 }
 
@@ -582,8 +960,6 @@ void* vmm_alloc_pages(vmm_context_t* ctx, size_t page_count, uint64_t flags) {
         return NULL;
     }
 
-    kprintf("[VMM] vmm_alloc_pages: requesting %zu pages with flags 0x%llx\n", page_count, (unsigned long long)flags);
-
     // Allocate physical pages first (returns pointer to physical memory)
     void* phys_pages = pmm_alloc(page_count);
     if (!phys_pages) {
@@ -592,58 +968,35 @@ void* vmm_alloc_pages(vmm_context_t* ctx, size_t page_count, uint64_t flags) {
         return NULL;
     }
 
-    kprintf("[VMM] PMM allocated %zu pages at physical 0x%p\n", page_count, phys_pages);
-
     uintptr_t phys_base = (uintptr_t)phys_pages;
-    uintptr_t virt_base;
-
-    // Find virtual address space
-    if (flags & VMM_FLAG_USER) {
-        virt_base = vmm_find_free_region(ctx, vmm_pages_to_size(page_count),
-                                         VMM_USER_BASE, VMM_USER_STACK_TOP);
-        if (!virt_base) {
-            pmm_free(phys_pages, page_count);
-            vmm_set_error("Failed to find user virtual address space");
-            kprintf("[VMM] Failed to find user virtual space for %zu pages\n", page_count);
-            return NULL;
-        }
-        kprintf("[VMM] Found user virtual space at 0x%p\n", (void*)virt_base);
-    } else {
-        // Kernel allocation - use simple sequential allocation
-        spin_lock(&kernel_heap_lock);
-        virt_base = kernel_heap_current;
-
-        kprintf("[VMM] Current kernel heap pointer: 0x%p\n", (void*)kernel_heap_current);
-        kprintf("[VMM] Kernel heap base: 0x%p\n", (void*)VMM_KERNEL_HEAP_BASE);
-        kprintf("[VMM] Kernel heap size: 0x%llx\n", (unsigned long long)VMM_KERNEL_HEAP_SIZE);
 
-        // Check if we have enough space (basic check)
-        if (virt_base + vmm_pages_to_size(page_count) > VMM_KERNEL_HEAP_BASE + VMM_KERNEL_HEAP_SIZE) {
-            spin_unlock(&kernel_heap_lock);
-            pmm_free(phys_pages, page_count);
-            vmm_set_error("Kernel heap exhausted");
-            kprintf("[VMM] ERROR: Kernel heap exhausted! Current: 0x%p, need: 0x%llx, limit: 0x%p\n",
-                   (void*)virt_base, (unsigned long long)vmm_pages_to_size(page_count),
-                   (void*)(VMM_KERNEL_HEAP_BASE + VMM_KERNEL_HEAP_SIZE));
-            return NULL;
-        }
-
-        kernel_heap_current += vmm_pages_to_size(page_count);
-        spin_unlock(&kernel_heap_lock);
-
-        kprintf("[VMM] Kernel allocation: virt=0x%p, phys=0x%p, pages=%zu\n",
-               (void*)virt_base, (void*)phys_base, page_count);
+    // Virtual range from the context's region tree (kernel heap window or user window).
+    // От 2MB - VA с 2MB границы: PMM отдаёт такие блоки выровненными
+    // по порядку buddy, и диапазон ложится на 2MB страницы
+    size_t align = (!(flags & VMM_FLAG_USER) && page_count >= VMM_LARGE_PAGE_PAGES)
+                   ? VMM_LARGE_PAGE_SIZE : VMM_PAGE_SIZE;
+    uintptr_t virt_base = vmm_region_alloc(&ctx->regions, vmm_pages_to_size(page_count), align, 0);
+    if (!virt_base) {
+        pmm_free(phys_pages, page_count);
+        vmm_set_error("Virtual address space exhausted");
+        kprintf("[VMM] ERROR: no virtual space for %zu pages (%s)\n", page_count,
+                (flags & VMM_FLAG_USER) ? "user" : "kernel heap");
+        return NULL;
     }
 
-    // Map the pages individually for better error handling
-    for (size_t i = 0; i < page_count; i++) {
+    // 2MB страницами - где virt и phys оба выровнены и до конца >= 2MB,
+    // остальное (края) - 4KB PTE
+    for (size_t i = 0; i < page_count; ) {
         uintptr_t virt_addr = virt_base + i * VMM_PAGE_SIZE;
         uintptr_t phys_addr = phys_base + i * VMM_PAGE_SIZE;
 
-        kprintf("[VMM] Mapping page %zu/%zu: virt=0x%p -> phys=0x%p\n",
-               i + 1, page_count, (void*)virt_addr, (void*)phys_addr);
+        bool large = !(flags & VMM_FLAG_USER) &&
+                     page_count - i >= VMM_LARGE_PAGE_PAGES &&
+                     !((virt_addr | phys_addr) & (VMM_LARGE_PAGE_SIZE - 1));
 
-        vmm_map_result_t result = vmm_map_page(ctx, virt_addr, phys_addr, flags);
+        vmm_map_result_t result = large
+            ? vmm_map_large_page(ctx, virt_addr, phys_addr, flags)
+            : vmm_map_page(ctx, virt_addr, phys_addr, flags);
 
         if (!result.success) {
             kprintf("[VMM] ERROR: Failed to map page %zu/%zu (virt=0x%p, phys=0x%p): %s\n",
@@ -651,17 +1004,43 @@ void* vmm_alloc_pages(vmm_context_t* ctx, size_t page_count, uint64_t flags) {
                    result.error_msg ? result.error_msg : "unknown error");
 
             // Rollback previous mappings
-            for (size_t j = 0; j < i; j++) {
-                vmm_unmap_page(ctx, virt_base + j * VMM_PAGE_SIZE);
-            }
+            vmm_unmap_pages(ctx, virt_base, i);
+            vmm_region_free(&ctx->regions, virt_base);
 
             pmm_free(phys_pages, page_count);
             vmm_set_error(result.error_msg);
             return NULL;
         }
+
+        i += result.pages_mapped;
     }
 
-    kprintf("[VMM] SUCCESS: Allocated %zu pages at virtual 0x%p\n", page_count, (void*)virt_base);
+    TRACE_DEBUG(TRACE_VMM_ALLOC, virt_base, page_count);
+    return (void*)virt_base;
+}
+
+void* vmm_alloc_pages_lazy(vmm_context_t* ctx, size_t page_count, uint64_t flags) {
+    return vmm_alloc_pages_lazy_aligned(ctx, page_count, VMM_PAGE_SIZE, flags);
+}
+
+void* vmm_alloc_pages_lazy_aligned(vmm_context_t* ctx, size_t page_count, size_t align,
+                                   uint64_t flags) {
+    if (!ctx || page_count == 0) {
+        return NULL;
+    }
+
+    // Только адреса: страницы - из vmm_handle_page_fault, нулевые
+    flags |= VMM_FLAG_PRESENT;
+    uintptr_t virt_base = vmm_region_alloc(&ctx->regions, vmm_pages_to_size(page_count),
+                                           align, flags);
+    if (!virt_base) {
+        vmm_set_error("Virtual address space exhausted");
+        kprintf("[VMM] ERROR: no virtual space for %zu lazy pages (%s)\n", page_count,
+                (flags & VMM_FLAG_USER) ? "user" : "kernel heap");
+        return NULL;
+    }
+
+    TRACE_DEBUG(TRACE_VMM_ALLOC, virt_base, page_count);
     return (void*)virt_base;
 }
 
@@ -670,74 +1049,39 @@ void vmm_free_pages(vmm_context_t* ctx, void* virt_addr, size_t page_count) {
 
     uintptr_t virt_base = (uintptr_t)virt_addr;
 
-    // Collect physical addresses
-    uintptr_t* phys_addrs = kmalloc(page_count * sizeof(uintptr_t));
-    if (phys_addrs) {
-        for (size_t i = 0; i < page_count; i++) {
-            phys_addrs[i] = vmm_virt_to_phys(ctx, virt_base + i * VMM_PAGE_SIZE);
-        }
-    }
+    // Один сброс TLB на весь диапазон, страницы в PMM - после него
+    vmm_tlb_batch_t batch;
+    vmm_tlb_batch_init(&batch, ctx);
+    vmm_unmap_range(ctx, virt_base, page_count, &batch, true);
+    vmm_tlb_batch_finish(&batch);
 
-    // Unmap virtual pages (does not free physical)
-    vmm_unmap_pages(ctx, virt_base, page_count);
-
-    // Free physical pages
-    if (phys_addrs) {
-        for (size_t i = 0; i < page_count; i++) {
-            if (phys_addrs[i]) {
-                pmm_free((void*)phys_addrs[i], 1);
-            }
-        }
-        kfree(phys_addrs);
-    }
+    // Адреса - обратно в дерево, когда отображения уже нет
+    // (не регион vmm_alloc_pages - ничего не делает)
+    vmm_region_free(&ctx->regions, virt_base);
+    TRACE_DEBUG(TRACE_VMM_FREE, virt_base, page_count);
 }
 
 // ========== KERNEL HEAP (vmalloc) ==========
+// Регион vmalloc - запись в busy дереве kernel context: vfree находит
+// размер по адресу за O(log n), отдельного списка нет
 void* vmalloc(size_t size) {
     if (size == 0) {
         kprintf("[VMM] vmalloc: size is 0\n");
         return NULL;
     }
 
-    if (!vmm_initialized) {
+    if (!vmm_initialized || !kernel_context) {
         kprintf("[VMM] vmalloc: VMM not initialized\n");
         return NULL;
     }
 
     size_t page_count = vmm_size_to_pages(size);
-    kprintf("[VMM] vmalloc: requested %zu bytes (%zu pages)\n", size, page_count);
-
-    vmm_context_t* ctx = vmm_get_current_context();
-    if (!ctx) {
-        kprintf("[VMM] vmalloc: no current context\n");
-        return NULL;
-    }
-
-    void* virt = vmm_alloc_pages(ctx, page_count, VMM_FLAGS_KERNEL_RW);
+    void* virt = vmm_alloc_pages(kernel_context, page_count, VMM_FLAGS_KERNEL_RW);
     if (!virt) {
-        kprintf("[VMM] vmalloc FAILED: %s\n", vmm_get_last_error());
+        kprintf("[VMM] vmalloc FAILED (%zu pages): %s\n", page_count, vmm_get_last_error());
         return NULL;
     }
 
-    uintptr_t phys_first = vmm_virt_to_phys(ctx, (uintptr_t)virt);
-    kprintf("[VMM] vmalloc: allocated virt=%p phys=%p pages=%zu\n",
-            virt, (void*)phys_first, page_count);
-
-    // Register allocation for vfree
-    vmalloc_entry_t* ent = kmalloc(sizeof(vmalloc_entry_t));
-    if (ent) {
-        ent->virt_base = virt;
-        ent->pages = page_count;
-        spin_lock(&vmalloc_lock);
-        ent->next = vmalloc_list;
-        vmalloc_list = ent;
-        spin_unlock(&vmalloc_lock);
-        kprintf("[VMM] vmalloc: recorded allocation (%p, %zu pages)\n", virt, page_count);
-    } else {
-        kprintf("[VMM] vmalloc: WARNING: could not record allocation for vfree()\n");
-    }
-
-    kprintf("[VMM] vmalloc SUCCESS: %p (%zu pages)\n", virt, page_count);
     return virt;
 }
 
@@ -751,50 +1095,53 @@ void* vzalloc(size_t size) {
 }
 
 void vfree(void* addr) {
-    if (!addr) {
-        kprintf("[VMM] vfree: null pointer, nothing to free\n");
+    if (!addr || !kernel_context) {
         return;
     }
 
-    spin_lock(&vmalloc_lock);
-    vmalloc_entry_t* prev = NULL;
-    vmalloc_entry_t* cur = vmalloc_list;
-
-    while (cur) {
-        if (cur->virt_base == addr) {
-            // Found allocation
-            if (prev) prev->next = cur->next;
-            else vmalloc_list = cur->next;
-            spin_unlock(&vmalloc_lock);
-
-            kprintf("[VMM] vfree: freeing allocation at %p (%zu pages)\n",
-                    addr, cur->pages);
+    size_t size = vmm_region_size(&kernel_context->regions, (uintptr_t)addr);
+    if (!size) {
+        kprintf("[VMM] vfree: WARNING: %p is not a vmalloc allocation\n", addr);
+        return;
+    }
 
-            vmm_free_pages(vmm_get_current_context(), addr, cur->pages);
-            kfree(cur);
+    vmm_free_pages(kernel_context, addr, size / VMM_PAGE_SIZE);
+}
 
-            kprintf("[VMM] vfree: successfully freed %p\n", addr);
-            return;
-        }
-        prev = cur;
-        cur = cur->next;
+// ========== DEVICE MMIO ==========
+void* vmm_map_mmio(uintptr_t phys_addr, size_t size) {
+    if (!kernel_context || size == 0) {
+        vmm_set_error("vmm_map_mmio: VMM not initialized or zero size");
+        return NULL;
     }
 
-    spin_unlock(&vmalloc_lock);
+    uintptr_t phys_base = vmm_page_align_down(phys_addr);
+    uintptr_t offset = phys_addr - phys_base;
+    size_t pages = vmm_size_to_pages(size + offset);
 
-    // Not found — fallback mode
-    kprintf("[VMM] vfree: allocation not found in list, fallback free at %p\n", addr);
+    spin_lock(&mmio_lock);
+    if (mmio_current + vmm_pages_to_size(pages) > VMM_MMIO_BASE + VMM_MMIO_SIZE) {
+        spin_unlock(&mmio_lock);
+        vmm_set_error("vmm_map_mmio: MMIO window exhausted");
+        return NULL;
+    }
+    uintptr_t virt_base = mmio_current;
+    mmio_current += vmm_pages_to_size(pages);
+    spin_unlock(&mmio_lock);
 
-    uintptr_t phys = vmm_virt_to_phys(vmm_get_current_context(), (uintptr_t)addr);
-    if (phys) {
-        kprintf("[VMM] vfree: unmapped single page virt=%p phys=%p\n", addr, (void*)phys);
-        vmm_unmap_page(vmm_get_current_context(), (uintptr_t)addr);
-        pmm_free((void*)phys, 1);
-    } else {
-        kprintf("[VMM] vfree: WARNING: could not resolve physical address for %p\n", addr);
+    // Registers must not be cached
+    uint64_t flags = VMM_FLAGS_KERNEL_RW | VMM_FLAG_CACHE_DISABLE | VMM_FLAG_WRITE_THROUGH;
+    vmm_map_result_t result = vmm_map_pages(kernel_context, virt_base, phys_base, pages, flags);
+    if (!result.success) {
+        kprintf("[VMM] vmm_map_mmio: failed to map phys=0x%p (%zu pages): %s\n",
+                (void*)phys_base, pages, result.error_msg ? result.error_msg : "unknown");
+        return NULL;
     }
-}
 
+    kprintf("[VMM] MMIO phys=0x%p mapped at 0x%p (%zu pages)\n",
+            (void*)phys_base, (void*)virt_base, pages);
+    return (void*)(virt_base + offset);
+}
 
 // ========== ADDRESS TRANSLATION ==========
 uintptr_t vmm_virt_to_phys(vmm_context_t* ctx, uintptr_t virt_addr) {
@@ -802,14 +1149,15 @@ uintptr_t vmm_virt_to_phys(vmm_context_t* ctx, uintptr_t virt_addr) {
 
     spin_lock(&ctx->lock);
 
-    pte_t* pte = vmm_get_pte(ctx, virt_addr); // noalloc
-    if (!pte || !(*pte & VMM_FLAG_PRESENT)) {
+    size_t size = 0;
+    pte_t* pte = vmm_get_leaf(ctx, virt_addr, &size); // noalloc, 4KB/2MB/1GB
+    if (!pte) {
         spin_unlock(&ctx->lock);
         return 0;
     }
 
-    uintptr_t phys_base = vmm_pte_to_phys(*pte);
-    uintptr_t offset = virt_addr & VMM_PAGE_OFFSET_MASK;
+    uintptr_t phys_base = vmm_pte_to_phys(*pte) & ~(size - 1);
+    uintptr_t offset = virt_addr & (size - 1);
 
     spin_unlock(&ctx->lock);
 
@@ -825,8 +1173,8 @@ uint64_t vmm_get_page_flags(vmm_context_t* ctx, uintptr_t virt_addr) {
 
     spin_lock(&ctx->lock);
 
-    pte_t* pte = vmm_get_pte(ctx, virt_addr); // noalloc
-    if (!pte || !(*pte & VMM_FLAG_PRESENT)) {
+    pte_t* pte = vmm_get_leaf(ctx, virt_addr, NULL); // noalloc
+    if (!pte) {
         spin_unlock(&ctx->lock);
         return 0;
     }
@@ -849,10 +1197,15 @@ uintptr_t vmm_find_free_region(vmm_context_t* ctx, size_t size, uintptr_t start,
 
         // Check pages
         for (size_t i = 0; i < pages_needed; i++) {
-            if (vmm_is_mapped(ctx, current + i * VMM_PAGE_SIZE)) {
+            uintptr_t addr = current + i * VMM_PAGE_SIZE;
+            size_t size = 0;
+            spin_lock(&ctx->lock);
+            pte_t* leaf = vmm_get_leaf(ctx, addr, &size);
+            spin_unlock(&ctx->lock);
+            if (leaf) {
                 region_free = false;
-                // skip past this mapped page
-                uintptr_t next = current + (i + 1) * VMM_PAGE_SIZE;
+                // skip past this mapped page (the whole 2MB/1GB one for large pages)
+                uintptr_t next = (addr & ~(size - 1)) + size;
 
                 // Check for overflow and ensure we're making progress
                 if (next <= current || next >= end) {
@@ -889,29 +1242,61 @@ bool vmm_protect(vmm_context_t* ctx, uintptr_t virt_addr, size_t size, uint64_t
 
     size_t page_count = vmm_size_to_pages(size);
     uintptr_t current_addr = vmm_page_align_down(virt_addr);
+    bool success = true;
+
+    // TLB - один раз на весь диапазон, после снятия lock'а
+    vmm_tlb_batch_t batch;
+    vmm_tlb_batch_init(&batch, ctx);
 
     spin_lock(&ctx->lock);
 
-    for (size_t i = 0; i < page_count; i++) {
-        pte_t* pte = vmm_get_pte(ctx, current_addr); // noalloc
+    // Ensure present bit remains set unless new_flags explicitly clears it
+    uint64_t flags_to_set = (new_flags & VMM_PTE_FLAGS_MASK) & ~VMM_FLAG_LARGE_PAGE;
+    if (!(flags_to_set & VMM_FLAG_PRESENT)) flags_to_set |= VMM_FLAG_PRESENT;
+
+    for (size_t i = 0; i < page_count; ) {
+        // 2MB страница целиком в диапазоне - меняем её запись, иначе дробим
+        size_t size = 0;
+        pte_t* pte = vmm_get_leaf(ctx, current_addr, &size);
+        if (pte && size == VMM_LARGE_PAGE_SIZE &&
+            !(current_addr & (VMM_LARGE_PAGE_SIZE - 1)) &&
+            page_count - i >= VMM_LARGE_PAGE_PAGES) {
+            *pte = vmm_make_pte(vmm_pte_to_phys(*pte), flags_to_set | VMM_FLAG_LARGE_PAGE);
+            vmm_tlb_batch_add(&batch, current_addr, VMM_LARGE_PAGE_SIZE);
+            current_addr += VMM_LARGE_PAGE_SIZE;
+            i += VMM_LARGE_PAGE_PAGES;
+            continue;
+        }
+
+        pte = vmm_get_pte_split(ctx, current_addr);
         if (!pte || !(*pte & VMM_FLAG_PRESENT)) {
-            spin_unlock(&ctx->lock);
-            return false;
+            success = false;
+            break;
+        }
+
+        // Страница кэша образов остаётся общей: запись в неё - только через копию
+        uint64_t pte_flags = flags_to_set;
+        if (*pte & VMM_FLAG_SHARED) {
+            pte_flags |= VMM_FLAG_SHARED;
+            if (pte_flags & VMM_FLAG_WRITABLE) {
+                pte_flags = (pte_flags & ~VMM_FLAG_WRITABLE) | VMM_FLAG_COW;
+            }
         }
 
         // Update flags while preserving physical address
         uintptr_t phys_addr = vmm_pte_to_phys(*pte);
-        // Ensure present bit remains set unless new_flags explicitly clears it
-        uint64_t flags_to_set = (new_flags & VMM_PTE_FLAGS_MASK);
-        if (!(flags_to_set & VMM_FLAG_PRESENT)) flags_to_set |= VMM_FLAG_PRESENT;
-        *pte = vmm_make_pte(phys_addr, flags_to_set);
+        *pte = vmm_make_pte(phys_addr, pte_flags);
 
-        vmm_flush_tlb_page(current_addr);
+        vmm_tlb_batch_add(&batch, current_addr, VMM_PAGE_SIZE);
         current_addr += VMM_PAGE_SIZE;
+        i++;
     }
 
     spin_unlock(&ctx->lock);
-    return true;
+
+    // Уже изменённые до ошибки страницы - тоже
+    vmm_tlb_batch_finish(&batch);
+    return success;
 }
 
 bool vmm_reserve_region(vmm_context_t* ctx, uintptr_t start, size_t size, uint64_t flags) {
@@ -946,8 +1331,8 @@ void vmm_init(void) {
     kprintf("[VMM] Initializing Virtual Memory Manager...\n");
 
     spinlock_init(&vmm_global_lock);
-    spinlock_init(&kernel_heap_lock);
-    spinlock_init(&vmalloc_lock);
+    vmm_region_init();
+    spinlock_init(&mmio_lock);
 
     // Create kernel context
     kernel_context = vmm_create_context();
@@ -955,6 +1340,20 @@ void vmm_init(void) {
         panic("Failed to create kernel VMM context");
     }
 
+    // Адреса kernel context - окно kernel heap (vmalloc, vmm_alloc_pages)
+    vmm_region_space_destroy(&kernel_context->regions);
+    if (!vmm_region_space_init(&kernel_context->regions, VMM_KERNEL_HEAP_BASE,
+                               VMM_KERNEL_HEAP_SIZE)) {
+        panic("Failed to create kernel heap region tree");
+    }
+
+    // PDPT kernel heap - сразу: контексты процессов копируют PML4[256..511]
+    // при создании, и heap (в том числе lazy страницы из page fault)
+    // должен быть виден в них, даже если отображён позже
+    if (!vmm_get_or_create_table(kernel_context, VMM_KERNEL_HEAP_BASE, 1)) {
+        panic("Failed to create kernel heap PDPT");
+    }
+
     kprintf("[VMM] Kernel context created at %p\n", kernel_context);
     kprintf("[VMM] PML4 physical address: 0x%p\n", (void*)kernel_context->pml4_phys);
 
@@ -976,27 +1375,18 @@ void vmm_init(void) {
     kprintf("[VMM] Setting up identity mapping for %zu MB (using 2MB large pages)...\n",
             identity_map_end / (1024*1024));
 
-    // Map using 2MB large pages for speed
-    #define LARGE_PAGE_SIZE (2 * 1024 * 1024)  // 2MB
+    // Map using 2MB large pages for speed (PS bit in PD entry, no Page Table level)
     size_t large_pages_mapped = 0;
 
-    for (uintptr_t addr = 0; addr < identity_map_end; addr += LARGE_PAGE_SIZE) {
-        // Get or create page directory (PD) entry
-        page_table_t* pd = vmm_get_or_create_table(kernel_context, addr, 2);
-        if (!pd) {
+    for (uintptr_t addr = 0; addr < identity_map_end; addr += VMM_LARGE_PAGE_SIZE) {
+        vmm_map_result_t result = vmm_map_large_page(kernel_context, addr, addr,
+                                                     VMM_FLAGS_KERNEL_RW | VMM_FLAG_GLOBAL);
+        if (!result.success) {
             if (addr < 0x1000000) { // First 16MB is critical
                 panic("Failed to create page directory for identity mapping");
             }
             continue;
         }
-
-        // Calculate PD index
-        uint32_t pd_idx = VMM_PD_INDEX(addr);
-        pte_t* pd_entry = &pd->entries[pd_idx];
-
-        // Create 2MB large page entry (skip Page Table level)
-        // Set LARGE_PAGE bit (bit 7) to indicate 2MB page
-        *pd_entry = vmm_make_pte(addr, VMM_FLAGS_KERNEL_RW | VMM_FLAG_LARGE_PAGE);
         large_pages_mapped++;
     }
 
@@ -1028,6 +1418,27 @@ void vmm_init(void) {
     }
     *test_ptr = old_value; // Restore
 
+    // CR0.WP: запись ядра в read-only user страницу тоже даёт page fault -
+    // иначе копирование в буфер процесса писало бы прямо в общую COW страницу
+    // (AP включают WP в ap_trampoline)
+    uint64_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    asm volatile("mov %0, %%cr0" : : "r"(cr0 | (1ULL << 16)) : "memory");
+
+    // PCID (CPUID.1:ECX[17]) и INVPCID (CPUID.7:EBX[10]): решается один раз,
+    // AP включают то же в vmm_init_cpu
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    vmm_pcid_enabled = (ecx & (1u << 17)) != 0;
+    cpu_cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if (vmm_pcid_enabled && eax >= 7) {
+        cpu_cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        vmm_invpcid_supported = (ebx & (1u << 10)) != 0;
+    }
+    vmm_init_cpu();
+    kprintf("[VMM] Global identity map, PCID: %s, INVPCID: %s\n",
+            vmm_pcid_enabled ? "on" : "off", vmm_invpcid_supported ? "on" : "off");
+
     vmm_initialized = true;
 
     kprintf("[VMM] Virtual memory layout:\n");
@@ -1075,7 +1486,8 @@ void vmm_dump_page_tables(vmm_context_t* ctx, uintptr_t virt_addr) {
     kprintf("[VMM]   PDPT entry: 0x%016llx (present: %s)\n",
            (unsigned long long)pdpt_entry, (pdpt_entry & VMM_FLAG_PRESENT) ? "yes" : "no");
 
-    if (!(pdpt_entry & VMM_FLAG_PRESENT)) {
+    if (!(pdpt_entry & VMM_FLAG_PRESENT) || (pdpt_entry & VMM_FLAG_LARGE_PAGE)) {
+        if (pdpt_entry & VMM_FLAG_LARGE_PAGE) kprintf("[VMM]   1GB page\n");
         spin_unlock(&ctx->lock);
         return;
     }
@@ -1085,7 +1497,8 @@ void vmm_dump_page_tables(vmm_context_t* ctx, uintptr_t virt_addr) {
     kprintf("[VMM]   PD entry:   0x%016llx (present: %s)\n",
            (unsigned long long)pd_entry, (pd_entry & VMM_FLAG_PRESENT) ? "yes" : "no");
 
-    if (!(pd_entry & VMM_FLAG_PRESENT)) {
+    if (!(pd_entry & VMM_FLAG_PRESENT) || (pd_entry & VMM_FLAG_LARGE_PAGE)) {
+        if (pd_entry & VMM_FLAG_LARGE_PAGE) kprintf("[VMM]   2MB page\n");
         spin_unlock(&ctx->lock);
         return;
     }
@@ -1138,6 +1551,11 @@ void vmm_get_global_stats(vmm_stats_t* stats) {
     spin_lock(&vmm_global_lock);
     *stats = global_stats;
     spin_unlock(&vmm_global_lock);
+
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        stats->context_switches += vmm_cpu_tlb[i].switches;
+        stats->tlb_preserved += vmm_cpu_tlb[i].preserved;
+    }
 }
 
 void vmm_print_stats(void) {
@@ -1158,8 +1576,16 @@ void vmm_print_stats(void) {
     kprintf("[VMM]   Page tables allocated: %zu (%zu KB)\n",
            stats.page_tables_allocated,
            (stats.page_tables_allocated * VMM_PAGE_SIZE) / 1024);
-    kprintf("[VMM]   Page faults handled:   %zu\n", stats.page_faults_handled);
+    kprintf("[VMM]   Page faults handled:   %zu (lazy pages %zu, COW copies %zu)\n",
+           stats.page_faults_handled, stats.lazy_pages_mapped, stats.cow_pages_copied);
     kprintf("[VMM]   TLB flushes:           %zu\n", stats.tlb_flushes);
+    kprintf("[VMM]   Context switches:      %zu (TLB kept %zu, PCID %s)\n",
+           stats.context_switches, stats.tlb_preserved, vmm_pcid_enabled ? "on" : "off");
+    if (kernel_context) {
+        vmm_region_space_t* heap = &kernel_context->regions;
+        kprintf("[VMM]   Kernel heap regions:   %zu (%zu KB), free ranges %zu\n",
+               heap->busy_count, heap->busy_bytes / 1024, heap->free_count);
+    }
 }
 
 // ========== BASIC TESTING ==========
@@ -1269,95 +1695,122 @@ void vmm_test_basic(void) {
 #define PF_RESERVED  (1 << 3)  // 1 = reserved bit set in page table
 #define PF_INSTR     (1 << 4)  // 1 = instruction fetch
 
-int vmm_handle_page_fault(uintptr_t fault_addr, uint64_t error_code) {
-    // Analyze fault
-    bool present = error_code & PF_PRESENT;
-    bool write = error_code & PF_WRITE;
-    bool user = error_code & PF_USER;
-    bool reserved = error_code & PF_RESERVED;
-    bool instr_fetch = error_code & PF_INSTR;
+// Нулевая страница в addr. Другой CPU успел раньше - тоже успех
+static bool vmm_map_zero_page(vmm_context_t* ctx, uintptr_t addr, uint64_t flags) {
+    void* phys_page = pmm_alloc_zero(1);
+    if (!phys_page) {
+        return false;
+    }
 
-    kprintf("[VMM] Page fault at 0x%llx (error=0x%llx)\n", fault_addr, error_code);
-    kprintf("[VMM]   present=%d write=%d user=%d reserved=%d instr=%d\n",
-            present, write, user, reserved, instr_fetch);
+    vmm_map_result_t result = vmm_map_page(ctx, addr, (uintptr_t)phys_page, flags);
+    if (!result.success) {
+        pmm_free(phys_page, 1);
+        return vmm_is_mapped(ctx, addr);
+    }
+    return true;
+}
 
-    // Reserved bit violations are always fatal
-    if (reserved) {
-        kprintf("[VMM] ERROR: Reserved bit violation - cannot handle\n");
+// Запись в VMM_FLAG_COW страницу: своя копия, writable, без SHARED.
+// Общая страница остаётся у владельца (кэш ELF образов)
+static int vmm_handle_cow_fault(vmm_context_t* ctx, uintptr_t fault_addr) {
+    if (!ctx || fault_addr >= VMM_KERNEL_BASE) {
         return -1;
     }
 
-    // If page is present, it's a protection fault
-    if (present) {
-        kprintf("[VMM] ERROR: Protection fault - access denied\n");
+    uintptr_t page_addr = vmm_page_align_down(fault_addr);
+    void* copy = pmm_alloc(1);
+    if (!copy) {
+        kprintf("[VMM] ERROR: No memory for COW copy at 0x%p\n", (void*)page_addr);
         return -1;
     }
 
-    // Page not present - demand paging
-    kprintf("[VMM] Page not present - attempting demand paging\n");
+    spin_lock(&ctx->lock);
 
-    // Get kernel context
-    vmm_context_t* ctx = kernel_context;
+    pte_t* pte = vmm_get_pte_noalloc(ctx, page_addr);
+    if (!pte || !(*pte & VMM_FLAG_COW)) {
+        // Другой CPU уже скопировал - повторить доступ; иначе нарушение
+        bool resolved = pte && (*pte & VMM_FLAG_PRESENT) && (*pte & VMM_FLAG_WRITABLE);
+        spin_unlock(&ctx->lock);
+        pmm_free(copy, 1);
+        return resolved ? 0 : -1;
+    }
 
-    // Align fault address to page boundary
-    uintptr_t page_addr = fault_addr & ~(VMM_PAGE_SIZE - 1);
+    memcpy(copy, vmm_phys_to_virt(vmm_pte_to_phys(*pte)), VMM_PAGE_SIZE);
+    uint64_t flags = (vmm_pte_to_flags(*pte) & ~(VMM_FLAG_COW | VMM_FLAG_SHARED)) |
+                     VMM_FLAG_WRITABLE;
+    *pte = vmm_make_pte((uintptr_t)copy, flags);
 
-    // Check if this is in kernel heap range (higher half)
-    if (page_addr >= VMM_KERNEL_HEAP_BASE &&
-        page_addr < VMM_KERNEL_HEAP_BASE + VMM_KERNEL_HEAP_SIZE) {
+    spin_unlock(&ctx->lock);
 
-        kprintf("[VMM] Demand paging: mapping kernel heap page at 0x%llx\n", page_addr);
+    vmm_tlb_flush_range(ctx, page_addr, page_addr + VMM_PAGE_SIZE);
 
-        // Allocate physical page
-        void* phys_page = pmm_alloc(1);
-        if (!phys_page) {
-            kprintf("[VMM] ERROR: Failed to allocate physical page\n");
-            return -1;
-        }
+    spin_lock(&vmm_global_lock);
+    global_stats.page_faults_handled++;
+    global_stats.cow_pages_copied++;
+    spin_unlock(&vmm_global_lock);
 
-        // Map the page
-        uint64_t flags = VMM_FLAG_PRESENT | VMM_FLAG_WRITABLE;
-        if (user) {
-            flags |= VMM_FLAG_USER;
-        }
+    return 0;
+}
 
-        vmm_map_result_t result = vmm_map_page(ctx, page_addr, (uintptr_t)phys_page, flags);
-        if (!result.success) {
-            kprintf("[VMM] ERROR: Failed to map page\n");
-            pmm_free(phys_page, 1);
-            return -1;
-        }
+// Lazy регион (vmm_alloc_pages_lazy): нулевая страница на первое обращение
+// + до VMM_FAULT_AROUND_PAGES соседних из того же выровненного окна
+int vmm_handle_page_fault(vmm_context_t* ctx, uintptr_t fault_addr, uint64_t error_code) {
+    // Reserved bit violations are always fatal
+    if (error_code & PF_RESERVED) {
+        return -1;
+    }
 
-        kprintf("[VMM] SUCCESS: Demand paging successful\n");
-        return 0;  // Handled successfully
+    // Protection fault на present странице: COW запись или настоящее нарушение
+    if (error_code & PF_PRESENT) {
+        return (error_code & PF_WRITE) ? vmm_handle_cow_fault(ctx, fault_addr) : -1;
+    }
+
+    // Kernel heap - общий для всех контекстов (PML4[256] копируется)
+    if (fault_addr >= VMM_KERNEL_BASE || !ctx) {
+        ctx = kernel_context;
+    }
+    if (!ctx) {
+        return -1;
     }
 
-    // Check if this is in low memory (0-256MB) for kernel data/heap fallback
-    if (page_addr < (256ULL * 1024 * 1024)) {
-        kprintf("[VMM] Demand paging: mapping low memory page at 0x%llx\n", page_addr);
+    vmm_region_t region;
+    if (!vmm_region_find(&ctx->regions, fault_addr, &region) || !region.flags) {
+        return -1;  // Не выданный адрес или регион без lazy страниц
+    }
 
-        // Allocate physical page
-        void* phys_page = pmm_alloc(1);
-        if (!phys_page) {
-            kprintf("[VMM] ERROR: Failed to allocate physical page\n");
-            return -1;
-        }
+    uint64_t flags = region.flags;
+    if (((error_code & PF_USER) && !(flags & VMM_FLAG_USER)) ||
+        ((error_code & PF_WRITE) && !(flags & VMM_FLAG_WRITABLE)) ||
+        ((error_code & PF_INSTR) && (flags & VMM_FLAG_NO_EXECUTE))) {
+        return -1;
+    }
 
-        // Map the page (kernel mode, writable)
-        uint64_t flags = VMM_FLAG_PRESENT | VMM_FLAG_WRITABLE;
+    uintptr_t page_addr = vmm_page_align_down(fault_addr);
+    uintptr_t region_end = region.start + region.size;
 
-        vmm_map_result_t result = vmm_map_page(ctx, page_addr, (uintptr_t)phys_page, flags);
-        if (!result.success) {
-            kprintf("[VMM] ERROR: Failed to map page\n");
-            pmm_free(phys_page, 1);
-            return -1;
-        }
+    // Окно fault-around, выровненное и в пределах региона; страница fault - первой
+    size_t window = (VMM_FAULT_AROUND_PAGES > 1 ? VMM_FAULT_AROUND_PAGES : 1) * VMM_PAGE_SIZE;
+    uintptr_t first = page_addr & ~(window - 1);
+    uintptr_t last = first + window;
+    if (first < region.start) first = region.start;
+    if (last > region_end) last = region_end;
+
+    if (!vmm_map_zero_page(ctx, page_addr, flags)) {
+        kprintf("[VMM] ERROR: No memory for lazy page at 0x%p\n", (void*)page_addr);
+        return -1;
+    }
 
-        kprintf("[VMM] SUCCESS: Low memory page mapped\n");
-        return 0;  // Handled successfully
+    size_t mapped = 1;
+    for (uintptr_t addr = first; addr < last; addr += VMM_PAGE_SIZE) {
+        if (addr == page_addr || vmm_is_mapped(ctx, addr)) continue;
+        if (!vmm_map_zero_page(ctx, addr, flags)) break;  // Соседи - не обязательны
+        mapped++;
     }
 
-    // Not in a valid range
-    kprintf("[VMM] ERROR: Fault address not in valid range (0x%llx)\n", fault_addr);
-    return -1;  // Cannot handle
+    spin_lock(&vmm_global_lock);
+    global_stats.page_faults_handled++;
+    global_stats.lazy_pages_mapped += mapped;
+    spin_unlock(&vmm_global_lock);
+
+    return 0;
 }
@@ -2,19 +2,32 @@
 #define VMM_H
 
 #include "klib.h"
+#include "vmm_region.h"
 
 // ========== VMM CONSTANTS ==========
 #define VMM_PAGE_SIZE           4096
 #define VMM_PAGE_MASK           0xFFFFFFFFFFFFF000ULL
 #define VMM_PAGE_OFFSET_MASK    0x0000000000000FFFULL
+#define VMM_LARGE_PAGE_SIZE     (2ULL * 1024 * 1024)   // PS в PD entry
+#define VMM_LARGE_PAGE_PAGES    (VMM_LARGE_PAGE_SIZE / VMM_PAGE_SIZE)
+#define VMM_HUGE_PAGE_SIZE      (1ULL << 30)           // PS в PDPT entry
+#define VMM_FAULT_AROUND_PAGES  4                      // Lazy страниц на один page fault (степень 2)
+#define VMM_PCID_SLOTS          8                      // PCID 1..8 на CPU; 0 - kernel context и без PCID
+#define VMM_TLB_FLUSH_ALL_PAGES 32                     // Больше страниц за сброс - весь PCID, не invlpg
+#define VMM_TLB_BATCH_FREE      32                     // Отложенных диапазонов pmm_free в batch
 
 // Virtual address space layout
 #define VMM_KERNEL_BASE         0xFFFF800000000000ULL  // -128TB
 #define VMM_KERNEL_HEAP_BASE    0xFFFF800000000000ULL  // Kernel heap start
 #define VMM_KERNEL_HEAP_SIZE    (1ULL << 30)           // 1GB kernel heap
-#define VMM_USER_BASE           0x0000000000400000ULL  // 4MB (standard ELF base)
+#define VMM_USER_BASE           0x0000000010000000ULL  // 256MB: ELF образы, сразу за identity map
+#define VMM_USER_IMAGE_END      0x0000000020000000ULL  // 512MB: дальше фиксированные адреса процесса
 #define VMM_USER_STACK_TOP      0x00007FFFFFFFE000ULL  // ~128TB user space top
 #define VMM_USER_HEAP_BASE      0x0000000001000000ULL  // 16MB user heap start
+#define VMM_USER_REGION_BASE    0x0000000040000000ULL  // 1GB: vmm_alloc_pages(USER), выше identity и фиксированных адресов процесса
+#define VMM_USER_REGION_END     0x0000400000000000ULL  // 64TB (стек процесса - выше)
+#define VMM_MMIO_BASE           0xFFFFFF8000000000ULL  // PML4[511]: device MMIO window
+#define VMM_MMIO_SIZE           (1ULL << 30)           // 1GB MMIO window
 
 // Memory protection flags
 #define VMM_FLAG_PRESENT        (1ULL << 0)   // Page is present
@@ -26,6 +39,8 @@
 #define VMM_FLAG_DIRTY          (1ULL << 6)   // Page was written to
 #define VMM_FLAG_LARGE_PAGE     (1ULL << 7)   // 2MB/1GB page
 #define VMM_FLAG_GLOBAL         (1ULL << 8)   // Global page
+#define VMM_FLAG_SHARED         (1ULL << 9)   // Software: страница не своя (кэш ELF образов), в PMM не возвращается
+#define VMM_FLAG_COW            (1ULL << 10)  // Software: read-only, запись - своя копия (page fault)
 #define VMM_FLAG_NO_EXECUTE     (1ULL << 63)  // No execute (NX bit)
 
 // Convenience flag combinations
@@ -71,8 +86,35 @@ typedef struct {
     uintptr_t heap_start;         // Current heap start
     uintptr_t heap_end;           // Current heap end
     uintptr_t stack_top;          // Stack top for user processes
+
+    // Virtual address allocator: kernel heap window (kernel context) or
+    // VMM_USER_REGION_BASE..END (user contexts)
+    vmm_region_space_t regions;
+
+    // PCID: id контекста (не переиспользуется) и поколение отображений -
+    // растёт, когда PTE снят или ослаблен. PCID CPU с меньшим поколением
+    // сбрасывается при следующем vmm_switch_context
+    uint64_t tlb_id;
+    volatile uint64_t tlb_gen;
 } vmm_context_t;
 
+// TLB batch (в духе mmu_gather): снятые / ослабленные PTE диапазона копятся,
+// TLB сбрасывается один раз в vmm_tlb_batch_finish - выборочно или целиком
+// (VMM_TLB_FLUSH_ALL_PAGES), физические страницы уходят в PMM только после
+// сброса. Заполнен список страниц - промежуточный сброс
+typedef struct {
+    uintptr_t phys;
+    size_t pages;
+} vmm_tlb_batch_page_t;
+
+typedef struct {
+    vmm_context_t* ctx;
+    uintptr_t start;                            // Изменённые адреса, start == end - нет
+    uintptr_t end;
+    size_t free_count;
+    vmm_tlb_batch_page_t free[VMM_TLB_BATCH_FREE];  // Подряд идущие склеиваются
+} vmm_tlb_batch_t;
+
 // Memory mapping result
 typedef struct {
     bool success;
@@ -86,6 +128,7 @@ typedef struct {
 
 // Initialization
 void vmm_init(void);
+void vmm_init_cpu(void);  // PGE/PCID этого CPU (BSP - из vmm_init, AP - из ap_main)
 void vmm_test_basic(void);
 
 // Context management
@@ -100,6 +143,10 @@ vmm_map_result_t vmm_map_page(vmm_context_t* ctx, uintptr_t virt_addr,
                               uintptr_t phys_addr, uint64_t flags);
 vmm_map_result_t vmm_map_pages(vmm_context_t* ctx, uintptr_t virt_addr, 
                                uintptr_t phys_addr, size_t page_count, uint64_t flags);
+// 2MB page (PS): virt и phys выровнены на VMM_LARGE_PAGE_SIZE.
+// unmap/protect части такой страницы дробят её на 4KB PTE
+vmm_map_result_t vmm_map_large_page(vmm_context_t* ctx, uintptr_t virt_addr,
+                                    uintptr_t phys_addr, uint64_t flags);
 bool vmm_unmap_page(vmm_context_t* ctx, uintptr_t virt_addr);
 bool vmm_unmap_pages(vmm_context_t* ctx, uintptr_t virt_addr, size_t page_count);
 
@@ -107,6 +154,15 @@ bool vmm_unmap_pages(vmm_context_t* ctx, uintptr_t virt_addr, size_t page_count)
 void* vmm_alloc_pages(vmm_context_t* ctx, size_t page_count, uint64_t flags);
 void vmm_free_pages(vmm_context_t* ctx, void* virt_addr, size_t page_count);
 
+// Demand paging: только адреса (регион в ctx->regions). Страница появляется
+// при первом обращении - нулевая, с flags; вместе с ней - соседние из окна
+// VMM_FAULT_AROUND_PAGES. Освобождение - vmm_free_pages / vfree как обычно.
+// Не для DMA буферов и памяти, которую трогают под spinlock'ами VMM/PMM
+void* vmm_alloc_pages_lazy(vmm_context_t* ctx, size_t page_count, uint64_t flags);
+// То же с началом, кратным align (степень 2, >= VMM_PAGE_SIZE)
+void* vmm_alloc_pages_lazy_aligned(vmm_context_t* ctx, size_t page_count, size_t align,
+                                   uint64_t flags);
+
 // Address translation
 uintptr_t vmm_virt_to_phys(vmm_context_t* ctx, uintptr_t virt_addr);
 bool vmm_is_mapped(vmm_context_t* ctx, uintptr_t virt_addr);
@@ -117,6 +173,10 @@ void* vmalloc(size_t size);
 void* vzalloc(size_t size);  // Zero-initialized
 void vfree(void* addr);
 
+// Device MMIO (LAPIC, IOAPIC, ...): uncached mapping in the shared upper half
+// Must be called before user contexts are created (upper half is copied)
+void* vmm_map_mmio(uintptr_t phys_addr, size_t size);
+
 // Memory regions
 uintptr_t vmm_find_free_region(vmm_context_t* ctx, size_t size, uintptr_t start, uintptr_t end);
 bool vmm_reserve_region(vmm_context_t* ctx, uintptr_t start, size_t size, uint64_t flags);
@@ -127,6 +187,12 @@ void vmm_dump_context_stats(vmm_context_t* ctx);
 void vmm_flush_tlb(void);
 void vmm_flush_tlb_page(uintptr_t virt_addr);
 
+// TLB batch: PTE меняет caller, batch - только сброс и освобождение
+void vmm_tlb_batch_init(vmm_tlb_batch_t* batch, vmm_context_t* ctx);
+void vmm_tlb_batch_add(vmm_tlb_batch_t* batch, uintptr_t virt_addr, size_t size);
+void vmm_tlb_batch_free(vmm_tlb_batch_t* batch, uintptr_t phys, size_t pages);
+void vmm_tlb_batch_finish(vmm_tlb_batch_t* batch);
+
 // Protection and flags
 bool vmm_protect(vmm_context_t* ctx, uintptr_t virt_addr, size_t size, uint64_t new_flags);
 bool vmm_is_user_accessible(uintptr_t virt_addr);
@@ -138,6 +204,8 @@ bool vmm_is_kernel_addr(uintptr_t addr);
 page_table_t* vmm_get_or_create_table(vmm_context_t* ctx, uintptr_t virt_addr, int level);
 pte_t* vmm_get_pte(vmm_context_t* ctx, uintptr_t virt_addr);
 pte_t* vmm_get_or_create_pte(vmm_context_t* ctx, uintptr_t virt_addr);
+// Leaf entry любого уровня (PTE, 2MB PD entry, 1GB PDPT entry), size - его размер
+pte_t* vmm_get_leaf(vmm_context_t* ctx, uintptr_t virt_addr, size_t* size);
 void vmm_invalidate_page(uintptr_t virt_addr);
 
 // Physical memory integration
@@ -156,7 +224,11 @@ typedef struct {
     size_t user_mapped_pages;
     size_t page_tables_allocated;
     size_t page_faults_handled;
+    size_t lazy_pages_mapped;     // Нулевых страниц отображено из page fault
+    size_t cow_pages_copied;      // COW страниц скопировано при записи
     size_t tlb_flushes;
+    size_t context_switches;      // vmm_switch_context
+    size_t tlb_preserved;         // Из них без сброса TLB (PCID)
 } vmm_stats_t;
 
 void vmm_get_global_stats(vmm_stats_t* stats);
@@ -233,8 +305,9 @@ static inline uintptr_t vmm_virt_to_phys_direct(void* virt_addr) {
     return virt;
 }
 
-// Page fault handling
+// Page fault handling: lazy регионы ctx (NULL или адрес kernel - kernel context)
+// и запись в VMM_FLAG_COW страницы. ctx - контекст, чей CR3 сейчас загружен
 // Returns: 0 on success (handled), -1 on error (unhandled)
-int vmm_handle_page_fault(uintptr_t fault_addr, uint64_t error_code);
+int vmm_handle_page_fault(vmm_context_t* ctx, uintptr_t fault_addr, uint64_t error_code);
 
 #endif // VMM_H
\ No newline at end of file
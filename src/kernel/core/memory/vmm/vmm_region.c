@@ -0,0 +1,330 @@
+#include "vmm_region.h"
+#include "vmm.h"
+#include "slab.h"
+
+static SlabCache vmm_region_cache;
+
+void vmm_region_init(void) {
+    slab_cache_init(&vmm_region_cache, "vmm_region", sizeof(vmm_region_t), NULL);
+}
+
+// ========== AVL TREE (по start) ==========
+
+static inline int32_t region_height(vmm_region_t* n) {
+    return n ? n->height : 0;
+}
+
+static inline size_t region_max(vmm_region_t* n) {
+    return n ? n->max_size : 0;
+}
+
+static void region_update(vmm_region_t* n) {
+    int32_t hl = region_height(n->left);
+    int32_t hr = region_height(n->right);
+    n->height = 1 + (hl > hr ? hl : hr);
+
+    size_t max = n->size;
+    if (region_max(n->left) > max) max = region_max(n->left);
+    if (region_max(n->right) > max) max = region_max(n->right);
+    n->max_size = max;
+}
+
+static vmm_region_t* region_rotate_right(vmm_region_t* n) {
+    vmm_region_t* l = n->left;
+    n->left = l->right;
+    l->right = n;
+    region_update(n);
+    region_update(l);
+    return l;
+}
+
+static vmm_region_t* region_rotate_left(vmm_region_t* n) {
+    vmm_region_t* r = n->right;
+    n->right = r->left;
+    r->left = n;
+    region_update(n);
+    region_update(r);
+    return r;
+}
+
+static vmm_region_t* region_balance(vmm_region_t* n) {
+    region_update(n);
+    int32_t diff = region_height(n->left) - region_height(n->right);
+
+    if (diff > 1) {
+        if (region_height(n->left->left) < region_height(n->left->right)) {
+            n->left = region_rotate_left(n->left);
+        }
+        return region_rotate_right(n);
+    }
+    if (diff < -1) {
+        if (region_height(n->right->right) < region_height(n->right->left)) {
+            n->right = region_rotate_right(n->right);
+        }
+        return region_rotate_left(n);
+    }
+    return n;
+}
+
+static vmm_region_t* region_insert(vmm_region_t* root, vmm_region_t* node) {
+    if (!root) {
+        node->left = NULL;
+        node->right = NULL;
+        region_update(node);
+        return node;
+    }
+
+    if (node->start < root->start) {
+        root->left = region_insert(root->left, node);
+    } else {
+        root->right = region_insert(root->right, node);
+    }
+    return region_balance(root);
+}
+
+// Отцепить самый левый узел поддерева в *min
+static vmm_region_t* region_remove_min(vmm_region_t* root, vmm_region_t** min) {
+    if (!root->left) {
+        *min = root;
+        return root->right;
+    }
+    root->left = region_remove_min(root->left, min);
+    return region_balance(root);
+}
+
+// Отцепить узел с данным start в *removed (NULL = нет такого)
+static vmm_region_t* region_remove(vmm_region_t* root, uintptr_t start, vmm_region_t** removed) {
+    if (!root) {
+        *removed = NULL;
+        return NULL;
+    }
+
+    if (start < root->start) {
+        root->left = region_remove(root->left, start, removed);
+    } else if (start > root->start) {
+        root->right = region_remove(root->right, start, removed);
+    } else {
+        *removed = root;
+        if (!root->right) {
+            return root->left;
+        }
+        vmm_region_t* min;
+        vmm_region_t* right = region_remove_min(root->right, &min);
+        min->left = root->left;
+        min->right = right;
+        return region_balance(min);
+    }
+    return region_balance(root);
+}
+
+static vmm_region_t* region_find(vmm_region_t* n, uintptr_t start) {
+    while (n && n->start != start) {
+        n = start < n->start ? n->left : n->right;
+    }
+    return n;
+}
+
+// Последний узел с start < addr
+static vmm_region_t* region_before(vmm_region_t* n, uintptr_t addr) {
+    vmm_region_t* best = NULL;
+    while (n) {
+        if (n->start < addr) {
+            best = n;
+            n = n->right;
+        } else {
+            n = n->left;
+        }
+    }
+    return best;
+}
+
+// Самый низкий по адресу узел с size >= need
+static vmm_region_t* region_first_fit(vmm_region_t* n, size_t need) {
+    while (n && n->max_size >= need) {
+        if (region_max(n->left) >= need) {
+            n = n->left;
+        } else if (n->size >= need) {
+            return n;
+        } else {
+            n = n->right;
+        }
+    }
+    return NULL;
+}
+
+// ========== SPACE ==========
+
+static vmm_region_t* region_new(uintptr_t start, size_t size) {
+    vmm_region_t* node = (vmm_region_t*)slab_cache_alloc(&vmm_region_cache);
+    if (node) {
+        node->start = start;
+        node->size = size;
+        node->flags = 0;
+    }
+    return node;
+}
+
+bool vmm_region_space_init(vmm_region_space_t* space, uintptr_t base, size_t size) {
+    memset(space, 0, sizeof(*space));
+    spinlock_init(&space->lock);
+    space->base = base;
+    space->end = base + size;
+
+    vmm_region_t* all = region_new(base, size);
+    if (!all) {
+        return false;
+    }
+    space->free = region_insert(NULL, all);
+    space->free_count = 1;
+    return true;
+}
+
+static void region_free_tree(vmm_region_t* n) {
+    while (n) {
+        region_free_tree(n->left);
+        vmm_region_t* right = n->right;
+        slab_cache_free(&vmm_region_cache, n);
+        n = right;
+    }
+}
+
+void vmm_region_space_destroy(vmm_region_space_t* space) {
+    spin_lock(&space->lock);
+    vmm_region_t* free = space->free;
+    vmm_region_t* busy = space->busy;
+    space->free = NULL;
+    space->busy = NULL;
+    space->free_count = 0;
+    space->busy_count = 0;
+    space->busy_bytes = 0;
+    spin_unlock(&space->lock);
+
+    region_free_tree(free);
+    region_free_tree(busy);
+}
+
+uintptr_t vmm_region_alloc(vmm_region_space_t* space, size_t size, size_t align, uint64_t flags) {
+    if (size == 0) return 0;
+    size = ALIGN_UP(size, VMM_PAGE_SIZE);
+    if (align < VMM_PAGE_SIZE) align = VMM_PAGE_SIZE;
+
+    // Узлы под хвост и голову - заранее, вне lock'а
+    vmm_region_t* head = region_new(0, 0);
+    vmm_region_t* tail = region_new(0, 0);
+    if (!head || !tail) {
+        if (head) slab_cache_free(&vmm_region_cache, head);
+        if (tail) slab_cache_free(&vmm_region_cache, tail);
+        return 0;
+    }
+
+    // С запасом на выравнивание - тогда первый найденный точно подходит
+    size_t need = size + (align - VMM_PAGE_SIZE);
+
+    spin_lock(&space->lock);
+
+    vmm_region_t* fit = region_first_fit(space->free, need);
+    if (!fit) {
+        spin_unlock(&space->lock);
+        slab_cache_free(&vmm_region_cache, head);
+        slab_cache_free(&vmm_region_cache, tail);
+        return 0;
+    }
+
+    vmm_region_t* node;
+    space->free = region_remove(space->free, fit->start, &node);
+    space->free_count--;
+
+    uintptr_t start = ALIGN_UP(node->start, align);
+    uintptr_t end = start + size;
+    uintptr_t fit_end = node->start + node->size;
+
+    if (start > node->start) {
+        head->start = node->start;
+        head->size = start - node->start;
+        space->free = region_insert(space->free, head);
+        space->free_count++;
+        head = NULL;
+    }
+    if (fit_end > end) {
+        tail->start = end;
+        tail->size = fit_end - end;
+        space->free = region_insert(space->free, tail);
+        space->free_count++;
+        tail = NULL;
+    }
+
+    node->start = start;
+    node->size = size;
+    node->flags = flags;
+    space->busy = region_insert(space->busy, node);
+    space->busy_count++;
+    space->busy_bytes += size;
+
+    spin_unlock(&space->lock);
+
+    if (head) slab_cache_free(&vmm_region_cache, head);
+    if (tail) slab_cache_free(&vmm_region_cache, tail);
+    return start;
+}
+
+size_t vmm_region_free(vmm_region_space_t* space, uintptr_t start) {
+    vmm_region_t* merged[2] = {NULL, NULL};
+
+    spin_lock(&space->lock);
+
+    vmm_region_t* node;
+    space->busy = region_remove(space->busy, start, &node);
+    if (!node) {
+        spin_unlock(&space->lock);
+        return 0;
+    }
+    size_t size = node->size;
+    node->flags = 0;
+    space->busy_count--;
+    space->busy_bytes -= size;
+
+    // Склеить со свободными соседями
+    vmm_region_t* prev = region_before(space->free, start);
+    if (prev && prev->start + prev->size == start) {
+        space->free = region_remove(space->free, prev->start, &merged[0]);
+        node->start = prev->start;
+        node->size += prev->size;
+        space->free_count--;
+    }
+
+    vmm_region_t* next = region_find(space->free, start + size);
+    if (next) {
+        space->free = region_remove(space->free, next->start, &merged[1]);
+        node->size += next->size;
+        space->free_count--;
+    }
+
+    space->free = region_insert(space->free, node);
+    space->free_count++;
+
+    spin_unlock(&space->lock);
+
+    for (int i = 0; i < 2; i++) {
+        if (merged[i]) slab_cache_free(&vmm_region_cache, merged[i]);
+    }
+    return size;
+}
+
+size_t vmm_region_size(vmm_region_space_t* space, uintptr_t start) {
+    spin_lock(&space->lock);
+    vmm_region_t* node = region_find(space->busy, start);
+    size_t size = node ? node->size : 0;
+    spin_unlock(&space->lock);
+    return size;
+}
+
+bool vmm_region_find(vmm_region_space_t* space, uintptr_t addr, vmm_region_t* out) {
+    spin_lock(&space->lock);
+    vmm_region_t* node = region_before(space->busy, addr + 1);
+    bool found = node && addr < node->start + node->size;
+    if (found) {
+        *out = *node;
+    }
+    spin_unlock(&space->lock);
+    return found;
+}
@@ -0,0 +1,70 @@
+#ifndef VMM_REGION_H
+#define VMM_REGION_H
+
+#include "klib.h"  // spinlock_t
+
+// ============================================================================
+// VMM REGIONS - распределитель виртуальных адресов одного address space
+// ============================================================================
+//
+// Окно [base, end) делится на регионы. Два AVL дерева узлов по адресу:
+//
+//   free  - свободные диапазоны; узел помнит максимальный size своего
+//           поддерева, поэтому first-fit (самый низкий подходящий) -
+//           один спуск, O(log n)
+//   busy  - выданные регионы; free/size по начальному адресу - O(log n)
+//
+// Освобождённый регион склеивается с соседними свободными, так что
+// адреса переиспользуются (раньше kernel heap был bump pointer'ом).
+//
+// Узлы - из slab cache, память под таблицы страниц регион не трогает:
+// отображение - забота вызывающего (vmm_alloc_pages). Регион с flags != 0 -
+// lazy: страниц нет, vmm_handle_page_fault отображает их при первом
+// обращении с этими флагами PTE.
+//
+// ============================================================================
+
+typedef struct vmm_region {
+    uintptr_t start;
+    size_t size;                    // Байт, кратно VMM_PAGE_SIZE
+    size_t max_size;                // Максимум size в поддереве (free дерево)
+    uint64_t flags;                 // PTE флаги lazy региона, 0 = отображён сразу
+    struct vmm_region* left;
+    struct vmm_region* right;
+    int32_t height;
+} vmm_region_t;
+
+typedef struct {
+    vmm_region_t* free;
+    vmm_region_t* busy;
+    uintptr_t base;
+    uintptr_t end;
+    size_t busy_count;
+    size_t free_count;
+    size_t busy_bytes;
+    spinlock_t lock;
+} vmm_region_space_t;
+
+// Slab cache узлов (из vmm_init, до первого vmm_region_space_init)
+void vmm_region_init(void);
+
+// Всё окно [base, base + size) свободно. false = нет памяти под узел
+bool vmm_region_space_init(vmm_region_space_t* space, uintptr_t base, size_t size);
+
+// Вернуть все узлы (адреса должны быть уже не отображены)
+void vmm_region_space_destroy(vmm_region_space_t* space);
+
+// size байт с началом, кратным align (степень 2, >= VMM_PAGE_SIZE).
+// 0 = окно исчерпано / нет памяти под узлы
+uintptr_t vmm_region_alloc(vmm_region_space_t* space, size_t size, size_t align, uint64_t flags);
+
+// Освободить регион, начинающийся в start. Возвращает его size, 0 = такого нет
+size_t vmm_region_free(vmm_region_space_t* space, uintptr_t start);
+
+// size региона, начинающегося в start, 0 = такого нет
+size_t vmm_region_size(vmm_region_space_t* space, uintptr_t start);
+
+// Копия выданного региона, содержащего addr. false = адрес не выдан
+bool vmm_region_find(vmm_region_space_t* space, uintptr_t addr, vmm_region_t* out);
+
+#endif // VMM_REGION_H
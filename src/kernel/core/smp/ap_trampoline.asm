@@ -0,0 +1,121 @@
+; ===========================================================================
+; AP TRAMPOLINE - Real mode → Long mode для Application Processors
+; ===========================================================================
+;
+; Код линкуется в ядро, но исполняется из копии по AP_TRAMPOLINE_BASE
+; (smp.c копирует его туда перед SIPI, вектор = BASE >> 12).
+; Все абсолютные адреса считаются через TRAMP(), т.е. относительно копии.
+;
+; Параметры (ap_trampoline_params) заполняет BSP перед каждым SIPI:
+;   cr3   - PML4 ядра (должен быть < 4GB: грузится в 32-bit режиме)
+;   stack - вершина стека AP
+;   entry - C функция void ap_main(uint64_t cpu_index)
+;   cpu   - индекс CPU для ap_main
+;
+; ===========================================================================
+
+AP_TRAMPOLINE_BASE equ 0x8000       ; Stage2 после загрузки ядра не нужен
+
+%define TRAMP(x) (AP_TRAMPOLINE_BASE + ((x) - ap_trampoline_start))
+
+section .text
+
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_trampoline_params
+
+[BITS 16]
+ap_trampoline_start:
+    cli
+    cld
+
+    xor ax, ax
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+
+    ; Временный GDT (32-bit + 64-bit сегменты)
+    lgdt [TRAMP(ap_gdt_descriptor)]
+
+    ; Protected mode
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+
+    jmp dword 0x08:TRAMP(ap_protected_mode)
+
+[BITS 32]
+ap_protected_mode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+
+    ; PAE
+    mov eax, cr4
+    or eax, (1 << 5)
+    mov cr4, eax
+
+    ; Page tables ядра (те же, что у BSP)
+    mov eax, [TRAMP(ap_param_cr3)]
+    mov cr3, eax
+
+    ; Long Mode в EFER
+    mov ecx, 0xC0000080
+    rdmsr
+    or eax, (1 << 8)
+    wrmsr
+
+    ; Paging + WP (COW страницы ловятся и при записи из ядра, как на BSP)
+    mov eax, cr0
+    or eax, (1 << 31) | (1 << 16)
+    mov cr0, eax
+
+    jmp 0x18:TRAMP(ap_long_mode)
+
+[BITS 64]
+ap_long_mode:
+    mov ax, 0x20
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    mov rsp, [TRAMP(ap_param_stack)]
+    xor rbp, rbp
+
+    ; ap_main(cpu_index) - не возвращается
+    mov rdi, [TRAMP(ap_param_cpu)]
+    mov rax, [TRAMP(ap_param_entry)]
+    call rax
+
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+; ===== ВРЕМЕННЫЙ GDT (как в Stage2) =====
+align 8
+ap_gdt:
+    dq 0x0000000000000000           ; 0x00: Null
+    dq 0x00CF9A000000FFFF           ; 0x08: 32-bit Code
+    dq 0x00CF92000000FFFF           ; 0x10: 32-bit Data
+    dq 0x00209A0000000000           ; 0x18: 64-bit Code (L=1)
+    dq 0x0000920000000000           ; 0x20: 64-bit Data
+ap_gdt_end:
+
+align 4
+ap_gdt_descriptor:
+    dw ap_gdt_end - ap_gdt - 1
+    dd TRAMP(ap_gdt)
+
+; ===== ПАРАМЕТРЫ (заполняются BSP) =====
+align 8
+ap_trampoline_params:
+ap_param_cr3:   dq 0
+ap_param_stack: dq 0
+ap_param_entry: dq 0
+ap_param_cpu:   dq 0
+
+ap_trampoline_end:
@@ -0,0 +1,344 @@
+#include "smp.h"
+#include "lapic.h"
+#include "ioapic.h"
+#include "madt.h"
+#include "gdt.h"
+#include "idt.h"
+#include "fpu.h"
+#include "pit.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "events.h"
+#include "atomics.h"
+#include "klib.h"
+
+// ============================================================================
+// TRAMPOLINE (ap_trampoline.asm)
+// ============================================================================
+
+// Должен совпадать с AP_TRAMPOLINE_BASE в ap_trampoline.asm
+#define AP_TRAMPOLINE_BASE 0x8000
+
+extern char ap_trampoline_start[];
+extern char ap_trampoline_end[];
+extern char ap_trampoline_params[];
+
+typedef struct {
+    uint64_t cr3;
+    uint64_t stack;
+    uint64_t entry;
+    uint64_t cpu;
+} __attribute__((packed)) ap_trampoline_params_t;
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static smp_cpu_t smp_cpus[SMP_MAX_CPUS];
+static uint32_t smp_cpu_total = 1;          // BSP есть всегда
+static volatile uint32_t smp_cpus_online = 1;
+static madt_info_t smp_madt;
+
+// ============================================================================
+// AP ENTRY
+// ============================================================================
+
+// Вызывается из trampoline на стеке AP, IF=0
+static void ap_main(uint64_t cpu_index) {
+    smp_cpu_t* cpu = &smp_cpus[cpu_index];
+
+    // GDT/IDT ядра общие для всех CPU
+    gdt_load();
+    idt_load();
+    enable_fpu();
+    vmm_init_cpu();
+    lapic_init_ap();
+
+    atomic_store_u32(&cpu->online, 1);
+    atomic_increment_u32(&smp_cpus_online);
+
+    kprintf("[SMP] CPU %u (APIC ID %u) online, parked\n", cpu->cpu_index, cpu->apic_id);
+
+    // Ждём назначения работы от BSP
+    smp_work_func_t work;
+    while (!(work = cpu->work)) {
+        cpu_pause();
+    }
+
+    kprintf("[SMP] CPU %u running %s\n", cpu->cpu_index, cpu->work_name);
+    work();
+
+    // PRODUCTION: deck loops не возвращаются - если вернулся, просто стоим
+    kprintf("[SMP] %[W]CPU %u: %s returned, halting%[D]\n", cpu->cpu_index, cpu->work_name);
+    while (1) {
+        asm volatile("cli; hlt");
+    }
+}
+
+// ============================================================================
+// AP STARTUP (INIT-SIPI-SIPI)
+// ============================================================================
+
+static int smp_wait_online(smp_cpu_t* cpu, uint32_t timeout_us, uint32_t step_us) {
+    for (uint32_t waited = 0; waited < timeout_us; waited += step_us) {
+        if (atomic_load_u32(&cpu->online)) {
+            return 1;
+        }
+        pit_udelay(step_us);
+    }
+    return atomic_load_u32(&cpu->online) != 0;
+}
+
+static int smp_boot_ap(smp_cpu_t* cpu) {
+    cpu->stack = pmm_alloc_zero(SMP_AP_STACK_PAGES);
+    if (!cpu->stack) {
+        kprintf("[SMP] ERROR: No memory for CPU %u stack\n", cpu->cpu_index);
+        return 0;
+    }
+
+    uint64_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    cr3 &= VMM_PAGE_MASK;  // Без PCID: в 32-bit режиме младшие биты - PWT/PCD
+
+    // AP грузит CR3 в 32-bit режиме
+    if (cr3 >> 32) {
+        kprintf("[SMP] ERROR: Kernel PML4 above 4GB (0x%lx), cannot start APs\n", cr3);
+        pmm_free(cpu->stack, SMP_AP_STACK_PAGES);
+        cpu->stack = 0;
+        return 0;
+    }
+
+    volatile ap_trampoline_params_t* params = (volatile ap_trampoline_params_t*)
+        (AP_TRAMPOLINE_BASE + (ap_trampoline_params - ap_trampoline_start));
+    params->cr3 = cr3;
+    params->stack = (uint64_t)cpu->stack + SMP_AP_STACK_PAGES * PMM_PAGE_SIZE;
+    params->entry = (uint64_t)ap_main;
+    params->cpu = cpu->cpu_index;
+    MEMORY_BARRIER();
+
+    uint8_t vector_page = (uint8_t)(AP_TRAMPOLINE_BASE >> 12);
+
+    // INIT, 10ms, SIPI, (200us) SIPI - Intel MP spec
+    if (!lapic_send_init(cpu->apic_id)) {
+        kprintf("[SMP] ERROR: INIT IPI to APIC %u not delivered\n", cpu->apic_id);
+        return 0;
+    }
+    pit_udelay(10000);
+
+    lapic_send_startup(cpu->apic_id, vector_page);
+    if (!smp_wait_online(cpu, 200, 100)) {
+        lapic_send_startup(cpu->apic_id, vector_page);
+        smp_wait_online(cpu, SMP_AP_BOOT_TIMEOUT_MS * 1000, 1000);
+    }
+
+    if (!atomic_load_u32(&cpu->online)) {
+        kprintf("[SMP] %[E]CPU %u (APIC ID %u) did not come online%[D]\n",
+                cpu->cpu_index, cpu->apic_id);
+        return 0;
+    }
+    return 1;
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void smp_init(void) {
+    kprintf("[SMP] Initializing SMP...\n");
+
+    memset(smp_cpus, 0, sizeof(smp_cpus));
+    uint8_t bsp_apic_id = lapic_get_id();
+
+    smp_cpus[0].cpu_index = 0;
+    smp_cpus[0].apic_id = bsp_apic_id;
+    smp_cpus[0].online = 1;
+    smp_cpus[0].work_name = "Guide (timer IRQ)";
+
+    madt_parse(&smp_madt);
+
+    if (!lapic_init(smp_madt.lapic_phys)) {
+        kprintf("[SMP] %[W]No LAPIC - running on BSP only%[D]\n");
+        return;
+    }
+
+    if (smp_madt.ioapic_phys) {
+        ioapic_init(smp_madt.ioapic_phys, smp_madt.ioapic_gsi_base);
+    }
+
+    if (!smp_madt.found || smp_madt.cpu_count <= 1) {
+        kprintf("[SMP] Single CPU system\n");
+        return;
+    }
+
+    // Trampoline в low memory (AP стартует в real mode)
+    uint64_t trampoline_size = (uint64_t)(ap_trampoline_end - ap_trampoline_start);
+    memcpy((void*)AP_TRAMPOLINE_BASE, ap_trampoline_start, trampoline_size);
+    kprintf("[SMP] AP trampoline: %lu bytes at 0x%x\n", trampoline_size, AP_TRAMPOLINE_BASE);
+
+    // CPU индексы: 0 = BSP, дальше AP в порядке MADT
+    for (uint32_t i = 0; i < smp_madt.cpu_count; i++) {
+        uint8_t apic_id = smp_madt.apic_ids[i];
+        if (apic_id == bsp_apic_id) {
+            continue;
+        }
+
+        smp_cpu_t* cpu = &smp_cpus[smp_cpu_total];
+        cpu->cpu_index = smp_cpu_total;
+        cpu->apic_id = apic_id;
+        smp_cpu_total++;
+
+        smp_boot_ap(cpu);
+    }
+
+    kprintf("[SMP] %[S]%u of %u CPUs online%[D]\n", smp_cpus_online, smp_cpu_total);
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+uint32_t smp_cpu_count(void) {
+    return smp_cpu_total;
+}
+
+uint32_t smp_online_count(void) {
+    return atomic_load_u32(&smp_cpus_online);
+}
+
+uint32_t smp_current_cpu(void) {
+    if (smp_cpu_total == 1) {
+        return 0;
+    }
+
+    uint8_t apic_id = lapic_get_id();
+    for (uint32_t i = 0; i < smp_cpu_total; i++) {
+        if (smp_cpus[i].apic_id == apic_id) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+uint8_t smp_cpu_apic_id(uint32_t cpu_index) {
+    if (cpu_index >= smp_cpu_total) {
+        cpu_index = 0;
+    }
+    return smp_cpus[cpu_index].apic_id;
+}
+
+// ============================================================================
+// WORK PLACEMENT
+// ============================================================================
+
+int smp_run_on_cpu(uint32_t cpu_index, smp_work_func_t work, const char* name) {
+    // DEFENSIVE: BSP не паркуется, работу получают только online AP
+    if (cpu_index == 0 || cpu_index >= smp_cpu_total || !work) {
+        return 0;
+    }
+
+    smp_cpu_t* cpu = &smp_cpus[cpu_index];
+    if (!atomic_load_u32(&cpu->online) || cpu->work) {
+        return 0;
+    }
+
+    cpu->work_name = name;
+    MEMORY_BARRIER();
+    cpu->work = work;
+    return 1;
+}
+
+void smp_place_decks(void) {
+    extern void operations_deck_run(void);
+    extern void storage_deck_run(void);
+    extern void hardware_deck_run(void);
+    extern void execution_deck_run(void);
+    extern void guide_set_deck_pinned(uint8_t deck_prefix, int pinned);
+    extern int guide_deck_is_pinned(uint8_t deck_prefix);
+    extern void guide_sqpoll_run(void);
+    extern void guide_set_sqpoll_pinned(int pinned);
+
+    // Порядок = приоритет на ядро. DECK_PREFIX_NONE = Execution Deck
+    struct {
+        const char* name;
+        uint8_t deck_prefix;
+        smp_work_func_t run;
+    } placement[] = {
+        { "Operations Deck", DECK_PREFIX_OPERATIONS, operations_deck_run },
+        { "Storage Deck",    DECK_PREFIX_STORAGE,    storage_deck_run },
+        { "Hardware Deck",   DECK_PREFIX_HARDWARE,   hardware_deck_run },
+#ifdef SMP_PIN_EXECUTION_DECK
+        { "Execution Deck",  DECK_PREFIX_NONE,       execution_deck_run },
+#endif
+    };
+    uint32_t placement_count = sizeof(placement) / sizeof(placement[0]);
+
+    uint32_t next_cpu = 1;
+    for (uint32_t i = 0; i < placement_count; i++) {
+        while (next_cpu < smp_cpu_total && !atomic_load_u32(&smp_cpus[next_cpu].online)) {
+            next_cpu++;
+        }
+
+        if (next_cpu >= smp_cpu_total) {
+            kprintf("[SMP] %s stays on BSP (no free AP)\n", placement[i].name);
+            continue;
+        }
+
+        // CRITICAL: Сначала Guide перестаёт быть consumer'ом этой очереди
+        guide_set_deck_pinned(placement[i].deck_prefix, 1);
+
+        if (!smp_run_on_cpu(next_cpu, placement[i].run, placement[i].name)) {
+            guide_set_deck_pinned(placement[i].deck_prefix, 0);
+            kprintf("[SMP] ERROR: Failed to place %s on CPU %u\n", placement[i].name, next_cpu);
+            continue;
+        }
+
+        kprintf("[SMP] %s -> CPU %u (APIC ID %u)\n",
+                placement[i].name, next_cpu, smp_cpus[next_cpu].apic_id);
+        next_cpu++;
+    }
+
+    // SQPOLL poller: следующий свободный AP. Иначе EventRing поллит timer
+    // interrupt BSP, и событие ждёт до одного tick
+    while (next_cpu < smp_cpu_total && !atomic_load_u32(&smp_cpus[next_cpu].online)) {
+        next_cpu++;
+    }
+    if (next_cpu < smp_cpu_total) {
+        guide_set_sqpoll_pinned(1);
+        if (smp_run_on_cpu(next_cpu, guide_sqpoll_run, "SQPOLL Poller")) {
+            kprintf("[SMP] SQPOLL Poller -> CPU %u (APIC ID %u)\n",
+                    next_cpu, smp_cpus[next_cpu].apic_id);
+            next_cpu++;
+        } else {
+            guide_set_sqpoll_pinned(0);
+        }
+    } else {
+        kprintf("[SMP] SQPOLL Poller stays on BSP timer IRQ (no free AP)\n");
+    }
+
+    // Оставшиеся AP - дополнительные Operations workers (work-stealing пул).
+    // Только если Operations уже снят с Guide: иначе input queue читает BSP
+    if (!guide_deck_is_pinned(DECK_PREFIX_OPERATIONS)) {
+        return;
+    }
+
+    for (; next_cpu < smp_cpu_total; next_cpu++) {
+        if (!atomic_load_u32(&smp_cpus[next_cpu].online)) {
+            continue;
+        }
+        if (smp_run_on_cpu(next_cpu, operations_deck_run, "Operations Worker")) {
+            kprintf("[SMP] Operations Worker -> CPU %u (APIC ID %u)\n",
+                    next_cpu, smp_cpus[next_cpu].apic_id);
+        }
+    }
+}
+
+void smp_print_info(void) {
+    kprintf("\n%[H]=== SMP ===%[D]\n");
+    kprintf("CPUs: %u total, %u online\n", smp_cpu_total, smp_online_count());
+    for (uint32_t i = 0; i < smp_cpu_total; i++) {
+        smp_cpu_t* cpu = &smp_cpus[i];
+        kprintf("  CPU %u: APIC ID %u, %s, %s\n", cpu->cpu_index, cpu->apic_id,
+                cpu->online ? "online" : "offline",
+                cpu->work_name ? cpu->work_name : "parked");
+    }
+}
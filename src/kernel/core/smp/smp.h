@@ -0,0 +1,71 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "ktypes.h"
+#include "madt.h"
+
+// ============================================================================
+// SMP - Application Processor bring-up и размещение decks по ядрам
+// ============================================================================
+//
+// smp_init():
+//   1. MADT → список APIC ID, адреса LAPIC/IOAPIC
+//   2. LAPIC BSP (virtual wire: PIC остаётся источником IRQ 0-15)
+//   3. IOAPIC (все входы замаскированы)
+//   4. INIT-SIPI-SIPI для каждого AP → AP паркуется в ap_main()
+//
+// smp_place_decks():
+//   Каждому deck из таблицы размещения - отдельный AP, на котором крутится
+//   его deck_run loop. Guide перестаёт вызывать run_once для этих decks
+//   (DeckQueue - SPSC, у очереди может быть только один consumer).
+//   Decks без своего ядра по-прежнему обслуживаются из timer IRQ на BSP.
+//   Следующий свободный AP - SQPOLL poller (guide_sqpoll_run).
+//   AP, оставшиеся после этого, становятся дополнительными workers
+//   Operations Deck (work-stealing; один тяжёлый workflow занимает все ядра).
+//
+// ============================================================================
+
+#define SMP_MAX_CPUS          MADT_MAX_CPUS
+#define SMP_AP_STACK_PAGES    4            // 16KB стек на AP
+#define SMP_AP_BOOT_TIMEOUT_MS 100         // Ожидание ap_main после SIPI
+
+// Execution Deck пишет результаты в ResultRing владельца события, но
+// kernel-side события без владельца идут process_get_current()
+// (completion IRQ будит процессы в runqueue их CPU под её lock'ом).
+// Поэтому по умолчанию Execution остаётся на BSP.
+// Собрать с -DSMP_PIN_EXECUTION_DECK чтобы выделить ему ядро.
+
+// Работа для AP (не возвращается)
+typedef void (*smp_work_func_t)(void);
+
+typedef struct {
+    uint32_t cpu_index;                 // 0 = BSP
+    uint8_t apic_id;
+    volatile uint32_t online;           // AP дошёл до ap_main
+    smp_work_func_t volatile work;      // Назначенная работа (NULL = parked)
+    const char* work_name;
+    void* stack;                        // База стека (pmm)
+} smp_cpu_t;
+
+// Инициализация APIC и запуск AP (вызывать с IF=0, до создания процессов)
+void smp_init(void);
+
+// Количество CPU (из MADT) / запущенных (BSP + online AP)
+uint32_t smp_cpu_count(void);
+uint32_t smp_online_count(void);
+
+// Индекс текущего CPU (0 = BSP)
+uint32_t smp_current_cpu(void);
+
+// APIC ID CPU по индексу (адресат IPI)
+uint8_t smp_cpu_apic_id(uint32_t cpu_index);
+
+// Отдать parked AP работу. Возвращает 1 при успехе
+int smp_run_on_cpu(uint32_t cpu_index, smp_work_func_t work, const char* name);
+
+// Политика размещения decks по свободным AP
+void smp_place_decks(void);
+
+void smp_print_info(void);
+
+#endif // SMP_H
@@ -0,0 +1,233 @@
+#include "trace.h"
+#include "smp.h"
+#include "pmm.h"
+#include "atomics.h"
+#include "klib.h"
+
+// ============================================================================
+// PER-CPU RING
+// ============================================================================
+
+typedef struct {
+    volatile uint64_t head __attribute__((aligned(64)));     // Writers (lock xadd)
+    uint64_t drained;                                        // Только drain (под trace_drain_lock)
+    volatile uint64_t dropped;                               // Перезаписано до drain
+    TraceRecord records[TRACE_RING_SIZE] __attribute__((aligned(64)));
+} TraceBuffer;
+
+#define TRACE_BUFFER_PAGES ((sizeof(TraceBuffer) + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE)
+
+// PRODUCTION: буферы из pmm, а не BSS - ядро линкуется flat binary
+static TraceBuffer* trace_buffers[SMP_MAX_CPUS];
+static volatile uint32_t trace_ready = 0;
+static spinlock_t trace_drain_lock;
+
+static const struct {
+    const char* name;
+    const char* a;
+    const char* b;
+} trace_point_info[TRACE_POINT_COUNT] = {
+    [TRACE_SYSCALL_SUBMIT]  = { "SYSCALL_SUBMIT",  "pid",      "events" },
+    [TRACE_SYSCALL_EVENT]   = { "SYSCALL_EVENT",   "event",    "type" },
+    [TRACE_SYSCALL_THROTTLE] = { "SYSCALL_THROTTLE", "pid",     "waiting" },
+    [TRACE_SYSCALL_SQPOLL]  = { "SYSCALL_SQPOLL",  "pid",      "workflow" },
+    [TRACE_SYSCALL_WAIT]    = { "SYSCALL_WAIT",    "pid",      "workflow" },
+    [TRACE_SYSCALL_WAKE]    = { "SYSCALL_WAKE",    "pid",      "workflow" },
+    [TRACE_SYSCALL_YIELD]   = { "SYSCALL_YIELD",   "pid",      "-" },
+    [TRACE_SYSCALL_BAD_WORKFLOW] = { "SYSCALL_BAD_WORKFLOW", "pid", "workflow" },
+    [TRACE_ROUTING_INSERT]  = { "ROUTING_INSERT",  "event",    "slot" },
+    [TRACE_DECK_PROCESS]    = { "DECK_PROCESS",    "event",    "deck" },
+    [TRACE_DECK_ERROR]      = { "DECK_ERROR",      "event",    "code" },
+    [TRACE_RESULT_STAGE]    = { "RESULT_STAGE",    "event",    "pid" },
+    [TRACE_RESULT_PUBLISH]  = { "RESULT_PUBLISH",  "procs",    "results" },
+    [TRACE_COMPLETION_IRQ]  = { "COMPLETION_IRQ",  "woken",    "-" },
+    [TRACE_RESULT_COLLECT]  = { "RESULT_COLLECT",  "event",    "step" },
+    [TRACE_RESULT_FREE]     = { "RESULT_FREE",     "event",    "step" },
+    [TRACE_VMM_ALLOC]       = { "VMM_ALLOC",       "virt",     "pages" },
+    [TRACE_VMM_FREE]        = { "VMM_FREE",        "virt",     "pages" },
+    [TRACE_TIMER_EXPIRE]    = { "TIMER_EXPIRE",    "timer",    "late_ms" },
+};
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void trace_init(void) {
+    spinlock_init(&trace_drain_lock);
+
+    // CPU count ещё неизвестен (smp_init позже) - буфер на каждый возможный
+    uint32_t allocated = 0;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        trace_buffers[i] = (TraceBuffer*)pmm_alloc_zero(TRACE_BUFFER_PAGES);
+        if (!trace_buffers[i]) {
+            kprintf("[TRACE] %[W]No memory for CPU %u buffer - CPU not traced%[D]\n", i);
+            continue;
+        }
+        allocated++;
+    }
+
+    MEMORY_BARRIER();
+    atomic_store_u32(&trace_ready, 1);
+
+    kprintf("[TRACE] %u per-CPU rings x %u records (level %u)\n",
+            allocated, TRACE_RING_SIZE, TRACE_LEVEL);
+}
+
+// ============================================================================
+// LEVEL 1: WRITER (hot path)
+// ============================================================================
+
+void trace_record(uint8_t level, uint16_t point, uint64_t a, uint64_t b) {
+    // DEFENSIVE: trace points до trace_init просто теряются
+    if (!trace_ready) {
+        return;
+    }
+
+    uint32_t cpu = smp_current_cpu();
+    TraceBuffer* buf = trace_buffers[cpu];
+    if (!buf) {
+        return;
+    }
+
+    // Позиция уникальна даже если IRQ на этом CPU прервал другой trace point
+    uint64_t pos = atomic_increment_u64(&buf->head) - 1;
+    TraceRecord* rec = &buf->records[pos & TRACE_RING_MASK];
+
+    rec->seq = 0;
+    COMPILER_BARRIER();
+    rec->tsc = rdtsc();
+    rec->point = point;
+    rec->cpu = (uint8_t)cpu;
+    rec->level = level;
+    rec->a = a;
+    rec->b = b;
+    COMPILER_BARRIER();  // TSO: поля видны раньше commit
+    rec->seq = (uint32_t)(pos + 1);
+}
+
+// ============================================================================
+// LEVEL 2: DRAIN (merge по TSC + форматирование)
+// ============================================================================
+
+// Следующий готовый record CPU. 1 = скопирован в out, 0 = ring пуст / writer не закончил
+static int trace_peek(TraceBuffer* buf, TraceRecord* out) {
+    while (1) {
+        uint64_t head = atomic_load_u64(&buf->head);
+
+        // Writer обогнал drain больше чем на ring - старое уже перезаписано
+        if (head - buf->drained > TRACE_RING_SIZE) {
+            uint64_t lost = head - TRACE_RING_SIZE - buf->drained;
+            atomic_add_u64(&buf->dropped, lost);
+            buf->drained = head - TRACE_RING_SIZE;
+        }
+
+        if (buf->drained == head) {
+            return 0;
+        }
+
+        TraceRecord* rec = &buf->records[buf->drained & TRACE_RING_MASK];
+        uint32_t expected = (uint32_t)(buf->drained + 1);
+
+        if (rec->seq != expected) {
+            // Либо writer ещё пишет этот slot, либо его уже перезаписали
+            if (atomic_load_u64(&buf->head) - buf->drained > TRACE_RING_SIZE) {
+                continue;
+            }
+            return 0;
+        }
+
+        *out = *rec;
+        COMPILER_BARRIER();
+
+        // Seqlock: запись могли перезаписать во время копирования
+        if (rec->seq != expected) {
+            continue;
+        }
+        return 1;
+    }
+}
+
+uint32_t trace_drain(uint32_t max_records) {
+    if (!trace_ready) {
+        return 0;
+    }
+
+    // Один drain одновременно (shell + stats dump)
+    if (!spin_trylock(&trace_drain_lock)) {
+        kprintf("[TRACE] %[W]Drain already in progress%[D]\n");
+        return 0;
+    }
+
+    uint32_t cpu_count = smp_cpu_count();
+    uint32_t printed = 0;
+    uint64_t base_tsc = 0;
+
+    kprintf("\n%[H]=== Trace ===%[D]\n");
+
+    while (max_records == 0 || printed < max_records) {
+        // Самый старый record среди всех CPU
+        TraceRecord best = {0};
+        TraceBuffer* best_buf = 0;
+
+        for (uint32_t i = 0; i < cpu_count; i++) {
+            TraceBuffer* buf = trace_buffers[i];
+            TraceRecord rec;
+            if (!buf || !trace_peek(buf, &rec)) {
+                continue;
+            }
+            if (!best_buf || rec.tsc < best.tsc) {
+                best = rec;
+                best_buf = buf;
+            }
+        }
+
+        if (!best_buf) {
+            break;
+        }
+        best_buf->drained++;
+
+        if (printed == 0) {
+            base_tsc = best.tsc;
+        }
+
+        const char* name = "UNKNOWN";
+        const char* a_label = "a";
+        const char* b_label = "b";
+        if (best.point < TRACE_POINT_COUNT && trace_point_info[best.point].name) {
+            name = trace_point_info[best.point].name;
+            a_label = trace_point_info[best.point].a;
+            b_label = trace_point_info[best.point].b;
+        }
+
+        kprintf("  +%lu cpu%u %s %s=%lu %s=%lu\n",
+                best.tsc - base_tsc, best.cpu, name, a_label, best.a, b_label, best.b);
+        printed++;
+    }
+
+    kprintf("[TRACE] %u records\n", printed);
+    spin_unlock(&trace_drain_lock);
+    return printed;
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+void trace_print_stats(void) {
+    kprintf("\n%[H]=== Trace Buffers ===%[D]\n");
+    if (!trace_ready) {
+        kprintf("  not initialized\n");
+        return;
+    }
+
+    uint32_t cpu_count = smp_cpu_count();
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        TraceBuffer* buf = trace_buffers[i];
+        if (!buf) {
+            continue;
+        }
+        uint64_t head = atomic_load_u64(&buf->head);
+        kprintf("  CPU %u: recorded=%lu pending=%lu dropped=%lu\n",
+                i, head, head - buf->drained, atomic_load_u64(&buf->dropped));
+    }
+}
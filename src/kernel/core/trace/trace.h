@@ -0,0 +1,104 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// TRACE - Lock-free binary trace buffer для hot paths
+// ============================================================================
+//
+// kprintf пишет побайтно в serial и VGA - на hot path pipeline это дороже
+// самой работы. Trace point вместо этого кладёт fixed record (32 байта,
+// TSC timestamp + 2 аргумента) в ring своего CPU:
+//
+//   Level 1: per-CPU ring (TRACE_RING_SIZE records) - один lock xadd на
+//            запись, без блокировок, безопасно из IRQ на том же CPU
+//   Level 2: trace_drain() сливает все CPU rings по TSC и форматирует
+//            через kprintf (shell "trace" / EVENT_SYSTEM_TRACE, stats dump)
+//
+// Переполнение не блокирует writer: старые records перезаписываются,
+// drain считает потерянные.
+//
+// Уровни задаются при сборке: -DTRACE_LEVEL=0 убирает все trace points
+// (аргументы не вычисляются, кода нет). По умолчанию TRACE_LEVEL_INFO.
+//
+// ============================================================================
+
+#define TRACE_LEVEL_NONE   0
+#define TRACE_LEVEL_INFO   1    // Pipeline: submit, routing, deck, result, IRQ
+#define TRACE_LEVEL_DEBUG  2    // Детали: cleanup, per-entry ownership
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+#define TRACE_RING_SIZE 512                   // Records на CPU (16KB, степень 2)
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+// Static trace points (имена и подписи аргументов - trace.c)
+typedef enum {
+    TRACE_SYSCALL_SUBMIT = 0,   // a = pid, b = events accepted
+    TRACE_SYSCALL_EVENT,        // a = event_id, b = type
+    TRACE_SYSCALL_THROTTLE,     // a = pid, b = события, ждущие ResultRing credit
+    TRACE_SYSCALL_SQPOLL,       // a = pid, b = workflow (NOTIFY_SQPOLL)
+    TRACE_SYSCALL_WAIT,         // a = pid, b = workflow (процесс уходит в WAITING)
+    TRACE_SYSCALL_WAKE,         // a = pid, b = workflow (WAIT завершён)
+    TRACE_SYSCALL_YIELD,        // a = pid
+    TRACE_SYSCALL_BAD_WORKFLOW, // a = pid, b = workflow (WAIT/POLL: нет такого)
+    TRACE_ROUTING_INSERT,       // a = event_id, b = EventRing slot (-1 = kernel)
+    TRACE_DECK_PROCESS,         // a = event_id, b = deck prefix
+    TRACE_DECK_ERROR,           // a = event_id, b = error code (старший байт = deck)
+    TRACE_RESULT_STAGE,         // a = event_id, b = pid
+    TRACE_RESULT_PUBLISH,       // a = processes notified, b = results
+    TRACE_COMPLETION_IRQ,       // a = processes woken
+    TRACE_RESULT_COLLECT,       // a = event_id, b = deck step (-1 = none)
+    TRACE_RESULT_FREE,          // a = event_id, b = deck step
+    TRACE_VMM_ALLOC,            // a = virt, b = pages (vmm_alloc_pages / vmalloc)
+    TRACE_VMM_FREE,             // a = virt, b = pages
+    TRACE_TIMER_EXPIRE,         // a = timer id, b = опоздание в ms
+    TRACE_POINT_COUNT
+} TracePoint;
+
+typedef struct {
+    uint64_t tsc;               // rdtsc() в момент trace point
+    uint32_t seq;               // Позиция + 1 (commit: 0 = запись не закончена)
+    uint16_t point;             // TracePoint
+    uint8_t cpu;
+    uint8_t level;
+    uint64_t a;
+    uint64_t b;
+} TraceRecord;
+
+_Static_assert(sizeof(TraceRecord) == 32, "TraceRecord must be 32 bytes");
+
+void trace_init(void);
+
+// Записать record в ring текущего CPU (не вызывать напрямую - TRACE_*)
+void trace_record(uint8_t level, uint16_t point, uint64_t a, uint64_t b);
+
+// Отформатировать до max_records самых старых records (0 = все).
+// Возвращает количество выведенных
+uint32_t trace_drain(uint32_t max_records);
+
+void trace_print_stats(void);
+
+// ============================================================================
+// TRACE POINTS
+// ============================================================================
+
+// Disabled: if (0) - аргументы проверяются компилятором, но кода нет
+#define TRACE_NOP(a, b) do { if (0) { (void)(a); (void)(b); } } while (0)
+
+#if TRACE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_INFO(point, a, b) trace_record(TRACE_LEVEL_INFO, (point), (uint64_t)(a), (uint64_t)(b))
+#else
+#define TRACE_INFO(point, a, b) TRACE_NOP(a, b)
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_DEBUG(point, a, b) trace_record(TRACE_LEVEL_DEBUG, (point), (uint64_t)(a), (uint64_t)(b))
+#else
+#define TRACE_DEBUG(point, a, b) TRACE_NOP(a, b)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,895 @@
+#include "ahci.h"
+#include "klib.h"
+#include "io.h"  // mmio_read32, mmio_write32, pause
+#include "pmm.h"
+#include "vmm.h"  // vmm_map_mmio, vmm_virt_to_phys_direct
+#include "pic.h"
+#include "pci.h"
+#include "atomics.h"
+
+// ============================================================================
+// HBA STRUCTURES
+// ============================================================================
+
+// Command header: 32 байта, 32 штуки = command list порта (1KB)
+typedef struct __attribute__((packed)) {
+    uint16_t flags;                     // CFL (4:0), W (6), C (10)
+    uint16_t prdtl;                     // PRD entries
+    volatile uint32_t prdbc;            // Передано байт (пишет HBA)
+    uint32_t ctba;                      // Command table (128B aligned)
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} AHCICommandHeader;
+
+typedef struct __attribute__((packed)) {
+    uint32_t dba;                       // Data base address (чётный)
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;                       // Байт - 1 (21:0), bit 31 - IRQ on completion
+} AHCIPrd;
+
+typedef struct __attribute__((packed)) {
+    uint8_t cfis[64];                   // Command FIS
+    uint8_t acmd[16];                   // ATAPI - не используем
+    uint8_t reserved[48];
+    AHCIPrd prdt[AHCI_PRDT_ENTRIES];
+} AHCICommandTable;
+
+// Host to device register FIS
+typedef struct __attribute__((packed)) {
+    uint8_t type;                       // AHCI_FIS_REG_H2D
+    uint8_t flags;                      // AHCI_FIS_COMMAND
+    uint8_t command;
+    uint8_t feature_lo;                 // NCQ: sector count (7:0)
+    uint8_t lba0;
+    uint8_t lba1;
+    uint8_t lba2;
+    uint8_t device;                     // Bit 6 = LBA, NCQ: bit 7 = FUA
+    uint8_t lba3;
+    uint8_t lba4;
+    uint8_t lba5;
+    uint8_t feature_hi;                 // NCQ: sector count (15:8)
+    uint8_t count_lo;                   // NCQ: tag << 3
+    uint8_t count_hi;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} AHCIFisH2D;
+
+// Первый порт с SATA диском
+typedef struct {
+    uintptr_t regs;                     // MMIO порта
+    uint8_t index;
+    uint8_t ncq;                        // READ/WRITE FPDMA QUEUED
+    uint8_t fua;                        // WRITE DMA FUA EXT (без NCQ)
+    uint32_t slot_mask;                 // Доступные слоты (min(CAP.NCS, NCQ depth))
+    AHCICommandHeader* command_list;    // + FIS receive area в той же странице
+    AHCICommandTable* tables[AHCI_MAX_SLOTS];
+    ATARequest* slot_request[AHCI_MAX_SLOTS];
+    uint32_t busy;                      // Выданные HBA слоты
+    uint32_t flushing;                  // Слот выполняет FLUSH CACHE после записи
+    ATADevice device;
+} AHCIPort;
+
+static uintptr_t ahci_abar = 0;
+static uint32_t ahci_cap = 0;
+static uint8_t ahci_irq_line = 0xFF;
+static volatile uint8_t ahci_ready = 0;
+static volatile uint8_t ahci_irq_enabled = 0;
+static AHCIPort ahci_disk;
+
+// ============================================================================
+// REGISTER ACCESS
+// ============================================================================
+
+static inline uint32_t ahci_read(uint32_t reg) {
+    return mmio_read32(ahci_abar + reg);
+}
+
+static inline void ahci_write(uint32_t reg, uint32_t value) {
+    mmio_write32(ahci_abar + reg, value);
+}
+
+static inline uint32_t ahci_port_read(uint32_t reg) {
+    return mmio_read32(ahci_disk.regs + reg);
+}
+
+static inline void ahci_port_write(uint32_t reg, uint32_t value) {
+    mmio_write32(ahci_disk.regs + reg, value);
+}
+
+// Ждать (reg & mask) == value. 0 при успехе, -1 по timeout
+static int ahci_port_wait(uint32_t reg, uint32_t mask, uint32_t value) {
+    for (int timeout = 1000000; timeout > 0; timeout--) {
+        if ((ahci_port_read(reg) & mask) == value) {
+            return 0;
+        }
+        pause();
+    }
+    return -1;
+}
+
+// ============================================================================
+// PORT CONTROL
+// ============================================================================
+
+// Остановить command list и FIS receive (перед сменой CLB/FB и после ошибки)
+static int ahci_port_stop(void) {
+    ahci_port_write(AHCI_PxCMD, ahci_port_read(AHCI_PxCMD) & ~AHCI_PxCMD_ST);
+    if (ahci_port_wait(AHCI_PxCMD, AHCI_PxCMD_CR, 0) != 0) {
+        return -1;
+    }
+
+    ahci_port_write(AHCI_PxCMD, ahci_port_read(AHCI_PxCMD) & ~AHCI_PxCMD_FRE);
+    return ahci_port_wait(AHCI_PxCMD, AHCI_PxCMD_FR, 0);
+}
+
+static void ahci_port_start(void) {
+    ahci_port_write(AHCI_PxCMD, ahci_port_read(AHCI_PxCMD) | AHCI_PxCMD_FRE);
+
+    // ST только когда устройство не BSY/DRQ (AHCI 1.3 §10.3.1)
+    if (ahci_port_wait(AHCI_PxTFD, ATA_SR_BSY | ATA_SR_DRQ, 0) != 0) {
+        kprintf("[AHCI] %[W]Port %u: device busy (tfd=0x%x), starting anyway%[D]\n",
+                ahci_disk.index, ahci_port_read(AHCI_PxTFD));
+    }
+    ahci_port_write(AHCI_PxCMD, ahci_port_read(AHCI_PxCMD) | AHCI_PxCMD_ST);
+}
+
+// COMRESET: устройство застряло в BSY/DRQ - только reset линка
+static void ahci_port_comreset(void) {
+    uint32_t sctl = ahci_port_read(AHCI_PxSCTL) & ~AHCI_SSTS_DET_MASK;
+    ahci_port_write(AHCI_PxSCTL, sctl | AHCI_SCTL_DET_COMRESET);
+    for (volatile int i = 0; i < 100000; i++) { }  // >= 1ms
+    ahci_port_write(AHCI_PxSCTL, sctl);
+
+    if (ahci_port_wait(AHCI_PxSSTS, AHCI_SSTS_DET_MASK, AHCI_SSTS_DET_PRESENT) != 0) {
+        kprintf("[AHCI] %[E]Port %u: link down after COMRESET%[D]\n", ahci_disk.index);
+    }
+    ahci_port_write(AHCI_PxSERR, 0xFFFFFFFF);
+}
+
+// ============================================================================
+// COMMAND BUILDING
+// ============================================================================
+
+// Физический адрес для PRD: identity mapping, иначе через page tables
+static uint64_t ahci_phys(const uint8_t* addr) {
+    uint64_t phys = vmm_virt_to_phys_direct((void*)addr);
+    if (phys == 0) {
+        phys = vmm_virt_to_phys(vmm_get_kernel_context(), (uintptr_t)addr);
+    }
+    return phys;
+}
+
+// Заполнить PRDT: сектор s - chunks[s / chunk_sectors] + (s % chunk_sectors) * 512.
+// Буфер вне identity mapping - по странице, соседние физические куски
+// склеиваются. prdt = NULL - только проверить. Возвращает entries или -1
+static int ahci_build_prdt(AHCIPrd* prdt, const uint8_t* const* chunks, uint32_t count,
+                           uint32_t chunk_sectors) {
+    int entries = 0;
+    uint64_t last_end = 0;
+    uint32_t last_bytes = 0;
+
+    for (uint32_t first = 0; first < count; first += chunk_sectors) {
+        uint32_t sectors = count - first;
+        if (sectors > chunk_sectors) {
+            sectors = chunk_sectors;
+        }
+
+        const uint8_t* addr = chunks[first / chunk_sectors];
+        uint64_t remaining = (uint64_t)sectors * ATA_SECTOR_SIZE;
+        int direct = vmm_virt_to_phys_direct((void*)addr) != 0;
+
+        while (remaining > 0) {
+            uint64_t phys = ahci_phys(addr);
+            uint64_t piece = direct ? remaining : 4096 - ((uintptr_t)addr & 0xFFF);
+            if (piece > remaining) {
+                piece = remaining;
+            }
+
+            // DEFENSIVE: без S64A HBA видит только нижние 4GB
+            if (phys == 0 || (phys & 1) ||
+                (!(ahci_cap & AHCI_CAP_S64A) && phys + piece > 0x100000000ULL)) {
+                return -1;
+            }
+
+            while (piece > 0) {
+                uint32_t bytes = piece > AHCI_PRD_MAX_BYTES ? AHCI_PRD_MAX_BYTES : (uint32_t)piece;
+
+                if (entries > 0 && phys == last_end && last_bytes + bytes <= AHCI_PRD_MAX_BYTES) {
+                    last_bytes += bytes;
+                    if (prdt) {
+                        prdt[entries - 1].dbc = last_bytes - 1;
+                    }
+                } else {
+                    if (entries == AHCI_PRDT_ENTRIES) {
+                        return -1;
+                    }
+                    if (prdt) {
+                        prdt[entries].dba = (uint32_t)phys;
+                        prdt[entries].dbau = (uint32_t)(phys >> 32);
+                        prdt[entries].reserved = 0;
+                        prdt[entries].dbc = bytes - 1;
+                    }
+                    entries++;
+                    last_bytes = bytes;
+                }
+
+                last_end = phys + bytes;
+                phys += bytes;
+                addr += bytes;
+                piece -= bytes;
+                remaining -= bytes;
+            }
+        }
+    }
+
+    return entries;
+}
+
+static void ahci_build_fis(AHCICommandTable* table, uint8_t command, uint64_t lba, uint32_t count,
+                           uint8_t device) {
+    AHCIFisH2D* fis = (AHCIFisH2D*)table->cfis;
+    memset(fis, 0, sizeof(AHCIFisH2D));
+
+    fis->type = AHCI_FIS_REG_H2D;
+    fis->flags = AHCI_FIS_COMMAND;
+    fis->command = command;
+    fis->device = device;
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->lba3 = (lba >> 24) & 0xFF;
+    fis->lba4 = (lba >> 32) & 0xFF;
+    fis->lba5 = (lba >> 40) & 0xFF;
+    fis->count_lo = count & 0xFF;        // 65536 (LBA48) / 256 (LBA28) -> 0
+    fis->count_hi = (count >> 8) & 0xFF;
+}
+
+// Команда данных в слот. NCQ: sector count - в features, тег - в count
+static void ahci_build_transfer(uint32_t slot, const ATARequest* req, int entries) {
+    AHCICommandTable* table = ahci_disk.tables[slot];
+    uint8_t command;
+    uint8_t device = 0x40;  // LBA mode
+
+    if (ahci_disk.ncq) {
+        command = req->write ? AHCI_CMD_WRITE_FPDMA : AHCI_CMD_READ_FPDMA;
+        if (req->write) {
+            device |= 0x80;  // FUA: как ATA write + flush, без FLUSH в очереди
+        }
+    } else if (ahci_disk.device.lba48) {
+        command = req->write ? (ahci_disk.fua ? AHCI_CMD_WRITE_DMA_FUA : ATA_CMD_WRITE_DMA_EXT)
+                             : ATA_CMD_READ_DMA_EXT;
+    } else {
+        command = req->write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+        device |= (req->lba >> 24) & 0x0F;  // LBA28: старшие 4 бита - в device
+    }
+
+    ahci_build_fis(table, command, req->lba, req->count, device);
+    if (ahci_disk.ncq) {
+        AHCIFisH2D* fis = (AHCIFisH2D*)table->cfis;
+        fis->feature_lo = req->count & 0xFF;
+        fis->feature_hi = (req->count >> 8) & 0xFF;
+        fis->count_lo = (uint8_t)(slot << 3);
+        fis->count_hi = 0;
+    }
+
+    AHCICommandHeader* header = &ahci_disk.command_list[slot];
+    header->flags = AHCI_CMD_FIS_DWORDS | (req->write ? AHCI_CMD_WRITE : 0);
+    header->prdtl = (uint16_t)entries;
+    header->prdbc = 0;
+}
+
+// FLUSH CACHE (EXT) в тот же слот - запись без FUA и без NCQ
+static void ahci_build_flush(uint32_t slot) {
+    ahci_build_fis(ahci_disk.tables[slot],
+                   ahci_disk.device.lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH, 0, 0, 0x40);
+
+    AHCICommandHeader* header = &ahci_disk.command_list[slot];
+    header->flags = AHCI_CMD_FIS_DWORDS | AHCI_CMD_CLEAR_BUSY;
+    header->prdtl = 0;
+    header->prdbc = 0;
+}
+
+static inline void ahci_issue(uint32_t slot) {
+    COMPILER_BARRIER();  // Command table/header записаны до CI
+    if (ahci_disk.ncq) {
+        ahci_port_write(AHCI_PxSACT, 1u << slot);
+    }
+    ahci_port_write(AHCI_PxCI, 1u << slot);
+}
+
+// ============================================================================
+// QUEUE (ahci_lock)
+// ============================================================================
+//
+// Все команды - ATARequest: async от ata_submit() (done() из ahci_async_reap)
+// и синхронные (done = NULL, caller крутит ahci_async_poll пока status ==
+// AHCI_STATUS_PENDING). Ждущие слот - FIFO; слот освободился - сразу следующая.
+//
+// Ошибка (TFES/HBFS/...) - NCQ теряет очередь целиком: завершённые до неё
+// слоты засчитываем, остальным -1, порт перезапускается. Timeout - то же.
+
+#define AHCI_STATUS_PENDING     1
+
+static spinlock_t ahci_lock;
+static ATARequest* ahci_queue_head = NULL;  // Ждут слот
+static ATARequest* ahci_queue_tail = NULL;
+static ATARequest* ahci_done_head = NULL;   // Ждут ahci_async_reap()
+static ATARequest* ahci_done_tail = NULL;
+
+static struct {
+    volatile uint64_t submitted;
+    volatile uint64_t completed;
+    volatile uint64_t irq_completions;      // Увидел IRQ (остальные - опрос)
+    volatile uint64_t errors;
+    volatile uint64_t max_inflight;         // Глубина очереди устройства
+} ahci_stats;
+
+static void ahci_finish_slot(uint32_t slot, int status) {
+    ATARequest* req = ahci_disk.slot_request[slot];
+    ahci_disk.slot_request[slot] = NULL;
+    ahci_disk.busy &= ~(1u << slot);
+    ahci_disk.flushing &= ~(1u << slot);
+
+    if (status != 0) {
+        atomic_increment_u64(&ahci_stats.errors);
+    }
+
+    if (!req->done) {
+        // Синхронный: после записи status caller может уйти со стека
+        *(volatile int*)&req->status = status;
+        return;
+    }
+
+    req->status = status;
+    req->next = NULL;
+    if (ahci_done_tail) {
+        ahci_done_tail->next = req;
+    } else {
+        ahci_done_head = req;
+    }
+    ahci_done_tail = req;
+}
+
+static void ahci_start_next(void) {
+    while (ahci_queue_head) {
+        uint32_t free_slots = ahci_disk.slot_mask & ~ahci_disk.busy;
+        if (!free_slots) {
+            return;
+        }
+        uint32_t slot = (uint32_t)__builtin_ctz(free_slots);
+
+        ATARequest* req = ahci_queue_head;
+        ahci_queue_head = req->next;
+        if (!ahci_queue_head) {
+            ahci_queue_tail = NULL;
+        }
+        req->next = NULL;
+
+        ahci_disk.slot_request[slot] = req;
+        ahci_disk.busy |= 1u << slot;
+
+        int entries = ahci_build_prdt(ahci_disk.tables[slot]->prdt, (const uint8_t* const*)req->chunks,
+                                      req->count, req->chunk_sectors);
+        if (entries < 0) {
+            ahci_finish_slot(slot, -1);  // Проверено в submit - сюда не попадаем
+            continue;
+        }
+
+        ahci_build_transfer(slot, req, entries);
+        req->started_at = rdtsc();
+        ahci_issue(slot);
+
+        uint32_t inflight = (uint32_t)__builtin_popcount(ahci_disk.busy);
+        if (inflight > ahci_stats.max_inflight) {
+            ahci_stats.max_inflight = inflight;
+        }
+    }
+}
+
+// Ошибка порта: засчитать завершённое, остальным -1, перезапустить порт
+static void ahci_port_recover(uint32_t is, const char* reason) {
+    uint32_t tfd = ahci_port_read(AHCI_PxTFD);
+    kprintf("[AHCI] %[E]ERROR: Port %u %s (is=0x%x tfd=0x%x serr=0x%x busy=0x%x)%[D]\n",
+            ahci_disk.index, reason, is, tfd, ahci_port_read(AHCI_PxSERR), ahci_disk.busy);
+
+    uint32_t active = ahci_port_read(AHCI_PxCI) | ahci_port_read(AHCI_PxSACT);
+    uint32_t done = ahci_disk.busy & ~active & ~ahci_disk.flushing;
+
+    ahci_port_stop();
+    ahci_port_write(AHCI_PxSERR, 0xFFFFFFFF);
+    ahci_port_write(AHCI_PxIS, 0xFFFFFFFF);
+    if (ahci_port_read(AHCI_PxTFD) & (ATA_SR_BSY | ATA_SR_DRQ)) {
+        ahci_port_comreset();
+    }
+    ahci_port_start();
+
+    for (uint32_t slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        if (ahci_disk.busy & (1u << slot)) {
+            ahci_finish_slot(slot, (done & (1u << slot)) ? 0 : -1);
+        }
+    }
+}
+
+// Снять завершения с порта. Возвращает завершённых запросов
+static uint32_t ahci_process(void) {
+    uint32_t is = ahci_port_read(AHCI_PxIS);
+    ahci_port_write(AHCI_PxIS, is);
+    ahci_write(AHCI_REG_IS, 1u << ahci_disk.index);
+
+    uint32_t before = ahci_disk.busy;
+    if (is & AHCI_PxIS_ERRORS) {
+        ahci_port_recover(is, "error");
+    } else {
+        uint32_t active = ahci_port_read(AHCI_PxCI) | ahci_port_read(AHCI_PxSACT);
+        uint32_t done = ahci_disk.busy & ~active;
+
+        while (done) {
+            uint32_t slot = (uint32_t)__builtin_ctz(done);
+            done &= done - 1;
+
+            // Запись без FUA: прежде завершения - FLUSH CACHE тем же слотом
+            ATARequest* req = ahci_disk.slot_request[slot];
+            if (req->write && !ahci_disk.ncq && !ahci_disk.fua &&
+                !(ahci_disk.flushing & (1u << slot))) {
+                ahci_disk.flushing |= 1u << slot;
+                ahci_build_flush(slot);
+                ahci_issue(slot);
+                continue;
+            }
+            ahci_finish_slot(slot, 0);
+        }
+    }
+
+    ahci_start_next();
+    return (uint32_t)__builtin_popcount(before & ~ahci_disk.busy);
+}
+
+// Самая старая команда дольше ATA_ASYNC_TIMEOUT_CYCLES - reset порта
+static uint32_t ahci_check_timeout(void) {
+    uint64_t now = rdtsc();
+    for (uint32_t slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        ATARequest* req = ahci_disk.slot_request[slot];
+        if (req && now - req->started_at > ATA_ASYNC_TIMEOUT_CYCLES) {
+            uint32_t before = ahci_disk.busy;
+            ahci_port_recover(ahci_port_read(AHCI_PxIS), "command timeout");
+            ahci_start_next();
+            return (uint32_t)__builtin_popcount(before & ~ahci_disk.busy);
+        }
+    }
+    return 0;
+}
+
+static int ahci_request_valid(const ATARequest* req) {
+    if (req->count == 0 || req->count > AHCI_REQUEST_SECTORS || req->chunk_sectors == 0 ||
+        (req->count + req->chunk_sectors - 1) / req->chunk_sectors > ATA_REQUEST_MAX_CHUNKS ||
+        req->lba + req->count > ahci_disk.device.total_sectors ||
+        (!ahci_disk.device.lba48 && req->lba + req->count > ATA_LBA28_LIMIT)) {
+        return 0;
+    }
+    return ahci_build_prdt(NULL, (const uint8_t* const*)req->chunks, req->count, req->chunk_sectors) >= 0;
+}
+
+static void ahci_enqueue(ATARequest* req) {
+    req->status = AHCI_STATUS_PENDING;
+    req->next = NULL;
+
+    spin_lock(&ahci_lock);
+    if (ahci_queue_tail) {
+        ahci_queue_tail->next = req;
+    } else {
+        ahci_queue_head = req;
+    }
+    ahci_queue_tail = req;
+    ahci_start_next();
+    spin_unlock(&ahci_lock);
+
+    atomic_increment_u64(&ahci_stats.submitted);
+}
+
+// ============================================================================
+// ASYNC API
+// ============================================================================
+
+int ahci_available(void) {
+    return ahci_ready;
+}
+
+const ATADevice* ahci_device(void) {
+    return &ahci_disk.device;
+}
+
+int ahci_can_submit(const ATARequest* req) {
+    return ahci_ready && ahci_request_valid(req);
+}
+
+uint32_t ahci_queue_depth(void) {
+    return (uint32_t)__builtin_popcount(ahci_disk.slot_mask);
+}
+
+int ahci_submit(ATARequest* req) {
+    if (!ahci_ready || !req->done || !ahci_request_valid(req)) {
+        return -1;
+    }
+    ahci_enqueue(req);
+    return 0;
+}
+
+int ahci_irq_handler(uint8_t irq) {
+    if (!ahci_ready || irq != ahci_irq_line) {
+        return 0;
+    }
+
+    spin_lock(&ahci_lock);
+    uint32_t completed = ahci_process();
+    spin_unlock(&ahci_lock);
+
+    atomic_add_u64(&ahci_stats.irq_completions, completed);
+    return 1;
+}
+
+int ahci_async_poll(void) {
+    // Без lock: пусто - частый случай (idle проход Storage Deck)
+    if (!ahci_ready || (!ahci_disk.busy && !ahci_queue_head)) {
+        return 0;
+    }
+
+    spin_lock(&ahci_lock);
+    uint32_t completed = ahci_process();
+    if (completed == 0) {
+        completed = ahci_check_timeout();
+    }
+    spin_unlock(&ahci_lock);
+    return completed > 0;
+}
+
+uint32_t ahci_async_reap(void) {
+    if (!ahci_done_head) {
+        return 0;
+    }
+
+    spin_lock(&ahci_lock);
+    ATARequest* list = ahci_done_head;
+    ahci_done_head = ahci_done_tail = NULL;
+    spin_unlock(&ahci_lock);
+
+    uint32_t count = 0;
+    while (list) {
+        ATARequest* req = list;
+        list = req->next;
+        req->next = NULL;
+        count++;
+        req->done(req);  // Может переиспользовать req
+    }
+
+    atomic_add_u64(&ahci_stats.completed, count);
+    return count;
+}
+
+// ============================================================================
+// SYNCHRONOUS I/O
+// ============================================================================
+
+// Команды по AHCI_REQUEST_SECTORS, до AHCI_SYNC_WINDOW в полёте: NCQ
+// держит устройство занятым, пока caller ждёт самую старую
+static int ahci_transfer(uint64_t lba, uint32_t count, const uint8_t* const* chunks,
+                         uint32_t chunk_sectors, uint8_t write) {
+    if (!ahci_ready || chunk_sectors == 0) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // Несколько буферов: каждая команда целиком из целых chunks
+    if (chunk_sectors < count && chunk_sectors > AHCI_REQUEST_SECTORS) {
+        return -1;
+    }
+
+    // Каждая команда начинается на границе chunk: шаг кратен chunk_sectors
+    uint32_t step = AHCI_REQUEST_SECTORS;
+    if (chunk_sectors < count && chunk_sectors < step) {
+        step -= step % chunk_sectors;
+    }
+
+    ATARequest window[AHCI_SYNC_WINDOW];
+    uint32_t issued = 0;
+    uint32_t waited = 0;
+    uint32_t offset = 0;
+    int result = 0;
+
+    while (waited < issued || offset < count) {
+        if (offset < count && issued - waited < AHCI_SYNC_WINDOW && result == 0) {
+            ATARequest* req = &window[issued % AHCI_SYNC_WINDOW];
+            memset(req, 0, sizeof(ATARequest));
+            req->write = write;
+            req->lba = lba + offset;
+            req->count = count - offset < step ? count - offset : step;
+
+            if (chunk_sectors >= count) {
+                // Один смежный буфер - кусок со смещением
+                req->chunks[0] = (uint8_t*)chunks[0] + (uint64_t)offset * ATA_SECTOR_SIZE;
+                req->chunk_sectors = req->count;
+            } else {
+                for (uint32_t i = 0; i * chunk_sectors < req->count; i++) {
+                    req->chunks[i] = (uint8_t*)chunks[offset / chunk_sectors + i];
+                }
+                req->chunk_sectors = chunk_sectors;
+            }
+
+            if (!ahci_request_valid(req)) {
+                kprintf("[AHCI] ERROR: Cannot %s LBA %lu+%u (bounds or buffer)\n",
+                        write ? "write" : "read", req->lba, req->count);
+                result = -1;
+                continue;
+            }
+            ahci_enqueue(req);
+            offset += req->count;
+            issued++;
+            continue;
+        }
+
+        if (waited == issued) {
+            break;  // Ошибка до отправки - ждать нечего
+        }
+
+        // IRQ может быть запрещён у вызывающего - доводим опросом
+        ATARequest* oldest = &window[waited % AHCI_SYNC_WINDOW];
+        while (*(volatile int*)&oldest->status == AHCI_STATUS_PENDING) {
+            ahci_async_poll();
+            pause();
+        }
+        if (oldest->status != 0) {
+            result = -1;
+        }
+        waited++;
+    }
+
+    return result;
+}
+
+int ahci_read_sectors(uint64_t lba, uint32_t count, uint8_t* buffer) {
+    const uint8_t* chunk = buffer;
+    return ahci_transfer(lba, count, &chunk, count ? count : 1, 0);
+}
+
+int ahci_write_chunks(uint64_t lba, uint32_t count, const uint8_t* const* chunks, uint32_t chunk_sectors) {
+    return ahci_transfer(lba, count, chunks, chunk_sectors, 1);
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+// BIOS мог оставить HBA за собой (SMM): забрать через BOHC
+static void ahci_bios_handoff(void) {
+    if (!(ahci_read(AHCI_REG_CAP2) & AHCI_CAP2_BOH)) {
+        return;
+    }
+
+    ahci_write(AHCI_REG_BOHC, ahci_read(AHCI_REG_BOHC) | AHCI_BOHC_OOS);
+    for (int timeout = 1000000; timeout > 0 && (ahci_read(AHCI_REG_BOHC) & AHCI_BOHC_BOS); timeout--) {
+        pause();
+    }
+}
+
+// IDENTIFY DEVICE через слот 0 опросом - до IRQ и до NCQ
+static int ahci_identify(void) {
+    uint16_t* identify_data = (uint16_t*)pmm_alloc_zero(1);
+    if (!identify_data) {
+        return -1;
+    }
+
+    AHCICommandTable* table = ahci_disk.tables[0];
+    ahci_build_fis(table, ATA_CMD_IDENTIFY, 0, 0, 0);
+
+    uint64_t phys = vmm_virt_to_phys_direct(identify_data);
+    table->prdt[0].dba = (uint32_t)phys;
+    table->prdt[0].dbau = (uint32_t)(phys >> 32);
+    table->prdt[0].reserved = 0;
+    table->prdt[0].dbc = 512 - 1;
+
+    AHCICommandHeader* header = &ahci_disk.command_list[0];
+    header->flags = AHCI_CMD_FIS_DWORDS;
+    header->prdtl = 1;
+    header->prdbc = 0;
+
+    COMPILER_BARRIER();
+    ahci_port_write(AHCI_PxCI, 1);
+
+    int result = ahci_port_wait(AHCI_PxCI, 1, 0);
+    if (result != 0 || (ahci_port_read(AHCI_PxIS) & AHCI_PxIS_TFES) ||
+        (ahci_port_read(AHCI_PxTFD) & ATA_SR_ERR)) {
+        kprintf("[AHCI] %[E]ERROR: IDENTIFY failed on port %u (tfd=0x%x)%[D]\n",
+                ahci_disk.index, ahci_port_read(AHCI_PxTFD));
+        result = -1;
+    } else {
+        ata_parse_identify(identify_data, &ahci_disk.device);
+        ahci_disk.device.is_master = 1;
+        ahci_disk.device.dma = 1;
+
+        // Word 76 bit 8: NCQ, word 75 (4:0): queue depth - 1
+        if ((ahci_cap & AHCI_CAP_SNCQ) && (identify_data[76] & 0x0100)) {
+            uint32_t depth = (identify_data[75] & 0x1F) + 1;
+            ahci_disk.ncq = 1;
+            if (depth < AHCI_MAX_SLOTS) {
+                ahci_disk.slot_mask &= (1u << depth) - 1;
+            }
+        }
+
+        // Word 84 bit 6: WRITE DMA FUA EXT
+        ahci_disk.fua = ahci_disk.device.lba48 && (identify_data[84] & 0x0040);
+    }
+
+    ahci_port_write(AHCI_PxIS, 0xFFFFFFFF);
+    pmm_free(identify_data, 1);
+    return result;
+}
+
+// Память и запуск порта. Command list (1KB) и FIS area (256B) - одна
+// страница; command table - страница на слот
+static int ahci_port_setup(uint32_t port, uint32_t slots) {
+    ahci_disk.index = (uint8_t)port;
+    ahci_disk.regs = ahci_abar + AHCI_PORT_BASE + port * AHCI_PORT_SIZE;
+    ahci_disk.slot_mask = slots >= AHCI_MAX_SLOTS ? 0xFFFFFFFFu : (1u << slots) - 1;
+
+    if (ahci_port_stop() != 0) {
+        kprintf("[AHCI] %[E]ERROR: Port %u does not stop%[D]\n", port);
+        return -1;
+    }
+
+    uint8_t* page = (uint8_t*)pmm_alloc_zero(1);
+    if (!page) {
+        return -1;
+    }
+    ahci_disk.command_list = (AHCICommandHeader*)page;
+
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        ahci_disk.tables[slot] = (AHCICommandTable*)pmm_alloc_zero(1);
+        if (!ahci_disk.tables[slot]) {
+            kprintf("[AHCI] %[E]ERROR: Out of memory for command tables%[D]\n");
+            return -1;
+        }
+
+        uint64_t table_phys = vmm_virt_to_phys_direct(ahci_disk.tables[slot]);
+        ahci_disk.command_list[slot].ctba = (uint32_t)table_phys;
+        ahci_disk.command_list[slot].ctbau = (uint32_t)(table_phys >> 32);
+    }
+
+    uint64_t list_phys = vmm_virt_to_phys_direct(page);
+    uint64_t fis_phys = list_phys + 1024;
+    if (!(ahci_cap & AHCI_CAP_S64A) && list_phys >= 0x100000000ULL) {
+        kprintf("[AHCI] %[E]ERROR: Command list above 4GB without S64A%[D]\n");
+        return -1;
+    }
+
+    ahci_port_write(AHCI_PxCLB, (uint32_t)list_phys);
+    ahci_port_write(AHCI_PxCLBU, (uint32_t)(list_phys >> 32));
+    ahci_port_write(AHCI_PxFB, (uint32_t)fis_phys);
+    ahci_port_write(AHCI_PxFBU, (uint32_t)(fis_phys >> 32));
+    ahci_port_write(AHCI_PxSERR, 0xFFFFFFFF);
+    ahci_port_write(AHCI_PxIS, 0xFFFFFFFF);
+    ahci_port_write(AHCI_PxCMD, ahci_port_read(AHCI_PxCMD) | AHCI_PxCMD_SUD | AHCI_PxCMD_POD);
+    ahci_port_start();
+
+    if (ahci_identify() != 0) {
+        return -1;
+    }
+
+    // Завершения (D2H/SDB) и ошибки. Доставка - после GHC.IE
+    ahci_port_write(AHCI_PxIE, AHCI_PxIS_DHRS | AHCI_PxIS_SDBS | AHCI_PxIS_ERRORS);
+    return 0;
+}
+
+int ahci_init(void) {
+    PciAddress pci;
+    if (!pci_find_class(0x01, 0x06, &pci) || pci.prog_if != 0x01) {
+        kprintf("[AHCI] No AHCI controller\n");
+        return -1;
+    }
+
+    uint32_t bar5 = pci_config_read(pci.bus, pci.dev, pci.func, PCI_REG_BAR0 + 5 * 4);
+    if (bar5 & 0x01) {
+        kprintf("[AHCI] %[W]ABAR is an I/O BAR, skipping controller%[D]\n");
+        return -1;
+    }
+
+    void* mapped = vmm_map_mmio(bar5 & 0xFFFFFFF0u, AHCI_MMIO_SIZE);
+    if (!mapped) {
+        kprintf("[AHCI] %[E]ERROR: Failed to map ABAR 0x%x%[D]\n", bar5 & 0xFFFFFFF0u);
+        return -1;
+    }
+    ahci_abar = (uintptr_t)mapped;
+    spinlock_init(&ahci_lock);
+
+    pci_enable(&pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+    ahci_irq_line = (uint8_t)(pci_config_read(pci.bus, pci.dev, pci.func, PCI_REG_INTERRUPT) & 0xFF);
+
+    ahci_bios_handoff();
+    ahci_write(AHCI_REG_GHC, ahci_read(AHCI_REG_GHC) | AHCI_GHC_AE);
+
+    ahci_cap = ahci_read(AHCI_REG_CAP);
+    uint32_t slots = ((ahci_cap >> AHCI_CAP_NCS_SHIFT) & AHCI_CAP_NCS_MASK) + 1;
+    uint32_t implemented = ahci_read(AHCI_REG_PI);
+    uint32_t version = ahci_read(AHCI_REG_VS);
+
+    kprintf("[AHCI] Controller %02x:%02x.%x (%04x:%04x) v%u.%u: ports=0x%x slots=%u%s%s irq=%u\n",
+            pci.bus, pci.dev, pci.func, pci.vendor, pci.device, version >> 16, (version >> 8) & 0xFF,
+            implemented, slots, (ahci_cap & AHCI_CAP_SNCQ) ? " NCQ" : "",
+            (ahci_cap & AHCI_CAP_S64A) ? " 64-bit" : "", ahci_irq_line);
+
+    for (uint32_t port = 0; port < 32; port++) {
+        if (!(implemented & (1u << port))) {
+            continue;
+        }
+
+        uintptr_t regs = ahci_abar + AHCI_PORT_BASE + port * AHCI_PORT_SIZE;
+        uint32_t ssts = mmio_read32(regs + AHCI_PxSSTS);
+        uint32_t sig = mmio_read32(regs + AHCI_PxSIG);
+        if ((ssts & AHCI_SSTS_DET_MASK) != AHCI_SSTS_DET_PRESENT) {
+            continue;
+        }
+        if (sig != AHCI_SIG_ATA) {
+            kprintf("[AHCI] Port %u: not a SATA disk (sig=0x%x), skipping\n", port, sig);
+            continue;
+        }
+        if (ahci_ready) {
+            kprintf("[AHCI] Port %u: additional disk not used\n", port);
+            continue;
+        }
+
+        if (ahci_port_setup(port, slots) != 0) {
+            memset(&ahci_disk, 0, sizeof(AHCIPort));
+            continue;
+        }
+        ahci_ready = 1;
+
+        kprintf("[AHCI] Port %u: %s (%lu MB, %lu sectors, %s, queue depth %u)\n",
+                port, ahci_disk.device.model, ahci_disk.device.size_mb, ahci_disk.device.total_sectors,
+                ahci_disk.ncq ? "NCQ" : (ahci_disk.fua ? "DMA+FUA" : "DMA"),
+                (uint32_t)__builtin_popcount(ahci_disk.slot_mask));
+    }
+
+    if (!ahci_ready) {
+        return -1;
+    }
+
+    ahci_write(AHCI_REG_IS, 0xFFFFFFFF);
+    ahci_write(AHCI_REG_GHC, ahci_read(AHCI_REG_GHC) | AHCI_GHC_IE);
+    return 0;
+}
+
+void ahci_enable_irq(void) {
+    if (!ahci_ready || ahci_irq_enabled || ahci_irq_line >= 16) {
+        return;
+    }
+
+    ahci_irq_enabled = 1;
+    pic_enable_irq(ahci_irq_line);
+    kprintf("[AHCI] IRQ%u enabled: NCQ completions\n", ahci_irq_line);
+}
+
+void ahci_print_stats(void) {
+    kprintf("  AHCI:            submitted=%lu completed=%lu (irq=%lu) errors=%lu max_inflight=%lu\n",
+            atomic_load_u64(&ahci_stats.submitted),
+            atomic_load_u64(&ahci_stats.completed),
+            atomic_load_u64(&ahci_stats.irq_completions),
+            atomic_load_u64(&ahci_stats.errors),
+            atomic_load_u64(&ahci_stats.max_inflight));
+}
+
+const ATABackend ahci_backend = {
+    .name = "ahci",
+    .device = ahci_device,
+    .read_sectors = ahci_read_sectors,
+    .write_chunks = ahci_write_chunks,
+    .request_valid = ahci_can_submit,
+    .queue_depth = ahci_queue_depth,
+    .submit = ahci_submit,
+    .irq_handler = ahci_irq_handler,
+    .async_poll = ahci_async_poll,
+    .async_reap = ahci_async_reap,
+    .enable_irq = ahci_enable_irq,
+    .print_stats = ahci_print_stats,
+};
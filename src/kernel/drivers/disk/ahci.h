@@ -0,0 +1,154 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include "ktypes.h"
+#include "ata.h"  // ATADevice, ATARequest
+
+// ============================================================================
+// AHCI SATA Driver - PCI class 01:06 (prog_if 01), ABAR = BAR5
+// ============================================================================
+//
+// Один SATA диск (первый порт с ATA сигнатурой) за тем же block интерфейсом,
+// что и legacy ATA: ata_read_blocks()/ata_write_blocks()/ata_submit()
+// уходят в ahci_backend, если ata_init() его выбрал.
+//
+// Per-port command list (32 слота) + FIS receive area + command table со
+// своей PRDT на слот. NCQ (READ/WRITE FPDMA QUEUED) - до 32 команд на
+// устройстве одновременно; без NCQ - READ/WRITE DMA (EXT), HBA выполняет
+// выданные слоты по очереди.
+//
+// ============================================================================
+
+// HBA generic registers
+#define AHCI_REG_CAP            0x00    // Host capabilities
+#define AHCI_REG_GHC            0x04    // Global host control
+#define AHCI_REG_IS             0x08    // Interrupt status (bit на порт, RW1C)
+#define AHCI_REG_PI             0x0C    // Ports implemented
+#define AHCI_REG_VS             0x10    // Version
+#define AHCI_REG_CAP2           0x24    // Host capabilities extended
+#define AHCI_REG_BOHC           0x28    // BIOS/OS handoff control
+
+#define AHCI_CAP_NCS_SHIFT      8       // Number of command slots - 1 (bits 12:8)
+#define AHCI_CAP_NCS_MASK       0x1F
+#define AHCI_CAP_SNCQ           (1u << 30)  // Native command queuing
+#define AHCI_CAP_S64A           (1u << 31)  // 64-bit addressing
+
+#define AHCI_GHC_HR             (1u << 0)   // HBA reset
+#define AHCI_GHC_IE             (1u << 1)   // Interrupt enable
+#define AHCI_GHC_AE             (1u << 31)  // AHCI enable
+
+#define AHCI_CAP2_BOH           (1u << 0)   // BIOS/OS handoff supported
+#define AHCI_BOHC_BOS           (1u << 0)   // BIOS owned semaphore
+#define AHCI_BOHC_OOS           (1u << 1)   // OS owned semaphore
+
+// Port registers (ABAR + 0x100 + port * 0x80)
+#define AHCI_PORT_BASE          0x100
+#define AHCI_PORT_SIZE          0x80
+#define AHCI_MMIO_SIZE          (AHCI_PORT_BASE + 32 * AHCI_PORT_SIZE)
+
+#define AHCI_PxCLB              0x00    // Command list base (1KB aligned)
+#define AHCI_PxCLBU             0x04
+#define AHCI_PxFB               0x08    // FIS receive base (256B aligned)
+#define AHCI_PxFBU              0x0C
+#define AHCI_PxIS               0x10    // Interrupt status (RW1C)
+#define AHCI_PxIE               0x14    // Interrupt enable
+#define AHCI_PxCMD              0x18    // Command and status
+#define AHCI_PxTFD              0x20    // Task file data (status 7:0, error 15:8)
+#define AHCI_PxSIG              0x24    // Device signature
+#define AHCI_PxSSTS             0x28    // SATA status (SStatus)
+#define AHCI_PxSCTL             0x2C    // SATA control (SControl)
+#define AHCI_PxSERR             0x30    // SATA error (RW1C)
+#define AHCI_PxSACT             0x34    // NCQ: выданные теги
+#define AHCI_PxCI               0x38    // Command issue
+
+#define AHCI_PxCMD_ST           (1u << 0)   // Start (обработка command list)
+#define AHCI_PxCMD_SUD          (1u << 1)   // Spin-up device
+#define AHCI_PxCMD_POD          (1u << 2)   // Power on device
+#define AHCI_PxCMD_FRE          (1u << 4)   // FIS receive enable
+#define AHCI_PxCMD_FR           (1u << 14)  // FIS receive running
+#define AHCI_PxCMD_CR           (1u << 15)  // Command list running
+
+#define AHCI_PxIS_DHRS          (1u << 0)   // D2H register FIS (не-NCQ завершение)
+#define AHCI_PxIS_PSS           (1u << 1)   // PIO setup FIS
+#define AHCI_PxIS_DSS           (1u << 2)   // DMA setup FIS
+#define AHCI_PxIS_SDBS          (1u << 3)   // Set device bits FIS (NCQ завершение)
+#define AHCI_PxIS_IFS           (1u << 27)  // Interface fatal error
+#define AHCI_PxIS_HBDS          (1u << 28)  // Host bus data error
+#define AHCI_PxIS_HBFS          (1u << 29)  // Host bus fatal error
+#define AHCI_PxIS_TFES          (1u << 30)  // Task file error
+#define AHCI_PxIS_ERRORS        (AHCI_PxIS_IFS | AHCI_PxIS_HBDS | AHCI_PxIS_HBFS | AHCI_PxIS_TFES)
+
+#define AHCI_SSTS_DET_MASK      0x0F
+#define AHCI_SSTS_DET_PRESENT   0x03    // Устройство есть, PHY связь установлена
+#define AHCI_SCTL_DET_COMRESET  0x01
+
+#define AHCI_SIG_ATA            0x00000101  // SATA диск (не ATAPI/PM/SEMB)
+
+// Command header flags (DW0)
+#define AHCI_CMD_FIS_DWORDS     5       // H2D register FIS = 20 байт
+#define AHCI_CMD_WRITE          (1u << 6)   // Host -> device
+#define AHCI_CMD_CLEAR_BUSY     (1u << 10)  // Команда без данных
+
+#define AHCI_FIS_REG_H2D        0x27
+#define AHCI_FIS_COMMAND        0x80    // Byte 1 bit 7: command, не control
+
+#define AHCI_CMD_READ_FPDMA     0x60    // READ FPDMA QUEUED (NCQ)
+#define AHCI_CMD_WRITE_FPDMA    0x61    // WRITE FPDMA QUEUED (NCQ)
+#define AHCI_CMD_WRITE_DMA_FUA  0x3D    // WRITE DMA FUA EXT
+
+#define AHCI_MAX_SLOTS          32
+#define AHCI_PRDT_ENTRIES       248     // Command table = 128 + 248 * 16 = 4KB
+#define AHCI_PRD_MAX_BYTES      (4u << 20)  // DBC 22 бита
+
+// Секторов на одну команду: синхронный ata_read_blocks(16MB) уходит пачкой
+// NCQ команд по 128KB, каждая гарантированно влезает в PRDT
+#define AHCI_REQUEST_SECTORS    256
+#define AHCI_SYNC_WINDOW        4       // Синхронных команд одного caller'а в полёте
+
+// ============================================================================
+// API
+// ============================================================================
+
+// Найти HBA, поднять первый порт с SATA диском. Вызывать после vmm_init.
+// 0 = диск готов, -1 = нет HBA/диска
+int ahci_init(void);
+
+// 1 = диск на AHCI найден: block интерфейс ATA идёт сюда
+int ahci_available(void);
+
+// IDENTIFY данные диска (total_sectors, model, ...)
+const ATADevice* ahci_device(void);
+
+// Чтение/запись - 0 при успехе, -1 при ошибке. Любой count: делится на
+// команды по AHCI_REQUEST_SECTORS, до AHCI_SYNC_WINDOW в очереди устройства.
+// chunks: один смежный буфер (chunk_sectors >= count) или куски не больше
+// AHCI_REQUEST_SECTORS
+int ahci_read_sectors(uint64_t lba, uint32_t count, uint8_t* buffer);
+int ahci_write_chunks(uint64_t lba, uint32_t count, const uint8_t* const* chunks, uint32_t chunk_sectors);
+
+// Как ata_request_valid() / ata_queue_depth()
+int ahci_can_submit(const ATARequest* req);
+uint32_t ahci_queue_depth(void);
+
+// Async как ata_submit(): 0 = принят, -1 = нельзя (caller делает синхронно).
+// is_master игнорируется
+int ahci_submit(ATARequest* req);
+
+// IRQ линии HBA (из irq_handler). 1 = irq наш
+int ahci_irq_handler(uint8_t irq);
+
+// Завершения без IRQ + timeout. 1 = что-то завершилось
+int ahci_async_poll(void);
+
+// done() завершённых async запросов - вне IRQ и чужих lock'ов
+uint32_t ahci_async_reap(void);
+
+// Разрешить IRQ линии HBA (после pic_init)
+void ahci_enable_irq(void);
+
+void ahci_print_stats(void);
+
+// Для ata_init(): block интерфейс ATA через AHCI
+extern const ATABackend ahci_backend;
+
+#endif // AHCI_H
@@ -1,6 +1,13 @@
 #include "ata.h"
 #include "klib.h"
-#include "io.h"  // inb, outb, inw, outw
+#include "io.h"  // inb, outb, inw, outw, inl, outl
+#include "pmm.h"
+#include "vmm.h"  // vmm_virt_to_phys_direct
+#include "pic.h"
+#include "atomics.h"
+#include "pci.h"
+#include "ahci.h"
+#include "virtio_blk.h"
 
 // ============================================================================
 // GLOBAL DEVICES
@@ -9,6 +16,20 @@
 ATADevice ata_primary_master;
 ATADevice ata_primary_slave;
 
+// Драйвер за block интерфейсом (NULL - legacy primary channel)
+static const ATABackend* ata_backend = NULL;
+
+// Physical Region Descriptor: address/byte count пары для bus master
+typedef struct __attribute__((packed)) {
+    uint32_t phys;                      // Физический адрес (чётный, < 4GB)
+    uint16_t bytes;                     // 0 = 64KB
+    uint16_t flags;                     // ATA_PRD_EOT у последнего
+} ATAPrd;
+
+static uint16_t ata_bm_base = 0;        // I/O база bus master (0 = только PIO)
+static ATAPrd* ata_prd_table = NULL;    // 1 страница из PMM
+static uint32_t ata_prd_phys = 0;
+
 // ============================================================================
 // HELPER FUNCTIONS
 // ============================================================================
@@ -65,6 +86,69 @@ int ata_wait_drq(void) {
     return -1;  // Timeout
 }
 
+// ============================================================================
+// TASK FILE (LBA28 / LBA48)
+// ============================================================================
+
+static inline ATADevice* ata_device(uint8_t is_master) {
+    return is_master ? &ata_primary_master : &ata_primary_slave;
+}
+
+// Секторов за команду: LBA48 - 16-bit sector count (0 = 65536), LBA28 - 8-bit (0 = 256)
+static inline uint32_t ata_max_sectors(const ATADevice* device) {
+    return device->lba48 ? ATA_LBA48_MAX_SECTORS : ATA_LBA28_MAX_SECTORS;
+}
+
+// EXT команда только когда нужна: LBA28 - вдвое меньше записей в порты
+static inline int ata_use_lba48(uint64_t lba, uint32_t count) {
+    return lba + count > ATA_LBA28_LIMIT || count > ATA_LBA28_MAX_SECTORS;
+}
+
+// Устройство есть, диапазон в пределах диска и одной команды
+static int ata_check_range(const ATADevice* device, uint64_t lba, uint32_t count, const char* op) {
+    if (count == 0 || count > ata_max_sectors(device)) {
+        kprintf("[ATA] ERROR: Cannot %s %u sectors (max %u)\n", op, count, ata_max_sectors(device));
+        return -1;
+    }
+
+    // Validate device exists
+    if (!device->exists) {
+        kprintf("[ATA] ERROR: Device does not exist\n");
+        return -1;
+    }
+
+    // Validate LBA is within bounds
+    if (lba + count > device->total_sectors) {
+        kprintf("[ATA] ERROR: LBA %lu+%u out of bounds (max %lu)\n", lba, count, device->total_sectors);
+        return -1;
+    }
+    return 0;
+}
+
+// Drive/LBA/sector count. LBA48: регистры - двухбайтовые FIFO, сначала
+// старшие байты (HOB), затем младшие. count == max кодируется как 0
+static void ata_setup_task(uint8_t is_master, uint64_t lba, uint32_t count, int lba48) {
+    if (lba48) {
+        outb(ATA_PRIMARY_DRIVE, is_master ? 0x40 : 0x50);  // LBA mode, без битов LBA
+        ata_delay_400ns();
+
+        outb(ATA_PRIMARY_SECCOUNT, (count >> 8) & 0xFF);
+        outb(ATA_PRIMARY_LBA_LO, (lba >> 24) & 0xFF);
+        outb(ATA_PRIMARY_LBA_MID, (lba >> 32) & 0xFF);
+        outb(ATA_PRIMARY_LBA_HI, (lba >> 40) & 0xFF);
+    } else {
+        uint8_t drive_bits = is_master ? 0xE0 : 0xF0;  // LBA mode + master/slave
+        drive_bits |= (lba >> 24) & 0x0F;  // High 4 bits of LBA
+        outb(ATA_PRIMARY_DRIVE, drive_bits);
+        ata_delay_400ns();
+    }
+
+    outb(ATA_PRIMARY_SECCOUNT, count & 0xFF);
+    outb(ATA_PRIMARY_LBA_LO, lba & 0xFF);
+    outb(ATA_PRIMARY_LBA_MID, (lba >> 8) & 0xFF);
+    outb(ATA_PRIMARY_LBA_HI, (lba >> 16) & 0xFF);
+}
+
 // ============================================================================
 // STRING UTILITIES (для IDENTIFY)
 // ============================================================================
@@ -92,6 +176,30 @@ static void ata_string_fixup(char* str, int len) {
 // IDENTIFY DEVICE
 // ============================================================================
 
+void ata_parse_identify(const uint16_t* identify_data, ATADevice* device) {
+    device->exists = 1;
+
+    // Word 83 bit 10: LBA48, сектора - words 100-103. Иначе LBA28 (words 60-61)
+    if (identify_data[83] & 0x0400) {
+        device->lba48 = 1;
+        device->total_sectors = *(const uint64_t*)&identify_data[100];
+    } else {
+        device->total_sectors = *(const uint32_t*)&identify_data[60];
+    }
+    device->size_mb = (device->total_sectors / 2048);  // sectors * 512 / (1024*1024)
+
+    // Word 47: максимум секторов на DRQ блок для READ/WRITE MULTIPLE
+    device->max_multiple = identify_data[47] & 0xFF;
+
+    // Model string (words 27-46)
+    memcpy(device->model, &identify_data[27], 40);
+    ata_string_fixup(device->model, 40);
+
+    // Serial number (words 10-19)
+    memcpy(device->serial, &identify_data[10], 20);
+    ata_string_fixup(device->serial, 20);
+}
+
 int ata_identify(uint8_t is_master, ATADevice* device) {
     uint16_t identify_data[256];
 
@@ -149,50 +257,477 @@ int ata_identify(uint8_t is_master, ATADevice* device) {
         identify_data[i] = inw(ATA_PRIMARY_DATA);
     }
 
-    // Parse identify data
-    device->exists = 1;
+    ata_parse_identify(identify_data, device);
 
-    // Total sectors (LBA28)
-    device->total_sectors = *(uint32_t*)&identify_data[60];
-    device->size_mb = (device->total_sectors / 2048);  // sectors * 512 / (1024*1024)
-
-    // Model string (words 27-46)
-    memcpy(device->model, &identify_data[27], 40);
-    ata_string_fixup(device->model, 40);
-
-    // Serial number (words 10-19)
-    memcpy(device->serial, &identify_data[10], 20);
-    ata_string_fixup(device->serial, 20);
+    // Word 49 bit 8: DMA supported. Режим (MWDMA/UDMA) оставляем тот, что
+    // выставил BIOS/контроллер; помечаем drive DMA capable в BM status
+    if (ata_bm_base != 0 && (identify_data[49] & 0x0100)) {
+        device->dma = 1;
+        outb(ata_bm_base + ATA_BM_STATUS, (inb(ata_bm_base + ATA_BM_STATUS) & ~(ATA_BM_SR_IRQ | ATA_BM_SR_ERR)) |
+             (is_master ? ATA_BM_SR_DMA_MASTER : ATA_BM_SR_DMA_SLAVE));
+    }
 
-    kprintf("[ATA] Detected %s: %s (%lu MB, %u sectors)\n",
+    kprintf("[ATA] Detected %s: %s (%lu MB, %lu sectors, %s, %s)\n",
             is_master ? "master" : "slave",
             device->model,
             device->size_mb,
-            device->total_sectors);
+            device->total_sectors,
+            device->lba48 ? "LBA48" : "LBA28",
+            device->dma ? "DMA" : "PIO");
 
     return 0;
 }
 
 // ============================================================================
-// READ SECTORS
+// BUS-MASTER DMA (PCI IDE)
 // ============================================================================
+//
+// Контроллер сам перекладывает сектора по PRD таблице - вместо 256 inw/outw
+// на сектор CPU только программирует команду и ждёт ATA_BM_SR_IRQ.
+// Буферы - память PMM/kmalloc/.bss, т.е. identity mapping: физический
+// адрес = vmm_virt_to_phys_direct(). Если буфер не подходит (higher half,
+// выше 4GB, нечётный) - команда идёт через PIO.
+
+// Найти IDE контроллер (class 01:01) с bus master и primary channel в
+// compatibility mode (наши порты 0x1F0/0x3F6), включить bus mastering
+static void ata_dma_probe(void) {
+    PciAddress pci;
+    if (!pci_find_class(0x01, 0x01, &pci)) {
+        return;
+    }
+
+    uint32_t bar4 = pci_config_read(pci.bus, pci.dev, pci.func, PCI_REG_BAR0 + 4 * 4);
+
+    // prog_if bit 0: primary в native mode - другие порты
+    // bit 7: bus master IDE
+    if ((pci.prog_if & 0x01) || !(pci.prog_if & 0x80) || !(bar4 & 0x01)) {
+        kprintf("[ATA] %[W]IDE controller %02x:%02x.%x: no usable bus master (prog_if=0x%02x)%[D]\n",
+                pci.bus, pci.dev, pci.func, pci.prog_if);
+        return;
+    }
+
+    pci_enable(&pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+    ata_bm_base = (uint16_t)(bar4 & 0xFFFC);
+    kprintf("[ATA] IDE controller %02x:%02x.%x (%04x:%04x), bus master at 0x%x\n",
+            pci.bus, pci.dev, pci.func, pci.vendor, pci.device, ata_bm_base);
+}
+
+static int ata_dma_init(void) {
+    ata_dma_probe();
+    if (ata_bm_base == 0) {
+        return 0;
+    }
 
-int ata_read_sectors(uint8_t is_master, uint32_t lba, uint8_t count, uint8_t* buffer) {
-    if (count == 0) {
-        kprintf("[ATA] ERROR: Cannot read 0 sectors\n");
+    ata_prd_table = (ATAPrd*)pmm_alloc_zero(1);
+    uintptr_t phys = ata_prd_table ? vmm_virt_to_phys_direct(ata_prd_table) : 0;
+
+    // DEFENSIVE: PRDT register 32-bit - таблица должна лежать ниже 4GB
+    if (phys == 0 || phys > 0xFFFFF000u) {
+        kprintf("[ATA] %[W]No PRD table below 4GB, using PIO%[D]\n");
+        if (ata_prd_table) {
+            pmm_free(ata_prd_table, 1);
+            ata_prd_table = NULL;
+        }
+        ata_bm_base = 0;
+        return 0;
+    }
+
+    ata_prd_phys = (uint32_t)phys;
+    return 1;
+}
+
+// Заполнить PRD таблицу: сектор s - chunks[s / chunk_sectors] + (s % chunk_sectors) * 512
+// table = NULL - только проверить буферы (таблица может быть занята командой)
+// Возвращает 0, или -1 если какой-то буфер нельзя отдать контроллеру
+static int ata_dma_prepare(ATAPrd* table, const uint8_t* const* chunks, uint32_t count,
+                           uint32_t chunk_sectors) {
+    uint32_t entries = 0;
+
+    for (uint32_t first = 0; first < count; first += chunk_sectors) {
+        uint32_t sectors = count - first;
+        if (sectors > chunk_sectors) {
+            sectors = chunk_sectors;
+        }
+
+        uint64_t phys = vmm_virt_to_phys_direct((void*)chunks[first / chunk_sectors]);
+        uint64_t end = phys + (uint64_t)sectors * ATA_SECTOR_SIZE;
+        if (phys == 0 || (phys & 1) || end > 0x100000000ULL) {
+            return -1;
+        }
+
+        // PRD не может пересекать 64KB границу
+        while (phys < end) {
+            uint64_t boundary = (phys & ~0xFFFFULL) + 0x10000;
+            uint64_t piece_end = end < boundary ? end : boundary;
+
+            if (entries == ATA_PRD_MAX_ENTRIES) {
+                return -1;
+            }
+            if (table) {
+                table[entries].phys = (uint32_t)phys;
+                table[entries].bytes = (uint16_t)(piece_end - phys);  // 64KB -> 0
+                table[entries].flags = 0;
+            }
+            entries++;
+            phys = piece_end;
+        }
+    }
+
+    if (table) {
+        table[entries - 1].flags = ATA_PRD_EOT;
+    }
+    return 0;
+}
+
+// Запустить READ DMA (EXT) / WRITE DMA (EXT) по подготовленной PRD таблице
+// и вернуться: дальше контроллер работает сам. Вызывается после ata_wait_ready()
+static void ata_dma_start(uint8_t is_master, uint64_t lba, uint32_t count, int write) {
+    uint8_t direction = write ? 0 : ATA_BM_CMD_READ;
+    int lba48 = ata_use_lba48(lba, count);
+
+    // Остановить bus master, задать направление и таблицу, сбросить IRQ/ERR
+    outb(ata_bm_base + ATA_BM_COMMAND, direction);
+    outl(ata_bm_base + ATA_BM_PRDT, ata_prd_phys);
+    outb(ata_bm_base + ATA_BM_STATUS,
+         inb(ata_bm_base + ATA_BM_STATUS) | ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+
+    ata_setup_task(is_master, lba, count, lba48);
+
+    if (write) {
+        outb(ATA_PRIMARY_COMMAND, lba48 ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA);
+    } else {
+        outb(ATA_PRIMARY_COMMAND, lba48 ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    }
+    outb(ata_bm_base + ATA_BM_COMMAND, direction | ATA_BM_CMD_START);
+}
+
+// Команда закончилась (INTRQ или ошибка bus master)?
+// ALTSTATUS - чтобы не снять прерывание раньше времени
+static inline int ata_dma_done(void) {
+    uint8_t bm_status = inb(ata_bm_base + ATA_BM_STATUS);
+    if (bm_status & ATA_BM_SR_ERR) {
+        return 1;
+    }
+    return (bm_status & ATA_BM_SR_IRQ) && !(inb(ATA_PRIMARY_ALTSTATUS) & ATA_SR_BSY);
+}
+
+// Остановить bus master, снять INTRQ, разобрать результат
+static int ata_dma_finish(uint64_t lba, int write, int timed_out) {
+    uint8_t direction = write ? 0 : ATA_BM_CMD_READ;
+
+    outb(ata_bm_base + ATA_BM_COMMAND, direction);     // Stop
+    uint8_t bm_status = inb(ata_bm_base + ATA_BM_STATUS);
+    uint8_t status = ata_read_status();                  // Снимает INTRQ
+    outb(ata_bm_base + ATA_BM_STATUS, bm_status | ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+
+    if (timed_out) {
+        kprintf("[ATA] %[E]ERROR: DMA %s timeout at LBA %lu%[D]\n", write ? "write" : "read", lba);
+        return -1;
+    }
+    if ((bm_status & ATA_BM_SR_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF))) {
+        kprintf("[ATA] %[E]ERROR: DMA %s failed at LBA %lu (status=0x%x, bm=0x%x)%[D]\n",
+                write ? "write" : "read", lba, status, bm_status);
         return -1;
     }
 
-    // Validate device exists
-    ATADevice* device = is_master ? &ata_primary_master : &ata_primary_slave;
-    if (!device->exists) {
-        kprintf("[ATA] ERROR: Device does not exist\n");
+    return 0;
+}
+
+// Синхронная команда: ждём завершения опросом, по одному чтению порта
+// за итерацию, без передачи данных CPU
+static int ata_dma_transfer(uint8_t is_master, uint64_t lba, uint32_t count, int write) {
+    ata_dma_start(is_master, lba, count, write);
+
+    uint64_t timeout = 50000ULL * count;  // Столько же, сколько PIO ждёт DRQ
+    int done = 0;
+    while (timeout > 0 && !(done = ata_dma_done())) {
+        timeout--;
+        pause();
+    }
+
+    return ata_dma_finish(lba, write, !done);
+}
+
+// ============================================================================
+// ASYNC REQUESTS (IRQ14)
+// ============================================================================
+//
+// ata_submit() ставит DMA запрос в очередь канала и сразу возвращается.
+// Завершение видит IRQ14 (ata_irq_handler) или ata_async_poll() - запрос
+// переходит в done list, канал запускает следующий. done() вызывает только
+// ata_async_reap() - вне IRQ и вне чужих lock'ов (block cache, fd table):
+// колбэки берут свои lock'и, а синхронный путь ждёт канал, держа их.
+//
+// Синхронные команды (PIO или DMA) - эксклюзивный канал: ata_channel_acquire()
+// ждёт in-flight запрос (сам доводя его опросом - IRQ может быть запрещён
+// у вызывающего) и не даёт стартовать новым до ata_channel_release().
+
+static spinlock_t ata_channel_lock;
+static ATARequest* ata_queue_head = NULL;    // Ждут канал
+static ATARequest* ata_queue_tail = NULL;
+static ATARequest* ata_inflight = NULL;      // Команда на устройстве
+static ATARequest* ata_done_head = NULL;     // Ждут ata_async_reap()
+static ATARequest* ata_done_tail = NULL;
+static volatile uint32_t ata_sync_active = 0;   // Канал у синхронной команды
+static volatile uint64_t ata_sync_waiting = 0;  // Синхронных ждут канал
+static volatile uint8_t ata_irq_enabled = 0;
+
+static struct {
+    volatile uint64_t submitted;
+    volatile uint64_t completed;
+    volatile uint64_t irq_completions;     // Увидел IRQ14 (остальные - опрос)
+    volatile uint64_t errors;
+} ata_async_stats;
+
+static void ata_soft_reset(void);
+static int ata_flush_command(uint8_t is_master);
+
+// Следующий запрос из очереди на устройство (под ata_channel_lock)
+static void ata_async_start_next(void) {
+    while (!ata_inflight && !ata_sync_active && ata_sync_waiting == 0 && ata_queue_head) {
+        ATARequest* req = ata_queue_head;
+        ata_queue_head = req->next;
+        if (!ata_queue_head) {
+            ata_queue_tail = NULL;
+        }
+        req->next = NULL;
+
+        if (ata_wait_ready() != 0 ||
+            ata_dma_prepare(ata_prd_table, (const uint8_t* const*)req->chunks,
+                            req->count, req->chunk_sectors) != 0) {
+            req->status = -1;
+            atomic_increment_u64(&ata_async_stats.errors);
+            if (ata_done_tail) {
+                ata_done_tail->next = req;
+            } else {
+                ata_done_head = req;
+            }
+            ata_done_tail = req;
+            continue;
+        }
+
+        req->started_at = rdtsc();
+        ata_inflight = req;
+        ata_dma_start(req->is_master, req->lba, req->count, req->write);
+    }
+}
+
+// In-flight команда закончилась (под ata_channel_lock)
+static void ata_async_complete(int timed_out) {
+    ATARequest* req = ata_inflight;
+    ata_inflight = NULL;
+
+    req->status = ata_dma_finish(req->lba, req->write, timed_out);
+    if (req->status == 0 && req->write) {
+        ata_flush_command(req->is_master);  // Как синхронная запись
+    }
+    if (timed_out) {
+        ata_soft_reset();
+    }
+    if (req->status != 0) {
+        atomic_increment_u64(&ata_async_stats.errors);
+    }
+
+    if (ata_done_tail) {
+        ata_done_tail->next = req;
+    } else {
+        ata_done_head = req;
+    }
+    ata_done_tail = req;
+
+    ata_async_start_next();
+}
+
+int ata_async_available(void) {
+    if (ata_backend) {
+        return 1;
+    }
+    return ata_primary_master.dma && ata_prd_table != NULL;
+}
+
+int ata_request_valid(const ATARequest* req) {
+    if (ata_backend) {
+        return ata_backend->request_valid(req);
+    }
+
+    // DEFENSIVE: async - только DMA и только буферы, доступные контроллеру
+    ATADevice* device = ata_device(req->is_master);
+    return device->dma && ata_prd_table && req->count != 0 && req->chunk_sectors != 0 &&
+           req->count <= ata_max_sectors(device) &&
+           (req->count + req->chunk_sectors - 1) / req->chunk_sectors <= ATA_REQUEST_MAX_CHUNKS &&
+           req->lba + req->count <= device->total_sectors &&
+           ata_dma_prepare(NULL, (const uint8_t* const*)req->chunks, req->count, req->chunk_sectors) == 0;
+}
+
+uint32_t ata_queue_depth(void) {
+    if (ata_backend) {
+        return ata_backend->queue_depth();
+    }
+    return 1;  // Один канал - одна команда
+}
+
+int ata_submit(ATARequest* req) {
+    if (ata_backend) {
+        return ata_backend->submit(req);
+    }
+
+    if (!ata_request_valid(req)) {
         return -1;
     }
 
-    // Validate LBA is within bounds
-    if (lba >= device->total_sectors) {
-        kprintf("[ATA] ERROR: LBA %u out of bounds (max %u)\n", lba, device->total_sectors);
+    req->status = 0;
+    req->next = NULL;
+
+    spin_lock(&ata_channel_lock);
+    if (ata_queue_tail) {
+        ata_queue_tail->next = req;
+    } else {
+        ata_queue_head = req;
+    }
+    ata_queue_tail = req;
+    ata_async_start_next();
+    spin_unlock(&ata_channel_lock);
+
+    atomic_increment_u64(&ata_async_stats.submitted);
+    return 0;
+}
+
+// IRQ_ATA_PRIMARY: INTRQ без in-flight DMA - от синхронной команды, снимаем
+void ata_irq_handler(void) {
+    spin_lock(&ata_channel_lock);
+    if (ata_inflight) {
+        if (ata_dma_done()) {
+            atomic_increment_u64(&ata_async_stats.irq_completions);
+            ata_async_complete(0);
+        }
+    } else if (!ata_sync_active) {
+        ata_read_status();
+    }
+    spin_unlock(&ata_channel_lock);
+}
+
+int ata_async_poll(void) {
+    if (ata_backend) {
+        return ata_backend->async_poll();
+    }
+
+    // Без lock: пусто - частый случай (idle проход Storage Deck)
+    if (!ata_inflight) {
+        return 0;
+    }
+
+    int completed = 0;
+    spin_lock(&ata_channel_lock);
+    if (ata_inflight) {
+        if (ata_dma_done()) {
+            ata_async_complete(0);
+            completed = 1;
+        } else if (rdtsc() - ata_inflight->started_at > ATA_ASYNC_TIMEOUT_CYCLES) {
+            ata_async_complete(1);
+            completed = 1;
+        }
+    }
+    spin_unlock(&ata_channel_lock);
+    return completed;
+}
+
+uint32_t ata_async_reap(void) {
+    if (ata_backend) {
+        return ata_backend->async_reap();
+    }
+
+    if (!ata_done_head) {
+        return 0;
+    }
+
+    spin_lock(&ata_channel_lock);
+    ATARequest* list = ata_done_head;
+    ata_done_head = ata_done_tail = NULL;
+    spin_unlock(&ata_channel_lock);
+
+    uint32_t count = 0;
+    while (list) {
+        ATARequest* req = list;
+        list = req->next;
+        req->next = NULL;
+        count++;
+        if (req->done) {
+            req->done(req);  // Может переиспользовать req
+        }
+    }
+
+    atomic_add_u64(&ata_async_stats.completed, count);
+    return count;
+}
+
+// Канал для синхронной команды: дождаться in-flight DMA
+static void ata_channel_acquire(void) {
+    atomic_increment_u64(&ata_sync_waiting);
+    while (1) {
+        spin_lock(&ata_channel_lock);
+        if (ata_inflight) {
+            if (ata_dma_done()) {
+                ata_async_complete(0);
+            } else if (rdtsc() - ata_inflight->started_at > ATA_ASYNC_TIMEOUT_CYCLES) {
+                ata_async_complete(1);
+            }
+        }
+        if (!ata_inflight && !ata_sync_active) {
+            ata_sync_active = 1;
+            atomic_decrement_u64(&ata_sync_waiting);
+            spin_unlock(&ata_channel_lock);
+            return;
+        }
+        spin_unlock(&ata_channel_lock);
+        pause();
+    }
+}
+
+static void ata_channel_release(void) {
+    spin_lock(&ata_channel_lock);
+    ata_sync_active = 0;
+    ata_async_start_next();
+    spin_unlock(&ata_channel_lock);
+}
+
+void ata_enable_irq(void) {
+    if (ata_backend) {
+        ata_backend->enable_irq();
+        return;
+    }
+
+    if (!ata_async_available() || ata_irq_enabled) {
+        return;
+    }
+
+    // nIEN = 0 уже после reset; INTRQ прошлых команд снимаем
+    ata_read_status();
+    ata_irq_enabled = 1;
+    pic_enable_irq(14);
+    kprintf("[ATA] IRQ14 enabled: async DMA completions\n");
+}
+
+void ata_print_async_stats(void) {
+    if (ata_backend) {
+        ata_backend->print_stats();
+        return;
+    }
+
+    kprintf("  ATA async:       submitted=%lu completed=%lu (irq=%lu) errors=%lu\n",
+            atomic_load_u64(&ata_async_stats.submitted),
+            atomic_load_u64(&ata_async_stats.completed),
+            atomic_load_u64(&ata_async_stats.irq_completions),
+            atomic_load_u64(&ata_async_stats.errors));
+}
+
+// ============================================================================
+// READ SECTORS
+// ============================================================================
+
+static int ata_read_command(uint8_t is_master, uint64_t lba, uint32_t count, uint8_t* buffer) {
+    ATADevice* device = ata_device(is_master);
+    if (ata_check_range(device, lba, count, "read") != 0) {
         return -1;
     }
 
@@ -201,59 +736,61 @@ int ata_read_sectors(uint8_t is_master, uint32_t lba, uint8_t count, uint8_t* bu
         return -1;
     }
 
-    // Select drive and set LBA mode
-    uint8_t drive_bits = is_master ? 0xE0 : 0xF0;  // LBA mode + master/slave
-    drive_bits |= (lba >> 24) & 0x0F;  // High 4 bits of LBA
-    outb(ATA_PRIMARY_DRIVE, drive_bits);
-    ata_delay_400ns();
+    // Bus-master DMA прямо в buffer, если он доступен контроллеру
+    const uint8_t* chunk = buffer;
+    if (device->dma && ata_dma_prepare(ata_prd_table, &chunk, count, count) == 0) {
+        return ata_dma_transfer(is_master, lba, count, 0);
+    }
 
-    // Set parameters
-    outb(ATA_PRIMARY_SECCOUNT, count);
-    outb(ATA_PRIMARY_LBA_LO, lba & 0xFF);
-    outb(ATA_PRIMARY_LBA_MID, (lba >> 8) & 0xFF);
-    outb(ATA_PRIMARY_LBA_HI, (lba >> 16) & 0xFF);
+    int lba48 = ata_use_lba48(lba, count);
+    ata_setup_task(is_master, lba, count, lba48);
 
-    // Send read command
-    outb(ATA_PRIMARY_COMMAND, ATA_CMD_READ_SECTORS);
+    // READ MULTIPLE: один DRQ на device->multiple секторов
+    uint32_t per_drq = device->multiple ? device->multiple : 1;
+    if (device->multiple) {
+        outb(ATA_PRIMARY_COMMAND, lba48 ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE);
+    } else {
+        outb(ATA_PRIMARY_COMMAND, lba48 ? ATA_CMD_READ_SECTORS_EXT : ATA_CMD_READ_SECTORS);
+    }
 
     // Read sectors
-    for (int sector = 0; sector < count; sector++) {
+    for (uint32_t sector = 0; sector < count; ) {
         // Wait for DRQ
         if (ata_wait_drq() != 0) {
-            kprintf("[ATA] ERROR: Read failed at sector %d\n", sector);
+            kprintf("[ATA] ERROR: Read failed at sector %u\n", sector);
             return -1;
         }
 
-        // Read 256 words (512 bytes)
-        uint16_t* buf16 = (uint16_t*)(buffer + sector * ATA_SECTOR_SIZE);
-        for (int i = 0; i < 256; i++) {
-            buf16[i] = inw(ATA_PRIMARY_DATA);
+        uint32_t block_end = sector + per_drq < count ? sector + per_drq : count;
+        for (; sector < block_end; sector++) {
+            // Read 256 words (512 bytes)
+            uint16_t* buf16 = (uint16_t*)(buffer + (uint64_t)sector * ATA_SECTOR_SIZE);
+            for (int i = 0; i < 256; i++) {
+                buf16[i] = inw(ATA_PRIMARY_DATA);
+            }
         }
     }
 
     return 0;  // Success
 }
 
+int ata_read_sectors(uint8_t is_master, uint64_t lba, uint32_t count, uint8_t* buffer) {
+    ata_channel_acquire();
+    int result = ata_read_command(is_master, lba, count, buffer);
+    ata_channel_release();
+    return result;
+}
+
 // ============================================================================
 // WRITE SECTORS
 // ============================================================================
 
-int ata_write_sectors(uint8_t is_master, uint32_t lba, uint8_t count, const uint8_t* buffer) {
-    if (count == 0) {
-        kprintf("[ATA] ERROR: Cannot write 0 sectors\n");
-        return -1;
-    }
-
-    // Validate device exists
-    ATADevice* device = is_master ? &ata_primary_master : &ata_primary_slave;
-    if (!device->exists) {
-        kprintf("[ATA] ERROR: Device does not exist\n");
-        return -1;
-    }
-
-    // Validate LBA is within bounds
-    if (lba >= device->total_sectors) {
-        kprintf("[ATA] ERROR: LBA %u out of bounds (max %u)\n", lba, device->total_sectors);
+// Данные сектора s - chunks[s / chunk_sectors] + (s % chunk_sectors) * 512:
+// одна команда WRITE DMA / WRITE SECTORS из нескольких несмежных буферов (block cache)
+static int ata_write_command(uint8_t is_master, uint64_t lba, uint32_t count,
+                             const uint8_t* const* chunks, uint32_t chunk_sectors) {
+    ATADevice* device = ata_device(is_master);
+    if (ata_check_range(device, lba, count, "write") != 0) {
         return -1;
     }
 
@@ -262,49 +799,70 @@ int ata_write_sectors(uint8_t is_master, uint32_t lba, uint8_t count, const uint
         return -1;
     }
 
-    // Select drive and set LBA mode
-    uint8_t drive_bits = is_master ? 0xE0 : 0xF0;  // LBA mode + master/slave
-    drive_bits |= (lba >> 24) & 0x0F;  // High 4 bits of LBA
-    outb(ATA_PRIMARY_DRIVE, drive_bits);
-    ata_delay_400ns();
+    // Bus-master DMA: каждый chunk - свои PRD, копировать в один буфер не нужно
+    if (device->dma && ata_dma_prepare(ata_prd_table, chunks, count, chunk_sectors) == 0) {
+        if (ata_dma_transfer(is_master, lba, count, 1) != 0) {
+            return -1;
+        }
+        ata_flush_command(is_master);
+        return 0;
+    }
 
-    // Set parameters
-    outb(ATA_PRIMARY_SECCOUNT, count);
-    outb(ATA_PRIMARY_LBA_LO, lba & 0xFF);
-    outb(ATA_PRIMARY_LBA_MID, (lba >> 8) & 0xFF);
-    outb(ATA_PRIMARY_LBA_HI, (lba >> 16) & 0xFF);
+    int lba48 = ata_use_lba48(lba, count);
+    ata_setup_task(is_master, lba, count, lba48);
 
-    // Send write command
-    outb(ATA_PRIMARY_COMMAND, ATA_CMD_WRITE_SECTORS);
+    // WRITE MULTIPLE: один DRQ на device->multiple секторов
+    uint32_t per_drq = device->multiple ? device->multiple : 1;
+    if (device->multiple) {
+        outb(ATA_PRIMARY_COMMAND, lba48 ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_MULTIPLE);
+    } else {
+        outb(ATA_PRIMARY_COMMAND, lba48 ? ATA_CMD_WRITE_SECTORS_EXT : ATA_CMD_WRITE_SECTORS);
+    }
 
     // Write sectors
-    for (int sector = 0; sector < count; sector++) {
+    for (uint32_t sector = 0; sector < count; ) {
         // Wait for DRQ
         if (ata_wait_drq() != 0) {
-            kprintf("[ATA] ERROR: Write failed at sector %d\n", sector);
+            kprintf("[ATA] ERROR: Write failed at sector %u\n", sector);
             return -1;
         }
 
-        // Write 256 words (512 bytes)
-        const uint16_t* buf16 = (const uint16_t*)(buffer + sector * ATA_SECTOR_SIZE);
-        for (int i = 0; i < 256; i++) {
-            outw(ATA_PRIMARY_DATA, buf16[i]);
+        uint32_t block_end = sector + per_drq < count ? sector + per_drq : count;
+        for (; sector < block_end; sector++) {
+            // Write 256 words (512 bytes)
+            const uint8_t* chunk = chunks[sector / chunk_sectors];
+            const uint16_t* buf16 = (const uint16_t*)(chunk + (sector % chunk_sectors) * ATA_SECTOR_SIZE);
+            for (int i = 0; i < 256; i++) {
+                outw(ATA_PRIMARY_DATA, buf16[i]);
+            }
         }
     }
 
     // Flush cache to disk
-    ata_flush_cache(is_master);
+    ata_flush_command(is_master);
 
     return 0;  // Success
 }
 
+static int ata_write_chunks(uint8_t is_master, uint64_t lba, uint32_t count,
+                            const uint8_t* const* chunks, uint32_t chunk_sectors) {
+    ata_channel_acquire();
+    int result = ata_write_command(is_master, lba, count, chunks, chunk_sectors);
+    ata_channel_release();
+    return result;
+}
+
+int ata_write_sectors(uint8_t is_master, uint64_t lba, uint32_t count, const uint8_t* buffer) {
+    return ata_write_chunks(is_master, lba, count, &buffer, count ? count : 1);
+}
+
 // ============================================================================
 // CACHE FLUSH
 // ============================================================================
 
-int ata_flush_cache(uint8_t is_master) {
+static int ata_flush_command(uint8_t is_master) {
     ata_select_drive(is_master);
-    outb(ATA_PRIMARY_COMMAND, ATA_CMD_CACHE_FLUSH);
+    outb(ATA_PRIMARY_COMMAND, ata_device(is_master)->lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
 
     if (ata_wait_ready() != 0) {
         kprintf("[ATA] WARNING: Cache flush timeout\n");
@@ -314,6 +872,13 @@ int ata_flush_cache(uint8_t is_master) {
     return 0;
 }
 
+int ata_flush_cache(uint8_t is_master) {
+    ata_channel_acquire();
+    int result = ata_flush_command(is_master);
+    ata_channel_release();
+    return result;
+}
+
 // ============================================================================
 // ERROR HANDLING & RETRY
 // ============================================================================
@@ -337,7 +902,7 @@ static const char* ata_decode_error(uint8_t error) {
 }
 
 // Read с retry логикой
-int ata_read_sectors_retry(uint8_t is_master, uint32_t lba, uint8_t count, uint8_t* buffer) {
+int ata_read_sectors_retry(uint8_t is_master, uint64_t lba, uint32_t count, uint8_t* buffer) {
     const int MAX_RETRIES = 3;
 
     for (int retry = 0; retry < MAX_RETRIES; retry++) {
@@ -358,16 +923,17 @@ int ata_read_sectors_retry(uint8_t is_master, uint32_t lba, uint8_t count, uint8
         for (volatile int i = 0; i < 10000; i++) { }
     }
 
-    kprintf("[ATA] Read failed after %d retries at LBA %u\n", MAX_RETRIES, lba);
+    kprintf("[ATA] Read failed after %d retries at LBA %lu\n", MAX_RETRIES, lba);
     return -1;
 }
 
-// Write с retry логикой
-int ata_write_sectors_retry(uint8_t is_master, uint32_t lba, uint8_t count, const uint8_t* buffer) {
+// Write с retry логикой: общий цикл для одного буфера и для gather
+static int ata_write_chunks_retry(uint8_t is_master, uint64_t lba, uint32_t count,
+                                  const uint8_t* const* chunks, uint32_t chunk_sectors) {
     const int MAX_RETRIES = 3;
 
     for (int retry = 0; retry < MAX_RETRIES; retry++) {
-        int result = ata_write_sectors(is_master, lba, count, buffer);
+        int result = ata_write_chunks(is_master, lba, count, chunks, chunk_sectors);
 
         if (result == 0) {
             return 0;  // Success
@@ -384,20 +950,42 @@ int ata_write_sectors_retry(uint8_t is_master, uint32_t lba, uint8_t count, cons
         for (volatile int i = 0; i < 10000; i++) { }
     }
 
-    kprintf("[ATA] Write failed after %d retries at LBA %u\n", MAX_RETRIES, lba);
+    kprintf("[ATA] Write failed after %d retries at LBA %lu\n", MAX_RETRIES, lba);
     return -1;
 }
 
+int ata_write_sectors_retry(uint8_t is_master, uint64_t lba, uint32_t count, const uint8_t* buffer) {
+    return ata_write_chunks_retry(is_master, lba, count, &buffer, count ? count : 1);
+}
+
 // ============================================================================
 // HIGH-LEVEL DISK I/O для TagFS
 // ============================================================================
 
+const ATADevice* ata_block_device(void) {
+    return ata_backend ? ata_backend->device() : &ata_primary_master;
+}
+
+uint32_t ata_max_transfer_blocks(void) {
+    if (ata_backend) {
+        return ATA_LBA48_TRANSFER_BLOCKS;  // Backend сам делит на команды
+    }
+    if (!ata_primary_master.exists) {
+        return 0;
+    }
+    return ata_primary_master.lba48 ? ATA_LBA48_TRANSFER_BLOCKS : ATA_LBA28_TRANSFER_BLOCKS;
+}
+
 // Читать блок (4KB) для TagFS
 // block_num - номер блока TagFS (4KB)
 // buffer - буфер для данных (должен быть 4096 байт)
 int ata_read_block(uint32_t block_num, uint8_t* buffer) {
     // 1 TagFS block (4KB) = 8 ATA sectors (512 bytes each)
-    uint32_t lba = block_num * 8;
+    uint64_t lba = (uint64_t)block_num * 8;
+
+    if (ata_backend) {
+        return ata_backend->read_sectors(lba, 8, buffer);
+    }
 
     // Читаем 8 секторов
     return ata_read_sectors_retry(1, lba, 8, buffer);  // is_master = 1
@@ -406,28 +994,92 @@ int ata_read_block(uint32_t block_num, uint8_t* buffer) {
 // Записать блок (4KB) для TagFS
 int ata_write_block(uint32_t block_num, const uint8_t* buffer) {
     // 1 TagFS block (4KB) = 8 ATA sectors (512 bytes each)
-    uint32_t lba = block_num * 8;
+    uint64_t lba = (uint64_t)block_num * 8;
+
+    if (ata_backend) {
+        return ata_backend->write_chunks(lba, 8, &buffer, 8);
+    }
 
     // Пишем 8 секторов
     return ata_write_sectors_retry(1, lba, 8, buffer);  // is_master = 1
 }
 
-// Читать несколько блоков подряд
+// Читать несколько блоков подряд: одна команда на ata_max_transfer_blocks()
 int ata_read_blocks(uint32_t start_block, uint32_t count, uint8_t* buffer) {
-    for (uint32_t i = 0; i < count; i++) {
-        if (ata_read_block(start_block + i, buffer + i * 4096) != 0) {
+    if (ata_backend) {
+        return ata_backend->read_sectors((uint64_t)start_block * 8, count * 8, buffer);
+    }
+
+    uint32_t max_run = ata_max_transfer_blocks();
+    if (max_run == 0) {
+        return -1;
+    }
+
+    for (uint32_t done = 0; done < count; ) {
+        uint32_t run = count - done;
+        if (run > max_run) {
+            run = max_run;
+        }
+        uint64_t lba = (uint64_t)(start_block + done) * 8;
+        if (ata_read_sectors_retry(1, lba, run * 8, buffer + (uint64_t)done * 4096) != 0) {
             return -1;
         }
+        done += run;
     }
     return 0;
 }
 
 // Записать несколько блоков подряд
 int ata_write_blocks(uint32_t start_block, uint32_t count, const uint8_t* buffer) {
-    for (uint32_t i = 0; i < count; i++) {
-        if (ata_write_block(start_block + i, buffer + i * 4096) != 0) {
+    if (ata_backend) {
+        return ata_backend->write_chunks((uint64_t)start_block * 8, count * 8, &buffer, count * 8);
+    }
+
+    uint32_t max_run = ata_max_transfer_blocks();
+    if (max_run == 0) {
+        return -1;
+    }
+
+    for (uint32_t done = 0; done < count; ) {
+        uint32_t run = count - done;
+        if (run > max_run) {
+            run = max_run;
+        }
+        uint64_t lba = (uint64_t)(start_block + done) * 8;
+        if (ata_write_sectors_retry(1, lba, run * 8, buffer + (uint64_t)done * 4096) != 0) {
+            return -1;
+        }
+        done += run;
+    }
+    return 0;
+}
+
+// Записать подряд идущие блоки из отдельных буферов по 4KB
+int ata_write_blocks_gather(uint32_t start_block, uint32_t count, const uint8_t* const* buffers) {
+    if (ata_backend) {
+        return ata_backend->write_chunks((uint64_t)start_block * 8, count * 8, buffers, 8);
+    }
+
+    // Каждый буфер - минимум один PRD (два, если пересекает 64KB границу)
+    uint32_t max_run = ata_max_transfer_blocks();
+    if (max_run > ATA_PRD_MAX_ENTRIES / 2) {
+        max_run = ATA_PRD_MAX_ENTRIES / 2;
+    }
+    if (max_run == 0) {
+        return -1;
+    }
+
+    for (uint32_t done = 0; done < count; ) {
+        uint32_t run = count - done;
+        if (run > max_run) {
+            run = max_run;
+        }
+
+        uint64_t lba = (uint64_t)(start_block + done) * 8;
+        if (ata_write_chunks_retry(1, lba, run * 8, buffers + done, 8) != 0) {
             return -1;
         }
+        done += run;
     }
     return 0;
 }
@@ -436,6 +1088,33 @@ int ata_write_blocks(uint32_t start_block, uint32_t count, const uint8_t* buffer
 // INITIALIZATION
 // ============================================================================
 
+#ifndef ATA_BACKEND
+#define ATA_BACKEND auto
+#endif
+#define ATA_STRINGIFY(x) #x
+#define ATA_BACKEND_NAME(x) ATA_STRINGIFY(x)
+
+// Порядок: virtio-blk, AHCI, legacy канал. make DISK=virtio|ahci|ata
+// оставляет один вариант (не нашёлся - legacy канал)
+static void ata_select_backend(void) {
+    const char* wanted = ATA_BACKEND_NAME(ATA_BACKEND);
+    int any = strcmp(wanted, "auto") == 0;
+
+    if ((any || strcmp(wanted, "virtio") == 0) && virtio_blk_init() == 0) {
+        ata_backend = &virtio_blk_backend;
+    } else if ((any || strcmp(wanted, "ahci") == 0) && ahci_init() == 0) {
+        ata_backend = &ahci_backend;
+    }
+
+    if (ata_backend) {
+        kprintf("[ATA] Block backend: %s (%s)\n", ata_backend->name, wanted);
+    }
+}
+
+int ata_backend_irq_handler(uint8_t irq) {
+    return ata_backend ? ata_backend->irq_handler(irq) : 0;
+}
+
 // ATA Software Reset - критически важно для инициализации!
 static void ata_soft_reset(void) {
     kprintf("[ATA] Performing software reset...\n");
@@ -471,11 +1150,38 @@ static void ata_soft_reset(void) {
     kprintf("[ATA] Reset timeout - continuing anyway\n");
 }
 
+// SET MULTIPLE: PIO передаёт device->multiple секторов на одно DRQ прерывание
+// вместо одного. Степень двойки, не больше ATA_MULTIPLE_MAX и word 47
+static void ata_set_multiple(uint8_t is_master, ATADevice* device) {
+    uint8_t multiple = 0;
+    for (uint8_t n = 1; n <= device->max_multiple && n <= ATA_MULTIPLE_MAX; n <<= 1) {
+        multiple = n;
+    }
+    if (multiple < 2) {
+        return;  // READ/WRITE SECTORS
+    }
+
+    ata_select_drive(is_master);
+    outb(ATA_PRIMARY_SECCOUNT, multiple);
+    outb(ATA_PRIMARY_COMMAND, ATA_CMD_SET_MULTIPLE);
+
+    if (ata_wait_ready() != 0 || (ata_read_status() & ATA_SR_ERR)) {
+        kprintf("[ATA] %[W]SET MULTIPLE %u rejected, using single-sector PIO%[D]\n", multiple);
+        return;
+    }
+    device->multiple = multiple;
+}
+
 void ata_init(void) {
     kprintf("[ATA] Initializing ATA/IDE driver...\n");
 
     memset(&ata_primary_master, 0, sizeof(ATADevice));
     memset(&ata_primary_slave, 0, sizeof(ATADevice));
+    spinlock_init(&ata_channel_lock);
+
+    // Шаг 0: virtio-blk / AHCI - block интерфейс уходит туда, legacy канал
+    // остаётся для машин без них
+    ata_select_backend();
 
     // Шаг 1: Программный reset контроллера (ОБЯЗАТЕЛЬНО!)
     ata_soft_reset();
@@ -485,10 +1191,16 @@ void ata_init(void) {
         // Небольшая задержка для стабилизации
     }
 
-    // Шаг 3: Пытаемся определить master drive
+    // Шаг 3: PCI IDE bus master (без него - только PIO)
+    if (!ata_dma_init()) {
+        kprintf("[ATA] Bus-master DMA unavailable, using PIO\n");
+    }
+
+    // Шаг 4: Пытаемся определить master drive
     kprintf("[ATA] Detecting primary master...\n");
     int result = ata_identify(1, &ata_primary_master);
     if (result == 0) {
+        ata_set_multiple(1, &ata_primary_master);
         kprintf("[ATA] Primary master detected: %s (%lu MB)\n",
                 ata_primary_master.model, ata_primary_master.size_mb);
     } else {
@@ -514,5 +1226,11 @@ void ata_print_device_info(const ATADevice* device) {
     kprintf("  Type: %s\n", device->is_master ? "Master" : "Slave");
     kprintf("  Model: %s\n", device->model);
     kprintf("  Serial: %s\n", device->serial);
-    kprintf("  Size: %lu MB (%u sectors)\n", device->size_mb, device->total_sectors);
+    kprintf("  Size: %lu MB (%lu sectors)\n", device->size_mb, device->total_sectors);
+    kprintf("  Addressing: %s\n", device->lba48 ? "LBA48" : "LBA28");
+    kprintf("  Transfer: %s", device->dma ? "Bus-master DMA" : "PIO");
+    if (device->multiple) {
+        kprintf(" (PIO multiple %u)", device->multiple);
+    }
+    kprintf("\n");
 }
@@ -8,7 +8,8 @@
 // ============================================================================
 //
 // Поддержка PIO Mode (Programmed I/O) для чтения/записи секторов
-// LBA28 адресация (до 128GB дисков)
+// и PCI IDE bus-master DMA (PRD таблица), если контроллер его умеет
+// LBA28 адресация (до 128GB), LBA48 - если диск его поддерживает (IDENTIFY word 83)
 //
 // ============================================================================
 
@@ -28,9 +29,21 @@
 
 // ATA Commands
 #define ATA_CMD_READ_SECTORS    0x20    // Read sectors with retry
+#define ATA_CMD_READ_SECTORS_EXT 0x24   // Read sectors (LBA48)
+#define ATA_CMD_READ_DMA_EXT    0x25    // Read DMA (LBA48)
+#define ATA_CMD_READ_MULTIPLE_EXT 0x29  // Read multiple (LBA48)
 #define ATA_CMD_WRITE_SECTORS   0x30    // Write sectors with retry
+#define ATA_CMD_WRITE_SECTORS_EXT 0x34  // Write sectors (LBA48)
+#define ATA_CMD_WRITE_DMA_EXT   0x35    // Write DMA (LBA48)
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39 // Write multiple (LBA48)
+#define ATA_CMD_READ_MULTIPLE   0xC4    // Read multiple (один DRQ на блок секторов)
+#define ATA_CMD_WRITE_MULTIPLE  0xC5    // Write multiple
+#define ATA_CMD_SET_MULTIPLE    0xC6    // Set multiple mode (sector count = секторов на DRQ)
+#define ATA_CMD_READ_DMA        0xC8    // Read DMA (LBA28)
+#define ATA_CMD_WRITE_DMA       0xCA    // Write DMA (LBA28)
 #define ATA_CMD_IDENTIFY        0xEC    // Identify drive
 #define ATA_CMD_CACHE_FLUSH     0xE7    // Flush write cache
+#define ATA_CMD_CACHE_FLUSH_EXT 0xEA    // Flush write cache (LBA48)
 
 // Status Register Bits
 #define ATA_SR_BSY              0x80    // Busy
@@ -48,6 +61,27 @@
 
 // Constants
 #define ATA_SECTOR_SIZE         512     // Bytes per sector
+#define ATA_LBA28_LIMIT         (1ULL << 28)  // Первый сектор вне LBA28
+#define ATA_LBA28_MAX_SECTORS   256     // Sector count 0 = 256
+#define ATA_LBA48_MAX_SECTORS   65536   // Sector count 0 = 65536
+#define ATA_MULTIPLE_MAX        16      // Секторов на DRQ блок (SET MULTIPLE)
+
+// PCI IDE Bus Master (BAR4 контроллера class 01:01, primary channel - +0)
+#define ATA_BM_COMMAND          0x00    // Bus master command register
+#define ATA_BM_STATUS           0x02    // Bus master status register
+#define ATA_BM_PRDT             0x04    // PRD table physical address (32-bit)
+
+#define ATA_BM_CMD_START        0x01    // Start/stop bus master
+#define ATA_BM_CMD_READ         0x08    // Direction: device -> memory
+
+#define ATA_BM_SR_ACTIVE        0x01    // Bus master IDE active
+#define ATA_BM_SR_ERR           0x02    // DMA error (write 1 to clear)
+#define ATA_BM_SR_IRQ           0x04    // INTRQ asserted (write 1 to clear)
+#define ATA_BM_SR_DMA_MASTER    0x20    // Drive 0 DMA capable
+#define ATA_BM_SR_DMA_SLAVE     0x40    // Drive 1 DMA capable
+
+#define ATA_PRD_EOT             0x8000  // Последний PRD в таблице
+#define ATA_PRD_MAX_ENTRIES     512     // 4KB таблица / 8 байт
 
 // ============================================================================
 // ATA DEVICE INFO
@@ -56,7 +90,11 @@
 typedef struct {
     uint8_t exists;                     // 1 if drive exists
     uint8_t is_master;                  // 1 if master, 0 if slave
-    uint32_t total_sectors;             // Total LBA28 sectors
+    uint8_t dma;                        // 1 if bus-master DMA is used
+    uint8_t lba48;                      // 1 if 48-bit LBA commands are supported
+    uint8_t max_multiple;               // IDENTIFY word 47: max sectors per DRQ block
+    uint8_t multiple;                   // Sectors per DRQ block (0 = READ/WRITE SECTORS)
+    uint64_t total_sectors;             // Total addressable sectors (LBA28 or LBA48)
     uint64_t size_mb;                   // Size in megabytes
     char model[41];                     // Model string (40 chars + null)
     char serial[21];                    // Serial number (20 chars + null)
@@ -72,32 +110,35 @@ void ata_init(void);
 // Определение устройства (IDENTIFY DEVICE)
 int ata_identify(uint8_t is_master, ATADevice* device);
 
+// Разобрать 256 слов IDENTIFY (LBA28/48, размер, model/serial) - и для AHCI
+void ata_parse_identify(const uint16_t* identify_data, ATADevice* device);
+
 // ============================================================================
 // I/O OPERATIONS
 // ============================================================================
 
 // Чтение секторов с диска
 // lba: Logical Block Address (номер сектора)
-// count: количество секторов (1-256)
+// count: количество секторов (1-256, с LBA48 - 1-65536)
 // buffer: буфер для данных (должен быть >= count * 512 байт)
 // Возвращает: 0 при успехе, -1 при ошибке
-int ata_read_sectors(uint8_t is_master, uint32_t lba, uint8_t count, uint8_t* buffer);
+int ata_read_sectors(uint8_t is_master, uint64_t lba, uint32_t count, uint8_t* buffer);
 
 // Запись секторов на диск
 // lba: Logical Block Address (номер сектора)
-// count: количество секторов (1-256)
+// count: количество секторов (1-256, с LBA48 - 1-65536)
 // buffer: данные для записи (должен быть >= count * 512 байт)
 // Возвращает: 0 при успехе, -1 при ошибке
-int ata_write_sectors(uint8_t is_master, uint32_t lba, uint8_t count, const uint8_t* buffer);
+int ata_write_sectors(uint8_t is_master, uint64_t lba, uint32_t count, const uint8_t* buffer);
 
 // Сброс кеша записи на диск (flush)
 int ata_flush_cache(uint8_t is_master);
 
 // Чтение секторов с retry логикой (более надёжно)
-int ata_read_sectors_retry(uint8_t is_master, uint32_t lba, uint8_t count, uint8_t* buffer);
+int ata_read_sectors_retry(uint8_t is_master, uint64_t lba, uint32_t count, uint8_t* buffer);
 
 // Запись секторов с retry логикой (более надёжно)
-int ata_write_sectors_retry(uint8_t is_master, uint32_t lba, uint8_t count, const uint8_t* buffer);
+int ata_write_sectors_retry(uint8_t is_master, uint64_t lba, uint32_t count, const uint8_t* buffer);
 
 // ============================================================================
 // HIGH-LEVEL BLOCK I/O для TagFS (4KB блоки)
@@ -109,12 +150,104 @@ int ata_read_block(uint32_t block_num, uint8_t* buffer);
 // Записать 1 блок TagFS (4KB = 8 секторов)
 int ata_write_block(uint32_t block_num, const uint8_t* buffer);
 
-// Читать несколько блоков подряд
+// Блоков TagFS за одну команду: LBA28 - sector count 8 бит (32 * 8 = 256),
+// LBA48 - 16MB, чтобы смежный буфер всегда укладывался в PRD таблицу
+#define ATA_LBA28_TRANSFER_BLOCKS 32
+#define ATA_LBA48_TRANSFER_BLOCKS 4096
+
+// Диск за block интерфейсом: AHCI порт, если HBA найден, иначе primary master
+const ATADevice* ata_block_device(void);
+
+// Блоков за одну команду для диска block интерфейса (0 - устройства нет)
+uint32_t ata_max_transfer_blocks(void);
+
+// Читать несколько блоков подряд: одна команда на смежный участок
 int ata_read_blocks(uint32_t start_block, uint32_t count, uint8_t* buffer);
 
-// Записать несколько блоков подряд
+// Записать несколько блоков подряд (multi-sector команды)
 int ata_write_blocks(uint32_t start_block, uint32_t count, const uint8_t* buffer);
 
+// То же, блок i - из buffers[i] (4KB каждый, память не обязана быть смежной)
+int ata_write_blocks_gather(uint32_t start_block, uint32_t count, const uint8_t* const* buffers);
+
+// ============================================================================
+// ASYNC I/O (bus-master DMA + IRQ14)
+// ============================================================================
+
+#define ATA_REQUEST_MAX_CHUNKS  32      // Буферов в одном async запросе
+
+// Запрос без ожидания: caller владеет структурой до вызова done()
+typedef struct ATARequest {
+    uint8_t is_master;
+    uint8_t write;                      // 0 = READ DMA, 1 = WRITE DMA
+    uint32_t count;                     // Секторов
+    uint64_t lba;
+    uint32_t chunk_sectors;             // Сектор s - chunks[s / chunk_sectors]
+    uint8_t* chunks[ATA_REQUEST_MAX_CHUNKS];
+    int status;                         // 0 = успех, -1 = ошибка (к вызову done)
+    void (*done)(struct ATARequest* req);
+    void* context;                      // Для done()
+    uint64_t started_at;                // TSC запуска на устройстве
+    struct ATARequest* next;
+} ATARequest;
+
+// In-flight команда без завершения дольше - ошибка и reset канала
+#define ATA_ASYNC_TIMEOUT_CYCLES (5000ULL * 2400000)  // ~5s при ~2.4GHz TSC
+
+// 1 = ata_submit() принимает запросы (master с DMA)
+int ata_async_available(void);
+
+// 1 = ata_submit() примет запрос (границы, буферы доступны DMA)
+int ata_request_valid(const ATARequest* req);
+
+// Команд в полёте, которые устройство выполняет одновременно (очередь
+// канала / NCQ / virtqueue)
+uint32_t ata_queue_depth(void);
+
+// В очередь канала, возврат сразу. 0 = принят, -1 = async недоступен или
+// буферы нельзя отдать DMA (caller читает/пишет синхронно)
+int ata_submit(ATARequest* req);
+
+// IRQ_ATA_PRIMARY (из irq_handler)
+void ata_irq_handler(void);
+
+// Завершить in-flight команду без IRQ (опрос bus master status, timeout).
+// Возвращает 1, если команда завершилась
+int ata_async_poll(void);
+
+// Вызвать done() завершённых запросов - вне IRQ и без удержания lock'ов,
+// которые берут колбэки. Возвращает количество
+uint32_t ata_async_reap(void);
+
+// Разрешить IRQ14 (после pic_init). Без вызова завершения видит только опрос
+void ata_enable_irq(void);
+
+void ata_print_async_stats(void);
+
+// ============================================================================
+// BLOCK BACKENDS (AHCI, virtio-blk)
+// ============================================================================
+
+// Драйвер вместо legacy канала: block интерфейс и async API выше уходят
+// сюда. Выбирается в ata_init()
+typedef struct {
+    const char* name;
+    const ATADevice* (*device)(void);
+    int (*read_sectors)(uint64_t lba, uint32_t count, uint8_t* buffer);
+    int (*write_chunks)(uint64_t lba, uint32_t count, const uint8_t* const* chunks, uint32_t chunk_sectors);
+    int (*request_valid)(const ATARequest* req);
+    uint32_t (*queue_depth)(void);
+    int (*submit)(ATARequest* req);                 // Как ata_submit(), is_master игнорируется
+    int (*irq_handler)(uint8_t irq);                // 1 = irq наш
+    int (*async_poll)(void);
+    uint32_t (*async_reap)(void);
+    void (*enable_irq)(void);
+    void (*print_stats)(void);
+} ATABackend;
+
+// IRQ линий PCI устройств (из irq_handler). 1 = обработан backend'ом
+int ata_backend_irq_handler(uint8_t irq);
+
 // ============================================================================
 // UTILITY FUNCTIONS
 // ============================================================================
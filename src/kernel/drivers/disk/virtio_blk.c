@@ -0,0 +1,920 @@
+#include "virtio_blk.h"
+#include "klib.h"
+#include "io.h"  // mmio_read*/mmio_write*, pause
+#include "pmm.h"
+#include "vmm.h"  // vmm_map_mmio, vmm_virt_to_phys_direct
+#include "pic.h"
+#include "pci.h"
+#include "atomics.h"
+
+// ============================================================================
+// VIRTQUEUE STRUCTURES
+// ============================================================================
+
+typedef struct __attribute__((packed)) {
+    uint16_t flags;                     // VIRTQ_AVAIL_F_NO_INTERRUPT (без EVENT_IDX)
+    volatile uint16_t idx;
+    uint16_t ring[VIRTIO_BLK_SLOTS];
+    volatile uint16_t used_event;       // EVENT_IDX: IRQ, когда used idx пройдёт его
+} VirtqAvail;
+
+typedef struct __attribute__((packed)) {
+    volatile uint16_t flags;            // VIRTQ_USED_F_NO_NOTIFY (без EVENT_IDX)
+    volatile uint16_t idx;
+    volatile VirtqUsedElem ring[VIRTIO_BLK_SLOTS];
+    volatile uint16_t avail_event;      // EVENT_IDX: kick, когда avail idx пройдёт его
+} VirtqUsed;
+
+// Кольцо в одной странице: desc (16B align), avail, used (4B align)
+#define VIRTQ_AVAIL_OFFSET      512
+#define VIRTQ_USED_OFFSET       1024
+
+typedef struct __attribute__((packed)) {
+    uint32_t type;                      // VIRTIO_BLK_T_*
+    uint32_t reserved;
+    uint64_t sector;
+} VirtioBlkHeader;
+
+// Страница слота: indirect таблица (header, данные, status) + сами header и status
+typedef struct __attribute__((packed)) {
+    VirtqDesc table[VIRTIO_BLK_SEGMENTS + 2];
+    VirtioBlkHeader header;
+    volatile uint8_t status;
+} VirtioBlkSlot;
+
+_Static_assert(sizeof(VirtioBlkSlot) <= 4096, "VirtioBlkSlot must fit in one page");
+_Static_assert(VIRTQ_USED_OFFSET + sizeof(VirtqUsed) <= 4096, "Virtqueue must fit in one page");
+
+typedef struct {
+    uintptr_t common;                   // Common configuration (MMIO)
+    uintptr_t notify_base;
+    uint32_t notify_mult;
+    uintptr_t notify;                   // Kick requestq
+    uintptr_t isr;                      // Чтение снимает INTx
+    uintptr_t config;                   // virtio_blk_config
+    uint8_t event_idx;
+    uint8_t flush;                      // Запись завершается после T_FLUSH
+    uint8_t read_only;
+    uint32_t max_segments;
+    uint32_t size_max;                  // Байт на сегмент (0 - без ограничения)
+    uint8_t* ring_page;
+    VirtqDesc* desc;
+    VirtqAvail* avail;
+    VirtqUsed* used;
+    uint16_t avail_idx;                 // Наша копия avail->idx
+    uint16_t kicked_idx;                // avail idx на момент прошлого kick
+    uint16_t last_used;                 // Следующий used элемент для разбора
+    VirtioBlkSlot* slots[VIRTIO_BLK_SLOTS];
+    ATARequest* slot_request[VIRTIO_BLK_SLOTS];
+    uint32_t busy;                      // Выданные устройству слоты
+    uint32_t flushing;                  // Слот выполняет T_FLUSH после записи
+    uint32_t async_slots;               // Слоты async запросов (ради них - IRQ)
+    ATADevice device;
+} VirtioBlk;
+
+static uint8_t virtio_irq_line = 0xFF;
+static volatile uint8_t virtio_ready = 0;
+static volatile uint8_t virtio_irq_enabled = 0;
+static VirtioBlk virtio_disk;
+
+// ============================================================================
+// REGISTER ACCESS
+// ============================================================================
+
+static inline uint8_t virtio_common_read8(uint32_t reg) {
+    return mmio_read8(virtio_disk.common + reg);
+}
+
+static inline void virtio_common_write8(uint32_t reg, uint8_t value) {
+    mmio_write8(virtio_disk.common + reg, value);
+}
+
+static inline uint16_t virtio_common_read16(uint32_t reg) {
+    return mmio_read16(virtio_disk.common + reg);
+}
+
+static inline void virtio_common_write16(uint32_t reg, uint16_t value) {
+    mmio_write16(virtio_disk.common + reg, value);
+}
+
+static inline uint32_t virtio_common_read32(uint32_t reg) {
+    return mmio_read32(virtio_disk.common + reg);
+}
+
+static inline void virtio_common_write32(uint32_t reg, uint32_t value) {
+    mmio_write32(virtio_disk.common + reg, value);
+}
+
+// 64-битные поля - двумя 32-битными записями (разрешено спецификацией)
+static inline void virtio_common_write64(uint32_t reg, uint64_t value) {
+    virtio_common_write32(reg, (uint32_t)value);
+    virtio_common_write32(reg + 4, (uint32_t)(value >> 32));
+}
+
+static inline uint64_t virtio_phys(const void* addr) {
+    uint64_t phys = vmm_virt_to_phys_direct((void*)addr);
+    if (phys == 0) {
+        phys = vmm_virt_to_phys(vmm_get_kernel_context(), (uintptr_t)addr);
+    }
+    return phys;
+}
+
+// ============================================================================
+// DEVICE SETUP
+// ============================================================================
+
+// Vendor-specific capabilities -> MMIO окна. Первая capability типа
+// выигрывает (так советует спецификация)
+static int virtio_blk_map_caps(const PciAddress* pci) {
+    uint8_t cap = 0;
+    while ((cap = pci_next_capability(pci, PCI_CAP_ID_VENDOR, cap)) != 0) {
+        uint8_t type = (pci_config_read(pci->bus, pci->dev, pci->func, cap) >> 24) & 0xFF;
+        uint8_t bar = pci_config_read(pci->bus, pci->dev, pci->func, cap + VIRTIO_CAP_BAR) & 0xFF;
+        uint32_t offset = pci_config_read(pci->bus, pci->dev, pci->func, cap + VIRTIO_CAP_OFFSET);
+        uint32_t length = pci_config_read(pci->bus, pci->dev, pci->func, cap + VIRTIO_CAP_LENGTH);
+
+        uintptr_t* target;
+        switch (type) {
+            case VIRTIO_PCI_CAP_COMMON: target = &virtio_disk.common; break;
+            case VIRTIO_PCI_CAP_NOTIFY: target = &virtio_disk.notify_base; break;
+            case VIRTIO_PCI_CAP_ISR:    target = &virtio_disk.isr; break;
+            case VIRTIO_PCI_CAP_DEVICE: target = &virtio_disk.config; break;
+            default: continue;          // PCI cfg access и прочее
+        }
+        if (*target || bar > 5 || length == 0) {
+            continue;
+        }
+
+        uint64_t phys = pci_bar_address(pci, bar);
+        if (phys == 0) {
+            continue;
+        }
+
+        void* mapped = vmm_map_mmio(phys + offset, length);
+        if (!mapped) {
+            kprintf("[VIRTIO] %[E]ERROR: Failed to map cfg type %u (BAR%u+0x%x)%[D]\n", type, bar, offset);
+            return -1;
+        }
+        *target = (uintptr_t)mapped;
+
+        if (type == VIRTIO_PCI_CAP_NOTIFY) {
+            virtio_disk.notify_mult = pci_config_read(pci->bus, pci->dev, pci->func,
+                                                      cap + VIRTIO_CAP_NOTIFY_MULT);
+        }
+    }
+
+    return (virtio_disk.common && virtio_disk.notify_base && virtio_disk.isr && virtio_disk.config) ? 0 : -1;
+}
+
+static void virtio_blk_fail(const char* reason) {
+    virtio_common_write8(VIRTIO_COMMON_STATUS, virtio_common_read8(VIRTIO_COMMON_STATUS) | VIRTIO_STATUS_FAILED);
+    kprintf("[VIRTIO] %[E]ERROR: %s%[D]\n", reason);
+}
+
+// Reset, features, requestq, DRIVER_OK. Повторно - восстановление после
+// зависшего запроса (кольцо начинается заново)
+static int virtio_blk_setup(void) {
+    virtio_common_write8(VIRTIO_COMMON_STATUS, 0);
+    for (int timeout = 1000000; virtio_common_read8(VIRTIO_COMMON_STATUS) != 0; timeout--) {
+        if (timeout == 0) {
+            kprintf("[VIRTIO] %[E]ERROR: Device reset timeout%[D]\n");
+            return -1;
+        }
+        pause();
+    }
+    virtio_common_write8(VIRTIO_COMMON_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    virtio_common_write32(VIRTIO_COMMON_DFSELECT, 0);
+    uint64_t offered = virtio_common_read32(VIRTIO_COMMON_DF);
+    virtio_common_write32(VIRTIO_COMMON_DFSELECT, 1);
+    offered |= (uint64_t)virtio_common_read32(VIRTIO_COMMON_DF) << 32;
+
+    // VERSION_1 - modern интерфейс; INDIRECT - запрос = один descriptor кольца
+    uint64_t required = (1ULL << VIRTIO_F_VERSION_1) | (1ULL << VIRTIO_RING_F_INDIRECT_DESC);
+    if ((offered & required) != required) {
+        virtio_blk_fail("Device lacks VERSION_1 or INDIRECT_DESC");
+        return -1;
+    }
+
+    uint64_t optional = (1ULL << VIRTIO_RING_F_EVENT_IDX) | (1ULL << VIRTIO_BLK_F_SEG_MAX) |
+                        (1ULL << VIRTIO_BLK_F_SIZE_MAX) | (1ULL << VIRTIO_BLK_F_FLUSH) |
+                        (1ULL << VIRTIO_BLK_F_RO);
+    uint64_t features = required | (offered & optional);
+
+    virtio_common_write32(VIRTIO_COMMON_GFSELECT, 0);
+    virtio_common_write32(VIRTIO_COMMON_GF, (uint32_t)features);
+    virtio_common_write32(VIRTIO_COMMON_GFSELECT, 1);
+    virtio_common_write32(VIRTIO_COMMON_GF, (uint32_t)(features >> 32));
+
+    virtio_common_write8(VIRTIO_COMMON_STATUS, virtio_common_read8(VIRTIO_COMMON_STATUS) | VIRTIO_STATUS_FEATURES_OK);
+    if (!(virtio_common_read8(VIRTIO_COMMON_STATUS) & VIRTIO_STATUS_FEATURES_OK)) {
+        virtio_blk_fail("Features rejected");
+        return -1;
+    }
+
+    virtio_disk.event_idx = (features >> VIRTIO_RING_F_EVENT_IDX) & 1;
+    virtio_disk.flush = (features >> VIRTIO_BLK_F_FLUSH) & 1;
+    virtio_disk.read_only = (features >> VIRTIO_BLK_F_RO) & 1;
+
+    // requestq 0: кольцо ровно на VIRTIO_BLK_SLOTS (степень двойки)
+    virtio_common_write16(VIRTIO_COMMON_Q_SELECT, 0);
+    uint16_t max_size = virtio_common_read16(VIRTIO_COMMON_Q_SIZE);
+    if (max_size < VIRTIO_BLK_SLOTS) {
+        virtio_blk_fail("requestq too small");
+        return -1;
+    }
+    virtio_common_write16(VIRTIO_COMMON_Q_SIZE, VIRTIO_BLK_SLOTS);
+
+    memset(virtio_disk.ring_page, 0, 4096);
+    for (uint32_t slot = 0; slot < VIRTIO_BLK_SLOTS; slot++) {
+        virtio_disk.desc[slot].addr = virtio_phys(virtio_disk.slots[slot]->table);
+        virtio_disk.desc[slot].flags = VIRTQ_DESC_F_INDIRECT;
+    }
+    virtio_disk.avail_idx = 0;
+    virtio_disk.kicked_idx = 0;
+    virtio_disk.last_used = 0;
+
+    // IRQ выключен, пока нет async запросов (см. virtio_blk_arm_irq)
+    if (virtio_disk.event_idx) {
+        virtio_disk.avail->used_event = (uint16_t)(virtio_disk.last_used - 1);
+    } else {
+        virtio_disk.avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+
+    virtio_common_write64(VIRTIO_COMMON_Q_DESC, virtio_phys(virtio_disk.desc));
+    virtio_common_write64(VIRTIO_COMMON_Q_AVAIL, virtio_phys(virtio_disk.avail));
+    virtio_common_write64(VIRTIO_COMMON_Q_USED, virtio_phys(virtio_disk.used));
+    virtio_common_write16(VIRTIO_COMMON_Q_MSIX, VIRTIO_MSI_NO_VECTOR);
+    virtio_common_write16(VIRTIO_COMMON_Q_ENABLE, 1);
+
+    uint16_t notify_off = virtio_common_read16(VIRTIO_COMMON_Q_NOFF);
+    virtio_disk.notify = virtio_disk.notify_base + (uintptr_t)notify_off * virtio_disk.notify_mult;
+
+    virtio_common_write8(VIRTIO_COMMON_STATUS, virtio_common_read8(VIRTIO_COMMON_STATUS) | VIRTIO_STATUS_DRIVER_OK);
+    return 0;
+}
+
+// ============================================================================
+// REQUEST BUILDING
+// ============================================================================
+
+// Сегменты данных в indirect таблицу: сектор s - chunks[s / chunk_sectors] +
+// (s % chunk_sectors) * 512. Буфер вне identity mapping - по странице,
+// соседние физические куски склеиваются. table = NULL - только проверить.
+// Возвращает сегментов или -1
+static int virtio_blk_build_sg(VirtqDesc* table, const uint8_t* const* chunks, uint32_t count,
+                               uint32_t chunk_sectors, uint8_t write) {
+    uint32_t max_bytes = virtio_disk.size_max ? virtio_disk.size_max
+                                              : VIRTIO_BLK_REQUEST_SECTORS * ATA_SECTOR_SIZE;
+    uint16_t flags = VIRTQ_DESC_F_NEXT | (write ? 0 : VIRTQ_DESC_F_WRITE);
+    uint32_t entries = 0;
+    uint64_t last_end = 0;
+    uint32_t last_bytes = 0;
+
+    for (uint32_t first = 0; first < count; first += chunk_sectors) {
+        uint32_t sectors = count - first;
+        if (sectors > chunk_sectors) {
+            sectors = chunk_sectors;
+        }
+
+        const uint8_t* addr = chunks[first / chunk_sectors];
+        uint64_t remaining = (uint64_t)sectors * ATA_SECTOR_SIZE;
+        int direct = vmm_virt_to_phys_direct((void*)addr) != 0;
+
+        while (remaining > 0) {
+            uint64_t phys = virtio_phys(addr);
+            uint64_t piece = direct ? remaining : 4096 - ((uintptr_t)addr & 0xFFF);
+            if (piece > remaining) {
+                piece = remaining;
+            }
+            if (phys == 0) {
+                return -1;
+            }
+
+            while (piece > 0) {
+                uint32_t bytes = piece > max_bytes ? max_bytes : (uint32_t)piece;
+
+                if (entries > 0 && phys == last_end && last_bytes + bytes <= max_bytes) {
+                    last_bytes += bytes;
+                    if (table) {
+                        table[entries - 1].len = last_bytes;
+                    }
+                } else {
+                    if (entries == virtio_disk.max_segments) {
+                        return -1;
+                    }
+                    if (table) {
+                        table[entries].addr = phys;
+                        table[entries].len = bytes;
+                        table[entries].flags = flags;
+                    }
+                    entries++;
+                    last_bytes = bytes;
+                }
+
+                last_end = phys + bytes;
+                phys += bytes;
+                addr += bytes;
+                piece -= bytes;
+                remaining -= bytes;
+            }
+        }
+    }
+
+    return (int)entries;
+}
+
+// Header + сегменты + status. Возвращает descriptors в indirect таблице
+static int virtio_blk_build_request(uint32_t slot, const ATARequest* req) {
+    VirtioBlkSlot* page = virtio_disk.slots[slot];
+    int segments = virtio_blk_build_sg(&page->table[1], (const uint8_t* const*)req->chunks,
+                                       req->count, req->chunk_sectors, req->write);
+    if (segments < 0) {
+        return -1;
+    }
+
+    page->header.type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    page->header.reserved = 0;
+    page->header.sector = req->lba;
+    page->status = 0xFF;
+
+    page->table[0].addr = virtio_phys(&page->header);
+    page->table[0].len = sizeof(VirtioBlkHeader);
+    page->table[0].flags = VIRTQ_DESC_F_NEXT;
+
+    uint32_t last = (uint32_t)segments + 1;
+    for (uint32_t i = 0; i < last; i++) {
+        page->table[i].next = (uint16_t)(i + 1);
+    }
+    page->table[last].addr = virtio_phys((const uint8_t*)&page->status);
+    page->table[last].len = 1;
+    page->table[last].flags = VIRTQ_DESC_F_WRITE;
+    page->table[last].next = 0;
+
+    return (int)last + 1;
+}
+
+// T_FLUSH в тот же слот - запись на устройстве с write-back cache
+static int virtio_blk_build_flush(uint32_t slot) {
+    VirtioBlkSlot* page = virtio_disk.slots[slot];
+    page->header.type = VIRTIO_BLK_T_FLUSH;
+    page->header.reserved = 0;
+    page->header.sector = 0;
+    page->status = 0xFF;
+
+    page->table[0].addr = virtio_phys(&page->header);
+    page->table[0].len = sizeof(VirtioBlkHeader);
+    page->table[0].flags = VIRTQ_DESC_F_NEXT;
+    page->table[0].next = 1;
+    page->table[1].addr = virtio_phys((const uint8_t*)&page->status);
+    page->table[1].len = 1;
+    page->table[1].flags = VIRTQ_DESC_F_WRITE;
+    page->table[1].next = 0;
+    return 2;
+}
+
+// В avail ring без kick: kick один на пачку (virtio_blk_kick)
+static void virtio_blk_post(uint32_t slot, int descriptors) {
+    virtio_disk.desc[slot].len = (uint32_t)descriptors * sizeof(VirtqDesc);
+    virtio_disk.avail->ring[virtio_disk.avail_idx % VIRTIO_BLK_SLOTS] = (uint16_t)slot;
+    virtio_disk.avail_idx++;
+}
+
+// ============================================================================
+// QUEUE (virtio_lock)
+// ============================================================================
+//
+// Та же схема, что у AHCI: async от ata_submit() (done() из
+// virtio_blk_async_reap) и синхронные (done = NULL, caller крутит
+// virtio_blk_async_poll пока status == VIRTIO_STATUS_PENDING). Ждущие слот -
+// FIFO. Timeout - reset устройства, всем в полёте -1.
+
+#define VIRTIO_STATUS_PENDING   1
+
+static spinlock_t virtio_lock;
+static ATARequest* virtio_queue_head = NULL;  // Ждут слот
+static ATARequest* virtio_queue_tail = NULL;
+static ATARequest* virtio_done_head = NULL;   // Ждут virtio_blk_async_reap()
+static ATARequest* virtio_done_tail = NULL;
+
+static struct {
+    volatile uint64_t submitted;
+    volatile uint64_t completed;
+    volatile uint64_t irq_completions;      // Увидел IRQ (остальные - опрос)
+    volatile uint64_t errors;
+    volatile uint64_t max_inflight;
+    volatile uint64_t kicks;
+    volatile uint64_t kicks_suppressed;     // Устройство ещё разбирает avail ring
+} virtio_stats;
+
+static void virtio_blk_kick(void) {
+    uint16_t old_idx = virtio_disk.kicked_idx;
+    uint16_t new_idx = virtio_disk.avail_idx;
+    if (old_idx == new_idx) {
+        return;
+    }
+
+    COMPILER_BARRIER();  // Descriptors и ring записаны до idx
+    virtio_disk.avail->idx = new_idx;
+    virtio_disk.kicked_idx = new_idx;
+    MEMORY_BARRIER();    // idx виден устройству до чтения avail_event/flags
+
+    int need = virtio_disk.event_idx ? virtio_need_event(virtio_disk.used->avail_event, new_idx, old_idx)
+                                     : !(virtio_disk.used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    if (need) {
+        mmio_write16(virtio_disk.notify, 0);  // Номер очереди
+        virtio_stats.kicks++;
+    } else {
+        virtio_stats.kicks_suppressed++;
+    }
+}
+
+// IRQ нужен только async запросам: синхронные caller опрашивает сам.
+// Возвращает 1, если после включения в used ring уже есть завершения
+// (IRQ на них не придёт - разобрать сразу)
+static int virtio_blk_arm_irq(void) {
+    int want = virtio_disk.async_slots && virtio_irq_enabled;
+
+    if (virtio_disk.event_idx) {
+        // last_used - 1: event позади old, устройство не прерывает
+        virtio_disk.avail->used_event = want ? virtio_disk.last_used : (uint16_t)(virtio_disk.last_used - 1);
+    } else {
+        virtio_disk.avail->flags = want ? 0 : VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+
+    if (!want) {
+        return 0;
+    }
+    MEMORY_BARRIER();
+    return virtio_disk.used->idx != virtio_disk.last_used;
+}
+
+static void virtio_blk_finish_slot(uint32_t slot, int status) {
+    ATARequest* req = virtio_disk.slot_request[slot];
+    virtio_disk.slot_request[slot] = NULL;
+    virtio_disk.busy &= ~(1u << slot);
+    virtio_disk.flushing &= ~(1u << slot);
+    virtio_disk.async_slots &= ~(1u << slot);
+
+    if (status != 0) {
+        atomic_increment_u64(&virtio_stats.errors);
+    }
+
+    if (!req->done) {
+        // Синхронный: после записи status caller может уйти со стека
+        *(volatile int*)&req->status = status;
+        return;
+    }
+
+    req->status = status;
+    req->next = NULL;
+    if (virtio_done_tail) {
+        virtio_done_tail->next = req;
+    } else {
+        virtio_done_head = req;
+    }
+    virtio_done_tail = req;
+}
+
+static void virtio_blk_start_next(void) {
+    while (virtio_queue_head) {
+        uint32_t free_slots = ~virtio_disk.busy;
+        if (!free_slots) {
+            break;
+        }
+        uint32_t slot = (uint32_t)__builtin_ctz(free_slots);
+
+        ATARequest* req = virtio_queue_head;
+        virtio_queue_head = req->next;
+        if (!virtio_queue_head) {
+            virtio_queue_tail = NULL;
+        }
+        req->next = NULL;
+
+        virtio_disk.slot_request[slot] = req;
+        virtio_disk.busy |= 1u << slot;
+        if (req->done) {
+            virtio_disk.async_slots |= 1u << slot;
+        }
+
+        int descriptors = virtio_blk_build_request(slot, req);
+        if (descriptors < 0) {
+            virtio_blk_finish_slot(slot, -1);  // Проверено в submit - сюда не попадаем
+            continue;
+        }
+
+        req->started_at = rdtsc();
+        virtio_blk_post(slot, descriptors);
+
+        uint32_t inflight = (uint32_t)__builtin_popcount(virtio_disk.busy);
+        if (inflight > virtio_stats.max_inflight) {
+            virtio_stats.max_inflight = inflight;
+        }
+    }
+
+    virtio_blk_kick();
+}
+
+// Разобрать used ring, выдать ждущие, перевооружить IRQ. Возвращает
+// завершённых запросов
+static uint32_t virtio_blk_process(void) {
+    uint32_t completed = 0;
+
+    do {
+        while (virtio_disk.last_used != virtio_disk.used->idx) {
+            COMPILER_BARRIER();  // Элемент читаем после idx
+            uint32_t slot = virtio_disk.used->ring[virtio_disk.last_used % VIRTIO_BLK_SLOTS].id;
+            virtio_disk.last_used++;
+
+            // DEFENSIVE: id не из выданных - игнорируем
+            if (slot >= VIRTIO_BLK_SLOTS || !(virtio_disk.busy & (1u << slot))) {
+                kprintf("[VIRTIO] %[W]Spurious used id %u%[D]\n", slot);
+                continue;
+            }
+
+            ATARequest* req = virtio_disk.slot_request[slot];
+            uint8_t status = virtio_disk.slots[slot]->status;
+            if (status != VIRTIO_BLK_S_OK) {
+                kprintf("[VIRTIO] %[E]ERROR: %s LBA %lu+%u failed (status %u)%[D]\n",
+                        (virtio_disk.flushing & (1u << slot)) ? "FLUSH after" : (req->write ? "Write" : "Read"),
+                        req->lba, req->count, status);
+                virtio_blk_finish_slot(slot, -1);
+                completed++;
+                continue;
+            }
+
+            // Запись: прежде завершения - T_FLUSH тем же слотом
+            if (req->write && virtio_disk.flush && !(virtio_disk.flushing & (1u << slot))) {
+                virtio_disk.flushing |= 1u << slot;
+                virtio_blk_post(slot, virtio_blk_build_flush(slot));
+                continue;
+            }
+            virtio_blk_finish_slot(slot, 0);
+            completed++;
+        }
+
+        virtio_blk_start_next();
+    } while (virtio_blk_arm_irq());
+
+    return completed;
+}
+
+// Запрос дольше ATA_ASYNC_TIMEOUT_CYCLES: отменить его нельзя - reset
+// устройства, всем в полёте -1
+static uint32_t virtio_blk_check_timeout(void) {
+    uint64_t now = rdtsc();
+    for (uint32_t slot = 0; slot < VIRTIO_BLK_SLOTS; slot++) {
+        ATARequest* req = virtio_disk.slot_request[slot];
+        if (!req || now - req->started_at <= ATA_ASYNC_TIMEOUT_CYCLES) {
+            continue;
+        }
+
+        kprintf("[VIRTIO] %[E]ERROR: Request timeout (LBA %lu, busy=0x%x), resetting device%[D]\n",
+                req->lba, virtio_disk.busy);
+
+        uint32_t failed = (uint32_t)__builtin_popcount(virtio_disk.busy);
+        if (virtio_blk_setup() != 0) {
+            virtio_ready = 0;  // Устройство не поднялось: дальше все запросы -1
+        }
+        for (uint32_t s = 0; s < VIRTIO_BLK_SLOTS; s++) {
+            if (virtio_disk.busy & (1u << s)) {
+                virtio_blk_finish_slot(s, -1);
+            }
+        }
+        if (virtio_ready) {
+            virtio_blk_start_next();
+            virtio_blk_arm_irq();
+        }
+        return failed;
+    }
+    return 0;
+}
+
+static int virtio_blk_request_valid(const ATARequest* req) {
+    if (req->count == 0 || req->count > VIRTIO_BLK_REQUEST_SECTORS || req->chunk_sectors == 0 ||
+        (req->count + req->chunk_sectors - 1) / req->chunk_sectors > ATA_REQUEST_MAX_CHUNKS ||
+        req->lba + req->count > virtio_disk.device.total_sectors ||
+        (req->write && virtio_disk.read_only)) {
+        return 0;
+    }
+    return virtio_blk_build_sg(NULL, (const uint8_t* const*)req->chunks, req->count,
+                               req->chunk_sectors, req->write) >= 0;
+}
+
+static void virtio_blk_enqueue(ATARequest* req) {
+    req->status = VIRTIO_STATUS_PENDING;
+    req->next = NULL;
+
+    spin_lock(&virtio_lock);
+    if (virtio_queue_tail) {
+        virtio_queue_tail->next = req;
+    } else {
+        virtio_queue_head = req;
+    }
+    virtio_queue_tail = req;
+    virtio_blk_process();
+    spin_unlock(&virtio_lock);
+
+    atomic_increment_u64(&virtio_stats.submitted);
+}
+
+// ============================================================================
+// ASYNC API
+// ============================================================================
+
+int virtio_blk_available(void) {
+    return virtio_ready;
+}
+
+const ATADevice* virtio_blk_device(void) {
+    return &virtio_disk.device;
+}
+
+int virtio_blk_can_submit(const ATARequest* req) {
+    return virtio_ready && virtio_blk_request_valid(req);
+}
+
+uint32_t virtio_blk_queue_depth(void) {
+    return VIRTIO_BLK_SLOTS;
+}
+
+int virtio_blk_submit(ATARequest* req) {
+    if (!virtio_ready || !req->done || !virtio_blk_request_valid(req)) {
+        return -1;
+    }
+    virtio_blk_enqueue(req);
+    return 0;
+}
+
+int virtio_blk_irq_handler(uint8_t irq) {
+    if (!virtio_ready || irq != virtio_irq_line) {
+        return 0;
+    }
+
+    // Чтение ISR снимает INTx. 0 - линию делит другое устройство
+    uint8_t isr = mmio_read8(virtio_disk.isr);
+    if (!isr) {
+        return 0;
+    }
+
+    spin_lock(&virtio_lock);
+    uint32_t completed = virtio_blk_process();
+    spin_unlock(&virtio_lock);
+
+    atomic_add_u64(&virtio_stats.irq_completions, completed);
+    return 1;
+}
+
+int virtio_blk_async_poll(void) {
+    // Без lock: пусто - частый случай (idle проход Storage Deck)
+    if (!virtio_ready || (!virtio_disk.busy && !virtio_queue_head)) {
+        return 0;
+    }
+
+    spin_lock(&virtio_lock);
+    uint32_t completed = virtio_blk_process();
+    if (completed == 0) {
+        completed = virtio_blk_check_timeout();
+    }
+    spin_unlock(&virtio_lock);
+    return completed > 0;
+}
+
+uint32_t virtio_blk_async_reap(void) {
+    if (!virtio_done_head) {
+        return 0;
+    }
+
+    spin_lock(&virtio_lock);
+    ATARequest* list = virtio_done_head;
+    virtio_done_head = virtio_done_tail = NULL;
+    spin_unlock(&virtio_lock);
+
+    uint32_t count = 0;
+    while (list) {
+        ATARequest* req = list;
+        list = req->next;
+        req->next = NULL;
+        count++;
+        req->done(req);  // Может переиспользовать req
+    }
+
+    atomic_add_u64(&virtio_stats.completed, count);
+    return count;
+}
+
+// ============================================================================
+// SYNCHRONOUS I/O
+// ============================================================================
+
+// Запросы по VIRTIO_BLK_REQUEST_SECTORS, до VIRTIO_BLK_SYNC_WINDOW в полёте
+static int virtio_blk_transfer(uint64_t lba, uint32_t count, const uint8_t* const* chunks,
+                               uint32_t chunk_sectors, uint8_t write) {
+    if (!virtio_ready || chunk_sectors == 0) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // Несколько буферов: каждый запрос целиком из целых chunks
+    if (chunk_sectors < count && chunk_sectors > VIRTIO_BLK_REQUEST_SECTORS) {
+        return -1;
+    }
+
+    uint32_t step = VIRTIO_BLK_REQUEST_SECTORS;
+    if (chunk_sectors < count && chunk_sectors < step) {
+        step -= step % chunk_sectors;
+    }
+
+    ATARequest window[VIRTIO_BLK_SYNC_WINDOW];
+    uint32_t issued = 0;
+    uint32_t waited = 0;
+    uint32_t offset = 0;
+    int result = 0;
+
+    while (waited < issued || offset < count) {
+        if (offset < count && issued - waited < VIRTIO_BLK_SYNC_WINDOW && result == 0) {
+            ATARequest* req = &window[issued % VIRTIO_BLK_SYNC_WINDOW];
+            memset(req, 0, sizeof(ATARequest));
+            req->write = write;
+            req->lba = lba + offset;
+            req->count = count - offset < step ? count - offset : step;
+
+            if (chunk_sectors >= count) {
+                req->chunks[0] = (uint8_t*)chunks[0] + (uint64_t)offset * ATA_SECTOR_SIZE;
+                req->chunk_sectors = req->count;
+            } else {
+                for (uint32_t i = 0; i * chunk_sectors < req->count; i++) {
+                    req->chunks[i] = (uint8_t*)chunks[offset / chunk_sectors + i];
+                }
+                req->chunk_sectors = chunk_sectors;
+            }
+
+            if (!virtio_blk_request_valid(req)) {
+                kprintf("[VIRTIO] ERROR: Cannot %s LBA %lu+%u (bounds, buffer or read-only)\n",
+                        write ? "write" : "read", req->lba, req->count);
+                result = -1;
+                continue;
+            }
+            virtio_blk_enqueue(req);
+            offset += req->count;
+            issued++;
+            continue;
+        }
+
+        if (waited == issued) {
+            break;  // Ошибка до отправки - ждать нечего
+        }
+
+        // IRQ для синхронных не запрашиваем - доводим опросом
+        ATARequest* oldest = &window[waited % VIRTIO_BLK_SYNC_WINDOW];
+        while (*(volatile int*)&oldest->status == VIRTIO_STATUS_PENDING) {
+            virtio_blk_async_poll();
+            pause();
+        }
+        if (oldest->status != 0) {
+            result = -1;
+        }
+        waited++;
+    }
+
+    return result;
+}
+
+int virtio_blk_read_sectors(uint64_t lba, uint32_t count, uint8_t* buffer) {
+    const uint8_t* chunk = buffer;
+    return virtio_blk_transfer(lba, count, &chunk, count ? count : 1, 0);
+}
+
+int virtio_blk_write_chunks(uint64_t lba, uint32_t count, const uint8_t* const* chunks,
+                            uint32_t chunk_sectors) {
+    return virtio_blk_transfer(lba, count, chunks, chunk_sectors, 1);
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+static void virtio_blk_read_config(void) {
+    uint8_t generation;
+    uint64_t capacity;
+    uint32_t seg_max;
+    uint32_t size_max;
+
+    // Config generation: поля прочитаны без изменения между ними
+    do {
+        generation = virtio_common_read8(VIRTIO_COMMON_CFGGEN);
+        capacity = mmio_read32(virtio_disk.config + VIRTIO_BLK_CFG_CAPACITY) |
+                   ((uint64_t)mmio_read32(virtio_disk.config + VIRTIO_BLK_CFG_CAPACITY + 4) << 32);
+        size_max = mmio_read32(virtio_disk.config + VIRTIO_BLK_CFG_SIZE_MAX);
+        seg_max = mmio_read32(virtio_disk.config + VIRTIO_BLK_CFG_SEG_MAX);
+    } while (generation != virtio_common_read8(VIRTIO_COMMON_CFGGEN));
+
+    virtio_disk.max_segments = VIRTIO_BLK_SEGMENTS;
+    if (seg_max != 0 && seg_max < virtio_disk.max_segments) {
+        virtio_disk.max_segments = seg_max;
+    }
+    // Сегмент не меньше сектора, иначе size_max игнорируем
+    virtio_disk.size_max = size_max >= ATA_SECTOR_SIZE ? size_max & ~(ATA_SECTOR_SIZE - 1) : 0;
+
+    ATADevice* device = &virtio_disk.device;
+    device->exists = 1;
+    device->is_master = 1;
+    device->dma = 1;
+    device->lba48 = 1;                  // Без ограничения LBA28
+    device->total_sectors = capacity;
+    device->size_mb = capacity / 2048;
+    strncpy(device->model, "VirtIO Block Device", sizeof(device->model) - 1);
+}
+
+int virtio_blk_init(void) {
+    PciAddress pci;
+    if (!pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_PCI_DEVICE_BLK, &pci) &&
+        !pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_PCI_DEVICE_BLK_TRANS, &pci)) {
+        kprintf("[VIRTIO] No virtio-blk device\n");
+        return -1;
+    }
+
+    pci_enable(&pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+    if (virtio_blk_map_caps(&pci) != 0) {
+        kprintf("[VIRTIO] %[W]virtio-blk %02x:%02x.%x has no modern interface, skipping%[D]\n",
+                pci.bus, pci.dev, pci.func);
+        memset(&virtio_disk, 0, sizeof(VirtioBlk));
+        return -1;
+    }
+    virtio_irq_line = (uint8_t)(pci_config_read(pci.bus, pci.dev, pci.func, PCI_REG_INTERRUPT) & 0xFF);
+
+    virtio_disk.ring_page = (uint8_t*)pmm_alloc_zero(1);
+    if (!virtio_disk.ring_page) {
+        return -1;
+    }
+    virtio_disk.desc = (VirtqDesc*)virtio_disk.ring_page;
+    virtio_disk.avail = (VirtqAvail*)(virtio_disk.ring_page + VIRTQ_AVAIL_OFFSET);
+    virtio_disk.used = (VirtqUsed*)(virtio_disk.ring_page + VIRTQ_USED_OFFSET);
+
+    for (uint32_t slot = 0; slot < VIRTIO_BLK_SLOTS; slot++) {
+        virtio_disk.slots[slot] = (VirtioBlkSlot*)pmm_alloc_zero(1);
+        if (!virtio_disk.slots[slot]) {
+            kprintf("[VIRTIO] %[E]ERROR: Out of memory for request slots%[D]\n");
+            return -1;
+        }
+    }
+
+    spinlock_init(&virtio_lock);
+    if (virtio_blk_setup() != 0) {
+        return -1;
+    }
+    virtio_blk_read_config();
+    virtio_ready = 1;
+
+    kprintf("[VIRTIO] virtio-blk %02x:%02x.%x: %lu MB (%lu sectors), %u slots, %u segments%s%s%s, irq=%u\n",
+            pci.bus, pci.dev, pci.func, virtio_disk.device.size_mb, virtio_disk.device.total_sectors,
+            VIRTIO_BLK_SLOTS, virtio_disk.max_segments,
+            virtio_disk.event_idx ? ", event idx" : "", virtio_disk.flush ? ", flush" : "",
+            virtio_disk.read_only ? ", read-only" : "", virtio_irq_line);
+    return 0;
+}
+
+void virtio_blk_enable_irq(void) {
+    if (!virtio_ready || virtio_irq_enabled || virtio_irq_line >= 16) {
+        return;
+    }
+
+    virtio_irq_enabled = 1;
+    pic_enable_irq(virtio_irq_line);
+
+    // Async запросы уже в полёте - IRQ для них
+    spin_lock(&virtio_lock);
+    virtio_blk_process();
+    spin_unlock(&virtio_lock);
+
+    kprintf("[VIRTIO] IRQ%u enabled: request completions\n", virtio_irq_line);
+}
+
+void virtio_blk_print_stats(void) {
+    kprintf("  virtio-blk:      submitted=%lu completed=%lu (irq=%lu) errors=%lu max_inflight=%lu\n",
+            atomic_load_u64(&virtio_stats.submitted),
+            atomic_load_u64(&virtio_stats.completed),
+            atomic_load_u64(&virtio_stats.irq_completions),
+            atomic_load_u64(&virtio_stats.errors),
+            atomic_load_u64(&virtio_stats.max_inflight));
+    kprintf("                   kicks=%lu suppressed=%lu\n",
+            atomic_load_u64(&virtio_stats.kicks),
+            atomic_load_u64(&virtio_stats.kicks_suppressed));
+}
+
+const ATABackend virtio_blk_backend = {
+    .name = "virtio-blk",
+    .device = virtio_blk_device,
+    .read_sectors = virtio_blk_read_sectors,
+    .write_chunks = virtio_blk_write_chunks,
+    .request_valid = virtio_blk_can_submit,
+    .queue_depth = virtio_blk_queue_depth,
+    .submit = virtio_blk_submit,
+    .irq_handler = virtio_blk_irq_handler,
+    .async_poll = virtio_blk_async_poll,
+    .async_reap = virtio_blk_async_reap,
+    .enable_irq = virtio_blk_enable_irq,
+    .print_stats = virtio_blk_print_stats,
+};
@@ -0,0 +1,94 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "ktypes.h"
+#include "ata.h"  // ATADevice, ATARequest, ATABackend
+#include "virtio_pci.h"
+
+// ============================================================================
+// virtio-blk Driver - modern PCI (virtio 1.0), 1AF4:1042 / 1AF4:1001
+// ============================================================================
+//
+// Одна split virtqueue (requestq). Запрос занимает один descriptor кольца
+// (INDIRECT): header, сегменты данных и status байт - в странице слота.
+// До VIRTIO_BLK_SLOTS запросов в полёте, ждущие слот - FIFO.
+//
+// Notification suppression (VIRTIO_RING_F_EVENT_IDX): kick только если
+// устройство ждёт его (avail_event), пачка запросов - один kick. IRQ
+// запрашиваем, только пока в полёте async запросы: синхронный путь
+// опрашивает used ring сам.
+//
+// ============================================================================
+
+#define VIRTIO_PCI_DEVICE_BLK       0x1042  // Modern
+#define VIRTIO_PCI_DEVICE_BLK_TRANS 0x1001  // Transitional (modern caps тоже есть)
+
+// Feature bits
+#define VIRTIO_BLK_F_SIZE_MAX       1       // Байт на сегмент
+#define VIRTIO_BLK_F_SEG_MAX        2       // Сегментов на запрос
+#define VIRTIO_BLK_F_RO             5
+#define VIRTIO_BLK_F_FLUSH          9       // Write-back cache: нужен T_FLUSH
+
+// Device configuration (struct virtio_blk_config)
+#define VIRTIO_BLK_CFG_CAPACITY     0x00    // 512-байтных секторов, 64 бита
+#define VIRTIO_BLK_CFG_SIZE_MAX     0x08
+#define VIRTIO_BLK_CFG_SEG_MAX      0x0C
+
+#define VIRTIO_BLK_T_IN             0
+#define VIRTIO_BLK_T_OUT            1
+#define VIRTIO_BLK_T_FLUSH          4
+#define VIRTIO_BLK_S_OK             0
+
+#define VIRTIO_BLK_SLOTS            32      // Размер кольца = запросов в полёте
+#define VIRTIO_BLK_SEGMENTS         248     // Indirect таблица = (248 + 2) * 16 < 4KB
+
+// Секторов на запрос и синхронных запросов одного caller'а в полёте -
+// как у AHCI
+#define VIRTIO_BLK_REQUEST_SECTORS  256
+#define VIRTIO_BLK_SYNC_WINDOW      4
+
+// ============================================================================
+// API
+// ============================================================================
+
+// Найти устройство, поднять requestq. Вызывать после vmm_init.
+// 0 = диск готов, -1 = нет устройства или оно не подходит
+int virtio_blk_init(void);
+
+int virtio_blk_available(void);
+
+const ATADevice* virtio_blk_device(void);
+
+// Чтение/запись - 0 при успехе, -1 при ошибке. Любой count: делится на
+// запросы по VIRTIO_BLK_REQUEST_SECTORS, до VIRTIO_BLK_SYNC_WINDOW в полёте.
+// chunks: один смежный буфер (chunk_sectors >= count) или куски не больше
+// VIRTIO_BLK_REQUEST_SECTORS
+int virtio_blk_read_sectors(uint64_t lba, uint32_t count, uint8_t* buffer);
+int virtio_blk_write_chunks(uint64_t lba, uint32_t count, const uint8_t* const* chunks,
+                            uint32_t chunk_sectors);
+
+// Как ata_request_valid() / ata_queue_depth()
+int virtio_blk_can_submit(const ATARequest* req);
+uint32_t virtio_blk_queue_depth(void);
+
+// Async как ata_submit(): 0 = принят, -1 = нельзя (caller делает синхронно)
+int virtio_blk_submit(ATARequest* req);
+
+// IRQ линии устройства (из irq_handler). 1 = irq наш
+int virtio_blk_irq_handler(uint8_t irq);
+
+// Завершения без IRQ + timeout. 1 = что-то завершилось
+int virtio_blk_async_poll(void);
+
+// done() завершённых async запросов - вне IRQ и чужих lock'ов
+uint32_t virtio_blk_async_reap(void);
+
+// Разрешить IRQ линии устройства (после pic_init)
+void virtio_blk_enable_irq(void);
+
+void virtio_blk_print_stats(void);
+
+// Для ata_init(): block интерфейс ATA через virtio-blk
+extern const ATABackend virtio_blk_backend;
+
+#endif // VIRTIO_BLK_H
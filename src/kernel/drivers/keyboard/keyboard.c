@@ -1,16 +1,21 @@
 #include "keyboard.h"
 #include "klib.h"
+#include "atomics.h"
 
 // ============================================================================
 // KEYBOARD RING BUFFER
 // ============================================================================
 
-#define KEYBOARD_BUFFER_SIZE 256
+// Lock-free SPSC: пишет только IRQ 1 (BSP), читает только Hardware deck.
+// В ring - сырые scancodes, перевод в ASCII (и состояние модификаторов) -
+// на стороне читателя, IRQ handler - одна запись и один store
+#define KEYBOARD_BUFFER_SIZE 256               // Степень 2
+#define KEYBOARD_BUFFER_MASK (KEYBOARD_BUFFER_SIZE - 1)
 
-static char keyboard_buffer[KEYBOARD_BUFFER_SIZE];
-static volatile uint32_t kb_head = 0;  // Write position
-static volatile uint32_t kb_tail = 0;  // Read position
-static spinlock_t kb_lock = {0};       // Spinlock
+static volatile uint8_t keyboard_buffer[KEYBOARD_BUFFER_SIZE];
+static volatile uint32_t kb_head = 0;  // Write position (IRQ)
+static volatile uint32_t kb_tail = 0;  // Read position (Hardware deck)
+static volatile uint64_t kb_dropped = 0;  // Scancodes при полном ring
 
 static keyboard_state_t kb_state = {0};
 
@@ -53,6 +58,7 @@ static const char scancode_to_ascii_shifted[] = {
 void keyboard_init(void) {
     kb_head = 0;
     kb_tail = 0;
+    kb_dropped = 0;
     kb_state.shift_pressed = 0;
     kb_state.ctrl_pressed = 0;
     kb_state.alt_pressed = 0;
@@ -63,10 +69,25 @@ void keyboard_init(void) {
 }
 
 // ============================================================================
-// SCANCODE PROCESSING (called from IRQ handler)
+// SCANCODE PROCESSING
 // ============================================================================
 
-void keyboard_handle_scancode(uint8_t scancode) {
+// IRQ 1: только в ring
+int keyboard_handle_scancode(uint8_t scancode) {
+    uint32_t head = kb_head;
+    if (head - kb_tail >= KEYBOARD_BUFFER_SIZE) {
+        kb_dropped++;
+        return 0;
+    }
+
+    keyboard_buffer[head & KEYBOARD_BUFFER_MASK] = scancode;
+    COMPILER_BARRIER();  // Байт виден раньше head (x86 TSO)
+    kb_head = head + 1;
+    return 1;
+}
+
+// Читатель: scancode -> ASCII, 0 = модификатор / отпускание / без символа
+static char keyboard_translate(uint8_t scancode) {
     // Handle key release (bit 7 set)
     uint8_t is_release = scancode & 0x80;
     uint8_t key = scancode & 0x7F;
@@ -74,23 +95,23 @@ void keyboard_handle_scancode(uint8_t scancode) {
     // Handle modifier keys
     if (key == 0x2A || key == 0x36) {  // Left/Right Shift
         kb_state.shift_pressed = !is_release;
-        return;
+        return 0;
     }
     if (key == 0x1D) {  // Ctrl
         kb_state.ctrl_pressed = !is_release;
-        return;
+        return 0;
     }
     if (key == 0x38) {  // Alt
         kb_state.alt_pressed = !is_release;
-        return;
+        return 0;
     }
     if (key == 0x3A && !is_release) {  // Caps Lock (toggle on press)
         kb_state.caps_lock = !kb_state.caps_lock;
-        return;
+        return 0;
     }
 
     // Ignore key releases for regular keys
-    if (is_release) return;
+    if (is_release) return 0;
 
     // Convert scancode to ASCII
     char ascii = 0;
@@ -105,17 +126,7 @@ void keyboard_handle_scancode(uint8_t scancode) {
             }
         }
     }
-
-    // Add to ring buffer if valid ASCII
-    if (ascii != 0) {
-        spin_lock(&kb_lock);
-        uint32_t next_head = (kb_head + 1) % KEYBOARD_BUFFER_SIZE;
-        if (next_head != kb_tail) {  // Buffer not full
-            keyboard_buffer[kb_head] = ascii;
-            kb_head = next_head;
-        }
-        spin_unlock(&kb_lock);
-    }
+    return ascii;
 }
 
 // ============================================================================
@@ -127,27 +138,31 @@ int keyboard_has_input(void) {
 }
 
 char keyboard_getchar(void) {
-    if (kb_head == kb_tail) {
-        return 0;  // No input
+    while (kb_tail != kb_head) {
+        COMPILER_BARRIER();  // head прочитан раньше байта
+        uint8_t scancode = keyboard_buffer[kb_tail & KEYBOARD_BUFFER_MASK];
+        kb_tail++;
+
+        char c = keyboard_translate(scancode);
+        if (c) {
+            return c;
+        }
     }
-
-    spin_lock(&kb_lock);
-    char c = keyboard_buffer[kb_tail];
-    kb_tail = (kb_tail + 1) % KEYBOARD_BUFFER_SIZE;
-    spin_unlock(&kb_lock);
-
-    return c;
+    return 0;  // No input
 }
 
 char keyboard_getchar_blocking(void) {
-    while (!keyboard_has_input()) {
+    char c;
+    while ((c = keyboard_getchar()) == 0) {
         asm("hlt");  // Wait for interrupt
     }
-    return keyboard_getchar();
+    return c;
 }
 
 void keyboard_flush(void) {
-    spin_lock(&kb_lock);
-    kb_head = kb_tail = 0;
-    spin_unlock(&kb_lock);
+    kb_tail = kb_head;
+}
+
+uint64_t keyboard_dropped(void) {
+    return kb_dropped;
 }
@@ -21,13 +21,15 @@ typedef struct {
 // Initialization
 void keyboard_init(void);
 
-// IRQ handler (called from interrupt context)
-void keyboard_handle_scancode(uint8_t scancode);
+// IRQ handler (called from interrupt context): scancode в lock-free ring.
+// 0 = ring полон, scancode потерян
+int keyboard_handle_scancode(uint8_t scancode);
 
-// Input API
-int keyboard_has_input(void);          // Returns 1 if input available
+// Input API - один читатель (Hardware deck, console input)
+int keyboard_has_input(void);          // Returns 1 if scancodes pending
 char keyboard_getchar(void);           // Non-blocking read (returns 0 if no input)
-char keyboard_getchar_blocking(void);  // Blocking read (waits for input)
+char keyboard_getchar_blocking(void);  // Blocking read (waits for input, нужен IF=1)
 void keyboard_flush(void);             // Clear input buffer
+uint64_t keyboard_dropped(void);       // Scancodes, потерянные при полном ring
 
 #endif // KEYBOARD_H
\ No newline at end of file
@@ -0,0 +1,651 @@
+#include "virtio_net.h"
+#include "klib.h"
+#include "io.h"  // mmio_read*/mmio_write*, pause
+#include "pmm.h"
+#include "vmm.h"  // vmm_map_mmio, vmm_virt_to_phys_direct
+#include "pic.h"
+#include "pci.h"
+#include "atomics.h"
+
+// ============================================================================
+// VIRTQUEUE STRUCTURES
+// ============================================================================
+
+typedef struct __attribute__((packed)) {
+    uint16_t flags;                     // VIRTQ_AVAIL_F_NO_INTERRUPT
+    volatile uint16_t idx;
+    uint16_t ring[VIRTIO_NET_QUEUE_SIZE];
+    volatile uint16_t used_event;       // EVENT_IDX не согласуем - не используется
+} VirtioNetAvail;
+
+typedef struct __attribute__((packed)) {
+    volatile uint16_t flags;            // VIRTQ_USED_F_NO_NOTIFY
+    volatile uint16_t idx;
+    volatile VirtqUsedElem ring[VIRTIO_NET_QUEUE_SIZE];
+    volatile uint16_t avail_event;
+} VirtioNetUsed;
+
+// Очередь в одной странице: desc (16B align), avail, used (4B align)
+#define VIRTIO_NET_AVAIL_OFFSET 1024
+#define VIRTIO_NET_USED_OFFSET  2048
+
+_Static_assert(VIRTIO_NET_QUEUE_SIZE * sizeof(VirtqDesc) <= VIRTIO_NET_AVAIL_OFFSET,
+               "Descriptor table overlaps avail ring");
+_Static_assert(VIRTIO_NET_USED_OFFSET + sizeof(VirtioNetUsed) <= 4096, "Virtqueue must fit in one page");
+_Static_assert(VIRTIO_NET_TX_SLOTS <= 32, "TX slots are tracked in a 32-bit mask");
+
+// struct virtio_net_hdr (VERSION_1: num_buffers всегда есть)
+typedef struct __attribute__((packed)) {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t num_buffers;
+} VirtioNetHeader;
+
+// RX страница: header пишет устройство, кадр - в buffer.data
+typedef struct {
+    VirtioNetHeader header;
+    uint16_t index;                     // Номер буфера (descriptors 2*index, 2*index+1)
+    uint8_t reserved[64 - sizeof(VirtioNetHeader) - sizeof(uint16_t)];
+    ResultBuffer buffer;
+} VirtioNetRxPage;
+
+#define VIRTIO_NET_RX_CAPACITY  (4096 - sizeof(VirtioNetRxPage))
+
+// TX страница слота: header, с VIRTIO_NET_TX_FRAME_OFFSET - копия кадра
+#define VIRTIO_NET_TX_FRAME_OFFSET 64
+
+_Static_assert(VIRTIO_NET_RX_CAPACITY >= VIRTIO_NET_FRAME_MAX, "RX page too small for a frame");
+_Static_assert(VIRTIO_NET_TX_FRAME_OFFSET + VIRTIO_NET_FRAME_MAX <= 4096, "TX page too small for a frame");
+
+typedef struct {
+    uint8_t* page;
+    VirtqDesc* desc;
+    VirtioNetAvail* avail;
+    VirtioNetUsed* used;
+    uintptr_t notify;
+    uint16_t index;                     // Номер очереди (для notify)
+    uint16_t avail_idx;                 // Наша копия avail->idx
+    uint16_t last_used;                 // Следующий used элемент для разбора
+} VirtioNetQueue;
+
+typedef struct {
+    uintptr_t common;                   // Common configuration (MMIO)
+    uintptr_t notify_base;
+    uint32_t notify_mult;
+    uintptr_t isr;                      // Чтение снимает INTx
+    uintptr_t config;                   // virtio_net_config
+    uint8_t has_status;
+    uint8_t mac[VIRTIO_NET_MAC_LEN];
+    VirtioNetQueue rx;
+    VirtioNetQueue tx;
+    VirtioNetRxPage* rx_pages[VIRTIO_NET_RX_BUFFERS];
+    uint8_t* tx_pages[VIRTIO_NET_TX_SLOTS];
+    ResultBuffer* tx_ref[VIRTIO_NET_TX_SLOTS];  // Кадр по ссылке, release после завершения
+    uint32_t tx_free;                   // Свободные TX слоты (битовая маска)
+} VirtioNet;
+
+static uint8_t virtio_net_irq_line = 0xFF;
+static volatile uint8_t virtio_net_ready = 0;
+static VirtioNet virtio_nic;
+static spinlock_t virtio_net_lock;
+
+static struct {
+    volatile uint64_t rx_packets;
+    volatile uint64_t rx_bytes;
+    volatile uint64_t rx_dropped;       // Пустые / битые used элементы
+    volatile uint64_t rx_recycled;
+    volatile uint64_t tx_packets;
+    volatile uint64_t tx_bytes;
+    volatile uint64_t tx_zero_copy;     // Кадр ушёл по ссылке
+    volatile uint64_t tx_completed;
+    volatile uint64_t tx_full;
+    volatile uint64_t irqs;
+    volatile uint64_t kicks;
+    volatile uint64_t kicks_suppressed;
+} virtio_net_stats;
+
+// ============================================================================
+// REGISTER ACCESS
+// ============================================================================
+
+static inline uint8_t virtio_net_common_read8(uint32_t reg) {
+    return mmio_read8(virtio_nic.common + reg);
+}
+
+static inline void virtio_net_common_write8(uint32_t reg, uint8_t value) {
+    mmio_write8(virtio_nic.common + reg, value);
+}
+
+static inline uint16_t virtio_net_common_read16(uint32_t reg) {
+    return mmio_read16(virtio_nic.common + reg);
+}
+
+static inline void virtio_net_common_write16(uint32_t reg, uint16_t value) {
+    mmio_write16(virtio_nic.common + reg, value);
+}
+
+static inline uint32_t virtio_net_common_read32(uint32_t reg) {
+    return mmio_read32(virtio_nic.common + reg);
+}
+
+static inline void virtio_net_common_write32(uint32_t reg, uint32_t value) {
+    mmio_write32(virtio_nic.common + reg, value);
+}
+
+static inline void virtio_net_common_write64(uint32_t reg, uint64_t value) {
+    virtio_net_common_write32(reg, (uint32_t)value);
+    virtio_net_common_write32(reg + 4, (uint32_t)(value >> 32));
+}
+
+static inline uint64_t virtio_net_phys(const void* addr) {
+    uint64_t phys = vmm_virt_to_phys_direct((void*)addr);
+    if (phys == 0) {
+        phys = vmm_virt_to_phys(vmm_get_kernel_context(), (uintptr_t)addr);
+    }
+    return phys;
+}
+
+// ============================================================================
+// DEVICE SETUP
+// ============================================================================
+
+// Vendor-specific capabilities -> MMIO окна (как у virtio-blk)
+static int virtio_net_map_caps(const PciAddress* pci) {
+    uint8_t cap = 0;
+    while ((cap = pci_next_capability(pci, PCI_CAP_ID_VENDOR, cap)) != 0) {
+        uint8_t type = (pci_config_read(pci->bus, pci->dev, pci->func, cap) >> 24) & 0xFF;
+        uint8_t bar = pci_config_read(pci->bus, pci->dev, pci->func, cap + VIRTIO_CAP_BAR) & 0xFF;
+        uint32_t offset = pci_config_read(pci->bus, pci->dev, pci->func, cap + VIRTIO_CAP_OFFSET);
+        uint32_t length = pci_config_read(pci->bus, pci->dev, pci->func, cap + VIRTIO_CAP_LENGTH);
+
+        uintptr_t* target;
+        switch (type) {
+            case VIRTIO_PCI_CAP_COMMON: target = &virtio_nic.common; break;
+            case VIRTIO_PCI_CAP_NOTIFY: target = &virtio_nic.notify_base; break;
+            case VIRTIO_PCI_CAP_ISR:    target = &virtio_nic.isr; break;
+            case VIRTIO_PCI_CAP_DEVICE: target = &virtio_nic.config; break;
+            default: continue;
+        }
+        if (*target || bar > 5 || length == 0) {
+            continue;
+        }
+
+        uint64_t phys = pci_bar_address(pci, bar);
+        if (phys == 0) {
+            continue;
+        }
+
+        void* mapped = vmm_map_mmio(phys + offset, length);
+        if (!mapped) {
+            kprintf("[VIRTIO-NET] %[E]ERROR: Failed to map cfg type %u (BAR%u+0x%x)%[D]\n", type, bar, offset);
+            return -1;
+        }
+        *target = (uintptr_t)mapped;
+
+        if (type == VIRTIO_PCI_CAP_NOTIFY) {
+            virtio_nic.notify_mult = pci_config_read(pci->bus, pci->dev, pci->func,
+                                                     cap + VIRTIO_CAP_NOTIFY_MULT);
+        }
+    }
+
+    return (virtio_nic.common && virtio_nic.notify_base && virtio_nic.isr && virtio_nic.config) ? 0 : -1;
+}
+
+static void virtio_net_fail(const char* reason) {
+    virtio_net_common_write8(VIRTIO_COMMON_STATUS,
+                             virtio_net_common_read8(VIRTIO_COMMON_STATUS) | VIRTIO_STATUS_FAILED);
+    kprintf("[VIRTIO-NET] %[E]ERROR: %s%[D]\n", reason);
+}
+
+// Кольцо очереди q на её странице. Адреса - устройству, включение - сразу
+static int virtio_net_setup_queue(VirtioNetQueue* q, uint16_t index) {
+    virtio_net_common_write16(VIRTIO_COMMON_Q_SELECT, index);
+    if (virtio_net_common_read16(VIRTIO_COMMON_Q_SIZE) < VIRTIO_NET_QUEUE_SIZE) {
+        virtio_net_fail(index == VIRTIO_NET_RXQ ? "receiveq too small" : "transmitq too small");
+        return -1;
+    }
+    virtio_net_common_write16(VIRTIO_COMMON_Q_SIZE, VIRTIO_NET_QUEUE_SIZE);
+
+    q->desc = (VirtqDesc*)q->page;
+    q->avail = (VirtioNetAvail*)(q->page + VIRTIO_NET_AVAIL_OFFSET);
+    q->used = (VirtioNetUsed*)(q->page + VIRTIO_NET_USED_OFFSET);
+    q->index = index;
+
+    virtio_net_common_write64(VIRTIO_COMMON_Q_DESC, virtio_net_phys(q->desc));
+    virtio_net_common_write64(VIRTIO_COMMON_Q_AVAIL, virtio_net_phys(q->avail));
+    virtio_net_common_write64(VIRTIO_COMMON_Q_USED, virtio_net_phys(q->used));
+    virtio_net_common_write16(VIRTIO_COMMON_Q_MSIX, VIRTIO_MSI_NO_VECTOR);
+    virtio_net_common_write16(VIRTIO_COMMON_Q_ENABLE, 1);
+
+    uint16_t notify_off = virtio_net_common_read16(VIRTIO_COMMON_Q_NOFF);
+    q->notify = virtio_nic.notify_base + (uintptr_t)notify_off * virtio_nic.notify_mult;
+    return 0;
+}
+
+// Registered буферы: descriptors заполняются один раз. RX - все буферы
+// сразу в avail ring (устройство увидит после DRIVER_OK + kick)
+static void virtio_net_register_buffers(void) {
+    for (uint32_t i = 0; i < VIRTIO_NET_RX_BUFFERS; i++) {
+        VirtioNetRxPage* page = virtio_nic.rx_pages[i];
+        VirtqDesc* header = &virtio_nic.rx.desc[2 * i];
+        VirtqDesc* frame = &virtio_nic.rx.desc[2 * i + 1];
+
+        page->index = (uint16_t)i;
+        header->addr = virtio_net_phys(&page->header);
+        header->len = sizeof(VirtioNetHeader);
+        header->flags = VIRTQ_DESC_F_WRITE | VIRTQ_DESC_F_NEXT;
+        header->next = (uint16_t)(2 * i + 1);
+        frame->addr = virtio_net_phys(page->buffer.data);
+        frame->len = VIRTIO_NET_RX_CAPACITY;
+        frame->flags = VIRTQ_DESC_F_WRITE;
+        frame->next = 0;
+
+        virtio_nic.rx.avail->ring[i] = (uint16_t)(2 * i);
+    }
+    virtio_nic.rx.avail_idx = VIRTIO_NET_RX_BUFFERS;
+    virtio_nic.rx.avail->idx = VIRTIO_NET_RX_BUFFERS;
+
+    // Header TX всегда нулевой: без checksum offload и GSO
+    for (uint32_t slot = 0; slot < VIRTIO_NET_TX_SLOTS; slot++) {
+        VirtqDesc* header = &virtio_nic.tx.desc[2 * slot];
+        header->addr = virtio_net_phys(virtio_nic.tx_pages[slot]);
+        header->len = sizeof(VirtioNetHeader);
+        header->flags = VIRTQ_DESC_F_NEXT;
+        header->next = (uint16_t)(2 * slot + 1);
+    }
+    virtio_nic.tx_free = VIRTIO_NET_TX_SLOTS == 32 ? 0xFFFFFFFFu : (1u << VIRTIO_NET_TX_SLOTS) - 1;
+
+    // IRQ: TX никогда (разбираем сами), RX - после virtio_net_enable_irq()
+    virtio_nic.rx.avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+    virtio_nic.tx.avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
+
+static int virtio_net_setup(void) {
+    virtio_net_common_write8(VIRTIO_COMMON_STATUS, 0);
+    for (int timeout = 1000000; virtio_net_common_read8(VIRTIO_COMMON_STATUS) != 0; timeout--) {
+        if (timeout == 0) {
+            kprintf("[VIRTIO-NET] %[E]ERROR: Device reset timeout%[D]\n");
+            return -1;
+        }
+        pause();
+    }
+    virtio_net_common_write8(VIRTIO_COMMON_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    virtio_net_common_write32(VIRTIO_COMMON_DFSELECT, 0);
+    uint64_t offered = virtio_net_common_read32(VIRTIO_COMMON_DF);
+    virtio_net_common_write32(VIRTIO_COMMON_DFSELECT, 1);
+    offered |= (uint64_t)virtio_net_common_read32(VIRTIO_COMMON_DF) << 32;
+
+    // Без offload'ов: кадр = один буфер, header нулевой
+    uint64_t required = 1ULL << VIRTIO_F_VERSION_1;
+    if (!(offered & required)) {
+        virtio_net_fail("Device lacks VERSION_1");
+        return -1;
+    }
+    uint64_t features = required | (offered & ((1ULL << VIRTIO_NET_F_MAC) | (1ULL << VIRTIO_NET_F_STATUS)));
+
+    virtio_net_common_write32(VIRTIO_COMMON_GFSELECT, 0);
+    virtio_net_common_write32(VIRTIO_COMMON_GF, (uint32_t)features);
+    virtio_net_common_write32(VIRTIO_COMMON_GFSELECT, 1);
+    virtio_net_common_write32(VIRTIO_COMMON_GF, (uint32_t)(features >> 32));
+
+    virtio_net_common_write8(VIRTIO_COMMON_STATUS,
+                             virtio_net_common_read8(VIRTIO_COMMON_STATUS) | VIRTIO_STATUS_FEATURES_OK);
+    if (!(virtio_net_common_read8(VIRTIO_COMMON_STATUS) & VIRTIO_STATUS_FEATURES_OK)) {
+        virtio_net_fail("Features rejected");
+        return -1;
+    }
+    virtio_nic.has_status = (features >> VIRTIO_NET_F_STATUS) & 1;
+
+    // MAC: из config, иначе locally administered
+    static const uint8_t fallback_mac[VIRTIO_NET_MAC_LEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    uint8_t generation;
+    do {
+        generation = virtio_net_common_read8(VIRTIO_COMMON_CFGGEN);
+        for (int i = 0; i < VIRTIO_NET_MAC_LEN; i++) {
+            virtio_nic.mac[i] = (features >> VIRTIO_NET_F_MAC) & 1
+                                    ? mmio_read8(virtio_nic.config + VIRTIO_NET_CFG_MAC + i)
+                                    : fallback_mac[i];
+        }
+    } while (generation != virtio_net_common_read8(VIRTIO_COMMON_CFGGEN));
+
+    memset(virtio_nic.rx.page, 0, 4096);
+    memset(virtio_nic.tx.page, 0, 4096);
+    if (virtio_net_setup_queue(&virtio_nic.rx, VIRTIO_NET_RXQ) != 0 ||
+        virtio_net_setup_queue(&virtio_nic.tx, VIRTIO_NET_TXQ) != 0) {
+        return -1;
+    }
+    virtio_net_register_buffers();
+
+    virtio_net_common_write8(VIRTIO_COMMON_STATUS,
+                             virtio_net_common_read8(VIRTIO_COMMON_STATUS) | VIRTIO_STATUS_DRIVER_OK);
+    return 0;
+}
+
+// ============================================================================
+// QUEUES (virtio_net_lock)
+// ============================================================================
+
+// Опубликовать avail idx, kick - если устройство не просило тишины
+static void virtio_net_kick(VirtioNetQueue* q) {
+    COMPILER_BARRIER();  // Descriptors и ring записаны до idx
+    q->avail->idx = q->avail_idx;
+    MEMORY_BARRIER();    // idx виден устройству до чтения used->flags
+
+    if (!(q->used->flags & VIRTQ_USED_F_NO_NOTIFY)) {
+        mmio_write16(q->notify, q->index);
+        virtio_net_stats.kicks++;
+    } else {
+        virtio_net_stats.kicks_suppressed++;
+    }
+}
+
+static void virtio_net_rx_post(uint16_t index) {
+    virtio_nic.rx.avail->ring[virtio_nic.rx.avail_idx % VIRTIO_NET_QUEUE_SIZE] = (uint16_t)(2 * index);
+    virtio_nic.rx.avail_idx++;
+}
+
+// Последний держатель кадра отпустил его - страница снова в receiveq
+static void virtio_net_rx_recycle(ResultBuffer* rb) {
+    VirtioNetRxPage* page = (VirtioNetRxPage*)((uint8_t*)rb - __builtin_offsetof(VirtioNetRxPage, buffer));
+
+    spin_lock(&virtio_net_lock);
+    virtio_net_rx_post(page->index);
+    virtio_net_kick(&virtio_nic.rx);
+    spin_unlock(&virtio_net_lock);
+
+    atomic_increment_u64(&virtio_net_stats.rx_recycled);
+}
+
+// Завершённые отправки: слоты свободны, ссылки - в released (release вне
+// lock: последний release RX кадра берёт virtio_net_lock в recycle).
+// Возвращает завершённых слотов
+static uint32_t virtio_net_tx_collect(ResultBuffer** released, uint32_t* released_count) {
+    uint32_t completed = 0;
+    *released_count = 0;
+
+    while (virtio_nic.tx.last_used != virtio_nic.tx.used->idx) {
+        COMPILER_BARRIER();  // Элемент читаем после idx
+        uint32_t id = virtio_nic.tx.used->ring[virtio_nic.tx.last_used % VIRTIO_NET_QUEUE_SIZE].id;
+        virtio_nic.tx.last_used++;
+
+        uint32_t slot = id / 2;
+        // DEFENSIVE: id не из выданных - игнорируем
+        if ((id & 1) || slot >= VIRTIO_NET_TX_SLOTS || (virtio_nic.tx_free & (1u << slot))) {
+            kprintf("[VIRTIO-NET] %[W]Spurious TX used id %u%[D]\n", id);
+            continue;
+        }
+
+        if (virtio_nic.tx_ref[slot]) {
+            released[(*released_count)++] = virtio_nic.tx_ref[slot];
+            virtio_nic.tx_ref[slot] = NULL;
+        }
+        virtio_nic.tx_free |= 1u << slot;
+        virtio_net_stats.tx_completed++;
+        completed++;
+    }
+
+    return completed;
+}
+
+static void virtio_net_release_all(ResultBuffer** released, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        result_buffer_release(released[i]);
+    }
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+int virtio_net_available(void) {
+    return virtio_net_ready;
+}
+
+void virtio_net_get_mac(uint8_t mac[VIRTIO_NET_MAC_LEN]) {
+    memcpy(mac, virtio_nic.mac, VIRTIO_NET_MAC_LEN);
+}
+
+int virtio_net_link_up(void) {
+    if (!virtio_net_ready) {
+        return 0;
+    }
+    if (!virtio_nic.has_status) {
+        return 1;
+    }
+    return (mmio_read16(virtio_nic.config + VIRTIO_NET_CFG_STATUS) & VIRTIO_NET_S_LINK_UP) != 0;
+}
+
+int virtio_net_send(const uint8_t* frame, uint32_t size, ResultBuffer* ref) {
+    if (!virtio_net_ready || !frame || size < VIRTIO_NET_FRAME_MIN || size > VIRTIO_NET_FRAME_MAX) {
+        return -1;
+    }
+
+    ResultBuffer* released[VIRTIO_NET_TX_SLOTS];
+
+    uint32_t count;
+
+    spin_lock(&virtio_net_lock);
+    virtio_net_tx_collect(released, &count);
+
+    if (!virtio_nic.tx_free) {
+        spin_unlock(&virtio_net_lock);
+        virtio_net_release_all(released, count);
+        atomic_increment_u64(&virtio_net_stats.tx_full);
+        return VIRTIO_NET_TX_FULL;
+    }
+
+    uint32_t slot = (uint32_t)__builtin_ctz(virtio_nic.tx_free);
+    virtio_nic.tx_free &= ~(1u << slot);
+    VirtqDesc* data = &virtio_nic.tx.desc[2 * slot + 1];
+
+    // По ссылке - только память identity mapping (физически смежная)
+    uint64_t phys = ref ? vmm_virt_to_phys_direct((void*)frame) : 0;
+    if (phys) {
+        result_buffer_retain(ref);
+        virtio_nic.tx_ref[slot] = ref;
+        virtio_net_stats.tx_zero_copy++;
+    } else {
+        uint8_t* copy = virtio_nic.tx_pages[slot] + VIRTIO_NET_TX_FRAME_OFFSET;
+        memcpy(copy, frame, size);
+        phys = virtio_net_phys(copy);
+    }
+    data->addr = phys;
+    data->len = size;
+    data->flags = 0;
+
+    virtio_nic.tx.avail->ring[virtio_nic.tx.avail_idx % VIRTIO_NET_QUEUE_SIZE] = (uint16_t)(2 * slot);
+    virtio_nic.tx.avail_idx++;
+    virtio_net_kick(&virtio_nic.tx);
+
+    virtio_net_stats.tx_packets++;
+    virtio_net_stats.tx_bytes += size;
+    spin_unlock(&virtio_net_lock);
+
+    virtio_net_release_all(released, count);
+    return 0;
+}
+
+ResultBuffer* virtio_net_receive(void) {
+    // Без lock: пусто - частый случай (idle проход Network deck)
+    if (!virtio_net_ready || virtio_nic.rx.last_used == virtio_nic.rx.used->idx) {
+        return NULL;
+    }
+
+    ResultBuffer* rb = NULL;
+
+    spin_lock(&virtio_net_lock);
+    while (!rb && virtio_nic.rx.last_used != virtio_nic.rx.used->idx) {
+        COMPILER_BARRIER();  // Элемент читаем после idx
+        volatile VirtqUsedElem* elem = &virtio_nic.rx.used->ring[virtio_nic.rx.last_used % VIRTIO_NET_QUEUE_SIZE];
+        uint32_t id = elem->id;
+        uint32_t len = elem->len;
+        virtio_nic.rx.last_used++;
+
+        uint32_t index = id / 2;
+        if ((id & 1) || index >= VIRTIO_NET_RX_BUFFERS) {
+            kprintf("[VIRTIO-NET] %[W]Spurious RX used id %u%[D]\n", id);
+            virtio_net_stats.rx_dropped++;
+            continue;
+        }
+
+        // Короче Ethernet header - страницу сразу обратно
+        if (len < sizeof(VirtioNetHeader) + VIRTIO_NET_FRAME_MIN) {
+            virtio_net_stats.rx_dropped++;
+            virtio_net_rx_post((uint16_t)index);
+            virtio_net_kick(&virtio_nic.rx);
+            continue;
+        }
+
+        VirtioNetRxPage* page = virtio_nic.rx_pages[index];
+        result_buffer_init(&page->buffer, VIRTIO_NET_RX_CAPACITY, virtio_net_rx_recycle);
+        page->buffer.size = len - sizeof(VirtioNetHeader);
+        rb = &page->buffer;
+
+        virtio_net_stats.rx_packets++;
+        virtio_net_stats.rx_bytes += rb->size;
+    }
+    spin_unlock(&virtio_net_lock);
+
+    return rb;
+}
+
+uint32_t virtio_net_rx_pending(void) {
+    if (!virtio_net_ready) {
+        return 0;
+    }
+    return (uint16_t)(virtio_nic.rx.used->idx - virtio_nic.rx.last_used);
+}
+
+uint32_t virtio_net_tx_reap(void) {
+    if (!virtio_net_ready || virtio_nic.tx.last_used == virtio_nic.tx.used->idx) {
+        return 0;
+    }
+
+    ResultBuffer* released[VIRTIO_NET_TX_SLOTS];
+    uint32_t count;
+
+    spin_lock(&virtio_net_lock);
+    uint32_t completed = virtio_net_tx_collect(released, &count);
+    spin_unlock(&virtio_net_lock);
+
+    virtio_net_release_all(released, count);
+    return completed;
+}
+
+int virtio_net_irq_handler(uint8_t irq) {
+    if (!virtio_net_ready || irq != virtio_net_irq_line) {
+        return 0;
+    }
+
+    // Чтение ISR снимает INTx. 0 - линию делит другое устройство
+    uint8_t isr = mmio_read8(virtio_nic.isr);
+    if (!isr) {
+        return 0;
+    }
+
+    atomic_increment_u64(&virtio_net_stats.irqs);
+    return 1;
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+int virtio_net_init(void) {
+    PciAddress pci;
+    if (!pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_PCI_DEVICE_NET, &pci) &&
+        !pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_PCI_DEVICE_NET_TRANS, &pci)) {
+        kprintf("[VIRTIO-NET] No virtio-net device\n");
+        return -1;
+    }
+
+    pci_enable(&pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+    if (virtio_net_map_caps(&pci) != 0) {
+        kprintf("[VIRTIO-NET] %[W]virtio-net %02x:%02x.%x has no modern interface, skipping%[D]\n",
+                pci.bus, pci.dev, pci.func);
+        memset(&virtio_nic, 0, sizeof(VirtioNet));
+        return -1;
+    }
+    virtio_net_irq_line = (uint8_t)(pci_config_read(pci.bus, pci.dev, pci.func, PCI_REG_INTERRUPT) & 0xFF);
+
+    virtio_nic.rx.page = (uint8_t*)pmm_alloc_zero(1);
+    virtio_nic.tx.page = (uint8_t*)pmm_alloc_zero(1);
+    if (!virtio_nic.rx.page || !virtio_nic.tx.page) {
+        kprintf("[VIRTIO-NET] %[E]ERROR: Out of memory for virtqueues%[D]\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < VIRTIO_NET_RX_BUFFERS; i++) {
+        virtio_nic.rx_pages[i] = (VirtioNetRxPage*)pmm_alloc_zero(1);
+        if (!virtio_nic.rx_pages[i]) {
+            kprintf("[VIRTIO-NET] %[E]ERROR: Out of memory for RX buffers%[D]\n");
+            return -1;
+        }
+    }
+    for (uint32_t slot = 0; slot < VIRTIO_NET_TX_SLOTS; slot++) {
+        virtio_nic.tx_pages[slot] = (uint8_t*)pmm_alloc_zero(1);
+        if (!virtio_nic.tx_pages[slot]) {
+            kprintf("[VIRTIO-NET] %[E]ERROR: Out of memory for TX slots%[D]\n");
+            return -1;
+        }
+    }
+
+    spinlock_init(&virtio_net_lock);
+    if (virtio_net_setup() != 0) {
+        return -1;
+    }
+    virtio_net_ready = 1;
+
+    // RX буферы устройству - только после DRIVER_OK
+    spin_lock(&virtio_net_lock);
+    virtio_net_kick(&virtio_nic.rx);
+    spin_unlock(&virtio_net_lock);
+
+    kprintf("[VIRTIO-NET] virtio-net %02x:%02x.%x: MAC %02x:%02x:%02x:%02x:%02x:%02x, link %s, "
+            "%u RX buffers, %u TX slots, irq=%u\n",
+            pci.bus, pci.dev, pci.func,
+            virtio_nic.mac[0], virtio_nic.mac[1], virtio_nic.mac[2],
+            virtio_nic.mac[3], virtio_nic.mac[4], virtio_nic.mac[5],
+            virtio_net_link_up() ? "up" : "down",
+            VIRTIO_NET_RX_BUFFERS, VIRTIO_NET_TX_SLOTS, virtio_net_irq_line);
+    return 0;
+}
+
+void virtio_net_enable_irq(void) {
+    if (!virtio_net_ready || virtio_net_irq_line >= 16) {
+        return;
+    }
+
+    virtio_nic.rx.avail->flags = 0;  // IRQ на каждый принятый кадр
+    MEMORY_BARRIER();
+    pic_enable_irq(virtio_net_irq_line);
+
+    kprintf("[VIRTIO-NET] IRQ%u enabled: receive\n", virtio_net_irq_line);
+}
+
+void virtio_net_print_stats(void) {
+    if (!virtio_net_ready) {
+        return;
+    }
+
+    kprintf("  virtio-net:      rx=%lu (%lu bytes) dropped=%lu recycled=%lu irqs=%lu\n",
+            atomic_load_u64(&virtio_net_stats.rx_packets),
+            atomic_load_u64(&virtio_net_stats.rx_bytes),
+            atomic_load_u64(&virtio_net_stats.rx_dropped),
+            atomic_load_u64(&virtio_net_stats.rx_recycled),
+            atomic_load_u64(&virtio_net_stats.irqs));
+    kprintf("                   tx=%lu (%lu bytes) zero_copy=%lu completed=%lu full=%lu\n",
+            atomic_load_u64(&virtio_net_stats.tx_packets),
+            atomic_load_u64(&virtio_net_stats.tx_bytes),
+            atomic_load_u64(&virtio_net_stats.tx_zero_copy),
+            atomic_load_u64(&virtio_net_stats.tx_completed),
+            atomic_load_u64(&virtio_net_stats.tx_full));
+    kprintf("                   kicks=%lu suppressed=%lu\n",
+            atomic_load_u64(&virtio_net_stats.kicks),
+            atomic_load_u64(&virtio_net_stats.kicks_suppressed));
+}
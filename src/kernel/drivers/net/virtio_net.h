@@ -0,0 +1,92 @@
+#ifndef VIRTIO_NET_H
+#define VIRTIO_NET_H
+
+#include "ktypes.h"
+#include "virtio_pci.h"
+#include "result_buffer.h"
+
+// ============================================================================
+// virtio-net Driver - modern PCI (virtio 1.0), 1AF4:1041 / 1AF4:1000
+// ============================================================================
+//
+// receiveq (0) и transmitq (1) по VIRTIO_NET_QUEUE_SIZE descriptors. Буферы -
+// страницы, зарегистрированные один раз при init: descriptors на них больше
+// не меняются, в avail ring уходит только номер буфера.
+//
+// RX: страница = [net header][ResultBuffer][кадр]. Устройство пишет header и
+// кадр прямо туда (chain из двух descriptors), так что принятый кадр уже
+// ResultBuffer - Network deck отдаёт его дальше по ссылке. Последний
+// release (recycle) возвращает страницу в receiveq.
+//
+// TX: слот = header + кадр. Кадр из ResultBuffer уходит по ссылке (retain
+// до завершения), остальное копируется в страницу слота. Завершения TX
+// без IRQ - разбираются при следующей отправке или проходе Network deck.
+//
+// IRQ (INTx) только будит Network deck: used ring receiveq разбирает он.
+//
+// ============================================================================
+
+#define VIRTIO_PCI_DEVICE_NET       0x1041  // Modern
+#define VIRTIO_PCI_DEVICE_NET_TRANS 0x1000  // Transitional (modern caps тоже есть)
+
+// Feature bits
+#define VIRTIO_NET_F_MAC            5
+#define VIRTIO_NET_F_STATUS         16
+
+// Device configuration (struct virtio_net_config)
+#define VIRTIO_NET_CFG_MAC          0x00
+#define VIRTIO_NET_CFG_STATUS       0x06
+#define VIRTIO_NET_S_LINK_UP        1
+
+#define VIRTIO_NET_RXQ              0
+#define VIRTIO_NET_TXQ              1
+
+#define VIRTIO_NET_QUEUE_SIZE       64                          // Descriptors в очереди
+#define VIRTIO_NET_RX_BUFFERS       (VIRTIO_NET_QUEUE_SIZE / 2) // Пара descriptors на буфер
+#define VIRTIO_NET_TX_SLOTS         (VIRTIO_NET_QUEUE_SIZE / 2)
+
+#define VIRTIO_NET_MAC_LEN          6
+#define VIRTIO_NET_FRAME_MAX        1514    // Ethernet без FCS (MTU 1500)
+#define VIRTIO_NET_FRAME_MIN        14      // Ethernet header
+
+// virtio_net_send()
+#define VIRTIO_NET_TX_FULL          (-2)
+
+// ============================================================================
+// API
+// ============================================================================
+
+// Найти устройство, поднять очереди. Вызывать после vmm_init.
+// 0 = готово, -1 = нет устройства или оно не подходит
+int virtio_net_init(void);
+
+int virtio_net_available(void);
+
+void virtio_net_get_mac(uint8_t mac[VIRTIO_NET_MAC_LEN]);
+
+// Без VIRTIO_NET_F_STATUS линк считается поднятым
+int virtio_net_link_up(void);
+
+// Кадр в transmitq. ref - ResultBuffer, внутри data которого лежит frame:
+// тогда кадр уходит по ссылке. 0 = отправлен, -1 = нет устройства или
+// размер, VIRTIO_NET_TX_FULL = все слоты в полёте
+int virtio_net_send(const uint8_t* frame, uint32_t size, ResultBuffer* ref);
+
+// Следующий принятый кадр (вызывающий держит ссылку) или NULL
+ResultBuffer* virtio_net_receive(void);
+
+// Кадров ждут в receiveq (без lock)
+uint32_t virtio_net_rx_pending(void);
+
+// Разобрать завершённые отправки. Возвращает освободившихся слотов
+uint32_t virtio_net_tx_reap(void);
+
+// IRQ линии устройства (из irq_handler). 1 = irq наш
+int virtio_net_irq_handler(uint8_t irq);
+
+// Разрешить IRQ приёма (после pic_init)
+void virtio_net_enable_irq(void);
+
+void virtio_net_print_stats(void);
+
+#endif // VIRTIO_NET_H
@@ -0,0 +1,108 @@
+#include "pci.h"
+#include "io.h"  // inl, outl
+
+// ============================================================================
+// CONFIGURATION SPACE
+// ============================================================================
+
+uint32_t pci_config_read(uint32_t bus, uint32_t dev, uint32_t func, uint32_t offset) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000u | (bus << 16) | (dev << 11) | (func << 8) | (offset & 0xFC));
+    return inl(PCI_CONFIG_DATA);
+}
+
+void pci_config_write(uint32_t bus, uint32_t dev, uint32_t func, uint32_t offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000u | (bus << 16) | (dev << 11) | (func << 8) | (offset & 0xFC));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+// ============================================================================
+// DEVICE LOOKUP
+// ============================================================================
+
+// Брутфорс по всем bus/dev/func: вызывается один раз на драйвер при init.
+// Совпадение: (id & id_mask) == id_value и (class & class_mask) == class_value
+static int pci_find(uint32_t id_mask, uint32_t id_value, uint32_t class_mask, uint32_t class_value,
+                    PciAddress* out) {
+    for (uint32_t bus = 0; bus < 256; bus++) {
+        for (uint32_t dev = 0; dev < 32; dev++) {
+            for (uint32_t func = 0; func < 8; func++) {
+                uint32_t id = pci_config_read(bus, dev, func, PCI_REG_ID);
+                if ((id & 0xFFFF) == 0xFFFF) {
+                    if (func == 0) break;
+                    continue;
+                }
+
+                uint32_t class_reg = pci_config_read(bus, dev, func, PCI_REG_CLASS);
+                if ((id & id_mask) == id_value && (class_reg & class_mask) == class_value) {
+                    out->bus = (uint8_t)bus;
+                    out->dev = (uint8_t)dev;
+                    out->func = (uint8_t)func;
+                    out->vendor = (uint16_t)(id & 0xFFFF);
+                    out->device = (uint16_t)(id >> 16);
+                    out->prog_if = (uint8_t)((class_reg >> 8) & 0xFF);
+                    return 1;
+                }
+
+                // Не multi-function устройство - остальные func пусты
+                if (func == 0 && !(pci_config_read(bus, dev, 0, PCI_REG_HEADER) & 0x00800000)) {
+                    break;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int pci_find_class(uint8_t class_code, uint8_t subclass, PciAddress* out) {
+    return pci_find(0, 0, 0xFFFF0000u, ((uint32_t)class_code << 24) | ((uint32_t)subclass << 16), out);
+}
+
+int pci_find_device(uint16_t vendor, uint16_t device, PciAddress* out) {
+    return pci_find(0xFFFFFFFFu, ((uint32_t)device << 16) | vendor, 0, 0, out);
+}
+
+void pci_enable(const PciAddress* address, uint16_t command_bits) {
+    uint32_t cmd = pci_config_read(address->bus, address->dev, address->func, PCI_REG_COMMAND) & 0xFFFF;
+    pci_config_write(address->bus, address->dev, address->func, PCI_REG_COMMAND, cmd | command_bits);
+}
+
+uint64_t pci_bar_address(const PciAddress* address, uint32_t bar) {
+    uint32_t low = pci_config_read(address->bus, address->dev, address->func, PCI_REG_BAR0 + 4 * bar);
+    if (low & PCI_BAR_IO) {
+        return 0;
+    }
+
+    uint64_t phys = low & 0xFFFFFFF0u;
+    if ((low & PCI_BAR_TYPE_MASK) == PCI_BAR_TYPE_64 && bar < 5) {
+        phys |= (uint64_t)pci_config_read(address->bus, address->dev, address->func,
+                                          PCI_REG_BAR0 + 4 * (bar + 1)) << 32;
+    }
+    return phys;
+}
+
+// ============================================================================
+// CAPABILITIES
+// ============================================================================
+
+uint8_t pci_next_capability(const PciAddress* address, uint8_t cap_id, uint8_t offset) {
+    if (offset == 0) {
+        // Status bit 4: список capabilities есть
+        uint32_t status = pci_config_read(address->bus, address->dev, address->func, PCI_REG_COMMAND) >> 16;
+        if (!(status & PCI_STATUS_CAP_LIST)) {
+            return 0;
+        }
+        offset = pci_config_read(address->bus, address->dev, address->func, PCI_REG_CAP_PTR) & 0xFC;
+    } else {
+        offset = (pci_config_read(address->bus, address->dev, address->func, offset) >> 8) & 0xFC;
+    }
+
+    // DEFENSIVE: список не длиннее 48 (256 байт / 4) - против петли
+    for (int guard = 0; offset >= 0x40 && guard < 48; guard++) {
+        uint32_t header = pci_config_read(address->bus, address->dev, address->func, offset);
+        if ((header & 0xFF) == cap_id) {
+            return offset;
+        }
+        offset = (header >> 8) & 0xFC;
+    }
+    return 0;
+}
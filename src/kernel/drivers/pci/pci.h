@@ -0,0 +1,61 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// PCI configuration space (mechanism #1, порты 0xCF8/0xCFC)
+// ============================================================================
+
+#define PCI_CONFIG_ADDRESS      0xCF8
+#define PCI_CONFIG_DATA         0xCFC
+
+// Смещения в configuration space
+#define PCI_REG_ID              0x00    // Vendor (15:0), device (31:16)
+#define PCI_REG_COMMAND         0x04    // Command (15:0), status (31:16, RW1C)
+#define PCI_REG_CLASS           0x08    // Class (31:24), subclass, prog_if, revision
+#define PCI_REG_HEADER          0x0C    // Header type (23:16), bit 23 = multi-function
+#define PCI_REG_BAR0            0x10    // BAR n = PCI_REG_BAR0 + 4 * n
+#define PCI_REG_CAP_PTR         0x34    // Первая capability (7:0)
+#define PCI_REG_INTERRUPT       0x3C    // Interrupt line (7:0), pin (15:8)
+
+#define PCI_COMMAND_IO          0x0001  // I/O space
+#define PCI_COMMAND_MEMORY      0x0002  // Memory space
+#define PCI_COMMAND_MASTER      0x0004  // Bus master
+
+#define PCI_STATUS_CAP_LIST     0x0010  // Есть список capabilities
+
+#define PCI_BAR_IO              0x01    // I/O BAR (иначе memory)
+#define PCI_BAR_TYPE_MASK       0x06
+#define PCI_BAR_TYPE_64         0x04    // 64-bit memory BAR: старшие биты - в BAR n+1
+
+#define PCI_CAP_ID_VENDOR       0x09    // Vendor-specific (virtio)
+
+typedef struct {
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t func;
+    uint16_t vendor;
+    uint16_t device;
+    uint8_t prog_if;
+} PciAddress;
+
+uint32_t pci_config_read(uint32_t bus, uint32_t dev, uint32_t func, uint32_t offset);
+void pci_config_write(uint32_t bus, uint32_t dev, uint32_t func, uint32_t offset, uint32_t value);
+
+// Первая функция с данным class/subclass. 1 = найдена (out заполнен)
+int pci_find_class(uint8_t class_code, uint8_t subclass, PciAddress* out);
+
+// То же по vendor:device
+int pci_find_device(uint16_t vendor, uint16_t device, PciAddress* out);
+
+// Физический адрес memory BAR (64-bit - из пары BAR). 0 = I/O BAR
+uint64_t pci_bar_address(const PciAddress* address, uint32_t bar);
+
+// Следующая capability cap_id после offset (0 - с начала списка). 0 = нет
+uint8_t pci_next_capability(const PciAddress* address, uint8_t cap_id, uint8_t offset);
+
+// Включить биты command register (status не трогаем - RW1C)
+void pci_enable(const PciAddress* address, uint16_t command_bits);
+
+#endif // PCI_H
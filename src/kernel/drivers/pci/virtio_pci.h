@@ -0,0 +1,82 @@
+#ifndef VIRTIO_PCI_H
+#define VIRTIO_PCI_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// virtio 1.0 PCI transport - общее для virtio-blk и virtio-net
+// ============================================================================
+//
+// Только регистры transport'а и split virtqueue. Размеры колец, слоты и
+// feature bits устройства - в драйвере.
+//
+// ============================================================================
+
+#define VIRTIO_PCI_VENDOR           0x1AF4
+
+// Vendor-specific PCI capability: cfg_type и поля
+#define VIRTIO_PCI_CAP_COMMON       1
+#define VIRTIO_PCI_CAP_NOTIFY       2
+#define VIRTIO_PCI_CAP_ISR          3
+#define VIRTIO_PCI_CAP_DEVICE       4
+
+#define VIRTIO_CAP_CFG_TYPE         3       // Байт в capability
+#define VIRTIO_CAP_BAR              4
+#define VIRTIO_CAP_OFFSET           8
+#define VIRTIO_CAP_LENGTH           12
+#define VIRTIO_CAP_NOTIFY_MULT      16      // Только NOTIFY
+
+// Common configuration
+#define VIRTIO_COMMON_DFSELECT      0x00    // Device features (окно 32 бита)
+#define VIRTIO_COMMON_DF            0x04
+#define VIRTIO_COMMON_GFSELECT      0x08    // Driver (guest) features
+#define VIRTIO_COMMON_GF            0x0C
+#define VIRTIO_COMMON_STATUS        0x14
+#define VIRTIO_COMMON_CFGGEN        0x15    // Config generation
+#define VIRTIO_COMMON_Q_SELECT      0x16
+#define VIRTIO_COMMON_Q_SIZE        0x18
+#define VIRTIO_COMMON_Q_MSIX        0x1A
+#define VIRTIO_COMMON_Q_ENABLE      0x1C
+#define VIRTIO_COMMON_Q_NOFF        0x1E    // Notify offset (в multiplier'ах)
+#define VIRTIO_COMMON_Q_DESC        0x20
+#define VIRTIO_COMMON_Q_AVAIL       0x28
+#define VIRTIO_COMMON_Q_USED        0x30
+
+#define VIRTIO_STATUS_ACKNOWLEDGE   0x01
+#define VIRTIO_STATUS_DRIVER        0x02
+#define VIRTIO_STATUS_DRIVER_OK     0x04
+#define VIRTIO_STATUS_FEATURES_OK   0x08
+#define VIRTIO_STATUS_FAILED        0x80
+
+#define VIRTIO_MSI_NO_VECTOR        0xFFFF  // MSI-X не используем - INTx
+#define VIRTIO_ISR_QUEUE            0x01
+
+// Transport feature bits
+#define VIRTIO_RING_F_INDIRECT_DESC 28
+#define VIRTIO_RING_F_EVENT_IDX     29
+#define VIRTIO_F_VERSION_1          32
+
+#define VIRTQ_DESC_F_NEXT           1
+#define VIRTQ_DESC_F_WRITE          2       // Буфер пишет устройство
+#define VIRTQ_DESC_F_INDIRECT       4
+#define VIRTQ_AVAIL_F_NO_INTERRUPT  1       // Без EVENT_IDX
+#define VIRTQ_USED_F_NO_NOTIFY      1
+
+typedef struct __attribute__((packed)) {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;                     // VIRTQ_DESC_F_*
+    uint16_t next;
+} VirtqDesc;
+
+typedef struct __attribute__((packed)) {
+    uint32_t id;                        // Head descriptor
+    uint32_t len;                       // Байт, записанных устройством
+} VirtqUsedElem;
+
+// EVENT_IDX: (new - event - 1) < (new - old) - event попал в [old, new)
+static inline int virtio_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) {
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+#endif // VIRTIO_PCI_H
@@ -1,5 +1,7 @@
 #include "serial.h"
 #include "io.h"
+#include "pic.h"
+#include "klib.h"
 
 // Serial port registers (offsets from base port)
 #define SERIAL_DATA          0  // Data register (read/write)
@@ -11,6 +13,30 @@
 #define SERIAL_MODEM_STATUS  6  // Modem status
 #define SERIAL_SCRATCH       7  // Scratch register
 
+#define SERIAL_IIR           2  // Interrupt identification (read)
+#define SERIAL_IER_THRE      0x02  // Interrupt: THR empty
+#define SERIAL_LSR_THRE      0x20  // Line status: THR (и FIFO) пуст
+
+#define SERIAL_TX_RING_MASK  (SERIAL_TX_RING_SIZE - 1)
+
+// ============================================================================
+// TX STATE
+// ============================================================================
+
+static char serial_tx_ring[SERIAL_TX_RING_SIZE];
+static uint64_t serial_tx_head = 0;             // Следующий байт в FIFO
+static uint64_t serial_tx_tail = 0;             // Следующий свободный
+static volatile uint32_t serial_tx_lock_word = 0;
+static int serial_irq_mode = 0;                 // 0 = синхронный вывод
+static int serial_tx_active = 0;                // THRE interrupt взведён
+
+static struct {
+    uint64_t bytes;             // Ушло через ring
+    uint64_t irqs;
+    uint64_t full_waits;        // Ring полон - писатель выталкивал FIFO сам
+    uint64_t lock_bypass;       // Lock не взят - байт синхронно мимо ring
+} serial_stats;
+
 void serial_init(void) {
     // Disable interrupts
     outb(SERIAL_COM1 + SERIAL_INT_ENABLE, 0x00);
@@ -46,10 +72,10 @@ void serial_init(void) {
 }
 
 static int serial_transmit_empty(void) {
-    return inb(SERIAL_COM1 + SERIAL_LINE_STATUS) & 0x20;
+    return inb(SERIAL_COM1 + SERIAL_LINE_STATUS) & SERIAL_LSR_THRE;
 }
 
-void serial_putchar(char c) {
+static void serial_putchar_sync(char c) {
     // Wait for transmit buffer to be empty
     while (serial_transmit_empty() == 0);
 
@@ -57,6 +83,124 @@ void serial_putchar(char c) {
     outb(SERIAL_COM1 + SERIAL_DATA, c);
 }
 
+// IF=0 + lock. bounded: не дольше SERIAL_TX_LOCK_SPINS (0 = не взят, IF как был)
+static int serial_tx_lock(uint64_t* flags, int bounded) {
+    asm volatile("pushfq; pop %0; cli" : "=r"(*flags) :: "memory");
+
+    for (uint32_t spin = 0; !bounded || spin < SERIAL_TX_LOCK_SPINS; spin++) {
+        if (!__sync_lock_test_and_set(&serial_tx_lock_word, 1)) {
+            return 1;
+        }
+        asm volatile("pause");
+    }
+
+    asm volatile("push %0; popfq" :: "r"(*flags) : "memory", "cc");
+    return 0;
+}
+
+static void serial_tx_unlock(uint64_t flags) {
+    __sync_lock_release(&serial_tx_lock_word);
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+// THR пуст (lock взят): до SERIAL_FIFO_SIZE байт из ring в FIFO
+static void serial_tx_fill(void) {
+    uint32_t n = 0;
+    while (serial_tx_head != serial_tx_tail && n < SERIAL_FIFO_SIZE) {
+        outb(SERIAL_COM1 + SERIAL_DATA, serial_tx_ring[serial_tx_head & SERIAL_TX_RING_MASK]);
+        serial_tx_head++;
+        n++;
+    }
+    serial_stats.bytes += n;
+}
+
+void serial_putchar(char c) {
+    if (!serial_irq_mode) {
+        serial_putchar_sync(c);
+        return;
+    }
+
+    uint64_t flags;
+    if (!serial_tx_lock(&flags, 1)) {
+        serial_stats.lock_bypass++;
+        serial_putchar_sync(c);
+        return;
+    }
+
+    if (serial_tx_tail - serial_tx_head >= SERIAL_TX_RING_SIZE) {
+        while (serial_transmit_empty() == 0) {
+            asm volatile("pause");
+        }
+        serial_tx_fill();
+        serial_stats.full_waits++;
+    }
+
+    serial_tx_ring[serial_tx_tail & SERIAL_TX_RING_MASK] = c;
+    serial_tx_tail++;
+
+    // Простаивал - THRE interrupt придёт сразу (THR уже пуст)
+    if (!serial_tx_active) {
+        serial_tx_active = 1;
+        outb(SERIAL_COM1 + SERIAL_INT_ENABLE, SERIAL_IER_THRE);
+    }
+
+    serial_tx_unlock(flags);
+}
+
+void serial_irq_handler(void) {
+    uint64_t flags;
+    serial_tx_lock(&flags, 0);  // Держат его только с IF=0 - не вечно
+
+    (void)inb(SERIAL_COM1 + SERIAL_IIR);  // Снимает THRE interrupt
+    serial_stats.irqs++;
+
+    if (serial_transmit_empty()) {
+        serial_tx_fill();
+    }
+    if (serial_tx_head == serial_tx_tail) {
+        // Ring пуст - молчим до следующего serial_putchar
+        outb(SERIAL_COM1 + SERIAL_INT_ENABLE, 0x00);
+        serial_tx_active = 0;
+    }
+
+    serial_tx_unlock(flags);
+}
+
+void serial_enable_irq(void) {
+    // OUT2 (MCR bit 3) уже выставлен в serial_init - линия IRQ 4 открыта
+    serial_irq_mode = 1;
+    pic_enable_irq(SERIAL_COM1_IRQ);
+    kprintf("[SERIAL] COM1 TX: %u-byte ring, IRQ %d (16550 FIFO)\n",
+            SERIAL_TX_RING_SIZE, SERIAL_COM1_IRQ);
+}
+
+void serial_flush(void) {
+    uint64_t flags;
+    int locked = serial_tx_lock(&flags, 1);
+
+    while (serial_tx_head != serial_tx_tail) {
+        while (serial_transmit_empty() == 0) {
+            asm volatile("pause");
+        }
+        serial_tx_fill();
+    }
+    outb(SERIAL_COM1 + SERIAL_INT_ENABLE, 0x00);
+    serial_tx_active = 0;
+    serial_irq_mode = 0;  // Дальше - синхронно
+
+    if (locked) {
+        serial_tx_unlock(flags);
+    }
+}
+
+void serial_print_stats(void) {
+    kprintf("\n%[H]=== Serial TX ===%[D]\n");
+    kprintf("  mode=%s queued=%lu bytes=%lu irqs=%lu full_waits=%lu bypass=%lu\n",
+            serial_irq_mode ? "irq" : "sync", serial_tx_tail - serial_tx_head,
+            serial_stats.bytes, serial_stats.irqs, serial_stats.full_waits,
+            serial_stats.lock_bypass);
+}
+
 void serial_print(const char* str) {
     while (*str) {
         // Convert \n to \r\n for proper terminal display
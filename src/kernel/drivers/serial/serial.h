@@ -5,9 +5,40 @@
 
 // COM1 serial port (standard)
 #define SERIAL_COM1 0x3F8
+#define SERIAL_COM1_IRQ 4
+
+// ============================================================================
+// TX: ring + IRQ 4
+// ============================================================================
+//
+// До serial_enable_irq() вывод синхронный (busy-wait на THRE, как раньше).
+// Потом serial_putchar() только кладёт байт в TX ring, а THR empty interrupt
+// (IRQ 4, BSP) докладывает по SERIAL_FIFO_SIZE байт в FIFO 16550 - kprintf
+// не стоит ~87 us на каждый байт при 115200.
+//
+// Ring полон - писатель сам выталкивает FIFO (backpressure, лог не теряется).
+// Не взял lock за SERIAL_TX_LOCK_SPINS (fault внутри serial_putchar на этом
+// же CPU) - байт уходит синхронно мимо ring.
+//
+// ============================================================================
+
+#define SERIAL_TX_RING_SIZE   16384     // Степень 2
+#define SERIAL_FIFO_SIZE      16        // 16550A TX FIFO
+#define SERIAL_TX_LOCK_SPINS  1000000
 
 void serial_init(void);
 void serial_putchar(char c);
 void serial_print(const char* str);
 
+// Перейти на IRQ-driven TX (после idt_init / pic_init)
+void serial_enable_irq(void);
+
+// IRQ 4 handler: THR пуст - следующая порция из ring
+void serial_irq_handler(void);
+
+// Синхронно вытолкнуть всё из ring (panic - прерываний больше не будет)
+void serial_flush(void);
+
+void serial_print_stats(void);
+
 #endif // SERIAL_H
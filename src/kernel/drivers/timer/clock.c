@@ -0,0 +1,226 @@
+#include "clock.h"
+#include "pit.h"
+#include "pic.h"
+#include "lapic.h"
+#include "idt.h"
+#include "smp.h"
+#include "cpu.h"
+#include "atomics.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+static uint64_t clock_base_tsc = 0;
+static uint64_t clock_hz = 0;                   // 0 = не откалиброван
+static uint64_t clock_tsc_per_tick = 0;
+static int clock_invariant = 0;                 // TSC не стоит в C-states
+
+static clock_event_mode_t clock_mode = CLOCK_EVENT_PIT;
+static uint64_t clock_lapic_hz = 0;             // One-shot: счёт LAPIC timer в секунду
+static uint64_t clock_next_tick = 0;            // TSC следующей границы tick
+static uint64_t clock_armed = 0;                // Взведённый срок, 0 = нет
+
+static struct {
+    uint64_t events;            // Timer interrupts (LAPIC)
+    uint64_t ticks;             // Из них - scheduler ticks
+    uint64_t skipped;           // Ticks, пропущенные в простое
+    volatile uint64_t kicks;
+} clock_stats;
+
+// ============================================================================
+// CLOCKSOURCE
+// ============================================================================
+
+void clock_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000007) {
+        cpu_cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        clock_invariant = (edx >> 8) & 1;
+    }
+
+    uint64_t start = rdtsc();
+    pit_udelay(CLOCK_CALIBRATE_US);
+    uint64_t hz = (rdtsc() - start) * (1000000 / CLOCK_CALIBRATE_US);
+    if (hz < CLOCK_TICK_HZ) {
+        hz = CLOCK_TSC_HZ_FALLBACK;  // TSC не идёт?
+    }
+
+    clock_base_tsc = start;
+    clock_tsc_per_tick = hz / CLOCK_TICK_HZ;
+    clock_hz = hz;
+
+    kprintf("[CLOCK] TSC %lu kHz%s\n", hz / 1000,
+            clock_invariant ? " (invariant)" : " (not invariant - may drift in deep C-states)");
+}
+
+uint64_t clock_tsc_hz(void) {
+    return clock_hz;
+}
+
+uint64_t clock_tsc_base(void) {
+    return clock_base_tsc;
+}
+
+int clock_tsc_invariant(void) {
+    return clock_invariant;
+}
+
+uint64_t clock_ns(void) {
+    return clock_tsc_to_ns(rdtsc());
+}
+
+uint64_t clock_tsc_to_ns(uint64_t tsc) {
+    uint64_t hz = clock_hz ? clock_hz : CLOCK_TSC_HZ_FALLBACK;
+    uint64_t delta = tsc - clock_base_tsc;
+
+    // Без 128-bit деления: целые секунды + остаток (< hz * 1e9 помещается)
+    return (delta / hz) * 1000000000ULL + ((delta % hz) * 1000000000ULL) / hz;
+}
+
+uint64_t clock_tsc_at(uint64_t ns) {
+    uint64_t hz = clock_hz ? clock_hz : CLOCK_TSC_HZ_FALLBACK;
+    // Округление вверх: в этот момент clock_ns() уже не меньше ns
+    return clock_base_tsc + (ns / 1000000000ULL) * hz +
+           ((ns % 1000000000ULL) * hz + 999999999ULL) / 1000000000ULL;
+}
+
+uint64_t clock_ticks(void) {
+    if (!clock_hz) {
+        return pit_get_ticks();
+    }
+    return (rdtsc() - clock_base_tsc) / clock_tsc_per_tick;
+}
+
+// ============================================================================
+// CLOCK EVENTS
+// ============================================================================
+
+clock_event_mode_t clock_event_init(void) {
+    if (!clock_hz || !lapic_available()) {
+        kprintf("[CLOCK] No LAPIC - staying on PIT %d Hz\n", CLOCK_TICK_HZ);
+        return clock_mode;
+    }
+
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0x00000001, 0, &eax, &ebx, &ecx, &edx);
+
+    if (ecx & (1 << 24)) {
+        lapic_timer_start(LAPIC_TIMER_VECTOR, 1);
+        clock_mode = CLOCK_EVENT_TSC_DEADLINE;
+    } else {
+        clock_lapic_hz = lapic_timer_calibrate(CLOCK_CALIBRATE_US);
+        if (clock_lapic_hz == 0) {
+            kprintf("[CLOCK] %[W]LAPIC timer does not count - staying on PIT%[D]\n");
+            return clock_mode;
+        }
+        lapic_timer_start(LAPIC_TIMER_VECTOR, 0);
+        clock_mode = CLOCK_EVENT_LAPIC_ONESHOT;
+    }
+
+    // Periodic IRQ 0 больше не нужен (pit_udelay на channel 2 работает и так)
+    pic_disable_irq(0);
+
+    memset(&clock_stats, 0, sizeof(clock_stats));
+    clock_next_tick = rdtsc() + clock_tsc_per_tick;
+    clock_armed = 0;
+    clock_event_program(clock_next_tick);
+
+    if (clock_mode == CLOCK_EVENT_TSC_DEADLINE) {
+        kprintf("[CLOCK] LAPIC timer: TSC-deadline, tickless idle (vector 0x%x)\n",
+                LAPIC_TIMER_VECTOR);
+    } else {
+        kprintf("[CLOCK] LAPIC timer: one-shot %lu kHz, tickless idle (vector 0x%x)\n",
+                clock_lapic_hz / 1000, LAPIC_TIMER_VECTOR);
+    }
+    return clock_mode;
+}
+
+clock_event_mode_t clock_event_mode(void) {
+    return clock_mode;
+}
+
+int clock_tick_due(uint64_t now_tsc) {
+    if (clock_mode == CLOCK_EVENT_PIT) {
+        return 1;  // Каждый IRQ 0 - tick
+    }
+    if (now_tsc < clock_next_tick) {
+        return 0;
+    }
+
+    // Простой мог проспать несколько ticks - не догоняем их пачкой
+    uint64_t missed = (now_tsc - clock_next_tick) / clock_tsc_per_tick;
+    clock_next_tick += (missed + 1) * clock_tsc_per_tick;
+    clock_stats.skipped += missed;
+    clock_stats.ticks++;
+    return 1;
+}
+
+uint64_t clock_next_tick_tsc(void) {
+    return clock_next_tick;
+}
+
+void clock_event_fired(void) {
+    clock_armed = 0;
+    clock_stats.events++;
+}
+
+void clock_event_program(uint64_t deadline_tsc) {
+    if (clock_mode == CLOCK_EVENT_PIT) {
+        return;
+    }
+    if (clock_armed && clock_armed <= deadline_tsc) {
+        return;  // Раньше уже придёт
+    }
+    if (deadline_tsc == 0) {
+        deadline_tsc = 1;  // 0 в IA32_TSC_DEADLINE = disarm
+    }
+    clock_armed = deadline_tsc;
+
+    if (clock_mode == CLOCK_EVENT_TSC_DEADLINE) {
+        lapic_timer_arm_deadline(deadline_tsc);  // В прошлом - сработает сразу
+        return;
+    }
+
+    // One-shot: TSC -> счёт LAPIC (дальше секунды не заглядываем - без переполнения)
+    uint64_t now = rdtsc();
+    uint64_t delta = deadline_tsc > now ? deadline_tsc - now : 0;
+    if (delta > clock_hz) {
+        delta = clock_hz;
+    }
+    uint64_t count = delta * clock_lapic_hz / clock_hz;
+    if (count == 0) {
+        count = 1;
+    }
+    if (count > 0xFFFFFFFFULL) {
+        count = 0xFFFFFFFFULL;
+    }
+    lapic_timer_arm_count((uint32_t)count);
+}
+
+void clock_event_kick(void) {
+    if (clock_mode == CLOCK_EVENT_PIT) {
+        return;  // IRQ 0 и так каждые 10 ms
+    }
+    atomic_increment_u64(&clock_stats.kicks);
+
+    if (smp_current_cpu() == 0) {
+        clock_event_program(rdtsc());
+    } else {
+        lapic_send_fixed_ipi(smp_cpu_apic_id(0), LAPIC_TIMER_VECTOR);
+    }
+}
+
+void clock_print_stats(void) {
+    static const char* mode_names[] = { "PIT 100 Hz", "LAPIC one-shot", "TSC-deadline" };
+
+    kprintf("\n%[H]=== Clock ===%[D]\n");
+    kprintf("  TSC=%lu kHz%s mode=%s uptime=%lu ms\n",
+            clock_hz / 1000, clock_invariant ? " invariant" : "",
+            mode_names[clock_mode], clock_ns() / 1000000);
+    kprintf("  events=%lu ticks=%lu skipped(idle)=%lu kicks=%lu\n",
+            clock_stats.events, clock_stats.ticks, clock_stats.skipped,
+            atomic_load_u64(&clock_stats.kicks));
+}
@@ -0,0 +1,89 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// CLOCK - TSC clocksource + LAPIC clock events (tickless)
+// ============================================================================
+//
+// Clocksource: TSC, откалиброванный по PIT channel 2 (clock_init). Из него -
+// clock_ns() и clock_ticks() (CLOCK_TICK_HZ ticks с загрузки - единицы
+// тайм-аутов block cache / journal / block queue, раньше это был счётчик
+// IRQ 0, который стоит без периодического прерывания).
+//
+// Clock events: вместо PIT 100 Hz на BSP - LAPIC timer, один раз на
+// ближайший срок:
+//
+//   TSC-deadline  - срок прямо в TSC (IA32_TSC_DEADLINE), если CPU умеет
+//   one-shot      - иначе счётчик LAPIC, откалиброванный по PIT
+//   PIT           - LAPIC недоступен: старые 100 Hz, всё как было
+//
+// Срок выбирает timer interrupt (idt.c): граница следующего tick, пока
+// есть процессы или события в полёте, ближайший таймер Hardware deck, и не
+// реже CLOCK_IDLE_MAX_MS в простое (NO_HZ idle). Scheduler tick по-прежнему
+// раз в 1/CLOCK_TICK_HZ - clock_tick_due() отмеряет границы по TSC.
+//
+// Всё, кроме clock_event_kick(), - только на BSP с IF=0 (timer IRQ / init).
+//
+// ============================================================================
+
+#define CLOCK_TICK_HZ          100          // Scheduler tick (10 ms, как PIT раньше)
+#define CLOCK_IDLE_MAX_MS      500          // Простой: housekeeping (writeback) не реже
+#define CLOCK_CALIBRATE_US     10000        // Окно калибровки по PIT
+#define CLOCK_TSC_HZ_FALLBACK  2400000000ULL // До калибровки (~2.4GHz)
+
+typedef enum {
+    CLOCK_EVENT_PIT = 0,
+    CLOCK_EVENT_LAPIC_ONESHOT,
+    CLOCK_EVENT_TSC_DEADLINE,
+} clock_event_mode_t;
+
+// Калибровка TSC (IF=0, до pit_init не обязательно - channel 2)
+void clock_init(void);
+
+// Частота TSC, 0 = clock_init() ещё не был
+uint64_t clock_tsc_hz(void);
+
+// TSC в момент clock_init() (ns = 0, tick = 0)
+uint64_t clock_tsc_base(void);
+
+// 1 = TSC не стоит в C-states
+int clock_tsc_invariant(void);
+
+// Наносекунды с clock_init()
+uint64_t clock_ns(void);
+
+// Наносекунды с clock_init() до значения TSC tsc
+uint64_t clock_tsc_to_ns(uint64_t tsc);
+
+// Первое значение TSC, при котором clock_ns() >= ns
+uint64_t clock_tsc_at(uint64_t ns);
+
+// CLOCK_TICK_HZ ticks с clock_init() (до калибровки - IRQ 0 ticks)
+uint64_t clock_ticks(void);
+
+// Переключить BSP с PIT IRQ 0 на LAPIC timer (после lapic_init, до sti).
+// Возвращает режим; CLOCK_EVENT_PIT = остаёмся на PIT
+clock_event_mode_t clock_event_init(void);
+clock_event_mode_t clock_event_mode(void);
+
+// Timer interrupt: пройдена граница tick? (PIT - каждый IRQ)
+int clock_tick_due(uint64_t now_tsc);
+
+// TSC следующей границы tick
+uint64_t clock_next_tick_tsc(void);
+
+// Прерывание, запрограммированное ранее, отработано (timer interrupt)
+void clock_event_fired(void);
+
+// Прерывание не позже deadline_tsc (более ранний уже взведённый срок остаётся)
+void clock_event_program(uint64_t deadline_tsc);
+
+// Timer interrupt на BSP как можно скорее - с любого CPU (с AP через IPI):
+// разбуженный процесс / завершённое I/O не ждут следующего срока
+void clock_event_kick(void);
+
+void clock_print_stats(void);
+
+#endif // CLOCK_H
@@ -71,6 +71,34 @@ void pit_sleep_ms(uint32_t milliseconds) {
     }
 }
 
+// Busy-wait using channel 2 one-shot (mode 0) and polling OUT2 in port B
+// Не зависит от IRQ 0 - работает при IF=0 и до pit_init()
+void pit_udelay(uint32_t microseconds) {
+    while (microseconds > 0) {
+        // Максимум 16-bit счётчика ~54ms, берём куски по 50ms
+        uint32_t chunk = microseconds > 50000 ? 50000 : microseconds;
+        uint32_t count = (uint32_t)(((uint64_t)chunk * PIT_FREQUENCY) / 1000000);
+        if (count == 0) {
+            count = 1;
+        }
+
+        // Gate on, speaker off
+        uint8_t port_b = inb(PIT_PORT_B);
+        outb(PIT_PORT_B, (port_b & ~PIT_PORT_B_SPKR) | PIT_PORT_B_GATE2);
+
+        outb(PIT_COMMAND, PIT_CMD_CHANNEL2 | PIT_CMD_RW_BOTH | PIT_CMD_MODE0 | PIT_CMD_BINARY);
+        outb(PIT_CHANNEL2, (uint8_t)(count & 0xFF));
+        outb(PIT_CHANNEL2, (uint8_t)((count >> 8) & 0xFF));
+
+        // OUT2 поднимается на terminal count
+        while (!(inb(PIT_PORT_B) & PIT_PORT_B_OUT2)) {
+            asm volatile("pause");
+        }
+
+        microseconds -= chunk;
+    }
+}
+
 // Get frequency in Hz
 uint32_t pit_get_frequency(void) {
     return pit_frequency;
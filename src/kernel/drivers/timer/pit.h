@@ -23,6 +23,14 @@
 #define PIT_CMD_MODE3    0x06     // Mode 3: Square Wave Generator
 #define PIT_CMD_RW_BOTH  0x30     // Read/Write LSB then MSB
 #define PIT_CMD_CHANNEL0 0x00     // Select Channel 0
+#define PIT_CMD_CHANNEL2 0x80     // Select Channel 2
+#define PIT_CMD_MODE0    0x00     // Mode 0: Interrupt on Terminal Count
+
+// Port B (0x61): bit 0 = channel 2 gate, bit 1 = speaker, bit 5 = channel 2 OUT
+#define PIT_PORT_B       0x61
+#define PIT_PORT_B_GATE2 0x01
+#define PIT_PORT_B_SPKR  0x02
+#define PIT_PORT_B_OUT2  0x20
 
 // Initialize PIT to generate interrupts at specified frequency
 void pit_init(uint32_t frequency_hz);
@@ -36,4 +44,8 @@ uint64_t pit_get_ticks(void);
 // Sleep for specified number of milliseconds (busy wait)
 void pit_sleep_ms(uint32_t milliseconds);
 
+// Busy-wait on channel 2 (polling, works with interrupts disabled)
+// Used by SMP bring-up for INIT/SIPI delays
+void pit_udelay(uint32_t microseconds);
+
 #endif // PIT_H
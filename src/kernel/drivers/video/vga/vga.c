@@ -2,7 +2,18 @@
 #include "io.h"
 #include "klib.h"
 
-unsigned char *vga = (unsigned char*)VGA_MEMORY;
+// Весь вывод - в теневой буфер в RAM, в видеопамять уходят только
+// изменённые строки в vga_flush() (запись в 0xB8000 и порты cursor медленные,
+// особенно под эмулятором). Экран обновляется на vga_update_cursor()
+static unsigned char vga_shadow[VGA_SIZE] __attribute__((aligned(64)));
+unsigned char *vga = vga_shadow;
+
+static volatile uint64_t* const vga_hw = (volatile uint64_t*)VGA_MEMORY;
+static uint32_t vga_dirty = 0;                  // Bit i - строка i изменена
+static int vga_hw_cursor = -1;                  // Позиция hardware cursor (-1 = неизвестна)
+
+#define VGA_ALL_LINES ((1u << VGA_HEIGHT) - 1)
+#define VGA_LINE_OF(loc) ((loc) / (VGA_WIDTH * BYTES_FOR_EACH_ELEMENT))
 
 uint8_t vga_attr_backup[VGA_WIDTH * VGA_HEIGHT]; // Хранит цвет каждого символа
 
@@ -29,12 +40,12 @@ void vga_print_char(char ch, const unsigned char attr) {
 
     vga[current_loc] = ch;
     vga[current_loc + 1] = attr;
+    vga_dirty |= 1u << VGA_LINE_OF(current_loc);
 
     // Сохраняем атрибут в бэкап, чтобы позже вернуть при обновлении курсора
     vga_attr_backup[current_loc / 2] = attr;
 
     current_loc += 2;
-    vga_update_cursor();
 }
 
 
@@ -84,6 +95,7 @@ void vga_clear_screen(void){
         vga[i+1] = VGA_DEFAULT;
         vga_attr_backup[i / 2] = VGA_DEFAULT;
     }
+    vga_dirty = VGA_ALL_LINES;
     current_loc = 0;
     last_loc = 0;
     vga_update_cursor();
@@ -96,6 +108,7 @@ void vga_clear_line(int line) {
         vga[i] = ' ';
         vga[i+1] = VGA_DEFAULT;
     }
+    vga_dirty |= 1u << line;
 }
 
 void vga_clear_to_eol(void) {
@@ -114,6 +127,7 @@ void vga_clear_to_eol(void) {
         vga[idx] = ' ';
         vga[idx + 1] = VGA_DEFAULT;
     }
+    vga_dirty |= 1u << y;
 }
 
 
@@ -188,6 +202,7 @@ void vga_scroll_up(void){
         // Обновляем бэкап для очищенных строк
         vga_attr_backup[i / 2] = VGA_DEFAULT; // Возможно удалить эту строку
     }
+    vga_dirty = VGA_ALL_LINES;
     if (current_loc >= line_size) {
         current_loc -= line_size;
     } else {
@@ -221,20 +236,45 @@ void vga_change_background(unsigned char new_bg_color) {
         // Обновляем бэкап атрибутов
         vga_attr_backup[i / 2] = vga[i];
     }
+    vga_dirty = VGA_ALL_LINES;
+}
+
+// Изменённые строки теневого буфера - в видеопамять, по 8 байт
+void vga_flush(void) {
+    uint32_t dirty = vga_dirty;
+    vga_dirty = 0;
+
+    while (dirty) {
+        uint32_t line = __builtin_ctz(dirty);
+        dirty &= dirty - 1;
+
+        const uint64_t* src = (const uint64_t*)(vga_shadow + line * line_size);
+        volatile uint64_t* dst = vga_hw + line * line_size / sizeof(uint64_t);
+        for (uint32_t i = 0; i < line_size / sizeof(uint64_t); i++) {
+            dst[i] = src[i];
+        }
+    }
 }
 
-// Hardware cursor update
+// Hardware cursor update: конец batch вывода - экран и cursor
 void vga_update_cursor(void){
     // Restore previous position's attribute from backup
     if (last_loc < VGA_SIZE) {
         uint16_t last_pos = last_loc / 2;
         vga[last_loc + 1] = vga_attr_backup[last_pos];
+        vga_dirty |= 1u << VGA_LINE_OF(last_loc);
     }
 
     last_loc = current_loc;
 
-    // Update hardware cursor position
+    vga_flush();
+
+    // Update hardware cursor position (порты - только если сдвинулся)
     uint16_t pos = current_loc / 2;
+    if (pos == vga_hw_cursor) {
+        return;
+    }
+    vga_hw_cursor = pos;
     outb(0x3D4, 0x0F);
     outb(0x3D5, (uint8_t)(pos & 0xFF));
     outb(0x3D4, 0x0E);
@@ -109,8 +109,10 @@ void vga_print_success(const char *str);
 void vga_print_hint(const char *str);
 void vga_print_warning(const char *str);
 
-// Cursor control
+// Cursor control. Вывод копится в теневом буфере: vga_update_cursor()
+// переносит изменённые строки на экран (vga_flush) и двигает cursor
 void vga_update_cursor(void);
+void vga_flush(void);
 void vga_set_cursor_position(int x, int y);
 int vga_get_cursor_position_x(void);
 int vga_get_cursor_position_y(void);
@@ -81,6 +81,18 @@ static inline uint64_t atomic_decrement_u64(volatile uint64_t* ptr) {
     return result - 1;
 }
 
+// Прибавить delta, вернуть новое значение
+static inline uint64_t atomic_add_u64(volatile uint64_t* ptr, uint64_t delta) {
+    uint64_t result;
+    __asm__ volatile(
+        "lock; xaddq %0, %1"
+        : "=r" (result), "+m" (*ptr)
+        : "0" (delta)
+        : "memory", "cc"
+    );
+    return result + delta;
+}
+
 static inline uint32_t atomic_increment_u32(volatile uint32_t* ptr) {
     uint32_t result;
     __asm__ volatile(
@@ -25,6 +25,7 @@ const char* error_to_string(uint32_t error_code) {
         case ERROR_OP_INVALID_INPUT: return "Invalid input data";
         case ERROR_OP_COMPRESSION_FAILED: return "Compression failed";
         case ERROR_OP_DECOMPRESSION_FAILED: return "Decompression failed";
+        case ERROR_OP_AUTH_FAILED: return "Authentication failed";
 
         // Storage Deck errors
         case ERROR_STORAGE_FILE_NOT_FOUND: return "File not found";
@@ -49,6 +50,9 @@ const char* error_to_string(uint32_t error_code) {
         case ERROR_NET_CONNECTION_REFUSED: return "Connection refused";
         case ERROR_NET_TIMEOUT: return "Network timeout";
         case ERROR_NET_HOST_UNREACHABLE: return "Host unreachable";
+        case ERROR_NET_NO_DEVICE: return "No network device";
+        case ERROR_NET_TX_FULL: return "Transmit queue full";
+        case ERROR_NET_FRAME_SIZE: return "Bad frame size";
 
         // Workflow errors
         case ERROR_WORKFLOW_NOT_FOUND: return "Workflow not found";
@@ -75,6 +79,7 @@ bool error_is_transient(uint32_t error_code) {
         case ERROR_HW_DEVICE_BUSY:
         case ERROR_NET_TIMEOUT:
         case ERROR_NET_HOST_UNREACHABLE:
+        case ERROR_NET_TX_FULL:
             return true;
 
         default:
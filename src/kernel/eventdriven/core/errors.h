@@ -28,6 +28,7 @@
 #define ERROR_OP_INVALID_INPUT      0x0103
 #define ERROR_OP_COMPRESSION_FAILED 0x0104
 #define ERROR_OP_DECOMPRESSION_FAILED 0x0105
+#define ERROR_OP_AUTH_FAILED        0x0106
 
 // === STORAGE DECK ERRORS (02xx) ===
 #define ERROR_STORAGE_FILE_NOT_FOUND    0x0201
@@ -52,6 +53,9 @@
 #define ERROR_NET_CONNECTION_REFUSED 0x0402
 #define ERROR_NET_TIMEOUT           0x0403
 #define ERROR_NET_HOST_UNREACHABLE  0x0404
+#define ERROR_NET_NO_DEVICE         0x0405
+#define ERROR_NET_TX_FULL           0x0406
+#define ERROR_NET_FRAME_SIZE        0x0407
 
 // === WORKFLOW ERRORS (05xx) ===
 #define ERROR_WORKFLOW_NOT_FOUND    0x0501
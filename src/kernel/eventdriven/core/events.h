@@ -34,6 +34,7 @@ typedef enum {
     EVENT_NET_CONNECT = 21,
     EVENT_NET_SEND = 22,
     EVENT_NET_RECV = 23,
+    EVENT_NET_POLL = 24,
 
     // Process operations
     EVENT_PROC_CREATE = 30,
@@ -70,6 +71,8 @@ typedef enum {
     EVENT_CONSOLE_CLEAR = 74,       // Clear screen
     EVENT_CONSOLE_SET_POS = 75,     // Set cursor position
     EVENT_CONSOLE_GET_POS = 76,     // Get cursor position
+    EVENT_SYSTEM_TRACE = 77,        // Drain kernel trace buffers to console
+    EVENT_SYSTEM_STATS = 78,        // Latency histograms (report / per-deck p99)
 
     EVENT_MAX = 255
 } EventType;
@@ -99,7 +102,20 @@ typedef enum {
 #define DECK_PREFIX_OPERATIONS  1  // Process + IPC operations
 #define DECK_PREFIX_STORAGE     2  // Memory + Filesystem operations
 #define DECK_PREFIX_HARDWARE    3  // Timer + Devices operations
-#define DECK_PREFIX_NETWORK     4  // Network operations (stub в v1)
+#define DECK_PREFIX_NETWORK     4  // Network operations (Ethernet кадры, virtio-net)
+
+// ============================================================================
+// PRIORITY CLASSES - QoS lanes в DeckQueue
+// ============================================================================
+// RingEvent.priority / Workflow.priority → RoutingEntry.priority → lane очереди
+// каждого deck (guide.h). 0 = NORMAL, так что нулевой RingEvent ведёт себя как
+// раньше. Неизвестный класс при ingestion становится NORMAL, INTERACTIVE
+// из user ring - тоже: эта lane только для kernel
+
+#define EVENT_PRIORITY_NORMAL       0  // По умолчанию
+#define EVENT_PRIORITY_INTERACTIVE  1  // Strict priority: консоль, latency-critical
+#define EVENT_PRIORITY_BULK         2  // Storage/compression потоки - меньшая доля
+#define EVENT_PRIORITY_CLASSES      3
 
 // ============================================================================
 // EVENT STRUCTURE - Основная структура события (256 байт)
@@ -113,12 +129,15 @@ typedef struct __attribute__((packed)) {
     uint64_t user_id;         // PID процесса-отправителя
     uint64_t timestamp;       // Timestamp создания (TSC или RDTSC)
     uint32_t type;            // Тип события (EventType)
-    uint32_t flags;           // Дополнительные флаги
+    uint32_t flags;           // Дополнительные флаги (EVENT_FLAG_*)
 
     // === PAYLOAD (224 bytes) ===
     uint8_t data[EVENT_DATA_SIZE];  // Данные события
 } Event;
 
+// Event.flags
+#define EVENT_FLAG_MEMOIZE  0x01  // Чистый operations шаг: результат из/в memo cache
+
 // Compile-time проверка размера
 _Static_assert(sizeof(Event) == 256, "Event must be exactly 256 bytes");
 
@@ -152,7 +171,8 @@ typedef enum {
     RESULT_TYPE_KMALLOC,        // Allocated via kmalloc() - needs kfree()
     RESULT_TYPE_VALUE,          // Value cast to pointer (e.g., inode_id) - no cleanup
     RESULT_TYPE_STATIC,         // Static data or stack pointer - no cleanup
-    RESULT_TYPE_MEMORY_MAPPED   // Memory-mapped region - special cleanup
+    RESULT_TYPE_MEMORY_MAPPED,  // Memory-mapped region - special cleanup
+    RESULT_TYPE_BUFFER          // ResultBuffer* (result_buffer.h) - release()
 } ResultType;
 
 // ============================================================================
@@ -161,13 +181,48 @@ typedef enum {
 
 #define MAX_ROUTING_STEPS 8
 
+// Максимальный payload события в RoutingEntry (= EVENT_PAYLOAD_SIZE RingEvent)
+#define ROUTING_PAYLOAD_SIZE 512
+
+// LAYOUT: hot/cold split
+//   Cache line 0 (HOT) - всё, что читают Guide и dispatch на каждом шаге
+//   Cache lines 1+ (COLD) - event header, результаты decks, владелец слота;
+//   трогаются только decks и Execution Deck
+// Pool выделяет entries выровненными по 64, поэтому HOT = ровно одна линия.
 typedef struct RoutingEntry {
+    // ===================== HOT (cache line 0) =====================
     uint64_t event_id;                    // ID события
-    Event event_copy;                     // КОПИЯ события (не указатель!)
 
-    // Prefix routing system
+    // GUIDE READY QUEUE (intrusive FIFO): entry может сделать следующий шаг
+    struct RoutingEntry* ready_next;      // Следующий в ready queue
+
+    // PAYLOAD - kernel копия: payload_data (ingestion из ring / workflow) или
+    // event_copy.data (routing_entry_init). Decks читают ТОЛЬКО payload,
+    // память процесса после ingestion не трогают
+    uint8_t* payload;                     // Данные события
+
+    volatile uint32_t state;              // Состояние обработки
+    volatile uint32_t abort_flag;         // Флаг прерывания (например, при отказе Security)
+    volatile uint32_t completion_flags;   // Битовые флаги завершения decks
+    volatile uint32_t ready_queued;       // 1 = уже стоит в ready queue
+    uint32_t error_code;                  // Код ошибки
+    uint32_t payload_size;                // Размер (снимок при ingestion)
+
+    // Prefix routing system: маршрут неизменен, двигается только курсор
     uint8_t prefixes[MAX_ROUTING_STEPS];  // Массив префиксов (маршрут)
-    volatile uint8_t current_index;       // Текущая позиция в маршруте
+    volatile uint8_t current_index;       // Курсор: текущий шаг маршрута
+
+    // Step fusion: deck loop держит entry и выполняет подряд идущие свои шаги
+    volatile uint8_t fusion_budget;       // >0 = deck_complete может слить следующий шаг
+    volatile uint8_t fusion_pending;      // 1 = следующий шаг оставлен текущему deck
+
+    uint8_t priority;                     // EVENT_PRIORITY_* - lane в DeckQueue
+
+    // Batch deck публикует завершения сам после общей работы (group commit)
+    volatile uint8_t publish_hold;        // DECK_PUBLISH_* (deck_interface.h)
+
+    // ===================== COLD (cache lines 1+) =====================
+    Event event_copy __attribute__((aligned(64)));  // Header события (+ data для kernel-side)
 
     // Результаты от каждого deck
     void* deck_results[MAX_ROUTING_STEPS];
@@ -176,15 +231,53 @@ typedef struct RoutingEntry {
 
     // Метаданные
     uint64_t created_at;                  // Timestamp создания
-    volatile uint32_t completion_flags;   // Битовые флаги завершения decks
-    volatile uint32_t state;              // Состояние обработки
-    volatile uint32_t abort_flag;         // Флаг прерывания (например, при отказе Security)
-    uint32_t error_code;                  // Код ошибки
 
-    // DYNAMIC ROUTING TABLE FIX: Linked list for unlimited entries
-    struct RoutingEntry* next;            // Next entry in bucket (NULL if last)
+    // Текущий шаг маршрута (latency_stats: queue = started - dispatched)
+    uint64_t dispatched_at;               // Guide положил entry в DeckQueue
+    uint64_t started_at;                  // Deck loop взял entry
+    volatile uint32_t deck_step;          // DECK_STEP_* (deck_interface.h): кто публикует шаг
+
+    // Процесс-отправитель: его пространство FD / streams / памяти
+    void* owner;                          // process_t* (NULL = kernel-side событие)
+    uint64_t owner_pid;                   // PID владельца (защита от reuse слота процесса)
+
+    // Получатель результата - резолвится при ingestion, Execution Deck
+    // пишет прямо в этот ResultRing (не process_get_current())
+    void* result_owner;                   // process_t* (NULL = kernel-side без владельца)
+    uint64_t result_pid;                  // PID получателя (защита от reuse слота процесса)
+    void* result_ring;                    // ResultRing* получателя
+
+    // Registered buffer (bulk data) - kernel указатель в страницы процесса.
+    // NULL = событие работает только с payload
+    uint8_t* buffer;
+    uint32_t buffer_length;
+    void* buffer_pin;                     // process_reg_pin_t*: страницы buffer живы до release
+
+    // Результат предыдущего workflow node как input (zero-copy).
+    // Entry держит ссылку; buffer/buffer_length указывают в его data (read-only)
+    struct ResultBuffer* input_result;
+
+    // Workflow node события: WORKFLOW_TAG(instance_id, node), 0 = обычное событие
+    uint64_t workflow_tag;
+
+    // Storage Deck: шаг уже ждал async disk I/O - повтор читает синхронно
+    uint8_t io_waited;
+
+    // 1 = entry держит result credit result_owner'а (routing_entry_return_credit)
+    uint8_t credit_held;
+
+    // Detached entry ждёт grace period (routing_table_reclaim)
+    uint8_t retire_cache;                 // ROUTING_POOL_CACHE_* для возврата
+    uint64_t retire_epoch;
+    struct RoutingEntry* retire_next;
+
+    // Снимок payload события (+1: terminator строковых payload'ов - path, name)
+    uint8_t payload_data[ROUTING_PAYLOAD_SIZE + 1];
 } RoutingEntry;
 
+_Static_assert(__builtin_offsetof(RoutingEntry, event_copy) == 64,
+               "RoutingEntry hot fields must fit in one cache line");
+
 // ============================================================================
 // EVENT HELPERS - Вспомогательные функции для работы с событиями
 // ============================================================================
@@ -229,9 +322,33 @@ static inline void routing_entry_init(RoutingEntry* entry, uint64_t event_id, Ev
     entry->completion_flags = 0;
     entry->state = EVENT_STATUS_PENDING;
     entry->created_at = 0;  // Будет установлен timestamp
+    entry->dispatched_at = 0;
+    entry->started_at = 0;
     entry->abort_flag = 0;  // Нет ошибок
     entry->error_code = 0;
 
+    entry->payload = entry->event_copy.data;
+    entry->payload_size = EVENT_DATA_SIZE;
+    entry->owner = 0;
+    entry->owner_pid = 0;
+    entry->result_owner = 0;
+    entry->result_pid = 0;
+    entry->result_ring = 0;
+    entry->buffer = 0;
+    entry->buffer_length = 0;
+    entry->buffer_pin = 0;
+    entry->input_result = 0;
+    entry->workflow_tag = 0;
+    entry->io_waited = 0;
+    entry->credit_held = 0;
+    entry->ready_next = 0;
+    entry->ready_queued = 0;
+    entry->fusion_budget = 0;
+    entry->fusion_pending = 0;
+    entry->priority = EVENT_PRIORITY_NORMAL;
+    entry->publish_hold = 0;
+    entry->deck_step = 0;
+
     // Очищаем префиксы и результаты
     for (int i = 0; i < MAX_ROUTING_STEPS; i++) {
         entry->prefixes[i] = DECK_PREFIX_NONE;
@@ -241,36 +358,45 @@ static inline void routing_entry_init(RoutingEntry* entry, uint64_t event_id, Ev
     }
 }
 
-// Проверяет, завершена ли обработка события (все префиксы = 0)
-static inline int routing_entry_is_complete(RoutingEntry* entry) {
-    for (int i = 0; i < MAX_ROUTING_STEPS; i++) {
-        if (entry->prefixes[i] != DECK_PREFIX_NONE) {
-            return 0;  // Есть незавершённые decks
-        }
+static inline const char* event_priority_name(uint8_t priority) {
+    switch (priority) {
+        case EVENT_PRIORITY_NORMAL:      return "normal";
+        case EVENT_PRIORITY_INTERACTIVE: return "interactive";
+        case EVENT_PRIORITY_BULK:        return "bulk";
+        default:                         return "?";
     }
-    return 1;  // Все decks завершены
 }
 
-// Получает следующий префикс для обработки (всегда первый элемент!)
-// ОПТИМИЗАЦИЯ: O(1) вместо O(n) поиска
+// Получает следующий префикс для обработки (prefixes[current_index])
+// ОПТИМИЗАЦИЯ: O(1), маршрут не переписывается
 static inline uint8_t routing_entry_get_next_prefix(RoutingEntry* entry) {
-    return entry->prefixes[0];
+    uint8_t index = entry->current_index;
+    if (index >= MAX_ROUTING_STEPS) {
+        return DECK_PREFIX_NONE;
+    }
+    return entry->prefixes[index];
 }
 
-// СДВИГАЕТ массив префиксов влево (убирает первый префикс)
-// По idea.txt: [3,1,2,0] → [1,2,0,0] → [2,0,0,0] → [0,0,0,0]
-// ОПТИМИЗАЦИЯ: Больше не ищем prefix, всегда сдвигаем влево!
+// Проверяет, завершена ли обработка события (курсор дошёл до 0 / конца)
+static inline int routing_entry_is_complete(RoutingEntry* entry) {
+    return routing_entry_get_next_prefix(entry) == DECK_PREFIX_NONE;
+}
+
+// Завершает текущий шаг: двигает курсор (вместо сдвига массива)
+// По idea.txt: [3,1,2,0] cursor 0 → 1 → 2 → 3 (prefixes[3] = 0 → complete)
 static inline void routing_entry_clear_prefix(RoutingEntry* entry, uint8_t prefix) {
-    // Сдвиг влево: [3,1,2,0] → [1,2,0,0]
-    for (int i = 0; i < MAX_ROUTING_STEPS - 1; i++) {
-        entry->prefixes[i] = entry->prefixes[i + 1];
+    if (entry->current_index < MAX_ROUTING_STEPS) {
+        entry->current_index++;
     }
-    // Последний элемент всегда 0
-    entry->prefixes[MAX_ROUTING_STEPS - 1] = DECK_PREFIX_NONE;
 
-    // NOTE: параметр 'prefix' больше не используется, т.к. всегда удаляем первый
+    // NOTE: параметр 'prefix' не используется - всегда завершаем текущий шаг
     // Оставлен для совместимости с существующим кодом
     (void)prefix;
 }
 
+// Прерывает маршрут: курсор за конец, все оставшиеся шаги пропущены
+static inline void routing_entry_abort_route(RoutingEntry* entry) {
+    entry->current_index = MAX_ROUTING_STEPS;
+}
+
 #endif // EVENTS_H
@@ -0,0 +1,83 @@
+#include "result_buffer.h"
+#include "atomics.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+static ResultBufferStats result_buffer_stats;
+
+// ============================================================================
+// LIFETIME
+// ============================================================================
+
+ResultBuffer* result_buffer_alloc(uint64_t capacity) {
+    ResultBuffer* rb = (ResultBuffer*)kmalloc(sizeof(ResultBuffer) + capacity);
+    if (!rb) {
+        return 0;
+    }
+
+    result_buffer_init(rb, capacity, 0);
+    return rb;
+}
+
+void result_buffer_init(ResultBuffer* rb, uint64_t capacity, void (*recycle)(ResultBuffer* rb)) {
+    rb->refcount = 1;
+    rb->size = 0;
+    rb->capacity = capacity;
+    rb->recycle = recycle;
+
+    atomic_increment_u64(&result_buffer_stats.allocated);
+    atomic_add_u64(&result_buffer_stats.bytes_live, capacity);
+}
+
+void result_buffer_retain(ResultBuffer* rb) {
+    if (!rb) {
+        return;
+    }
+    atomic_increment_u64(&rb->refcount);
+}
+
+void result_buffer_release(ResultBuffer* rb) {
+    if (!rb) {
+        return;
+    }
+
+    // DEFENSIVE: лишний release не уводит refcount ниже нуля
+    if (atomic_load_u64(&rb->refcount) == 0) {
+        kprintf("[RESULT_BUFFER] %[E]Release of dead buffer %p%[D]\n", rb);
+        return;
+    }
+
+    if (atomic_decrement_u64(&rb->refcount) != 0) {
+        return;
+    }
+
+    atomic_increment_u64(&result_buffer_stats.freed);
+    atomic_add_u64(&result_buffer_stats.bytes_live, 0 - rb->capacity);
+    if (rb->recycle) {
+        rb->recycle(rb);
+    } else {
+        kfree(rb);
+    }
+}
+
+void result_buffer_note_consumed(void) {
+    atomic_increment_u64(&result_buffer_stats.consumed);
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+void result_buffer_print_stats(void) {
+    uint64_t allocated = atomic_load_u64(&result_buffer_stats.allocated);
+    uint64_t freed = atomic_load_u64(&result_buffer_stats.freed);
+
+    kprintf("\n%[H]=== Result Buffers ===%[D]\n");
+    kprintf("  allocated=%lu freed=%lu live=%lu (%lu bytes) consumed=%lu\n",
+            allocated, freed, allocated - freed,
+            atomic_load_u64(&result_buffer_stats.bytes_live),
+            atomic_load_u64(&result_buffer_stats.consumed));
+}
@@ -0,0 +1,61 @@
+#ifndef RESULT_BUFFER_H
+#define RESULT_BUFFER_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// RESULT BUFFER - Reference-counted результат deck'а с реальным размером
+// ============================================================================
+//
+// Deck кладёт ResultBuffer в deck_results с RESULT_TYPE_BUFFER вместо
+// голого kmalloc - так результат несёт свой размер и может пережить
+// RoutingEntry:
+//
+//   storage FILE_READ  → ResultBuffer (size = прочитано байт)
+//   workflow node      → retain (результат node, пока workflow его держит)
+//   successor node     → entry->input_result (retain), entry->buffer/
+//                        buffer_length указывают прямо в data
+//   operations CRC32   → читает entry->buffer, копий нет
+//
+// Каждый держатель делает ровно один release; последний освобождает память.
+// Данные после публикации не меняются - consumers только читают.
+//
+// Буфер в чужой памяти (RX страница virtio-net) - result_buffer_init() с
+// recycle: последний release возвращает его владельцу вместо kfree.
+//
+// ============================================================================
+
+typedef struct ResultBuffer {
+    volatile uint64_t refcount;
+    uint64_t size;                  // Байт данных (<= capacity)
+    uint64_t capacity;
+    void (*recycle)(struct ResultBuffer* rb);   // NULL = kmalloc, kfree
+    uint8_t data[] __attribute__((aligned(16)));
+} ResultBuffer;
+
+typedef struct {
+    volatile uint64_t allocated;
+    volatile uint64_t freed;
+    volatile uint64_t bytes_live;
+    volatile uint64_t consumed;     // Переданы successor'у как input
+} ResultBufferStats;
+
+// refcount = 1, size = 0. NULL если нет памяти
+ResultBuffer* result_buffer_alloc(uint64_t capacity);
+
+// Буфер поверх памяти владельца (data сразу за header): refcount = 1,
+// size = 0. Последний release вызывает recycle(rb)
+void result_buffer_init(ResultBuffer* rb, uint64_t capacity, void (*recycle)(ResultBuffer* rb));
+
+// +1 держатель (NULL допустим)
+void result_buffer_retain(ResultBuffer* rb);
+
+// -1 держатель, последний освобождает (NULL допустим)
+void result_buffer_release(ResultBuffer* rb);
+
+// Учёт передачи буфера successor'у (zero-copy input)
+void result_buffer_note_consumed(void);
+
+void result_buffer_print_stats(void);
+
+#endif // RESULT_BUFFER_H
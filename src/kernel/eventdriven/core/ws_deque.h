@@ -0,0 +1,109 @@
+#ifndef WS_DEQUE_H
+#define WS_DEQUE_H
+
+#include "ktypes.h"
+#include "atomics.h"
+
+// ============================================================================
+// WORK-STEALING DEQUE (Chase-Lev) - один владелец, много воров
+// ============================================================================
+//
+// Владелец работает с bottom (push/pop как стек, LIFO - тёплый кэш),
+// воры забирают с top (FIFO - самую старую работу). Конфликт за
+// последний элемент решается одним CAS по top, поэтому каждый элемент
+// достаётся ровно одному потребителю.
+//
+// Буфер фиксированный (степень 2): push в полный deque возвращает 0,
+// вызывающий решает сам, что делать с элементом.
+//
+// x86-64 TSO: store→load в pop требует MFENCE, остальное - compiler barrier
+//
+// ============================================================================
+
+#define WS_DEQUE_SIZE 256                      // Степень 2
+#define WS_DEQUE_MASK (WS_DEQUE_SIZE - 1)
+
+typedef struct {
+    volatile uint64_t top __attribute__((aligned(64)));      // Воры (CAS)
+    volatile uint64_t bottom __attribute__((aligned(64)));   // Только владелец
+    void* volatile slots[WS_DEQUE_SIZE] __attribute__((aligned(64)));
+} WSDeque;
+
+static inline void ws_deque_init(WSDeque* deque) {
+    deque->top = 0;
+    deque->bottom = 0;
+    for (uint32_t i = 0; i < WS_DEQUE_SIZE; i++) {
+        deque->slots[i] = 0;
+    }
+}
+
+// Приблизительный размер (точен только для владельца)
+static inline uint64_t ws_deque_size(WSDeque* deque) {
+    int64_t size = (int64_t)(atomic_load_u64(&deque->bottom) - atomic_load_u64(&deque->top));
+    return size > 0 ? (uint64_t)size : 0;
+}
+
+// Только владелец. Возвращает 1 при успехе, 0 если deque полон
+static inline int ws_deque_push(WSDeque* deque, void* item) {
+    uint64_t bottom = deque->bottom;
+    uint64_t top = atomic_load_u64(&deque->top);
+
+    if (bottom - top >= WS_DEQUE_SIZE) {
+        return 0;
+    }
+
+    deque->slots[bottom & WS_DEQUE_MASK] = item;
+    COMPILER_BARRIER();  // Слот виден раньше нового bottom
+    atomic_store_u64(&deque->bottom, bottom + 1);
+    return 1;
+}
+
+// Только владелец. Возвращает NULL если deque пуст (или последний украли)
+static inline void* ws_deque_pop(WSDeque* deque) {
+    uint64_t bottom = deque->bottom;
+    if (bottom == atomic_load_u64(&deque->top)) {
+        return 0;  // Быстрый путь: пусто, bottom не трогаем
+    }
+
+    bottom--;
+    atomic_store_u64(&deque->bottom, bottom);
+    MEMORY_BARRIER();  // CRITICAL: store bottom → load top (StoreLoad)
+
+    uint64_t top = atomic_load_u64(&deque->top);
+    if ((int64_t)(bottom - top) < 0) {
+        // Вор успел забрать последний элемент
+        atomic_store_u64(&deque->bottom, top);
+        return 0;
+    }
+
+    void* item = deque->slots[bottom & WS_DEQUE_MASK];
+    if (bottom != top) {
+        return item;  // Больше одного элемента - конфликта нет
+    }
+
+    // Последний элемент: гонка с ворами решается CAS по top
+    if (!atomic_cas_u64(&deque->top, top, top + 1)) {
+        item = 0;
+    }
+    atomic_store_u64(&deque->bottom, top + 1);
+    return item;
+}
+
+// Любой CPU. Возвращает NULL если пусто или проиграли гонку
+static inline void* ws_deque_steal(WSDeque* deque) {
+    uint64_t top = atomic_load_u64(&deque->top);
+    COMPILER_BARRIER();  // TSO: load top раньше load bottom
+    uint64_t bottom = atomic_load_u64(&deque->bottom);
+
+    if ((int64_t)(bottom - top) <= 0) {
+        return 0;
+    }
+
+    void* item = deque->slots[top & WS_DEQUE_MASK];
+    if (!atomic_cas_u64(&deque->top, top, top + 1)) {
+        return 0;  // Другой вор или владелец забрал этот элемент
+    }
+    return item;
+}
+
+#endif // WS_DEQUE_H
@@ -1,5 +1,6 @@
 #include "deck_interface.h"
 #include "klib.h"
+#include "trace.h"
 
 // ============================================================================
 // INITIALIZATION
@@ -10,8 +11,13 @@ void deck_init(DeckContext* ctx, const char* name, uint8_t prefix, DeckProcessFu
     ctx->stats.prefix = prefix;
     ctx->stats.events_processed = 0;
     ctx->stats.errors = 0;
+    ctx->stats.fused_steps = 0;
+    ctx->stats.memo_hits = 0;
+    ctx->stats.memo_misses = 0;
 
     ctx->process_func = func;
+    ctx->process_batch_func = 0;
+    ctx->batch_size = 1;
     ctx->deck_prefix = prefix;
 
     // Получаем input queue от Guide
@@ -20,24 +26,171 @@ void deck_init(DeckContext* ctx, const char* name, uint8_t prefix, DeckProcessFu
     kprintf("[DECK:%s] Initialized (prefix=%d)\n", name, prefix);
 }
 
+void deck_set_batch_func(DeckContext* ctx, DeckProcessBatchFunc func, uint32_t batch_size) {
+    if (batch_size == 0) {
+        batch_size = 1;
+    }
+    if (batch_size > DECK_BATCH_MAX) {
+        batch_size = DECK_BATCH_MAX;
+    }
+
+    ctx->process_batch_func = func;
+    ctx->batch_size = batch_size;
+
+    kprintf("[DECK:%s] Batch processing enabled (batch=%u)\n", ctx->stats.name, batch_size);
+}
+
+int deck_set_queue_depth(DeckContext* ctx, uint64_t depth) {
+    // DEFENSIVE: storage меняется только у пустой очереди
+    if (!ctx->input_queue || !deck_queue_set_capacity(ctx->input_queue, depth)) {
+        kprintf("[DECK:%s] ERROR: Cannot set queue depth %lu\n", ctx->stats.name, depth);
+        return 0;
+    }
+
+    kprintf("[DECK:%s] Queue depth set to %lu\n", ctx->stats.name, depth);
+    return 1;
+}
+
 // ============================================================================
 // GENERIC MAIN LOOP
 // ============================================================================
 
-// Обработать одно событие (для синхронной обработки в демо)
-int deck_run_once(DeckContext* ctx) {
-    // Получаем событие из очереди
-    RoutingEntry* entry = deck_queue_pop(ctx->input_queue);
+// Entry в руках deck loop: deck_complete() может оставить следующий шаг нам,
+// публикация шага - за loop (deck_finish_step)
+static inline void deck_fusion_begin(RoutingEntry* entry) {
+    entry->started_at = rdtsc();
+    entry->fusion_pending = 0;
+    entry->fusion_budget = DECK_FUSION_BUDGET;
+    entry->deck_step = DECK_STEP_RUNNING;
+}
 
-    if (entry) {
-        // Обрабатываем событие - deck сам вызовет deck_complete() или deck_error()
-        int success = ctx->process_func(entry);
+// process_func вернулся: отдать entry дальше. Шаг отмечен (READY) -
+// публикуем. Не отмечен - deck его не завершил, и Guide переотправит
+// entry, как раньше делало сканирование; SUSPENDED entry вернёт в ready
+// queue его источник (таймер, диск).
+// CRITICAL: state читаем до отпускания - после него entry может вести
+// источник SUSPENDED entry. Источник не пишет state раньше, чем
+// deck_step_ready(), поэтому PROCESSING здесь значит "никому не отдан"
+static void deck_finish_step(RoutingEntry* entry) {
+    uint32_t state = entry->state;
 
-        if (success) {
+    if (!atomic_cas_u32(&entry->deck_step, DECK_STEP_RUNNING, DECK_STEP_NONE)) {
+        entry->deck_step = DECK_STEP_NONE;
+        entry->state = EVENT_STATUS_PROCESSING;
+        if (!deck_publish_deferred(entry)) {
+            guide_mark_ready(entry);
+        }
+        return;
+    }
+
+    if (state == EVENT_STATUS_PROCESSING) {
+        guide_mark_ready(entry);
+    }
+}
+
+// Выполнить слитые шаги, затем вернуть entry обычному пути через Guide.
+// Шаг отмечен (READY), но не опубликован - entry всё ещё наш
+static void deck_run_fused_steps(DeckContext* ctx, RoutingEntry* entry) {
+    while (entry->fusion_pending && entry->fusion_budget > 0 &&
+           entry->deck_step == DECK_STEP_READY) {
+        entry->fusion_pending = 0;
+        entry->fusion_budget--;
+        entry->deck_step = DECK_STEP_RUNNING;
+        atomic_increment_u64((volatile uint64_t*)&ctx->stats.fused_steps);
+
+        if (ctx->process_func(entry)) {
             atomic_increment_u64((volatile uint64_t*)&ctx->stats.events_processed);
         } else {
             atomic_increment_u64((volatile uint64_t*)&ctx->stats.errors);
         }
+    }
+
+    // CRITICAL: fusion state чистим до deck_finish_step - после публикации
+    // entry ведёт другой CPU, а асинхронные завершения идут только через Guide
+    entry->fusion_pending = 0;
+    entry->fusion_budget = 0;
+}
+
+// Один pop, одно обновление head, один вызов batch func
+static int deck_run_batch(DeckContext* ctx) {
+    RoutingEntry* batch[DECK_BATCH_MAX];
+    uint32_t count = deck_queue_pop_batch(ctx->input_queue, batch, ctx->batch_size);
+
+    if (count == 0) {
+        return 0;  // Очередь пуста
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        deck_fusion_begin(batch[i]);
+        TRACE_INFO(TRACE_DECK_PROCESS, batch[i]->event_id, ctx->stats.prefix);
+    }
+
+    int succeeded = ctx->process_batch_func(batch, (int)count);
+    if (succeeded < 0) {
+        succeeded = 0;
+    }
+    if ((uint32_t)succeeded > count) {
+        succeeded = (int)count;
+    }
+
+    atomic_add_u64((volatile uint64_t*)&ctx->stats.events_processed, (uint64_t)succeeded);
+    atomic_add_u64((volatile uint64_t*)&ctx->stats.errors, (uint64_t)(count - (uint32_t)succeeded));
+
+    for (uint32_t i = 0; i < count; i++) {
+        deck_run_fused_steps(ctx, batch[i]);
+        deck_finish_step(batch[i]);
+    }
+    return (int)count;
+}
+
+void deck_hold_publish(RoutingEntry** entries, int count) {
+    for (int i = 0; i < count; i++) {
+        entries[i]->publish_hold = DECK_PUBLISH_HOLD;
+    }
+}
+
+void deck_publish_held(RoutingEntry** entries, int count) {
+    for (int i = 0; i < count; i++) {
+        RoutingEntry* entry = entries[i];
+        uint8_t hold = entry->publish_hold;
+
+        // CRITICAL: hold снимаем до публикации - следующий шаг уже не наш
+        entry->publish_hold = DECK_PUBLISH_NONE;
+        if (hold == DECK_PUBLISH_PENDING) {
+            guide_mark_ready(entry);
+        }
+    }
+}
+
+int deck_process_entry(DeckContext* ctx, RoutingEntry* entry) {
+    deck_fusion_begin(entry);
+    TRACE_INFO(TRACE_DECK_PROCESS, entry->event_id, ctx->stats.prefix);
+
+    // Deck сам вызовет deck_complete() или deck_error()
+    int success = ctx->process_func(entry);
+
+    if (success) {
+        atomic_increment_u64((volatile uint64_t*)&ctx->stats.events_processed);
+    } else {
+        atomic_increment_u64((volatile uint64_t*)&ctx->stats.errors);
+    }
+
+    deck_run_fused_steps(ctx, entry);
+    deck_finish_step(entry);
+    return success;
+}
+
+// Обработать одно событие (для синхронной обработки в демо)
+int deck_run_once(DeckContext* ctx) {
+    if (ctx->process_batch_func) {
+        return deck_run_batch(ctx);
+    }
+
+    // Получаем событие из очереди
+    RoutingEntry* entry = deck_queue_pop(ctx->input_queue);
+
+    if (entry) {
+        deck_process_entry(ctx, entry);
         return 1;  // Обработано событие
     }
     return 0;  // Очередь пуста
@@ -57,10 +210,13 @@ void deck_run(DeckContext* ctx) {
         // Периодическая статистика
         iterations++;
         if (iterations % 10000000 == 0) {
-            kprintf("[DECK:%s] processed=%lu errors=%lu\n",
+            kprintf("[DECK:%s] processed=%lu errors=%lu fused=%lu memo_hits=%lu memo_misses=%lu\n",
                     ctx->stats.name,
                     ctx->stats.events_processed,
-                    ctx->stats.errors);
+                    ctx->stats.errors,
+                    ctx->stats.fused_steps,
+                    ctx->stats.memo_hits,
+                    ctx->stats.memo_misses);
         }
     }
 }
@@ -4,7 +4,10 @@
 #include "../core/events.h"
 #include "../core/errors.h"
 #include "../guide/guide.h"
+#include "../core/result_buffer.h"
+#include "../stats/latency_stats.h"
 #include "klib.h"
+#include "trace.h"
 
 // ============================================================================
 // DECK INTERFACE - Общий интерфейс для всех Processing Decks
@@ -15,6 +18,9 @@ typedef struct {
     uint8_t prefix;                    // Уникальный prefix
     volatile uint64_t events_processed;
     volatile uint64_t errors;
+    volatile uint64_t fused_steps;     // Шаги, выполненные без возврата в Guide
+    volatile uint64_t memo_hits;       // Шаги, завершённые из memo cache
+    volatile uint64_t memo_misses;     // Memoizable шаги, посчитанные заново
 } DeckStats;
 
 // Функция обработки события (реализуется каждым deck)
@@ -22,6 +28,37 @@ typedef struct {
 // Возвращает: 1 = success, 0 = error
 typedef int (*DeckProcessFunc)(RoutingEntry* entry);
 
+// Пакетная обработка (опционально): deck получает сразу count entries
+// и может амортизировать дорогие операции (sync, flush) на весь batch.
+// Для каждого entry всё так же вызывается deck_complete()/deck_error()
+// Возвращает: количество успешно обработанных entries
+typedef int (*DeckProcessBatchFunc)(RoutingEntry** entries, int count);
+
+// Максимальный batch за один deck_run_once (массив на стеке)
+#define DECK_BATCH_MAX 32
+
+// Step fusion: маршрут [1,1,1,0] - deck выполняет до DECK_FUSION_BUDGET
+// следующих шагов сам, без round-trip через Guide ready queue.
+// Работает только пока entry в руках deck loop (асинхронные завершения,
+// например таймеры Hardware Deck, всегда идут через Guide)
+#define DECK_FUSION_BUDGET 4
+
+// Отложенная публикация (RoutingEntry.publish_hold): batch deck, которому
+// результаты можно отдавать только после общей работы batch (Storage -
+// tagfs_commit), держит завершения у себя и публикует их сам
+#define DECK_PUBLISH_NONE     0
+#define DECK_PUBLISH_HOLD     1     // deck_complete/deck_error не зовут Guide
+#define DECK_PUBLISH_PENDING  2     // Шаг завершён, ждёт deck_publish_held()
+
+// Кто отдаёт entry Guide (RoutingEntry.deck_step). Пока entry в руках deck
+// loop, завершение шага только отмечается - публикует сам loop, когда
+// process_func вернулся: после публикации entry может вести другой CPU
+// (pinned decks), и loop его больше не трогает. Без отметки loop знает,
+// что шаг не завершён, не перечитывая entry
+#define DECK_STEP_NONE        0     // Не в deck loop: завершение публикует само
+#define DECK_STEP_RUNNING     1     // Deck loop держит entry, шаг не отдан
+#define DECK_STEP_READY       2     // Шаг отдан (complete / error / resume), публикует loop
+
 // ============================================================================
 // DECK CONTEXT - Контекст для каждого deck
 // ============================================================================
@@ -29,6 +66,8 @@ typedef int (*DeckProcessFunc)(RoutingEntry* entry);
 typedef struct {
     DeckStats stats;
     DeckProcessFunc process_func;
+    DeckProcessBatchFunc process_batch_func;  // NULL = по одному entry
+    uint32_t batch_size;                      // <= DECK_BATCH_MAX
     DeckQueue* input_queue;
     uint8_t deck_prefix;
 } DeckContext;
@@ -40,22 +79,64 @@ typedef struct {
 // Инициализация deck
 void deck_init(DeckContext* ctx, const char* name, uint8_t prefix, DeckProcessFunc func);
 
-// Обработать одно событие (для синхронной обработки)
+// Включить пакетную обработку (batch_size обрезается до DECK_BATCH_MAX)
+void deck_set_batch_func(DeckContext* ctx, DeckProcessBatchFunc func, uint32_t batch_size);
+
+// Глубина input queue (степень 2, вызывать до первого события)
+// Возвращает 1 при успехе, 0 при ошибке
+int deck_set_queue_depth(DeckContext* ctx, uint64_t depth);
+
+// Обработать уже снятый с очереди entry: process_func + stats + requeue.
+// Для decks с собственной раздачей работы (Operations worker pool)
+// Возвращает результат process_func
+int deck_process_entry(DeckContext* ctx, RoutingEntry* entry);
+
+// Обработать одно событие (или один batch) - возвращает количество entries
 int deck_run_once(DeckContext* ctx);
 
 // Главный цикл deck (generic)
 void deck_run(DeckContext* ctx);
 
+// Отложенная публикация для batch func: hold до начала работы над batch,
+// publish - когда результаты batch можно отдавать (например, после commit)
+void deck_hold_publish(RoutingEntry** entries, int count);
+void deck_publish_held(RoutingEntry** entries, int count);
+
 // ============================================================================
 // DECK HELPERS - Завершение обработки
 // ============================================================================
 
+// Batch deck держит публикацию - шаг отдаст deck_publish_held()
+static inline int deck_publish_deferred(RoutingEntry* entry) {
+    if (entry->publish_hold == DECK_PUBLISH_HOLD) {
+        entry->publish_hold = DECK_PUBLISH_PENDING;
+        return 1;
+    }
+    return 0;
+}
+
+// Entry может идти дальше: шаг завершён, либо SUSPENDED entry вернулся из
+// async источника (таймер, диск) и должен пройти шаг заново. Внутри deck
+// loop - только отметка, иначе сразу Guide. Источники SUSPENDED entries
+// не пишут state сами: после публикации entry уже не их
+static inline void deck_step_ready(RoutingEntry* entry) {
+    if (atomic_cas_u32(&entry->deck_step, DECK_STEP_RUNNING, DECK_STEP_READY)) {
+        return;
+    }
+
+    entry->state = EVENT_STATUS_PROCESSING;
+    if (!deck_publish_deferred(entry)) {
+        guide_mark_ready(entry);
+    }
+}
+
 // Deck вызывает эту функцию после УСПЕШНОЙ обработки
 static inline void deck_complete(RoutingEntry* entry, uint8_t deck_prefix, void* result, ResultType result_type) {
     // 1. Сохраняем результат и его тип
     entry->deck_results[deck_prefix - 1] = result;
     entry->result_types[deck_prefix - 1] = result_type;
     entry->deck_timestamps[deck_prefix - 1] = rdtsc();
+    latency_stats_record_step(entry, deck_prefix, entry->deck_timestamps[deck_prefix - 1]);
 
     // 2. ЗАТИРАЕМ prefix (это ключевой момент!)
     routing_entry_clear_prefix(entry, deck_prefix);
@@ -64,7 +145,14 @@ static inline void deck_complete(RoutingEntry* entry, uint8_t deck_prefix, void*
     uint32_t flag = 1 << (deck_prefix - 1);
     atomic_store_u32(&entry->completion_flags, entry->completion_flags | flag);
 
-    // 4. Entry теперь готов для следующего шага (Guide его подхватит)
+    // 4. Следующий шаг снова наш - deck loop продолжит entry на месте
+    // (budget > 0 только пока entry в руках loop, решает и публикует он)
+    if (entry->fusion_budget > 0 && routing_entry_get_next_prefix(entry) == deck_prefix) {
+        entry->fusion_pending = 1;
+    }
+
+    // 5. Entry теперь готов для следующего шага - сообщаем Guide
+    deck_step_ready(entry);
 }
 
 // Deck вызывает эту функцию при ОШИБКЕ обработки (legacy - uses simple error code)
@@ -73,12 +161,16 @@ static inline void deck_error(RoutingEntry* entry, uint8_t deck_prefix, uint32_t
     atomic_store_u32(&entry->abort_flag, 1);
     entry->error_code = error_code;
     entry->deck_timestamps[deck_prefix - 1] = rdtsc();
+    latency_stats_record_step(entry, deck_prefix, entry->deck_timestamps[deck_prefix - 1]);
 
     // Затираем prefix чтобы Guide мог продолжить
     routing_entry_clear_prefix(entry, deck_prefix);
 
-    kprintf("[DECK_ERROR] Event %lu: deck %d error code %u\n",
-            entry->event_id, deck_prefix, error_code);
+    // Ошибка на событие (часто по вине user) - trace, не kprintf
+    TRACE_INFO(TRACE_DECK_ERROR, entry->event_id, error_code);
+
+    // Guide отправит entry в Execution (abort_flag)
+    deck_step_ready(entry);
 }
 
 // Deck вызывает эту функцию при ОШИБКЕ с полным контекстом (recommended)
@@ -88,15 +180,23 @@ static inline void deck_error_detailed(RoutingEntry* entry, uint8_t deck_prefix,
     atomic_store_u32(&entry->abort_flag, 1);
     entry->error_code = error_code;
     entry->deck_timestamps[deck_prefix - 1] = rdtsc();
+    latency_stats_record_step(entry, deck_prefix, entry->deck_timestamps[deck_prefix - 1]);
 
     // Затираем prefix чтобы Guide мог продолжить
     routing_entry_clear_prefix(entry, deck_prefix);
 
-    // Create and log error context
+    // Каждая ошибка - trace. Полный контекст в консоль только для FATAL:
+    // остальные (bad payload и т.п.) user может сыпать на каждое событие
+    TRACE_INFO(TRACE_DECK_ERROR, entry->event_id, error_code);
     ErrorContext err_ctx;
     error_context_init(&err_ctx, error_code, deck_prefix,
                       entry->event_id, entry->event_copy.user_id, message);
-    error_log(&err_ctx);
+    if (err_ctx.severity == ERROR_SEVERITY_FATAL) {
+        error_log(&err_ctx);
+    }
+
+    // Guide отправит entry в Execution (abort_flag)
+    deck_step_ready(entry);
 }
 
 #endif // DECK_INTERFACE_H
@@ -2,65 +2,20 @@
 #include "klib.h"
 #include "vga.h"
 #include "keyboard.h"
+#include "trace.h"
+#include "latency_stats.h"
+#include "hardware_timer.h"
 
 // ============================================================================
 // HARDWARE DECK - Timer, Device & Console Operations
 // ============================================================================
 
-// Timer descriptor
-typedef struct {
-    uint64_t id;
-    uint64_t owner_workflow_id;  // Workflow that owns this timer
-    uint64_t expiration;         // TSC timestamp
-    uint64_t interval;           // 0 = one-shot, >0 = periodic
-    uint64_t event_id;           // Event to trigger on expiration
-    RoutingEntry* suspended_entry; // Suspended RoutingEntry waiting for this timer
-    int active;
-} Timer;
-
-#define MAX_TIMERS 64
-static Timer timers[MAX_TIMERS];
-static volatile uint64_t next_timer_id = 1;
-
 // ============================================================================
 // TIMER OPERATIONS (Integrated with Task system)
 // ============================================================================
-
-static Timer* timer_create(uint64_t delay_ms, uint64_t interval_ms, RoutingEntry* entry) {
-    // Находим свободный slot
-    for (int i = 0; i < MAX_TIMERS; i++) {
-        if (!timers[i].active) {
-            timers[i].id = atomic_increment_u64(&next_timer_id);
-
-            // Get workflow ID from entry (user_id field stores workflow_id)
-            timers[i].owner_workflow_id = entry ? entry->event_copy.user_id : 0;
-
-            timers[i].expiration = rdtsc() + (delay_ms * 2400000);  // Примерная конверсия ms->TSC
-            timers[i].interval = interval_ms * 2400000;
-            timers[i].suspended_entry = entry;  // Link to suspended RoutingEntry
-            timers[i].active = 1;
-
-            kprintf("[HARDWARE] Created timer %lu: delay=%lu ms, interval=%lu ms (entry=%p)\n",
-                    timers[i].id, delay_ms, interval_ms, (void*)entry);
-
-            return &timers[i];
-        }
-    }
-
-    kprintf("[HARDWARE] ERROR: No free timer slots!\n");
-    return 0;
-}
-
-static int timer_cancel(uint64_t timer_id) {
-    for (int i = 0; i < MAX_TIMERS; i++) {
-        if (timers[i].active && timers[i].id == timer_id) {
-            timers[i].active = 0;
-            kprintf("[HARDWARE] Cancelled timer %lu\n", timer_id);
-            return 1;
-        }
-    }
-    return 0;  // Not found
-}
+//
+// Таймеры - hardware_timer.c (timer wheel), здесь - только события
+//
 
 static void timer_sleep(uint64_t ms) {
     // TODO: Workflow sleep (будет реализовано с Workflow Engine)
@@ -78,40 +33,6 @@ static uint64_t timer_get_ticks(void) {
     return rdtsc();
 }
 
-// Проверка истёкших таймеров (вызывается периодически)
-static void timer_check_expired(void) {
-    uint64_t now = rdtsc();
-
-    for (int i = 0; i < MAX_TIMERS; i++) {
-        if (timers[i].active && now >= timers[i].expiration) {
-            kprintf("[HARDWARE] Timer %lu expired!\n", timers[i].id);
-
-            // Wake up suspended workflow entry
-            if (timers[i].suspended_entry) {
-                RoutingEntry* entry = timers[i].suspended_entry;
-
-                // Complete the suspended event (no result for sleep)
-                deck_complete(entry, DECK_PREFIX_HARDWARE, 0, RESULT_TYPE_NONE);
-
-                // Change state from SUSPENDED back to PROCESSING
-                entry->state = EVENT_STATUS_PROCESSING;
-
-                kprintf("[HARDWARE] Woke up suspended entry (event_id=%lu)\n", entry->event_id);
-
-                // Clear the suspended_entry link
-                timers[i].suspended_entry = 0;
-            }
-
-            // Если periodic - перезапускаем
-            if (timers[i].interval > 0) {
-                timers[i].expiration = now + timers[i].interval;
-            } else {
-                timers[i].active = 0;  // One-shot
-            }
-        }
-    }
-}
-
 // ============================================================================
 // DEVICE OPERATIONS (STUBS - для v1)
 // ============================================================================
@@ -136,6 +57,156 @@ static int device_write(int device_id, const void* buffer, uint64_t size) {
     return size;
 }
 
+// ============================================================================
+// CONSOLE INPUT - READ_LINE / READ_CHAR ждут клавиш в SUSPENDED
+// ============================================================================
+//
+// Раньше READ_LINE крутил keyboard_getchar_blocking() прямо в deck loop:
+// пока человек печатал, Hardware deck не брал других событий. Теперь
+// событие паркуется (SUSPENDED) в FIFO читателей, IRQ 1 кладёт scancode в
+// lock-free ring и будит BSP (clock_event_kick), а console_input_poll() из
+// hardware_deck_run_once() раздаёт символы первому читателю - echo, line
+// editing - и возвращает готовые entries в Guide, как таймеры sleep.
+//
+#define CONSOLE_READERS_MAX 16
+
+typedef struct {
+    RoutingEntry* entry;
+    char* line;                 // READ_LINE: kmalloc буфер; NULL = READ_CHAR
+    uint32_t max_size;
+    uint32_t pos;
+} ConsoleReader;
+
+static ConsoleReader console_readers[CONSOLE_READERS_MAX];
+static uint32_t console_reader_head = 0;
+static uint32_t console_reader_count = 0;
+static spinlock_t console_lock;
+
+// 0 = очередь читателей полна
+static int console_reader_park(RoutingEntry* entry, char* line, uint32_t max_size) {
+    spin_lock(&console_lock);
+    if (console_reader_count >= CONSOLE_READERS_MAX) {
+        spin_unlock(&console_lock);
+        return 0;
+    }
+
+    // SUSPENDED до того, как reader виден poll'у
+    entry->state = EVENT_STATUS_SUSPENDED;
+
+    ConsoleReader* reader = &console_readers[(console_reader_head + console_reader_count) % CONSOLE_READERS_MAX];
+    reader->entry = entry;
+    reader->line = line;
+    reader->max_size = max_size;
+    reader->pos = 0;
+    console_reader_count++;
+    spin_unlock(&console_lock);
+    return 1;
+}
+
+// Символ текущему читателю. 1 = читатель получил всё
+static int console_reader_feed(ConsoleReader* reader, char c) {
+    if (!reader->line) {
+        reader->pos = (uint8_t)c;  // READ_CHAR: результат - сам символ
+        return 1;
+    }
+
+    if (c == '\n' || c == '\r') {
+        vga_print_newline();
+        return 1;
+    } else if (c == '\b') {
+        // Backspace
+        if (reader->pos > 0) {
+            reader->pos--;
+            // Move cursor back and clear character
+            unsigned int loc = vga_get_current_loc();
+            if (loc >= 2) {
+                vga_set_current_loc(loc - 2);
+                vga_print_char(' ', VGA_DEFAULT);
+                vga_set_current_loc(loc - 2);
+            }
+        }
+    } else if (c >= 0x20 && c <= 0x7E) {
+        // Printable character
+        reader->line[reader->pos++] = c;
+        vga_print_char(c, VGA_INPUT);
+    }
+    return reader->pos >= reader->max_size - 1;
+}
+
+// Раздать накопленные клавиши. Возвращает число завершённых читателей
+static uint32_t console_input_poll(void) {
+    if (console_reader_count == 0 || !keyboard_has_input()) {
+        return 0;
+    }
+
+    ConsoleReader done[CONSOLE_READERS_MAX];
+    uint32_t done_count = 0;
+
+    spin_lock(&console_lock);
+    while (console_reader_count > 0) {
+        char c = keyboard_getchar();
+        if (!c) {
+            break;
+        }
+
+        ConsoleReader* reader = &console_readers[console_reader_head];
+        if (console_reader_feed(reader, c)) {
+            done[done_count++] = *reader;
+            console_reader_head = (console_reader_head + 1) % CONSOLE_READERS_MAX;
+            console_reader_count--;
+        }
+    }
+    vga_update_cursor();  // Echo - одним batch
+    spin_unlock(&console_lock);
+
+    // deck_complete() - вне console_lock, идёт в Guide
+    // (SUSPENDED → PROCESSING он делает сам, до публикации)
+    for (uint32_t i = 0; i < done_count; i++) {
+        RoutingEntry* entry = done[i].entry;
+        if (done[i].line) {
+            done[i].line[done[i].pos] = '\0';
+            deck_complete(entry, DECK_PREFIX_HARDWARE, done[i].line, RESULT_TYPE_KMALLOC);
+        } else {
+            deck_complete(entry, DECK_PREFIX_HARDWARE, (void*)(uint64_t)done[i].pos, RESULT_TYPE_VALUE);
+        }
+    }
+    return done_count;
+}
+
+// Процесс завершается (process_destroy): его читатели не должны забирать
+// клавиши у живых. Снимаем их с FIFO (порядок остальных сохраняется) и
+// завершаем ошибкой - результат Execution Deck мёртвому не доставит
+void hardware_deck_release_owner(uint64_t owner_pid) {
+    ConsoleReader dropped[CONSOLE_READERS_MAX];
+    uint32_t dropped_count = 0;
+    uint32_t kept = 0;
+
+    spin_lock(&console_lock);
+    for (uint32_t i = 0; i < console_reader_count; i++) {
+        ConsoleReader reader = console_readers[(console_reader_head + i) % CONSOLE_READERS_MAX];
+        if (reader.entry->result_owner && reader.entry->result_pid == owner_pid) {
+            dropped[dropped_count++] = reader;
+            continue;
+        }
+        console_readers[(console_reader_head + kept) % CONSOLE_READERS_MAX] = reader;
+        kept++;
+    }
+    console_reader_count = kept;
+    spin_unlock(&console_lock);
+
+    for (uint32_t i = 0; i < dropped_count; i++) {
+        if (dropped[i].line) {
+            kfree(dropped[i].line);
+        }
+        deck_error_detailed(dropped[i].entry, DECK_PREFIX_HARDWARE, ERROR_HW_DEVICE_BUSY,
+                          "Console read: owner exited");
+    }
+
+    if (dropped_count > 0) {
+        kprintf("[HARDWARE] Dropped %u console reader(s) of PID=%lu\n", dropped_count, owner_pid);
+    }
+}
+
 // ============================================================================
 // PROCESSING FUNCTION
 // ============================================================================
@@ -148,10 +219,11 @@ int hardware_deck_process(RoutingEntry* entry) {
     }
 
     Event* event = &entry->event_copy;
+    uint8_t* payload = entry->payload;  // Kernel копия payload (снимок ingestion)
 
     // DEFENSIVE: Validate event type is in hardware range
     // Timer operations: 50-59, Device operations: 40-49
-    // Console operations: 70-79 (NEW for shell support)
+    // Console operations: 70-76 (NEW for shell support), system: 77-79
     int valid_type = (event->type >= 40 && event->type < 80);
     if (!valid_type) {
         deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_INVALID_PARAMETER,
@@ -163,8 +235,8 @@ int hardware_deck_process(RoutingEntry* entry) {
         // === TIMER OPERATIONS ===
         case EVENT_TIMER_CREATE: {
             // Payload: [delay_ms:8][interval_ms:8]
-            uint64_t delay_ms = *(uint64_t*)event->data;
-            uint64_t interval_ms = *(uint64_t*)(event->data + 8);
+            uint64_t delay_ms = *(uint64_t*)payload;
+            uint64_t interval_ms = *(uint64_t*)(payload + 8);
 
             // DEFENSIVE: Validate delay
             if (delay_ms == 0) {
@@ -187,12 +259,11 @@ int hardware_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
-            Timer* timer = timer_create(delay_ms, interval_ms, NULL);  // NULL = not suspended
+            uint64_t timer_id = hardware_timer_create(delay_ms, interval_ms, NULL);  // NULL = not suspended
 
-            if (timer) {
-                deck_complete(entry, DECK_PREFIX_HARDWARE, timer, RESULT_TYPE_STATIC);
-                kprintf("[HARDWARE] Event %lu: created timer %lu\n",
-                        event->id, timer->id);
+            if (timer_id) {
+                // Результат - id (для EVENT_TIMER_CANCEL)
+                deck_complete(entry, DECK_PREFIX_HARDWARE, (void*)timer_id, RESULT_TYPE_VALUE);
                 return 1;
             }
             deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_HW_TIMER_SLOTS_FULL,
@@ -202,7 +273,7 @@ int hardware_deck_process(RoutingEntry* entry) {
 
         case EVENT_TIMER_CANCEL: {
             // DEFENSIVE: Validate timer ID
-            uint64_t timer_id = *(uint64_t*)event->data;
+            uint64_t timer_id = *(uint64_t*)payload;
 
             if (timer_id == 0) {
                 deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_INVALID_PARAMETER,
@@ -210,11 +281,9 @@ int hardware_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
-            int success = timer_cancel(timer_id);
+            int success = hardware_timer_cancel(timer_id);
             if (success) {
                 deck_complete(entry, DECK_PREFIX_HARDWARE, 0, RESULT_TYPE_NONE);
-                kprintf("[HARDWARE] Event %lu: cancelled timer %lu\n",
-                        event->id, timer_id);
                 return 1;
             } else {
                 deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_HW_TIMER_NOT_FOUND,
@@ -224,7 +293,7 @@ int hardware_deck_process(RoutingEntry* entry) {
         }
 
         case EVENT_TIMER_SLEEP: {
-            uint64_t ms = *(uint64_t*)event->data;
+            uint64_t ms = *(uint64_t*)payload;
 
             // DEFENSIVE: Validate sleep duration
             if (ms == 0) {
@@ -240,21 +309,19 @@ int hardware_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
-            // Create one-shot timer linked to this entry (workflow suspension)
-            Timer* timer = timer_create(ms, 0, entry);  // 0 interval = one-shot
-
-            if (timer) {
-                // Mark entry as SUSPENDED - it will be completed when timer expires
-                entry->state = EVENT_STATUS_SUSPENDED;
+            // Mark entry as SUSPENDED до создания - таймер может сработать сразу
+            entry->state = EVENT_STATUS_SUSPENDED;
 
-                kprintf("[HARDWARE] Event %lu: suspended for %lu ms (timer %lu)\n",
-                        event->id, ms, timer->id);
+            // Create one-shot timer linked to this entry (workflow suspension)
+            uint64_t timer_id = hardware_timer_create(ms, 0, entry);  // 0 interval = one-shot
 
-                // Do NOT call deck_complete() - timer_check_expired() will do it
+            if (timer_id) {
+                // Do NOT call deck_complete() - hardware_timer_expire() will do it
                 return 1;
             }
 
             // Failed to create timer - fall back to error
+            entry->state = EVENT_STATUS_PROCESSING;
             deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_HW_TIMER_SLOTS_FULL,
                               "Timer sleep: no free timer slots");
             return 0;
@@ -270,7 +337,7 @@ int hardware_deck_process(RoutingEntry* entry) {
         // === DEVICE OPERATIONS (STUBS) ===
         case EVENT_DEV_OPEN: {
             // DEFENSIVE: Validate device name
-            const char* name = (const char*)event->data;
+            const char* name = (const char*)payload;
 
             if (!name || name[0] == 0) {
                 deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_INVALID_PARAMETER,
@@ -296,9 +363,9 @@ int hardware_deck_process(RoutingEntry* entry) {
 
         case EVENT_DEV_IOCTL: {
             // Payload: [device_id:4][command:8][arg:...]
-            int device_id = *(int*)event->data;
-            uint64_t command = *(uint64_t*)(event->data + 4);
-            void* arg = event->data + 12;
+            int device_id = *(int*)payload;
+            uint64_t command = *(uint64_t*)(payload + 4);
+            void* arg = payload + 12;
 
             // DEFENSIVE: Validate device ID
             if (device_id < 0) {
@@ -315,8 +382,8 @@ int hardware_deck_process(RoutingEntry* entry) {
 
         case EVENT_DEV_READ: {
             // Payload: [device_id:4][size:8]
-            int device_id = *(int*)event->data;
-            uint64_t size = *(uint64_t*)(event->data + 4);
+            int device_id = *(int*)payload;
+            uint64_t size = *(uint64_t*)(payload + 4);
 
             // DEFENSIVE: Validate device ID
             if (device_id < 0) {
@@ -347,9 +414,9 @@ int hardware_deck_process(RoutingEntry* entry) {
 
         case EVENT_DEV_WRITE: {
             // Payload: [device_id:4][size:8][data:...]
-            int device_id = *(int*)event->data;
-            uint64_t size = *(uint64_t*)(event->data + 4);
-            void* data = event->data + 12;
+            int device_id = *(int*)payload;
+            uint64_t size = *(uint64_t*)(payload + 4);
+            void* data = payload + 12;
 
             // DEFENSIVE: Validate device ID
             if (device_id < 0) {
@@ -384,8 +451,8 @@ int hardware_deck_process(RoutingEntry* entry) {
 
         case EVENT_CONSOLE_WRITE: {
             // Payload: [size:4][string:...]
-            uint32_t size = *(uint32_t*)event->data;
-            const char* str = (const char*)(event->data + 4);
+            uint32_t size = *(uint32_t*)payload;
+            const char* str = (const char*)(payload + 4);
 
             if (size == 0 || size > EVENT_DATA_SIZE - 4) {
                 deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_INVALID_PARAMETER,
@@ -409,9 +476,9 @@ int hardware_deck_process(RoutingEntry* entry) {
 
         case EVENT_CONSOLE_WRITE_ATTR: {
             // Payload: [attr:1][size:4][string:...]
-            uint8_t attr = *(uint8_t*)event->data;
-            uint32_t size = *(uint32_t*)(event->data + 1);
-            const char* str = (const char*)(event->data + 5);
+            uint8_t attr = *(uint8_t*)payload;
+            uint32_t size = *(uint32_t*)(payload + 1);
+            const char* str = (const char*)(payload + 5);
 
             if (size == 0 || size > EVENT_DATA_SIZE - 5) {
                 deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_INVALID_PARAMETER,
@@ -435,7 +502,7 @@ int hardware_deck_process(RoutingEntry* entry) {
 
         case EVENT_CONSOLE_READ_LINE: {
             // Payload: [max_size:4]
-            uint32_t max_size = *(uint32_t*)event->data;
+            uint32_t max_size = *(uint32_t*)payload;
 
             if (max_size == 0 || max_size > 256) {
                 max_size = 256;  // Default/max line size
@@ -449,43 +516,30 @@ int hardware_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
-            // Read characters until Enter or max_size
-            uint32_t pos = 0;
-            while (pos < max_size - 1) {
-                char c = keyboard_getchar_blocking();
-
-                if (c == '\n' || c == '\r') {
-                    vga_print_newline();
-                    break;
-                } else if (c == '\b') {
-                    // Backspace
-                    if (pos > 0) {
-                        pos--;
-                        // Move cursor back and clear character
-                        unsigned int loc = vga_get_current_loc();
-                        if (loc >= 2) {
-                            vga_set_current_loc(loc - 2);
-                            vga_print_char(' ', VGA_DEFAULT);
-                            vga_set_current_loc(loc - 2);
-                        }
-                    }
-                } else if (c >= 0x20 && c <= 0x7E) {
-                    // Printable character
-                    line[pos++] = c;
-                    vga_print_char(c, VGA_INPUT);
-                }
+            // Места только под '\0' - ждать нечего
+            if (max_size < 2) {
+                line[0] = '\0';
+                deck_complete(entry, DECK_PREFIX_HARDWARE, line, RESULT_TYPE_KMALLOC);
+                return 1;
             }
-            line[pos] = '\0';
 
-            deck_complete(entry, DECK_PREFIX_HARDWARE, line, RESULT_TYPE_KMALLOC);
+            // Символы придут позже: console_input_poll() завершит entry
+            if (!console_reader_park(entry, line, max_size)) {
+                kfree(line);
+                deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_HW_DEVICE_BUSY,
+                                  "Console read line: too many pending readers");
+                return 0;
+            }
             return 1;
         }
 
         case EVENT_CONSOLE_READ_CHAR: {
-            // Non-blocking single char read
-            char c = keyboard_getchar();  // Returns 0 if no input
-
-            deck_complete(entry, DECK_PREFIX_HARDWARE, (void*)(uint64_t)c, RESULT_TYPE_VALUE);
+            // Блокирующий (ulib getchar): SUSPENDED до первой клавиши
+            if (!console_reader_park(entry, NULL, 0)) {
+                deck_error_detailed(entry, DECK_PREFIX_HARDWARE, ERROR_HW_DEVICE_BUSY,
+                                  "Console read char: too many pending readers");
+                return 0;
+            }
             return 1;
         }
 
@@ -497,8 +551,8 @@ int hardware_deck_process(RoutingEntry* entry) {
 
         case EVENT_CONSOLE_SET_POS: {
             // Payload: [x:4][y:4]
-            int x = *(int*)event->data;
-            int y = *(int*)(event->data + 4);
+            int x = *(int*)payload;
+            int y = *(int*)(payload + 4);
 
             vga_set_cursor_position(x, y);
             deck_complete(entry, DECK_PREFIX_HARDWARE, 0, RESULT_TYPE_NONE);
@@ -515,6 +569,37 @@ int hardware_deck_process(RoutingEntry* entry) {
             return 1;
         }
 
+        // === SYSTEM (diagnostics) ===
+        case EVENT_SYSTEM_TRACE: {
+            // Payload: [max_records:4] (0 или пустой payload = все)
+            uint32_t max_records = 0;
+            if (entry->payload_size >= sizeof(uint32_t)) {
+                max_records = *(uint32_t*)payload;
+            }
+
+            uint32_t printed = trace_drain(max_records);
+            deck_complete(entry, DECK_PREFIX_HARDWARE, (void*)(uint64_t)printed, RESULT_TYPE_VALUE);
+            return 1;
+        }
+
+        case EVENT_SYSTEM_STATS: {
+            // Payload: [deck:4] - DECK_PREFIX_* (0 = Execution) -> p99 service ns,
+            // LATENCY_STATS_QUERY_ALL (или пустой payload) -> отчёт в консоль
+            uint32_t deck = LATENCY_STATS_QUERY_ALL;
+            if (entry->payload_size >= sizeof(uint32_t)) {
+                deck = *(uint32_t*)payload;
+            }
+
+            uint64_t value = 0;
+            if (deck < LATENCY_STATS_DECKS) {
+                value = latency_stats_deck_p99_ns((uint8_t)deck);
+            } else {
+                latency_stats_print();
+            }
+            deck_complete(entry, DECK_PREFIX_HARDWARE, (void*)value, RESULT_TYPE_VALUE);
+            return 1;
+        }
+
         default:
             // PRODUCTION: Detailed error for unknown operations
             kprintf("[HARDWARE] ERROR: Unknown/unimplemented event type %d\n", event->type);
@@ -531,22 +616,28 @@ int hardware_deck_process(RoutingEntry* entry) {
 DeckContext hardware_deck_context;
 
 void hardware_deck_init(void) {
-    // Очищаем все таймеры
-    for (int i = 0; i < MAX_TIMERS; i++) {
-        timers[i].active = 0;
-    }
+    hardware_timer_init();
+    spinlock_init(&console_lock);
 
     deck_init(&hardware_deck_context, "Hardware", DECK_PREFIX_HARDWARE, hardware_deck_process);
 }
 
 int hardware_deck_run_once(void) {
-    // Проверяем истёкшие таймеры
-    timer_check_expired();
+    // Проверяем истёкшие таймеры и ждущих ввода с клавиатуры
+    hardware_timer_expire();
+    console_input_poll();
 
     // Обрабатываем события
     return deck_run_once(&hardware_deck_context);
 }
 
 void hardware_deck_run(void) {
-    deck_run(&hardware_deck_context);
+    // Не deck_run(): таймеры проверяются в hardware_deck_run_once()
+    kprintf("[DECK:%s] Starting main loop...\n", hardware_deck_context.stats.name);
+
+    while (1) {
+        if (!hardware_deck_run_once()) {
+            cpu_pause();
+        }
+    }
 }
@@ -0,0 +1,360 @@
+#include "hardware_timer.h"
+#include "atomics.h"
+#include "klib.h"
+#include "slab.h"
+#include "trace.h"
+#include "clock.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+typedef struct HardwareTimer {
+    uint64_t id;
+    uint64_t owner_workflow_id;             // Workflow владельца (user_id события)
+    uint64_t expires;                       // Единица wheel (HARDWARE_TIMER_RESOLUTION_US)
+    uint64_t interval;                      // Единиц, 0 = one-shot
+    RoutingEntry* suspended_entry;          // SUSPENDED entry (EVENT_TIMER_SLEEP)
+    struct HardwareTimer* next;             // Слот wheel / список сработавших
+    struct HardwareTimer** pprev;           // Ссылка на нас в слоте (unlink за O(1))
+    struct HardwareTimer* hash_next;
+    uint32_t level;                         // Где лежит (для timer_pending)
+    uint32_t slot;
+} HardwareTimer;
+
+// Дальше - в верхний уровень, cascade переложит ближе к сроку
+#define TIMER_WHEEL_RANGE  (1ULL << (HARDWARE_TIMER_SLOT_BITS * HARDWARE_TIMER_LEVELS))
+
+static inline uint64_t timer_now(void) {
+    return clock_ns() / (HARDWARE_TIMER_RESOLUTION_US * 1000ULL);
+}
+
+static HardwareTimer* timer_wheel[HARDWARE_TIMER_LEVELS][HARDWARE_TIMER_SLOTS];
+static uint64_t timer_pending[HARDWARE_TIMER_LEVELS];  // Бит = слот не пуст
+static HardwareTimer* timer_hash[HARDWARE_TIMER_HASH_BUCKETS];
+static uint64_t timer_next = 0;             // Первая ещё не обработанная единица
+static uint64_t timer_active = 0;
+static volatile uint64_t next_timer_id = 1;
+static spinlock_t timer_lock;
+static SlabCache timer_cache;
+
+static struct {
+    volatile uint64_t created;
+    volatile uint64_t cancelled;
+    volatile uint64_t expired;
+    volatile uint64_t cascaded;     // Переездов на нижний уровень
+    volatile uint64_t rejected;     // Лимит HARDWARE_TIMER_MAX / нет памяти
+    uint64_t max_active;
+} timer_stats;
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void hardware_timer_init(void) {
+    slab_cache_init(&timer_cache, "hw_timer", sizeof(HardwareTimer), NULL);
+    spinlock_init(&timer_lock);
+    memset(timer_wheel, 0, sizeof(timer_wheel));
+    memset(timer_pending, 0, sizeof(timer_pending));
+    memset(timer_hash, 0, sizeof(timer_hash));
+    memset(&timer_stats, 0, sizeof(timer_stats));
+    timer_active = 0;
+    timer_next = timer_now();
+
+    kprintf("[HARDWARE] Timer wheel: %d levels x %d slots, %d us resolution, range %lu s, max %d timers\n",
+            HARDWARE_TIMER_LEVELS, HARDWARE_TIMER_SLOTS, HARDWARE_TIMER_RESOLUTION_US,
+            TIMER_WHEEL_RANGE / HARDWARE_TIMER_UNITS_PER_MS / 1000, HARDWARE_TIMER_MAX);
+}
+
+// ============================================================================
+// WHEEL (под timer_lock)
+// ============================================================================
+
+static void wheel_insert(HardwareTimer* timer) {
+    uint64_t expires = timer->expires;
+    if (expires < timer_next) {
+        expires = timer_next;  // Уже просрочен - ближайший проход
+    }
+
+    uint64_t delta = expires - timer_next;
+    if (delta >= TIMER_WHEEL_RANGE) {
+        delta = TIMER_WHEEL_RANGE - 1;
+        expires = timer_next + delta;
+    }
+
+    // Уровень level держит таймеры на расстоянии < SLOTS^(level+1) единиц
+    uint32_t level = 0;
+    while (level < HARDWARE_TIMER_LEVELS - 1 &&
+           (delta >> (HARDWARE_TIMER_SLOT_BITS * (level + 1))) != 0) {
+        level++;
+    }
+
+    uint32_t slot = (uint32_t)(expires >> (HARDWARE_TIMER_SLOT_BITS * level)) & HARDWARE_TIMER_SLOT_MASK;
+    HardwareTimer** head = &timer_wheel[level][slot];
+
+    timer->next = *head;
+    if (*head) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+    timer->level = level;
+    timer->slot = slot;
+    timer_pending[level] |= 1ULL << slot;
+}
+
+static void wheel_unlink(HardwareTimer* timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    if (!timer_wheel[timer->level][timer->slot]) {
+        timer_pending[timer->level] &= ~(1ULL << timer->slot);
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+// Забрать весь слот
+static HardwareTimer* wheel_take_slot(uint32_t level, uint32_t slot) {
+    HardwareTimer* timer = timer_wheel[level][slot];
+    timer_wheel[level][slot] = NULL;
+    timer_pending[level] &= ~(1ULL << slot);
+    return timer;
+}
+
+// Разложить слот уровня level по нижним (срок теперь ближе)
+static void wheel_cascade(uint32_t level, uint32_t slot) {
+    HardwareTimer* timer = wheel_take_slot(level, slot);
+
+    while (timer) {
+        HardwareTimer* next = timer->next;
+        wheel_insert(timer);
+        timer_stats.cascaded++;
+        timer = next;
+    }
+}
+
+// Первая единица >= timer_next, на которой wheel есть что делать: слот level 0
+// срабатывает или непустой слот верхнего уровня раскладывается (cascade).
+// Слот s уровня l трогают на первой границе SLOTS^l с индексом s.
+// UINT64_MAX = wheel пуст
+static uint64_t wheel_next_unit(void) {
+    uint64_t best = UINT64_MAX;
+
+    for (uint32_t level = 0; level < HARDWARE_TIMER_LEVELS; level++) {
+        uint64_t bits = timer_pending[level];
+        if (!bits) {
+            continue;
+        }
+
+        uint32_t shift = HARDWARE_TIMER_SLOT_BITS * level;
+        uint64_t first = (timer_next + (1ULL << shift) - 1) >> shift;  // Первая граница
+        uint32_t rot = (uint32_t)first & HARDWARE_TIMER_SLOT_MASK;
+
+        // Маска, повёрнутая так, что бит 0 - слот первой границы
+        uint64_t ahead = (bits >> rot) | (bits << ((HARDWARE_TIMER_SLOTS - rot) & HARDWARE_TIMER_SLOT_MASK));
+        uint64_t unit = (first + __builtin_ctzll(ahead)) << shift;
+        if (unit < best) {
+            best = unit;
+        }
+    }
+    return best;
+}
+
+static inline HardwareTimer** hash_bucket(uint64_t id) {
+    return &timer_hash[id & (HARDWARE_TIMER_HASH_BUCKETS - 1)];
+}
+
+static void hash_remove(HardwareTimer* timer) {
+    HardwareTimer** link = hash_bucket(timer->id);
+    while (*link != timer) {
+        link = &(*link)->hash_next;
+    }
+    *link = timer->hash_next;
+    timer->hash_next = NULL;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+uint64_t hardware_timer_create(uint64_t delay_ms, uint64_t interval_ms, RoutingEntry* entry) {
+    HardwareTimer* timer = (HardwareTimer*)slab_cache_alloc(&timer_cache);
+    if (!timer) {
+        atomic_increment_u64(&timer_stats.rejected);
+        return 0;
+    }
+
+    timer->id = atomic_increment_u64(&next_timer_id);
+    timer->owner_workflow_id = entry ? entry->event_copy.user_id : 0;
+    timer->interval = interval_ms * HARDWARE_TIMER_UNITS_PER_MS;
+    timer->suspended_entry = entry;
+    timer->hash_next = NULL;
+
+    spin_lock(&timer_lock);
+
+    if (timer_active >= HARDWARE_TIMER_MAX) {
+        spin_unlock(&timer_lock);
+        slab_cache_free(&timer_cache, timer);
+        atomic_increment_u64(&timer_stats.rejected);
+        return 0;
+    }
+
+    // +1: текущая единица уже идёт - раньше срока не срабатываем
+    timer->expires = timer_now() + 1 + delay_ms * HARDWARE_TIMER_UNITS_PER_MS;
+    wheel_insert(timer);
+
+    HardwareTimer** bucket = hash_bucket(timer->id);
+    timer->hash_next = *bucket;
+    *bucket = timer;
+
+    timer_active++;
+    if (timer_active > timer_stats.max_active) {
+        timer_stats.max_active = timer_active;
+    }
+    uint64_t id = timer->id;  // После unlock таймер может уже сработать
+
+    spin_unlock(&timer_lock);
+
+    atomic_increment_u64(&timer_stats.created);
+    return id;
+}
+
+int hardware_timer_cancel(uint64_t id) {
+    spin_lock(&timer_lock);
+
+    HardwareTimer** link = hash_bucket(id);
+    while (*link && (*link)->id != id) {
+        link = &(*link)->hash_next;
+    }
+
+    HardwareTimer* timer = *link;
+    if (!timer) {
+        spin_unlock(&timer_lock);
+        return 0;
+    }
+
+    *link = timer->hash_next;
+    wheel_unlink(timer);
+    timer_active--;
+
+    spin_unlock(&timer_lock);
+
+    slab_cache_free(&timer_cache, timer);
+    atomic_increment_u64(&timer_stats.cancelled);
+    return 1;
+}
+
+uint32_t hardware_timer_expire(void) {
+    uint64_t now = timer_now();
+    if (now < timer_next) {
+        return 0;  // Эта единица уже обработана (чтение без lock - только подсказка)
+    }
+
+    HardwareTimer* fired = NULL;
+    HardwareTimer** fired_tail = &fired;
+    uint32_t count = 0;
+
+    spin_lock(&timer_lock);
+
+    while (timer_next <= now) {
+        // Пустые единицы не перебираем: после tickless простоя их тысячи
+        uint64_t next = wheel_next_unit();
+        if (next > now) {
+            timer_next = now + 1;
+            break;
+        }
+        timer_next = next;
+
+        uint32_t index = (uint32_t)timer_next & HARDWARE_TIMER_SLOT_MASK;
+
+        // Level 0 пошёл на новый круг - следующий слот верхних уровней вниз
+        if (index == 0) {
+            for (uint32_t level = 1; level < HARDWARE_TIMER_LEVELS; level++) {
+                uint32_t slot = (uint32_t)(timer_next >> (HARDWARE_TIMER_SLOT_BITS * level)) &
+                                HARDWARE_TIMER_SLOT_MASK;
+                wheel_cascade(level, slot);
+                if (slot != 0) {
+                    break;
+                }
+            }
+        }
+
+        HardwareTimer* timer = wheel_take_slot(0, index);
+
+        while (timer) {
+            HardwareTimer* next = timer->next;
+            TRACE_DEBUG(TRACE_TIMER_EXPIRE, timer->id, now - timer->expires);
+            count++;
+
+            if (timer->interval > 0) {
+                // Periodic: следующий срок от прошлого (без дрейфа), пропущенные не копятся
+                timer->expires += timer->interval;
+                if (timer->expires <= now) {
+                    timer->expires = now + timer->interval;
+                }
+                wheel_insert(timer);
+            } else {
+                hash_remove(timer);
+                timer_active--;
+                timer->next = NULL;
+                timer->pprev = NULL;
+                *fired_tail = timer;
+                fired_tail = &timer->next;
+            }
+            timer = next;
+        }
+
+        timer_next++;
+    }
+
+    spin_unlock(&timer_lock);
+
+    // SUSPENDED entries - вне timer_lock: deck_complete() идёт в Guide
+    while (fired) {
+        HardwareTimer* next = fired->next;
+        RoutingEntry* entry = fired->suspended_entry;
+
+        if (entry) {
+            // Complete the suspended event (no result for sleep).
+            // SUSPENDED → PROCESSING делает deck_complete до публикации
+            deck_complete(entry, DECK_PREFIX_HARDWARE, 0, RESULT_TYPE_NONE);
+        }
+
+        slab_cache_free(&timer_cache, fired);
+        fired = next;
+    }
+
+    if (count > 0) {
+        atomic_add_u64(&timer_stats.expired, count);
+    }
+    return count;
+}
+
+uint64_t hardware_timer_next_deadline(void) {
+    if (timer_active == 0) {
+        return 0;  // Подсказка без lock
+    }
+
+    spin_lock(&timer_lock);
+    uint64_t unit = wheel_next_unit();
+    spin_unlock(&timer_lock);
+
+    if (unit == UINT64_MAX) {
+        return 0;
+    }
+    return clock_tsc_at(unit * HARDWARE_TIMER_RESOLUTION_US * 1000ULL);
+}
+
+void hardware_timer_print_stats(void) {
+    kprintf("\n%[H]=== Hardware Timers ===%[D]\n");
+    kprintf("  active=%lu max=%lu created=%lu cancelled=%lu expired=%lu\n",
+            timer_active, timer_stats.max_active,
+            atomic_load_u64(&timer_stats.created),
+            atomic_load_u64(&timer_stats.cancelled),
+            atomic_load_u64(&timer_stats.expired));
+    kprintf("  cascaded=%lu rejected=%lu\n",
+            timer_stats.cascaded,
+            atomic_load_u64(&timer_stats.rejected));
+}
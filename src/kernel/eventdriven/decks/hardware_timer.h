@@ -0,0 +1,63 @@
+#ifndef HARDWARE_TIMER_H
+#define HARDWARE_TIMER_H
+
+#include "deck_interface.h"
+
+// ============================================================================
+// HARDWARE TIMERS - иерархическое hashed timer wheel Hardware deck
+// ============================================================================
+//
+// Время wheel - единицы по HARDWARE_TIMER_RESOLUTION_US от загрузки (clock_ns(),
+// TSC clocksource). HARDWARE_TIMER_LEVELS уровней по HARDWARE_TIMER_SLOTS слотов:
+//
+//   level 0: слот = 100 us      (до 6.4 ms вперёд)
+//   level 1: слот = 6.4 ms      (до ~410 ms)
+//   level 2: слот = ~410 ms     (до ~26 s)
+//   level 3: слот = ~26 s       (до ~28 min)
+//   level 4: слот = ~28 min     (до ~30 h)
+//
+// Таймер кладётся в уровень по расстоянию до срабатывания - O(1). Когда
+// индекс level 0 проходит через 0, слот следующего уровня раскладывается
+// (cascade) по нижним - каждый таймер переезжает не больше LEVELS-1 раз,
+// expire амортизированно O(1). Cancel: hash по id + unlink из слота, O(1).
+//
+// Непустые слоты уровня - битовая маска, поэтому ближайший срок (с учётом
+// cascade) - несколько ctz: hardware_timer_next_deadline() отдаёт его timer
+// interrupt'у, и тот программирует LAPIC timer ровно на него (tickless).
+// Срок округляется вверх до слота: таймер не срабатывает раньше, опоздание -
+// до HARDWARE_TIMER_RESOLUTION_US.
+//
+// Таймеры - из slab cache, лимит HARDWARE_TIMER_MAX активных.
+//
+// ============================================================================
+
+#define HARDWARE_TIMER_RESOLUTION_US 100        // Единица wheel (слот level 0)
+#define HARDWARE_TIMER_UNITS_PER_MS (1000 / HARDWARE_TIMER_RESOLUTION_US)
+#define HARDWARE_TIMER_SLOT_BITS    6
+#define HARDWARE_TIMER_SLOTS        (1 << HARDWARE_TIMER_SLOT_BITS)
+#define HARDWARE_TIMER_SLOT_MASK    (HARDWARE_TIMER_SLOTS - 1)
+#define HARDWARE_TIMER_LEVELS       5
+#define HARDWARE_TIMER_HASH_BUCKETS 4096        // Степень 2, id последовательны
+#define HARDWARE_TIMER_MAX          65536       // Активных таймеров
+
+void hardware_timer_init(void);
+
+// One-shot (interval_ms = 0) или periodic таймер через delay_ms.
+// entry != NULL - SUSPENDED entry, по срабатыванию deck_complete() и обратно
+// в PROCESSING. Возвращает id, 0 = лимит / нет памяти
+uint64_t hardware_timer_create(uint64_t delay_ms, uint64_t interval_ms, RoutingEntry* entry);
+
+// 1 = снят, 0 = нет такого (или уже сработал)
+int hardware_timer_cancel(uint64_t id);
+
+// Продвинуть wheel до текущего времени и обработать истёкшие.
+// Возвращает количество сработавших
+uint32_t hardware_timer_expire(void);
+
+// TSC ближайшего срока, когда wheel нужно продвинуть (срабатывание или
+// cascade). 0 = таймеров нет
+uint64_t hardware_timer_next_deadline(void);
+
+void hardware_timer_print_stats(void);
+
+#endif // HARDWARE_TIMER_H
@@ -1,54 +1,228 @@
 #include "deck_interface.h"
+#include "virtio_net.h"
 #include "klib.h"
 
 // ============================================================================
-// NETWORK DECK - Network Operations (STUB для v1)
+// NETWORK DECK - Ethernet кадры через virtio-net
 // ============================================================================
-// В первой версии ядра нет полноценного сетевого стека.
-// Network deck реализуется в будущих версиях.
+//
+// TCP/IP стека нет: deck принимает и отправляет сырые Ethernet кадры, разбор
+// протокола - дело следующих шагов workflow или user'а.
+//
+//   NET_RECV → кадр как ResultBuffer (RX страница драйвера, без копий).
+//              Workflow node с WORKFLOW_NODE_FLAG_INPUT_FROM_DEP получает его
+//              как input_result: Operations / Storage читают entry->buffer
+//              прямо из RX страницы. Нет кадра - entry ждёт в SUSPENDED
+//   NET_SEND → кадр из entry->buffer (input_result уходит по ссылке,
+//              registered buffer - копией в TX слот) или из payload
+//   NET_POLL → принятых кадров в очереди, не ждёт
+//
+// "Принять запрос → распарсить → обработать → ответить" (idea.txt) - workflow
+// RECV → Operations → SEND, кадры между nodes - ссылками на ResultBuffer.
+// Держатели кадра занимают RX страницы: пока workflow их не отпустил,
+// receiveq меньше на эти буферы.
+//
 // ============================================================================
 
-int network_deck_process(RoutingEntry* entry) {
-    Event* event = &entry->event_copy;
+// NET_RECV payload: [flags:4]
+#define NET_RECV_NOWAIT     0x01    // Нет кадра - сразу результат без данных
 
-    switch (event->type) {
-        case EVENT_NET_SOCKET:
-            kprintf("[NETWORK] Event %lu: socket() - STUB\n", event->id);
-            deck_complete(entry, DECK_PREFIX_NETWORK, (void*)100, RESULT_TYPE_VALUE);  // Fake socket fd
-            return 1;
+// NET_SEND payload: [size:8][frame...] (без entry->buffer)
+#define NET_SEND_HEADER     8
 
-        case EVENT_NET_CONNECT: {
-            // Payload: [socket_fd:4][addr:...]
-            int socket_fd = *(int*)event->data;
-            kprintf("[NETWORK] Event %lu: connect(fd=%d) - STUB\n",
-                    event->id, socket_fd);
-            deck_complete(entry, DECK_PREFIX_NETWORK, 0, RESULT_TYPE_NONE);
-            return 1;
+// ============================================================================
+// RECEIVERS - NET_RECV ждут кадров в SUSPENDED
+// ============================================================================
+//
+// Как читатели консоли в Hardware deck: FIFO ждущих entries, IRQ приёма
+// будит BSP (clock_event_kick), network_rx_poll() из network_deck_run_once()
+// раздаёт кадры по порядку и возвращает entries в Guide.
+//
+#define NET_RECEIVERS_MAX 16
+
+static RoutingEntry* net_receivers[NET_RECEIVERS_MAX];
+static uint32_t net_receiver_head = 0;
+static uint32_t net_receiver_count = 0;
+static spinlock_t net_receiver_lock;
+
+// 0 = очередь ждущих полна
+static int network_receiver_park(RoutingEntry* entry) {
+    spin_lock(&net_receiver_lock);
+    if (net_receiver_count >= NET_RECEIVERS_MAX) {
+        spin_unlock(&net_receiver_lock);
+        return 0;
+    }
+
+    // SUSPENDED до того, как entry виден poll'у
+    entry->state = EVENT_STATUS_SUSPENDED;
+    net_receivers[(net_receiver_head + net_receiver_count) % NET_RECEIVERS_MAX] = entry;
+    net_receiver_count++;
+    spin_unlock(&net_receiver_lock);
+    return 1;
+}
+
+// Раздать принятые кадры ждущим. Возвращает число завершённых entries
+static uint32_t network_rx_poll(void) {
+    if (net_receiver_count == 0 || virtio_net_rx_pending() == 0) {
+        return 0;
+    }
+
+    RoutingEntry* done[NET_RECEIVERS_MAX];
+    ResultBuffer* frames[NET_RECEIVERS_MAX];
+    uint32_t done_count = 0;
+
+    spin_lock(&net_receiver_lock);
+    while (net_receiver_count > 0) {
+        ResultBuffer* frame = virtio_net_receive();
+        if (!frame) {
+            break;
         }
 
-        case EVENT_NET_SEND: {
-            // Payload: [socket_fd:4][size:8][data:...]
-            int socket_fd = *(int*)event->data;
-            uint64_t size = *(uint64_t*)(event->data + 4);
-            kprintf("[NETWORK] Event %lu: send(fd=%d, size=%lu) - STUB\n",
-                    event->id, socket_fd, size);
-            deck_complete(entry, DECK_PREFIX_NETWORK, (void*)size, RESULT_TYPE_VALUE);  // Return bytes sent
-            return 1;
+        done[done_count] = net_receivers[net_receiver_head];
+        frames[done_count++] = frame;
+        net_receiver_head = (net_receiver_head + 1) % NET_RECEIVERS_MAX;
+        net_receiver_count--;
+    }
+    spin_unlock(&net_receiver_lock);
+
+    // deck_complete() - вне lock, идёт в Guide
+    for (uint32_t i = 0; i < done_count; i++) {
+        // SUSPENDED → PROCESSING делает deck_complete до публикации
+        deck_complete(done[i], DECK_PREFIX_NETWORK, frames[i], RESULT_TYPE_BUFFER);
+    }
+    return done_count;
+}
+
+// Процесс завершается (process_destroy): его NET_RECV не должны забирать
+// кадры у живых. Снимаем с FIFO (порядок остальных сохраняется) и
+// завершаем ошибкой - результат Execution Deck мёртвому не доставит
+void network_deck_release_owner(uint64_t owner_pid) {
+    RoutingEntry* dropped[NET_RECEIVERS_MAX];
+    uint32_t dropped_count = 0;
+    uint32_t kept = 0;
+
+    spin_lock(&net_receiver_lock);
+    for (uint32_t i = 0; i < net_receiver_count; i++) {
+        RoutingEntry* entry = net_receivers[(net_receiver_head + i) % NET_RECEIVERS_MAX];
+        if (entry->result_owner && entry->result_pid == owner_pid) {
+            dropped[dropped_count++] = entry;
+            continue;
+        }
+        net_receivers[(net_receiver_head + kept) % NET_RECEIVERS_MAX] = entry;
+        kept++;
+    }
+    net_receiver_count = kept;
+    spin_unlock(&net_receiver_lock);
+
+    for (uint32_t i = 0; i < dropped_count; i++) {
+        deck_error_detailed(dropped[i], DECK_PREFIX_NETWORK, ERROR_NET_NOT_CONNECTED,
+                          "Recv: owner exited");
+    }
+
+    if (dropped_count > 0) {
+        kprintf("[NETWORK] Dropped %u pending receiver(s) of PID=%lu\n", dropped_count, owner_pid);
+    }
+}
+
+// ============================================================================
+// PROCESSING FUNCTION
+// ============================================================================
+
+static int network_send(RoutingEntry* entry) {
+    const uint8_t* frame;
+    uint64_t size;
+    ResultBuffer* ref = NULL;
+
+    if (entry->buffer) {
+        frame = entry->buffer;
+        size = entry->buffer_length;
+        ref = entry->input_result;  // NULL - registered buffer процесса, копией
+    } else {
+        size = *(uint64_t*)entry->payload;
+        frame = entry->payload + NET_SEND_HEADER;
+        if (size > EVENT_DATA_SIZE - NET_SEND_HEADER) {
+            deck_error_detailed(entry, DECK_PREFIX_NETWORK, ERROR_NET_FRAME_SIZE,
+                              "Send: inline frame exceeds payload");
+            return 0;
         }
+    }
+
+    if (size < VIRTIO_NET_FRAME_MIN || size > VIRTIO_NET_FRAME_MAX) {
+        deck_error_detailed(entry, DECK_PREFIX_NETWORK, ERROR_NET_FRAME_SIZE,
+                          "Send: frame must be 14..1514 bytes");
+        return 0;
+    }
+
+    int status = virtio_net_send(frame, (uint32_t)size, ref);
+    if (status == VIRTIO_NET_TX_FULL) {
+        deck_error_detailed(entry, DECK_PREFIX_NETWORK, ERROR_NET_TX_FULL,
+                          "Send: all transmit slots in flight");
+        return 0;
+    }
+    if (status != 0) {
+        deck_error(entry, DECK_PREFIX_NETWORK, ERROR_NET_NO_DEVICE);
+        return 0;
+    }
 
-        case EVENT_NET_RECV: {
-            // Payload: [socket_fd:4][max_size:8]
-            int socket_fd = *(int*)event->data;
-            uint64_t max_size = *(uint64_t*)(event->data + 4);
-            kprintf("[NETWORK] Event %lu: recv(fd=%d, max_size=%lu) - STUB\n",
-                    event->id, socket_fd, max_size);
-            deck_complete(entry, DECK_PREFIX_NETWORK, 0, RESULT_TYPE_NONE);  // Return 0 bytes received
+    deck_complete(entry, DECK_PREFIX_NETWORK, (void*)size, RESULT_TYPE_VALUE);  // Bytes sent
+    return 1;
+}
+
+static int network_recv(RoutingEntry* entry) {
+    uint32_t flags = entry->payload_size >= sizeof(uint32_t) ? *(uint32_t*)entry->payload : 0;
+
+    // Кадры раньше этого entry уже ждут - порядок FIFO
+    if (net_receiver_count == 0) {
+        ResultBuffer* frame = virtio_net_receive();
+        if (frame) {
+            deck_complete(entry, DECK_PREFIX_NETWORK, frame, RESULT_TYPE_BUFFER);
             return 1;
         }
+    }
+
+    if (flags & NET_RECV_NOWAIT) {
+        deck_complete(entry, DECK_PREFIX_NETWORK, 0, RESULT_TYPE_NONE);  // 0 bytes received
+        return 1;
+    }
+
+    // Кадр придёт позже: network_rx_poll() завершит entry
+    if (!network_receiver_park(entry)) {
+        deck_error_detailed(entry, DECK_PREFIX_NETWORK, ERROR_RESOURCE_BUSY,
+                          "Recv: too many pending receivers");
+        return 0;
+    }
+    return 1;
+}
+
+int network_deck_process(RoutingEntry* entry) {
+    Event* event = &entry->event_copy;
+
+    switch (event->type) {
+        case EVENT_NET_SOCKET:
+        case EVENT_NET_CONNECT:
+            deck_error_detailed(entry, DECK_PREFIX_NETWORK, ERROR_NOT_IMPLEMENTED,
+                              "No TCP/IP stack - raw frames only (NET_SEND/NET_RECV)");
+            return 0;
+
+        case EVENT_NET_POLL:
+            // Без устройства кадров просто нет
+            virtio_net_tx_reap();
+            deck_complete(entry, DECK_PREFIX_NETWORK, (void*)(uint64_t)virtio_net_rx_pending(),
+                          RESULT_TYPE_VALUE);
+            return 1;
+
+        case EVENT_NET_SEND:
+        case EVENT_NET_RECV:
+            if (!virtio_net_available()) {
+                deck_error_detailed(entry, DECK_PREFIX_NETWORK, ERROR_NET_NO_DEVICE,
+                                  "No virtio-net device");
+                return 0;
+            }
+            return event->type == EVENT_NET_SEND ? network_send(entry) : network_recv(entry);
 
         default:
-            kprintf("[NETWORK] Unknown event type %d - STUB\n", event->type);
-            deck_error(entry, DECK_PREFIX_NETWORK, 1);
+            kprintf("[NETWORK] ERROR: Unknown event type %d\n", event->type);
+            deck_error(entry, DECK_PREFIX_NETWORK, ERROR_NOT_IMPLEMENTED);
             return 0;
     }
 }
@@ -60,14 +234,31 @@ int network_deck_process(RoutingEntry* entry) {
 DeckContext network_deck_context;
 
 void network_deck_init(void) {
+    spinlock_init(&net_receiver_lock);
     deck_init(&network_deck_context, "Network", DECK_PREFIX_NETWORK, network_deck_process);
-    kprintf("[NETWORK] Initialized (STUB - no network stack in v1)\n");
+
+    if (virtio_net_init() == 0) {
+        virtio_net_enable_irq();  // PIC уже поднят (шаг [11])
+    } else {
+        kprintf("[NETWORK] No NIC - NET_SEND/NET_RECV will fail, NET_POLL returns 0\n");
+    }
 }
 
 int network_deck_run_once(void) {
+    // Завершённые отправки (ссылки на кадры) и ждущие NET_RECV
+    virtio_net_tx_reap();
+    network_rx_poll();
+
     return deck_run_once(&network_deck_context);
 }
 
 void network_deck_run(void) {
-    deck_run(&network_deck_context);
+    // Не deck_run(): кадры раздаются в network_deck_run_once()
+    kprintf("[DECK:%s] Starting main loop...\n", network_deck_context.stats.name);
+
+    while (1) {
+        if (!network_deck_run_once()) {
+            cpu_pause();
+        }
+    }
 }
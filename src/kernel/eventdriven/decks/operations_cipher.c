@@ -0,0 +1,1156 @@
+#include "operations_cipher.h"
+#include "atomics.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+#define CPUID_ECX_PCLMULQDQ    (1 << 1)
+#define CPUID_ECX_SSSE3        (1 << 9)
+#define CPUID_ECX_AESNI        (1 << 25)
+
+// SIMD секция держит cli - большие буферы режем на куски
+#define CIPHER_FPU_CHUNK       (16 * 1024)
+
+static int cipher_use_aesni = 0;
+static int cipher_use_pclmul = 0;
+
+typedef long long cipher_v2di __attribute__((vector_size(16)));
+typedef long long cipher_v2di_u __attribute__((vector_size(16), aligned(1)));
+typedef unsigned int cipher_v4su __attribute__((vector_size(16)));
+typedef int cipher_v4si __attribute__((vector_size(16)));
+typedef char cipher_v16qi __attribute__((vector_size(16)));
+
+// S-box по 8 байт в слове: software AES читает все 32 слова (constant-time)
+static uint64_t aes_sbox_words[32];
+
+static spinlock_t cipher_cache_lock;
+static CipherKey cipher_cache[CIPHER_KEY_CACHE_SLOTS];
+static uint64_t cipher_cache_clock = 0;
+
+static struct {
+    volatile uint64_t hits;         // Schedule из cache
+    volatile uint64_t expansions;   // Раскрыт и положен в cache
+    volatile uint64_t evictions;    // Вытеснен чужой schedule
+    volatile uint64_t uncached;     // Раскрыт на стеке (вне workflow / cache занят)
+} cipher_cache_stats;
+
+static const char* cipher_names[CIPHER_COUNT] = {
+    "auto", "AES-CTR", "AES-GCM", "ChaCha20-Poly1305"
+};
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+// volatile - запись не выкидывается как dead store
+void cipher_wipe(void* ptr, uint64_t size) {
+    volatile uint8_t* p = (volatile uint8_t*)ptr;
+    while (size-- > 0) {
+        *p++ = 0;
+    }
+}
+
+static int cipher_equal(const uint8_t* a, const uint8_t* b, uint64_t size) {
+    uint8_t diff = 0;
+    for (uint64_t i = 0; i < size; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+static inline uint32_t cipher_load32_le(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void cipher_store32_le(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t cipher_load32_be(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void cipher_store32_be(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline uint64_t cipher_load64_be(const uint8_t* p) {
+    return ((uint64_t)cipher_load32_be(p) << 32) | cipher_load32_be(p + 4);
+}
+
+static inline void cipher_store64_be(uint8_t* p, uint64_t v) {
+    cipher_store32_be(p, (uint32_t)(v >> 32));
+    cipher_store32_be(p + 4, (uint32_t)v);
+}
+
+static inline void cipher_store64_le(uint8_t* p, uint64_t v) {
+    cipher_store32_le(p, (uint32_t)v);
+    cipher_store32_le(p + 4, (uint32_t)(v >> 32));
+}
+
+// ============================================================================
+// SOFTWARE AES (constant-time)
+// ============================================================================
+//
+// Без AES-NI: S-box выбирается полным проходом по таблице с маской, т.е.
+// адреса не зависят от секрета. Единицы MB/s - нужен только для
+// AES-данных на CPU без AES-NI; новые данные там шифрует ChaCha20
+// (CIPHER_AUTO).
+//
+// ============================================================================
+
+static inline uint8_t aes_xtime(uint8_t x) {
+    return (uint8_t)((x << 1) ^ (0x1B & (uint8_t)-(x >> 7)));
+}
+
+static uint8_t gf256_mul(uint8_t a, uint8_t b) {
+    uint8_t r = 0;
+    for (int i = 0; i < 8; i++) {
+        r ^= a & (uint8_t)-(b & 1);
+        a = aes_xtime(a);
+        b >>= 1;
+    }
+    return r;
+}
+
+// Только при init (не секретные данные): x^254 = x^-1, затем affine
+static uint8_t aes_sbox_compute(uint8_t x) {
+    uint8_t x2 = gf256_mul(x, x);
+    uint8_t x3 = gf256_mul(x2, x);
+    uint8_t x6 = gf256_mul(x3, x3);
+    uint8_t x12 = gf256_mul(x6, x6);
+    uint8_t x15 = gf256_mul(x12, x3);
+    uint8_t x30 = gf256_mul(x15, x15);
+    uint8_t x60 = gf256_mul(x30, x30);
+    uint8_t x120 = gf256_mul(x60, x60);
+    uint8_t x240 = gf256_mul(x120, x120);
+    uint8_t x252 = gf256_mul(x240, x12);
+    uint8_t inv = gf256_mul(x252, x2);
+
+    uint8_t s = inv;
+    for (int i = 1; i <= 4; i++) {
+        s ^= (uint8_t)((inv << i) | (inv >> (8 - i)));
+    }
+    return s ^ 0x63;
+}
+
+static uint8_t aes_sbox(uint8_t x) {
+    uint64_t index = x >> 3;
+    uint64_t word = 0;
+    for (uint64_t i = 0; i < 32; i++) {
+        uint64_t mask = 0 - (((i ^ index) - 1) >> 63);
+        word |= aes_sbox_words[i] & mask;
+    }
+    return (uint8_t)(word >> ((x & 7) * 8));
+}
+
+static void aes_soft_expand(CipherKey* key) {
+    uint32_t nk = key->key_size / 4;
+    uint32_t total = 4 * (key->rounds + 1);
+    uint8_t* w = &key->round_keys[0][0];
+    uint8_t rcon = 1;
+
+    memcpy(w, key->raw, key->key_size);
+    for (uint32_t i = nk; i < total; i++) {
+        uint8_t t[4] = { w[(i - 1) * 4], w[(i - 1) * 4 + 1], w[(i - 1) * 4 + 2], w[(i - 1) * 4 + 3] };
+
+        if (i % nk == 0) {
+            uint8_t first = t[0];
+            t[0] = aes_sbox(t[1]) ^ rcon;
+            t[1] = aes_sbox(t[2]);
+            t[2] = aes_sbox(t[3]);
+            t[3] = aes_sbox(first);
+            rcon = aes_xtime(rcon);
+        } else if (nk > 6 && i % nk == 4) {
+            for (int j = 0; j < 4; j++) {
+                t[j] = aes_sbox(t[j]);
+            }
+        }
+
+        for (int j = 0; j < 4; j++) {
+            w[i * 4 + j] = w[(i - nk) * 4 + j] ^ t[j];
+        }
+    }
+}
+
+static void aes_soft_encrypt(const CipherKey* key, const uint8_t* in, uint8_t* out) {
+    uint8_t s[16];
+    uint8_t t[16];
+
+    for (int i = 0; i < 16; i++) {
+        s[i] = in[i] ^ key->round_keys[0][i];
+    }
+
+    for (uint32_t round = 1; round <= key->rounds; round++) {
+        // SubBytes + ShiftRows (state column-major: s[col * 4 + row])
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                t[c * 4 + r] = aes_sbox(s[((c + r) & 3) * 4 + r]);
+            }
+        }
+
+        if (round != key->rounds) {
+            for (int c = 0; c < 4; c++) {
+                uint8_t* col = &t[c * 4];
+                uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+                uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+                col[0] = a0 ^ all ^ aes_xtime(a0 ^ a1);
+                col[1] = a1 ^ all ^ aes_xtime(a1 ^ a2);
+                col[2] = a2 ^ all ^ aes_xtime(a2 ^ a3);
+                col[3] = a3 ^ all ^ aes_xtime(a3 ^ a0);
+            }
+        }
+
+        for (int i = 0; i < 16; i++) {
+            s[i] = t[i] ^ key->round_keys[round][i];
+        }
+    }
+
+    memcpy(out, s, 16);
+    cipher_wipe(s, sizeof(s));
+    cipher_wipe(t, sizeof(t));
+}
+
+// ============================================================================
+// AES-NI
+// ============================================================================
+
+#define CIPHER_AESENC(b, k)      __builtin_ia32_aesenc128((b), (k))
+#define CIPHER_AESENCLAST(b, k)  __builtin_ia32_aesenclast128((b), (k))
+
+// k ^= k << 32; k ^= k << 64 - префиксный XOR слов ключа
+static inline __attribute__((target("aes,sse2")))
+cipher_v2di aesni_key_prefix(cipher_v2di k) {
+    k ^= __builtin_ia32_pslldqi128(k, 32);
+    k ^= __builtin_ia32_pslldqi128(k, 64);
+    return k;
+}
+
+static inline __attribute__((target("aes,sse2")))
+cipher_v2di aesni_expand_step(cipher_v2di k, cipher_v2di assist, int lane) {
+    // lane: 0xFF - RotWord(SubWord) + rcon (каждый шаг), 0xAA - SubWord (AES-256)
+    assist = lane == 0xFF ? (cipher_v2di)__builtin_ia32_pshufd((cipher_v4si)assist, 0xFF)
+                          : (cipher_v2di)__builtin_ia32_pshufd((cipher_v4si)assist, 0xAA);
+    return aesni_key_prefix(k) ^ assist;
+}
+
+#define AESNI_128(k, rcon)      aesni_expand_step((k), __builtin_ia32_aeskeygenassist128((k), (rcon)), 0xFF)
+#define AESNI_256A(k1, k3, rcon) aesni_expand_step((k1), __builtin_ia32_aeskeygenassist128((k3), (rcon)), 0xFF)
+#define AESNI_256B(k3, k1)      aesni_expand_step((k3), __builtin_ia32_aeskeygenassist128((k1), 0x00), 0xAA)
+
+static __attribute__((target("aes,sse2")))
+void aesni_expand(CipherKey* key) {
+    cipher_v2di_u* rk = (cipher_v2di_u*)key->round_keys;
+
+    if (key->key_size == 16) {
+        cipher_v2di k = *(const cipher_v2di_u*)key->raw;
+        rk[0] = k;
+        k = AESNI_128(k, 0x01); rk[1] = k;
+        k = AESNI_128(k, 0x02); rk[2] = k;
+        k = AESNI_128(k, 0x04); rk[3] = k;
+        k = AESNI_128(k, 0x08); rk[4] = k;
+        k = AESNI_128(k, 0x10); rk[5] = k;
+        k = AESNI_128(k, 0x20); rk[6] = k;
+        k = AESNI_128(k, 0x40); rk[7] = k;
+        k = AESNI_128(k, 0x80); rk[8] = k;
+        k = AESNI_128(k, 0x1B); rk[9] = k;
+        k = AESNI_128(k, 0x36); rk[10] = k;
+        return;
+    }
+
+    cipher_v2di k1 = *(const cipher_v2di_u*)key->raw;
+    cipher_v2di k3 = *(const cipher_v2di_u*)(key->raw + 16);
+    rk[0] = k1;
+    rk[1] = k3;
+    k1 = AESNI_256A(k1, k3, 0x01); rk[2] = k1;  k3 = AESNI_256B(k3, k1); rk[3] = k3;
+    k1 = AESNI_256A(k1, k3, 0x02); rk[4] = k1;  k3 = AESNI_256B(k3, k1); rk[5] = k3;
+    k1 = AESNI_256A(k1, k3, 0x04); rk[6] = k1;  k3 = AESNI_256B(k3, k1); rk[7] = k3;
+    k1 = AESNI_256A(k1, k3, 0x08); rk[8] = k1;  k3 = AESNI_256B(k3, k1); rk[9] = k3;
+    k1 = AESNI_256A(k1, k3, 0x10); rk[10] = k1; k3 = AESNI_256B(k3, k1); rk[11] = k3;
+    k1 = AESNI_256A(k1, k3, 0x20); rk[12] = k1; k3 = AESNI_256B(k3, k1); rk[13] = k3;
+    k1 = AESNI_256A(k1, k3, 0x40); rk[14] = k1;
+}
+
+static __attribute__((target("aes,sse2")))
+void aesni_encrypt_block(const CipherKey* key, const uint8_t* in, uint8_t* out) {
+    const cipher_v2di_u* rk = (const cipher_v2di_u*)key->round_keys;
+    cipher_v2di b = *(const cipher_v2di_u*)in ^ rk[0];
+    for (uint32_t r = 1; r < key->rounds; r++) {
+        b = CIPHER_AESENC(b, rk[r]);
+    }
+    *(cipher_v2di_u*)out = CIPHER_AESENCLAST(b, rk[key->rounds]);
+}
+
+// 4 блока за проход - aesenc конвейеризуется (latency 4, throughput 1)
+static __attribute__((target("aes,sse2")))
+void aesni_ctr_blocks(const CipherKey* key, uint8_t* ctr, const uint8_t* in, uint8_t* out,
+                      uint64_t blocks) {
+    const cipher_v2di_u* rk = (const cipher_v2di_u*)key->round_keys;
+    uint32_t rounds = key->rounds;
+    uint32_t counter = cipher_load32_be(ctr + 12);
+
+    while (blocks >= 4) {
+        cipher_store32_be(ctr + 12, counter);
+        cipher_v2di b0 = *(const cipher_v2di_u*)ctr ^ rk[0];
+        cipher_store32_be(ctr + 12, counter + 1);
+        cipher_v2di b1 = *(const cipher_v2di_u*)ctr ^ rk[0];
+        cipher_store32_be(ctr + 12, counter + 2);
+        cipher_v2di b2 = *(const cipher_v2di_u*)ctr ^ rk[0];
+        cipher_store32_be(ctr + 12, counter + 3);
+        cipher_v2di b3 = *(const cipher_v2di_u*)ctr ^ rk[0];
+
+        for (uint32_t r = 1; r < rounds; r++) {
+            b0 = CIPHER_AESENC(b0, rk[r]);
+            b1 = CIPHER_AESENC(b1, rk[r]);
+            b2 = CIPHER_AESENC(b2, rk[r]);
+            b3 = CIPHER_AESENC(b3, rk[r]);
+        }
+
+        *(cipher_v2di_u*)(out) = CIPHER_AESENCLAST(b0, rk[rounds]) ^ *(const cipher_v2di_u*)(in);
+        *(cipher_v2di_u*)(out + 16) = CIPHER_AESENCLAST(b1, rk[rounds]) ^ *(const cipher_v2di_u*)(in + 16);
+        *(cipher_v2di_u*)(out + 32) = CIPHER_AESENCLAST(b2, rk[rounds]) ^ *(const cipher_v2di_u*)(in + 32);
+        *(cipher_v2di_u*)(out + 48) = CIPHER_AESENCLAST(b3, rk[rounds]) ^ *(const cipher_v2di_u*)(in + 48);
+
+        counter += 4;
+        in += 64;
+        out += 64;
+        blocks -= 4;
+    }
+
+    while (blocks-- > 0) {
+        cipher_store32_be(ctr + 12, counter++);
+        cipher_v2di b = *(const cipher_v2di_u*)ctr ^ rk[0];
+        for (uint32_t r = 1; r < rounds; r++) {
+            b = CIPHER_AESENC(b, rk[r]);
+        }
+        *(cipher_v2di_u*)out = CIPHER_AESENCLAST(b, rk[rounds]) ^ *(const cipher_v2di_u*)in;
+        in += 16;
+        out += 16;
+    }
+
+    cipher_store32_be(ctr + 12, counter);
+}
+
+// ============================================================================
+// AES DISPATCH
+// ============================================================================
+
+static void aes_encrypt_block(const CipherKey* key, const uint8_t* in, uint8_t* out) {
+    if (cipher_use_aesni) {
+        kernel_fpu_begin();
+        aesni_encrypt_block(key, in, out);
+        kernel_fpu_end();
+    } else {
+        aes_soft_encrypt(key, in, out);
+    }
+}
+
+// ctr: [nonce:12][counter BE:4], после вызова - следующий counter
+static void aes_ctr_xor(const CipherKey* key, uint8_t* ctr, const uint8_t* in, uint8_t* out,
+                        uint64_t size) {
+    uint64_t blocks = size / 16;
+
+    if (cipher_use_aesni) {
+        while (blocks > 0) {
+            uint64_t chunk = blocks < CIPHER_FPU_CHUNK / 16 ? blocks : CIPHER_FPU_CHUNK / 16;
+            kernel_fpu_begin();
+            aesni_ctr_blocks(key, ctr, in, out, chunk);
+            kernel_fpu_end();
+            in += chunk * 16;
+            out += chunk * 16;
+            blocks -= chunk;
+        }
+    } else {
+        uint8_t stream[16];
+        while (blocks-- > 0) {
+            aes_soft_encrypt(key, ctr, stream);
+            for (int i = 0; i < 16; i++) {
+                out[i] = in[i] ^ stream[i];
+            }
+            cipher_store32_be(ctr + 12, cipher_load32_be(ctr + 12) + 1);
+            in += 16;
+            out += 16;
+        }
+        cipher_wipe(stream, sizeof(stream));
+    }
+
+    uint64_t tail = size % 16;
+    if (tail > 0) {
+        uint8_t stream[16];
+        aes_encrypt_block(key, ctr, stream);
+        for (uint64_t i = 0; i < tail; i++) {
+            out[i] = in[i] ^ stream[i];
+        }
+        cipher_store32_be(ctr + 12, cipher_load32_be(ctr + 12) + 1);
+        cipher_wipe(stream, sizeof(stream));
+    }
+}
+
+// ============================================================================
+// GHASH (GCM)
+// ============================================================================
+//
+// PCLMULQDQ: Intel "Carry-Less Multiplication and Its Usage for Computing
+// the GCM Mode" - байты разворачиваются pshufb, 4 умножения 64x64, сдвиг
+// на 1 (bit-reflected) и редукция по x^128 + x^7 + x^2 + x + 1.
+// Software: побитовое умножение с масками, без ветвлений по данным.
+//
+// ============================================================================
+
+#define CIPHER_CLMUL(a, b, imm)  __builtin_ia32_pclmulqdq128((a), (b), (imm))
+
+static inline __attribute__((target("pclmul,ssse3,sse2")))
+cipher_v2di ghash_bswap(cipher_v2di x) {
+    const cipher_v16qi reverse = { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+    return (cipher_v2di)__builtin_ia32_pshufb128((cipher_v16qi)x, reverse);
+}
+
+static inline __attribute__((target("pclmul,ssse3,sse2")))
+cipher_v2di ghash_gfmul(cipher_v2di a, cipher_v2di b) {
+    cipher_v2di lo = CIPHER_CLMUL(a, b, 0x00);
+    cipher_v2di mid = CIPHER_CLMUL(a, b, 0x10) ^ CIPHER_CLMUL(a, b, 0x01);
+    cipher_v2di hi = CIPHER_CLMUL(a, b, 0x11);
+
+    lo ^= __builtin_ia32_pslldqi128(mid, 64);
+    hi ^= __builtin_ia32_psrldqi128(mid, 64);
+
+    // 256-bit произведение << 1
+    cipher_v4su lo_carry = (cipher_v4su)lo >> 31;
+    cipher_v4su hi_carry = (cipher_v4su)hi >> 31;
+    cipher_v2di lo_shift = (cipher_v2di)((cipher_v4su)lo << 1);
+    cipher_v2di hi_shift = (cipher_v2di)((cipher_v4su)hi << 1);
+    cipher_v2di cross = __builtin_ia32_psrldqi128((cipher_v2di)lo_carry, 96);
+    lo = lo_shift | __builtin_ia32_pslldqi128((cipher_v2di)lo_carry, 32);
+    hi = hi_shift | __builtin_ia32_pslldqi128((cipher_v2di)hi_carry, 32) | cross;
+
+    // Редукция: первая фаза
+    cipher_v4su v = (cipher_v4su)lo;
+    cipher_v2di fold = (cipher_v2di)((v << 31) ^ (v << 30) ^ (v << 25));
+    cipher_v2di spill = __builtin_ia32_psrldqi128(fold, 32);
+    lo ^= __builtin_ia32_pslldqi128(fold, 96);
+
+    // Вторая фаза
+    v = (cipher_v4su)lo;
+    cipher_v2di shifted = (cipher_v2di)((v >> 1) ^ (v >> 2) ^ (v >> 7)) ^ spill;
+    return hi ^ lo ^ shifted;
+}
+
+static __attribute__((target("pclmul,ssse3,sse2")))
+void ghash_pclmul(const uint8_t* h, uint8_t* x, const uint8_t* data, uint64_t blocks) {
+    cipher_v2di hv = ghash_bswap(*(const cipher_v2di_u*)h);
+    cipher_v2di xv = ghash_bswap(*(const cipher_v2di_u*)x);
+
+    while (blocks-- > 0) {
+        xv ^= ghash_bswap(*(const cipher_v2di_u*)data);
+        xv = ghash_gfmul(xv, hv);
+        data += 16;
+    }
+
+    *(cipher_v2di_u*)x = ghash_bswap(xv);
+}
+
+static void ghash_soft(const uint8_t* h, uint8_t* x, const uint8_t* data, uint64_t blocks) {
+    uint64_t h_hi = cipher_load64_be(h);
+    uint64_t h_lo = cipher_load64_be(h + 8);
+    uint64_t x_hi = cipher_load64_be(x);
+    uint64_t x_lo = cipher_load64_be(x + 8);
+
+    while (blocks-- > 0) {
+        x_hi ^= cipher_load64_be(data);
+        x_lo ^= cipher_load64_be(data + 8);
+
+        uint64_t z_hi = 0, z_lo = 0;
+        uint64_t v_hi = h_hi, v_lo = h_lo;
+        for (int i = 0; i < 128; i++) {
+            uint64_t bit = i < 64 ? (x_hi >> (63 - i)) & 1 : (x_lo >> (127 - i)) & 1;
+            uint64_t mask = 0 - bit;
+            z_hi ^= v_hi & mask;
+            z_lo ^= v_lo & mask;
+
+            uint64_t carry = 0 - (v_lo & 1);
+            v_lo = (v_lo >> 1) | (v_hi << 63);
+            v_hi = (v_hi >> 1) ^ (0xE100000000000000ULL & carry);
+        }
+
+        x_hi = z_hi;
+        x_lo = z_lo;
+        data += 16;
+    }
+
+    cipher_store64_be(x, x_hi);
+    cipher_store64_be(x + 8, x_lo);
+}
+
+// Хвост дополняется нулями до блока (GCM pad)
+static void ghash_update(const CipherKey* key, uint8_t* x, const uint8_t* data, uint64_t size) {
+    uint64_t blocks = size / 16;
+
+    if (cipher_use_pclmul) {
+        while (blocks > 0) {
+            uint64_t chunk = blocks < CIPHER_FPU_CHUNK / 16 ? blocks : CIPHER_FPU_CHUNK / 16;
+            kernel_fpu_begin();
+            ghash_pclmul(key->hash_key, x, data, chunk);
+            kernel_fpu_end();
+            data += chunk * 16;
+            blocks -= chunk;
+        }
+    } else if (blocks > 0) {
+        ghash_soft(key->hash_key, x, data, blocks);
+        data += blocks * 16;
+    }
+
+    uint64_t tail = size % 16;
+    if (tail > 0) {
+        uint8_t block[16];
+        memset(block, 0, sizeof(block));
+        memcpy(block, data, tail);
+        if (cipher_use_pclmul) {
+            kernel_fpu_begin();
+            ghash_pclmul(key->hash_key, x, block, 1);
+            kernel_fpu_end();
+        } else {
+            ghash_soft(key->hash_key, x, block, 1);
+        }
+    }
+}
+
+// ============================================================================
+// CHACHA20-POLY1305 (RFC 8439)
+// ============================================================================
+
+#define CHACHA_ROTL(v, n)  (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define CHACHA_QUARTER(a, b, c, d)                      \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 16);             \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 12);             \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 8);              \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 7)
+
+static void chacha20_block(const uint32_t state[16], uint8_t* out) {
+    uint32_t x[16];
+    for (int i = 0; i < 16; i++) {
+        x[i] = state[i];
+    }
+
+    for (int i = 0; i < 10; i++) {
+        CHACHA_QUARTER(x[0], x[4], x[8], x[12]);
+        CHACHA_QUARTER(x[1], x[5], x[9], x[13]);
+        CHACHA_QUARTER(x[2], x[6], x[10], x[14]);
+        CHACHA_QUARTER(x[3], x[7], x[11], x[15]);
+        CHACHA_QUARTER(x[0], x[5], x[10], x[15]);
+        CHACHA_QUARTER(x[1], x[6], x[11], x[12]);
+        CHACHA_QUARTER(x[2], x[7], x[8], x[13]);
+        CHACHA_QUARTER(x[3], x[4], x[9], x[14]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        cipher_store32_le(out + i * 4, x[i] + state[i]);
+    }
+    cipher_wipe(x, sizeof(x));
+}
+
+static void chacha20_init(uint32_t state[16], const uint8_t* key, const uint8_t* nonce,
+                          uint32_t counter) {
+    state[0] = 0x61707865;  // "expand 32-byte k"
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        state[4 + i] = cipher_load32_le(key + i * 4);
+    }
+    state[12] = counter;
+    state[13] = cipher_load32_le(nonce);
+    state[14] = cipher_load32_le(nonce + 4);
+    state[15] = cipher_load32_le(nonce + 8);
+}
+
+static void chacha20_xor(const uint8_t* key, const uint8_t* nonce, uint32_t counter,
+                         const uint8_t* in, uint8_t* out, uint64_t size) {
+    uint32_t state[16];
+    uint8_t stream[64];
+    chacha20_init(state, key, nonce, counter);
+
+    while (size > 0) {
+        chacha20_block(state, stream);
+        state[12]++;
+
+        uint64_t n = size < 64 ? size : 64;
+        for (uint64_t i = 0; i < n; i++) {
+            out[i] = in[i] ^ stream[i];
+        }
+        in += n;
+        out += n;
+        size -= n;
+    }
+
+    cipher_wipe(state, sizeof(state));
+    cipher_wipe(stream, sizeof(stream));
+}
+
+// poly1305-donna-32 (Poly1305State - operations_cipher.h), все ветвления - маски
+static void poly1305_init(Poly1305State* st, const uint8_t* key) {
+    st->r[0] = cipher_load32_le(key) & 0x3ffffff;
+    st->r[1] = (cipher_load32_le(key + 3) >> 2) & 0x3ffff03;
+    st->r[2] = (cipher_load32_le(key + 6) >> 4) & 0x3ffc0ff;
+    st->r[3] = (cipher_load32_le(key + 9) >> 6) & 0x3f03fff;
+    st->r[4] = (cipher_load32_le(key + 12) >> 8) & 0x00fffff;
+    for (int i = 0; i < 5; i++) {
+        st->h[i] = 0;
+    }
+    for (int i = 0; i < 4; i++) {
+        st->pad[i] = cipher_load32_le(key + 16 + i * 4);
+    }
+}
+
+// size кратен 16
+static void poly1305_blocks(Poly1305State* st, const uint8_t* m, uint64_t size) {
+    uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+    uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+
+    while (size >= 16) {
+        h0 += cipher_load32_le(m) & 0x3ffffff;
+        h1 += (cipher_load32_le(m + 3) >> 2) & 0x3ffffff;
+        h2 += (cipher_load32_le(m + 6) >> 4) & 0x3ffffff;
+        h3 += (cipher_load32_le(m + 9) >> 6) & 0x3ffffff;
+        h4 += (cipher_load32_le(m + 12) >> 8) | (1 << 24);
+
+        uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 +
+                      (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+        uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 +
+                      (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+        uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 +
+                      (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+        uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 +
+                      (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+        uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 +
+                      (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+        uint32_t c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+        d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+        d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+        d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+        d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+        h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+
+        m += 16;
+        size -= 16;
+    }
+
+    st->h[0] = h0; st->h[1] = h1; st->h[2] = h2; st->h[3] = h3; st->h[4] = h4;
+}
+
+// AEAD: каждый сегмент дополняется нулями до 16 (RFC 8439 pad16)
+static void poly1305_padded(Poly1305State* st, const uint8_t* data, uint64_t size) {
+    uint64_t full = size & ~(uint64_t)15;
+    poly1305_blocks(st, data, full);
+
+    if (size > full) {
+        uint8_t block[16];
+        memset(block, 0, sizeof(block));
+        memcpy(block, data + full, size - full);
+        poly1305_blocks(st, block, 16);
+    }
+}
+
+static void poly1305_finish(Poly1305State* st, uint8_t* mac) {
+    uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+    uint32_t c;
+
+    c = h1 >> 26; h1 &= 0x3ffffff;
+    h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+    h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+    h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+    h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+    h1 += c;
+
+    // g = h + 5 - 2^130: выбираем g, если h >= p
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+    uint32_t g4 = h4 + c - (1 << 26);
+
+    uint32_t mask = (g4 >> 31) - 1;
+    g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    h0 = h0 | (h1 << 26);
+    h1 = (h1 >> 6) | (h2 << 20);
+    h2 = (h2 >> 12) | (h3 << 14);
+    h3 = (h3 >> 18) | (h4 << 8);
+
+    uint64_t f = (uint64_t)h0 + st->pad[0];
+    cipher_store32_le(mac, (uint32_t)f);
+    f = (uint64_t)h1 + st->pad[1] + (f >> 32);
+    cipher_store32_le(mac + 4, (uint32_t)f);
+    f = (uint64_t)h2 + st->pad[2] + (f >> 32);
+    cipher_store32_le(mac + 8, (uint32_t)f);
+    f = (uint64_t)h3 + st->pad[3] + (f >> 32);
+    cipher_store32_le(mac + 12, (uint32_t)f);
+
+    cipher_wipe(st, sizeof(*st));
+}
+
+// ============================================================================
+// AEAD MAC - общий для one-shot и stream
+// ============================================================================
+//
+// Ciphertext приходит кусками любого размера: неполный блок копится в
+// mac->block и дополняется нулями только в finish (pad16 у обоих AEAD).
+//
+// ============================================================================
+
+static void cipher_mac_blocks(CipherMac* mac, const CipherKey* key,
+                              const uint8_t* data, uint64_t size) {
+    if (key->cipher == CIPHER_AES_GCM) {
+        ghash_update(key, mac->ghash_x, data, size);
+    } else {
+        poly1305_blocks(&mac->poly, data, size);
+    }
+}
+
+static void cipher_mac_begin(CipherMac* mac, const CipherKey* key, const uint8_t* nonce,
+                             const uint8_t* aad, uint64_t aad_size) {
+    memset(mac, 0, sizeof(*mac));
+    mac->aad_size = aad_size;
+
+    if (key->cipher == CIPHER_AES_GCM) {
+        ghash_update(key, mac->ghash_x, aad, aad_size);
+        return;
+    }
+
+    // One-time Poly1305 key - первые 32 байта блока 0
+    uint32_t state[16];
+    uint8_t block[64];
+    chacha20_init(state, key->raw, nonce, 0);
+    chacha20_block(state, block);
+    poly1305_init(&mac->poly, block);
+    poly1305_padded(&mac->poly, aad, aad_size);
+
+    cipher_wipe(state, sizeof(state));
+    cipher_wipe(block, sizeof(block));
+}
+
+static void cipher_mac_absorb(CipherMac* mac, const CipherKey* key,
+                              const uint8_t* data, uint64_t size) {
+    mac->text_size += size;
+
+    if (mac->fill > 0) {
+        uint64_t n = 16 - mac->fill < size ? 16 - mac->fill : size;
+        memcpy(mac->block + mac->fill, data, n);
+        mac->fill += n;
+        data += n;
+        size -= n;
+        if (mac->fill < 16) {
+            return;
+        }
+        cipher_mac_blocks(mac, key, mac->block, 16);
+        mac->fill = 0;
+    }
+
+    uint64_t full = size & ~(uint64_t)15;
+    cipher_mac_blocks(mac, key, data, full);
+    memcpy(mac->block, data + full, size - full);
+    mac->fill = size - full;
+}
+
+static void cipher_mac_finish(CipherMac* mac, const CipherKey* key, const uint8_t* nonce,
+                              uint8_t* tag) {
+    uint8_t block[16];
+
+    if (mac->fill > 0) {
+        memset(mac->block + mac->fill, 0, 16 - mac->fill);
+        cipher_mac_blocks(mac, key, mac->block, 16);
+    }
+
+    if (key->cipher == CIPHER_AES_GCM) {
+        cipher_store64_be(block, mac->aad_size * 8);
+        cipher_store64_be(block + 8, mac->text_size * 8);
+        ghash_update(key, mac->ghash_x, block, 16);
+
+        // J0 = nonce || 1
+        memcpy(block, nonce, CIPHER_NONCE_SIZE);
+        cipher_store32_be(block + 12, 1);
+        aes_encrypt_block(key, block, block);
+        for (int i = 0; i < 16; i++) {
+            tag[i] = block[i] ^ mac->ghash_x[i];
+        }
+    } else {
+        cipher_store64_le(block, mac->aad_size);
+        cipher_store64_le(block + 8, mac->text_size);
+        poly1305_blocks(&mac->poly, block, 16);
+        poly1305_finish(&mac->poly, tag);
+    }
+
+    cipher_wipe(block, sizeof(block));
+    cipher_wipe(mac, sizeof(*mac));
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void cipher_engine_init(void) {
+    memset(aes_sbox_words, 0, sizeof(aes_sbox_words));
+    for (uint32_t i = 0; i < 256; i++) {
+        aes_sbox_words[i >> 3] |= (uint64_t)aes_sbox_compute((uint8_t)i) << ((i & 7) * 8);
+    }
+
+    uint32_t a, b, c, d;
+    cpu_cpuid(1, 0, &a, &b, &c, &d);
+    cipher_use_aesni = (c & CPUID_ECX_AESNI) != 0;
+    cipher_use_pclmul = (c & CPUID_ECX_PCLMULQDQ) && (c & CPUID_ECX_SSSE3);
+
+    spinlock_init(&cipher_cache_lock);
+    cipher_wipe(cipher_cache, sizeof(cipher_cache));
+    cipher_cache_clock = 0;
+}
+
+// ============================================================================
+// KEY SCHEDULE CACHE
+// ============================================================================
+
+static void cipher_key_expand(CipherKey* key, uint32_t cipher, const uint8_t* raw,
+                              uint32_t key_size) {
+    cipher_wipe(key, sizeof(*key));
+    memcpy(key->raw, raw, key_size);
+    key->key_size = key_size;
+    key->cipher = cipher;
+
+    if (cipher == CIPHER_CHACHA20_POLY1305) {
+        return;
+    }
+
+    key->rounds = key_size == 16 ? 10 : 14;
+    if (cipher_use_aesni) {
+        kernel_fpu_begin();
+        aesni_expand(key);
+        kernel_fpu_end();
+    } else {
+        aes_soft_expand(key);
+    }
+
+    // GCM H = E_K(0) - тоже часть schedule
+    aes_encrypt_block(key, key->hash_key, key->hash_key);
+}
+
+CipherKey* cipher_key_acquire(uint64_t workflow_id, uint32_t cipher,
+                              const uint8_t* key, uint32_t key_size, CipherKey* scratch) {
+    if (cipher == CIPHER_AUTO || cipher >= CIPHER_COUNT) {
+        return 0;
+    }
+    if (cipher == CIPHER_CHACHA20_POLY1305 ? key_size != 32 : (key_size != 16 && key_size != 32)) {
+        return 0;
+    }
+
+    if (workflow_id != 0) {
+        spin_lock(&cipher_cache_lock);
+        for (uint32_t i = 0; i < CIPHER_KEY_CACHE_SLOTS; i++) {
+            CipherKey* slot = &cipher_cache[i];
+            if (slot->workflow_id == workflow_id && slot->cipher == cipher &&
+                slot->key_size == key_size && cipher_equal(slot->raw, key, key_size)) {
+                slot->refcount++;
+                slot->last_used = ++cipher_cache_clock;
+                spin_unlock(&cipher_cache_lock);
+                atomic_increment_u64(&cipher_cache_stats.hits);
+                return slot;
+            }
+        }
+        spin_unlock(&cipher_cache_lock);
+    }
+
+    // Expansion вне lock (software AES - тысячи тактов)
+    cipher_key_expand(scratch, cipher, key, key_size);
+    if (workflow_id == 0) {
+        atomic_increment_u64(&cipher_cache_stats.uncached);
+        return scratch;
+    }
+
+    spin_lock(&cipher_cache_lock);
+    CipherKey* victim = 0;
+    for (uint32_t i = 0; i < CIPHER_KEY_CACHE_SLOTS; i++) {
+        CipherKey* slot = &cipher_cache[i];
+        if (slot->refcount != 0) {
+            continue;
+        }
+        if (slot->workflow_id == 0) {
+            victim = slot;
+            break;
+        }
+        if (!victim || slot->last_used < victim->last_used) {
+            victim = slot;
+        }
+    }
+
+    if (!victim) {
+        // Все слоты заняты активными событиями - работаем со scratch
+        spin_unlock(&cipher_cache_lock);
+        atomic_increment_u64(&cipher_cache_stats.uncached);
+        return scratch;
+    }
+
+    if (victim->workflow_id != 0) {
+        atomic_increment_u64(&cipher_cache_stats.evictions);
+    }
+    memcpy(victim, scratch, sizeof(CipherKey));
+    victim->workflow_id = workflow_id;
+    victim->last_used = ++cipher_cache_clock;
+    victim->refcount = 1;
+    victim->cached = 1;
+    spin_unlock(&cipher_cache_lock);
+
+    cipher_wipe(scratch, sizeof(*scratch));
+    atomic_increment_u64(&cipher_cache_stats.expansions);
+    return victim;
+}
+
+void cipher_key_release(CipherKey* key) {
+    if (!key) {
+        return;
+    }
+
+    if (!key->cached) {
+        cipher_wipe(key, sizeof(*key));
+        return;
+    }
+
+    spin_lock(&cipher_cache_lock);
+    key->refcount--;
+    // Workflow снят, пока событие шифровало - стираем за ним
+    if (key->refcount == 0 && key->workflow_id == 0) {
+        cipher_wipe(key, sizeof(*key));
+    }
+    spin_unlock(&cipher_cache_lock);
+}
+
+void cipher_key_flush_workflow(uint64_t workflow_id) {
+    if (workflow_id == 0) {
+        return;
+    }
+
+    spin_lock(&cipher_cache_lock);
+    for (uint32_t i = 0; i < CIPHER_KEY_CACHE_SLOTS; i++) {
+        CipherKey* slot = &cipher_cache[i];
+        if (slot->workflow_id != workflow_id) {
+            continue;
+        }
+        if (slot->refcount == 0) {
+            cipher_wipe(slot, sizeof(*slot));
+        } else {
+            slot->workflow_id = 0;  // Больше не находится; release сотрёт
+        }
+    }
+    spin_unlock(&cipher_cache_lock);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+uint32_t cipher_auto_select(void) {
+    return cipher_use_aesni && cipher_use_pclmul ? CIPHER_AES_GCM : CIPHER_CHACHA20_POLY1305;
+}
+
+int cipher_is_aead(uint32_t cipher) {
+    return cipher == CIPHER_AES_GCM || cipher == CIPHER_CHACHA20_POLY1305;
+}
+
+const char* cipher_name(uint32_t cipher) {
+    return cipher < CIPHER_COUNT ? cipher_names[cipher] : "?";
+}
+
+// Keystream с байта offset: CTR counter 1 (GCM 2, 1 - J0 для tag),
+// ChaCha20 block counter 1 (0 - Poly1305 key)
+static void cipher_crypt_at(const CipherKey* key, const uint8_t* nonce, uint64_t offset,
+                            const uint8_t* in, uint64_t size, uint8_t* out) {
+    int chacha = key->cipher == CIPHER_CHACHA20_POLY1305;
+    uint64_t block_size = chacha ? 64 : 16;
+    uint32_t base = key->cipher == CIPHER_AES_GCM ? 2 : 1;
+
+    // Начало посреди блока keystream (stream chunk не кратен блоку)
+    uint64_t skip = offset % block_size;
+    if (skip > 0 && size > 0) {
+        uint8_t stream[64];
+        uint32_t index = base + (uint32_t)(offset / block_size);
+        if (chacha) {
+            uint32_t state[16];
+            chacha20_init(state, key->raw, nonce, index);
+            chacha20_block(state, stream);
+            cipher_wipe(state, sizeof(state));
+        } else {
+            memcpy(stream, nonce, CIPHER_NONCE_SIZE);
+            cipher_store32_be(stream + 12, index);
+            aes_encrypt_block(key, stream, stream);
+        }
+
+        uint64_t n = block_size - skip < size ? block_size - skip : size;
+        for (uint64_t i = 0; i < n; i++) {
+            out[i] = in[i] ^ stream[skip + i];
+        }
+        cipher_wipe(stream, sizeof(stream));
+        in += n;
+        out += n;
+        size -= n;
+        offset += n;
+    }
+
+    if (size == 0) {
+        return;
+    }
+
+    uint32_t counter = base + (uint32_t)(offset / block_size);
+    if (chacha) {
+        chacha20_xor(key->raw, nonce, counter, in, out, size);
+        return;
+    }
+
+    uint8_t ctr[16];
+    memcpy(ctr, nonce, CIPHER_NONCE_SIZE);
+    cipher_store32_be(ctr + 12, counter);
+    aes_ctr_xor(key, ctr, in, out, size);
+}
+
+static void cipher_tag(const CipherKey* key, const uint8_t* nonce,
+                       const uint8_t* aad, uint64_t aad_size,
+                       const uint8_t* ciphertext, uint64_t size, uint8_t* tag) {
+    CipherMac mac;
+    cipher_mac_begin(&mac, key, nonce, aad, aad_size);
+    cipher_mac_absorb(&mac, key, ciphertext, size);
+    cipher_mac_finish(&mac, key, nonce, tag);
+}
+
+void cipher_seal(const CipherKey* key, const uint8_t* nonce,
+                 const uint8_t* aad, uint64_t aad_size,
+                 const uint8_t* in, uint64_t size, uint8_t* out, uint8_t* tag) {
+    cipher_crypt_at(key, nonce, 0, in, size, out);
+    if (cipher_is_aead(key->cipher)) {
+        cipher_tag(key, nonce, aad, aad_size, out, size, tag);
+    }
+}
+
+int cipher_open(const CipherKey* key, const uint8_t* nonce,
+                const uint8_t* aad, uint64_t aad_size,
+                const uint8_t* in, uint64_t size, uint8_t* out, const uint8_t* tag) {
+    // CRITICAL: in / tag могут быть памятью процесса (registered buffer) -
+    // проверяем и расшифровываем один и тот же снимок в out, иначе user
+    // подменит ciphertext между проверкой tag и расшифровкой
+    if (out != in) {
+        memmove(out, in, size);
+    }
+
+    if (cipher_is_aead(key->cipher)) {
+        // CRITICAL: plaintext не появляется, пока tag не проверен
+        uint8_t expected[CIPHER_TAG_SIZE];
+        uint8_t received[CIPHER_TAG_SIZE];
+        memcpy(received, tag, CIPHER_TAG_SIZE);
+        cipher_tag(key, nonce, aad, aad_size, out, size, expected);
+        int valid = cipher_equal(expected, received, CIPHER_TAG_SIZE);
+        cipher_wipe(expected, sizeof(expected));
+        if (!valid) {
+            cipher_wipe(out, size);
+            return 0;
+        }
+    }
+
+    cipher_crypt_at(key, nonce, 0, out, size, out);
+    return 1;
+}
+
+// ============================================================================
+// STREAM API
+// ============================================================================
+
+int cipher_stream_init(CipherStream* stream, uint32_t cipher, const uint8_t* key, uint32_t key_size,
+                       const uint8_t* nonce, const uint8_t* aad, uint64_t aad_size, int encrypt) {
+    // Schedule раскрывается один раз на stream - прямо в stream->key
+    if (!cipher_key_acquire(0, cipher, key, key_size, &stream->key)) {
+        return 0;
+    }
+
+    memcpy(stream->nonce, nonce, CIPHER_NONCE_SIZE);
+    stream->encrypt = encrypt ? 1 : 0;
+    stream->offset = 0;
+    if (cipher_is_aead(cipher)) {
+        cipher_mac_begin(&stream->mac, &stream->key, nonce, aad, aad_size);
+    }
+    return 1;
+}
+
+void cipher_stream_update(CipherStream* stream, const uint8_t* in, uint64_t size, uint8_t* out) {
+    int aead = cipher_is_aead(stream->key.cipher);
+
+    // MAC всегда по ciphertext: decrypt - вход, encrypt - выход
+    if (aead && !stream->encrypt) {
+        cipher_mac_absorb(&stream->mac, &stream->key, in, size);
+    }
+    cipher_crypt_at(&stream->key, stream->nonce, stream->offset, in, size, out);
+    if (aead && stream->encrypt) {
+        cipher_mac_absorb(&stream->mac, &stream->key, out, size);
+    }
+    stream->offset += size;
+}
+
+int cipher_stream_final(CipherStream* stream, uint8_t* tag) {
+    int valid = 1;
+
+    if (cipher_is_aead(stream->key.cipher)) {
+        uint8_t computed[CIPHER_TAG_SIZE];
+        cipher_mac_finish(&stream->mac, &stream->key, stream->nonce, computed);
+        if (stream->encrypt) {
+            memcpy(tag, computed, CIPHER_TAG_SIZE);
+        } else {
+            valid = cipher_equal(computed, tag, CIPHER_TAG_SIZE);
+        }
+        cipher_wipe(computed, sizeof(computed));
+    }
+
+    cipher_stream_wipe(stream);
+    return valid;
+}
+
+void cipher_stream_wipe(CipherStream* stream) {
+    cipher_wipe(stream, sizeof(*stream));
+}
+
+void cipher_engine_print_info(void) {
+    kprintf("[OPERATIONS]   - Ciphers: AES-CTR/GCM (%s, GHASH %s), ChaCha20-Poly1305; auto = %s\n",
+            cipher_use_aesni ? "AES-NI" : "constant-time software",
+            cipher_use_pclmul ? "PCLMULQDQ" : "software",
+            cipher_name(cipher_auto_select()));
+}
+
+void cipher_key_cache_print_stats(void) {
+    uint32_t live = 0;
+    spin_lock(&cipher_cache_lock);
+    for (uint32_t i = 0; i < CIPHER_KEY_CACHE_SLOTS; i++) {
+        if (cipher_cache[i].workflow_id != 0) {
+            live++;
+        }
+    }
+    spin_unlock(&cipher_cache_lock);
+
+    kprintf("\n%[H]=== Cipher Key Cache ===%[D]\n");
+    kprintf("  schedules=%u/%d hits=%lu expansions=%lu evictions=%lu uncached=%lu\n",
+            live, CIPHER_KEY_CACHE_SLOTS,
+            atomic_load_u64(&cipher_cache_stats.hits),
+            atomic_load_u64(&cipher_cache_stats.expansions),
+            atomic_load_u64(&cipher_cache_stats.evictions),
+            atomic_load_u64(&cipher_cache_stats.uncached));
+}
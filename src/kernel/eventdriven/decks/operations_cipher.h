@@ -0,0 +1,126 @@
+#ifndef OPERATIONS_CIPHER_H
+#define OPERATIONS_CIPHER_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// CIPHER ENGINE - симметричное шифрование EVENT_OP_ENCRYPT / DECRYPT
+// ============================================================================
+//
+//   AES-128/256 CTR и GCM  - AES-NI + PCLMULQDQ (GHASH), если есть в CPUID;
+//                            иначе constant-time software AES / GHASH
+//                            (без таблиц, индексируемых секретом - медленно,
+//                            только для совместимости)
+//   ChaCha20-Poly1305      - RFC 8439, constant-time, без SIMD
+//   CIPHER_AUTO            - лучший AEAD этого CPU: AES-GCM с AES-NI,
+//                            иначе ChaCha20-Poly1305. Результат начинается
+//                            с байта выбранного cipher - открывается на
+//                            любом CPU
+//
+// Key schedule (AES round keys + GCM H) кешируется per workflow: события
+// одного workflow с тем же ключом не повторяют expansion. Ключи событий
+// вне workflow в cache не попадают - раскрываются на стеке и стираются.
+// workflow_unregister() стирает ключи своего workflow.
+//
+// ============================================================================
+
+#define CIPHER_AUTO                 0
+#define CIPHER_AES_CTR              1
+#define CIPHER_AES_GCM              2
+#define CIPHER_CHACHA20_POLY1305    3
+#define CIPHER_COUNT                4
+
+#define CIPHER_NONCE_SIZE           12
+#define CIPHER_TAG_SIZE             16
+#define CIPHER_KEY_MAX              32
+
+#define CIPHER_KEY_CACHE_SLOTS      32      // Schedules в cache (LRU)
+
+typedef struct {
+    uint8_t round_keys[15][16];     // AES encryption schedule (FIPS-197 порядок байт)
+    uint8_t hash_key[16];           // GCM H = E_K(0^128)
+    uint8_t raw[CIPHER_KEY_MAX];    // Исходный ключ (ChaCha20, сравнение в cache)
+    uint32_t rounds;                // AES: 10 / 14
+    uint32_t key_size;              // 16 / 32
+    uint32_t cipher;                // CIPHER_* (не AUTO)
+
+    // Cache (не используется для ключей на стеке)
+    uint64_t workflow_id;           // 0 = свободен / стёрт
+    uint64_t last_used;
+    volatile uint32_t refcount;
+    uint8_t cached;                 // 1 = слот cache (release через cipher_key_release)
+} CipherKey;
+
+// poly1305-donna-32: 5 limbs по 26 бит
+typedef struct {
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[4];
+} Poly1305State;
+
+// Инкрементальный AEAD MAC (GHASH / Poly1305) по ciphertext
+typedef struct {
+    uint8_t ghash_x[16];            // GCM
+    Poly1305State poly;             // ChaCha20-Poly1305
+    uint8_t block[16];              // Неполный блок ciphertext
+    uint64_t fill;
+    uint64_t aad_size;
+    uint64_t text_size;
+} CipherMac;
+
+// Stream (EVENT_OP_STREAM_*): keystream и MAC продолжаются между событиями.
+// Plaintext decrypt-chunks не аутентифицированы до cipher_stream_final()
+typedef struct {
+    CipherKey key;                  // Собственная копия schedule (не cache)
+    uint8_t nonce[CIPHER_NONCE_SIZE];
+    uint8_t encrypt;
+    uint64_t offset;                // Байт обработано
+    CipherMac mac;
+} CipherStream;
+
+void cipher_engine_init(void);
+
+// Cipher, в который раскрывается CIPHER_AUTO на этом CPU
+uint32_t cipher_auto_select(void);
+int cipher_is_aead(uint32_t cipher);
+
+// Schedule для (workflow, cipher, key). workflow_id == 0 - раскрывается
+// в scratch. Возвращает 0 при неверном cipher / key_size. После работы -
+// cipher_key_release() (стирает scratch / отпускает слот)
+CipherKey* cipher_key_acquire(uint64_t workflow_id, uint32_t cipher,
+                              const uint8_t* key, uint32_t key_size, CipherKey* scratch);
+void cipher_key_release(CipherKey* key);
+
+// Стирает ключи workflow (workflow_unregister)
+void cipher_key_flush_workflow(uint64_t workflow_id);
+
+// Стирание секретов (ключи в payload событий и шаблонах workflow)
+void cipher_wipe(void* ptr, uint64_t size);
+
+// out = E(in), size байт; tag (AEAD) - CIPHER_TAG_SIZE байт
+void cipher_seal(const CipherKey* key, const uint8_t* nonce,
+                 const uint8_t* aad, uint64_t aad_size,
+                 const uint8_t* in, uint64_t size, uint8_t* out, uint8_t* tag);
+
+// Ciphertext сначала копируется в out, tag проверяется и out расшифровывается
+// на месте (in может быть памятью процесса). Возвращает 1, 0 = tag не совпал
+// (out стёрт)
+int cipher_open(const CipherKey* key, const uint8_t* nonce,
+                const uint8_t* aad, uint64_t aad_size,
+                const uint8_t* in, uint64_t size, uint8_t* out, const uint8_t* tag);
+
+// Возвращает 1, 0 = неверный cipher (AUTO не допускается) / key_size
+int cipher_stream_init(CipherStream* stream, uint32_t cipher, const uint8_t* key, uint32_t key_size,
+                       const uint8_t* nonce, const uint8_t* aad, uint64_t aad_size, int encrypt);
+void cipher_stream_update(CipherStream* stream, const uint8_t* in, uint64_t size, uint8_t* out);
+
+// AEAD: encrypt пишет tag, decrypt сверяет с tag. Возвращает 1, 0 = tag не
+// совпал. Stream стирается в любом случае
+int cipher_stream_final(CipherStream* stream, uint8_t* tag);
+void cipher_stream_wipe(CipherStream* stream);
+
+const char* cipher_name(uint32_t cipher);
+void cipher_engine_print_info(void);
+void cipher_key_cache_print_stats(void);
+
+#endif // OPERATIONS_CIPHER_H
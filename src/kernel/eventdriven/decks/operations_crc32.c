@@ -0,0 +1,224 @@
+#include "operations_crc32.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+#define CRC32_POLY_IEEE        0xEDB88320
+#define CRC32_POLY_CASTAGNOLI  0x82F63B78
+
+#define CPUID_ECX_PCLMULQDQ    (1 << 1)
+#define CPUID_ECX_SSE42        (1 << 20)
+
+// tables[k][i] = CRC байта i, за которым идут k нулевых байт
+static uint32_t crc32_tables[8][256];
+static uint32_t crc32c_tables[8][256];
+
+static int crc32_use_pclmul = 0;
+static int crc32c_use_sse42 = 0;
+
+typedef long long crc_v2di __attribute__((vector_size(16)));
+typedef int crc_v4si __attribute__((vector_size(16)));
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+static void crc32_build_tables(uint32_t tables[8][256], uint32_t poly) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        }
+        tables[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = tables[k - 1][i];
+            tables[k][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+        }
+    }
+}
+
+void crc32_engine_init(void) {
+    crc32_build_tables(crc32_tables, CRC32_POLY_IEEE);
+    crc32_build_tables(crc32c_tables, CRC32_POLY_CASTAGNOLI);
+
+    uint32_t a, b, c, d;
+    cpu_cpuid(1, 0, &a, &b, &c, &d);
+    crc32_use_pclmul = (c & CPUID_ECX_PCLMULQDQ) != 0;
+    crc32c_use_sse42 = (c & CPUID_ECX_SSE42) != 0;
+}
+
+// ============================================================================
+// SLICING-BY-8 (fallback и хвосты)
+// ============================================================================
+
+static uint32_t crc32_slice8(uint32_t tables[8][256], uint32_t crc,
+                             const uint8_t* data, uint64_t size) {
+    while (size >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+
+        crc = tables[7][lo & 0xFF] ^ tables[6][(lo >> 8) & 0xFF] ^
+              tables[5][(lo >> 16) & 0xFF] ^ tables[4][lo >> 24] ^
+              tables[3][hi & 0xFF] ^ tables[2][(hi >> 8) & 0xFF] ^
+              tables[1][(hi >> 16) & 0xFF] ^ tables[0][hi >> 24];
+
+        data += 8;
+        size -= 8;
+    }
+
+    while (size-- > 0) {
+        crc = tables[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+// ============================================================================
+// PCLMULQDQ FOLDING (IEEE)
+// ============================================================================
+//
+// Intel "Fast CRC Computation Using PCLMULQDQ": 4 независимых 128-bit
+// аккумулятора сворачиваются на 512 бит вперёд, затем в один, затем
+// 128 → 64 → 32 и Barrett reduction. Константы - x^n mod P (bit-reflected).
+//
+// ============================================================================
+
+#define CRC_CLMUL(a, b, imm) __builtin_ia32_pclmulqdq128((a), (b), (imm))
+
+static inline __attribute__((target("pclmul,sse2")))
+crc_v2di crc32_load128(const uint8_t* p) {
+    crc_v2di v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// low(x) * low(k) ^ high(x) * high(k)
+static inline __attribute__((target("pclmul,sse2")))
+crc_v2di crc32_fold128(crc_v2di x, crc_v2di k) {
+    return CRC_CLMUL(x, k, 0x00) ^ CRC_CLMUL(x, k, 0x11);
+}
+
+// size >= CRC32_FOLD_MIN_SIZE и кратен 16
+static __attribute__((target("pclmul,sse2")))
+uint32_t crc32_pclmul(uint32_t crc, const uint8_t* data, uint64_t size) {
+    const crc_v2di k1k2 = { 0x154442bd4LL, 0x1c6e41596LL };   // Fold by 4 (512 bit)
+    const crc_v2di k3k4 = { 0x1751997d0LL, 0x0ccaa009eLL };   // Fold by 1 (128 bit)
+    const crc_v2di k5 = { 0x163cd6124LL, 0 };                 // 64 → 32
+    const crc_v2di poly = { 0x1db710641LL, 0x1f7011641LL };   // P' и mu (Barrett)
+    const crc_v2di mask32 = { 0xFFFFFFFFLL, 0 };
+
+    crc_v2di x1 = crc32_load128(data) ^ (crc_v2di){ crc, 0 };
+    crc_v2di x2 = crc32_load128(data + 16);
+    crc_v2di x3 = crc32_load128(data + 32);
+    crc_v2di x4 = crc32_load128(data + 48);
+    data += 64;
+    size -= 64;
+
+    while (size >= 64) {
+        x1 = crc32_fold128(x1, k1k2) ^ crc32_load128(data);
+        x2 = crc32_fold128(x2, k1k2) ^ crc32_load128(data + 16);
+        x3 = crc32_fold128(x3, k1k2) ^ crc32_load128(data + 32);
+        x4 = crc32_fold128(x4, k1k2) ^ crc32_load128(data + 48);
+        data += 64;
+        size -= 64;
+    }
+
+    // 4 аккумулятора → 1
+    x1 = crc32_fold128(x1, k3k4) ^ x2;
+    x1 = crc32_fold128(x1, k3k4) ^ x3;
+    x1 = crc32_fold128(x1, k3k4) ^ x4;
+
+    while (size >= 16) {
+        x1 = crc32_fold128(x1, k3k4) ^ crc32_load128(data);
+        data += 16;
+        size -= 16;
+    }
+
+    // 128 → 64 (плюс 32 нулевых бита)
+    x1 = (crc_v2di){ x1[1], 0 } ^ CRC_CLMUL(x1, k3k4, 0x10);
+
+    // 64 → 32
+    x2 = __builtin_ia32_psrldqi128(x1, 32);
+    x1 = CRC_CLMUL(x1 & mask32, k5, 0x00) ^ x2;
+
+    // Barrett reduction
+    x2 = x1;
+    x1 = CRC_CLMUL(x1 & mask32, poly, 0x10);
+    x1 = CRC_CLMUL(x1 & mask32, poly, 0x00);
+    x1 ^= x2;
+
+    return (uint32_t)((crc_v4si)x1)[1];
+}
+
+// ============================================================================
+// SSE4.2 CRC32 (Castagnoli)
+// ============================================================================
+
+static __attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, uint64_t size) {
+    uint64_t crc64 = crc;
+
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+
+    uint32_t crc32 = (uint32_t)crc64;
+    while (size-- > 0) {
+        crc32 = __builtin_ia32_crc32qi(crc32, *data++);
+    }
+    return crc32;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint64_t size) {
+    crc = ~crc;
+
+    if (crc32_use_pclmul && size >= CRC32_FOLD_MIN_SIZE) {
+        uint64_t folded = size & ~(uint64_t)15;
+        // XMM регистры - только внутри kernel SIMD секции
+        kernel_fpu_begin();
+        crc = crc32_pclmul(crc, data, folded);
+        kernel_fpu_end();
+        data += folded;
+        size -= folded;
+    }
+
+    return ~crc32_slice8(crc32_tables, crc, data, size);
+}
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t* data, uint64_t size) {
+    if (crc32c_use_sse42) {
+        return ~crc32c_sse42(~crc, data, size);
+    }
+    return ~crc32_slice8(crc32c_tables, ~crc, data, size);
+}
+
+uint32_t crc32_compute(const uint8_t* data, uint64_t size) {
+    return crc32_update(0, data, size);
+}
+
+uint32_t crc32c_compute(const uint8_t* data, uint64_t size) {
+    return crc32c_update(0, data, size);
+}
+
+void crc32_engine_print_info(void) {
+    kprintf("[OPERATIONS]   - CRC32: %s, CRC32C: %s\n",
+            crc32_use_pclmul ? "PCLMULQDQ folding" : "slicing-by-8",
+            crc32c_use_sse42 ? "SSE4.2 crc32" : "slicing-by-8");
+}
@@ -0,0 +1,41 @@
+#ifndef OPERATIONS_CRC32_H
+#define OPERATIONS_CRC32_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// CRC32 ENGINE - Operations deck checksums
+// ============================================================================
+//
+// Два полинома, реализация выбирается один раз при init по cpu_cpuid:
+//
+//   CRC32  (IEEE 0xEDB88320, EVENT_OP_HASH_CRC32)
+//     PCLMULQDQ  → folding по 64 байта (4 x 128 bit), хвост slicing-by-8
+//     иначе      → slicing-by-8
+//
+//   CRC32C (Castagnoli 0x82F63B78, EVENT_OP_HASH_CRC32C)
+//     SSE4.2     → инструкция crc32 по 8 байт
+//     иначе      → slicing-by-8
+//
+// SSE4.2 crc32 считает ТОЛЬКО Castagnoli - для IEEE CRC32 она не подходит,
+// поэтому аппаратный путь IEEE - carry-less multiply.
+//
+// ============================================================================
+
+#define CRC32_FOLD_MIN_SIZE 64     // Меньше - slicing-by-8 быстрее setup'а folding
+
+// Таблицы slicing-by-8 и выбор реализации. Вызывается до первого compute
+void crc32_engine_init(void);
+
+// Стандартная обработка: init ~0, результат ~crc
+uint32_t crc32_compute(const uint8_t* data, uint64_t size);
+uint32_t crc32c_compute(const uint8_t* data, uint64_t size);
+
+// Продолжение по кускам (streaming): crc = результат предыдущего update,
+// 0 для первого куска. update(update(0, a), b) == compute(a || b)
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint64_t size);
+uint32_t crc32c_update(uint32_t crc, const uint8_t* data, uint64_t size);
+
+void crc32_engine_print_info(void);
+
+#endif // OPERATIONS_CRC32_H
@@ -1,4 +1,12 @@
 #include "deck_interface.h"
+#include "operations_memo.h"
+#include "operations_crc32.h"
+#include "operations_vector.h"
+#include "operations_lz4.h"
+#include "operations_cipher.h"
+#include "operations_stream.h"
+#include "workflow.h"
+#include "ws_deque.h"
 #include "klib.h"
 
 // ============================================================================
@@ -6,8 +14,8 @@
 // ============================================================================
 //
 // According to idea.txt, this deck handles:
-// - Compression (RLE, LZ77, zlib-like)
-// - Encryption (AES, XOR, etc.)
+// - Compression (RLE, LZ4 block / frame)
+// - Encryption (AES-CTR/GCM, ChaCha20-Poly1305, XOR)
 // - Hashing (SHA256, MD5, CRC32)
 // - Media processing (image/video transformation)
 // - Mathematical transformations
@@ -19,47 +27,18 @@
 // HASHING OPERATIONS
 // ============================================================================
 
-// CRC32 Table (precomputed for fast calculation)
-static uint32_t crc32_table[256];
-static int crc32_table_initialized = 0;
+// CRC32 / CRC32C - operations_crc32.c (PCLMULQDQ / SSE4.2 / slicing-by-8)
 
-static void crc32_init_table(void) {
-    if (crc32_table_initialized) return;
-
-    for (uint32_t i = 0; i < 256; i++) {
-        uint32_t crc = i;
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ 0xEDB88320;
-            } else {
-                crc >>= 1;
-            }
-        }
-        crc32_table[i] = crc;
-    }
-    crc32_table_initialized = 1;
-}
-
-static uint32_t crc32_compute(const uint8_t* data, uint64_t size) {
-    if (!crc32_table_initialized) {
-        crc32_init_table();
-    }
-
-    uint32_t crc = 0xFFFFFFFF;
+// Simple hash function (djb2); update - продолжение для streams
+static uint64_t djb2_update(uint64_t hash, const uint8_t* data, uint64_t size) {
     for (uint64_t i = 0; i < size; i++) {
-        uint8_t byte = data[i];
-        crc = crc32_table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+        hash = ((hash << 5) + hash) + data[i];  // hash * 33 + c
     }
-    return ~crc;
+    return hash;
 }
 
-// Simple hash function (djb2)
 static uint64_t djb2_hash(const uint8_t* data, uint64_t size) {
-    uint64_t hash = 5381;
-    for (uint64_t i = 0; i < size; i++) {
-        hash = ((hash << 5) + hash) + data[i];  // hash * 33 + c
-    }
-    return hash;
+    return djb2_update(5381, data, size);
 }
 
 // ============================================================================
@@ -137,26 +116,7 @@ static void xor_decrypt(uint8_t* data, uint64_t size, const uint8_t* key, uint64
 // MATHEMATICAL OPERATIONS
 // ============================================================================
 
-// Vector addition (element-wise)
-static void vector_add(const uint64_t* a, const uint64_t* b, uint64_t* result, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        result[i] = a[i] + b[i];
-    }
-}
-
-// Vector multiplication (element-wise)
-static void vector_multiply(const uint64_t* a, const uint64_t* b, uint64_t* result, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        result[i] = a[i] * b[i];
-    }
-}
-
-// Scalar multiplication
-static void vector_scale(const uint64_t* input, uint64_t scalar, uint64_t* output, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        output[i] = input[i] * scalar;
-    }
-}
+// Vector kernels - operations_vector.c (SSE2 / AVX2, u64 / f32 / f64)
 
 // ============================================================================
 // EVENT PROCESSING
@@ -165,15 +125,366 @@ static void vector_scale(const uint64_t* input, uint64_t scalar, uint64_t* outpu
 // Define new event types for Operations Deck
 #define EVENT_OP_HASH_CRC32     100
 #define EVENT_OP_HASH_DJB2      101
+#define EVENT_OP_HASH_CRC32C    102
 #define EVENT_OP_COMPRESS_RLE   110
 #define EVENT_OP_DECOMPRESS_RLE 111
+#define EVENT_OP_COMPRESS_LZ4         112
+#define EVENT_OP_DECOMPRESS_LZ4       113
+#define EVENT_OP_COMPRESS_LZ4_FRAME   114
+#define EVENT_OP_DECOMPRESS_LZ4_FRAME 115
 #define EVENT_OP_ENCRYPT_XOR    120
 #define EVENT_OP_DECRYPT_XOR    121
+#define EVENT_OP_ENCRYPT        122     // AES-CTR / AES-GCM / ChaCha20-Poly1305 (operations_cipher.h)
+#define EVENT_OP_DECRYPT        123
 #define EVENT_OP_VECTOR_ADD     130
 #define EVENT_OP_VECTOR_MUL     131
 #define EVENT_OP_VECTOR_SCALE   132
+#define EVENT_OP_STREAM_OPEN    140     // Stateful sessions (operations_stream.h)
+#define EVENT_OP_STREAM_UPDATE  141
+#define EVENT_OP_STREAM_FINAL   142
+#define EVENT_OP_STREAM_ABORT   143
+
+// Memo: результат уходит в cache до deck_complete() - после него entry
+// уже может забрать Guide (и освободить Execution)
+static void operations_complete(RoutingEntry* entry, const OperationsMemoKey* memo,
+                                void* result, ResultType type, uint64_t size) {
+    if (memo) {
+        operations_memo_store(memo, result, type, size);
+    }
+    deck_complete(entry, DECK_PREFIX_OPERATIONS, result, type);
+}
 
-int operations_deck_process(RoutingEntry* entry) {
+// Payload: [count | elem << 56 : 8][scalar:8 (SCALE)][операнды...]
+// С buffer (registered / input_result) операнды целиком в buffer - размер
+// вектора не ограничен 224 байтами, результат - ResultBuffer
+static int operations_vector_op(RoutingEntry* entry, const OperationsMemoKey* memo,
+                                uint32_t op, const char* name, uint32_t error_code) {
+    uint8_t* payload = entry->payload;
+    uint64_t header = *(uint64_t*)payload;
+    uint64_t count = VECTOR_HEADER_COUNT(header);
+    uint32_t elem = VECTOR_HEADER_ELEM(header);
+    uint32_t elem_size = vector_elem_size(elem);
+
+    uint64_t operand_offset = op == VECTOR_OP_SCALE ? 16 : 8;
+    uint64_t operand_count = op == VECTOR_OP_SCALE ? 1 : 2;
+    const uint8_t* operands = entry->buffer ? entry->buffer : payload + operand_offset;
+    uint64_t available = entry->buffer ? entry->buffer_length : EVENT_DATA_SIZE - operand_offset;
+
+    // DEFENSIVE: деление вместо умножения - count из user памяти
+    if (elem_size == 0 || count == 0 || count > available / (elem_size * operand_count)) {
+        deck_error(entry, DECK_PREFIX_OPERATIONS, error_code);
+        return 0;
+    }
+
+    uint64_t result_size = count * elem_size;
+    const uint8_t* a = operands;
+    const uint8_t* b = op == VECTOR_OP_SCALE ? payload + 8 : operands + result_size;
+
+    if (entry->buffer) {
+        ResultBuffer* output = result_buffer_alloc(result_size);
+        if (!output) {
+            deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                              "Vector: failed to allocate output");
+            return 0;
+        }
+        vector_engine_apply(op, elem, a, b, output->data, count);
+        output->size = result_size;
+
+        operations_complete(entry, memo, output, RESULT_TYPE_BUFFER, output->capacity);
+    } else {
+        void* result = kmalloc(result_size);
+        if (!result) {
+            deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                              "Vector: failed to allocate result");
+            return 0;
+        }
+        vector_engine_apply(op, elem, a, b, result, count);
+
+        operations_complete(entry, memo, result, RESULT_TYPE_KMALLOC, result_size);
+    }
+
+    kprintf("[OPERATIONS] Vector %s: %lu %s elements%s\n",
+            name, count, vector_elem_name(elem), entry->buffer ? " (buffer)" : "");
+    return 1;
+}
+
+// Payload: [cipher:1][key_size:1][reserved:2][aad_size:4][data_size:8]
+//          [nonce:12][reserved:4][key:32][aad...][data...]
+// С buffer (registered / input_result) data целиком из buffer.
+// Результат (ResultBuffer): [cipher:1 - только CIPHER_AUTO][ciphertext][tag:16 - AEAD];
+// decrypt принимает тот же формат
+#define OPERATIONS_CIPHER_HEADER      64
+#define OPERATIONS_CIPHER_KEY_OFFSET  32    // И в OPEN stream: 8 + params[24]
+
+static int operations_cipher_run(RoutingEntry* entry, int encrypt) {
+    uint8_t* payload = entry->payload;
+    uint32_t cipher = payload[0];
+    uint32_t key_size = payload[1];
+    uint32_t aad_size = *(uint32_t*)(payload + 4);
+    uint64_t data_size = entry->buffer ? entry->buffer_length : *(uint64_t*)(payload + 8);
+    const uint8_t* nonce = payload + 16;
+    const uint8_t* key_bytes = payload + OPERATIONS_CIPHER_KEY_OFFSET;
+    const uint8_t* aad = payload + OPERATIONS_CIPHER_HEADER;
+    const uint8_t* data = entry->buffer ? entry->buffer : aad + aad_size;
+
+    // DEFENSIVE: размеры из user памяти
+    uint64_t inline_max = EVENT_DATA_SIZE - OPERATIONS_CIPHER_HEADER;
+    if (aad_size > inline_max || (!entry->buffer && data_size > inline_max - aad_size)) {
+        deck_error(entry, DECK_PREFIX_OPERATIONS, 16);
+        return 0;
+    }
+
+    // AUTO: encrypt берёт лучший AEAD этого CPU и пишет его первым байтом
+    int sealed_box = cipher == CIPHER_AUTO;
+    if (sealed_box) {
+        if (encrypt) {
+            cipher = cipher_auto_select();
+        } else if (data_size > 0) {
+            cipher = data[0];
+            data++;
+            data_size--;
+        }
+    }
+
+    uint64_t tag_size = cipher_is_aead(cipher) ? CIPHER_TAG_SIZE : 0;
+    if (!encrypt && data_size < tag_size) {
+        deck_error(entry, DECK_PREFIX_OPERATIONS, 17);
+        return 0;
+    }
+    uint64_t text_size = encrypt ? data_size : data_size - tag_size;
+    uint64_t output_size = encrypt ? sealed_box + data_size + tag_size : text_size;
+
+    // Schedule workflow берётся из cache - expansion не на каждое событие
+    uint64_t workflow_id = 0;
+    if (entry->workflow_tag) {
+        WorkflowInstance* instance = workflow_instance_get(WORKFLOW_TAG_INSTANCE(entry->workflow_tag));
+        if (instance) {
+            workflow_id = instance->workflow->workflow_id;
+        }
+    }
+
+    CipherKey scratch;
+    CipherKey* key = cipher_key_acquire(workflow_id, cipher, key_bytes, key_size, &scratch);
+    if (!key) {
+        deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_INVALID_PARAMETER,
+                          "Cipher: unknown cipher or invalid key size");
+        return 0;
+    }
+
+    ResultBuffer* output = result_buffer_alloc(output_size);
+    if (!output) {
+        cipher_key_release(key);
+        deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                          "Cipher: failed to allocate output");
+        return 0;
+    }
+
+    if (encrypt) {
+        uint8_t* out = output->data;
+        if (sealed_box) {
+            *out++ = (uint8_t)cipher;
+        }
+        cipher_seal(key, nonce, aad, aad_size, data, data_size, out, out + data_size);
+    } else if (!cipher_open(key, nonce, aad, aad_size, data, text_size,
+                            output->data, data + text_size)) {
+        cipher_key_release(key);
+        result_buffer_release(output);
+        deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OP_AUTH_FAILED,
+                          "Cipher: authentication tag mismatch");
+        return 0;
+    }
+    cipher_key_release(key);
+    output->size = output_size;
+
+    deck_complete(entry, DECK_PREFIX_OPERATIONS, output, RESULT_TYPE_BUFFER);
+    kprintf("[OPERATIONS] %s %s: %lu bytes%s\n", cipher_name(cipher),
+            encrypt ? "encrypt" : "decrypt", text_size, workflow_id ? " (cached key)" : "");
+    return 1;
+}
+
+// Ключ в копии payload не переживает операцию на любом исходе: entry
+// дальше уходит в Execution Deck и обратно в pool
+static int operations_cipher_op(RoutingEntry* entry, int encrypt) {
+    int done = operations_cipher_run(entry, encrypt);
+    cipher_wipe(entry->payload + OPERATIONS_CIPHER_KEY_OFFSET, CIPHER_KEY_MAX);
+    return done;
+}
+
+// OPEN:   [kind:4][reserved:4][cipher params (ENCRYPT / DECRYPT), operations_stream.h]
+// UPDATE: [session_id:8][seq:8][size:8][data...]
+// FINAL:  [session_id:8][seq:8][size:8][tag:16 (DECRYPT AEAD)][data...]
+// ABORT:  [session_id:8]
+// UPDATE / FINAL с buffer (registered / input_result): data целиком из buffer
+#define OPERATIONS_STREAM_CHUNK_HEADER  24
+#define OPERATIONS_STREAM_FINAL_HEADER  40
+
+static int operations_stream_op(RoutingEntry* entry) {
+    uint8_t* payload = entry->payload;
+    uint32_t type = entry->event_copy.type;
+    uint64_t owner_pid = entry->owner ? entry->owner_pid : 0;
+
+    if (type == EVENT_OP_STREAM_OPEN) {
+        uint32_t kind = *(uint32_t*)payload;
+
+        // Результат выделяем до open: session без id у submitter'а - утечка
+        uint64_t* result = (uint64_t*)kmalloc(sizeof(uint64_t));
+        if (!result) {
+            deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                              "Stream: failed to allocate result");
+            return 0;
+        }
+
+        uint64_t id = operations_stream_open(owner_pid, kind, payload + 8, EVENT_DATA_SIZE - 8);
+        cipher_wipe(payload + OPERATIONS_CIPHER_KEY_OFFSET, CIPHER_KEY_MAX);
+        if (!id) {
+            kfree(result);
+            deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_INVALID_PARAMETER,
+                              "Stream: invalid kind / cipher parameters, no free session or PID limit");
+            return 0;
+        }
+        *result = id;
+
+        deck_complete(entry, DECK_PREFIX_OPERATIONS, result, RESULT_TYPE_KMALLOC);
+        kprintf("[OPERATIONS] Stream open: id=0x%lx kind=%u\n", id, kind);
+        return 1;
+    }
+
+    uint64_t id = *(uint64_t*)payload;
+    uint64_t seq = type == EVENT_OP_STREAM_ABORT ? STREAM_SEQ_ANY : *(uint64_t*)(payload + 8);
+    uint32_t error_code = 0;
+    OperationsStream* stream = operations_stream_get(id, owner_pid, seq, &error_code);
+    if (!stream) {
+        deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, error_code,
+                          "Stream: unknown session, out-of-order chunk or concurrent use");
+        return 0;
+    }
+
+    if (type == EVENT_OP_STREAM_ABORT) {
+        uint64_t bytes_in = stream->bytes_in;
+        operations_stream_close(stream);
+        deck_complete(entry, DECK_PREFIX_OPERATIONS, 0, RESULT_TYPE_NONE);
+        kprintf("[OPERATIONS] Stream abort: id=0x%lx after %lu bytes\n", id, bytes_in);
+        return 1;
+    }
+
+    int final = type == EVENT_OP_STREAM_FINAL;
+    uint64_t header = final ? OPERATIONS_STREAM_FINAL_HEADER : OPERATIONS_STREAM_CHUNK_HEADER;
+    uint64_t size = entry->buffer ? entry->buffer_length : *(uint64_t*)(payload + 16);
+    const uint8_t* data = entry->buffer ? entry->buffer : payload + header;
+
+    if (!entry->buffer && size > EVENT_DATA_SIZE - header) {
+        operations_stream_put(stream);
+        deck_error(entry, DECK_PREFIX_OPERATIONS, 18);
+        return 0;
+    }
+
+    // state меняется только после успешного выделения результата -
+    // chunk с ошибкой можно повторить с тем же seq
+    void* result = 0;
+    ResultType result_type = RESULT_TYPE_KMALLOC;
+    uint64_t produced = 0;
+
+    switch (stream->kind) {
+        case STREAM_KIND_CRC32:
+        case STREAM_KIND_CRC32C:
+        case STREAM_KIND_DJB2: {
+            uint64_t* value = (uint64_t*)kmalloc(sizeof(uint64_t));
+            if (!value) {
+                break;
+            }
+            if (stream->kind == STREAM_KIND_CRC32) {
+                stream->state.crc = crc32_update(stream->state.crc, data, size);
+            } else if (stream->kind == STREAM_KIND_CRC32C) {
+                stream->state.crc = crc32c_update(stream->state.crc, data, size);
+            } else {
+                stream->state.djb2 = djb2_update(stream->state.djb2, data, size);
+            }
+
+            // UPDATE: байт всего, FINAL: hash (CRC в младших 32 битах)
+            if (!final) {
+                *value = stream->bytes_in + size;
+            } else {
+                *value = stream->kind == STREAM_KIND_DJB2 ? stream->state.djb2 : stream->state.crc;
+            }
+            result = value;
+            break;
+        }
+
+        case STREAM_KIND_LZ4_FRAME: {
+            uint32_t flags = (stream->state.lz4_begun ? 0 : LZ4_FRAME_BEGIN) |
+                             (final ? LZ4_FRAME_END : 0);
+            ResultBuffer* output = result_buffer_alloc(LZ4_FRAME_BOUND(size));
+            if (!output) {
+                break;
+            }
+            output->size = lz4_frame_compress(data, size, output->data, output->capacity, flags);
+            if (output->size == 0 && (size > 0 || flags != 0)) {
+                result_buffer_release(output);
+                operations_stream_put(stream);
+                deck_error(entry, DECK_PREFIX_OPERATIONS, 19);
+                return 0;
+            }
+            stream->state.lz4_begun = 1;
+            produced = output->size;
+            result = output;
+            result_type = RESULT_TYPE_BUFFER;
+            break;
+        }
+
+        case STREAM_KIND_ENCRYPT:
+        case STREAM_KIND_DECRYPT: {
+            int encrypt = stream->kind == STREAM_KIND_ENCRYPT;
+            uint64_t tag_size = final && encrypt && cipher_is_aead(stream->cipher->key.cipher)
+                              ? CIPHER_TAG_SIZE : 0;
+            ResultBuffer* output = result_buffer_alloc(size + tag_size);
+            if (!output) {
+                break;
+            }
+            cipher_stream_update(stream->cipher, data, size, output->data);
+
+            // CRITICAL: tag - проверка всего потока; без него финальный chunk не отдаём
+            if (final && !cipher_stream_final(stream->cipher,
+                                              encrypt ? output->data + size : payload + 24)) {
+                memset(output->data, 0, size);
+                result_buffer_release(output);
+                operations_stream_close(stream);
+                deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OP_AUTH_FAILED,
+                                  "Stream: authentication tag mismatch");
+                return 0;
+            }
+            output->size = size + tag_size;
+            produced = output->size;
+            result = output;
+            result_type = RESULT_TYPE_BUFFER;
+            break;
+        }
+    }
+
+    if (!result) {
+        operations_stream_put(stream);
+        deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                          "Stream: failed to allocate chunk result");
+        return 0;
+    }
+
+    stream->bytes_in += size;
+    stream->bytes_out += produced;
+    stream->next_seq++;
+    uint64_t bytes_in = stream->bytes_in;
+
+    if (final) {
+        operations_stream_close(stream);
+    } else {
+        operations_stream_put(stream);
+    }
+
+    deck_complete(entry, DECK_PREFIX_OPERATIONS, result, result_type);
+    kprintf("[OPERATIONS] Stream %s: id=0x%lx seq=%lu chunk=%lu total=%lu\n",
+            final ? "final" : "update", id, seq, size, bytes_in);
+    return 1;
+}
+
+static int operations_deck_compute(RoutingEntry* entry, const OperationsMemoKey* memo) {
     // DEFENSIVE: Validate input
     if (!entry) {
         kprintf("[OPERATIONS] ERROR: NULL routing entry\n");
@@ -181,6 +492,7 @@ int operations_deck_process(RoutingEntry* entry) {
     }
 
     Event* event = &entry->event_copy;
+    uint8_t* payload = entry->payload;  // Kernel копия payload (снимок ingestion)
 
     // DEFENSIVE: Validate event type is in operations range (100-199)
     if (event->type < 100 || event->type >= 200) {
@@ -197,9 +509,12 @@ int operations_deck_process(RoutingEntry* entry) {
         case EVENT_OP_HASH_CRC32: {
             // Payload: [size:8][data:...]
 
+            // Registered buffer: данные хешируются прямо в страницах процесса
+            // (границы проверены при ingestion), payload не используется
+
             // DEFENSIVE: Validate payload has at least size field
-            uint64_t size = *(uint64_t*)event->data;
-            const uint8_t* data = event->data + 8;
+            uint64_t size = entry->buffer ? entry->buffer_length : *(uint64_t*)payload;
+            const uint8_t* data = entry->buffer ? entry->buffer : payload + 8;
 
             // DEFENSIVE: Validate data size is non-zero
             if (size == 0) {
@@ -209,7 +524,7 @@ int operations_deck_process(RoutingEntry* entry) {
             }
 
             // DEFENSIVE: Validate data size fits in event payload
-            if (size > EVENT_DATA_SIZE - 8) {
+            if (!entry->buffer && size > EVENT_DATA_SIZE - 8) {
                 deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OP_INVALID_INPUT,
                                   "CRC32: data size exceeds event payload limit");
                 return 0;
@@ -227,17 +542,42 @@ int operations_deck_process(RoutingEntry* entry) {
 
             *result = hash;
 
-            deck_complete(entry, DECK_PREFIX_OPERATIONS, result, RESULT_TYPE_KMALLOC);
+            operations_complete(entry, memo, result, RESULT_TYPE_KMALLOC, sizeof(uint32_t));
             kprintf("[OPERATIONS] CRC32 hash: 0x%x (size=%lu)\n", hash, size);
             return 1;
         }
 
+        case EVENT_OP_HASH_CRC32C: {
+            // Payload: [size:8][data:...] или registered buffer (как CRC32)
+            uint64_t size = entry->buffer ? entry->buffer_length : *(uint64_t*)payload;
+            const uint8_t* data = entry->buffer ? entry->buffer : payload + 8;
+
+            if (size == 0 || (!entry->buffer && size > EVENT_DATA_SIZE - 8)) {
+                deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OP_INVALID_INPUT,
+                                  "CRC32C: invalid data size");
+                return 0;
+            }
+
+            uint32_t* result = (uint32_t*)kmalloc(sizeof(uint32_t));
+            if (!result) {
+                deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                                  "CRC32C: failed to allocate result buffer");
+                return 0;
+            }
+
+            *result = crc32c_compute(data, size);
+
+            operations_complete(entry, memo, result, RESULT_TYPE_KMALLOC, sizeof(uint32_t));
+            kprintf("[OPERATIONS] CRC32C hash: 0x%x (size=%lu)\n", *result, size);
+            return 1;
+        }
+
         case EVENT_OP_HASH_DJB2: {
-            // Payload: [size:8][data:...]
-            uint64_t size = *(uint64_t*)event->data;
-            const uint8_t* data = event->data + 8;
+            // Payload: [size:8][data:...] или registered buffer
+            uint64_t size = entry->buffer ? entry->buffer_length : *(uint64_t*)payload;
+            const uint8_t* data = entry->buffer ? entry->buffer : payload + 8;
 
-            if (size > EVENT_DATA_SIZE - 8) {
+            if (!entry->buffer && size > EVENT_DATA_SIZE - 8) {
                 deck_error(entry, DECK_PREFIX_OPERATIONS, 2);
                 return 0;
             }
@@ -247,7 +587,7 @@ int operations_deck_process(RoutingEntry* entry) {
             uint64_t* result = (uint64_t*)kmalloc(sizeof(uint64_t));
             *result = hash;
 
-            deck_complete(entry, DECK_PREFIX_OPERATIONS, result, RESULT_TYPE_KMALLOC);
+            operations_complete(entry, memo, result, RESULT_TYPE_KMALLOC, sizeof(uint64_t));
             kprintf("[OPERATIONS] DJB2 hash: 0x%lx (size=%lu)\n", hash, size);
             return 1;
         }
@@ -257,73 +597,170 @@ int operations_deck_process(RoutingEntry* entry) {
         // ====================================================================
 
         case EVENT_OP_COMPRESS_RLE: {
-            // Payload: [input_size:8][data:...]
-            uint64_t input_size = *(uint64_t*)event->data;
-            const uint8_t* input_data = event->data + 8;
+            // Payload: [input_size:8][data:...] или buffer (registered / input_result)
+            uint64_t input_size = entry->buffer ? entry->buffer_length : *(uint64_t*)payload;
+            const uint8_t* input_data = entry->buffer ? entry->buffer : payload + 8;
 
-            if (input_size > EVENT_DATA_SIZE - 8) {
+            if (input_size == 0 || (!entry->buffer && input_size > EVENT_DATA_SIZE - 8)) {
                 deck_error(entry, DECK_PREFIX_OPERATIONS, 3);
                 return 0;
             }
 
             // Allocate output buffer (worst case: 2x input size)
-            uint8_t* output = (uint8_t*)kmalloc(input_size * 2);
-            uint64_t output_size = rle_compress(input_data, input_size, output, input_size * 2);
+            // ResultBuffer: следующий node (write, hash) берёт его как input
+            ResultBuffer* output = result_buffer_alloc(input_size * 2);
+            if (!output) {
+                deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                                  "RLE compress: failed to allocate output");
+                return 0;
+            }
+            uint64_t output_size = rle_compress(input_data, input_size, output->data, input_size * 2);
 
             if (output_size == 0) {
-                kfree(output);
+                result_buffer_release(output);
                 deck_error(entry, DECK_PREFIX_OPERATIONS, 4);
                 return 0;
             }
+            output->size = output_size;
 
-            deck_complete(entry, DECK_PREFIX_OPERATIONS, output, RESULT_TYPE_KMALLOC);
-            kprintf("[OPERATIONS] RLE compress: %lu -> %lu bytes (%.1f%% ratio)\n",
-                    input_size, output_size, (float)output_size * 100 / input_size);
+            operations_complete(entry, memo, output, RESULT_TYPE_BUFFER, output->capacity);
+            // Ядро без FPU (-mgeneral-regs-only): процент в десятых, целыми
+            uint64_t ratio = output_size * 1000 / input_size;
+            kprintf("[OPERATIONS] RLE compress: %lu -> %lu bytes (%lu.%lu%% ratio)\n",
+                    input_size, output_size, ratio / 10, ratio % 10);
             return 1;
         }
 
         case EVENT_OP_DECOMPRESS_RLE: {
             // Payload: [compressed_size:8][output_capacity:8][data:...]
-            uint64_t compressed_size = *(uint64_t*)event->data;
-            uint64_t output_capacity = *(uint64_t*)(event->data + 8);
-            const uint8_t* compressed_data = event->data + 16;
+            // С buffer: данные из buffer, payload = [unused:8][output_capacity:8]
+            uint64_t compressed_size = entry->buffer ? entry->buffer_length : *(uint64_t*)payload;
+            uint64_t output_capacity = *(uint64_t*)(payload + 8);
+            const uint8_t* compressed_data = entry->buffer ? entry->buffer : payload + 16;
 
-            if (compressed_size > EVENT_DATA_SIZE - 16) {
+            if (!entry->buffer && compressed_size > EVENT_DATA_SIZE - 16) {
                 deck_error(entry, DECK_PREFIX_OPERATIONS, 5);
                 return 0;
             }
 
-            uint8_t* output = (uint8_t*)kmalloc(output_capacity);
+            ResultBuffer* output = result_buffer_alloc(output_capacity);
+            if (!output) {
+                deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                                  "RLE decompress: failed to allocate output");
+                return 0;
+            }
             uint64_t output_size = rle_decompress(compressed_data, compressed_size,
-                                                   output, output_capacity);
+                                                   output->data, output_capacity);
 
             if (output_size == 0) {
-                kfree(output);
+                result_buffer_release(output);
                 deck_error(entry, DECK_PREFIX_OPERATIONS, 6);
                 return 0;
             }
+            output->size = output_size;
 
-            deck_complete(entry, DECK_PREFIX_OPERATIONS, output, RESULT_TYPE_KMALLOC);
+            operations_complete(entry, memo, output, RESULT_TYPE_BUFFER, output->capacity);
             kprintf("[OPERATIONS] RLE decompress: %lu -> %lu bytes\n",
                     compressed_size, output_size);
             return 1;
         }
 
+        case EVENT_OP_COMPRESS_LZ4:
+        case EVENT_OP_COMPRESS_LZ4_FRAME: {
+            // Block: [input_size:8][data:...]
+            // Frame: [input_size:8][frame_flags:8][data:...] (LZ4_FRAME_BEGIN / END)
+            // С buffer: данные из buffer, payload = [unused:8][frame_flags:8]
+            int frame = event->type == EVENT_OP_COMPRESS_LZ4_FRAME;
+            uint64_t data_offset = frame ? 16 : 8;
+            uint64_t input_size = entry->buffer ? entry->buffer_length : *(uint64_t*)payload;
+            const uint8_t* input_data = entry->buffer ? entry->buffer : payload + data_offset;
+
+            if ((!frame && input_size == 0) ||
+                (!entry->buffer && input_size > EVENT_DATA_SIZE - data_offset)) {
+                deck_error(entry, DECK_PREFIX_OPERATIONS, 12);
+                return 0;
+            }
+
+            uint64_t capacity = frame ? LZ4_FRAME_BOUND(input_size) : LZ4_COMPRESS_BOUND(input_size);
+            ResultBuffer* output = result_buffer_alloc(capacity);
+            if (!output) {
+                deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                                  "LZ4 compress: failed to allocate output");
+                return 0;
+            }
+
+            uint64_t output_size = frame
+                ? lz4_frame_compress(input_data, input_size, output->data, capacity,
+                                     (uint32_t)*(uint64_t*)(payload + 8))
+                : lz4_compress_block(input_data, input_size, output->data, capacity);
+
+            if (output_size == 0) {
+                result_buffer_release(output);
+                deck_error(entry, DECK_PREFIX_OPERATIONS, 13);
+                return 0;
+            }
+            output->size = output_size;
+
+            operations_complete(entry, memo, output, RESULT_TYPE_BUFFER, output->capacity);
+            kprintf("[OPERATIONS] LZ4 %s compress: %lu -> %lu bytes\n",
+                    frame ? "frame" : "block", input_size, output_size);
+            return 1;
+        }
+
+        case EVENT_OP_DECOMPRESS_LZ4:
+        case EVENT_OP_DECOMPRESS_LZ4_FRAME: {
+            // Payload: [compressed_size:8][output_capacity:8][data:...]
+            // С buffer: данные из buffer, payload = [unused:8][output_capacity:8]
+            int frame = event->type == EVENT_OP_DECOMPRESS_LZ4_FRAME;
+            uint64_t compressed_size = entry->buffer ? entry->buffer_length : *(uint64_t*)payload;
+            uint64_t output_capacity = *(uint64_t*)(payload + 8);
+            const uint8_t* compressed_data = entry->buffer ? entry->buffer : payload + 16;
+
+            if (compressed_size == 0 || output_capacity == 0 ||
+                (!entry->buffer && compressed_size > EVENT_DATA_SIZE - 16)) {
+                deck_error(entry, DECK_PREFIX_OPERATIONS, 14);
+                return 0;
+            }
+
+            ResultBuffer* output = result_buffer_alloc(output_capacity);
+            if (!output) {
+                deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_OUT_OF_MEMORY,
+                                  "LZ4 decompress: failed to allocate output");
+                return 0;
+            }
+
+            int64_t output_size = frame
+                ? lz4_frame_decompress(compressed_data, compressed_size, output->data, output_capacity)
+                : lz4_decompress_block(compressed_data, compressed_size, output->data, output_capacity);
+
+            if (output_size < 0) {
+                result_buffer_release(output);
+                deck_error(entry, DECK_PREFIX_OPERATIONS, 15);
+                return 0;
+            }
+            output->size = (uint64_t)output_size;
+
+            operations_complete(entry, memo, output, RESULT_TYPE_BUFFER, output->capacity);
+            kprintf("[OPERATIONS] LZ4 %s decompress: %lu -> %ld bytes\n",
+                    frame ? "frame" : "block", compressed_size, output_size);
+            return 1;
+        }
+
         // ====================================================================
         // ENCRYPTION OPERATIONS
         // ====================================================================
 
         case EVENT_OP_ENCRYPT_XOR: {
             // Payload: [data_size:8][key_size:2][data:...][key:...]
-            uint64_t data_size = *(uint64_t*)event->data;
-            uint16_t key_size = *(uint16_t*)(event->data + 8);
+            uint64_t data_size = *(uint64_t*)payload;
+            uint16_t key_size = *(uint16_t*)(payload + 8);
 
             if (data_size + key_size + 10 > EVENT_DATA_SIZE) {
                 deck_error(entry, DECK_PREFIX_OPERATIONS, 7);
                 return 0;
             }
 
-            uint8_t* data = event->data + 10;
+            uint8_t* data = payload + 10;
             const uint8_t* key = data + data_size;
 
             // Allocate result buffer
@@ -339,15 +776,15 @@ int operations_deck_process(RoutingEntry* entry) {
 
         case EVENT_OP_DECRYPT_XOR: {
             // Same as encryption (XOR is symmetric)
-            uint64_t data_size = *(uint64_t*)event->data;
-            uint16_t key_size = *(uint16_t*)(event->data + 8);
+            uint64_t data_size = *(uint64_t*)payload;
+            uint16_t key_size = *(uint16_t*)(payload + 8);
 
             if (data_size + key_size + 10 > EVENT_DATA_SIZE) {
                 deck_error(entry, DECK_PREFIX_OPERATIONS, 8);
                 return 0;
             }
 
-            uint8_t* data = event->data + 10;
+            uint8_t* data = payload + 10;
             const uint8_t* key = data + data_size;
 
             uint8_t* result = (uint8_t*)kmalloc(data_size);
@@ -360,101 +797,276 @@ int operations_deck_process(RoutingEntry* entry) {
             return 1;
         }
 
+        case EVENT_OP_ENCRYPT:
+            return operations_cipher_op(entry, 1);
+
+        case EVENT_OP_DECRYPT:
+            return operations_cipher_op(entry, 0);
+
         // ====================================================================
         // MATHEMATICAL OPERATIONS
         // ====================================================================
 
-        case EVENT_OP_VECTOR_ADD: {
-            // Payload: [count:8][vector_a:...][vector_b:...]
-            uint64_t count = *(uint64_t*)event->data;
+        case EVENT_OP_VECTOR_ADD:
+            return operations_vector_op(entry, memo, VECTOR_OP_ADD, "add", 9);
 
-            if (count * 2 * sizeof(uint64_t) + 8 > EVENT_DATA_SIZE) {
-                deck_error(entry, DECK_PREFIX_OPERATIONS, 9);
-                return 0;
-            }
+        case EVENT_OP_VECTOR_MUL:
+            return operations_vector_op(entry, memo, VECTOR_OP_MUL, "multiply", 10);
+
+        case EVENT_OP_VECTOR_SCALE:
+            return operations_vector_op(entry, memo, VECTOR_OP_SCALE, "scale", 11);
 
-            const uint64_t* vector_a = (const uint64_t*)(event->data + 8);
-            const uint64_t* vector_b = vector_a + count;
+        // ====================================================================
+        // STREAMING SESSIONS
+        // ====================================================================
 
-            uint64_t* result = (uint64_t*)kmalloc(count * sizeof(uint64_t));
-            vector_add(vector_a, vector_b, result, count);
+        case EVENT_OP_STREAM_OPEN:
+        case EVENT_OP_STREAM_UPDATE:
+        case EVENT_OP_STREAM_FINAL:
+        case EVENT_OP_STREAM_ABORT:
+            return operations_stream_op(entry);
 
-            deck_complete(entry, DECK_PREFIX_OPERATIONS, result, RESULT_TYPE_KMALLOC);
-            kprintf("[OPERATIONS] Vector add: %lu elements\n", count);
+        default:
+            // PRODUCTION: Detailed error for unknown operations
+            kprintf("[OPERATIONS] ERROR: Unknown/unimplemented event type %d\n", event->type);
+            deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_NOT_IMPLEMENTED,
+                              "Operation type not implemented");
+            return 0;
+    }
+}
+
+// ============================================================================
+// INITIALIZATION & RUN
+// ============================================================================
+
+DeckContext operations_deck_context;
+
+#define OPERATIONS_DECK_BATCH_SIZE 16
+
+// Шифрование не кешируем: ключ не должен оседать в памяти ядра после события
+static int operations_memoizable(uint32_t type) {
+    switch (type) {
+        case EVENT_OP_HASH_CRC32:
+        case EVENT_OP_HASH_DJB2:
+        case EVENT_OP_HASH_CRC32C:
+        case EVENT_OP_COMPRESS_RLE:
+        case EVENT_OP_DECOMPRESS_RLE:
+        case EVENT_OP_COMPRESS_LZ4:
+        case EVENT_OP_DECOMPRESS_LZ4:
+        case EVENT_OP_COMPRESS_LZ4_FRAME:
+        case EVENT_OP_DECOMPRESS_LZ4_FRAME:
+        case EVENT_OP_VECTOR_ADD:
+        case EVENT_OP_VECTOR_MUL:
+        case EVENT_OP_VECTOR_SCALE:
             return 1;
-        }
+        default:
+            return 0;
+    }
+}
 
-        case EVENT_OP_VECTOR_MUL: {
-            uint64_t count = *(uint64_t*)event->data;
+// EVENT_FLAG_MEMOIZE: hit завершает entry без вычисления (operations_memo.h)
+int operations_deck_process(RoutingEntry* entry) {
+    if (!entry || !(entry->event_copy.flags & EVENT_FLAG_MEMOIZE) ||
+        !operations_memoizable(entry->event_copy.type)) {
+        return operations_deck_compute(entry, 0);
+    }
 
-            if (count * 2 * sizeof(uint64_t) + 8 > EVENT_DATA_SIZE) {
-                deck_error(entry, DECK_PREFIX_OPERATIONS, 10);
-                return 0;
-            }
+    OperationsMemoKey key;
+    operations_memo_key(entry, &key);
+
+    void* result;
+    ResultType type;
+    if (operations_memo_lookup(&key, &result, &type)) {
+        atomic_increment_u64(&operations_deck_context.stats.memo_hits);
+        deck_complete(entry, DECK_PREFIX_OPERATIONS, result, type);
+        return 1;
+    }
 
-            const uint64_t* vector_a = (const uint64_t*)(event->data + 8);
-            const uint64_t* vector_b = vector_a + count;
+    atomic_increment_u64(&operations_deck_context.stats.memo_misses);
+    return operations_deck_compute(entry, &key);
+}
 
-            uint64_t* result = (uint64_t*)kmalloc(count * sizeof(uint64_t));
-            vector_multiply(vector_a, vector_b, result, count);
+// Batch: пока считаем текущий entry, подтягиваем payload следующего
+static int operations_deck_process_batch(RoutingEntry** entries, int count) {
+    int succeeded = 0;
 
-            deck_complete(entry, DECK_PREFIX_OPERATIONS, result, RESULT_TYPE_KMALLOC);
-            kprintf("[OPERATIONS] Vector multiply: %lu elements\n", count);
-            return 1;
+    for (int i = 0; i < count; i++) {
+        if (i + 1 < count) {
+            __builtin_prefetch(entries[i + 1]->payload, 0, 3);
         }
+        if (operations_deck_process(entries[i])) {
+            succeeded++;
+        }
+    }
 
-        case EVENT_OP_VECTOR_SCALE: {
-            // Payload: [count:8][scalar:8][vector:...]
-            uint64_t count = *(uint64_t*)event->data;
-            uint64_t scalar = *(uint64_t*)(event->data + 8);
+    return succeeded;
+}
 
-            if (count * sizeof(uint64_t) + 16 > EVENT_DATA_SIZE) {
-                deck_error(entry, DECK_PREFIX_OPERATIONS, 11);
-                return 0;
-            }
+// ============================================================================
+// WORKER POOL (work-stealing)
+// ============================================================================
+//
+// Когда Operations вынесен на AP, каждый AP из размещения становится
+// worker'ом со своим Chase-Lev deque. Input DeckQueue - SPSC, поэтому
+// снимать с неё может только один worker за раз (intake lock, trylock):
+// он переносит batch в свой deque, остальные воруют с его top.
+// Entry живёт ровно в одном слоте одного deque - deck_complete()
+// для него вызывается ровно одним worker'ом.
+//
+// На BSP (Operations не закреплён) работает обычный deck_run_once().
+//
+// ============================================================================
 
-            const uint64_t* input = (const uint64_t*)(event->data + 16);
+#define OPERATIONS_MAX_WORKERS   16
+#define OPERATIONS_INTAKE_BATCH  16
+
+typedef struct {
+    WSDeque deque;
+    uint32_t index;
+    volatile uint64_t processed;
+    volatile uint64_t stolen;            // Забрано из чужих deques
+    volatile uint64_t intake;            // Снято с input queue
+} OperationsWorker;
+
+static OperationsWorker operations_workers[OPERATIONS_MAX_WORKERS];
+static volatile uint32_t operations_worker_count = 0;
+static spinlock_t operations_intake_lock;
+
+// Активные workers (для воров и статистики)
+uint32_t operations_deck_worker_count(void) {
+    uint32_t count = atomic_load_u32(&operations_worker_count);
+    return count < OPERATIONS_MAX_WORKERS ? count : OPERATIONS_MAX_WORKERS;
+}
 
-            uint64_t* result = (uint64_t*)kmalloc(count * sizeof(uint64_t));
-            vector_scale(input, scalar, result, count);
+// Перенести batch из input queue в свой deque. Возвращает количество
+static uint32_t operations_worker_intake(OperationsWorker* self) {
+    uint64_t space = WS_DEQUE_SIZE - ws_deque_size(&self->deque);
+    uint32_t max = space < OPERATIONS_INTAKE_BATCH ? (uint32_t)space : OPERATIONS_INTAKE_BATCH;
+    if (max == 0) {
+        return 0;
+    }
 
-            deck_complete(entry, DECK_PREFIX_OPERATIONS, result, RESULT_TYPE_KMALLOC);
-            kprintf("[OPERATIONS] Vector scale: %lu elements * %lu\n", count, scalar);
-            return 1;
+    // DEFENSIVE: второй consumer у SPSC очереди недопустим
+    if (!spin_trylock(&operations_intake_lock)) {
+        return 0;
+    }
+
+    RoutingEntry* batch[OPERATIONS_INTAKE_BATCH];
+    uint32_t count = deck_queue_pop_batch(operations_deck_context.input_queue, batch, max);
+
+    spin_unlock(&operations_intake_lock);
+
+    // В обратном порядке: владелец (LIFO) снимает entries в порядке прихода
+    for (uint32_t i = count; i > 0; i--) {
+        ws_deque_push(&self->deque, batch[i - 1]);
+    }
+
+    if (count > 0) {
+        atomic_add_u64(&self->intake, count);
+    }
+    return count;
+}
+
+static RoutingEntry* operations_worker_steal(OperationsWorker* self) {
+    uint32_t count = operations_deck_worker_count();
+
+    for (uint32_t i = 1; i < count; i++) {
+        OperationsWorker* victim = &operations_workers[(self->index + i) % count];
+        RoutingEntry* entry = (RoutingEntry*)ws_deque_steal(&victim->deque);
+        if (entry) {
+            atomic_increment_u64(&self->stolen);
+            return entry;
         }
+    }
+    return 0;
+}
 
-        default:
-            // PRODUCTION: Detailed error for unknown operations
-            kprintf("[OPERATIONS] ERROR: Unknown/unimplemented event type %d\n", event->type);
-            deck_error_detailed(entry, DECK_PREFIX_OPERATIONS, ERROR_NOT_IMPLEMENTED,
-                              "Operation type not implemented");
-            return 0;
+// Свой deque → input queue → чужие deques
+static RoutingEntry* operations_worker_next(OperationsWorker* self) {
+    RoutingEntry* entry = (RoutingEntry*)ws_deque_pop(&self->deque);
+    if (entry) {
+        return entry;
+    }
+
+    if (operations_worker_intake(self)) {
+        entry = (RoutingEntry*)ws_deque_pop(&self->deque);
+        if (entry) {
+            return entry;
+        }
     }
+
+    return operations_worker_steal(self);
 }
 
-// ============================================================================
-// INITIALIZATION & RUN
-// ============================================================================
+static void operations_worker_loop(OperationsWorker* self) {
+    kprintf("[OPERATIONS] Worker %u started\n", self->index);
 
-DeckContext operations_deck_context;
+    uint64_t iterations = 0;
+
+    while (1) {
+        RoutingEntry* entry = operations_worker_next(self);
+
+        if (entry) {
+            __builtin_prefetch(entry->payload, 0, 3);
+            deck_process_entry(&operations_deck_context, entry);
+            atomic_increment_u64(&self->processed);
+        } else {
+            cpu_pause();
+        }
+
+        iterations++;
+        if (iterations % 10000000 == 0) {
+            kprintf("[OPERATIONS] Worker %u: processed=%lu stolen=%lu intake=%lu\n",
+                    self->index, self->processed, self->stolen, self->intake);
+        }
+    }
+}
 
 void operations_deck_init(void) {
-    // Initialize CRC32 table
-    crc32_init_table();
+    // CRC32 tables + выбор PCLMULQDQ / SSE4.2 по CPUID
+    crc32_engine_init();
+    vector_engine_init();
+    cipher_engine_init();
+    operations_stream_init();
+    operations_memo_init();
 
     deck_init(&operations_deck_context, "Operations", DECK_PREFIX_OPERATIONS, operations_deck_process);
+    deck_set_batch_func(&operations_deck_context, operations_deck_process_batch, OPERATIONS_DECK_BATCH_SIZE);
+
+    spinlock_init(&operations_intake_lock);
+    for (uint32_t i = 0; i < OPERATIONS_MAX_WORKERS; i++) {
+        ws_deque_init(&operations_workers[i].deque);
+        operations_workers[i].index = i;
+    }
 
     kprintf("[OPERATIONS] Initialized with real algorithms:\n");
-    kprintf("[OPERATIONS]   - Hashing: CRC32, DJB2\n");
-    kprintf("[OPERATIONS]   - Compression: RLE\n");
-    kprintf("[OPERATIONS]   - Encryption: XOR\n");
+    kprintf("[OPERATIONS]   - Hashing: CRC32, CRC32C, DJB2\n");
+    crc32_engine_print_info();
+    kprintf("[OPERATIONS]   - Compression: RLE, LZ4 (block / frame)\n");
+    kprintf("[OPERATIONS]   - Encryption: XOR, AES-CTR/GCM, ChaCha20-Poly1305\n");
+    cipher_engine_print_info();
     kprintf("[OPERATIONS]   - Math: Vector operations\n");
+    kprintf("[OPERATIONS]   - Streams: CRC32, CRC32C, DJB2, LZ4 frame, ciphers (%d sessions)\n",
+            OPERATIONS_STREAM_MAX);
+    vector_engine_print_info();
 }
 
 int operations_deck_run_once(void) {
     return deck_run_once(&operations_deck_context);
 }
 
+// Каждый CPU, вызвавший эту функцию, становится worker'ом пула
 void operations_deck_run(void) {
-    deck_run(&operations_deck_context);
+    uint32_t index = atomic_increment_u32(&operations_worker_count) - 1;
+
+    // DEFENSIVE: сверх лимита CPU просто стоит (воры видят только первые слоты)
+    if (index >= OPERATIONS_MAX_WORKERS) {
+        kprintf("[OPERATIONS] %[W]Worker limit %d reached, CPU idle%[D]\n",
+                OPERATIONS_MAX_WORKERS);
+        while (1) {
+            cpu_pause();
+        }
+    }
+
+    operations_worker_loop(&operations_workers[index]);
 }
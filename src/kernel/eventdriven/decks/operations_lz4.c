@@ -0,0 +1,475 @@
+#include "operations_lz4.h"
+#include "pmm.h"
+#include "smp.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+#define LZ4_HASH_SIZE     (1 << LZ4_HASH_BITS)
+#define LZ4_CHAIN_SIZE    65536
+#define LZ4_CHAIN_MASK    (LZ4_CHAIN_SIZE - 1)
+
+// head[] хранит base + позицию: записи прошлых вызовов (< base) считаются
+// пустыми - таблицу не надо чистить перед каждым blockом
+typedef struct {
+    uint32_t base;
+    uint32_t head[LZ4_HASH_SIZE];
+    uint16_t chain[LZ4_CHAIN_SIZE];     // Дельта до предыдущей позиции с тем же hash
+} Lz4Workspace;
+
+#define LZ4_WORKSPACE_PAGES ((sizeof(Lz4Workspace) + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE)
+
+static Lz4Workspace* lz4_workspaces[SMP_MAX_CPUS];
+
+#define XXH_PRIME32_1  2654435761U
+#define XXH_PRIME32_2  2246822519U
+#define XXH_PRIME32_3  3266489917U
+#define XXH_PRIME32_4  668265263U
+#define XXH_PRIME32_5  374761393U
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static inline uint32_t lz4_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void lz4_write32(uint8_t* p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+static inline uint32_t lz4_rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+// Каждый CPU - свой workspace: workers Operations считают параллельно
+static Lz4Workspace* lz4_workspace(void) {
+    uint32_t cpu = smp_current_cpu();
+    if (!lz4_workspaces[cpu]) {
+        lz4_workspaces[cpu] = (Lz4Workspace*)pmm_alloc_zero(LZ4_WORKSPACE_PAGES);
+        if (lz4_workspaces[cpu]) {
+            lz4_workspaces[cpu]->base = 1;
+        }
+    }
+    return lz4_workspaces[cpu];
+}
+
+uint32_t lz4_xxh32(const uint8_t* data, uint64_t size, uint32_t seed) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint32_t h;
+
+    if (size >= 16) {
+        uint32_t v1 = seed + XXH_PRIME32_1 + XXH_PRIME32_2;
+        uint32_t v2 = seed + XXH_PRIME32_2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - XXH_PRIME32_1;
+
+        while (p + 16 <= end) {
+            v1 = lz4_rotl32(v1 + lz4_read32(p) * XXH_PRIME32_2, 13) * XXH_PRIME32_1;
+            v2 = lz4_rotl32(v2 + lz4_read32(p + 4) * XXH_PRIME32_2, 13) * XXH_PRIME32_1;
+            v3 = lz4_rotl32(v3 + lz4_read32(p + 8) * XXH_PRIME32_2, 13) * XXH_PRIME32_1;
+            v4 = lz4_rotl32(v4 + lz4_read32(p + 12) * XXH_PRIME32_2, 13) * XXH_PRIME32_1;
+            p += 16;
+        }
+        h = lz4_rotl32(v1, 1) + lz4_rotl32(v2, 7) + lz4_rotl32(v3, 12) + lz4_rotl32(v4, 18);
+    } else {
+        h = seed + XXH_PRIME32_5;
+    }
+
+    h += (uint32_t)size;
+
+    while (p + 4 <= end) {
+        h = lz4_rotl32(h + lz4_read32(p) * XXH_PRIME32_3, 17) * XXH_PRIME32_4;
+        p += 4;
+    }
+    while (p < end) {
+        h = lz4_rotl32(h + (*p++) * XXH_PRIME32_5, 11) * XXH_PRIME32_1;
+    }
+
+    h ^= h >> 15;
+    h *= XXH_PRIME32_2;
+    h ^= h >> 13;
+    h *= XXH_PRIME32_3;
+    h ^= h >> 16;
+    return h;
+}
+
+// ============================================================================
+// BLOCK COMPRESSION
+// ============================================================================
+
+static inline uint8_t* lz4_write_length(uint8_t* op, uint64_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+// Один sequence: literals [anchor, anchor + literals) + match (match_length >= 4,
+// match_length = 0 - последний sequence без match)
+static uint8_t* lz4_emit_sequence(uint8_t* op, uint8_t* oend, const uint8_t* anchor,
+                                  uint64_t literals, uint32_t offset, uint64_t match_length) {
+    uint64_t extra = match_length ? 2 + (match_length - LZ4_MIN_MATCH) / 255 + 1 : 0;
+    uint64_t need = 1 + literals / 255 + 1 + literals + extra;
+    if ((uint64_t)(oend - op) < need) {
+        return 0;
+    }
+
+    uint8_t* token = op++;
+    *token = (uint8_t)((literals >= 15 ? 15 : literals) << 4);
+    if (literals >= 15) {
+        op = lz4_write_length(op, literals - 15);
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+
+    if (match_length) {
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+
+        uint64_t ml = match_length - LZ4_MIN_MATCH;
+        *token |= (uint8_t)(ml >= 15 ? 15 : ml);
+        if (ml >= 15) {
+            op = lz4_write_length(op, ml - 15);
+        }
+    }
+    return op;
+}
+
+static inline void lz4_insert(Lz4Workspace* ws, const uint8_t* src, uint64_t pos) {
+    uint32_t h = lz4_hash(lz4_read32(src + pos));
+    uint32_t prev = ws->head[h];
+    uint64_t delta = prev >= ws->base ? pos - (prev - ws->base) : 0;
+
+    ws->chain[pos & LZ4_CHAIN_MASK] = delta <= LZ4_MAX_OFFSET ? (uint16_t)delta : 0;
+    ws->head[h] = ws->base + (uint32_t)pos;
+}
+
+uint64_t lz4_compress_block(const uint8_t* src, uint64_t size, uint8_t* dst, uint64_t capacity) {
+    // uint32 позиции в head[] - block ограничен (frame режет по 64KB)
+    if (size > 0x7FFFFFFF || capacity == 0) {
+        return 0;
+    }
+
+    Lz4Workspace* ws = lz4_workspace();
+    if (!ws) {
+        return 0;
+    }
+
+    // Переполнение base - одна полная очистка
+    if (ws->base > 0xFFFFFFFFU - (uint32_t)size - 1) {
+        memset(ws->head, 0, sizeof(ws->head));
+        ws->base = 1;
+    }
+
+    uint8_t* op = dst;
+    uint8_t* oend = dst + capacity;
+    uint64_t anchor = 0;
+    uint64_t ip = 0;
+
+    if (size >= LZ4_MFLIMIT + 1) {
+        uint64_t match_limit = size - LZ4_LAST_LITERALS;
+        uint64_t start_limit = size - LZ4_MFLIMIT;
+
+        while (ip <= start_limit) {
+            uint32_t sequence = lz4_read32(src + ip);
+            uint32_t candidate = ws->head[lz4_hash(sequence)];
+            lz4_insert(ws, src, ip);
+
+            // Hash chain: лучший match среди LZ4_CHAIN_DEPTH кандидатов
+            uint64_t best_length = 0;
+            uint64_t best_pos = 0;
+            uint32_t depth = LZ4_CHAIN_DEPTH;
+
+            while (candidate >= ws->base && depth-- > 0) {
+                uint64_t cp = candidate - ws->base;
+                if (cp >= ip || ip - cp > LZ4_MAX_OFFSET) {
+                    break;
+                }
+
+                if (lz4_read32(src + cp) == sequence) {
+                    uint64_t length = LZ4_MIN_MATCH;
+                    while (ip + length < match_limit && src[cp + length] == src[ip + length]) {
+                        length++;
+                    }
+                    if (length > best_length) {
+                        best_length = length;
+                        best_pos = cp;
+                    }
+                }
+
+                uint16_t delta = ws->chain[cp & LZ4_CHAIN_MASK];
+                if (delta == 0 || delta > cp) {
+                    break;
+                }
+                candidate -= delta;
+            }
+
+            if (best_length < LZ4_MIN_MATCH) {
+                ip++;
+                continue;
+            }
+
+            op = lz4_emit_sequence(op, oend, src + anchor, ip - anchor,
+                                   (uint32_t)(ip - best_pos), best_length);
+            if (!op) {
+                return 0;
+            }
+
+            // Позиции внутри match тоже в chain - следующие match'и длиннее
+            uint64_t match_end = ip + best_length;
+            for (uint64_t p = ip + 1; p < match_end && p <= start_limit; p++) {
+                lz4_insert(ws, src, p);
+            }
+
+            ip = match_end;
+            anchor = ip;
+        }
+    }
+
+    ws->base += (uint32_t)size + 1;
+
+    op = lz4_emit_sequence(op, oend, src + anchor, size - anchor, 0, 0);
+    return op ? (uint64_t)(op - dst) : 0;
+}
+
+// ============================================================================
+// BLOCK DECOMPRESSION
+// ============================================================================
+
+static inline int lz4_read_length(const uint8_t* src, uint64_t size, uint64_t* ip, uint64_t* length) {
+    uint8_t b;
+    do {
+        if (*ip >= size) {
+            return 0;
+        }
+        b = src[(*ip)++];
+        *length += b;
+    } while (b == 255);
+    return 1;
+}
+
+// Пишет с позиции out_pos; match может ссылаться на всё out[0, out_pos) -
+// так декодируются зависимые блоки frame. Возвращает новую позицию или -1
+static int64_t lz4_decode(const uint8_t* src, uint64_t size,
+                          uint8_t* out, uint64_t out_pos, uint64_t capacity) {
+    uint64_t ip = 0;
+    uint64_t op = out_pos;
+
+    while (ip < size) {
+        uint8_t token = src[ip++];
+
+        uint64_t literals = token >> 4;
+        if (literals == 15 && !lz4_read_length(src, size, &ip, &literals)) {
+            return -1;
+        }
+        if (literals > size - ip || literals > capacity - op) {
+            return -1;
+        }
+        memcpy(out + op, src + ip, literals);
+        ip += literals;
+        op += literals;
+
+        // Последний sequence - только literals
+        if (ip == size) {
+            return (int64_t)op;
+        }
+
+        if (size - ip < 2) {
+            return -1;
+        }
+        uint64_t offset = src[ip] | ((uint64_t)src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return -1;
+        }
+
+        uint64_t match_length = token & 15;
+        if (match_length == 15 && !lz4_read_length(src, size, &ip, &match_length)) {
+            return -1;
+        }
+        match_length += LZ4_MIN_MATCH;
+        if (match_length > capacity - op) {
+            return -1;
+        }
+
+        // Не перекрывающиеся куски - по 8 байт, перекрытие (offset < 8) - по байту
+        uint8_t* dst = out + op;
+        const uint8_t* match = dst - offset;
+        uint64_t remaining = match_length;
+        if (offset >= 8) {
+            while (remaining >= 8) {
+                memcpy(dst, match, 8);
+                dst += 8;
+                match += 8;
+                remaining -= 8;
+            }
+        }
+        while (remaining-- > 0) {
+            *dst++ = *match++;
+        }
+        op += match_length;
+    }
+
+    // Пустой вход - не block (block содержит хотя бы token)
+    return -1;
+}
+
+int64_t lz4_decompress_block(const uint8_t* src, uint64_t size, uint8_t* dst, uint64_t capacity) {
+    return lz4_decode(src, size, dst, 0, capacity);
+}
+
+// ============================================================================
+// FRAME
+// ============================================================================
+
+#define LZ4_FLG_VERSION          0x40
+#define LZ4_FLG_BLOCK_INDEP      0x20
+#define LZ4_FLG_BLOCK_CHECKSUM   0x10
+#define LZ4_FLG_CONTENT_SIZE     0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_DICT_ID          0x01
+#define LZ4_BD_64KB              0x40
+#define LZ4_BLOCK_UNCOMPRESSED   0x80000000U
+
+uint64_t lz4_frame_compress(const uint8_t* src, uint64_t size, uint8_t* dst, uint64_t capacity,
+                            uint32_t flags) {
+    uint64_t op = 0;
+
+    if (flags & LZ4_FRAME_BEGIN) {
+        if (capacity < 7) {
+            return 0;
+        }
+        lz4_write32(dst, LZ4_FRAME_MAGIC);
+        dst[4] = LZ4_FLG_VERSION | LZ4_FLG_BLOCK_INDEP;
+        dst[5] = LZ4_BD_64KB;
+        dst[6] = (uint8_t)(lz4_xxh32(dst + 4, 2, 0) >> 8);
+        op = 7;
+    }
+
+    for (uint64_t pos = 0; pos < size; pos += LZ4_FRAME_BLOCK_SIZE) {
+        uint64_t chunk = size - pos < LZ4_FRAME_BLOCK_SIZE ? size - pos : LZ4_FRAME_BLOCK_SIZE;
+        if (capacity - op < 4) {
+            return 0;
+        }
+
+        // Сжатый block только если он меньше исходного - иначе raw
+        uint64_t room = capacity - op - 4;
+        uint64_t compressed = lz4_compress_block(src + pos, chunk, dst + op + 4,
+                                                 room < chunk ? room : chunk - 1);
+        if (compressed > 0 && compressed < chunk) {
+            lz4_write32(dst + op, (uint32_t)compressed);
+            op += 4 + compressed;
+        } else {
+            if (room < chunk) {
+                return 0;
+            }
+            lz4_write32(dst + op, (uint32_t)chunk | LZ4_BLOCK_UNCOMPRESSED);
+            memcpy(dst + op + 4, src + pos, chunk);
+            op += 4 + chunk;
+        }
+    }
+
+    if (flags & LZ4_FRAME_END) {
+        if (capacity - op < 4) {
+            return 0;
+        }
+        lz4_write32(dst + op, 0);
+        op += 4;
+    }
+
+    return op;
+}
+
+int64_t lz4_frame_decompress(const uint8_t* src, uint64_t size, uint8_t* dst, uint64_t capacity) {
+    uint64_t ip = 0;
+    uint64_t op = 0;
+    uint8_t flg = LZ4_FLG_VERSION | LZ4_FLG_BLOCK_INDEP;   // Продолжение: наш формат
+    int has_header = 0;
+
+    if (size >= 4 && lz4_read32(src) == LZ4_FRAME_MAGIC) {
+        if (size < 7) {
+            return -1;
+        }
+        flg = src[4];
+        uint64_t descriptor = 2 + ((flg & LZ4_FLG_CONTENT_SIZE) ? 8 : 0) +
+                              ((flg & LZ4_FLG_DICT_ID) ? 4 : 0);
+
+        // Версия 01, reserved bits = 0; внешние словари не поддерживаем
+        if ((flg & 0xC0) != LZ4_FLG_VERSION || (flg & 0x02) || (flg & LZ4_FLG_DICT_ID) ||
+            size < 4 + descriptor + 1) {
+            return -1;
+        }
+        if (src[4 + descriptor] != (uint8_t)(lz4_xxh32(src + 4, descriptor, 0) >> 8)) {
+            return -1;
+        }
+        ip = 4 + descriptor + 1;
+        has_header = 1;
+    }
+
+    while (ip < size) {
+        if (size - ip < 4) {
+            return -1;
+        }
+        uint32_t block = lz4_read32(src + ip);
+        ip += 4;
+
+        // End mark (+ content checksum)
+        if (block == 0) {
+            if (flg & LZ4_FLG_CONTENT_CHECKSUM) {
+                if (size - ip < 4) {
+                    return -1;
+                }
+                // Checksum покрывает весь frame - проверяем, только если он весь здесь
+                if (has_header && lz4_read32(src + ip) != lz4_xxh32(dst, op, 0)) {
+                    return -1;
+                }
+                ip += 4;
+            }
+            return (int64_t)op;
+        }
+
+        uint64_t block_size = block & ~LZ4_BLOCK_UNCOMPRESSED;
+        if (block_size > size - ip) {
+            return -1;
+        }
+
+        if ((flg & LZ4_FLG_BLOCK_CHECKSUM) &&
+            (size - ip - block_size < 4 ||
+             lz4_read32(src + ip + block_size) != lz4_xxh32(src + ip, block_size, 0))) {
+            return -1;
+        }
+
+        if (block & LZ4_BLOCK_UNCOMPRESSED) {
+            if (block_size > capacity - op) {
+                return -1;
+            }
+            memcpy(dst + op, src + ip, block_size);
+            op += block_size;
+        } else {
+            // Зависимые блоки - match может уйти в предыдущий вывод
+            int64_t next = lz4_decode(src + ip, block_size, dst, op, capacity);
+            if (next < 0) {
+                return -1;
+            }
+            op = (uint64_t)next;
+        }
+
+        ip += block_size + ((flg & LZ4_FLG_BLOCK_CHECKSUM) ? 4 : 0);
+    }
+
+    // Без end mark - фрагмент потока, следующие блоки придут другим событием
+    return (int64_t)op;
+}
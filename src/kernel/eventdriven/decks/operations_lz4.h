@@ -0,0 +1,66 @@
+#ifndef OPERATIONS_LZ4_H
+#define OPERATIONS_LZ4_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// LZ4 CODEC - LZ4-совместимый block и frame формат для Operations deck
+// ============================================================================
+//
+// Block:  стандартный LZ4 block (token / literals / offset / match length),
+//         match finder - hash chain (head по 4-байтному hash + chain дельт
+//         в окне 64KB, глубина LZ4_CHAIN_DEPTH). Decoder проверяет все
+//         границы - вход из user памяти.
+//
+// Frame:  LZ4 frame (magic 0x184D2204), независимые блоки по 64KB - поток
+//         режется на события без состояния между ними:
+//
+//           событие 1: LZ4_FRAME_BEGIN          → header + блоки
+//           событие k: 0                        → блоки
+//           событие n: LZ4_FRAME_END            → блоки + end mark
+//
+//         Decoder принимает frame целиком (в т.ч. от lz4 CLI: зависимые
+//         блоки, block/content checksum) или продолжение - последовательность
+//         блоков без header'а (формат нашего encoder'а).
+//
+// Рабочая память match finder'а - per-CPU, из pmm при первом вызове.
+//
+// ============================================================================
+
+#define LZ4_MIN_MATCH        4
+#define LZ4_LAST_LITERALS    5      // Последние 5 байт - всегда literals
+#define LZ4_MFLIMIT          12     // Match не начинается ближе 12 байт к концу
+#define LZ4_MAX_OFFSET       65535
+#define LZ4_HASH_BITS        12
+#define LZ4_CHAIN_DEPTH      16
+
+#define LZ4_FRAME_MAGIC      0x184D2204
+#define LZ4_FRAME_BLOCK_SIZE (64 * 1024)
+
+// Frame flags (payload compress frame)
+#define LZ4_FRAME_BEGIN      0x01   // Писать frame header
+#define LZ4_FRAME_END        0x02   // Писать end mark
+
+// Худший случай block (несжимаемые данные)
+#define LZ4_COMPRESS_BOUND(n)      ((n) + (n) / 255 + 16)
+
+// Худший случай frame: header + end mark + блоки (raw) с заголовками
+#define LZ4_FRAME_BOUND(n)         (7 + 4 + (n) + 4 * ((n) / LZ4_FRAME_BLOCK_SIZE + 1))
+
+// Возвращает размер сжатого block, 0 = не влезло в capacity / нет памяти
+uint64_t lz4_compress_block(const uint8_t* src, uint64_t size, uint8_t* dst, uint64_t capacity);
+
+// Возвращает размер результата, -1 = повреждённые данные / мало capacity
+int64_t lz4_decompress_block(const uint8_t* src, uint64_t size, uint8_t* dst, uint64_t capacity);
+
+// Возвращает размер frame-фрагмента, 0 = не влезло
+uint64_t lz4_frame_compress(const uint8_t* src, uint64_t size, uint8_t* dst, uint64_t capacity,
+                            uint32_t flags);
+
+// Возвращает размер результата, -1 = ошибка формата / checksum / capacity
+int64_t lz4_frame_decompress(const uint8_t* src, uint64_t size, uint8_t* dst, uint64_t capacity);
+
+// xxHash32 (frame header / checksums)
+uint32_t lz4_xxh32(const uint8_t* data, uint64_t size, uint32_t seed);
+
+#endif // OPERATIONS_LZ4_H
@@ -0,0 +1,308 @@
+#include "operations_memo.h"
+#include "atomics.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+typedef struct OperationsMemoEntry {
+    OperationsMemoKey key;
+    ResultType type;
+    uint64_t size;                          // Байт результата
+    uint64_t cost;                          // Вклад в бюджет
+    ResultBuffer* buffer;                   // RESULT_TYPE_BUFFER: ссылка cache
+    struct OperationsMemoEntry* hash_next;
+    struct OperationsMemoEntry* lru_prev;   // К голове (свежие)
+    struct OperationsMemoEntry* lru_next;   // К хвосту (кандидаты на вытеснение)
+    uint8_t data[] __attribute__((aligned(16)));  // RESULT_TYPE_KMALLOC: копия
+} OperationsMemoEntry;
+
+static OperationsMemoEntry* memo_buckets[OPERATIONS_MEMO_BUCKETS];
+static OperationsMemoEntry* memo_lru_head = 0;
+static OperationsMemoEntry* memo_lru_tail = 0;
+static uint64_t memo_bytes = 0;
+static uint64_t memo_entries = 0;
+static spinlock_t memo_lock;
+static OperationsMemoStats memo_stats;
+
+#define MEMO_FNV_OFFSET  0xCBF29CE484222325ULL
+#define MEMO_FNV_PRIME   0x00000100000001B3ULL
+#define MEMO_MIX_MULT    0x9E3779B97F4A7C15ULL
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void operations_memo_init(void) {
+    spinlock_init(&memo_lock);
+    memset(memo_buckets, 0, sizeof(memo_buckets));
+    memo_lru_head = 0;
+    memo_lru_tail = 0;
+    memo_bytes = 0;
+    memo_entries = 0;
+
+    kprintf("[MEMO] Initialized (%d buckets, budget %lu KB)\n",
+            OPERATIONS_MEMO_BUCKETS, (uint64_t)OPERATIONS_MEMO_BUDGET / 1024);
+}
+
+// ============================================================================
+// KEY
+// ============================================================================
+
+// Два hash в одном проходе: FNV-1a и multiply-xorshift - разные структуры,
+// совпадение обоих для разных входов практически исключено
+static void memo_hash_bytes(const uint8_t* data, uint64_t size, uint64_t* h1, uint64_t* h2) {
+    uint64_t a = *h1;
+    uint64_t b = *h2;
+
+    for (uint64_t i = 0; i < size; i++) {
+        a = (a ^ data[i]) * MEMO_FNV_PRIME;
+        b = (b + data[i] + 1) * MEMO_MIX_MULT;
+        b ^= b >> 29;
+    }
+
+    *h1 = a;
+    *h2 = b;
+}
+
+static void memo_hash_u64(uint64_t value, uint64_t* h1, uint64_t* h2) {
+    memo_hash_bytes((const uint8_t*)&value, sizeof(value), h1, h2);
+}
+
+void operations_memo_key(RoutingEntry* entry, OperationsMemoKey* key) {
+    uint64_t h1 = MEMO_FNV_OFFSET;
+    uint64_t h2 = MEMO_MIX_MULT;
+    uint32_t buffer_length = entry->buffer ? entry->buffer_length : 0;
+
+    // CRITICAL: namespace процесса (его registered buffers, FD) - только свой PID
+    key->namespace_pid = entry->owner ? entry->owner_pid : 0;
+    key->type = entry->event_copy.type;
+    key->input_size = entry->payload_size + buffer_length;
+
+    memo_hash_u64(key->namespace_pid, &h1, &h2);
+    memo_hash_u64(key->type, &h1, &h2);
+
+    // Длины отдельно: граница payload/buffer - часть ключа
+    memo_hash_u64(entry->payload_size, &h1, &h2);
+    memo_hash_bytes(entry->payload, entry->payload_size, &h1, &h2);
+    memo_hash_u64(buffer_length, &h1, &h2);
+    if (buffer_length > 0) {
+        memo_hash_bytes(entry->buffer, buffer_length, &h1, &h2);
+    }
+
+    key->hash = h1;
+    key->check = h2;
+}
+
+static int memo_key_equal(const OperationsMemoKey* a, const OperationsMemoKey* b) {
+    return a->hash == b->hash && a->check == b->check &&
+           a->namespace_pid == b->namespace_pid &&
+           a->type == b->type && a->input_size == b->input_size;
+}
+
+// ============================================================================
+// LRU (под memo_lock)
+// ============================================================================
+
+static void memo_lru_unlink(OperationsMemoEntry* e) {
+    if (e->lru_prev) {
+        e->lru_prev->lru_next = e->lru_next;
+    } else {
+        memo_lru_head = e->lru_next;
+    }
+    if (e->lru_next) {
+        e->lru_next->lru_prev = e->lru_prev;
+    } else {
+        memo_lru_tail = e->lru_prev;
+    }
+    e->lru_prev = 0;
+    e->lru_next = 0;
+}
+
+static void memo_lru_push_head(OperationsMemoEntry* e) {
+    e->lru_prev = 0;
+    e->lru_next = memo_lru_head;
+    if (memo_lru_head) {
+        memo_lru_head->lru_prev = e;
+    } else {
+        memo_lru_tail = e;
+    }
+    memo_lru_head = e;
+}
+
+static OperationsMemoEntry* memo_find(const OperationsMemoKey* key) {
+    OperationsMemoEntry* e = memo_buckets[key->hash & (OPERATIONS_MEMO_BUCKETS - 1)];
+    while (e && !memo_key_equal(&e->key, key)) {
+        e = e->hash_next;
+    }
+    return e;
+}
+
+// Снимает запись из bucket и LRU; освобождение - caller, вне lock
+static void memo_remove(OperationsMemoEntry* e) {
+    OperationsMemoEntry** link = &memo_buckets[e->key.hash & (OPERATIONS_MEMO_BUCKETS - 1)];
+    while (*link && *link != e) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = e->hash_next;
+    }
+
+    memo_lru_unlink(e);
+    memo_bytes -= e->cost;
+    memo_entries--;
+}
+
+static void memo_entry_free(OperationsMemoEntry* e) {
+    if (e->type == RESULT_TYPE_BUFFER) {
+        result_buffer_release(e->buffer);
+    }
+    kfree(e);
+}
+
+// ============================================================================
+// LOOKUP / STORE
+// ============================================================================
+
+int operations_memo_lookup(const OperationsMemoKey* key, void** result, ResultType* type) {
+    spin_lock(&memo_lock);
+
+    OperationsMemoEntry* e = memo_find(key);
+    if (!e) {
+        spin_unlock(&memo_lock);
+        return 0;
+    }
+
+    memo_lru_unlink(e);
+    memo_lru_push_head(e);
+
+    // BUFFER: данные неизменяемы - отдаём ссылку (retain под lock, чтобы
+    // вытеснение на другом CPU не освободило буфер раньше)
+    if (e->type == RESULT_TYPE_BUFFER) {
+        result_buffer_retain(e->buffer);
+        *result = e->buffer;
+        *type = RESULT_TYPE_BUFFER;
+        spin_unlock(&memo_lock);
+        return 1;
+    }
+
+    // KMALLOC: каждый consumer освобождает свой результат - нужна копия.
+    // kmalloc под lock: запись не должна исчезнуть во время memcpy
+    void* copy = kmalloc(e->size);
+    if (copy) {
+        memcpy(copy, e->data, e->size);
+    }
+    spin_unlock(&memo_lock);
+
+    // Нет памяти - считаем как miss, вычисление само сообщит об ошибке
+    if (!copy) {
+        return 0;
+    }
+
+    *result = copy;
+    *type = RESULT_TYPE_KMALLOC;
+    return 1;
+}
+
+void operations_memo_store(const OperationsMemoKey* key, void* result,
+                           ResultType type, uint64_t size) {
+    if (!result || (type != RESULT_TYPE_KMALLOC && type != RESULT_TYPE_BUFFER)) {
+        return;
+    }
+
+    uint64_t payload_bytes = type == RESULT_TYPE_KMALLOC ? size : 0;
+    uint64_t cost = sizeof(OperationsMemoEntry) + size;
+
+    // Одна запись не вытесняет весь cache
+    if (cost > OPERATIONS_MEMO_BUDGET / 4) {
+        atomic_increment_u64(&memo_stats.rejected);
+        return;
+    }
+
+    OperationsMemoEntry* e = (OperationsMemoEntry*)kmalloc(sizeof(OperationsMemoEntry) + payload_bytes);
+    if (!e) {
+        return;
+    }
+
+    e->key = *key;
+    e->type = type;
+    e->size = size;
+    e->cost = cost;
+    e->buffer = 0;
+    e->lru_prev = 0;
+    e->lru_next = 0;
+
+    if (type == RESULT_TYPE_BUFFER) {
+        e->buffer = (ResultBuffer*)result;
+        result_buffer_retain(e->buffer);
+    } else {
+        memcpy(e->data, result, size);
+    }
+
+    OperationsMemoEntry* evicted = 0;
+
+    spin_lock(&memo_lock);
+
+    // Два worker'а посчитали один ключ одновременно - первый store остаётся
+    if (memo_find(key)) {
+        spin_unlock(&memo_lock);
+        memo_entry_free(e);
+        return;
+    }
+
+    while (memo_lru_tail && memo_bytes + cost > OPERATIONS_MEMO_BUDGET) {
+        OperationsMemoEntry* victim = memo_lru_tail;
+        memo_remove(victim);
+        victim->hash_next = evicted;
+        evicted = victim;
+        atomic_increment_u64(&memo_stats.evictions);
+    }
+
+    uint32_t bucket = key->hash & (OPERATIONS_MEMO_BUCKETS - 1);
+    e->hash_next = memo_buckets[bucket];
+    memo_buckets[bucket] = e;
+    memo_lru_push_head(e);
+    memo_bytes += cost;
+    memo_entries++;
+
+    spin_unlock(&memo_lock);
+
+    atomic_increment_u64(&memo_stats.stores);
+
+    while (evicted) {
+        OperationsMemoEntry* next = evicted->hash_next;
+        memo_entry_free(evicted);
+        evicted = next;
+    }
+}
+
+void operations_memo_flush(void) {
+    spin_lock(&memo_lock);
+    OperationsMemoEntry* all = memo_lru_head;
+    memset(memo_buckets, 0, sizeof(memo_buckets));
+    memo_lru_head = 0;
+    memo_lru_tail = 0;
+    memo_bytes = 0;
+    memo_entries = 0;
+    spin_unlock(&memo_lock);
+
+    while (all) {
+        OperationsMemoEntry* next = all->lru_next;
+        memo_entry_free(all);
+        all = next;
+    }
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+void operations_memo_print_stats(void) {
+    kprintf("\n%[H]=== Operations Memo ===%[D]\n");
+    kprintf("  entries=%lu bytes=%lu/%lu stores=%lu evictions=%lu rejected=%lu\n",
+            memo_entries, memo_bytes, (uint64_t)OPERATIONS_MEMO_BUDGET,
+            atomic_load_u64(&memo_stats.stores),
+            atomic_load_u64(&memo_stats.evictions),
+            atomic_load_u64(&memo_stats.rejected));
+}
@@ -0,0 +1,67 @@
+#ifndef OPERATIONS_MEMO_H
+#define OPERATIONS_MEMO_H
+
+#include "deck_interface.h"
+
+// ============================================================================
+// OPERATIONS MEMO - Content-addressed cache результатов чистых operations
+// ============================================================================
+//
+// CRC32 / DJB2 / RLE / vector ops - чистые функции входа: одинаковые
+// (type, payload, buffer) всегда дают одинаковый результат. Workflow,
+// который каждую активацию хеширует один и тот же файл, платит за
+// вычисление один раз:
+//
+//   EVENT_FLAG_MEMOIZE (opt-in) → ключ = (namespace, type, 2 x hash входа)
+//   hit  → копия (KMALLOC) или retain (BUFFER) → deck_complete() сразу
+//   miss → вычисление → store (копия / retain) → LRU голова
+//
+// Namespace: payload и registered buffer лежат в памяти процесса и могут
+// меняться во время вычисления - результат такого события виден только
+// тому же PID. Kernel-side события (workflow, input_result) - namespace 0.
+//
+// Бюджет в байтах (entry + результат), вытеснение с LRU хвоста.
+//
+// ============================================================================
+
+#ifndef OPERATIONS_MEMO_BUDGET
+#define OPERATIONS_MEMO_BUDGET   (256 * 1024)
+#endif
+
+#define OPERATIONS_MEMO_BUCKETS  256
+
+typedef struct {
+    uint64_t hash;              // FNV-1a по входу
+    uint64_t check;             // Второй независимый hash (ложный hit ~2^-128)
+    uint64_t namespace_pid;
+    uint32_t type;
+    uint32_t input_size;        // payload_size + buffer_length
+} OperationsMemoKey;
+
+// Hit rate - в DeckStats Operations deck (memo_hits / memo_misses)
+typedef struct {
+    volatile uint64_t stores;
+    volatile uint64_t evictions;
+    volatile uint64_t rejected;     // Результат больше budget/4
+} OperationsMemoStats;
+
+void operations_memo_init(void);
+
+// Ключ по входу entry (payload + buffer)
+void operations_memo_key(RoutingEntry* entry, OperationsMemoKey* key);
+
+// Hit: *result - собственный результат caller'а (kmalloc копия или retain
+// ResultBuffer), отдаётся в deck_complete(). Возвращает 1 = hit, 0 = miss
+int operations_memo_lookup(const OperationsMemoKey* key, void** result, ResultType* type);
+
+// Запоминает результат (KMALLOC копируется, BUFFER retain). result
+// остаётся у caller'а. Повторный store того же ключа игнорируется
+void operations_memo_store(const OperationsMemoKey* key, void* result,
+                           ResultType type, uint64_t size);
+
+// Освобождает все записи (BUFFER - release)
+void operations_memo_flush(void);
+
+void operations_memo_print_stats(void);
+
+#endif // OPERATIONS_MEMO_H
@@ -0,0 +1,217 @@
+#include "operations_stream.h"
+#include "atomics.h"
+#include "errors.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+#define STREAM_SLOT_BITS   8
+#define STREAM_SLOT(id)    ((uint32_t)((id) & ((1 << STREAM_SLOT_BITS) - 1)))
+
+_Static_assert(OPERATIONS_STREAM_MAX <= (1 << STREAM_SLOT_BITS), "Stream slot must fit in id");
+
+static OperationsStream* stream_slots[OPERATIONS_STREAM_MAX];
+static uint64_t stream_generation = 0;     // Старые id после close не находят новый слот
+static uint32_t stream_open_count = 0;
+static spinlock_t stream_lock;
+
+static struct {
+    volatile uint64_t opened;
+    volatile uint64_t closed;
+    volatile uint64_t rejected;     // Чужой / неизвестный id, seq не тот, занята
+    volatile uint64_t released;     // Закрыты при выходе процесса
+    volatile uint64_t limited;      // OPEN сверх OPERATIONS_STREAM_PER_OWNER
+} stream_stats;
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void operations_stream_init(void) {
+    spinlock_init(&stream_lock);
+    memset(stream_slots, 0, sizeof(stream_slots));
+    stream_generation = 0;
+    stream_open_count = 0;
+}
+
+// ============================================================================
+// SESSIONS
+// ============================================================================
+
+static void stream_free(OperationsStream* stream) {
+    if (stream->cipher) {
+        cipher_stream_wipe(stream->cipher);
+        kfree(stream->cipher);
+    }
+    kfree(stream);
+}
+
+uint64_t operations_stream_open(uint64_t owner_pid, uint32_t kind,
+                                const uint8_t* cipher_params, uint64_t params_size) {
+    if (kind < STREAM_KIND_CRC32 || kind > STREAM_KIND_DECRYPT) {
+        return 0;
+    }
+
+    OperationsStream* stream = (OperationsStream*)kmalloc(sizeof(OperationsStream));
+    if (!stream) {
+        return 0;
+    }
+    memset(stream, 0, sizeof(OperationsStream));
+    stream->owner_pid = owner_pid;
+    stream->kind = kind;
+    if (kind == STREAM_KIND_DJB2) {
+        stream->state.djb2 = 5381;  // Seed djb2_hash (operations_deck.c)
+    }
+
+    if (kind == STREAM_KIND_ENCRYPT || kind == STREAM_KIND_DECRYPT) {
+        // DEFENSIVE: aad_size из user памяти
+        uint32_t aad_size = *(const uint32_t*)(cipher_params + 4);
+        if (params_size < 56 || aad_size > params_size - 56) {
+            kfree(stream);
+            return 0;
+        }
+
+        stream->cipher = (CipherStream*)kmalloc(sizeof(CipherStream));
+        if (!stream->cipher ||
+            !cipher_stream_init(stream->cipher, cipher_params[0], cipher_params + 24,
+                                cipher_params[1], cipher_params + 8, cipher_params + 56,
+                                aad_size, kind == STREAM_KIND_ENCRYPT)) {
+            if (stream->cipher) {
+                kfree(stream->cipher);
+            }
+            kfree(stream);
+            return 0;
+        }
+    }
+
+    spin_lock(&stream_lock);
+    uint32_t slot = OPERATIONS_STREAM_MAX;
+    uint32_t owned = 0;
+    for (uint32_t i = 0; i < OPERATIONS_STREAM_MAX; i++) {
+        if (!stream_slots[i]) {
+            if (slot == OPERATIONS_STREAM_MAX) {
+                slot = i;
+            }
+        } else if (stream_slots[i]->owner_pid == owner_pid) {
+            owned++;
+        }
+    }
+
+    // Пул общий: без лимита один процесс открыл бы все sessions
+    if (owner_pid && owned >= OPERATIONS_STREAM_PER_OWNER) {
+        spin_unlock(&stream_lock);
+        stream_free(stream);
+        atomic_increment_u64(&stream_stats.limited);
+        kprintf("[STREAM] %[W]PID=%lu: session limit (%d) reached%[D]\n",
+                owner_pid, OPERATIONS_STREAM_PER_OWNER);
+        return 0;
+    }
+
+    if (slot == OPERATIONS_STREAM_MAX) {
+        spin_unlock(&stream_lock);
+        stream_free(stream);
+        kprintf("[STREAM] %[W]No free session slots (%d open)%[D]\n", OPERATIONS_STREAM_MAX);
+        return 0;
+    }
+
+    stream->id = (++stream_generation << STREAM_SLOT_BITS) | slot;
+    stream_slots[slot] = stream;
+    stream_open_count++;
+    spin_unlock(&stream_lock);
+
+    atomic_increment_u64(&stream_stats.opened);
+    return stream->id;
+}
+
+OperationsStream* operations_stream_get(uint64_t id, uint64_t owner_pid, uint64_t seq,
+                                        uint32_t* error_code) {
+    uint32_t slot = STREAM_SLOT(id);
+
+    spin_lock(&stream_lock);
+    OperationsStream* stream = slot < OPERATIONS_STREAM_MAX ? stream_slots[slot] : 0;
+
+    if (!stream || stream->id != id || stream->owner_pid != owner_pid || stream->dead) {
+        *error_code = ERROR_INVALID_PARAMETER;
+        stream = 0;
+    } else if (stream->busy) {
+        *error_code = ERROR_RESOURCE_BUSY;
+        stream = 0;
+    } else if (seq != STREAM_SEQ_ANY && seq != stream->next_seq) {
+        *error_code = ERROR_OP_INVALID_INPUT;
+        stream = 0;
+    } else {
+        stream->busy = 1;
+    }
+    spin_unlock(&stream_lock);
+
+    if (!stream) {
+        atomic_increment_u64(&stream_stats.rejected);
+    }
+    return stream;
+}
+
+void operations_stream_put(OperationsStream* stream) {
+    spin_lock(&stream_lock);
+    if (stream->dead) {
+        // Процесс вышел, пока chunk обрабатывался
+        stream_slots[STREAM_SLOT(stream->id)] = 0;
+        stream_open_count--;
+        spin_unlock(&stream_lock);
+        stream_free(stream);
+        return;
+    }
+    stream->busy = 0;
+    spin_unlock(&stream_lock);
+}
+
+void operations_stream_close(OperationsStream* stream) {
+    spin_lock(&stream_lock);
+    stream_slots[STREAM_SLOT(stream->id)] = 0;
+    stream_open_count--;
+    spin_unlock(&stream_lock);
+
+    stream_free(stream);
+    atomic_increment_u64(&stream_stats.closed);
+}
+
+void operations_stream_release_owner(uint64_t owner_pid) {
+    OperationsStream* victims[OPERATIONS_STREAM_MAX];
+    uint32_t count = 0;
+
+    spin_lock(&stream_lock);
+    for (uint32_t i = 0; i < OPERATIONS_STREAM_MAX; i++) {
+        OperationsStream* stream = stream_slots[i];
+        if (!stream || stream->owner_pid != owner_pid) {
+            continue;
+        }
+        if (stream->busy) {
+            stream->dead = 1;   // Освободит operations_stream_put()
+            continue;
+        }
+        stream_slots[i] = 0;
+        stream_open_count--;
+        victims[count++] = stream;
+    }
+    spin_unlock(&stream_lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        stream_free(victims[i]);
+    }
+    if (count > 0) {
+        atomic_add_u64(&stream_stats.released, count);
+        kprintf("[STREAM] Released %u session(s) of PID=%lu\n", count, owner_pid);
+    }
+}
+
+void operations_stream_print_stats(void) {
+    kprintf("\n%[H]=== Operations Streams ===%[D]\n");
+    kprintf("  open=%u/%d opened=%lu closed=%lu released=%lu rejected=%lu limited=%lu\n",
+            stream_open_count, OPERATIONS_STREAM_MAX,
+            atomic_load_u64(&stream_stats.opened),
+            atomic_load_u64(&stream_stats.closed),
+            atomic_load_u64(&stream_stats.released),
+            atomic_load_u64(&stream_stats.rejected),
+            atomic_load_u64(&stream_stats.limited));
+}
@@ -0,0 +1,77 @@
+#ifndef OPERATIONS_STREAM_H
+#define OPERATIONS_STREAM_H
+
+#include "ktypes.h"
+#include "operations_cipher.h"
+
+// ============================================================================
+// OPERATIONS STREAMS - stateful hashing / compression / encryption
+// ============================================================================
+//
+// Вход больше одного события: session держит running state в deck,
+// chunks приходят событиями (payload или registered buffer / input_result):
+//
+//   EVENT_OP_STREAM_OPEN    → session_id
+//   EVENT_OP_STREAM_UPDATE  → chunk результата (LZ4 / cipher) или байт всего
+//   EVENT_OP_STREAM_FINAL   → итог (hash / end mark / tag), session закрыта
+//   EVENT_OP_STREAM_ABORT   → session закрыта без результата
+//
+// Порядок chunks задаёт submitter (workflow deps между nodes); seq в
+// каждом UPDATE / FINAL ловит гонку или пропуск - такой chunk отвергается,
+// state не меняется. Session принадлежит PID, открывшему её; при выходе
+// процесса его sessions освобождаются.
+//
+// ============================================================================
+
+#define STREAM_KIND_CRC32           1
+#define STREAM_KIND_CRC32C          2
+#define STREAM_KIND_DJB2            3
+#define STREAM_KIND_LZ4_FRAME       4   // Chunks - блоки одного LZ4 frame
+#define STREAM_KIND_ENCRYPT         5   // cipher_stream (AES-CTR / GCM / ChaCha20-Poly1305)
+#define STREAM_KIND_DECRYPT         6
+
+#define OPERATIONS_STREAM_MAX       64  // Открытых sessions одновременно
+#define OPERATIONS_STREAM_PER_OWNER 8   // Один PID не занимает весь пул (kernel - без лимита)
+#define STREAM_SEQ_ANY              (~0ULL)  // ABORT: без проверки порядка
+
+typedef struct OperationsStream {
+    uint64_t id;                    // (generation << 8) | slot
+    uint64_t owner_pid;
+    uint32_t kind;
+    volatile uint32_t busy;         // Chunk в обработке (одновременный - отвергается)
+    uint8_t dead;                   // Владелец вышел во время chunk: освободит put
+    uint64_t next_seq;              // Ожидаемый seq следующего chunk
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+
+    union {
+        uint32_t crc;               // CRC32 / CRC32C: результат update
+        uint64_t djb2;
+        uint8_t lz4_begun;          // Frame header уже выдан
+    } state;
+    CipherStream* cipher;           // ENCRYPT / DECRYPT (kmalloc, стирается при close)
+} OperationsStream;
+
+void operations_stream_init(void);
+
+// cipher_params: [cipher:1][key_size:1][reserved:2][aad_size:4][nonce:12]
+//                [reserved:4][key:32][aad...] (только ENCRYPT / DECRYPT).
+// Возвращает session_id, 0 = неверные параметры / нет слотов / лимит PID / памяти
+uint64_t operations_stream_open(uint64_t owner_pid, uint32_t kind,
+                                const uint8_t* cipher_params, uint64_t params_size);
+
+// Занимает session под chunk: 0 = нет такой / чужая / seq не тот / занята.
+// Успех - обязательно operations_stream_put() (или close)
+OperationsStream* operations_stream_get(uint64_t id, uint64_t owner_pid, uint64_t seq,
+                                        uint32_t* error_code);
+void operations_stream_put(OperationsStream* stream);
+
+// Закрывает занятую session (FINAL / ABORT)
+void operations_stream_close(OperationsStream* stream);
+
+// Все sessions процесса (process_destroy)
+void operations_stream_release_owner(uint64_t owner_pid);
+
+void operations_stream_print_stats(void);
+
+#endif // OPERATIONS_STREAM_H
@@ -0,0 +1,158 @@
+#include "operations_vector.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+#define CPUID7_EBX_AVX2  (1 << 5)
+
+typedef void (*vector_kernel_t)(const void* a, const void* b, void* out, uint64_t count);
+
+// [op][elem] текущей реализации
+static vector_kernel_t vector_kernels[3][VECTOR_ELEM_COUNT];
+static const char* vector_isa_name = "none";
+
+static const uint32_t vector_elem_sizes[VECTOR_ELEM_COUNT] = { 8, 4, 8 };
+static const char* vector_elem_names[VECTOR_ELEM_COUNT] = { "u64", "f32", "f64" };
+
+// aligned(1): операнды из payload / registered buffer без выравнивания
+typedef uint64_t vector_u64x2 __attribute__((vector_size(16), aligned(1)));
+typedef uint64_t vector_u64x4 __attribute__((vector_size(32), aligned(1)));
+typedef float    vector_f32x4 __attribute__((vector_size(16), aligned(1)));
+typedef float    vector_f32x8 __attribute__((vector_size(32), aligned(1)));
+typedef double   vector_f64x2 __attribute__((vector_size(16), aligned(1)));
+typedef double   vector_f64x4 __attribute__((vector_size(32), aligned(1)));
+
+// ============================================================================
+// KERNELS
+// ============================================================================
+//
+// Один шаблон на (ISA, тип, операция): основной цикл по полному вектору,
+// хвост поэлементно. GCC vector extensions - uint64 MUL без AVX-512
+// раскладывается на pmuludq, как и нужно.
+//
+// ============================================================================
+
+#define VECTOR_BINARY_KERNEL(name, isa, elem_t, vec_t, OP)                          \
+    static __attribute__((target(isa)))                                             \
+    void name(const void* a_ptr, const void* b_ptr, void* out_ptr, uint64_t count) { \
+        const elem_t* a = (const elem_t*)a_ptr;                                     \
+        const elem_t* b = (const elem_t*)b_ptr;                                     \
+        elem_t* out = (elem_t*)out_ptr;                                             \
+        const uint64_t lanes = sizeof(vec_t) / sizeof(elem_t);                      \
+        uint64_t i = 0;                                                             \
+        for (; i + lanes <= count; i += lanes) {                                    \
+            *(vec_t*)(out + i) = *(const vec_t*)(a + i) OP *(const vec_t*)(b + i);  \
+        }                                                                           \
+        for (; i < count; i++) {                                                    \
+            out[i] = a[i] OP b[i];                                                  \
+        }                                                                           \
+    }
+
+#define VECTOR_SCALE_KERNEL(name, isa, elem_t, vec_t)                               \
+    static __attribute__((target(isa)))                                             \
+    void name(const void* a_ptr, const void* s_ptr, void* out_ptr, uint64_t count) { \
+        const elem_t* a = (const elem_t*)a_ptr;                                     \
+        elem_t* out = (elem_t*)out_ptr;                                             \
+        elem_t scalar;                                                              \
+        memcpy(&scalar, s_ptr, sizeof(scalar));                                     \
+        const uint64_t lanes = sizeof(vec_t) / sizeof(elem_t);                      \
+        uint64_t i = 0;                                                             \
+        for (; i + lanes <= count; i += lanes) {                                    \
+            *(vec_t*)(out + i) = *(const vec_t*)(a + i) * scalar;                   \
+        }                                                                           \
+        for (; i < count; i++) {                                                    \
+            out[i] = a[i] * scalar;                                                 \
+        }                                                                           \
+    }
+
+VECTOR_BINARY_KERNEL(vector_add_u64_sse2, "sse2", uint64_t, vector_u64x2, +)
+VECTOR_BINARY_KERNEL(vector_add_f32_sse2, "sse2", float,    vector_f32x4, +)
+VECTOR_BINARY_KERNEL(vector_add_f64_sse2, "sse2", double,   vector_f64x2, +)
+VECTOR_BINARY_KERNEL(vector_mul_u64_sse2, "sse2", uint64_t, vector_u64x2, *)
+VECTOR_BINARY_KERNEL(vector_mul_f32_sse2, "sse2", float,    vector_f32x4, *)
+VECTOR_BINARY_KERNEL(vector_mul_f64_sse2, "sse2", double,   vector_f64x2, *)
+VECTOR_SCALE_KERNEL(vector_scale_u64_sse2, "sse2", uint64_t, vector_u64x2)
+VECTOR_SCALE_KERNEL(vector_scale_f32_sse2, "sse2", float,    vector_f32x4)
+VECTOR_SCALE_KERNEL(vector_scale_f64_sse2, "sse2", double,   vector_f64x2)
+
+VECTOR_BINARY_KERNEL(vector_add_u64_avx2, "avx2", uint64_t, vector_u64x4, +)
+VECTOR_BINARY_KERNEL(vector_add_f32_avx2, "avx2", float,    vector_f32x8, +)
+VECTOR_BINARY_KERNEL(vector_add_f64_avx2, "avx2", double,   vector_f64x4, +)
+VECTOR_BINARY_KERNEL(vector_mul_u64_avx2, "avx2", uint64_t, vector_u64x4, *)
+VECTOR_BINARY_KERNEL(vector_mul_f32_avx2, "avx2", float,    vector_f32x8, *)
+VECTOR_BINARY_KERNEL(vector_mul_f64_avx2, "avx2", double,   vector_f64x4, *)
+VECTOR_SCALE_KERNEL(vector_scale_u64_avx2, "avx2", uint64_t, vector_u64x4)
+VECTOR_SCALE_KERNEL(vector_scale_f32_avx2, "avx2", float,    vector_f32x8)
+VECTOR_SCALE_KERNEL(vector_scale_f64_avx2, "avx2", double,   vector_f64x4)
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void vector_engine_init(void) {
+    uint32_t a, b, c, d;
+    cpu_cpuid(0, 0, &a, &b, &c, &d);
+    uint32_t max_leaf = a;
+
+    int avx2 = 0;
+    if (max_leaf >= 7 && fpu_avx_enabled()) {
+        cpu_cpuid(7, 0, &a, &b, &c, &d);
+        avx2 = (b & CPUID7_EBX_AVX2) != 0;
+    }
+
+    if (avx2) {
+        vector_kernels[VECTOR_OP_ADD][VECTOR_ELEM_U64] = vector_add_u64_avx2;
+        vector_kernels[VECTOR_OP_ADD][VECTOR_ELEM_F32] = vector_add_f32_avx2;
+        vector_kernels[VECTOR_OP_ADD][VECTOR_ELEM_F64] = vector_add_f64_avx2;
+        vector_kernels[VECTOR_OP_MUL][VECTOR_ELEM_U64] = vector_mul_u64_avx2;
+        vector_kernels[VECTOR_OP_MUL][VECTOR_ELEM_F32] = vector_mul_f32_avx2;
+        vector_kernels[VECTOR_OP_MUL][VECTOR_ELEM_F64] = vector_mul_f64_avx2;
+        vector_kernels[VECTOR_OP_SCALE][VECTOR_ELEM_U64] = vector_scale_u64_avx2;
+        vector_kernels[VECTOR_OP_SCALE][VECTOR_ELEM_F32] = vector_scale_f32_avx2;
+        vector_kernels[VECTOR_OP_SCALE][VECTOR_ELEM_F64] = vector_scale_f64_avx2;
+        vector_isa_name = "AVX2";
+    } else {
+        vector_kernels[VECTOR_OP_ADD][VECTOR_ELEM_U64] = vector_add_u64_sse2;
+        vector_kernels[VECTOR_OP_ADD][VECTOR_ELEM_F32] = vector_add_f32_sse2;
+        vector_kernels[VECTOR_OP_ADD][VECTOR_ELEM_F64] = vector_add_f64_sse2;
+        vector_kernels[VECTOR_OP_MUL][VECTOR_ELEM_U64] = vector_mul_u64_sse2;
+        vector_kernels[VECTOR_OP_MUL][VECTOR_ELEM_F32] = vector_mul_f32_sse2;
+        vector_kernels[VECTOR_OP_MUL][VECTOR_ELEM_F64] = vector_mul_f64_sse2;
+        vector_kernels[VECTOR_OP_SCALE][VECTOR_ELEM_U64] = vector_scale_u64_sse2;
+        vector_kernels[VECTOR_OP_SCALE][VECTOR_ELEM_F32] = vector_scale_f32_sse2;
+        vector_kernels[VECTOR_OP_SCALE][VECTOR_ELEM_F64] = vector_scale_f64_sse2;
+        vector_isa_name = "SSE2";
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+uint32_t vector_elem_size(uint32_t elem) {
+    return elem < VECTOR_ELEM_COUNT ? vector_elem_sizes[elem] : 0;
+}
+
+const char* vector_elem_name(uint32_t elem) {
+    return elem < VECTOR_ELEM_COUNT ? vector_elem_names[elem] : "?";
+}
+
+int vector_engine_apply(uint32_t op, uint32_t elem, const void* a, const void* b,
+                        void* out, uint64_t count) {
+    if (op > VECTOR_OP_SCALE || elem >= VECTOR_ELEM_COUNT || !vector_kernels[op][elem]) {
+        return 0;
+    }
+
+    kernel_fpu_begin();
+    vector_kernels[op][elem](a, b, out, count);
+    kernel_fpu_end();
+    return 1;
+}
+
+void vector_engine_print_info(void) {
+    kprintf("[OPERATIONS]   - Vectors: %s (u64, f32, f64)\n", vector_isa_name);
+}
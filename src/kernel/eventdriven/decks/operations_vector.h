@@ -0,0 +1,45 @@
+#ifndef OPERATIONS_VECTOR_H
+#define OPERATIONS_VECTOR_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// VECTOR ENGINE - SIMD kernels EVENT_OP_VECTOR_ADD / MUL / SCALE
+// ============================================================================
+//
+// Реализация выбирается один раз при init:
+//   AVX2 (CPUID.7:EBX.AVX2 + XCR0.AVX, fpu_avx_enabled) → 256-bit
+//   иначе SSE2 (всегда есть на x86-64)                  → 128-bit
+//
+// Тип элемента - старший байт поля count в payload:
+//   [count | elem << 56 : 8] ...   (elem = 0 - uint64, как раньше)
+//
+// Вызов сам открывает kernel_fpu_begin/end - caller SIMD не трогает.
+//
+// ============================================================================
+
+#define VECTOR_ELEM_U64     0
+#define VECTOR_ELEM_F32     1
+#define VECTOR_ELEM_F64     2
+#define VECTOR_ELEM_COUNT   3
+
+#define VECTOR_OP_ADD       0
+#define VECTOR_OP_MUL       1
+#define VECTOR_OP_SCALE     2       // out[i] = a[i] * scalar (b = &scalar)
+
+#define VECTOR_HEADER_COUNT(h)  ((h) & 0x00FFFFFFFFFFFFFFULL)
+#define VECTOR_HEADER_ELEM(h)   ((uint32_t)((h) >> 56))
+
+void vector_engine_init(void);
+
+// Байт на элемент (0 = неизвестный тип)
+uint32_t vector_elem_size(uint32_t elem);
+const char* vector_elem_name(uint32_t elem);
+
+// out = a op b, count элементов. Возвращает 1, 0 при неверном op/elem
+int vector_engine_apply(uint32_t op, uint32_t elem, const void* a, const void* b,
+                        void* out, uint64_t count);
+
+void vector_engine_print_info(void);
+
+#endif // OPERATIONS_VECTOR_H
@@ -1,8 +1,13 @@
 #include "deck_interface.h"
 #include "pmm.h"  // Physical memory manager
 #include "vmm.h"  // Virtual memory manager
+#include "process.h"
 #include "klib.h"
 #include "../storage/tagfs.h"  // TagFS - Tag-based filesystem
+#include "../storage/block_cache.h"  // Background write-back
+#include "../storage/block_queue.h"  // Async completions, plug на batch
+#include "smp.h"
+#include "clock.h"  // clock_event_kick - отложенное снятие памяти на BSP
 
 // ============================================================================
 // STORAGE DECK - Memory & Filesystem Operations
@@ -23,15 +28,131 @@ typedef struct {
     uint64_t position;         // Current read/write position
     int flags;                 // Open flags (O_RDONLY, O_WRONLY, O_RDWR)
     int in_use;                // 1 if FD is active, 0 if free
+    uint64_t owner_pid;        // Процесс-владелец (0 = kernel-side события)
+    uint32_t generation;       // Растёт при каждом open слота
+    int next_free;             // Следующий свободный слот (-1 = конец)
+
+    // Read-ahead (см. READ-AHEAD ниже)
+    uint64_t ra_next;          // Offset, с которого продолжится последовательное чтение
+    uint64_t ra_start;         // Последнее окно read-ahead [ra_start, ra_end)
+    uint64_t ra_end;
+    uint32_t ra_window;        // Размер окна в блоках
+    int ra_pending;            // Окно ещё не отдано в block cache
+
+    // Async read (см. ASYNC READ ниже)
+    int io_wait;               // Слот storage_io_waits (-1 = чтений в полёте нет)
+    uint32_t io_resuming;      // Чтений возвращено в Guide, ещё не выполнено
 } FileDescriptor;
 
-// Глобальная таблица открытых файлов
+// Глобальная таблица открытых файлов.
+// FD = (generation << FD_SLOT_BITS) | slot: find_fd - индекс, без скана.
+// Закрытый FD не находит слот после повторного open (generation другой),
+// FD другого процесса - не совпадает owner_pid
 #define MAX_OPEN_FILES 256
+#define FD_SLOT_BITS   8
+#define FD_SLOT(fd)    ((uint32_t)(fd) & ((1u << FD_SLOT_BITS) - 1))
+#define FD_GEN_MASK    ((1u << (31 - FD_SLOT_BITS)) - 1)  // FD остаётся положительным int
+
+_Static_assert(MAX_OPEN_FILES <= (1 << FD_SLOT_BITS), "FD slot must fit in fd");
+
 static FileDescriptor fd_table[MAX_OPEN_FILES];
+static int fd_free_head = -1;           // Free list через next_free
 static spinlock_t fd_table_lock;
 
-// Глобальный счетчик FD
-static volatile uint64_t next_fd = 100;
+// ============================================================================
+// READ-AHEAD - последовательное чтение через FD
+// ============================================================================
+
+// fs_read с offset == ra_next - последовательный поток: следующее окно
+// ставится в очередь (ra_pending) и читается в block cache из idle прохода
+// deck, пока процесс обрабатывает уже полученные данные. Окно адаптивное:
+// если к приходу read блоки окна ещё в cache - окно удваивается, если их
+// уже вытеснили (prefetch пришлось повторить) - уменьшается вдвое. Случайный
+// offset сбрасывает окно к минимуму и останавливает read-ahead.
+// NOTE: с DMA окно уходит async командой (tagfs_fetch_async), без него -
+// синхронный prefetch, перенесённый в idle проход
+#define STORAGE_RA_MIN_BLOCKS   2
+#define STORAGE_RA_MAX_BLOCKS   BLOCK_CACHE_PREFETCH_MAX
+
+static uint32_t storage_ra_cursor = 0;  // Round-robin по fd_table в idle
+
+static void storage_readahead_update(FileDescriptor* fd_info, uint64_t size);
+static void storage_readahead_schedule(FileDescriptor* fd_info, uint64_t bytes_read);
+static int storage_readahead_idle(void);
+
+// Окна, заказанные workflow optimizer'ом (storage_prefetch_hint): FILE_READ
+// node ещё ждёт зависимостей, его блоки читаются в idle проходе заранее.
+// Полная очередь - hint просто теряется
+#define STORAGE_PREFETCH_HINTS  16
+
+typedef struct {
+    uint64_t inode_id;
+    uint64_t start;
+    uint64_t end;
+} StoragePrefetchHint;
+
+static StoragePrefetchHint storage_prefetch_hints[STORAGE_PREFETCH_HINTS];
+static uint32_t storage_prefetch_head = 0;
+static uint32_t storage_prefetch_count = 0;    // Под fd_table_lock
+
+static int storage_prefetch_idle(void);
+
+// ============================================================================
+// ASYNC READ - FILE_READ ждёт диск в SUSPENDED, а не в deck loop
+// ============================================================================
+
+// Блоки чтения, которых нет в block cache, уходят async DMA командами
+// (tagfs_fetch_async), entry - SUSPENDED, deck берёт следующие события -
+// как Hardware Deck паркует timer sleep. IRQ диска -> block_queue_reap() ->
+// storage_io_done(): последняя команда возвращает entries в Guide
+// (PROCESSING), шаг выполняется заново и читает уже из cache.
+// Чтения того же FD, пришедшие пока первое ждёт, встают в тот же wait,
+// новые - ждут, пока возвращённые не выполнятся: порядок position сохраняется
+#define STORAGE_IO_WAITS         32      // FD с чтением в полёте одновременно
+#define STORAGE_IO_WAIT_ENTRIES  8       // Ждущих чтений на один FD
+#define STORAGE_IO_MAX_BLOCKS    BLOCK_CACHE_PREFETCH_MAX  // Остаток чтения - синхронно
+
+typedef struct {
+    RoutingEntry* entries[STORAGE_IO_WAIT_ENTRIES];
+    uint32_t entry_count;
+    uint32_t outstanding;        // Команд ATA в полёте (+1, пока идёт отправка)
+    FileDescriptor* fd_info;     // NULL - FD закрыли, пока ждали
+    int in_use;
+} StorageIoWait;
+
+static StorageIoWait storage_io_waits[STORAGE_IO_WAITS];   // Под fd_table_lock
+
+static int storage_read_suspend(RoutingEntry* entry, uint64_t owner_pid, int fd, uint64_t size);
+static void storage_io_done(void* context, int status);
+
+// ============================================================================
+// BATCHED SYNC - один tagfs_commit() на batch вместо одного на операцию
+// ============================================================================
+
+// Внутри storage_deck_process_batch() commit откладывается до конца batch:
+// изменения metadata всех событий batch - одна транзакция журнала (group
+// commit). Завершения batch deck держит (deck_hold_publish) и отдаёт Guide
+// только после tagfs_commit() - процесс получает ответ уже после записи на
+// диск. Блоки на место - background checkpoint из idle прохода.
+//
+// Состояние batch - у CPU, на котором идёт batch: deck loop (свой AP или
+// timer IRQ на BSP) и прямые вызовы storage_deck_process() (bench) не
+// видят batch друг друга
+typedef struct {
+    int active;                 // Внутри storage_deck_process_batch()
+    int sync_pending;           // Batch изменил metadata - commit в конце
+} StorageBatchState;
+
+static StorageBatchState storage_batch[SMP_MAX_CPUS];
+
+static void storage_sync(void) {
+    StorageBatchState* batch = &storage_batch[smp_current_cpu()];
+    if (batch->active) {
+        batch->sync_pending = 1;
+        return;
+    }
+    tagfs_commit();
+}
 
 // File stat structure (returned by fs_stat)
 typedef struct {
@@ -47,93 +168,255 @@ typedef struct {
 // MEMORY OPERATIONS
 // ============================================================================
 
-static void* memory_alloc(uint64_t size) {
+// Событие процесса (из его EventRing) получает память в СВОЁМ адресном
+// пространстве: lazy регион user RW с началом, кратным MEMORY_USER_ALIGN -
+// ulib heap режет такие chunks на блоки и находит chunk блока маской.
+// Kernel-side событие без владельца - kernel heap, как раньше
+#define MEMORY_USER_ALIGN (64 * 1024)
+
+// Контекст процесса-владельца entry. NULL - процесса уже нет
+static vmm_context_t* memory_owner_context(RoutingEntry* entry) {
+    process_t* proc = (process_t*)entry->owner;
+
+    if (proc->pid != entry->owner_pid || proc->state == PROCESS_STATE_ZOMBIE) {
+        return NULL;
+    }
+    return (vmm_context_t*)proc->vmm_context;
+}
+
+static void* memory_alloc(vmm_context_t* user_ctx, uint64_t size) {
     // Вычисляем количество страниц (4KB каждая)
     size_t page_count = (size + 4095) / 4096;
 
-    // Аллоцируем память через VMM (используем kernel context)
-    void* addr = vmm_alloc_pages(vmm_get_kernel_context(), page_count,
-                                 VMM_FLAGS_KERNEL_RW);
+    // Только адреса: нулевые страницы - при первом обращении (demand paging),
+    // процесс платит физической памятью только за то, что тронул
+    void* addr = user_ctx
+        ? vmm_alloc_pages_lazy_aligned(user_ctx, page_count, MEMORY_USER_ALIGN,
+                                       VMM_FLAGS_USER_RW)
+        : vmm_alloc_pages_lazy(vmm_get_kernel_context(), page_count,
+                               VMM_FLAGS_KERNEL_RW);
 
-    if (addr) {
-        kprintf("[STORAGE] Allocated %lu bytes (%lu pages) at %p\n",
-                size, page_count, addr);
-    } else {
+    // Успех - trace point VMM_ALLOC в vmm_alloc_pages
+    if (!addr) {
         kprintf("[STORAGE] Failed to allocate %lu bytes\n", size);
     }
 
     return addr;
 }
 
-static void memory_free(void* addr, uint64_t size) {
+// ----------------------------------------------------------------------------
+// DEFERRED UNMAP - EVENT_MEMORY_FREE с AP
+// ----------------------------------------------------------------------------
+// vmm_free_pages сбрасывает TLB только своего CPU, а user процессы (и их
+// TLB) живут на BSP: снятие на AP отдало бы страницы в PMM, пока BSP их ещё
+// видит. AP ставит снятие в очередь и будит BSP (clock_event_kick) - BSP
+// снимает сам из timer interrupt, где его сброс TLB верный. До этого регион
+// остаётся занятым: адрес не выдаётся повторно, повторный free отвергается.
+#define MEMORY_DEFERRED_MAX 64
+
+typedef struct {
+    uint64_t owner_pid;             // 0 = kernel context
+    void* addr;
+    uint64_t pages;
+} MemoryDeferredFree;
+
+static MemoryDeferredFree memory_deferred[MEMORY_DEFERRED_MAX];
+static volatile uint32_t memory_deferred_count = 0;
+static spinlock_t memory_deferred_lock;
+
+// 1 = поставлено, 0 = этот регион уже ждёт снятия, -1 = очередь полна
+static int memory_defer_free(uint64_t owner_pid, void* addr, uint64_t pages) {
+    int queued = -1;
+
+    spin_lock(&memory_deferred_lock);
+    for (uint32_t i = 0; i < memory_deferred_count; i++) {
+        if (memory_deferred[i].owner_pid == owner_pid && memory_deferred[i].addr == addr) {
+            queued = 0;
+            break;
+        }
+    }
+    if (queued != 0 && memory_deferred_count < MEMORY_DEFERRED_MAX) {
+        memory_deferred[memory_deferred_count].owner_pid = owner_pid;
+        memory_deferred[memory_deferred_count].addr = addr;
+        memory_deferred[memory_deferred_count].pages = pages;
+        memory_deferred_count++;
+        queued = 1;
+    }
+    spin_unlock(&memory_deferred_lock);
+
+    if (queued == 1) {
+        clock_event_kick();
+    }
+    return queued;
+}
+
+// BSP, timer interrupt: снять отложенные регионы. Процесс успел умереть -
+// его страницы уже забрал vmm_destroy_context
+void storage_deck_drain_frees(void) {
+    if (atomic_load_u32(&memory_deferred_count) == 0) {
+        return;
+    }
+
+    MemoryDeferredFree batch[MEMORY_DEFERRED_MAX];
+    spin_lock(&memory_deferred_lock);
+    uint32_t count = memory_deferred_count;
+    memcpy(batch, memory_deferred, count * sizeof(MemoryDeferredFree));
+    memory_deferred_count = 0;
+    spin_unlock(&memory_deferred_lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        vmm_context_t* ctx = vmm_get_kernel_context();
+        if (batch[i].owner_pid) {
+            process_t* proc = process_find_by_pid(batch[i].owner_pid);
+            if (!proc || !proc->vmm_context) {
+                continue;
+            }
+            ctx = (vmm_context_t*)proc->vmm_context;
+        }
+        vmm_free_pages(ctx, batch[i].addr, batch[i].pages);
+    }
+}
+
+// 1 = снят (или снимет BSP), 0 = addr не начало выданного региона такого
+// размера (или уже ждёт снятия), -1 = очередь отложенных снятий полна
+static int memory_free(vmm_context_t* user_ctx, uint64_t owner_pid, void* addr, uint64_t size) {
     size_t page_count = (size + 4095) / 4096;
-    vmm_free_pages(vmm_get_kernel_context(), addr, page_count);
-    kprintf("[STORAGE] Freed memory at %p (%lu pages)\n", addr, page_count);
+
+    if (user_ctx) {
+        // Процесс не должен снять чужой регион или свой стек: только то,
+        // что выдал EVENT_MEMORY_ALLOC, и целиком
+        if (vmm_region_size(&user_ctx->regions, (uintptr_t)addr) != page_count * 4096) {
+            return 0;
+        }
+    }
+
+    if (smp_current_cpu() != 0) {
+        return memory_defer_free(user_ctx ? owner_pid : 0, addr, page_count);
+    }
+
+    vmm_free_pages(user_ctx ? user_ctx : vmm_get_kernel_context(), addr, page_count);
+    return 1;
 }
 
 // ============================================================================
 // FILE DESCRIPTOR TABLE MANAGEMENT
 // ============================================================================
 
-static int allocate_fd(uint64_t inode_id, const char* path, int flags) {
+// Все слоты в free list (init)
+static void fd_table_reset(void) {
+    memset(fd_table, 0, sizeof(fd_table));
+    memset(storage_io_waits, 0, sizeof(storage_io_waits));
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        fd_table[i].next_free = i + 1 < MAX_OPEN_FILES ? i + 1 : -1;
+        fd_table[i].io_wait = -1;
+    }
+    fd_free_head = 0;
+}
+
+// Слот в free list (под fd_table_lock)
+static void fd_slot_release(FileDescriptor* fd_info) {
+    // Чтения в полёте вернутся в Guide и получат "invalid fd"
+    if (fd_info->io_wait >= 0) {
+        storage_io_waits[fd_info->io_wait].fd_info = NULL;
+        fd_info->io_wait = -1;
+    }
+    fd_info->io_resuming = 0;
+    fd_info->in_use = 0;
+    fd_info->ra_pending = 0;
+    fd_info->next_free = fd_free_head;
+    fd_free_head = (int)(fd_info - fd_table);
+}
+
+static int allocate_fd(uint64_t owner_pid, uint64_t inode_id, const char* path, int flags) {
+    // Get file size from inode (до fd_table_lock)
+    FileInode* inode = tagfs_get_inode(inode_id);
+    uint64_t size = inode ? inode->size : 0;
+
     spin_lock(&fd_table_lock);
 
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        if (!fd_table[i].in_use) {
-            // Found free slot
-            fd_table[i].in_use = 1;
-            fd_table[i].fd = atomic_increment_u64(&next_fd);
-            fd_table[i].inode_id = inode_id;
-            fd_table[i].position = 0;
-            fd_table[i].flags = flags;
-
-            // Copy path
-            int j = 0;
-            while (path[j] && j < 255) {
-                fd_table[i].path[j] = path[j];
-                j++;
-            }
-            fd_table[i].path[j] = 0;
-
-            // Get file size from inode
-            FileInode* inode = tagfs_get_inode(inode_id);
-            fd_table[i].size = inode ? inode->size : 0;
-
-            int fd = fd_table[i].fd;
-            spin_unlock(&fd_table_lock);
-            return fd;
-        }
+    if (fd_free_head < 0) {
+        spin_unlock(&fd_table_lock);
+        return -1;  // No free slots
     }
 
+    int slot = fd_free_head;
+    FileDescriptor* fd_info = &fd_table[slot];
+    fd_free_head = fd_info->next_free;
+
+    fd_info->generation = (fd_info->generation + 1) & FD_GEN_MASK;
+    fd_info->fd = (int)((fd_info->generation << FD_SLOT_BITS) | (uint32_t)slot);
+    fd_info->in_use = 1;
+    fd_info->owner_pid = owner_pid;
+    fd_info->inode_id = inode_id;
+    fd_info->size = size;
+    fd_info->position = 0;
+    fd_info->flags = flags;
+    fd_info->next_free = -1;
+    fd_info->ra_next = 0;
+    fd_info->ra_start = 0;
+    fd_info->ra_end = 0;
+    fd_info->ra_window = STORAGE_RA_MIN_BLOCKS;
+    fd_info->ra_pending = 0;
+    fd_info->io_wait = -1;
+    fd_info->io_resuming = 0;
+
+    // Copy path
+    int j = 0;
+    while (path[j] && j < 255) {
+        fd_info->path[j] = path[j];
+        j++;
+    }
+    fd_info->path[j] = 0;
+
+    int fd = fd_info->fd;
     spin_unlock(&fd_table_lock);
-    return -1;  // No free slots
+    return fd;
 }
 
-static FileDescriptor* find_fd(int fd) {
+static FileDescriptor* find_fd(uint64_t owner_pid, int fd) {
+    if (fd < 0) {
+        return NULL;
+    }
+
+    FileDescriptor* fd_info = &fd_table[FD_SLOT(fd)];
+
     spin_lock(&fd_table_lock);
+    int match = fd_info->in_use && fd_info->fd == fd && fd_info->owner_pid == owner_pid;
+    spin_unlock(&fd_table_lock);
 
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        if (fd_table[i].in_use && fd_table[i].fd == fd) {
-            spin_unlock(&fd_table_lock);
-            return &fd_table[i];
-        }
+    return match ? fd_info : NULL;  // NULL = закрыт / чужой / не было
+}
+
+static void free_fd(uint64_t owner_pid, int fd) {
+    if (fd < 0) {
+        return;
     }
 
+    FileDescriptor* fd_info = &fd_table[FD_SLOT(fd)];
+
+    spin_lock(&fd_table_lock);
+    if (fd_info->in_use && fd_info->fd == fd && fd_info->owner_pid == owner_pid) {
+        fd_slot_release(fd_info);
+    }
     spin_unlock(&fd_table_lock);
-    return NULL;  // Not found
 }
 
-static void free_fd(int fd) {
-    spin_lock(&fd_table_lock);
+// Процесс завершается (process_destroy) - его FD больше никто не закроет
+void storage_deck_release_owner(uint64_t owner_pid) {
+    uint32_t count = 0;
 
+    spin_lock(&fd_table_lock);
     for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        if (fd_table[i].in_use && fd_table[i].fd == fd) {
-            fd_table[i].in_use = 0;
-            break;
+        if (fd_table[i].in_use && fd_table[i].owner_pid == owner_pid) {
+            fd_slot_release(&fd_table[i]);
+            count++;
         }
     }
-
     spin_unlock(&fd_table_lock);
+
+    if (count > 0) {
+        kprintf("[STORAGE] Closed %u file descriptor(s) of PID=%lu\n", count, owner_pid);
+    }
 }
 
 // ============================================================================
@@ -141,21 +424,13 @@ static void free_fd(int fd) {
 // ============================================================================
 
 // Open file: search by name tag, return FD
-static int fs_open(const char* path) {
-    // Strategy: search for file with tag "name:path"
-    Tag search_tag;
-    strcpy(search_tag.key, "name");
-    strcpy(search_tag.value, path);
-
-    uint64_t result_inodes[10];
-    uint32_t count = 0;
-
-    int ret = tagfs_query_single(&search_tag, result_inodes, &count, 10);
+static int fs_open(uint64_t owner_pid, const char* path) {
+    // Strategy: file with tag "name:path" - через name index TagFS
+    uint64_t inode_id = tagfs_lookup_name(path);
 
-    if (ret == 0 && count > 0) {
+    if (inode_id != TAGFS_INVALID_INODE) {
         // Found file - open first match
-        uint64_t inode_id = result_inodes[0];
-        int fd = allocate_fd(inode_id, path, 0);  // flags=0 for now
+        int fd = allocate_fd(owner_pid, inode_id, path, 0);  // flags=0 for now
 
         if (fd >= 0) {
             kprintf("[STORAGE] Opened file '%s' (inode=%lu, fd=%d)\n",
@@ -168,17 +443,18 @@ static int fs_open(const char* path) {
     } else {
         // File not found - create it!
         Tag tags[2];
+        memset(tags, 0, sizeof(tags));
         strcpy(tags[0].key, "name");
-        strcpy(tags[0].value, path);
+        strncpy(tags[0].value, path, TAGFS_TAG_VALUE_SIZE - 1);  // Name index сравнивает те же байты
         strcpy(tags[1].key, "type");
         strcpy(tags[1].value, "file");
 
-        uint64_t inode_id = tagfs_create_file(tags, 2);
+        inode_id = tagfs_create_file(tags, 2);
 
         if (inode_id != TAGFS_INVALID_INODE) {
             // PRODUCTION: Sync to disk immediately!
-            tagfs_sync();
-            int fd = allocate_fd(inode_id, path, 0);
+            storage_sync();
+            int fd = allocate_fd(owner_pid, inode_id, path, 0);
             kprintf("[STORAGE] Created & opened file '%s' (inode=%lu, fd=%d) - synced to disk\n",
                     path, inode_id, fd);
             return fd;
@@ -190,13 +466,13 @@ static int fs_open(const char* path) {
 }
 
 // Close file: free FD
-static int fs_close(int fd) {
-    FileDescriptor* fd_info = find_fd(fd);
+static int fs_close(uint64_t owner_pid, int fd) {
+    FileDescriptor* fd_info = find_fd(owner_pid, fd);
 
     if (fd_info) {
         kprintf("[STORAGE] Closed fd=%d (inode=%lu, '%s')\n",
                 fd, fd_info->inode_id, fd_info->path);
-        free_fd(fd);
+        free_fd(owner_pid, fd);
         return 0;
     } else {
         kprintf("[STORAGE] ERROR: Invalid fd=%d\n", fd);
@@ -205,19 +481,22 @@ static int fs_close(int fd) {
 }
 
 // Read from file: use TagFS
-static int fs_read(int fd, void* buffer, uint64_t size) {
-    FileDescriptor* fd_info = find_fd(fd);
+static int fs_read(uint64_t owner_pid, int fd, void* buffer, uint64_t size) {
+    FileDescriptor* fd_info = find_fd(owner_pid, fd);
 
     if (!fd_info) {
         kprintf("[STORAGE] ERROR: Read: invalid fd=%d\n", fd);
         return -1;
     }
 
+    storage_readahead_update(fd_info, size);
+
     // Read from current position
     int bytes_read = tagfs_read_file(fd_info->inode_id, fd_info->position,
                                       (uint8_t*)buffer, size);
 
     if (bytes_read >= 0) {
+        storage_readahead_schedule(fd_info, bytes_read);
         fd_info->position += bytes_read;
         kprintf("[STORAGE] Read %d bytes from fd=%d (inode=%lu, pos=%lu)\n",
                 bytes_read, fd, fd_info->inode_id, fd_info->position);
@@ -228,9 +507,286 @@ static int fs_read(int fd, void* buffer, uint64_t size) {
     }
 }
 
+// До чтения: подстроить окно под то, как сработало предыдущее
+static void storage_readahead_update(FileDescriptor* fd_info, uint64_t size) {
+    uint64_t position = fd_info->position;
+
+    if (position != fd_info->ra_next) {
+        // Случайный доступ - read-ahead только мешает
+        fd_info->ra_window = STORAGE_RA_MIN_BLOCKS;
+        fd_info->ra_start = fd_info->ra_end = 0;
+        fd_info->ra_pending = 0;
+        return;
+    }
+
+    uint64_t start = position > fd_info->ra_start ? position : fd_info->ra_start;
+    uint64_t end = position + size < fd_info->ra_end ? position + size : fd_info->ra_end;
+    if (start >= end) {
+        return;
+    }
+
+    if (fd_info->ra_pending) {
+        // Idle проход не успел - окно прочитает сам read, оценивать нечего
+        fd_info->ra_pending = 0;
+        return;
+    }
+
+    // Блоки окна, которые пришлось читать заново, вытеснены до использования
+    int fetched = tagfs_readahead(fd_info->inode_id, start, end - start);
+    if (fetched > 0) {
+        if (fd_info->ra_window > STORAGE_RA_MIN_BLOCKS) {
+            fd_info->ra_window /= 2;
+        }
+    } else if (fetched == 0 && fd_info->ra_window < STORAGE_RA_MAX_BLOCKS) {
+        fd_info->ra_window *= 2;
+    }
+}
+
+// После чтения: следующее окно, когда до конца текущего меньше половины
+static void storage_readahead_schedule(FileDescriptor* fd_info, uint64_t bytes_read) {
+    uint64_t position = fd_info->position + bytes_read;
+    int sequential = fd_info->position == fd_info->ra_next;
+
+    fd_info->ra_next = position;
+    if (!sequential || bytes_read == 0 || position >= fd_info->size) {
+        return;
+    }
+
+    uint64_t window = (uint64_t)fd_info->ra_window * TAGFS_BLOCK_SIZE;
+    if (fd_info->ra_end > position + window / 2) {
+        return;  // Впереди ещё достаточно прочитанного
+    }
+
+    uint64_t start = fd_info->ra_end > position ? fd_info->ra_end : position;
+    uint64_t end = position + window;
+    if (end > fd_info->size) {
+        end = fd_info->size;
+    }
+    if (start >= end) {
+        return;
+    }
+
+    fd_info->ra_start = start;
+    fd_info->ra_end = end;
+    fd_info->ra_pending = 1;
+}
+
+// Idle проход: одно ожидающее окно за вызов. Возвращает 1, если было что читать
+static int storage_readahead_idle(void) {
+    uint64_t inode_id = 0;
+    uint64_t start = 0;
+    uint64_t end = 0;
+
+    spin_lock(&fd_table_lock);
+    for (uint32_t n = 0; n < MAX_OPEN_FILES; n++) {
+        FileDescriptor* fd_info = &fd_table[storage_ra_cursor];
+        storage_ra_cursor = (storage_ra_cursor + 1) % MAX_OPEN_FILES;
+
+        if (fd_info->in_use && fd_info->ra_pending) {
+            fd_info->ra_pending = 0;
+            inode_id = fd_info->inode_id;
+            start = fd_info->ra_start;
+            end = fd_info->ra_end;
+            break;
+        }
+    }
+    spin_unlock(&fd_table_lock);
+
+    if (!inode_id) {
+        return 0;
+    }
+
+    // tagfs lock вне fd_table_lock (prefetch = счётчики block cache).
+    // С DMA окно читается без ожидания, иначе - синхронно
+    if (tagfs_fetch_async(inode_id, start, end - start, NULL, NULL) < 0) {
+        tagfs_readahead(inode_id, start, end - start);
+    }
+    return 1;
+}
+
+// Окно [position + skip, + size) файла fd в очередь hints (workflow.c).
+// 1 = заказано, 0 = нет такого FD, окно за концом файла или очередь полна
+int storage_prefetch_hint(uint64_t owner_pid, int fd, uint64_t skip, uint64_t size) {
+    if (fd < 0 || size == 0) {
+        return 0;
+    }
+
+    FileDescriptor* fd_info = &fd_table[FD_SLOT(fd)];
+    int queued = 0;
+
+    spin_lock(&fd_table_lock);
+    if (fd_info->in_use && fd_info->fd == fd && fd_info->owner_pid == owner_pid &&
+        storage_prefetch_count < STORAGE_PREFETCH_HINTS) {
+        uint64_t start = fd_info->position + skip;
+        uint64_t end = start + size < fd_info->size ? start + size : fd_info->size;
+
+        if (start < end) {
+            StoragePrefetchHint* hint = &storage_prefetch_hints[
+                (storage_prefetch_head + storage_prefetch_count) % STORAGE_PREFETCH_HINTS];
+            hint->inode_id = fd_info->inode_id;
+            hint->start = start;
+            hint->end = end;
+            storage_prefetch_count++;
+            queued = 1;
+        }
+    }
+    spin_unlock(&fd_table_lock);
+
+    return queued;
+}
+
+// Idle проход: один hint за вызов, как storage_readahead_idle()
+static int storage_prefetch_idle(void) {
+    StoragePrefetchHint hint;
+
+    spin_lock(&fd_table_lock);
+    if (storage_prefetch_count == 0) {
+        spin_unlock(&fd_table_lock);
+        return 0;
+    }
+    hint = storage_prefetch_hints[storage_prefetch_head];
+    storage_prefetch_head = (storage_prefetch_head + 1) % STORAGE_PREFETCH_HINTS;
+    storage_prefetch_count--;
+    spin_unlock(&fd_table_lock);
+
+    if (tagfs_fetch_async(hint.inode_id, hint.start, hint.end - hint.start, NULL, NULL) < 0) {
+        tagfs_readahead(hint.inode_id, hint.start, hint.end - hint.start);
+    }
+    return 1;
+}
+
+// Wait закончен (под fd_table_lock)
+static void storage_io_wait_release(StorageIoWait* wait) {
+    int slot = (int)(wait - storage_io_waits);
+    if (wait->fd_info && wait->fd_info->io_wait == slot) {
+        wait->fd_info->io_wait = -1;
+    }
+    wait->fd_info = NULL;
+    wait->entry_count = 0;
+    wait->in_use = 0;
+}
+
+// FILE_READ до fs_read: 1 = шаг продолжится позже (entry SUSPENDED или
+// вернётся через Guide), 0 = читать сейчас
+static int storage_read_suspend(RoutingEntry* entry, uint64_t owner_pid, int fd, uint64_t size) {
+    FileDescriptor* fd_info = find_fd(owner_pid, fd);
+    if (!fd_info) {
+        entry->io_waited = 0;
+        return 0;  // Ошибку вернёт fs_read
+    }
+
+    spin_lock(&fd_table_lock);
+
+    // DEFENSIVE: FD мог закрыться после find_fd
+    if (!fd_info->in_use || fd_info->fd != fd) {
+        spin_unlock(&fd_table_lock);
+        entry->io_waited = 0;
+        return 0;
+    }
+
+    // Уже ждали: блоки в cache (ошибку I/O вернёт синхронное чтение)
+    if (entry->io_waited) {
+        entry->io_waited = 0;
+        if (fd_info->io_resuming > 0) {
+            fd_info->io_resuming--;
+        }
+        spin_unlock(&fd_table_lock);
+        return 0;
+    }
+
+    // Перед этим чтением FD есть ждущие / возвращённые - встаём за ними
+    if (fd_info->io_wait >= 0) {
+        StorageIoWait* wait = &storage_io_waits[fd_info->io_wait];
+        if (wait->entry_count < STORAGE_IO_WAIT_ENTRIES) {
+            wait->entries[wait->entry_count++] = entry;
+            entry->state = EVENT_STATUS_SUSPENDED;
+        }
+        // Wait полон - PROCESSING без завершения: deck_finish_step
+        spin_unlock(&fd_table_lock);
+        return 1;
+    }
+    if (fd_info->io_resuming > 0) {
+        spin_unlock(&fd_table_lock);
+        return 1;  // Повторится через Guide после возвращённых
+    }
+
+    StorageIoWait* wait = NULL;
+    for (int i = 0; i < STORAGE_IO_WAITS; i++) {
+        if (!storage_io_waits[i].in_use) {
+            wait = &storage_io_waits[i];
+            break;
+        }
+    }
+    if (!wait) {
+        spin_unlock(&fd_table_lock);
+        return 0;  // Все waits заняты - синхронно
+    }
+
+    wait->in_use = 1;
+    wait->entries[0] = entry;
+    wait->entry_count = 1;
+    wait->outstanding = 1;  // Guard: done до конца отправки не закроет wait
+    wait->fd_info = fd_info;
+    fd_info->io_wait = (int)(wait - storage_io_waits);
+    entry->state = EVENT_STATUS_SUSPENDED;
+
+    uint64_t inode_id = fd_info->inode_id;
+    uint64_t position = fd_info->position;
+    spin_unlock(&fd_table_lock);
+
+    // tagfs (rwlock) - вне fd_table_lock
+    uint64_t span = (uint64_t)STORAGE_IO_MAX_BLOCKS * TAGFS_BLOCK_SIZE;
+    int submitted = tagfs_fetch_async(inode_id, position, size < span ? size : span,
+                                      storage_io_done, wait);
+
+    spin_lock(&fd_table_lock);
+    if (submitted > 0) {
+        wait->outstanding += (uint32_t)submitted;
+    }
+
+    // Ждать нечего (всё в cache / нет DMA) и никто не встал следом -
+    // читаем сейчас, без round-trip через Guide
+    if (wait->outstanding == 1 && wait->entry_count == 1) {
+        storage_io_wait_release(wait);
+        entry->state = EVENT_STATUS_PROCESSING;
+        spin_unlock(&fd_table_lock);
+        return 0;
+    }
+    spin_unlock(&fd_table_lock);
+
+    storage_io_done(wait, 0);  // Снять guard
+    return 1;
+}
+
+// Колбэк block cache (из block_queue_reap): последняя команда будит entries
+static void storage_io_done(void* context, int status) {
+    StorageIoWait* wait = (StorageIoWait*)context;
+    RoutingEntry* resume[STORAGE_IO_WAIT_ENTRIES];
+    uint32_t count = 0;
+
+    (void)status;  // Ошибку I/O вернёт синхронный повтор чтения
+
+    spin_lock(&fd_table_lock);
+    if (--wait->outstanding == 0) {
+        count = wait->entry_count;
+        memcpy(resume, wait->entries, count * sizeof(RoutingEntry*));
+        if (wait->fd_info) {
+            wait->fd_info->io_resuming += count;
+        }
+        storage_io_wait_release(wait);
+    }
+    spin_unlock(&fd_table_lock);
+
+    // Порядок entries = порядок чтений FD (ready queue - FIFO)
+    for (uint32_t i = 0; i < count; i++) {
+        resume[i]->io_waited = 1;
+        deck_step_ready(resume[i]);  // Шаг ещё не сделан - Guide вернёт его нам
+    }
+}
+
 // Write to file: use TagFS
-static int fs_write(int fd, const void* buffer, uint64_t size) {
-    FileDescriptor* fd_info = find_fd(fd);
+static int fs_write(uint64_t owner_pid, int fd, const void* buffer, uint64_t size) {
+    FileDescriptor* fd_info = find_fd(owner_pid, fd);
 
     if (!fd_info) {
         kprintf("[STORAGE] ERROR: Write: invalid fd=%d\n", fd);
@@ -251,7 +807,7 @@ static int fs_write(int fd, const void* buffer, uint64_t size) {
         }
 
         // PRODUCTION: Sync to disk after every write!
-        tagfs_sync();
+        storage_sync();
 
         kprintf("[STORAGE] Wrote %d bytes to fd=%d (inode=%lu, pos=%lu, size=%lu) - synced to disk\n",
                 bytes_written, fd, fd_info->inode_id, fd_info->position, fd_info->size);
@@ -268,19 +824,11 @@ static int fs_stat(const char* path, FileStat* stat_buf) {
         return -1;  // Invalid buffer
     }
 
-    // Search for file by name tag
-    Tag search_tag;
-    strcpy(search_tag.key, "name");
-    strcpy(search_tag.value, path);
-
-    uint64_t result_inodes[10];
-    uint32_t count = 0;
-
-    int ret = tagfs_query_single(&search_tag, result_inodes, &count, 10);
+    // Search for file by name tag (name index)
+    uint64_t inode_id = tagfs_lookup_name(path);
 
-    if (ret == 0 && count > 0) {
+    if (inode_id != TAGFS_INVALID_INODE) {
         // Found file - get inode info
-        uint64_t inode_id = result_inodes[0];
         FileInode* inode = tagfs_get_inode(inode_id);
 
         if (inode) {
@@ -317,6 +865,11 @@ int storage_deck_process(RoutingEntry* entry) {
     }
 
     Event* event = &entry->event_copy;
+    uint8_t* payload = entry->payload;  // Kernel копия payload (снимок ingestion)
+    // Пространство FD процесса. Workflow node не имеет owner, но его
+    // результат идёт владельцу instance - FD тоже его (0 = kernel workflow)
+    uint64_t owner_pid = entry->owner ? entry->owner_pid :
+                         entry->result_owner ? entry->result_pid : 0;
 
     // DEFENSIVE: Validate event type is in storage range
     // Memory operations: 1-9, File operations: 10-19
@@ -331,7 +884,7 @@ int storage_deck_process(RoutingEntry* entry) {
         // === MEMORY OPERATIONS ===
         case EVENT_MEMORY_ALLOC: {
             // DEFENSIVE: Validate size
-            uint64_t size = *(uint64_t*)event->data;
+            uint64_t size = *(uint64_t*)payload;
 
             if (size == 0) {
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
@@ -346,10 +899,22 @@ int storage_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
-            void* addr = memory_alloc(size);
+            vmm_context_t* user_ctx = NULL;
+            if (entry->owner) {
+                user_ctx = memory_owner_context(entry);
+                if (!user_ctx) {
+                    deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
+                                      "Memory allocation: owner process is gone");
+                    return 0;
+                }
+            }
+
+            void* addr = memory_alloc(user_ctx, size);
 
             if (addr) {
-                deck_complete(entry, DECK_PREFIX_STORAGE, addr, RESULT_TYPE_MEMORY_MAPPED);
+                // Память процесса - его, Execution Deck её не освобождает
+                deck_complete(entry, DECK_PREFIX_STORAGE, addr,
+                              user_ctx ? RESULT_TYPE_VALUE : RESULT_TYPE_MEMORY_MAPPED);
                 kprintf("[STORAGE] Event %lu: allocated %lu bytes\n",
                         event->id, size);
                 return 1;
@@ -362,8 +927,8 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_MEMORY_FREE: {
             // DEFENSIVE: Validate pointer
-            void* addr = *(void**)event->data;
-            uint64_t size = *(uint64_t*)(event->data + 8);
+            void* addr = *(void**)payload;
+            uint64_t size = *(uint64_t*)(payload + 8);
 
             if (!addr) {
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
@@ -377,7 +942,27 @@ int storage_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
-            memory_free(addr, size);
+            vmm_context_t* user_ctx = NULL;
+            if (entry->owner) {
+                user_ctx = memory_owner_context(entry);
+                if (!user_ctx) {
+                    deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
+                                      "Memory free: owner process is gone");
+                    return 0;
+                }
+            }
+
+            int freed = memory_free(user_ctx, entry->owner_pid, addr, size);
+            if (freed < 0) {
+                deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_RESOURCE_BUSY,
+                                  "Memory free: deferred unmap queue full");
+                return 0;
+            }
+            if (!freed) {
+                deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
+                                  "Memory free: not an allocated region of this size");
+                return 0;
+            }
             deck_complete(entry, DECK_PREFIX_STORAGE, 0, RESULT_TYPE_NONE);
             kprintf("[STORAGE] Event %lu: freed memory at %p\n", event->id, addr);
             return 1;
@@ -385,9 +970,9 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_MEMORY_MAP: {
             // Payload: [size:8][flags:4][fd:4] (fd can be -1 for anonymous mapping)
-            uint64_t size = *(uint64_t*)event->data;
-            uint32_t flags = *(uint32_t*)(event->data + 8);
-            int fd = *(int*)(event->data + 12);
+            uint64_t size = *(uint64_t*)payload;
+            uint32_t flags = *(uint32_t*)(payload + 8);
+            int fd = *(int*)(payload + 12);
 
             // DEFENSIVE: Validate size
             if (size == 0) {
@@ -408,15 +993,15 @@ int storage_deck_process(RoutingEntry* entry) {
             // File-backed mapping can be added later
 
             if (fd == -1) {
-                // Anonymous mapping - allocate virtual memory
-                void* mapped_addr = vmalloc(size);
+                // Anonymous mapping - lazy: страницы нулевые уже при первом
+                // обращении, поэтому MAP_ZERO (flags & 0x01) ничего не стоит.
+                // Освобождается через vfree (регион kernel heap)
+                (void)flags;
+                void* mapped_addr = vmm_alloc_pages_lazy(vmm_get_kernel_context(),
+                                                         (size + 4095) / 4096,
+                                                         VMM_FLAGS_KERNEL_RW);
 
                 if (mapped_addr) {
-                    // Zero-initialize if requested
-                    if (flags & 0x01) {  // MAP_ZERO flag
-                        memset(mapped_addr, 0, size);
-                    }
-
                     kprintf("[STORAGE] Memory mapped %lu bytes at %p (anonymous)\n",
                             size, mapped_addr);
                     deck_complete(entry, DECK_PREFIX_STORAGE, mapped_addr, RESULT_TYPE_MEMORY_MAPPED);
@@ -437,7 +1022,7 @@ int storage_deck_process(RoutingEntry* entry) {
         // === FILESYSTEM OPERATIONS ===
         case EVENT_FILE_OPEN: {
             // DEFENSIVE: Validate path
-            const char* path = (const char*)event->data;
+            const char* path = (const char*)payload;
 
             if (!path || path[0] == 0) {
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
@@ -455,13 +1040,13 @@ int storage_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
-            int fd = fs_open(path);
+            int fd = fs_open(owner_pid, path);
 
             if (fd >= 0) {
                 // DEFENSIVE: Check memory allocation
                 int* fd_result = (int*)kmalloc(sizeof(int));
                 if (!fd_result) {
-                    fs_close(fd);  // Clean up
+                    fs_close(owner_pid, fd);  // Clean up
                     deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_OUT_OF_MEMORY,
                                       "File open: failed to allocate result buffer");
                     return 0;
@@ -478,7 +1063,7 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_FILE_CLOSE: {
             // DEFENSIVE: Validate FD
-            int fd = *(int*)event->data;
+            int fd = *(int*)payload;
 
             if (fd < 0) {
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
@@ -486,7 +1071,7 @@ int storage_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
-            int result = fs_close(fd);
+            int result = fs_close(owner_pid, fd);
 
             if (result == 0) {
                 deck_complete(entry, DECK_PREFIX_STORAGE, 0, RESULT_TYPE_NONE);
@@ -500,8 +1085,8 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_FILE_READ: {
             // Payload: [fd:4 bytes][size:8 bytes]
-            int fd = *(int*)event->data;
-            uint64_t size = *(uint64_t*)(event->data + 4);
+            int fd = *(int*)payload;
+            uint64_t size = *(uint64_t*)(payload + 4);
 
             // DEFENSIVE: Validate FD
             if (fd < 0) {
@@ -510,6 +1095,28 @@ int storage_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
+            // Registered buffer: читаем прямо в страницы процесса (size = buf_length),
+            // результат - только количество прочитанных байт (значением: kmalloc
+            // указатель освобождается после publish и user'у бесполезен).
+            // input_result read-only - в него не читаем
+            if (entry->buffer && !entry->input_result) {
+                // Блоков нет в cache - ждём диск в SUSPENDED, шаг повторится
+                if (storage_read_suspend(entry, owner_pid, fd, entry->buffer_length)) {
+                    return 1;
+                }
+
+                int bytes_read = fs_read(owner_pid, fd, entry->buffer, entry->buffer_length);
+                if (bytes_read < 0) {
+                    deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_STORAGE_READ_FAILED,
+                                      "File read failed");
+                    return 0;
+                }
+
+                deck_complete(entry, DECK_PREFIX_STORAGE, (void*)(uint64_t)bytes_read,
+                              RESULT_TYPE_VALUE);
+                return 1;
+            }
+
             // DEFENSIVE: Validate size
             if (size == 0) {
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
@@ -524,20 +1131,26 @@ int storage_deck_process(RoutingEntry* entry) {
                 return 0;
             }
 
+            if (storage_read_suspend(entry, owner_pid, fd, size)) {
+                return 1;
+            }
+
             // DEFENSIVE: Check memory allocation
-            uint8_t* buffer = (uint8_t*)kmalloc(size);
+            // ResultBuffer: реальный размер, successor node читает его без копии
+            ResultBuffer* buffer = result_buffer_alloc(size);
             if (!buffer) {
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_OUT_OF_MEMORY,
                                   "File read: failed to allocate buffer");
                 return 0;
             }
 
-            int bytes_read = fs_read(fd, buffer, size);
+            int bytes_read = fs_read(owner_pid, fd, buffer->data, size);
             if (bytes_read >= 0) {
-                deck_complete(entry, DECK_PREFIX_STORAGE, buffer, RESULT_TYPE_KMALLOC);
+                buffer->size = (uint64_t)bytes_read;
+                deck_complete(entry, DECK_PREFIX_STORAGE, buffer, RESULT_TYPE_BUFFER);
                 return 1;
             } else {
-                kfree(buffer);
+                result_buffer_release(buffer);
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_STORAGE_READ_FAILED,
                                   "File read failed");
                 return 0;
@@ -546,9 +1159,10 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_FILE_WRITE: {
             // Payload: [fd:4 bytes][size:8 bytes][data:...]
-            int fd = *(int*)event->data;
-            uint64_t size = *(uint64_t*)(event->data + 4);
-            void* data = event->data + 12;
+            // С registered buffer данные берутся из буфера, size = buf_length
+            int fd = *(int*)payload;
+            uint64_t size = entry->buffer ? entry->buffer_length : *(uint64_t*)(payload + 4);
+            void* data = entry->buffer ? (void*)entry->buffer : (void*)(payload + 12);
 
             // DEFENSIVE: Validate FD
             if (fd < 0) {
@@ -565,17 +1179,17 @@ int storage_deck_process(RoutingEntry* entry) {
             }
 
             // DEFENSIVE: Validate size fits in event payload
-            if (size > EVENT_DATA_SIZE - 12) {
+            if (!entry->buffer && size > EVENT_DATA_SIZE - 12) {
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
                                   "File write: data exceeds event payload limit");
                 return 0;
             }
 
             // Real write
-            int bytes_written = fs_write(fd, data, size);
+            int bytes_written = fs_write(owner_pid, fd, data, size);
             if (bytes_written >= 0) {
                 // PRODUCTION: Sync to disk immediately after write!
-                tagfs_sync();
+                storage_sync();
                 // DEFENSIVE: Check memory allocation
                 int* result = (int*)kmalloc(sizeof(int));
                 if (!result) {
@@ -595,7 +1209,7 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_FILE_STAT: {
             // DEFENSIVE: Validate path
-            const char* path = (const char*)event->data;
+            const char* path = (const char*)payload;
 
             if (!path || path[0] == 0) {
                 deck_error_detailed(entry, DECK_PREFIX_STORAGE, ERROR_INVALID_PARAMETER,
@@ -629,8 +1243,8 @@ int storage_deck_process(RoutingEntry* entry) {
         // === TAGFS OPERATIONS ===
         case EVENT_FILE_CREATE_TAGGED: {
             // Payload: [tag_count:4][tags:Tag[]...]
-            uint32_t tag_count = *(uint32_t*)event->data;
-            Tag* tags = (Tag*)(event->data + 4);
+            uint32_t tag_count = *(uint32_t*)payload;
+            Tag* tags = (Tag*)(payload + 4);
 
             // DEFENSIVE: Validate tag count
             if (tag_count == 0) {
@@ -648,7 +1262,7 @@ int storage_deck_process(RoutingEntry* entry) {
             uint64_t inode_id = tagfs_create_file(tags, tag_count);
             if (inode_id != TAGFS_INVALID_INODE) {
                 // PRODUCTION: Sync to disk immediately to ensure persistence!
-                tagfs_sync();
+                storage_sync();
                 deck_complete(entry, DECK_PREFIX_STORAGE, (void*)inode_id, RESULT_TYPE_VALUE);
                 kprintf("[STORAGE] Event %lu: created file inode=%lu with %u tags (synced to disk)\n",
                         event->id, inode_id, tag_count);
@@ -662,9 +1276,9 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_FILE_QUERY: {
             // Payload: [tag_count:4][operator:1][tags:Tag[]...]
-            uint32_t tag_count = *(uint32_t*)event->data;
-            uint8_t op = *(uint8_t*)(event->data + 4);
-            Tag* tags = (Tag*)(event->data + 8);
+            uint32_t tag_count = *(uint32_t*)payload;
+            uint8_t op = *(uint8_t*)(payload + 4);
+            Tag* tags = (Tag*)(payload + 8);
 
             // DEFENSIVE: Validate tag count
             if (tag_count == 0) {
@@ -719,8 +1333,8 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_FILE_TAG_ADD: {
             // Payload: [inode_id:8][tag:Tag]
-            uint64_t inode_id = *(uint64_t*)event->data;
-            Tag* tag = (Tag*)(event->data + 8);
+            uint64_t inode_id = *(uint64_t*)payload;
+            Tag* tag = (Tag*)(payload + 8);
 
             // DEFENSIVE: Validate inode ID
             if (inode_id == TAGFS_INVALID_INODE || inode_id == 0) {
@@ -739,7 +1353,7 @@ int storage_deck_process(RoutingEntry* entry) {
             int success = tagfs_add_tag(inode_id, tag);
             if (success) {
                 // PRODUCTION: Sync to disk after tag modification!
-                tagfs_sync();
+                storage_sync();
                 deck_complete(entry, DECK_PREFIX_STORAGE, 0, RESULT_TYPE_NONE);
                 kprintf("[STORAGE] Event %lu: added tag %s:%s to inode=%lu (synced to disk)\n",
                         event->id, tag->key, tag->value, inode_id);
@@ -753,8 +1367,8 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_FILE_TAG_REMOVE: {
             // Payload: [inode_id:8][key:32]
-            uint64_t inode_id = *(uint64_t*)event->data;
-            const char* key = (const char*)(event->data + 8);
+            uint64_t inode_id = *(uint64_t*)payload;
+            const char* key = (const char*)(payload + 8);
 
             // DEFENSIVE: Validate inode ID
             if (inode_id == TAGFS_INVALID_INODE || inode_id == 0) {
@@ -773,7 +1387,7 @@ int storage_deck_process(RoutingEntry* entry) {
             int success = tagfs_remove_tag(inode_id, key);
             if (success) {
                 // PRODUCTION: Sync to disk after tag modification!
-                tagfs_sync();
+                storage_sync();
                 deck_complete(entry, DECK_PREFIX_STORAGE, 0, RESULT_TYPE_NONE);
                 kprintf("[STORAGE] Event %lu: removed tag '%s' from inode=%lu (synced to disk)\n",
                         event->id, key, inode_id);
@@ -787,7 +1401,7 @@ int storage_deck_process(RoutingEntry* entry) {
 
         case EVENT_FILE_TAG_GET: {
             // Payload: [inode_id:8]
-            uint64_t inode_id = *(uint64_t*)event->data;
+            uint64_t inode_id = *(uint64_t*)payload;
 
             // DEFENSIVE: Validate inode ID
             if (inode_id == TAGFS_INVALID_INODE || inode_id == 0) {
@@ -834,12 +1448,43 @@ int storage_deck_process(RoutingEntry* entry) {
 
 DeckContext storage_deck_context;
 
+// Storage bursts (много мелких write) переполняли 128 слотов
+#define STORAGE_DECK_QUEUE_DEPTH 1024
+#define STORAGE_DECK_BATCH_SIZE  DECK_BATCH_MAX
+
+static int storage_deck_process_batch(RoutingEntry** entries, int count) {
+    StorageBatchState* batch = &storage_batch[smp_current_cpu()];
+    int succeeded = 0;
+
+    deck_hold_publish(entries, count);
+    batch->active = 1;
+    for (int i = 0; i < count; i++) {
+        if (storage_deck_process(entries[i])) {
+            succeeded++;
+        }
+    }
+    batch->active = 0;
+
+    // PRODUCTION: Один commit на весь batch
+    if (batch->sync_pending) {
+        batch->sync_pending = 0;
+        tagfs_commit();
+    }
+
+    // Только теперь результаты batch видны Guide / Execution
+    deck_publish_held(entries, count);
+    return succeeded;
+}
+
 void storage_deck_init(void) {
     deck_init(&storage_deck_context, "Storage", DECK_PREFIX_STORAGE, storage_deck_process);
+    deck_set_queue_depth(&storage_deck_context, STORAGE_DECK_QUEUE_DEPTH);
+    deck_set_batch_func(&storage_deck_context, storage_deck_process_batch, STORAGE_DECK_BATCH_SIZE);
 
     // Initialize FD table
-    memset(fd_table, 0, sizeof(fd_table));
+    fd_table_reset();
     spinlock_init(&fd_table_lock);
+    spinlock_init(&memory_deferred_lock);
     kprintf("[STORAGE] FD table initialized (%d slots)\n", MAX_OPEN_FILES);
 
     // NOTE: TagFS already initialized in main.c - don't reinitialize!
@@ -847,7 +1492,26 @@ void storage_deck_init(void) {
 }
 
 int storage_deck_run_once(void) {
-    return deck_run_once(&storage_deck_context);
+    // Завершённые async команды: block cache + SUSPENDED чтения обратно в Guide
+    block_queue_reap();
+
+    // Async чтения batch'а копятся в block queue и уходят на диск вместе -
+    // отсортированные по LBA и склеенные
+    block_queue_plug();
+    int processed = deck_run_once(&storage_deck_context);
+    block_queue_unplug();
+
+    // Очередь пуста - опрос диска (без IRQ14), read-ahead, background
+    // write-back block cache и checkpoint журнала
+    if (!processed) {
+        block_queue_poll();
+        if (!storage_readahead_idle()) {
+            storage_prefetch_idle();
+        }
+        block_cache_flush_idle();
+        tagfs_checkpoint_idle();
+    }
+    return processed;
 }
 
 void storage_deck_run(void) {
@@ -2,7 +2,16 @@
 #include "guide/guide.h"
 #include "execution/execution_deck.h"
 #include "decks/deck_interface.h"
+#include "decks/operations_memo.h"
+#include "decks/operations_cipher.h"
+#include "decks/operations_stream.h"
+#include "decks/hardware_timer.h"
+#include "clock.h"
+#include "serial.h"
+#include "virtio_net.h"
 #include "routing/routing_table.h"
+#include "stats/latency_stats.h"
+#include "trace.h"
 #include "klib.h"
 
 // ============================================================================
@@ -59,6 +68,9 @@ void eventdriven_system_init(void) {
     kprintf("[SYSTEM] Initializing execution deck...\n");
     execution_deck_init(&global_routing_table);
 
+    // 5. Latency histograms (TSC уже откалиброван clock_init())
+    latency_stats_init();
+
     global_event_system.initialized = 1;
 
     kprintf("\n");
@@ -113,20 +125,38 @@ void eventdriven_print_full_stats(void) {
     extern DeckContext hardware_deck_context;
     extern DeckContext network_deck_context;
 
-    kprintf("[DECK:Operations] processed=%lu errors=%lu\n",
+    uint64_t memo_hits = operations_deck_context.stats.memo_hits;
+    uint64_t memo_lookups = memo_hits + operations_deck_context.stats.memo_misses;
+    kprintf("[DECK:Operations] processed=%lu errors=%lu fused=%lu memo=%lu/%lu (%lu%%)\n",
             operations_deck_context.stats.events_processed,
-            operations_deck_context.stats.errors);
-    kprintf("[DECK:Storage] processed=%lu errors=%lu\n",
+            operations_deck_context.stats.errors,
+            operations_deck_context.stats.fused_steps,
+            memo_hits, memo_lookups,
+            memo_lookups ? memo_hits * 100 / memo_lookups : 0);
+    kprintf("[DECK:Storage] processed=%lu errors=%lu fused=%lu\n",
             storage_deck_context.stats.events_processed,
-            storage_deck_context.stats.errors);
-    kprintf("[DECK:Hardware] processed=%lu errors=%lu\n",
+            storage_deck_context.stats.errors,
+            storage_deck_context.stats.fused_steps);
+    kprintf("[DECK:Hardware] processed=%lu errors=%lu fused=%lu\n",
             hardware_deck_context.stats.events_processed,
-            hardware_deck_context.stats.errors);
-    kprintf("[DECK:Network] processed=%lu errors=%lu\n",
+            hardware_deck_context.stats.errors,
+            hardware_deck_context.stats.fused_steps);
+    kprintf("[DECK:Network] processed=%lu errors=%lu fused=%lu\n",
             network_deck_context.stats.events_processed,
-            network_deck_context.stats.errors);
+            network_deck_context.stats.errors,
+            network_deck_context.stats.fused_steps);
+    virtio_net_print_stats();
 
     execution_deck_print_stats();
+    latency_stats_print();
+    result_buffer_print_stats();
+    operations_memo_print_stats();
+    cipher_key_cache_print_stats();
+    operations_stream_print_stats();
+    hardware_timer_print_stats();
+    clock_print_stats();
+    serial_print_stats();
+    trace_print_stats();
 
     kprintf("============================================================\n");
     kprintf("\n");
@@ -2,6 +2,10 @@
 #include "process.h"
 #include "klib.h"
 #include "workflow.h"  // For workflow_on_event_completed() callback
+#include "routing_pool.h"  // ROUTING_POOL_CACHE_EXECUTION
+#include "trace.h"  // Hot path trace points
+#include "latency_stats.h"  // Execution queue/service + end-to-end
+#include "result_buffer.h"  // RESULT_TYPE_BUFFER cleanup
 
 // ============================================================================
 // GLOBAL STATE
@@ -11,6 +15,10 @@ ExecutionStats execution_stats;
 static RoutingTable* routing_table = 0;
 static DeckQueue* execution_queue = 0;
 
+// Backpressure: parked results (per-process FIFO в process_t)
+static spinlock_t execution_overflow_lock;
+static volatile uint64_t execution_overflow_total = 0;  // Parked по всем процессам
+
 // ============================================================================
 // INITIALIZATION
 // ============================================================================
@@ -34,6 +42,10 @@ void execution_deck_init(RoutingTable* rtable) {
     execution_stats.events_executed = 0;
     execution_stats.responses_sent = 0;
     execution_stats.errors = 0;
+    execution_stats.batches = 0;
+    execution_stats.completion_irqs = 0;
+    execution_stats.results_parked = 0;
+    spinlock_init(&execution_overflow_lock);
 
     kprintf("[EXECUTION] Initialized\n");
 }
@@ -63,6 +75,7 @@ static void collect_results(RoutingEntry* entry, RingResult* result) {
     result->status = entry->abort_flag ? entry->error_code : 0;
     result->error_code = entry->error_code;
     result->result_size = 0;
+    *(uint64_t*)result->result = 0;  // Слот переиспользуется: VALUE 0 (EOF) != старые данные
 
     // Collect results from decks
     int result_index = -1;
@@ -85,112 +98,506 @@ static void collect_results(RoutingEntry* entry, RingResult* result) {
         // Copy deck result to RingResult
         void* deck_result = entry->deck_results[result_index];
 
-        // Copy pointer value to result (simplified for now)
-        *(void**)result->result = deck_result;
-        result->result_size = sizeof(void*);
+        if (entry->result_types[result_index] == RESULT_TYPE_BUFFER) {
+            // BUFFER (FILE_READ, NET_RECV, operations): данные копируем в слот -
+            // буфер освобождается после publish, указатель ядра user'у не нужен.
+            // Больше слота - только через registered buffer, иначе ошибка
+            ResultBuffer* buffer = (ResultBuffer*)deck_result;
+            if (buffer->size > sizeof(result->result)) {
+                result->status = ERROR_OP_BUFFER_TOO_SMALL;
+                result->error_code = ERROR_OP_BUFFER_TOO_SMALL;
+            } else {
+                memcpy(result->result, buffer->data, buffer->size);
+                result->result_size = (uint32_t)buffer->size;
+            }
+        } else {
+            // Значение или указатель (legacy ABI: result_data в первых 8 байтах)
+            *(void**)result->result = deck_result;
+            result->result_size = sizeof(void*);
+        }
 
-        kprintf("[EXECUTION] Collected result from deck at index %d for event %lu\n",
-                result_index, entry->event_id);
+        TRACE_INFO(TRACE_RESULT_COLLECT, entry->event_id, result_index);
     } else {
-        kprintf("[EXECUTION] No results for event %lu\n", entry->event_id);
+        TRACE_INFO(TRACE_RESULT_COLLECT, entry->event_id, (uint64_t)-1);
     }
 }
 
 // ============================================================================
-// EVENT PROCESSING
+// RESULT RING FORMATS
+// ============================================================================
+//
+// FIXED:   RingResult по 576 байт, позиции в слотах (RESULT_RING_SIZE)
+// COMPACT: CompactResult записи, позиции в 64-байтных units; результат-
+//          значение занимает одну cache line вместо девяти, данные BUFFER -
+//          столько units, сколько нужно.
+// Оба формата имеют общий header (head/tail), поэтому publish один и тот же.
+//
 // ============================================================================
 
-static void process_completed_event(RoutingEntry* entry) {
-    // DEFENSIVE: Validate entry
-    if (!entry) {
-        kprintf("[EXECUTION] ERROR: process_completed_event called with NULL entry\n");
-        atomic_increment_u64((volatile uint64_t*)&execution_stats.errors);
+// Свободное место после tail (FIXED: слоты, COMPACT: units)
+static uint64_t execution_ring_space(process_t* proc) {
+    ResultRing* ring = (ResultRing*)proc->result_ring;
+    uint64_t used = ring->tail - ring->head;
+
+    // DEFENSIVE: head пишет user
+    if (used > proc->result_ring_units) {
+        return 0;
+    }
+    return proc->result_ring_units - used;
+}
+
+// Units типичной записи результата (значение/указатель). Запись с данными
+// BUFFER длиннее: если не поместится, результат уйдёт в overflow
+static uint64_t execution_result_units(process_t* proc) {
+    if (proc->ring_format != PROCESS_RING_FORMAT_COMPACT) {
+        return 1;
+    }
+    return wf_compact_units(sizeof(CompactResult) + sizeof(void*));
+}
+
+// Записать RingResult по позиции tail + offset. Возвращает занятые units
+// (с PAD при wrap) или 0, если места нет
+static uint64_t execution_ring_put(process_t* proc, uint64_t offset, const RingResult* result) {
+    if (proc->ring_format != PROCESS_RING_FORMAT_COMPACT) {
+        if (execution_ring_space(proc) <= offset) {
+            return 0;
+        }
+        memcpy(wf_result_ring_slot((ResultRing*)proc->result_ring, offset), result,
+               sizeof(RingResult));
+        return 1;
+    }
+
+    CompactRing* ring = (CompactRing*)proc->result_ring;
+    uint32_t status = result->status;
+    uint32_t error_code = result->error_code;
+    uint32_t result_size = result->result_size;
+    uint64_t max_size = (uint64_t)proc->ring_max_entry_units * COMPACT_UNIT_SIZE - sizeof(CompactResult);
+    if (result_size > max_size) {
+        // Больше согласованного максимума записи: не обрезаем молча, а
+        // отдаём ошибку (данные такого размера - через registered buffer)
+        status = ERROR_OP_BUFFER_TOO_SMALL;
+        error_code = ERROR_OP_BUFFER_TOO_SMALL;
+        result_size = 0;
+    }
+    uint32_t units = (uint32_t)wf_compact_units(sizeof(CompactResult) + result_size);
+
+    uint64_t pad = 0;
+    CompactResult* record = (CompactResult*)wf_compact_reserve(ring, proc->result_ring_units,
+                                                              ring->tail + offset, ring->head,
+                                                              units, &pad);
+    if (!record) {
+        return 0;
+    }
+
+    record->header.units = (uint16_t)units;
+    record->header.flags = 0;
+    record->header.type = status;
+    record->event_id = result->event_id;
+    record->workflow_id = result->workflow_id;
+    record->completion_time = result->completion_time;
+    record->error_code = error_code;
+    record->result_size = result_size;
+    memcpy(record->result, result->result, result_size);
+    return pad + units;
+}
+
+// ============================================================================
+// BATCH DELIVERY
+// ============================================================================
+//
+// Execution Deck снимает до EXECUTION_BATCH_SIZE entries за раз:
+//   1. stage   - RingResult пишется прямо в слот ResultRing получателя
+//   2. publish - один сдвиг tail на процесс, completion_ready получателям
+//                и один INT 0x81 на весь batch
+//   3. finish  - workflow callback, cleanup результатов, release entry
+// Workflow из 100 событий = несколько прерываний вместо 100.
+//
+// ============================================================================
+
+#define EXECUTION_BATCH_SIZE   32
+#define EXECUTION_MAX_TARGETS  8     // Разных процессов за один publish
+#define EXECUTION_MAX_WAKE_KEYS 4    // Разных workflow на процесс (иначе wake "любой")
+
+typedef struct {
+    process_t* proc;
+    ResultRing* ring;                // COMPACT: CompactRing* (общий header)
+    uint64_t staged;                 // Записано в слоты, tail ещё не сдвинут
+    uint64_t staged_units;           // Сдвиг tail для staged (FIXED: = staged)
+    uint64_t published;              // Уже видно userspace в этом batch
+    uint64_t workflow_ids[EXECUTION_MAX_WAKE_KEYS];
+    uint32_t workflow_count;         // > MAX = будить по pid без workflow
+} ExecutionTarget;
+
+typedef struct {
+    ExecutionTarget targets[EXECUTION_MAX_TARGETS];
+    uint32_t target_count;
+} ExecutionBatch;
+
+// Получатель результата события: владелец, зафиксированный при ingestion.
+// Kernel-side события без владельца идут текущему процессу (как раньше)
+static process_t* execution_resolve_owner(RoutingEntry* entry) {
+    process_t* proc = (process_t*)entry->result_owner;
+
+    if (!proc) {
+        return process_get_current();
+    }
+
+    // DEFENSIVE: процесс мог умереть, а слот таблицы - достаться другому
+    if (proc->pid != entry->result_pid || proc->state == PROCESS_STATE_ZOMBIE ||
+        proc->result_ring != entry->result_ring) {
+        kprintf("[EXECUTION] Owner PID=%lu of event %lu is gone, dropping result\n",
+                entry->result_pid, entry->event_id);
+        return 0;
+    }
+
+    return proc;
+}
+
+static ExecutionTarget* execution_batch_find(ExecutionBatch* batch, process_t* proc) {
+    for (uint32_t i = 0; i < batch->target_count; i++) {
+        if (batch->targets[i].proc == proc) {
+            return &batch->targets[i];
+        }
+    }
+
+    if (batch->target_count >= EXECUTION_MAX_TARGETS) {
+        return 0;
+    }
+
+    ExecutionTarget* target = &batch->targets[batch->target_count++];
+    target->proc = proc;
+    target->ring = (ResultRing*)proc->result_ring;
+    target->staged = 0;
+    target->staged_units = 0;
+    target->published = 0;
+    target->workflow_count = 0;
+    return target;
+}
+
+// Запомнить workflow для targeted wakeup (scheduler wait queue)
+static void execution_target_add_workflow(ExecutionTarget* target, uint64_t workflow_id) {
+    for (uint32_t i = 0; i < target->workflow_count && i < EXECUTION_MAX_WAKE_KEYS; i++) {
+        if (target->workflow_ids[i] == workflow_id) {
+            return;
+        }
+    }
+    if (target->workflow_count < EXECUTION_MAX_WAKE_KEYS) {
+        target->workflow_ids[target->workflow_count] = workflow_id;
+    }
+    if (target->workflow_count <= EXECUTION_MAX_WAKE_KEYS) {
+        target->workflow_count++;
+    }
+}
+
+static void execution_target_flush(ExecutionTarget* target) {
+    if (target->staged == 0) {
+        return;
+    }
+    wf_result_ring_publish(target->ring, target->staged_units);
+    target->published += target->staged;
+    target->staged = 0;
+    target->staged_units = 0;
+}
+
+// Сделать staged results видимыми и разбудить получателей (один IRQ).
+// already_notified - процессы, получившие wake вне batch (flush overflow)
+static void execution_batch_publish(ExecutionBatch* batch, uint32_t already_notified) {
+    extern void scheduler_notify_completion(uint64_t pid, uint64_t workflow_id);
+    uint32_t notified = already_notified;
+    uint64_t results = 0;
+
+    for (uint32_t i = 0; i < batch->target_count; i++) {
+        ExecutionTarget* target = &batch->targets[i];
+        execution_target_flush(target);
+
+        if (target->published > 0) {
+            results += target->published;
+            atomic_add_u64((volatile uint64_t*)&execution_stats.responses_sent, target->published);
+            atomic_store_u32(&target->proc->completion_ready, 1);
+
+            if (target->workflow_count > EXECUTION_MAX_WAKE_KEYS) {
+                scheduler_notify_completion(target->proc->pid, 0);
+            } else {
+                for (uint32_t w = 0; w < target->workflow_count; w++) {
+                    scheduler_notify_completion(target->proc->pid, target->workflow_ids[w]);
+                }
+            }
+            notified++;
+        }
+    }
+    batch->target_count = 0;
+
+    if (notified == 0) {
+        return;
+    }
+
+    // INT 0x81 is REQUIRED to wake process from hlt instruction!
+    // completion_irq_handler будит только процессы с записанным ключом
+    TRACE_INFO(TRACE_RESULT_PUBLISH, notified, results);
+    atomic_increment_u64((volatile uint64_t*)&execution_stats.completion_irqs);
+    asm volatile("int $0x81");
+}
+
+// ============================================================================
+// BACKPRESSURE: result credits + overflow
+// ============================================================================
+//
+// Каждое ingested событие с владельцем занимает credit (results_outstanding).
+// Submission принимает событие, только пока outstanding + parked меньше
+// свободных слотов ResultRing (execution_deck_result_credit).
+// Если ring всё же полон (kernel-side события, user не читает) - результат
+// паркуется в per-process FIFO и дописывается, когда user сдвинет head.
+// Никаких ожиданий на cpu_pause() в Execution Deck.
+//
+// ============================================================================
+
+typedef struct ExecutionOverflow {
+    struct ExecutionOverflow* next;
+    uint8_t result[sizeof(RingResult)];     // kmalloc не гарантирует aligned(64)
+} ExecutionOverflow;
+
+static int execution_overflow_park(process_t* proc, RingResult* result) {
+    ExecutionOverflow* node = (ExecutionOverflow*)kmalloc(sizeof(ExecutionOverflow));
+    if (!node) {
+        return 0;
+    }
+    node->next = 0;
+    memcpy(node->result, result, sizeof(RingResult));
+
+    spin_lock(&execution_overflow_lock);
+    if (proc->result_overflow_tail) {
+        ((ExecutionOverflow*)proc->result_overflow_tail)->next = node;
+    } else {
+        proc->result_overflow_head = node;
+    }
+    proc->result_overflow_tail = node;
+    proc->result_overflow_count++;
+    atomic_increment_u64(&execution_overflow_total);
+    spin_unlock(&execution_overflow_lock);
+
+    atomic_increment_u64((volatile uint64_t*)&execution_stats.results_parked);
+    return 1;
+}
+
+uint32_t execution_deck_flush_overflow(process_t* proc) {
+    if (!proc || !proc->result_ring || proc->result_overflow_count == 0) {
+        return 0;
+    }
+
+    ResultRing* ring = (ResultRing*)proc->result_ring;
+    uint64_t written = 0;
+    uint64_t written_units = 0;
+
+    spin_lock(&execution_overflow_lock);
+
+    while (proc->result_overflow_head) {
+        ExecutionOverflow* node = (ExecutionOverflow*)proc->result_overflow_head;
+        uint64_t used = execution_ring_put(proc, written_units, (RingResult*)node->result);
+        if (used == 0) {
+            break;  // Ring снова полон
+        }
+
+        proc->result_overflow_head = node->next;
+        if (!node->next) {
+            proc->result_overflow_tail = 0;
+        }
+        proc->result_overflow_count--;
+        atomic_decrement_u64(&execution_overflow_total);
+
+        written++;
+        written_units += used;
+        kfree(node);
+    }
+
+    if (written > 0) {
+        wf_result_ring_publish(ring, written_units);
+    }
+
+    spin_unlock(&execution_overflow_lock);
+
+    if (written == 0) {
+        return 0;
+    }
+
+    extern void scheduler_notify_completion(uint64_t pid, uint64_t workflow_id);
+    atomic_add_u64((volatile uint64_t*)&execution_stats.responses_sent, written);
+    atomic_store_u32(&proc->completion_ready, 1);
+    scheduler_notify_completion(proc->pid, 0);
+
+    kprintf("[EXECUTION] Flushed %lu parked result(s) to PID=%lu\n", written, proc->pid);
+    return (uint32_t)written;
+}
+
+void execution_deck_drop_overflow(process_t* proc) {
+    if (!proc) {
         return;
     }
 
-    // Get current running process
-    process_t* proc = process_get_current();
+    spin_lock(&execution_overflow_lock);
+    ExecutionOverflow* node = (ExecutionOverflow*)proc->result_overflow_head;
+    uint32_t dropped = proc->result_overflow_count;
+    proc->result_overflow_head = 0;
+    proc->result_overflow_tail = 0;
+    proc->result_overflow_count = 0;
+    for (uint32_t i = 0; i < dropped; i++) {
+        atomic_decrement_u64(&execution_overflow_total);
+    }
+    spin_unlock(&execution_overflow_lock);
+
+    while (node) {
+        ExecutionOverflow* next = node->next;
+        kfree(node);
+        node = next;
+    }
+}
+
+uint64_t execution_deck_result_credit(process_t* proc) {
+    if (!proc || !proc->result_ring) {
+        return 0;
+    }
+
+    // Credit = результат в худшем случае: COMPACT запись плюс PAD при wrap
+    uint64_t record_units = execution_result_units(proc);
+    uint64_t space = execution_ring_space(proc);
+    space = space > record_units - 1 ? (space - (record_units - 1)) / record_units : 0;
+
+    uint64_t used = atomic_load_u64(&proc->results_outstanding) + proc->result_overflow_count;
+    return space > used ? space - used : 0;
+}
+
+// Процессы с parked results (только если они вообще есть)
+static uint32_t execution_flush_all_overflow(void) {
+    if (atomic_load_u64(&execution_overflow_total) == 0) {
+        return 0;
+    }
+
+    uint32_t flushed_procs = 0;
+    for (int i = 0; i < PROCESS_MAX_COUNT; i++) {
+        process_t* proc = process_get_by_index(i);
+        if (proc && proc->result_overflow_count > 0 && execution_deck_flush_overflow(proc)) {
+            flushed_procs++;
+        }
+    }
+    return flushed_procs;
+}
+
+// Записать результат после staged (без сдвига tail). 0 = ring полон
+static int execution_target_stage(ExecutionTarget* target, RoutingEntry* entry) {
+    process_t* proc = target->proc;
+
+    // Ring полон - сначала отдаём уже записанное userspace
+    if (execution_ring_space(proc) < target->staged_units + execution_result_units(proc)) {
+        execution_target_flush(target);
+    }
+
+    if (proc->ring_format != PROCESS_RING_FORMAT_COMPACT) {
+        // FIXED: RingResult собирается прямо в слоте ResultRing
+        if (execution_ring_space(proc) <= target->staged_units) {
+            return 0;
+        }
+        collect_results(entry, wf_result_ring_slot(target->ring, target->staged_units));
+        target->staged++;
+        target->staged_units++;
+        return 1;
+    }
+
+    // COMPACT: собираем на стеке и кодируем в запись нужной длины
+    RingResult result;
+    collect_results(entry, &result);
+    uint64_t used = execution_ring_put(proc, target->staged_units, &result);
+    if (used == 0) {
+        return 0;
+    }
+    target->staged++;
+    target->staged_units += used;
+    return 1;
+}
+
+// Записать результат в ResultRing получателя (без сдвига tail)
+static int execution_stage_result(ExecutionBatch* batch, RoutingEntry* entry) {
+    process_t* proc = execution_resolve_owner(entry);
 
     if (!proc) {
-        kprintf("[EXECUTION] ERROR: No current process for event %lu\n", entry->event_id);
+        kprintf("[EXECUTION] ERROR: No owner process for event %lu\n", entry->event_id);
         atomic_increment_u64((volatile uint64_t*)&execution_stats.errors);
-        return;
+        return 0;
     }
 
+    // Событие больше не "в полёте" (если результат не дойдёт - credit
+    // всё равно вернёт release entry)
+    routing_entry_return_credit(entry);
+
     if (!proc->result_ring) {
         kprintf("[EXECUTION] ERROR: Process PID=%lu has no ResultRing for event %lu\n",
                 proc->pid, entry->event_id);
         atomic_increment_u64((volatile uint64_t*)&execution_stats.errors);
-        return;
+        return 0;
     }
 
-    ResultRing* result_ring = (ResultRing*)proc->result_ring;
+    ExecutionTarget* target = execution_batch_find(batch, proc);
+    if (!target) {
+        // Слишком много получателей в одном batch - публикуем досрочно
+        execution_batch_publish(batch, 0);
+        target = execution_batch_find(batch, proc);
+    }
+
+    // FIFO: пока есть parked results, новые тоже идут в overflow
+    if (proc->result_overflow_count == 0 && execution_target_stage(target, entry)) {
+        execution_target_add_workflow(target, entry->event_copy.user_id);  // user_id = workflow_id
+
+        TRACE_INFO(TRACE_RESULT_STAGE, entry->event_id, proc->pid);
+        return 1;
+    }
 
-    // 1. Collect results from decks
     RingResult result;
     collect_results(entry, &result);
 
-    // 2. Push result to ResultRing (kernel → user)
-    // CRITICAL: Add timeout to prevent infinite busy-wait deadlock!
-    int push_attempts = 0;
-    const int MAX_PUSH_ATTEMPTS = 10000;  // ~10ms worst case with cpu_pause
-
-    while (!wf_result_ring_push(result_ring, &result)) {
-        if (++push_attempts >= MAX_PUSH_ATTEMPTS) {
-            kprintf("[EXECUTION] ERROR: ResultRing full after %d attempts for event %lu! (PID=%lu)\n",
-                    MAX_PUSH_ATTEMPTS, entry->event_id, proc->pid);
-            kprintf("[EXECUTION]   This means user is not reading results fast enough!\n");
-            atomic_increment_u64((volatile uint64_t*)&execution_stats.errors);
-            return;  // Drop result to prevent deadlock
-        }
-        cpu_pause();  // Yield CPU while waiting
+    if (!execution_overflow_park(proc, &result)) {
+        kprintf("[EXECUTION] ERROR: ResultRing full and no memory to park event %lu (PID=%lu)\n",
+                entry->event_id, proc->pid);
+        atomic_increment_u64((volatile uint64_t*)&execution_stats.errors);
+        return 0;
     }
 
-    atomic_increment_u64((volatile uint64_t*)&execution_stats.responses_sent);
-
-    kprintf("[EXECUTION] Sent result for event %lu to user space\n", entry->event_id);
+    kprintf("[EXECUTION] %[W]ResultRing full, parked event %lu (PID=%lu, parked=%u)%[D]\n",
+            entry->event_id, proc->pid, proc->result_overflow_count);
+    return 1;
+}
 
-    // 3. Send completion IRQ to wake up waiting process
-    // INT 0x81 is REQUIRED to wake process from hlt instruction!
-    // The interrupt will:
-    //   1. Call completion_irq_handler
-    //   2. Set completion_ready flag
-    //   3. Wake process from hlt (if waiting)
-    kprintf("[EXECUTION] Sending completion IRQ (INT 0x81)\n");
-    asm volatile("int $0x81");
+// ============================================================================
+// EVENT PROCESSING
+// ============================================================================
 
+// Результат уже опубликован - workflow callback, cleanup, release
+static void execution_finish_event(RoutingEntry* entry) {
     // 4. NOTIFY WORKFLOW SYSTEM - CRITICAL INTEGRATION POINT!
     // This callback enables automatic DAG dependency resolution
-    uint64_t workflow_id = entry->event_copy.user_id;  // user_id contains workflow_id
+    // workflow_tag: instance + node (0 = не workflow node - callback сразу выходит)
     uint64_t event_id = entry->event_id;
 
     // Find the deck result (last non-null result)
     void* deck_result = 0;
     uint64_t deck_result_size = 0;
+    ResultType deck_result_type = RESULT_TYPE_NONE;
     for (int i = MAX_ROUTING_STEPS - 1; i >= 0; i--) {
         if (entry->deck_results[i] != 0) {
             deck_result = entry->deck_results[i];
-            // Size is not tracked currently, TODO: add result_size tracking
-            deck_result_size = sizeof(void*);  // Placeholder
+            deck_result_type = (ResultType)entry->result_types[i];
+
+            // ResultBuffer знает свой размер; остальные типы - указатель/значение
+            deck_result_size = deck_result_type == RESULT_TYPE_BUFFER
+                             ? ((ResultBuffer*)deck_result)->size : sizeof(void*);
             break;
         }
     }
 
-    // Copy result for workflow (workflow takes ownership)
-    void* result_copy = 0;
-    if (deck_result != 0) {
-        // CRITICAL: We make a SHALLOW copy (just the pointer)
-        // The actual data ownership transfers to workflow
-        // Workflow will be responsible for cleanup
-        result_copy = deck_result;
-        kprintf("[EXECUTION] Transferring result %p to workflow %lu\n",
-                result_copy, workflow_id);
-    }
-
     // Call workflow callback (this may trigger new events!)
+    // CRITICAL: SHALLOW transfer - workflow забирает сам указатель (BUFFER: нашу ссылку)
     int32_t error_code = entry->abort_flag ? entry->error_code : 0;
-    workflow_on_event_completed(workflow_id, event_id,
-                                 result_copy, deck_result_size, error_code);
+    int transferred = workflow_on_event_completed(entry->workflow_tag, event_id,
+                                                  deck_result, deck_result_size,
+                                                  deck_result_type, error_code);
+    void* result_copy = transferred ? deck_result : 0;
 
     // 5. DECK RESULT CLEANUP - Now properly implemented!
     // Use result_types array to determine how to cleanup each result
@@ -205,8 +612,6 @@ static void process_completed_event(RoutingEntry* entry) {
 
         // Skip the result that was transferred to workflow (ownership transferred)
         if (deck_result == result_copy) {
-            kprintf("[EXECUTION] Skipping cleanup for result %p (transferred to workflow)\n",
-                    deck_result);
             continue;
         }
 
@@ -214,7 +619,7 @@ static void process_completed_event(RoutingEntry* entry) {
             case RESULT_TYPE_KMALLOC:
                 // Allocated via kmalloc - free it
                 kfree(deck_result);
-                kprintf("[EXECUTION] Freed kmalloc result at %p (deck %d)\n", deck_result, i);
+                TRACE_DEBUG(TRACE_RESULT_FREE, event_id, i);
                 break;
 
             case RESULT_TYPE_VALUE:
@@ -225,6 +630,12 @@ static void process_completed_event(RoutingEntry* entry) {
                 // Static data or stack pointer - no cleanup needed
                 break;
 
+            case RESULT_TYPE_BUFFER:
+                // Reference-counted - successor node мог ещё держать ссылку
+                result_buffer_release((ResultBuffer*)deck_result);
+                TRACE_DEBUG(TRACE_RESULT_FREE, event_id, i);
+                break;
+
             case RESULT_TYPE_MEMORY_MAPPED:
                 // Memory-mapped region - TODO: implement unmap
                 // For now, leave mapped (will be freed with process cleanup)
@@ -248,7 +659,9 @@ static void process_completed_event(RoutingEntry* entry) {
         return;
     }
 
-    routing_table_remove(routing_table, entry->event_id);
+    // Detach + release в собственный pool cache Execution Deck
+    routing_table_release_entry(routing_table_detach(routing_table, entry->event_id),
+                                ROUTING_POOL_CACHE_EXECUTION);
 
     atomic_increment_u64((volatile uint64_t*)&execution_stats.events_executed);
 }
@@ -257,7 +670,7 @@ static void process_completed_event(RoutingEntry* entry) {
 // MAIN LOOP
 // ============================================================================
 
-// Обработать одно завершённое событие (для синхронной обработки)
+// Обработать batch завершённых событий. Возвращает количество entries
 int execution_deck_run_once(void) {
     // DEFENSIVE: Validate execution queue
     if (!execution_queue) {
@@ -266,22 +679,55 @@ int execution_deck_run_once(void) {
         return 0;
     }
 
-    // Получаем завершённое событие от Guide
-    RoutingEntry* entry = deck_queue_pop(execution_queue);
+    ExecutionBatch batch;
+    batch.target_count = 0;
+
+    // 0. Backpressure: user мог сдвинуть head - дописать parked results первыми
+    uint32_t overflow_notified = execution_flush_all_overflow();
+
+    // Получаем завершённые события от Guide
+    RoutingEntry* entries[EXECUTION_BATCH_SIZE];
+    uint32_t count = deck_queue_pop_batch(execution_queue, entries, EXECUTION_BATCH_SIZE);
 
-    if (entry) {
+    if (count == 0) {
+        if (overflow_notified > 0) {
+            execution_batch_publish(&batch, overflow_notified);
+        }
+        return 0;  // Очередь пуста
+    }
+
+    // 1. Stage: results во все ResultRings
+    uint64_t started_at = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
         // DEFENSIVE: Validate entry before processing
-        if (entry->event_id == 0) {
+        if (!entries[i] || entries[i]->event_id == 0) {
             kprintf("[EXECUTION] WARNING: Popped entry with event_id=0\n");
             atomic_increment_u64((volatile uint64_t*)&execution_stats.errors);
-            return 0;
+            entries[i] = 0;
+            continue;
+        }
+        execution_stage_result(&batch, entries[i]);
+    }
+
+    // 2. Publish: один tail update на процесс, один IRQ на batch
+    execution_batch_publish(&batch, overflow_notified);
+
+    uint64_t published_at = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        if (entries[i]) {
+            latency_stats_record_execution(entries[i], started_at, published_at);
         }
+    }
 
-        // Обрабатываем завершённое событие
-        process_completed_event(entry);
-        return 1;  // Обработано
+    // 3. Finish: workflow callbacks (могут породить новые события), cleanup
+    for (uint32_t i = 0; i < count; i++) {
+        if (entries[i]) {
+            execution_finish_event(entries[i]);
+        }
     }
-    return 0;  // Очередь пуста
+
+    atomic_increment_u64((volatile uint64_t*)&execution_stats.batches);
+    return (int)count;
 }
 
 void execution_deck_run(void) {
@@ -308,8 +754,11 @@ void execution_deck_run(void) {
 // ============================================================================
 
 void execution_deck_print_stats(void) {
-    kprintf("[EXECUTION] Stats: executed=%lu responses_sent=%lu errors=%lu\n",
+    kprintf("[EXECUTION] Stats: executed=%lu responses_sent=%lu errors=%lu batches=%lu irqs=%lu parked=%lu\n",
             execution_stats.events_executed,
             execution_stats.responses_sent,
-            execution_stats.errors);
+            execution_stats.errors,
+            execution_stats.batches,
+            execution_stats.completion_irqs,
+            execution_stats.results_parked);
 }
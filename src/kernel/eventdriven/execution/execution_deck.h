@@ -3,6 +3,7 @@
 
 #include "../core/events.h"
 #include "workflow_rings.h"
+#include "process.h"
 #include "../guide/guide.h"
 
 // ============================================================================
@@ -13,7 +14,8 @@
 // 1. Получает завершённые routing entries от Guide
 // 2. Собирает результаты от всех decks
 // 3. Формирует RingResult
-// 4. Отправляет RingResult в ResultRing (kernel→user)
+// 4. Отправляет RingResult в ResultRing (kernel→user) - batch'ами,
+//    один сдвиг tail и один completion IRQ на batch
 // 5. Очищает routing entry из таблицы
 //
 // ============================================================================
@@ -22,6 +24,9 @@ typedef struct {
     volatile uint64_t events_executed;
     volatile uint64_t responses_sent;
     volatile uint64_t errors;
+    volatile uint64_t batches;             // Вызовы run_once с непустой очередью
+    volatile uint64_t completion_irqs;     // INT 0x81 (не больше одного на batch)
+    volatile uint64_t results_parked;      // ResultRing был полон → overflow list
 } ExecutionStats;
 
 extern ExecutionStats execution_stats;
@@ -36,11 +41,26 @@ void execution_deck_init(RoutingTable* routing_table);
 // MAIN LOOP
 // ============================================================================
 
-// Обработать одно завершённое событие (для синхронной обработки)
+// Обработать batch завершённых событий (возвращает количество entries)
 int execution_deck_run_once(void);
 
 void execution_deck_run(void);
 
+// ============================================================================
+// BACKPRESSURE
+// ============================================================================
+
+// Сколько ещё событий процесс может отправить, не переполнив ResultRing
+// (свободные слоты минус события в полёте и parked results)
+uint64_t execution_deck_result_credit(process_t* proc);
+
+// Дописать parked results в освободившиеся слоты ResultRing.
+// Возвращает количество записанных results
+uint32_t execution_deck_flush_overflow(process_t* proc);
+
+// Освободить parked results (process_destroy)
+void execution_deck_drop_overflow(process_t* proc);
+
 // ============================================================================
 // STATS
 // ============================================================================
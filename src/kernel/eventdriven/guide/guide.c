@@ -1,5 +1,12 @@
 #include "guide.h"
 #include "klib.h"
+#include "process.h"
+#include "workflow_rings.h"
+#include "syscall.h"
+#include "scheduler.h"
+#include "workflow.h"
+#include "clock.h"
+#include "smp.h"
 
 // ============================================================================
 // GLOBAL STATE
@@ -8,6 +15,10 @@
 GuideStats guide_stats;
 GuideContext guide_context;
 
+static uint64_t sqpoll_idle_us = GUIDE_SQPOLL_IDLE_US_DEFAULT;
+static volatile uint32_t sqpoll_polling = 0;   // SQPOLL процессов на последнем проходе
+static volatile uint32_t sqpoll_pinned = 0;    // 1 = поллер крутится на своём AP
+
 // ============================================================================
 // INITIALIZATION
 // ============================================================================
@@ -16,7 +27,11 @@ void guide_init(RoutingTable* routing_table) {
     kprintf("[GUIDE] Initializing...\n");
 
     guide_context.routing_table = routing_table;
-    guide_context.scan_position = 0;
+
+    guide_context.ready_queue.head = 0;
+    guide_context.ready_queue.tail = 0;
+    guide_context.ready_queue.count = 0;
+    spinlock_init(&guide_context.ready_queue.lock);
 
     // Инициализируем все deck queues (НОВАЯ АРХИТЕКТУРА: 5 queues вместо 11)
     for (int i = 0; i < 5; i++) {
@@ -24,24 +39,186 @@ void guide_init(RoutingTable* routing_table) {
     }
 
     deck_queue_init(&guide_context.execution_queue);
+    guide_context.pinned_decks = 0;
 
     guide_stats.events_routed = 0;
     guide_stats.events_completed = 0;
     guide_stats.routing_iterations = 0;
+    guide_stats.ready_dispatched = 0;
+    guide_stats.ready_requeued = 0;
+    guide_stats.sqpoll_events = 0;
+    guide_stats.sqpoll_fallbacks = 0;
+    guide_stats.fused_passes = 0;
 
     kprintf("[GUIDE] Initialized (4 decks: OPERATIONS, STORAGE, HARDWARE, NETWORK)\n");
 }
 
+// ============================================================================
+// READY QUEUE
+// ============================================================================
+
+void guide_mark_ready(RoutingEntry* entry) {
+    GuideReadyQueue* queue = &guide_context.ready_queue;
+
+    spin_lock(&queue->lock);
+
+    if (!entry->ready_queued) {
+        entry->ready_queued = 1;
+        entry->ready_next = 0;
+
+        if (queue->tail) {
+            queue->tail->ready_next = entry;
+        } else {
+            queue->head = entry;
+        }
+        queue->tail = entry;
+        queue->count++;
+    }
+
+    spin_unlock(&queue->lock);
+}
+
+static RoutingEntry* guide_ready_pop(GuideReadyQueue* queue) {
+    spin_lock(&queue->lock);
+
+    RoutingEntry* entry = queue->head;
+    if (entry) {
+        queue->head = entry->ready_next;
+        if (!queue->head) {
+            queue->tail = 0;
+        }
+        queue->count--;
+
+        entry->ready_next = 0;
+        entry->ready_queued = 0;
+    }
+
+    spin_unlock(&queue->lock);
+    return entry;
+}
+
+// Один шаг маршрута для entry. Возвращает 0 если целевая очередь полна.
+static int guide_route_entry(GuideContext* ctx, RoutingEntry* entry) {
+    // SUSPENDED (timer), SUCCESS/ERROR (уже в Execution) - не трогаем.
+    // Timer/deck сами вернут entry в ready queue когда он сможет продолжить.
+    if (entry->state != EVENT_STATUS_PROCESSING) {
+        return 1;
+    }
+
+    // Получаем следующий prefix
+    uint8_t next_prefix = routing_entry_get_next_prefix(entry);
+
+    // CRITICAL: отметка до push - после push entry уже у consumer'а
+    entry->dispatched_at = rdtsc();
+
+    if (next_prefix == DECK_PREFIX_NONE) {
+        // Все префиксы обработаны! Отправляем в Execution Deck.
+        // state ставим до push - после push entry принадлежит Execution
+        entry->state = EVENT_STATUS_SUCCESS;
+        if (!deck_queue_push(&ctx->execution_queue, entry)) {
+            entry->state = EVENT_STATUS_PROCESSING;
+            return 0;
+        }
+        atomic_increment_u64((volatile uint64_t*)&guide_stats.events_completed);
+        return 1;
+    }
+
+    // Проверяем abort_flag - если установлен, пропускаем обработку
+    if (entry->abort_flag) {
+        // Прерываем обработку - пропускаем оставшиеся шаги и отправляем в Execution.
+        // Как и выше: route/state меняем до push, при полной очереди откатываем
+        uint8_t saved_index = entry->current_index;
+        routing_entry_abort_route(entry);
+        entry->state = EVENT_STATUS_ERROR;
+        if (!deck_queue_push(&ctx->execution_queue, entry)) {
+            entry->current_index = saved_index;
+            entry->state = EVENT_STATUS_PROCESSING;
+            return 0;
+        }
+        atomic_increment_u64((volatile uint64_t*)&guide_stats.events_completed);
+        return 1;
+    }
+
+    // Отправляем в соответствующий deck (НОВАЯ АРХИТЕКТУРА: префиксы 1-4)
+    if (next_prefix < 1 || next_prefix > 4) {
+        // DEFENSIVE: неизвестный prefix - прерываем, иначе entry застрянет навсегда
+        kprintf("[GUIDE] ERROR: Event %lu has invalid prefix %u, aborting\n",
+                entry->event_id, next_prefix);
+        atomic_store_u32(&entry->abort_flag, 1);
+        return guide_route_entry(ctx, entry);
+    }
+
+    if (!deck_queue_push(&ctx->deck_queues[next_prefix], entry)) {
+        return 0;
+    }
+
+    // НЕ затираем prefix! Deck сам затрет после обработки!
+    atomic_increment_u64((volatile uint64_t*)&guide_stats.events_routed);
+    return 1;
+}
+
+uint64_t guide_dispatch_ready(GuideContext* ctx) {
+    // Обрабатываем только то, что уже в очереди: requeue при полной deck queue
+    // не должен крутить этот цикл бесконечно
+    uint64_t budget = atomic_load_u64(&ctx->ready_queue.count);
+    uint64_t dispatched = 0;
+
+    while (budget-- > 0) {
+        RoutingEntry* entry = guide_ready_pop(&ctx->ready_queue);
+        if (!entry) {
+            break;
+        }
+
+        if (!guide_route_entry(ctx, entry)) {
+            // Очередь deck полна - попробуем на следующем проходе
+            guide_mark_ready(entry);
+            atomic_increment_u64((volatile uint64_t*)&guide_stats.ready_requeued);
+            continue;
+        }
+
+        dispatched++;
+    }
+
+    if (dispatched > 0) {
+        atomic_add_u64((volatile uint64_t*)&guide_stats.ready_dispatched, dispatched);
+    }
+
+    return dispatched;
+}
+
 // ============================================================================
 // MAIN LOOP
 // ============================================================================
 
 // Обёртка для синхронной обработки
 void guide_scan_and_dispatch(RoutingTable* routing_table) {
-    guide_scan_and_route(&guide_context);
+    (void)routing_table;
+    guide_dispatch_ready(&guide_context);
     atomic_increment_u64((volatile uint64_t*)&guide_stats.routing_iterations);
 }
 
+// Deck queues, затем Execution (decks со своим ядром - пропускаем)
+static void guide_run_decks(void) {
+    extern int operations_deck_run_once(void);
+    extern int storage_deck_run_once(void);
+    extern int hardware_deck_run_once(void);
+    extern int network_deck_run_once(void);
+    extern int execution_deck_run_once(void);
+
+    // Process all events in deck queues
+    if (!guide_deck_is_pinned(DECK_PREFIX_OPERATIONS)) while (operations_deck_run_once());
+    if (!guide_deck_is_pinned(DECK_PREFIX_STORAGE))    while (storage_deck_run_once());
+    if (!guide_deck_is_pinned(DECK_PREFIX_HARDWARE))   while (hardware_deck_run_once());
+    if (!guide_deck_is_pinned(DECK_PREFIX_NETWORK))    while (network_deck_run_once());
+
+    // PASS #2: Decks marked finished steps ready
+    // CRITICAL: This moves completed events to execution_queue!
+    guide_dispatch_ready(&guide_context);
+
+    // Process completed events (write results to ResultRing and send INT 0x81)
+    if (!guide_deck_is_pinned(GUIDE_DECK_EXECUTION)) while (execution_deck_run_once());
+}
+
 // Process all events in routing table (called from timer IRQ in background)
 void guide_process_all(void) {
     // ASYNC MODE: Called from timer IRQ every 100ms
@@ -53,33 +230,29 @@ void guide_process_all(void) {
         debug_once = 0;
     }
 
-    // SCAN #1: Find new events and route to deck queues
-    // ROUTING_TABLE_SIZE = 64, so we need 4 calls to scan all buckets (16 per call)
-    for (int i = 0; i < 4; i++) {
-        guide_scan_and_route(&guide_context);
+    // SQPOLL: Pick up events published without kernel_notify(SUBMIT).
+    // Только без своего AP - иначе поллер уже забрал их сам
+    if (!atomic_load_u32(&sqpoll_pinned)) {
+        guide_sqpoll_poll();
     }
 
-    // Process events in each deck queue
-    extern int operations_deck_run_once(void);
-    extern int storage_deck_run_once(void);
-    extern int hardware_deck_run_once(void);
-    extern int network_deck_run_once(void);
-    extern int execution_deck_run_once(void);
+    // PASS #1: Route new/advanced events from ready queue to deck queues
+    guide_dispatch_ready(&guide_context);
 
-    // Process all events in deck queues
-    while (operations_deck_run_once());
-    while (storage_deck_run_once());
-    while (hardware_deck_run_once());
-    while (network_deck_run_once());
+    guide_run_decks();
 
-    // SCAN #2: Find completed events (after decks cleared prefixes)
-    // CRITICAL: This moves completed events to execution_queue!
-    for (int i = 0; i < 4; i++) {
-        guide_scan_and_route(&guide_context);
+    // PASS #3: fused workflow chains (workflow_optimize) - successor, который
+    // Execution Deck только что отправил, проходит свой deck сейчас, а не
+    // на следующем tick
+    for (int pass = 0; pass < GUIDE_FUSED_PASSES && workflow_take_fused(); pass++) {
+        guide_dispatch_ready(&guide_context);
+        guide_run_decks();
+        atomic_increment_u64((volatile uint64_t*)&guide_stats.fused_passes);
     }
 
-    // Process completed events (write results to ResultRing and send INT 0x81)
-    while (execution_deck_run_once());
+    // Grace period routing table: entries и массивы, которые уже не может
+    // держать ни один lock-free lookup, - обратно в pool
+    routing_table_reclaim(guide_context.routing_table);
 
     atomic_increment_u64((volatile uint64_t*)&guide_stats.routing_iterations);
 }
@@ -90,8 +263,8 @@ void guide_run(void) {
     uint64_t iterations = 0;
 
     while (1) {
-        // Сканируем routing table и маршрутизируем события
-        guide_scan_and_route(&guide_context);
+        // Маршрутизируем события, готовые к следующему шагу
+        guide_dispatch_ready(&guide_context);
 
         atomic_increment_u64((volatile uint64_t*)&guide_stats.routing_iterations);
 
@@ -106,6 +279,130 @@ void guide_run(void) {
     }
 }
 
+// ============================================================================
+// SQPOLL
+// ============================================================================
+
+void guide_set_sqpoll_idle_us(uint64_t us) {
+    sqpoll_idle_us = us ? us : GUIDE_SQPOLL_IDLE_US_DEFAULT;
+}
+
+void guide_set_sqpoll_pinned(int pinned) {
+    atomic_store_u32(&sqpoll_pinned, pinned ? 1 : 0);
+}
+
+// Один SQPOLL процесс под его event_ring_lock. Простой меряется по TSC
+// этого CPU (поллер всегда на одном и том же CPU) - не числом проходов
+static uint64_t guide_sqpoll_process(process_t* proc, uint64_t now, uint64_t idle_cycles,
+                                     uint32_t* polling) {
+    spin_lock(&proc->event_ring_lock);
+
+    // Процесс умирает: process_destroy отцепил ring под этим же lock
+    if (!atomic_load_u32(&proc->sqpoll_active) || !proc->event_ring ||
+        proc->state == PROCESS_STATE_ZOMBIE) {
+        atomic_store_u32(&proc->sqpoll_active, 0);
+        spin_unlock(&proc->event_ring_lock);
+        return 0;
+    }
+
+    EventRing* ring = (EventRing*)proc->event_ring;
+
+    if (proc->sqpoll_last_active == 0) {
+        proc->sqpoll_last_active = now;  // Только что включён (NOTIFY_SQPOLL)
+    }
+
+    if (!syscall_event_ring_pending(proc)) {
+        if (now - proc->sqpoll_last_active < idle_cycles) {
+            (*polling)++;
+            spin_unlock(&proc->event_ring_lock);
+            return 0;
+        }
+
+        // Idle слишком долго - переходим обратно на notify-режим
+        atomic_store_u32(&proc->sqpoll_active, 0);
+        atomic_store_u32(&ring->flags, ring->flags | EVENT_RING_FLAG_NEED_WAKEUP);
+        MEMORY_BARRIER();
+        atomic_increment_u64((volatile uint64_t*)&guide_stats.sqpoll_fallbacks);
+
+        // Race: user мог опубликовать событие до того, как увидел флаг
+        if (!syscall_event_ring_pending(proc)) {
+            spin_unlock(&proc->event_ring_lock);
+            return 0;
+        }
+    }
+
+    proc->sqpoll_last_active = now;
+
+    uint64_t n = syscall_ingest_event_ring_locked(proc, proc->sqpoll_workflow_id);
+    if (n > 0) {
+        // Процесс жив, даже если не делает syscall (watchdog)
+        proc->last_syscall_tick = scheduler_stats.total_ticks;
+    }
+    if (atomic_load_u32(&proc->sqpoll_active)) {
+        (*polling)++;
+    }
+
+    spin_unlock(&proc->event_ring_lock);
+    return n;
+}
+
+uint64_t guide_sqpoll_poll(void) {
+    uint64_t total = 0;
+    uint32_t polling = 0;
+
+    // clock_tsc_hz() после clock_init() только читается - годится и на AP
+    uint64_t tsc_hz = clock_tsc_hz() ? clock_tsc_hz() : CLOCK_TSC_HZ_FALLBACK;
+    uint64_t idle_cycles = tsc_hz / 1000000 * sqpoll_idle_us;
+    uint64_t now = rdtsc();
+
+    for (int i = 0; i < PROCESS_MAX_COUNT; i++) {
+        process_t* proc = process_get_by_index(i);
+
+        if (!proc || proc->pid == 0 || !atomic_load_u32(&proc->sqpoll_active)) {
+            continue;
+        }
+
+        total += guide_sqpoll_process(proc, now, idle_cycles, &polling);
+    }
+    sqpoll_polling = polling;
+
+    if (total > 0) {
+        atomic_add_u64((volatile uint64_t*)&guide_stats.sqpoll_events, total);
+    }
+
+    return total;
+}
+
+void guide_sqpoll_run(void) {
+    kprintf("[GUIDE] SQPOLL poller started on CPU %u\n", smp_current_cpu());
+
+    while (1) {
+        // Новые события ждут Guide в ready queue - BSP не ждёт срока tick
+        if (guide_sqpoll_poll() > 0) {
+            clock_event_kick();
+        } else {
+            cpu_pause();
+        }
+    }
+}
+
+int guide_has_pending(void) {
+    // SQPOLL процессы держат tick, только пока их поллит этот timer interrupt
+    if (guide_context.ready_queue.count > 0 ||
+        (!atomic_load_u32(&sqpoll_pinned) && sqpoll_polling > 0)) {
+        return 1;
+    }
+
+    // Очереди, которые крутит timer interrupt (pinned decks опрашивают себя сами)
+    for (uint8_t prefix = 1; prefix <= DECK_PREFIX_NETWORK; prefix++) {
+        if (!guide_deck_is_pinned(prefix) && !deck_queue_is_empty(&guide_context.deck_queues[prefix])) {
+            return 1;
+        }
+    }
+    return !guide_deck_is_pinned(GUIDE_DECK_EXECUTION) &&
+           !deck_queue_is_empty(&guide_context.execution_queue);
+}
+
 // ============================================================================
 // GETTERS
 // ============================================================================
@@ -122,13 +419,61 @@ DeckQueue* guide_get_execution_queue(void) {
     return &guide_context.execution_queue;
 }
 
+// ============================================================================
+// SMP PLACEMENT
+// ============================================================================
+
+void guide_set_deck_pinned(uint8_t deck_prefix, int pinned) {
+    if (deck_prefix > DECK_PREFIX_NETWORK) {
+        return;
+    }
+
+    uint32_t bit = 1u << deck_prefix;
+    uint32_t mask = atomic_load_u32(&guide_context.pinned_decks);
+    mask = pinned ? (mask | bit) : (mask & ~bit);
+    atomic_store_u32(&guide_context.pinned_decks, mask);
+}
+
+int guide_deck_is_pinned(uint8_t deck_prefix) {
+    if (deck_prefix > DECK_PREFIX_NETWORK) {
+        return 0;
+    }
+    return (atomic_load_u32(&guide_context.pinned_decks) >> deck_prefix) & 1;
+}
+
 // ============================================================================
 // STATISTICS
 // ============================================================================
 
+// Глубина lanes сейчас / пик (depth/peak), порядок - EVENT_PRIORITY_*
+static void guide_print_queue_lanes(const char* name, DeckQueue* queue) {
+    DeckLane* lanes = queue->lanes;
+    kprintf("[GUIDE] %s lanes: normal=%lu/%lu interactive=%lu/%lu bulk=%lu/%lu\n", name,
+            deck_lane_depth(&lanes[EVENT_PRIORITY_NORMAL]), lanes[EVENT_PRIORITY_NORMAL].max_depth,
+            deck_lane_depth(&lanes[EVENT_PRIORITY_INTERACTIVE]), lanes[EVENT_PRIORITY_INTERACTIVE].max_depth,
+            deck_lane_depth(&lanes[EVENT_PRIORITY_BULK]), lanes[EVENT_PRIORITY_BULK].max_depth);
+}
+
 void guide_print_stats(void) {
+    static const char* deck_names[] = { "Operations", "Storage", "Hardware", "Network" };
+
     kprintf("[GUIDE] Stats: routed=%lu completed=%lu iterations=%lu\n",
             guide_stats.events_routed,
             guide_stats.events_completed,
             guide_stats.routing_iterations);
+    kprintf("[GUIDE] Ready queue: pending=%lu dispatched=%lu requeued=%lu\n",
+            guide_context.ready_queue.count,
+            guide_stats.ready_dispatched,
+            guide_stats.ready_requeued);
+    kprintf("[GUIDE] SQPOLL: events=%lu fallbacks=%lu idle_us=%lu poller=%s\n",
+            guide_stats.sqpoll_events,
+            guide_stats.sqpoll_fallbacks,
+            sqpoll_idle_us,
+            sqpoll_pinned ? "AP" : "timer IRQ");
+    kprintf("[GUIDE] Fused workflow passes: %lu\n", guide_stats.fused_passes);
+
+    for (uint8_t prefix = 1; prefix <= DECK_PREFIX_NETWORK; prefix++) {
+        guide_print_queue_lanes(deck_names[prefix - 1], &guide_context.deck_queues[prefix]);
+    }
+    guide_print_queue_lanes("Execution", &guide_context.execution_queue);
 }
@@ -4,17 +4,18 @@
 #include "../core/events.h"
 #include "../routing/routing_table.h"
 #include "../core/ringbuffer.h"
+#include "klib.h"
 
 // ============================================================================
 // GUIDE - Динамическая маршрутизация событий к Decks
 // ============================================================================
 //
 // Функции:
-// 1. Сканирует routing table для событий, ожидающих обработки
+// 1. Забирает из ready queue события, которые могут сделать следующий шаг
+//    (ingestion и decks сами ставят entry в очередь - сканирования нет)
 // 2. Читает следующий prefix из routing entry
-// 3. Отправляет событие в соответствующий Deck
-// 4. Проверяет завершение обработки decks (префикс затёрт?)
-// 5. Если все префиксы = 0, отправляет в Execution Deck
+// 3. Отправляет событие в соответствующий Deck (lane его priority class)
+// 4. Если все префиксы = 0, отправляет в Execution Deck
 //
 // ============================================================================
 
@@ -26,6 +27,11 @@ typedef struct {
     volatile uint64_t events_routed;
     volatile uint64_t events_completed;
     volatile uint64_t routing_iterations;
+    volatile uint64_t ready_dispatched;    // Entries popped from ready queue
+    volatile uint64_t ready_requeued;      // Deck queue full → back to ready queue
+    volatile uint64_t sqpoll_events;       // Events picked up by SQPOLL poller
+    volatile uint64_t sqpoll_fallbacks;    // Poller went idle → NEED_WAKEUP
+    volatile uint64_t fused_passes;        // Доп. проходы для fused workflow chains
 } GuideStats;
 
 extern GuideStats guide_stats;
@@ -33,63 +39,245 @@ extern GuideStats guide_stats;
 // ============================================================================
 // DECK QUEUE - Очередь событий для каждого deck
 // ============================================================================
+//
+// QoS: по одной SPSC lane на priority class (EVENT_PRIORITY_*). Guide кладёт
+// entry в lane его класса - полная BULK lane не мешает INTERACTIVE. Consumer:
+//   INTERACTIVE  - strict priority, берётся первой всегда
+//   NORMAL/BULK  - weighted round robin DECK_LANE_WEIGHT_NORMAL : _BULK;
+//                  пустая lane свою долю не держит (work-conserving)
+// Состояние WRR пишет только consumer, так что очередь остаётся SPSC.
+//
+// ============================================================================
 
-// Уменьшено для экономии памяти
+// Глубина lane по умолчанию (inline storage, без аллокаций)
+// Deck может увеличить через deck_set_queue_depth()
 #define DECK_QUEUE_SIZE 128
 #define DECK_QUEUE_MASK (DECK_QUEUE_SIZE - 1)
+#define DECK_QUEUE_MAX_DEPTH 4096
 
-struct DeckQueue {
-    volatile uint64_t head __attribute__((aligned(64)));
-    volatile uint64_t tail __attribute__((aligned(64)));
+// WRR доли (pop'ов подряд), пока обе lanes не пусты
+#define DECK_LANE_WEIGHT_NORMAL 4
+#define DECK_LANE_WEIGHT_BULK   1
+
+typedef struct {
+    volatile uint64_t head __attribute__((aligned(64)));   // Consumer
+    volatile uint64_t tail __attribute__((aligned(64)));   // Producer
+    uint64_t max_depth;                                    // Producer: пик глубины
+
+    // Геометрия: entries = inline_entries или kmalloc'нутый массив
+    RoutingEntry** entries __attribute__((aligned(64)));
+    uint64_t capacity;
+    uint64_t mask;
 
     // Вместо копирования Event, храним указатели на RoutingEntry
-    RoutingEntry* entries[DECK_QUEUE_SIZE] __attribute__((aligned(64)));
+    RoutingEntry* inline_entries[DECK_QUEUE_SIZE] __attribute__((aligned(64)));
+} DeckLane;
+
+struct DeckQueue {
+    DeckLane lanes[EVENT_PRIORITY_CLASSES];
+
+    // WRR между NORMAL и BULK (только consumer)
+    uint32_t wrr_lane __attribute__((aligned(64)));
+    uint32_t wrr_credit;                                   // Pop'ов осталось у wrr_lane
 };
 
+static inline void deck_lane_init(DeckLane* lane) {
+    atomic_store_u64(&lane->head, 0);
+    atomic_store_u64(&lane->tail, 0);
+    lane->max_depth = 0;
+    lane->entries = lane->inline_entries;
+    lane->capacity = DECK_QUEUE_SIZE;
+    lane->mask = DECK_QUEUE_MASK;
+}
+
+static inline uint64_t deck_lane_depth(DeckLane* lane) {
+    return atomic_load_u64(&lane->tail) - atomic_load_u64(&lane->head);
+}
+
+static inline int deck_lane_is_empty(DeckLane* lane) {
+    return atomic_load_u64(&lane->head) == atomic_load_u64(&lane->tail);
+}
+
+// Забрать до max entries одной lane одним обновлением head
+static inline uint32_t deck_lane_pop_batch(DeckLane* lane, RoutingEntry** out, uint32_t max) {
+    uint64_t current_head = atomic_load_u64(&lane->head);
+    uint64_t current_tail = atomic_load_u64(&lane->tail);
+
+    uint64_t available = current_tail - current_head;
+    uint32_t count = available < max ? (uint32_t)available : max;
+
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = lane->entries[(current_head + i) & lane->mask];
+    }
+
+    COMPILER_BARRIER();
+    atomic_store_u64(&lane->head, current_head + count);
+
+    return count;
+}
+
 // Операции с deck queue
 static inline void deck_queue_init(DeckQueue* queue) {
-    atomic_store_u64(&queue->head, 0);
-    atomic_store_u64(&queue->tail, 0);
+    for (uint32_t i = 0; i < EVENT_PRIORITY_CLASSES; i++) {
+        deck_lane_init(&queue->lanes[i]);
+    }
+    queue->wrr_lane = EVENT_PRIORITY_NORMAL;
+    queue->wrr_credit = DECK_LANE_WEIGHT_NORMAL;
 }
 
+static inline int deck_queue_is_empty(DeckQueue* queue) {
+    for (uint32_t i = 0; i < EVENT_PRIORITY_CLASSES; i++) {
+        if (!deck_lane_is_empty(&queue->lanes[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Изменить глубину каждой lane (степень 2, только пока очередь пуста)
+// Возвращает 1 при успехе, 0 при ошибке
+static inline int deck_queue_set_capacity(DeckQueue* queue, uint64_t capacity) {
+    if (capacity < 2 || capacity > DECK_QUEUE_MAX_DEPTH || (capacity & (capacity - 1))) {
+        return 0;
+    }
+    if (!deck_queue_is_empty(queue)) {
+        return 0;  // Нельзя менять storage под живыми entries
+    }
+
+    // Сначала storage для всех lanes: при нехватке памяти очередь не меняется
+    RoutingEntry** storage[EVENT_PRIORITY_CLASSES];
+    for (uint32_t i = 0; i < EVENT_PRIORITY_CLASSES; i++) {
+        storage[i] = queue->lanes[i].inline_entries;
+        if (capacity > DECK_QUEUE_SIZE) {
+            storage[i] = (RoutingEntry**)kmalloc(capacity * sizeof(RoutingEntry*));
+            if (!storage[i]) {
+                while (i-- > 0) {
+                    kfree(storage[i]);
+                }
+                return 0;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < EVENT_PRIORITY_CLASSES; i++) {
+        DeckLane* lane = &queue->lanes[i];
+        if (lane->entries != lane->inline_entries) {
+            kfree(lane->entries);
+        }
+
+        lane->entries = storage[i];
+        lane->capacity = capacity;
+        lane->mask = capacity - 1;
+    }
+    return 1;
+}
+
+// В lane класса entry->priority (ingestion уже привёл его к EVENT_PRIORITY_*)
 static inline int deck_queue_push(DeckQueue* queue, RoutingEntry* entry) {
-    uint64_t current_tail = atomic_load_u64(&queue->tail);
-    uint64_t current_head = atomic_load_u64(&queue->head);
+    DeckLane* lane = &queue->lanes[entry->priority];
+    uint64_t current_tail = atomic_load_u64(&lane->tail);
+    uint64_t current_head = atomic_load_u64(&lane->head);
 
-    if ((current_tail - current_head) >= DECK_QUEUE_SIZE) {
-        return 0;  // Queue full
+    if ((current_tail - current_head) >= lane->capacity) {
+        return 0;  // Lane full
     }
 
-    uint64_t index = current_tail & DECK_QUEUE_MASK;
-    queue->entries[index] = entry;
+    uint64_t index = current_tail & lane->mask;
+    lane->entries[index] = entry;
 
     COMPILER_BARRIER();
-    atomic_store_u64(&queue->tail, current_tail + 1);
+    atomic_store_u64(&lane->tail, current_tail + 1);
+
+    if (current_tail + 1 - current_head > lane->max_depth) {
+        lane->max_depth = current_tail + 1 - current_head;
+    }
 
     return 1;
 }
 
-static inline RoutingEntry* deck_queue_pop(DeckQueue* queue) {
-    uint64_t current_head = atomic_load_u64(&queue->head);
-    uint64_t current_tail = atomic_load_u64(&queue->tail);
+// Lane для следующего pop: INTERACTIVE, иначе WRR между NORMAL и BULK.
+// -1 = все lanes пусты
+static inline int deck_queue_next_lane(DeckQueue* queue) {
+    if (!deck_lane_is_empty(&queue->lanes[EVENT_PRIORITY_INTERACTIVE])) {
+        return EVENT_PRIORITY_INTERACTIVE;
+    }
 
-    if (current_head == current_tail) {
-        return 0;  // Queue empty
+    // Текущая lane, другая с новой долей, снова текущая
+    for (int i = 0; i < 3; i++) {
+        if (queue->wrr_credit > 0 && !deck_lane_is_empty(&queue->lanes[queue->wrr_lane])) {
+            return (int)queue->wrr_lane;
+        }
+
+        if (queue->wrr_lane == EVENT_PRIORITY_NORMAL) {
+            queue->wrr_lane = EVENT_PRIORITY_BULK;
+            queue->wrr_credit = DECK_LANE_WEIGHT_BULK;
+        } else {
+            queue->wrr_lane = EVENT_PRIORITY_NORMAL;
+            queue->wrr_credit = DECK_LANE_WEIGHT_NORMAL;
+        }
     }
+    return -1;
+}
 
-    uint64_t index = current_head & DECK_QUEUE_MASK;
-    RoutingEntry* entry = queue->entries[index];
+static inline RoutingEntry* deck_queue_pop(DeckQueue* queue) {
+    RoutingEntry* entry;
+    int lane = deck_queue_next_lane(queue);
 
-    COMPILER_BARRIER();
-    atomic_store_u64(&queue->head, current_head + 1);
+    if (lane < 0) {
+        return 0;  // Queue empty
+    }
+    if (lane != EVENT_PRIORITY_INTERACTIVE) {
+        queue->wrr_credit--;
+    }
 
+    deck_lane_pop_batch(&queue->lanes[lane], &entry, 1);
     return entry;
 }
 
-static inline int deck_queue_is_empty(DeckQueue* queue) {
-    return atomic_load_u64(&queue->head) == atomic_load_u64(&queue->tail);
+// Забрать до max entries: по одному обновлению head на каждый отрезок lane
+// Возвращает количество извлечённых entries
+static inline uint32_t deck_queue_pop_batch(DeckQueue* queue, RoutingEntry** out, uint32_t max) {
+    uint32_t count = 0;
+
+    while (count < max) {
+        int lane = deck_queue_next_lane(queue);
+        if (lane < 0) {
+            break;
+        }
+
+        uint32_t want = max - count;
+        if (lane != EVENT_PRIORITY_INTERACTIVE && want > queue->wrr_credit) {
+            want = queue->wrr_credit;
+        }
+
+        uint32_t taken = deck_lane_pop_batch(&queue->lanes[lane], out + count, want);
+        if (lane != EVENT_PRIORITY_INTERACTIVE) {
+            queue->wrr_credit -= taken;
+        }
+        count += taken;
+    }
+
+    return count;
 }
 
+// ============================================================================
+// READY QUEUE - Entries, готовые к следующему шагу маршрута
+// ============================================================================
+//
+// Intrusive FIFO через RoutingEntry.ready_next: без лимита ёмкости и без
+// аллокаций. Пушат: ingestion (новый entry), deck_complete()/deck_error(),
+// deck_run_once() (deck не завершил шаг - повторить). ready_queued делает
+// push идемпотентным.
+//
+// ============================================================================
+
+typedef struct {
+    RoutingEntry* head;
+    RoutingEntry* tail;
+    volatile uint64_t count;
+    spinlock_t lock;
+} GuideReadyQueue;
+
 // ============================================================================
 // GUIDE CONTEXT - Глобальное состояние Guide
 // ============================================================================
@@ -97,14 +285,18 @@ static inline int deck_queue_is_empty(DeckQueue* queue) {
 typedef struct {
     RoutingTable* routing_table;
 
+    // Entries, которые могут продвинуться (вместо сканирования buckets)
+    GuideReadyQueue ready_queue;
+
     // Очереди для каждого deck (НОВАЯ АРХИТЕКТУРА v1)
     DeckQueue deck_queues[5];  // 0 = unused, 1-4 = deck prefixes (OPERATIONS, STORAGE, HARDWARE, NETWORK)
 
     // Очередь для Execution Deck (завершённые события)
     DeckQueue execution_queue;
 
-    // Scan position в routing table (для round-robin)
-    volatile uint64_t scan_position;
+    // SMP: decks со своим ядром (бит = deck prefix, бит 0 = Execution).
+    // Их очереди Guide не дренирует - у SPSC очереди один consumer
+    volatile uint32_t pinned_decks;
 } GuideContext;
 
 extern GuideContext guide_context;
@@ -119,81 +311,54 @@ void guide_init(RoutingTable* routing_table);
 // ROUTING LOGIC
 // ============================================================================
 
-// Сканирует routing table и маршрутизирует события
-static inline void guide_scan_and_route(GuideContext* ctx) {
-    RoutingTable* table = ctx->routing_table;
-
-    // Сканируем несколько buckets за один проход (batch processing)
-    for (int batch = 0; batch < 16; batch++) {
-        uint64_t pos = atomic_load_u64(&ctx->scan_position);
-        uint64_t bucket_index = pos % ROUTING_TABLE_SIZE;
-
-        RoutingBucket* bucket = &table->buckets[bucket_index];
+// Поставить entry в ready queue (идемпотентно, безопасно из IRQ)
+void guide_mark_ready(RoutingEntry* entry);
 
-        // Lock bucket
-        bucket_lock(bucket);
+// Маршрутизировать entries из ready queue (только те, что были в очереди
+// на момент вызова). Возвращает количество обработанных entries.
+uint64_t guide_dispatch_ready(GuideContext* ctx);
 
-        // DYNAMIC ROUTING TABLE FIX: Iterate through linked list
-        RoutingEntry* entry = bucket->head;
-        while (entry) {
-            if (entry->state != EVENT_STATUS_PROCESSING) {
-                entry = entry->next;
-                continue;  // Не в состоянии обработки
-            }
+// ============================================================================
+// MAIN LOOP
+// ============================================================================
 
-            // Получаем следующий prefix
-            uint8_t next_prefix = routing_entry_get_next_prefix(entry);
+// Обработать один проход ready queue (для синхронной обработки)
+void guide_scan_and_dispatch(RoutingTable* routing_table);
 
-            if (next_prefix == DECK_PREFIX_NONE) {
-                // Все префиксы обработаны! Отправляем в Execution Deck
-                if (deck_queue_push(&ctx->execution_queue, entry)) {
-                    entry->state = EVENT_STATUS_SUCCESS;
-                    atomic_increment_u64((volatile uint64_t*)&guide_stats.events_completed);
-                }
-            } else {
-                // Проверяем abort_flag - если установлен, пропускаем обработку
-                if (entry->abort_flag) {
-                    // Прерываем обработку - очищаем все префиксы и отправляем в Execution
-                    for (int j = 0; j < MAX_ROUTING_STEPS; j++) {
-                        entry->prefixes[j] = DECK_PREFIX_NONE;
-                    }
-                    if (deck_queue_push(&ctx->execution_queue, entry)) {
-                        entry->state = EVENT_STATUS_ERROR;
-                        atomic_increment_u64((volatile uint64_t*)&guide_stats.events_completed);
-                    }
-                } else {
-                    // Отправляем в соответствующий deck (НОВАЯ АРХИТЕКТУРА: префиксы 1-4)
-                    if (next_prefix >= 1 && next_prefix <= 4) {
-                        if (deck_queue_push(&ctx->deck_queues[next_prefix], entry)) {
-                            // ИСПРАВЛЕНО: НЕ затираем prefix! Deck сам затрет после обработки!
-                            atomic_increment_u64((volatile uint64_t*)&guide_stats.events_routed);
-                        }
-                    }
-                }
-            }
+// Максимум дополнительных проходов guide_process_all() за fused workflow
+// successors (цепочка длиннее доходит на следующем вызове)
+#define GUIDE_FUSED_PASSES 4
 
-            // DYNAMIC ROUTING TABLE FIX: Move to next entry in linked list
-            entry = entry->next;
-        }
+// Process all events from EventRing (called from kernel_notify)
+void guide_process_all(void);
 
-        bucket_unlock(bucket);
+void guide_run(void);
 
-        // Двигаем scan position
-        atomic_increment_u64(&ctx->scan_position);
-    }
-}
+// Есть ли работа для guide_process_all() на следующем tick: ready queue,
+// непустые очереди не-pinned decks, SQPOLL процессы. SUSPENDED события не
+// считаются - их будит таймер Hardware deck / IRQ (tickless idle, clock.h)
+int guide_has_pending(void);
 
 // ============================================================================
-// MAIN LOOP
+// SQPOLL - Kernel-side EventRing polling
 // ============================================================================
 
-// Обработать один проход сканирования (для синхронной обработки)
-void guide_scan_and_dispatch(RoutingTable* routing_table);
+// Порог простоя по умолчанию: 1 сек пустого EventRing (по TSC)
+#define GUIDE_SQPOLL_IDLE_US_DEFAULT 1000000
 
-// Process all events from EventRing (called from kernel_notify)
-void guide_process_all(void);
+// Poll EventRing.tail of every SQPOLL process. Called by guide_sqpoll_run
+// on its AP, or from guide_process_all when no AP was free.
+// Returns number of events ingested
+uint64_t guide_sqpoll_poll(void);
 
-void guide_run(void);
+// Poller loop for a dedicated AP (smp_place_decks), never returns
+void guide_sqpoll_run(void);
+
+// 1 = guide_sqpoll_run owns polling, timer interrupt stops calling guide_sqpoll_poll
+void guide_set_sqpoll_pinned(int pinned);
+
+// Configure idle threshold before falling back to notify mode (0 = default)
+void guide_set_sqpoll_idle_us(uint64_t us);
 
 // ============================================================================
 // STATS
@@ -208,4 +373,15 @@ void guide_print_stats(void);
 DeckQueue* guide_get_deck_queue(uint8_t deck_prefix);
 DeckQueue* guide_get_execution_queue(void);
 
+// ============================================================================
+// SMP PLACEMENT
+// ============================================================================
+
+// Execution Deck в pinned_decks
+#define GUIDE_DECK_EXECUTION DECK_PREFIX_NONE
+
+// Deck получил отдельное ядро (pinned=1) - guide_process_all() его пропускает
+void guide_set_deck_pinned(uint8_t deck_prefix, int pinned);
+int guide_deck_is_pinned(uint8_t deck_prefix);
+
 #endif // GUIDE_H
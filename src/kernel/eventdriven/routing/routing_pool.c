@@ -0,0 +1,185 @@
+#include "routing_pool.h"
+#include "pmm.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL POOL
+// ============================================================================
+
+static RoutingPool routing_pool;
+
+// Free-list link хранится в первом слове свободного объекта
+static inline void* pool_next(void* obj) {
+    return *(void**)obj;
+}
+
+static inline void pool_set_next(void* obj, void* next) {
+    *(void**)obj = next;
+}
+
+// ============================================================================
+// SLAB GROWTH (под global lock)
+// ============================================================================
+
+static int routing_pool_grow(void) {
+    uint8_t* slab = (uint8_t*)pmm_alloc(ROUTING_POOL_SLAB_PAGES);
+    if (!slab) {
+        kprintf("[ROUTING_POOL] ERROR: Out of memory for new slab!\n");
+        return 0;
+    }
+
+    uint64_t count = (ROUTING_POOL_SLAB_PAGES * PMM_PAGE_SIZE) / ROUTING_POOL_OBJECT_SIZE;
+
+    // Нарезаем slab и цепляем объекты к global free list
+    for (uint64_t i = 0; i < count; i++) {
+        void* obj = slab + i * ROUTING_POOL_OBJECT_SIZE;
+        pool_set_next(obj, routing_pool.free_list);
+        routing_pool.free_list = obj;
+    }
+
+    routing_pool.free_count += count;
+    routing_pool.slabs++;
+    routing_pool.objects_total += count;
+
+    return 1;
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void routing_pool_init(void) {
+    kprintf("[ROUTING_POOL] Initializing...\n");
+
+    memset(&routing_pool, 0, sizeof(RoutingPool));
+    spinlock_init(&routing_pool.lock);
+
+    for (int i = 0; i < ROUTING_POOL_CACHE_COUNT; i++) {
+        spinlock_init(&routing_pool.caches[i].lock);
+    }
+
+    // Первый slab сразу - чтобы первые события не платили за рост
+    spin_lock(&routing_pool.lock);
+    routing_pool_grow();
+    spin_unlock(&routing_pool.lock);
+
+    kprintf("[ROUTING_POOL] Initialized (object=%lu bytes, %lu per slab, %d caches)\n",
+            (uint64_t)ROUTING_POOL_OBJECT_SIZE,
+            (uint64_t)((ROUTING_POOL_SLAB_PAGES * PMM_PAGE_SIZE) / ROUTING_POOL_OBJECT_SIZE),
+            ROUTING_POOL_CACHE_COUNT);
+}
+
+// ============================================================================
+// ALLOC / FREE
+// ============================================================================
+
+RoutingEntry* routing_pool_alloc(uint8_t cache_id) {
+    // DEFENSIVE: Validate cache id
+    if (cache_id >= ROUTING_POOL_CACHE_COUNT) {
+        cache_id = ROUTING_POOL_CACHE_GUIDE;
+    }
+
+    RoutingPoolCache* cache = &routing_pool.caches[cache_id];
+
+    spin_lock(&cache->lock);
+
+    if (!cache->free_list) {
+        // Refill batch из global free list
+        spin_lock(&routing_pool.lock);
+
+        if (routing_pool.free_count < ROUTING_POOL_BATCH) {
+            routing_pool_grow();
+        }
+
+        for (int i = 0; i < ROUTING_POOL_BATCH && routing_pool.free_list; i++) {
+            void* obj = routing_pool.free_list;
+            routing_pool.free_list = pool_next(obj);
+            routing_pool.free_count--;
+
+            pool_set_next(obj, cache->free_list);
+            cache->free_list = obj;
+            cache->count++;
+        }
+
+        spin_unlock(&routing_pool.lock);
+        cache->refills++;
+    }
+
+    void* obj = cache->free_list;
+    if (obj) {
+        cache->free_list = pool_next(obj);
+        cache->count--;
+        cache->allocs++;
+    }
+
+    spin_unlock(&cache->lock);
+
+    if (!obj) {
+        kprintf("[ROUTING_POOL] ERROR: Pool exhausted!\n");
+        return NULL;
+    }
+
+    atomic_increment_u64(&routing_pool.objects_in_use);
+    return (RoutingEntry*)obj;
+}
+
+void routing_pool_free(RoutingEntry* entry, uint8_t cache_id) {
+    if (!entry) {
+        return;
+    }
+
+    if (cache_id >= ROUTING_POOL_CACHE_COUNT) {
+        cache_id = ROUTING_POOL_CACHE_GUIDE;
+    }
+
+    RoutingPoolCache* cache = &routing_pool.caches[cache_id];
+
+    spin_lock(&cache->lock);
+
+    pool_set_next(entry, cache->free_list);
+    cache->free_list = entry;
+    cache->count++;
+    cache->frees++;
+
+    if (cache->count > ROUTING_POOL_CACHE_SIZE) {
+        // Flush batch в global: cache Guide их подхватит при refill
+        spin_lock(&routing_pool.lock);
+
+        for (int i = 0; i < ROUTING_POOL_BATCH && cache->free_list; i++) {
+            void* obj = cache->free_list;
+            cache->free_list = pool_next(obj);
+            cache->count--;
+
+            pool_set_next(obj, routing_pool.free_list);
+            routing_pool.free_list = obj;
+            routing_pool.free_count++;
+        }
+
+        spin_unlock(&routing_pool.lock);
+        cache->flushes++;
+    }
+
+    spin_unlock(&cache->lock);
+
+    atomic_decrement_u64(&routing_pool.objects_in_use);
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+void routing_pool_print_stats(void) {
+    kprintf("[ROUTING_POOL] slabs=%lu objects=%lu in_use=%lu global_free=%lu\n",
+            routing_pool.slabs, routing_pool.objects_total,
+            routing_pool.objects_in_use, routing_pool.free_count);
+
+    for (int i = 0; i < ROUTING_POOL_CACHE_COUNT; i++) {
+        RoutingPoolCache* cache = &routing_pool.caches[i];
+        if (cache->allocs == 0 && cache->frees == 0) {
+            continue;
+        }
+        kprintf("[ROUTING_POOL]   cache %d: cached=%u allocs=%lu frees=%lu refills=%lu flushes=%lu\n",
+                i, cache->count, cache->allocs, cache->frees,
+                cache->refills, cache->flushes);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef ROUTING_POOL_H
+#define ROUTING_POOL_H
+
+#include "../core/events.h"
+#include "../core/atomics.h"
+#include "ktypes.h"
+#include "klib.h"
+
+// ============================================================================
+// ROUTING POOL - Slab allocator для RoutingEntry
+// ============================================================================
+//
+// Fixed-size объекты (sizeof(RoutingEntry), округлено до cache line) в
+// slab'ах из PMM - мимо глобального first-fit kmalloc и его heap_lock.
+//
+// Два уровня:
+//   1. Per-context cache: LIFO до ROUTING_POOL_CACHE_SIZE объектов, свой lock
+//      (uncontended - каждый cache использует один контекст)
+//   2. Global free list: refill/flush batch'ами по ROUTING_POOL_BATCH
+//
+// Entries рождаются только при ingestion (Guide) и умирают в Execution
+// Deck - поэтому caches два: Guide берёт, Execution возвращает, batch'и
+// ходят между ними через global list. Decks entries не выделяют.
+//
+// Alloc/free - O(1). Slab'ы не возвращаются в PMM (рабочий набор
+// routing entries стабилен).
+//
+// ============================================================================
+
+// Cache ID: 0 = Guide/ingestion, 1 = Execution Deck
+#define ROUTING_POOL_CACHE_GUIDE      0
+#define ROUTING_POOL_CACHE_EXECUTION  1
+#define ROUTING_POOL_CACHE_COUNT      2
+
+#define ROUTING_POOL_CACHE_SIZE  32     // Объектов в cache (max)
+#define ROUTING_POOL_BATCH       16     // Refill/flush batch
+#define ROUTING_POOL_SLAB_PAGES  16     // Страниц на slab (64KB)
+
+// Размер объекта: кратен cache line
+#define ROUTING_POOL_OBJECT_SIZE ((sizeof(RoutingEntry) + 63) & ~63ULL)
+
+typedef struct {
+    void* free_list;                    // LIFO (next pointer в первом слове объекта)
+    uint32_t count;
+    spinlock_t lock;
+    volatile uint64_t allocs;
+    volatile uint64_t frees;
+    volatile uint64_t refills;          // Batch'и из global
+    volatile uint64_t flushes;          // Batch'и в global
+} __attribute__((aligned(64))) RoutingPoolCache;
+
+typedef struct {
+    RoutingPoolCache caches[ROUTING_POOL_CACHE_COUNT];
+
+    // Global free list
+    void* free_list;
+    uint64_t free_count;
+    spinlock_t lock;
+
+    volatile uint64_t slabs;            // Выделено slab'ов
+    volatile uint64_t objects_total;    // Объектов во всех slab'ах
+    volatile uint64_t objects_in_use;
+} RoutingPool;
+
+// Инициализация (до первого routing_table_alloc_entry)
+void routing_pool_init(void);
+
+// Выделить объект (НЕ обнулён) из cache / вернуть в cache
+RoutingEntry* routing_pool_alloc(uint8_t cache_id);
+void routing_pool_free(RoutingEntry* entry, uint8_t cache_id);
+
+void routing_pool_print_stats(void);
+
+#endif // ROUTING_POOL_H
@@ -1,6 +1,15 @@
 #include "routing_table.h"
+#include "routing_pool.h"
 #include "workflow_rings.h"
+#include "syscall.h"
+#include "pmm.h"
 #include "klib.h"
+#include "trace.h"
+#include "result_buffer.h"
+#include "smp.h"
+
+_Static_assert(ROUTING_PAYLOAD_SIZE == EVENT_PAYLOAD_SIZE,
+               "RoutingEntry.payload_data must hold a full RingEvent payload");
 
 // ============================================================================
 // GLOBAL ROUTING TABLE
@@ -8,6 +17,229 @@
 
 RoutingTable global_routing_table;
 
+// ============================================================================
+// EPOCH RECLAMATION
+// ============================================================================
+
+// Per-CPU: read-side секция lookup и retired entries этого CPU
+typedef struct {
+    volatile uint64_t epoch;            // 0 = вне lookup, иначе epoch при входе
+    uint32_t nesting;                   // Lookup из IRQ поверх lookup на том же CPU
+    spinlock_t retire_lock;             // vs routing_table_reclaim (BSP)
+    RoutingEntry* retire_head;          // Retired entries, старые первыми
+    RoutingEntry* retire_tail;
+} __attribute__((aligned(64))) RoutingEpochCpu;
+
+static RoutingEpochCpu routing_epoch_cpus[SMP_MAX_CPUS];
+
+// CRITICAL: epoch объявлена (mfence) до первого чтения массивов
+static inline RoutingEpochCpu* routing_read_begin(RoutingTable* table) {
+    RoutingEpochCpu* cpu = &routing_epoch_cpus[smp_current_cpu()];
+    if (cpu->nesting++ == 0) {
+        atomic_store_u64(&cpu->epoch, atomic_load_u64(&table->epoch));
+        MEMORY_BARRIER();
+    }
+    return cpu;
+}
+
+static inline void routing_read_end(RoutingEpochCpu* cpu) {
+    COMPILER_BARRIER();
+    if (--cpu->nesting == 0) {
+        atomic_store_u64(&cpu->epoch, 0);
+    }
+}
+
+// Массив больше не достижим из таблицы (под lock)
+static void routing_retire_array(RoutingTable* table, RoutingArray* array) {
+    array->retire_next = NULL;
+    array->retire_epoch = atomic_load_u64(&table->epoch);
+    if (table->retired_tail) {
+        table->retired_tail->retire_next = array;
+    } else {
+        table->retired_head = array;
+    }
+    table->retired_tail = array;
+}
+
+// ============================================================================
+// ARRAY MANAGEMENT
+// ============================================================================
+
+static RoutingArray* routing_array_create(uint64_t bucket_count) {
+    uint64_t bytes = sizeof(RoutingArray) + bucket_count * sizeof(RoutingBucket);
+    uint64_t pages = (bytes + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE;
+
+    // pmm_alloc_zero: все ключи = ROUTING_KEY_EMPTY, page-aligned → buckets aligned(64)
+    RoutingArray* array = (RoutingArray*)pmm_alloc_zero(pages);
+    if (!array) {
+        kprintf("[ROUTING_TABLE] ERROR: Out of memory for %lu buckets!\n", bucket_count);
+        return NULL;
+    }
+
+    array->bucket_mask = bucket_count - 1;
+    array->pages = pages;
+    return array;
+}
+
+static void routing_array_destroy(RoutingArray* array) {
+    if (array) {
+        pmm_free(array, array->pages);
+    }
+}
+
+static inline uint64_t routing_array_slots(RoutingArray* array) {
+    return (array->bucket_mask + 1) * ROUTING_SLOTS_PER_BUCKET;
+}
+
+static inline void routing_record_probe(RoutingTable* table, uint64_t probes) {
+    atomic_increment_u64(&table->probe_ops);
+    atomic_add_u64(&table->probe_total, probes);
+    if (probes > table->probe_max) {
+        table->probe_max = probes;
+    }
+}
+
+// Поиск слота в одном массиве (под lock или в read-side секции).
+// Возвращает slot или NULL.
+static RoutingSlot* routing_array_find(RoutingArray* array, uint64_t key, uint64_t* probes) {
+    uint64_t mask = array->bucket_mask;
+    uint64_t index = hash_event_id(key - 1) & mask;
+
+    for (uint64_t n = 0; n <= mask; n++) {
+        RoutingBucket* bucket = &array->buckets[(index + n) & mask];
+        (*probes)++;
+
+        for (int i = 0; i < ROUTING_SLOTS_PER_BUCKET; i++) {
+            uint64_t k = atomic_load_u64(&bucket->slots[i].key);
+            if (k == key) {
+                return &bucket->slots[i];
+            }
+            if (k == ROUTING_KEY_EMPTY) {
+                return NULL;  // Цепочка пробирования закончилась
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Вставка в массив (под lock, дубликат уже проверен).
+// Возвращает номер bucket'а от home (0 = без коллизии).
+static uint64_t routing_array_put(RoutingArray* array, uint64_t key, RoutingEntry* entry) {
+    uint64_t mask = array->bucket_mask;
+    uint64_t index = hash_event_id(key - 1) & mask;
+
+    for (uint64_t n = 0; n <= mask; n++) {
+        RoutingBucket* bucket = &array->buckets[(index + n) & mask];
+
+        for (int i = 0; i < ROUTING_SLOTS_PER_BUCKET; i++) {
+            RoutingSlot* slot = &bucket->slots[i];
+            uint64_t k = slot->key;
+
+            if (k == ROUTING_KEY_EMPTY || k == ROUTING_KEY_TOMBSTONE) {
+                if (k == ROUTING_KEY_EMPTY) {
+                    array->used++;  // Tombstone уже учтён в used
+                }
+                array->live++;
+
+                // Публикация: сначала pointer, потом key (readers читают key первым)
+                slot->entry = entry;
+                MEMORY_BARRIER();
+                atomic_store_u64(&slot->key, key);
+                return n;
+            }
+        }
+    }
+
+    // Недостижимо: resize держит load factor <= 3/4
+    panic("routing_array_put: table full");
+    return 0;
+}
+
+static void routing_slot_clear(RoutingArray* array, RoutingSlot* slot) {
+    atomic_store_u64(&slot->key, ROUTING_KEY_TOMBSTONE);
+    slot->entry = NULL;
+    array->live--;
+}
+
+// Перенести до ROUTING_MIGRATE_BUCKETS bucket'ов из old_array (под lock)
+static void routing_migrate_step(RoutingTable* table, uint64_t budget) {
+    RoutingArray* old = table->old_array;
+    if (!old) {
+        return;
+    }
+
+    RoutingArray* cur = table->array;
+
+    while (budget-- > 0 && table->migrate_pos <= old->bucket_mask) {
+        RoutingBucket* bucket = &old->buckets[table->migrate_pos++];
+
+        for (int i = 0; i < ROUTING_SLOTS_PER_BUCKET; i++) {
+            RoutingSlot* slot = &bucket->slots[i];
+            uint64_t k = slot->key;
+            if (k == ROUTING_KEY_EMPTY || k == ROUTING_KEY_TOMBSTONE) {
+                continue;
+            }
+
+            // ПОРЯДОК ВАЖЕН: сначала в current, потом tombstone в old
+            routing_array_put(cur, k, slot->entry);
+            routing_slot_clear(old, slot);
+        }
+    }
+
+    if (table->migrate_pos > old->bucket_mask) {
+        // Перенос завершён. Lock-free lookup мог ещё взять old - массив
+        // уходит в pool после grace period
+        atomic_store_u64((volatile uint64_t*)&table->old_array, 0);
+        routing_retire_array(table, old);
+
+        kprintf("[ROUTING_TABLE] Resize complete: %lu buckets\n", cur->bucket_mask + 1);
+    }
+}
+
+// Начать resize, если вставка превысит load factor 3/4 (под lock)
+static int routing_maybe_grow(RoutingTable* table) {
+    RoutingArray* cur = table->array;
+    uint64_t slots = routing_array_slots(cur);
+
+    if ((cur->used + 1) * 4 <= slots * 3) {
+        return 1;
+    }
+
+    // Предыдущий перенос должен закончиться до нового
+    if (table->old_array) {
+        routing_migrate_step(table, ~0ULL);
+    }
+
+    // Много tombstones → rehash в тот же размер, иначе x2
+    uint64_t bucket_count = cur->bucket_mask + 1;
+    if (cur->live * 2 >= slots) {
+        bucket_count *= 2;
+    }
+
+    RoutingArray* next = routing_array_create(bucket_count);
+    if (!next) {
+        // Нет памяти: работаем дальше, пока есть свободные слоты
+        return cur->used < slots;
+    }
+
+    // Lookup, прочитавший пару массивов посередине, увидит нечётный или
+    // изменившийся layout_seq и повторит промах
+    table->migrate_pos = 0;
+    atomic_increment_u64(&table->layout_seq);
+    MEMORY_BARRIER();
+    atomic_store_u64((volatile uint64_t*)&table->old_array, (uint64_t)cur);
+    MEMORY_BARRIER();
+    atomic_store_u64((volatile uint64_t*)&table->array, (uint64_t)next);
+    MEMORY_BARRIER();
+    atomic_increment_u64(&table->layout_seq);
+    atomic_increment_u64(&table->resizes);
+
+    kprintf("[ROUTING_TABLE] Resizing: %lu -> %lu buckets (live=%lu used=%lu)\n",
+            cur->bucket_mask + 1, bucket_count, cur->live, cur->used);
+    return 1;
+}
+
 // ============================================================================
 // INITIALIZATION
 // ============================================================================
@@ -15,171 +247,593 @@ RoutingTable global_routing_table;
 void routing_table_init(RoutingTable* table) {
     kprintf("[ROUTING_TABLE] Initializing...\n");
 
-    // Initialize all buckets
+    // Slab pool для entries (вместо kmalloc на каждое событие)
+    routing_pool_init();
+
     memset(table, 0, sizeof(RoutingTable));
+    spinlock_init(&table->lock);
+    table->epoch = 1;  // 0 в per-CPU слоте = вне lookup
 
-    kprintf("[ROUTING_TABLE] Initialized (size=%d buckets, UNLIMITED capacity via linked lists)\n",
-            ROUTING_TABLE_SIZE);
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        spinlock_init(&routing_epoch_cpus[i].retire_lock);
+    }
+
+    table->array = routing_array_create(ROUTING_TABLE_SIZE);
+    if (!table->array) {
+        panic("routing_table_init: out of memory");
+    }
+
+    kprintf("[ROUTING_TABLE] Initialized (%d buckets x %d slots, open addressing, resizable)\n",
+            ROUTING_TABLE_SIZE, ROUTING_SLOTS_PER_BUCKET);
 }
 
 // ============================================================================
-// INSERT - Вставка routing entry (DYNAMIC VERSION with linked list)
+// INSERT - Вставка routing entry
 // ============================================================================
 
-int routing_table_insert(RoutingTable* table, RoutingEntry* entry) {
-    uint64_t index = routing_table_index(entry->event_id);
-    RoutingBucket* bucket = &table->buckets[index];
+RoutingEntry* routing_table_alloc_entry(void) {
+    // Ingestion идёт из syscall/SQPOLL/workflow - cache Guide
+    RoutingEntry* entry = routing_pool_alloc(ROUTING_POOL_CACHE_GUIDE);
+    if (!entry) {
+        kprintf("[ROUTING_TABLE] ERROR: Out of memory for routing entry!\n");
+        return NULL;
+    }
+    memset(entry, 0, sizeof(RoutingEntry));
+    return entry;
+}
+
+int routing_table_link_entry(RoutingTable* table, RoutingEntry* entry) {
+    uint64_t key = entry->event_id + 1;
+    uint64_t probes = 0;
 
-    // Allocate new entry on heap (CRITICAL: allows unlimited entries!)
-    RoutingEntry* new_entry = (RoutingEntry*)kmalloc(sizeof(RoutingEntry));
+    // DEFENSIVE: event_id = ~0 даёт key = EMPTY
+    if (key == ROUTING_KEY_EMPTY || key == ROUTING_KEY_TOMBSTONE) {
+        kprintf("[ROUTING_TABLE] ERROR: Reserved event_id %lu\n", entry->event_id);
+        return 0;
+    }
+
+    spin_lock(&table->lock);
+
+    routing_migrate_step(table, ROUTING_MIGRATE_BUCKETS);
+
+    // Дубликаты запрещены: event_id - ключ
+    if ((table->old_array && routing_array_find(table->old_array, key, &probes)) ||
+        routing_array_find(table->array, key, &probes)) {
+        spin_unlock(&table->lock);
+        kprintf("[ROUTING_TABLE] ERROR: Duplicate event_id %lu\n", entry->event_id);
+        return 0;
+    }
+
+    if (!routing_maybe_grow(table)) {
+        spin_unlock(&table->lock);
+        kprintf("[ROUTING_TABLE] ERROR: Table full, event %lu rejected\n", entry->event_id);
+        return 0;
+    }
+
+    uint64_t displacement = routing_array_put(table->array, key, entry);
+    if (displacement > 0) {
+        atomic_increment_u64(&table->collisions);
+    }
+    atomic_increment_u64(&table->total_entries);
+
+    spin_unlock(&table->lock);
+
+    routing_record_probe(table, probes);
+
+    // Новый entry сразу готов к первому шагу маршрута
+    extern void guide_mark_ready(RoutingEntry* entry);
+    guide_mark_ready(entry);
+    return 1;
+}
+
+int routing_table_insert(RoutingTable* table, RoutingEntry* entry) {
+    RoutingEntry* new_entry = routing_table_alloc_entry();
     if (!new_entry) {
-        kprintf("[ROUTING_TABLE] ERROR: Out of memory for routing entry!\n");
         return 0;  // Out of memory
     }
 
     // Copy entry data
     *new_entry = *entry;
-    new_entry->next = NULL;
-
-    bucket_lock(bucket);
-
-    // Insert at head of linked list (O(1) insertion)
-    new_entry->next = bucket->head;
-    bucket->head = new_entry;
-    bucket->count++;
-    atomic_increment_u64(&table->total_entries);
+    new_entry->ready_next = NULL;
+    new_entry->ready_queued = 0;
+
+    // Payload жил в старой копии - перенаправляем на новую
+    if (entry->payload == entry->payload_data) {
+        new_entry->payload = new_entry->payload_data;
+    } else if (entry->payload == entry->event_copy.data) {
+        new_entry->payload = new_entry->event_copy.data;
+    }
 
-    bucket_unlock(bucket);
+    if (!routing_table_link_entry(table, new_entry)) {
+        routing_pool_free(new_entry, ROUTING_POOL_CACHE_GUIDE);
+        return 0;
+    }
     return 1;  // Success
 }
 
 // ============================================================================
-// LOOKUP - Поиск routing entry (DYNAMIC VERSION with linked list)
+// LOOKUP - Поиск routing entry
 // ============================================================================
 
+// LOCK-FREE: массивы, которые видит lookup, не освобождаются до конца
+// его read-side секции (epoch). Detached entry lookup не вернёт: key
+// слота перепроверяется после чтения pointer
 RoutingEntry* routing_table_lookup(RoutingTable* table, uint64_t event_id) {
-    uint64_t index = routing_table_index(event_id);
-    RoutingBucket* bucket = &table->buckets[index];
+    uint64_t key = event_id + 1;
+    uint64_t probes = 0;
+    RoutingEntry* entry = NULL;
+
+    RoutingEpochCpu* cpu = routing_read_begin(table);
 
-    bucket_lock(bucket);
+    while (1) {
+        uint64_t seq = atomic_load_u64(&table->layout_seq);
+        if (seq & 1) {
+            cpu_pause();  // Resize публикует пару массивов
+            continue;
+        }
+
+        // СНАЧАЛА old: перенос пишет в current до tombstone в old
+        RoutingArray* old = (RoutingArray*)atomic_load_u64((volatile uint64_t*)&table->old_array);
+        RoutingArray* cur = (RoutingArray*)atomic_load_u64((volatile uint64_t*)&table->array);
 
-    // Walk linked list to find entry
-    RoutingEntry* current = bucket->head;
-    while (current) {
-        if (current->event_id == event_id) {
-            bucket_unlock(bucket);
-            return current;  // Found
+        RoutingSlot* slot = old ? routing_array_find(old, key, &probes) : NULL;
+        if (!slot) {
+            slot = routing_array_find(cur, key, &probes);
+        }
+
+        if (slot) {
+            // Слот мог быть очищен между чтением key и entry: detach (тогда
+            // повтор не найдёт key) или перенос в current (повтор найдёт там)
+            entry = slot->entry;
+            COMPILER_BARRIER();
+            if (atomic_load_u64(&slot->key) == key) {
+                break;
+            }
+            entry = NULL;
+            continue;
+        }
+
+        COMPILER_BARRIER();
+        if (atomic_load_u64(&table->layout_seq) == seq) {
+            break;  // Промах при неизменной паре массивов - entry нет
         }
-        current = current->next;
     }
 
-    bucket_unlock(bucket);
-    return NULL;  // Not found
+    routing_read_end(cpu);
+
+    routing_record_probe(table, probes);
+    return entry;
 }
 
 // ============================================================================
-// REMOVE - Удаление routing entry (DYNAMIC VERSION with linked list)
+// REMOVE - Удаление routing entry
 // ============================================================================
 
-int routing_table_remove(RoutingTable* table, uint64_t event_id) {
-    uint64_t index = routing_table_index(event_id);
-    RoutingBucket* bucket = &table->buckets[index];
-
-    bucket_lock(bucket);
-
-    // Walk linked list to find and remove entry
-    RoutingEntry* current = bucket->head;
-    RoutingEntry* prev = NULL;
-
-    while (current) {
-        if (current->event_id == event_id) {
-            // Found - remove from list
-            if (prev) {
-                // Not head - update previous node's next pointer
-                prev->next = current->next;
-            } else {
-                // Head node - update bucket head
-                bucket->head = current->next;
-            }
+RoutingEntry* routing_table_detach(RoutingTable* table, uint64_t event_id) {
+    uint64_t key = event_id + 1;
+    uint64_t probes = 0;
 
-            bucket->count--;
-            atomic_decrement_u64(&table->total_entries);
-            bucket_unlock(bucket);
+    spin_lock(&table->lock);
 
-            // CRITICAL: Free the entry memory (was allocated in insert)
-            kfree(current);
+    routing_migrate_step(table, ROUTING_MIGRATE_BUCKETS);
 
-            return 1;  // Success
+    RoutingArray* array = table->old_array;
+    RoutingSlot* slot = array ? routing_array_find(array, key, &probes) : NULL;
+    if (!slot) {
+        array = table->array;
+        slot = routing_array_find(array, key, &probes);
+    }
+
+    if (!slot) {
+        spin_unlock(&table->lock);
+        return NULL;  // Not found
+    }
+
+    RoutingEntry* entry = slot->entry;
+    routing_slot_clear(array, slot);
+    atomic_decrement_u64(&table->total_entries);
+
+    spin_unlock(&table->lock);
+
+    routing_record_probe(table, probes);
+    return entry;
+}
+
+void routing_table_release_entry(RoutingEntry* entry, uint8_t cache_id) {
+    if (!entry) {
+        return;
+    }
+
+    // Entry ушёл без результата (remove, abort) - credit не должен пропасть
+    routing_entry_return_credit(entry);
+
+    // Страницы registered buffer - процесс мог уже умереть
+    if (entry->buffer_pin) {
+        process_reg_pin_release((process_reg_pin_t*)entry->buffer_pin);
+        entry->buffer_pin = 0;
+    }
+
+    // Ссылка на результат предыдущего node (routing_table_add_workflow_event)
+    if (entry->input_result) {
+        result_buffer_release(entry->input_result);
+        entry->input_result = 0;
+    }
+
+    // В pool cache вызывающего (Guide / Execution) - после grace period:
+    // lock-free lookup мог прочитать pointer прямо перед detach
+    RoutingEpochCpu* cpu = &routing_epoch_cpus[smp_current_cpu()];
+    entry->retire_cache = cache_id;
+    entry->retire_next = NULL;
+
+    spin_lock(&cpu->retire_lock);
+    entry->retire_epoch = atomic_load_u64(&global_routing_table.epoch);
+    if (cpu->retire_tail) {
+        cpu->retire_tail->retire_next = entry;
+    } else {
+        cpu->retire_head = entry;
+    }
+    cpu->retire_tail = entry;
+    spin_unlock(&cpu->retire_lock);
+}
+
+void routing_table_reclaim(RoutingTable* table) {
+    // 1. Epoch двигается, только если каждый CPU в lookup уже видел текущую
+    uint64_t epoch = atomic_load_u64(&table->epoch);
+    int advance = 1;
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        uint64_t seen = atomic_load_u64(&routing_epoch_cpus[i].epoch);
+        if (seen != 0 && seen != epoch) {
+            advance = 0;
+            break;
         }
+    }
+    if (advance) {
+        atomic_store_u64(&table->epoch, ++epoch);
+        MEMORY_BARRIER();
+    }
 
-        prev = current;
-        current = current->next;
+    // 2. Retired в epoch <= E - 2: ни один lookup их уже не держит
+    if (epoch < 3) {
+        return;
     }
+    uint64_t safe = epoch - 2;
 
-    bucket_unlock(bucket);
-    return 0;  // Not found
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        RoutingEpochCpu* cpu = &routing_epoch_cpus[i];
+        if (!cpu->retire_head) {
+            continue;
+        }
+
+        spin_lock(&cpu->retire_lock);
+        RoutingEntry* head = cpu->retire_head;
+        RoutingEntry* last = NULL;
+        RoutingEntry* entry = head;
+        while (entry && entry->retire_epoch <= safe) {
+            last = entry;
+            entry = entry->retire_next;
+        }
+        if (!last) {
+            spin_unlock(&cpu->retire_lock);
+            continue;
+        }
+        cpu->retire_head = entry;
+        if (!entry) {
+            cpu->retire_tail = NULL;
+        }
+        last->retire_next = NULL;
+        spin_unlock(&cpu->retire_lock);
+
+        // pool free - вне retire_lock
+        uint64_t count = 0;
+        while (head) {
+            RoutingEntry* next = head->retire_next;
+            routing_pool_free(head, head->retire_cache);
+            head = next;
+            count++;
+        }
+        if (count > 0) {
+            atomic_add_u64(&table->reclaimed, count);
+        }
+    }
+
+    if (!table->retired_head) {
+        return;
+    }
+
+    spin_lock(&table->lock);
+    RoutingArray* arrays = NULL;
+    while (table->retired_head && table->retired_head->retire_epoch <= safe) {
+        RoutingArray* array = table->retired_head;
+        table->retired_head = array->retire_next;
+        array->retire_next = arrays;
+        arrays = array;
+    }
+    if (!table->retired_head) {
+        table->retired_tail = NULL;
+    }
+    spin_unlock(&table->lock);
+
+    while (arrays) {
+        RoutingArray* next = arrays->retire_next;
+        routing_array_destroy(arrays);
+        arrays = next;
+    }
+}
+
+int routing_table_remove(RoutingTable* table, uint64_t event_id) {
+    RoutingEntry* entry = routing_table_detach(table, event_id);
+    if (!entry) {
+        return 0;  // Not found
+    }
+
+    routing_table_release_entry(entry, ROUTING_POOL_CACHE_GUIDE);
+    return 1;  // Success
 }
 
 // ============================================================================
 // ADD RING EVENT - Create RoutingEntry from RingEvent and insert
 // ============================================================================
 
-int routing_table_add_event(RoutingTable* table, void* ring_event_ptr) {
-    RingEvent* ring_event = (RingEvent*)ring_event_ptr;
+// Получатель результата фиксируется при ingestion
+static void routing_entry_set_result_owner(RoutingEntry* entry, process_t* proc) {
+    if (!proc) {
+        return;
+    }
+    entry->result_owner = proc;
+    entry->result_pid = proc->pid;
+    entry->result_ring = proc->result_ring;
+}
 
-    // Create RoutingEntry from RingEvent
-    RoutingEntry entry;
-    entry.event_id = ring_event->id;
+// Entry в таблице - событие занимает result credit владельца
+// (возвращается, когда результат записан или parked, либо при release)
+static void routing_entry_take_credit(RoutingEntry* entry) {
+    process_t* proc = (process_t*)entry->result_owner;
+    if (proc) {
+        atomic_increment_u64(&proc->results_outstanding);
+        entry->credit_held = 1;
+    }
+}
+
+void routing_entry_return_credit(RoutingEntry* entry) {
+    if (!entry->credit_held) {
+        return;
+    }
+    entry->credit_held = 0;
+
+    // Процесс умер и слот таблицы занят другим - его credits не наши
+    process_t* proc = (process_t*)entry->result_owner;
+    if (proc->pid == entry->result_pid &&
+        atomic_load_u64(&proc->results_outstanding) > 0) {
+        atomic_decrement_u64(&proc->results_outstanding);
+    }
+}
+
+// Общая часть: заполняет entry из заголовка события прямо в финальном узле
+static void routing_entry_fill(RoutingEntry* entry, uint64_t id, uint64_t workflow_id,
+                               uint32_t type, uint64_t timestamp, const uint8_t* route,
+                               uint8_t priority) {
+    entry->event_id = id;
+
+    // Неизвестный класс идёт в NORMAL lane
+    entry->priority = priority < EVENT_PRIORITY_CLASSES ? priority : EVENT_PRIORITY_NORMAL;
 
     // Copy route from RingEvent to RoutingEntry prefixes
     for (int i = 0; i < MAX_ROUTING_STEPS; i++) {
-        entry.prefixes[i] = ring_event->route[i];
+        entry->prefixes[i] = route[i];
+        entry->result_types[i] = RESULT_TYPE_NONE;
     }
 
-    entry.current_index = 0;
-    entry.completion_flags = 0;
-    entry.state = EVENT_STATUS_PROCESSING;
-    entry.created_at = ring_event->timestamp;
-    entry.abort_flag = 0;
-    entry.error_code = 0;
+    entry->state = EVENT_STATUS_PROCESSING;
+    entry->created_at = timestamp;
 
-    // Initialize deck_results and deck_timestamps
-    for (int i = 0; i < MAX_ROUTING_STEPS; i++) {
-        entry.deck_results[i] = 0;
-        entry.deck_timestamps[i] = 0;
+    // Header fields only - payload НЕ копируется
+    entry->event_copy.id = id;
+    entry->event_copy.user_id = workflow_id;  // workflow_id maps to user_id
+    entry->event_copy.timestamp = timestamp;
+    entry->event_copy.type = type;
+    entry->event_copy.flags = 0;
+}
+
+int routing_table_add_event(RoutingTable* table, void* ring_event_ptr, void* result_owner) {
+    return routing_table_add_workflow_event(table, ring_event_ptr, result_owner, 0, 0);
+}
+
+int routing_table_add_workflow_event(RoutingTable* table, void* ring_event_ptr,
+                                     void* result_owner, ResultBuffer* input,
+                                     uint64_t workflow_tag) {
+    RingEvent* ring_event = (RingEvent*)ring_event_ptr;
+
+    // Kernel-side события (workflow engine) приходят с id = 0 - ключ таблицы
+    // должен быть уникален, поэтому назначаем id здесь
+    if (ring_event->id == 0) {
+        extern volatile uint64_t global_event_id_counter;
+        ring_event->id = atomic_increment_u64(&global_event_id_counter);
+        ring_event->timestamp = rdtsc();
+    }
+
+    RoutingEntry* entry = routing_table_alloc_entry();
+    if (!entry) {
+        return 0;
     }
 
-    // Copy RingEvent data to Event structure
-    entry.event_copy.id = ring_event->id;
-    entry.event_copy.user_id = ring_event->workflow_id;  // workflow_id maps to user_id
-    entry.event_copy.timestamp = ring_event->timestamp;
-    entry.event_copy.type = ring_event->type;
-    entry.event_copy.flags = 0;
+    routing_entry_fill(entry, ring_event->id, ring_event->workflow_id, ring_event->type,
+                       ring_event->timestamp, ring_event->route, ring_event->priority);
+    routing_entry_set_result_owner(entry, (process_t*)result_owner);
 
-    // Copy payload (up to EVENT_DATA_SIZE = 224 bytes)
+    // RingEvent вызывающего не переживёт вызов - копируем payload
+    // (остаток payload_data уже обнулён)
     uint32_t copy_size = ring_event->payload_size;
-    if (copy_size > EVENT_DATA_SIZE) {
-        copy_size = EVENT_DATA_SIZE;
+    if (copy_size > ROUTING_PAYLOAD_SIZE) {
+        copy_size = ROUTING_PAYLOAD_SIZE;
+    }
+    memcpy(entry->payload_data, ring_event->payload, copy_size);
+
+    entry->payload = entry->payload_data;
+    entry->payload_size = copy_size;
+    entry->workflow_tag = workflow_tag;
+
+    if (ring_event->buf_flags & RING_EVENT_MEMOIZE) {
+        entry->event_copy.flags |= EVENT_FLAG_MEMOIZE;
+    }
+
+    // ZERO-COPY: decks видят input как registered buffer.
+    // CRITICAL: до link - после link entry уже может взять deck
+    if (input && input->size > 0) {
+        result_buffer_retain(input);
+        entry->input_result = input;
+        entry->buffer = input->data;
+        entry->buffer_length = (uint32_t)input->size;
+    }
+
+    // CRITICAL: credit берётся до link - после link entry уже видит Guide
+    routing_entry_take_credit(entry);
+    if (!routing_table_link_entry(table, entry)) {
+        routing_table_release_entry(entry, ROUTING_POOL_CACHE_GUIDE);  // Credit, pin, input
+        return 0;
+    }
+
+    TRACE_INFO(TRACE_ROUTING_INSERT, ring_event->id, (uint64_t)-1);
+
+    return 1;
+}
+
+// Снимок payload-части user-события (RingEvent или CompactEvent).
+// Поля из shared слота читаются один раз - дальше user может их менять
+typedef struct {
+    const uint8_t* payload;
+    uint32_t payload_size;            // Уже провалидирован (<= ROUTING_PAYLOAD_SIZE)
+    uint32_t buf_flags;
+    uint32_t buf_index;
+    uint32_t buf_offset;
+    uint32_t buf_length;
+} RoutingUserPayload;
+
+// Общая часть ingestion: entry уже заполнен из заголовка события.
+// Payload КОПИРУЕТСЯ: слот user может переписать в любой момент, decks
+// должны валидировать и разбирать один и тот же снимок. Слот вызывающий
+// отпускает сразу после возврата
+static int routing_table_link_user_event(RoutingTable* table, RoutingEntry* entry,
+                                         process_t* proc, uint64_t slot,
+                                         const RoutingUserPayload* user) {
+    // Строковые payload'ы (path, name) должны быть терминированы: terminator
+    // пишем в копию (остаток payload_data уже обнулён alloc'ом)
+    memcpy(entry->payload_data, user->payload, user->payload_size);
+    entry->payload = entry->payload_data;
+    entry->payload_size = user->payload_size;
+    entry->owner = proc;
+    entry->owner_pid = proc->pid;
+    routing_entry_set_result_owner(entry, proc);
+
+    if (user->buf_flags & RING_EVENT_MEMOIZE) {
+        entry->event_copy.flags |= EVENT_FLAG_MEMOIZE;
+    }
+
+    // Registered buffer: границы проверяем сейчас - decks получают уже валидный
+    // указатель. Pin держит страницы, пока entry не освобождён (exit процесса)
+    if (user->buf_flags & RING_EVENT_BUF_REGISTERED) {
+        process_reg_pin_t* pin = NULL;
+        uint8_t* buffer = (uint8_t*)process_reg_buffer_pin(proc, user->buf_index, user->buf_offset,
+                                                           user->buf_length, &pin);
+        if (!buffer) {
+            kprintf("[ROUTING] ERROR: Event ID=%lu: bad registered buffer (index=%u offset=%u length=%u)\n",
+                    entry->event_id, user->buf_index, user->buf_offset, user->buf_length);
+            routing_pool_free(entry, ROUTING_POOL_CACHE_GUIDE);
+            return 0;
+        }
+
+        entry->buffer = buffer;
+        entry->buffer_length = user->buf_length;
+        entry->buffer_pin = pin;
+    }
+
+    routing_entry_take_credit(entry);
+    if (!routing_table_link_entry(table, entry)) {
+        routing_table_release_entry(entry, ROUTING_POOL_CACHE_GUIDE);  // Credit, pin, input
+        return 0;
+    }
+
+    TRACE_INFO(TRACE_ROUTING_INSERT, entry->event_id, slot);
+
+    return 1;
+}
+
+int routing_table_add_ring_event(RoutingTable* table, void* ring_event_ptr,
+                                 void* owner, uint64_t slot) {
+    RingEvent* ring_event = (RingEvent*)ring_event_ptr;
+    process_t* proc = (process_t*)owner;
+
+    RoutingEntry* entry = routing_table_alloc_entry();
+    if (!entry) {
+        return 0;
+    }
+
+    // QoS class пишет user: INTERACTIVE lane обслуживается strict priority
+    // без бюджета, и user, поставивший туда свой поток, морил бы голодом
+    // остальные lanes каждого deck. Она только для kernel (консоль, workflow
+    // с workflow_set_priority) - user получает NORMAL или BULK
+    uint8_t priority = ring_event->priority;
+    if (priority != EVENT_PRIORITY_BULK) {
+        priority = EVENT_PRIORITY_NORMAL;
     }
-    memcpy(entry.event_copy.data, ring_event->payload, copy_size);
 
-    // Zero remaining data
-    if (copy_size < EVENT_DATA_SIZE) {
-        memset(entry.event_copy.data + copy_size, 0, EVENT_DATA_SIZE - copy_size);
+    routing_entry_fill(entry, ring_event->id, ring_event->workflow_id, ring_event->type,
+                       ring_event->timestamp, ring_event->route, priority);
+
+    // payload_size пишет user: ingestion его проверял, но слот мог
+    // измениться - проверяем снимок, который и копируем
+    RoutingUserPayload user;
+    user.payload = ring_event->payload;
+    user.payload_size = ring_event->payload_size;
+    if (user.payload_size > ROUTING_PAYLOAD_SIZE) {
+        routing_pool_free(entry, ROUTING_POOL_CACHE_GUIDE);
+        return 0;
     }
+    user.buf_flags = ring_event->buf_flags;
+    user.buf_index = ring_event->buf_index;
+    user.buf_offset = ring_event->buf_offset;
+    user.buf_length = ring_event->buf_length;
 
-    // Insert into routing table
-    int result = routing_table_insert(table, &entry);
+    return routing_table_link_user_event(table, entry, proc, slot, &user);
+}
+
+int routing_table_add_compact_event(RoutingTable* table, void* compact_event_ptr,
+                                    void* owner, uint64_t slot,
+                                    uint64_t event_id, uint64_t timestamp) {
+    CompactEvent* event = (CompactEvent*)compact_event_ptr;
+    process_t* proc = (process_t*)owner;
+
+    // Запись уже провалидирована ingestion'ом: длина в units, payload внутри записи
+    uint32_t units = COMPACT_SLOT_UNITS(slot);
+    uint32_t payload_size = event->payload_size;
+    uint32_t capacity = units * COMPACT_UNIT_SIZE - sizeof(CompactEvent);
+    if (payload_size > capacity || payload_size > ROUTING_PAYLOAD_SIZE) {
+        return 0;
+    }
 
-    if (result == 0) {
-        // Calculate which bucket this event is in
-        uint64_t bucket_index = ring_event->id % ROUTING_TABLE_SIZE;
-        kprintf("[ROUTING] Added event ID=%lu to bucket %lu (route=[%u,%u,%u,%u])\n",
-                ring_event->id, bucket_index,
-                entry.prefixes[0], entry.prefixes[1], entry.prefixes[2], entry.prefixes[3]);
+    RoutingEntry* entry = routing_table_alloc_entry();
+    if (!entry) {
+        return 0;
     }
 
-    return result;
+    // QoS class - как у RingEvent: INTERACTIVE только для kernel
+    uint8_t priority = event->priority;
+    if (priority != EVENT_PRIORITY_BULK) {
+        priority = EVENT_PRIORITY_NORMAL;
+    }
+
+    // COMPACT: timestamp kernel держит в entry, id ingestion пишет в запись сам
+    routing_entry_fill(entry, event_id, event->workflow_id, event->header.type,
+                       timestamp, event->route, priority);
+
+    RoutingUserPayload user;
+    user.payload = event->payload;
+    user.payload_size = payload_size;
+    user.buf_flags = event->header.flags & (COMPACT_FLAG_BUF_REGISTERED | COMPACT_FLAG_MEMOIZE);
+    user.buf_index = event->buf_index;
+    user.buf_offset = event->buf_offset;
+    user.buf_length = event->buf_length;
+
+    return routing_table_link_user_event(table, entry, proc, slot, &user);
 }
 
 // ============================================================================
@@ -187,12 +841,29 @@ int routing_table_add_event(RoutingTable* table, void* ring_event_ptr) {
 // ============================================================================
 
 void routing_table_print_stats(RoutingTable* table) {
+    RoutingArray* cur = table->array;
     uint64_t total = atomic_load_u64(&table->total_entries);
     uint64_t collisions = atomic_load_u64(&table->collisions);
-
-    // Calculate average chain length per bucket
-    uint64_t avg_chain_length = total / ROUTING_TABLE_SIZE;
-
-    kprintf("[ROUTING_TABLE] entries=%lu collisions=%lu avg_chain=%lu (UNLIMITED capacity)\n",
-            total, collisions, avg_chain_length);
+    uint64_t slots = routing_array_slots(cur);
+
+    // Load factor в процентах (live и live+tombstones)
+    uint64_t load_pct = cur->live * 100 / slots;
+    uint64_t used_pct = cur->used * 100 / slots;
+
+    // Средняя длина пробирования (bucket'ов на операцию) x100
+    uint64_t ops = atomic_load_u64(&table->probe_ops);
+    uint64_t avg_probe_x100 = ops ? atomic_load_u64(&table->probe_total) * 100 / ops : 0;
+
+    kprintf("[ROUTING_TABLE] entries=%lu collisions=%lu buckets=%lu slots=%lu resizes=%lu%s\n",
+            total, collisions, cur->bucket_mask + 1, slots, table->resizes,
+            table->old_array ? " (migrating)" : "");
+    kprintf("[ROUTING_TABLE] load=%lu%% used=%lu%% probe_avg=%lu.%lu%lu probe_max=%lu ops=%lu\n",
+            load_pct, used_pct,
+            avg_probe_x100 / 100, (avg_probe_x100 / 10) % 10, avg_probe_x100 % 10,
+            table->probe_max, ops);
+    kprintf("[ROUTING_TABLE] epoch=%lu reclaimed=%lu%s\n",
+            table->epoch, table->reclaimed,
+            table->retired_head ? " (arrays waiting for grace period)" : "");
+
+    routing_pool_print_stats();
 }
@@ -3,64 +3,105 @@
 
 #include "../core/events.h"
 #include "../core/atomics.h"
+#include "../core/result_buffer.h"
 #include "ktypes.h"
+#include "klib.h"
 
 // ============================================================================
-// ROUTING TABLE - Hash table для хранения routing entries
+// ROUTING TABLE - Open-addressing hash table (event_id → RoutingEntry*)
+// ============================================================================
+//
+// Cache-line buckets по 4 слота (key + pointer), линейное пробирование
+// по bucket'ам. Insert и remove сериализуются lock'ом, lookup - lock-free.
+//
+// Incremental resize: при load factor > 3/4 выделяется новый массив
+// (x2, или тот же размер если много tombstones), старый остаётся в
+// old_array и каждая запись переносит ROUTING_MIGRATE_BUCKETS bucket'ов.
+// Lookup во время resize смотрит old, потом current (перенос пишет в
+// current до tombstone в old). Промах, пока менялась пара массивов
+// (layout_seq), lookup повторяет.
+//
+// Reclamation (epoch): lookup на любом CPU идёт внутри read-side секции,
+// объявленной в per-CPU слоте. Снятый с таблицы массив и detached entry
+// не освобождаются сразу, а retire'ятся с текущей epoch. Guide pass
+// (routing_table_reclaim, BSP) двигает epoch, когда все CPU в секции
+// видели текущую, и освобождает retired на 2 epochs раньше - их уже не
+// держит ни один lookup.
+//
 // ============================================================================
 
-// Размер hash table (должен быть степенью 2)
-// Уменьшено до 64 для экономии памяти и быстрой инициализации
+// Начальный размер (bucket'ов, должен быть степенью 2)
 #define ROUTING_TABLE_SIZE 64
-#define ROUTING_TABLE_MASK (ROUTING_TABLE_SIZE - 1)
 
 _Static_assert((ROUTING_TABLE_SIZE & (ROUTING_TABLE_SIZE - 1)) == 0,
                "ROUTING_TABLE_SIZE must be power of 2");
 
+#define ROUTING_SLOTS_PER_BUCKET  4     // 4 * 16 bytes = одна cache line
+#define ROUTING_MIGRATE_BUCKETS   8     // Bucket'ов переноса на каждую запись
+
+// Специальные ключи (key = event_id + 1, чтобы event_id 0 был валиден)
+#define ROUTING_KEY_EMPTY      0ULL
+#define ROUTING_KEY_TOMBSTONE  (~0ULL)
+
 // ============================================================================
-// ROUTING BUCKET - Bucket в hash table (для разрешения коллизий)
-// ============================================================================
-//
-// DYNAMIC ROUTING TABLE FIX:
-// Changed from fixed array to linked list for unlimited capacity!
-// Each bucket now has a head pointer to a chain of RoutingEntries.
-// This eliminates the 256-entry hard limit (64 buckets * 4 entries).
-//
+// ROUTING BUCKET - Одна cache line слотов
 // ============================================================================
 
 typedef struct {
-    volatile uint32_t lock;    // Spinlock для bucket (0 = unlocked, 1 = locked)
-    uint32_t count;            // Количество entries в цепочке
-    RoutingEntry* head;        // Голова linked list (NULL if empty)
-} RoutingBucket;
+    uint64_t key;                      // event_id + 1, EMPTY или TOMBSTONE
+    RoutingEntry* entry;
+} RoutingSlot;
+
+typedef struct {
+    RoutingSlot slots[ROUTING_SLOTS_PER_BUCKET];
+} __attribute__((aligned(64))) RoutingBucket;
+
+_Static_assert(sizeof(RoutingBucket) == 64, "RoutingBucket must be one cache line");
+
+// Массив bucket'ов + его геометрия
+typedef struct RoutingArray {
+    uint64_t bucket_mask;              // bucket_count - 1
+    uint64_t used;                     // live + tombstones
+    uint64_t live;                     // Живые entries
+    uint64_t pages;                    // Размер аллокации (pmm)
+    struct RoutingArray* retire_next;  // Retired после переноса (ждёт grace period)
+    uint64_t retire_epoch;
+    uint8_t _pad[16];
+    RoutingBucket buckets[];           // aligned(64): header ровно 64 bytes
+} RoutingArray;
+
+_Static_assert(sizeof(RoutingArray) == 64, "RoutingArray header must be one cache line");
 
 // ============================================================================
 // ROUTING TABLE STRUCTURE
 // ============================================================================
 
 typedef struct {
-    RoutingBucket buckets[ROUTING_TABLE_SIZE] __attribute__((aligned(64)));
+    RoutingArray* volatile array;      // Текущий массив (сюда идут inserts)
+    RoutingArray* volatile old_array;  // Массив в процессе переноса (или NULL)
+    uint64_t migrate_pos;              // Следующий bucket old_array для переноса
+    spinlock_t lock;                   // Insert, remove, resize (lookup - без lock)
+    volatile uint64_t layout_seq;      // Нечётный = меняется пара array/old_array
+
+    // Reclamation: epoch (>= 1) и retired массивы (под lock), старые первыми
+    volatile uint64_t epoch;
+    RoutingArray* retired_head;
+    RoutingArray* retired_tail;
+
     volatile uint64_t total_entries;  // Общее количество entries
-    volatile uint64_t collisions;     // Количество коллизий
+    volatile uint64_t collisions;     // Inserts, не попавшие в home bucket
+
+    // Статистика пробирования (bucket'ов на операцию)
+    volatile uint64_t probe_ops;
+    volatile uint64_t probe_total;
+    volatile uint64_t probe_max;
+    volatile uint64_t resizes;
+    volatile uint64_t reclaimed;       // Entries, вернувшиеся в pool после grace period
 } RoutingTable;
 
 // Глобальная routing table
 extern RoutingTable global_routing_table;
 
-// ============================================================================
-// BUCKET LOCKING - Spinlock для bucket
-// ============================================================================
-
-static inline void bucket_lock(RoutingBucket* bucket) {
-    while (!atomic_cas_u32(&bucket->lock, 0, 1)) {
-        cpu_pause();
-    }
-}
-
-static inline void bucket_unlock(RoutingBucket* bucket) {
-    atomic_store_u32(&bucket->lock, 0);
-}
-
 // ============================================================================
 // HASH FUNCTION - Простая и быстрая hash функция
 // ============================================================================
@@ -75,8 +116,9 @@ static inline uint64_t hash_event_id(uint64_t event_id) {
     return event_id;
 }
 
-static inline uint64_t routing_table_index(uint64_t event_id) {
-    return hash_event_id(event_id) & ROUTING_TABLE_MASK;
+// Home bucket для event_id в массиве
+static inline uint64_t routing_table_index(RoutingArray* array, uint64_t event_id) {
+    return hash_event_id(event_id) & array->bucket_mask;
 }
 
 // ============================================================================
@@ -86,25 +128,66 @@ static inline uint64_t routing_table_index(uint64_t event_id) {
 // Инициализация
 void routing_table_init(RoutingTable* table);
 
-// Вставка routing entry
+// Вставка routing entry (копия в новый узел)
 int routing_table_insert(RoutingTable* table, RoutingEntry* entry);
 
-// Поиск routing entry по event_id
+// Поиск routing entry по event_id (lock-free, любой CPU). Указатель
+// валиден, пока entry не detached - разыменовывать может только текущий
+// владелец шага
 RoutingEntry* routing_table_lookup(RoutingTable* table, uint64_t event_id);
 
 // Удаление routing entry (после завершения обработки)
+// = detach + release в cache Guide
 int routing_table_remove(RoutingTable* table, uint64_t event_id);
 
-// Add RingEvent to routing table (creates RoutingEntry)
-int routing_table_add_event(RoutingTable* table, void* ring_event);
-
-// Статистика
+// Убрать entry из таблицы, НЕ освобождая (NULL если не найден)
+RoutingEntry* routing_table_detach(RoutingTable* table, uint64_t event_id);
+
+// Освободить detached entry: result credit, input_result сразу, память -
+// в pool cache после grace period (routing_table_reclaim)
+// cache_id: ROUTING_POOL_CACHE_* (Guide или Execution Deck)
+void routing_table_release_entry(RoutingEntry* entry, uint8_t cache_id);
+
+// Grace period: сдвинуть epoch и вернуть в pool то, что retired
+// 2 epochs назад. Guide pass на BSP (guide_process_all)
+void routing_table_reclaim(RoutingTable* table);
+
+// Add RingEvent to routing table (creates RoutingEntry, COPIES payload)
+// Для kernel-side событий, чей RingEvent живёт на стеке вызывающего
+// result_owner = process_t* получателя результата (NULL = текущий процесс)
+int routing_table_add_event(RoutingTable* table, void* ring_event, void* result_owner);
+
+// То же для workflow node: workflow_tag = WORKFLOW_TAG(instance, node),
+// input = результат предыдущего node (NULL = без input).
+// Entry берёт свою ссылку (retain), decks читают его как entry->buffer;
+// отпускается в routing_table_release_entry()
+int routing_table_add_workflow_event(RoutingTable* table, void* ring_event,
+                                     void* result_owner, ResultBuffer* input,
+                                     uint64_t workflow_tag);
+
+// Add RingEvent that sits in owner's EventRing slot.
+// Entry строится сразу в финальном узле, payload КОПИРУЕТСЯ из слота -
+// вызывающий отпускает слот (EventRing.head) сразу после возврата.
+// owner = process_t*, slot = позиция события в EventRing
+int routing_table_add_ring_event(RoutingTable* table, void* ring_event,
+                                 void* owner, uint64_t slot);
+
+// То же для записи CompactRing (PROCESS_RING_FORMAT_COMPACT).
+// slot = COMPACT_SLOT(pos, units); id/timestamp назначает ingestion
+int routing_table_add_compact_event(RoutingTable* table, void* compact_event,
+                                    void* owner, uint64_t slot,
+                                    uint64_t event_id, uint64_t timestamp);
+
+// Вернуть result credit entry (идемпотентно): результат записан в ResultRing
+// или parked. Release entry возвращает его сам, если этого не случилось
+void routing_entry_return_credit(RoutingEntry* entry);
+
+// Allocate zeroed entry node / link prepared node into the table
+// link: 1 = success, 0 = duplicate event_id или нет памяти под resize
+RoutingEntry* routing_table_alloc_entry(void);
+int routing_table_link_entry(RoutingTable* table, RoutingEntry* entry);
+
+// Статистика (load factor, probe length, resizes)
 void routing_table_print_stats(RoutingTable* table);
 
-// ============================================================================
-// INLINE HELPERS
-// ============================================================================
-
-// REMOVED: routing_table_is_full() - table is now unlimited (only limited by RAM)!
-
 #endif // ROUTING_TABLE_H
@@ -0,0 +1,255 @@
+#include "latency_stats.h"
+#include "atomics.h"
+#include "pmm.h"
+#include "clock.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+// PRODUCTION: ~600KB гистограмм - из pmm, а не BSS (ядро линкуется flat binary)
+static LatencyStats* latency_stats = 0;
+static uint64_t latency_tsc_per_us = 0;     // 0 = не откалиброван, отчёт в cycles
+
+#define LATENCY_STATS_PAGES ((sizeof(LatencyStats) + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE)
+
+static const char* latency_deck_names[LATENCY_STATS_DECKS] = {
+    "Execution", "Operations", "Storage", "Hardware", "Network"
+};
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void latency_stats_init(void) {
+    latency_stats = (LatencyStats*)pmm_alloc_zero(LATENCY_STATS_PAGES);
+    if (!latency_stats) {
+        kprintf("[LATENCY] %[W]No memory for histograms - latency stats disabled%[D]\n");
+        return;
+    }
+
+    // TSC уже откалиброван clock_init() (0 - отчёт в cycles)
+    latency_tsc_per_us = clock_tsc_hz() / 1000000;
+
+    kprintf("[LATENCY] Initialized (%lu KB histograms, TSC %lu MHz)\n",
+            (uint64_t)(LATENCY_STATS_PAGES * PMM_PAGE_SIZE / 1024), latency_tsc_per_us);
+}
+
+// ============================================================================
+// HISTOGRAM
+// ============================================================================
+
+static uint32_t latency_bucket_index(uint64_t value) {
+    // Значения меньше SUB_BUCKETS - по одному на бакет (magnitude 0)
+    if (value < LATENCY_HIST_SUB_BUCKETS) {
+        return (uint32_t)value;
+    }
+
+    uint32_t msb = 63 - (uint32_t)__builtin_clzll(value);
+    uint32_t shift = msb - LATENCY_HIST_SUB_BITS;
+    uint32_t sub = (uint32_t)(value >> shift) & (LATENCY_HIST_SUB_BUCKETS - 1);
+    uint32_t index = (shift + 1) * LATENCY_HIST_SUB_BUCKETS + sub;
+
+    return index < LATENCY_HIST_BUCKETS ? index : LATENCY_HIST_BUCKETS - 1;
+}
+
+// Наибольшее значение, попадающее в бакет (HDR "highest equivalent value")
+static uint64_t latency_bucket_upper(uint32_t index) {
+    uint32_t magnitude = index / LATENCY_HIST_SUB_BUCKETS;
+    uint64_t sub = index % LATENCY_HIST_SUB_BUCKETS;
+
+    if (magnitude == 0) {
+        return sub;
+    }
+    return ((LATENCY_HIST_SUB_BUCKETS + sub + 1) << (magnitude - 1)) - 1;
+}
+
+static void latency_histogram_record(LatencyHistogram* hist, uint64_t value) {
+    atomic_increment_u32(&hist->buckets[latency_bucket_index(value)]);
+    atomic_add_u64(&hist->sum, value);
+    atomic_increment_u64(&hist->count);
+
+    uint64_t max = atomic_load_u64(&hist->max);
+    while (value > max && !atomic_cas_u64(&hist->max, max, value)) {
+        max = atomic_load_u64(&hist->max);
+    }
+}
+
+static uint64_t latency_cycles_to_ns(uint64_t cycles) {
+    if (latency_tsc_per_us == 0) {
+        return cycles;
+    }
+    return cycles * 1000 / latency_tsc_per_us;
+}
+
+uint64_t latency_histogram_percentile_ns(const LatencyHistogram* hist, uint32_t percentile) {
+    uint64_t count = hist->count;
+    if (count == 0) {
+        return 0;
+    }
+    if (percentile > 100) {
+        percentile = 100;
+    }
+
+    // Ранг = ceil(count * p / 100), минимум 1
+    uint64_t rank = (count * percentile + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            // Верхняя граница бакета не больше реального максимума
+            uint64_t upper = latency_bucket_upper(i);
+            if (upper > hist->max) {
+                upper = hist->max;
+            }
+            return latency_cycles_to_ns(upper);
+        }
+    }
+    return latency_cycles_to_ns(hist->max);
+}
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+static LatencyTypeStats* latency_type_stats(RoutingEntry* entry) {
+    uint32_t type = entry->event_copy.type;
+    return &latency_stats->types[type < LATENCY_STATS_EVENT_TYPES ? type : EVENT_MAX];
+}
+
+static LatencyClassStats* latency_class_stats(RoutingEntry* entry) {
+    uint8_t priority = entry->priority;
+    return &latency_stats->classes[priority < EVENT_PRIORITY_CLASSES ? priority : EVENT_PRIORITY_NORMAL];
+}
+
+void latency_stats_record_step(RoutingEntry* entry, uint8_t deck_prefix, uint64_t completed_at) {
+    if (!latency_stats || deck_prefix == DECK_PREFIX_NONE || deck_prefix >= LATENCY_STATS_DECKS) {
+        return;
+    }
+
+    uint64_t dispatched = entry->dispatched_at;
+    uint64_t started = entry->started_at;
+
+    // DEFENSIVE: шаг без отметок (deck вызван в обход Guide/deck loop)
+    if (dispatched != 0 && started >= dispatched && completed_at >= started) {
+        LatencyStageStats* deck = &latency_stats->decks[deck_prefix];
+        LatencyTypeStats* type = latency_type_stats(entry);
+
+        latency_histogram_record(&deck->queue, started - dispatched);
+        latency_histogram_record(&deck->service, completed_at - started);
+        latency_histogram_record(&type->queue, started - dispatched);
+        latency_histogram_record(&type->service, completed_at - started);
+        latency_histogram_record(&latency_class_stats(entry)->queue[deck_prefix], started - dispatched);
+    }
+
+    // Fused следующий шаг начинается сразу, без очереди.
+    // Обычный путь перезапишет обе отметки (Guide dispatch, deck loop)
+    entry->dispatched_at = completed_at;
+    entry->started_at = completed_at;
+}
+
+void latency_stats_record_execution(RoutingEntry* entry, uint64_t started_at, uint64_t published_at) {
+    if (!latency_stats) {
+        return;
+    }
+
+    LatencyStageStats* deck = &latency_stats->decks[DECK_PREFIX_NONE];
+    LatencyTypeStats* type = latency_type_stats(entry);
+    LatencyClassStats* qos = latency_class_stats(entry);
+
+    if (entry->dispatched_at != 0 && started_at >= entry->dispatched_at) {
+        latency_histogram_record(&deck->queue, started_at - entry->dispatched_at);
+        latency_histogram_record(&type->queue, started_at - entry->dispatched_at);
+        latency_histogram_record(&qos->queue[DECK_PREFIX_NONE], started_at - entry->dispatched_at);
+    }
+    if (published_at >= started_at) {
+        latency_histogram_record(&deck->service, published_at - started_at);
+    }
+
+    // Submit-to-result: created_at = rdtsc() при ingestion
+    if (entry->created_at != 0 && published_at >= entry->created_at) {
+        latency_histogram_record(&latency_stats->end_to_end, published_at - entry->created_at);
+        latency_histogram_record(&type->end_to_end, published_at - entry->created_at);
+        latency_histogram_record(&qos->end_to_end, published_at - entry->created_at);
+    }
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+uint64_t latency_stats_type_mean_cycles(uint32_t type) {
+    if (!latency_stats || type >= LATENCY_STATS_EVENT_TYPES) {
+        return 0;
+    }
+
+    LatencyHistogram* hist = &latency_stats->types[type].end_to_end;
+    uint64_t count = atomic_load_u64(&hist->count);
+    return count ? atomic_load_u64(&hist->sum) / count : 0;
+}
+
+uint64_t latency_stats_deck_p99_ns(uint8_t deck_prefix) {
+    if (!latency_stats || deck_prefix >= LATENCY_STATS_DECKS) {
+        return 0;
+    }
+    return latency_histogram_percentile_ns(&latency_stats->decks[deck_prefix].service, 99);
+}
+
+static void latency_print_histogram(const char* name, const char* kind, const LatencyHistogram* hist) {
+    if (hist->count == 0) {
+        return;
+    }
+    kprintf("  %s %s: n=%lu avg=%lu p50=%lu p90=%lu p99=%lu max=%lu\n",
+            name, kind, hist->count,
+            latency_cycles_to_ns(hist->sum / hist->count),
+            latency_histogram_percentile_ns(hist, 50),
+            latency_histogram_percentile_ns(hist, 90),
+            latency_histogram_percentile_ns(hist, 99),
+            latency_cycles_to_ns(hist->max));
+}
+
+void latency_stats_print(void) {
+    kprintf("\n%[H]=== Latency (%s) ===%[D]\n", latency_tsc_per_us ? "ns" : "cycles");
+    if (!latency_stats) {
+        kprintf("  not initialized\n");
+        return;
+    }
+
+    for (uint32_t i = 0; i < LATENCY_STATS_DECKS; i++) {
+        // Порядок pipeline: decks 1-4, затем Execution
+        uint32_t deck = (i + 1) % LATENCY_STATS_DECKS;
+        latency_print_histogram(latency_deck_names[deck], "queue", &latency_stats->decks[deck].queue);
+        latency_print_histogram(latency_deck_names[deck], "service", &latency_stats->decks[deck].service);
+    }
+    latency_print_histogram("Pipeline", "end-to-end", &latency_stats->end_to_end);
+
+    for (uint8_t c = 0; c < EVENT_PRIORITY_CLASSES; c++) {
+        LatencyClassStats* qos = &latency_stats->classes[c];
+        char name[32];
+
+        for (uint32_t i = 0; i < LATENCY_STATS_DECKS; i++) {
+            uint32_t deck = (i + 1) % LATENCY_STATS_DECKS;
+            ksnprintf(name, sizeof(name), "%s/%s", latency_deck_names[deck], event_priority_name(c));
+            latency_print_histogram(name, "queue", &qos->queue[deck]);
+        }
+        latency_print_histogram(event_priority_name(c), "end-to-end", &qos->end_to_end);
+    }
+
+    for (uint32_t t = 0; t < LATENCY_STATS_EVENT_TYPES; t++) {
+        LatencyTypeStats* type = &latency_stats->types[t];
+        if (type->queue.count == 0 && type->service.count == 0 && type->end_to_end.count == 0) {
+            continue;
+        }
+
+        char name[16];
+        ksnprintf(name, sizeof(name), "type %u", t);
+        latency_print_histogram(name, "queue", &type->queue);
+        latency_print_histogram(name, "service", &type->service);
+        latency_print_histogram(name, "end-to-end", &type->end_to_end);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include "ktypes.h"
+#include "events.h"
+
+// ============================================================================
+// LATENCY STATS - Log-bucketed гистограммы задержек pipeline
+// ============================================================================
+//
+// Для каждого шага маршрута RoutingEntry несёт три TSC отметки:
+//   dispatched_at    - Guide положил entry в DeckQueue
+//   started_at       - deck loop взял entry
+//   deck_timestamps  - deck_complete / deck_error
+// queue = started - dispatched, service = completed - started.
+// End-to-end = created_at (ingestion) -> публикация в ResultRing.
+//
+// Гистограммы: per deck (queue, service; 0 = Execution Deck),
+// per event type (queue, service, end-to-end), per priority class
+// (queue в каждой DeckQueue lane, end-to-end) и общая end-to-end.
+//
+// Бакеты HDR-style: magnitude = позиция старшего бита, внутри неё
+// LATENCY_HIST_SUB_BUCKETS линейных под-бакетов - относительная ошибка
+// не больше 1/SUB_BUCKETS при любом масштабе (от cycles до секунд).
+// Запись - несколько lock-инструкций, без блокировок, с любого CPU.
+//
+// ============================================================================
+
+#define LATENCY_HIST_SUB_BITS     2
+#define LATENCY_HIST_SUB_BUCKETS  (1 << LATENCY_HIST_SUB_BITS)       // 25% точность
+#define LATENCY_HIST_MAGNITUDES   48                                 // До 2^48 cycles
+#define LATENCY_HIST_BUCKETS      (LATENCY_HIST_MAGNITUDES * LATENCY_HIST_SUB_BUCKETS)
+
+#define LATENCY_STATS_DECKS       5      // 0 = Execution, 1-4 = DECK_PREFIX_*
+#define LATENCY_STATS_EVENT_TYPES 256    // EventType (EVENT_MAX = 255)
+
+// EVENT_SYSTEM_STATS payload [deck:4]: ALL = полный отчёт в консоль
+#define LATENCY_STATS_QUERY_ALL   0xFFFFFFFF
+
+typedef struct {
+    volatile uint64_t count;
+    volatile uint64_t sum;                           // Cycles
+    volatile uint64_t max;                           // Cycles
+    volatile uint32_t buckets[LATENCY_HIST_BUCKETS];
+} LatencyHistogram;
+
+typedef struct {
+    LatencyHistogram queue;
+    LatencyHistogram service;
+} LatencyStageStats;
+
+typedef struct {
+    LatencyHistogram queue;
+    LatencyHistogram service;
+    LatencyHistogram end_to_end;
+} LatencyTypeStats;
+
+// QoS class: ожидание в своей lane каждого deck
+typedef struct {
+    LatencyHistogram queue[LATENCY_STATS_DECKS];
+    LatencyHistogram end_to_end;
+} LatencyClassStats;
+
+typedef struct {
+    LatencyStageStats decks[LATENCY_STATS_DECKS];
+    LatencyHistogram end_to_end;
+    LatencyTypeStats types[LATENCY_STATS_EVENT_TYPES];
+    LatencyClassStats classes[EVENT_PRIORITY_CLASSES];
+} LatencyStats;
+
+// Выделение гистограмм (частота TSC - из clock_init())
+void latency_stats_init(void);
+
+// Шаг deck завершён (deck_complete/deck_error) в момент completed_at
+void latency_stats_record_step(RoutingEntry* entry, uint8_t deck_prefix, uint64_t completed_at);
+
+// Execution Deck взял entry в started_at и опубликовал результат в published_at
+void latency_stats_record_execution(RoutingEntry* entry, uint64_t started_at, uint64_t published_at);
+
+// Перцентиль (0-100) в наносекундах, 0 если нет данных
+uint64_t latency_histogram_percentile_ns(const LatencyHistogram* hist, uint32_t percentile);
+
+// Средняя end-to-end задержка EventType в cycles (0 = нет истории)
+uint64_t latency_stats_type_mean_cycles(uint32_t type);
+
+// p99 service time deck'а в наносекундах (0 = Execution Deck)
+uint64_t latency_stats_deck_p99_ns(uint8_t deck_prefix);
+
+// Полный отчёт: p50/p90/p99/max по decks, event types, priority classes и end-to-end
+void latency_stats_print(void);
+
+#endif // LATENCY_STATS_H
@@ -0,0 +1,671 @@
+#include "block_cache.h"
+#include "tagfs.h"
+#include "atomics.h"
+#include "klib.h"
+#include "ata.h"
+#include "block_queue.h"
+#include "clock.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+#define BLOCK_CACHE_NONE    ((uint64_t)-1)     // Буфер свободен
+#define BLOCK_CACHE_HASH(b) ((uint32_t)(b) & (BLOCK_CACHE_HASH_BUCKETS - 1))
+
+typedef struct BlockBuffer {
+    uint64_t block;                 // BLOCK_CACHE_NONE = свободен
+    struct BlockBuffer* hash_next;
+    uint32_t pins;
+    uint8_t dirty;
+    uint8_t referenced;             // CLOCK: второй шанс
+    uint8_t prefetched;             // Загружен read-ahead, ещё не прочитан
+    uint8_t io_pending;             // Async fetch: DMA ещё пишет в буфер
+    uint64_t dirty_since;           // clock_ticks() первой записи после flush
+} BlockBuffer;
+
+static uint8_t block_cache_data[BLOCK_CACHE_BUFFERS][TAGFS_BLOCK_SIZE];
+static BlockBuffer block_cache_buffers[BLOCK_CACHE_BUFFERS];
+static BlockBuffer* block_cache_hash[BLOCK_CACHE_HASH_BUCKETS];
+static uint32_t block_cache_hand = 0;
+static uint32_t block_cache_dirty_count = 0;
+static spinlock_t block_cache_lock;
+
+static struct {
+    volatile uint64_t hits;
+    volatile uint64_t misses;
+    volatile uint64_t evictions;
+    volatile uint64_t writebacks;   // Dirty victim записан при eviction
+    volatile uint64_t flushed;      // Записано flush / flusher
+    volatile uint64_t runs;         // ATA команд на flushed блоки
+    volatile uint64_t direct;       // Блоков span передано мимо буферов
+    volatile uint64_t prefetched;   // Блоков загружено read-ahead
+    volatile uint64_t prefetch_hits;    // Из них потом прочитано
+    volatile uint64_t prefetch_wasted;  // Вытеснено непрочитанными
+    volatile uint64_t async_commands;   // Команд async fetch отправлено
+    volatile uint64_t io_waits;         // Обращений к буферу с io_pending
+    volatile uint64_t io_errors;
+} block_cache_stats;
+
+// Staging для multi-sector чтения prefetch (буферы cache не подряд в памяти)
+static uint8_t block_cache_prefetch_stage[BLOCK_CACHE_PREFETCH_MAX][TAGFS_BLOCK_SIZE];
+
+// Async fetch: команда ATA и буферы, которые она заполняет (DMA gather -
+// staging не нужен)
+typedef struct {
+    ATARequest request;
+    BlockBuffer* buffers[BLOCK_CACHE_PREFETCH_MAX];
+    uint32_t count;
+    BlockCacheIoDone done;
+    void* context;
+    uint8_t in_use;
+} BlockCacheIo;
+
+static BlockCacheIo block_cache_io[BLOCK_CACHE_ASYNC_MAX];
+
+static void cache_io_done(ATARequest* request);
+
+static inline uint8_t* buffer_data(BlockBuffer* buffer) {
+    return block_cache_data[buffer - block_cache_buffers];
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void block_cache_init(void) {
+    spinlock_init(&block_cache_lock);
+    memset(block_cache_hash, 0, sizeof(block_cache_hash));
+    memset(block_cache_buffers, 0, sizeof(block_cache_buffers));
+    for (uint32_t i = 0; i < BLOCK_CACHE_BUFFERS; i++) {
+        block_cache_buffers[i].block = BLOCK_CACHE_NONE;
+    }
+    memset(block_cache_io, 0, sizeof(block_cache_io));
+    block_cache_hand = 0;
+    block_cache_dirty_count = 0;
+
+    kprintf("[BCACHE] %d buffers x %d bytes, CLOCK eviction, write-back after %d ticks\n",
+            BLOCK_CACHE_BUFFERS, TAGFS_BLOCK_SIZE, BLOCK_CACHE_DIRTY_AGE);
+}
+
+// ============================================================================
+// HASH + CLOCK (под block_cache_lock)
+// ============================================================================
+
+static BlockBuffer* cache_lookup(uint64_t block) {
+    BlockBuffer* buffer = block_cache_hash[BLOCK_CACHE_HASH(block)];
+    while (buffer && buffer->block != block) {
+        buffer = buffer->hash_next;
+    }
+    return buffer;
+}
+
+// Lookup, дождавшись async fetch буфера: lock отпускается на ожидание,
+// in-flight команду доводим сами (IRQ у caller может быть запрещён)
+static BlockBuffer* cache_lookup_ready(uint64_t block) {
+    BlockBuffer* buffer = cache_lookup(block);
+    if (buffer && buffer->io_pending) {
+        atomic_increment_u64(&block_cache_stats.io_waits);
+    }
+    while (buffer && buffer->io_pending) {
+        spin_unlock(&block_cache_lock);
+        block_queue_poll();
+        block_queue_reap();
+        cpu_relax();
+        spin_lock(&block_cache_lock);
+        buffer = cache_lookup(block);
+    }
+    return buffer;
+}
+
+static void cache_unhash(BlockBuffer* buffer) {
+    BlockBuffer** link = &block_cache_hash[BLOCK_CACHE_HASH(buffer->block)];
+    while (*link && *link != buffer) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = buffer->hash_next;
+    }
+    buffer->hash_next = 0;
+    buffer->block = BLOCK_CACHE_NONE;
+    if (buffer->prefetched) {
+        buffer->prefetched = 0;
+        atomic_increment_u64(&block_cache_stats.prefetch_wasted);
+    }
+}
+
+// Первое чтение блока, загруженного read-ahead
+static inline void cache_note_use(BlockBuffer* buffer) {
+    if (buffer->prefetched) {
+        buffer->prefetched = 0;
+        atomic_increment_u64(&block_cache_stats.prefetch_hits);
+    }
+}
+
+static void cache_mark_clean(BlockBuffer* buffer) {
+    if (buffer->dirty) {
+        buffer->dirty = 0;
+        block_cache_dirty_count--;
+    }
+}
+
+static int cache_write_back(BlockBuffer* buffer) {
+    if (ata_write_block(buffer->block, buffer_data(buffer)) != 0) {
+        atomic_increment_u64(&block_cache_stats.io_errors);
+        kprintf("[BCACHE] %[E]Write-back of block %lu failed%[D]\n", buffer->block);
+        return -1;
+    }
+    cache_mark_clean(buffer);
+    return 0;
+}
+
+// Свободный буфер или CLOCK victim: referenced сбрасывается на первом
+// проходе, берётся на втором. Привязанные пропускаются
+static BlockBuffer* cache_select_victim(void) {
+    for (uint32_t step = 0; step < 2 * BLOCK_CACHE_BUFFERS; step++) {
+        BlockBuffer* buffer = &block_cache_buffers[block_cache_hand];
+        block_cache_hand = (block_cache_hand + 1) % BLOCK_CACHE_BUFFERS;
+
+        if (buffer->block == BLOCK_CACHE_NONE) {
+            return buffer;
+        }
+        if (buffer->pins > 0) {
+            continue;
+        }
+        if (buffer->referenced) {
+            buffer->referenced = 0;
+            continue;
+        }
+        return buffer;
+    }
+    return 0;
+}
+
+// ============================================================================
+// GET / PUT
+// ============================================================================
+
+uint8_t* block_cache_get(uint64_t block, uint32_t mode) {
+    spin_lock(&block_cache_lock);
+
+    BlockBuffer* buffer = cache_lookup_ready(block);
+    if (buffer) {
+        buffer->pins++;
+        buffer->referenced = 1;
+        cache_note_use(buffer);
+        if (mode == BLOCK_CACHE_ZERO) {
+            memset(buffer_data(buffer), 0, TAGFS_BLOCK_SIZE);
+        }
+        spin_unlock(&block_cache_lock);
+        atomic_increment_u64(&block_cache_stats.hits);
+        return buffer_data(buffer);
+    }
+
+    atomic_increment_u64(&block_cache_stats.misses);
+
+    buffer = cache_select_victim();
+    if (!buffer) {
+        spin_unlock(&block_cache_lock);
+        kprintf("[BCACHE] %[E]All %d buffers pinned (block %lu)%[D]\n",
+                BLOCK_CACHE_BUFFERS, block);
+        return 0;
+    }
+
+    if (buffer->block != BLOCK_CACHE_NONE) {
+        // CRITICAL: dirty данные victim - единственная копия
+        if (buffer->dirty) {
+            if (cache_write_back(buffer) != 0) {
+                spin_unlock(&block_cache_lock);
+                return 0;
+            }
+            atomic_increment_u64(&block_cache_stats.writebacks);
+        }
+        cache_unhash(buffer);
+        atomic_increment_u64(&block_cache_stats.evictions);
+    }
+
+    uint8_t* data = buffer_data(buffer);
+    if (mode == BLOCK_CACHE_ZERO) {
+        memset(data, 0, TAGFS_BLOCK_SIZE);
+    } else if (ata_read_block(block, data) != 0) {
+        spin_unlock(&block_cache_lock);
+        atomic_increment_u64(&block_cache_stats.io_errors);
+        kprintf("[BCACHE] %[E]Read of block %lu failed%[D]\n", block);
+        return 0;
+    }
+
+    buffer->block = block;
+    buffer->pins = 1;
+    buffer->referenced = 1;
+    buffer->dirty = 0;
+    buffer->hash_next = block_cache_hash[BLOCK_CACHE_HASH(block)];
+    block_cache_hash[BLOCK_CACHE_HASH(block)] = buffer;
+
+    spin_unlock(&block_cache_lock);
+    return data;
+}
+
+void block_cache_put(uint64_t block, int dirty) {
+    spin_lock(&block_cache_lock);
+
+    BlockBuffer* buffer = cache_lookup(block);
+    if (!buffer || buffer->pins == 0) {
+        spin_unlock(&block_cache_lock);
+        kprintf("[BCACHE] %[W]put of unpinned block %lu%[D]\n", block);
+        return;
+    }
+
+    buffer->pins--;
+    if (dirty && !buffer->dirty) {
+        buffer->dirty = 1;
+        buffer->dirty_since = clock_ticks();
+        block_cache_dirty_count++;
+    }
+
+    spin_unlock(&block_cache_lock);
+}
+
+// ============================================================================
+// SPANS - полные блоки extent одной передачей
+// ============================================================================
+
+int block_cache_read_span(uint64_t start, uint64_t count, uint8_t* buffer) {
+    int result = 0;
+
+    spin_lock(&block_cache_lock);
+    for (uint64_t i = 0; i < count; ) {
+        BlockBuffer* cached = cache_lookup_ready(start + i);
+        if (cached) {
+            // CRITICAL: в cache может быть dirty версия новее диска
+            memcpy(buffer + i * TAGFS_BLOCK_SIZE, buffer_data(cached), TAGFS_BLOCK_SIZE);
+            cache_note_use(cached);
+            i++;
+            continue;
+        }
+
+        uint64_t run = 1;
+        while (i + run < count && !cache_lookup(start + i + run)) {
+            run++;
+        }
+        if (ata_read_blocks(start + i, run, buffer + i * TAGFS_BLOCK_SIZE) != 0) {
+            atomic_increment_u64(&block_cache_stats.io_errors);
+            kprintf("[BCACHE] %[E]Span read of blocks %lu-%lu failed%[D]\n",
+                    start + i, start + i + run - 1);
+            result = -1;
+            break;
+        }
+        atomic_add_u64(&block_cache_stats.direct, run);
+        i += run;
+    }
+    spin_unlock(&block_cache_lock);
+
+    return result;
+}
+
+// ============================================================================
+// PREFETCH - read-ahead в свободные / чистые буферы
+// ============================================================================
+
+uint32_t block_cache_prefetch(uint64_t start, uint32_t count) {
+    uint32_t fetched = 0;
+
+    spin_lock(&block_cache_lock);
+    for (uint32_t i = 0; i < count; ) {
+        if (cache_lookup(start + i)) {
+            i++;
+            continue;
+        }
+
+        uint32_t run = 1;
+        while (i + run < count && run < BLOCK_CACHE_PREFETCH_MAX && !cache_lookup(start + i + run)) {
+            run++;
+        }
+
+        // Victims: block ставится сразу, pins = 1 - CLOCK не выберет буфер дважды
+        BlockBuffer* victims[BLOCK_CACHE_PREFETCH_MAX];
+        uint32_t got = 0;
+        while (got < run) {
+            BlockBuffer* buffer = cache_select_victim();
+            if (!buffer || buffer->dirty) {
+                break;
+            }
+            if (buffer->block != BLOCK_CACHE_NONE) {
+                cache_unhash(buffer);
+                atomic_increment_u64(&block_cache_stats.evictions);
+            }
+            buffer->block = start + i + got;
+            buffer->pins = 1;
+            victims[got++] = buffer;
+        }
+
+        int failed = got > 0 && ata_read_blocks(start + i, got, block_cache_prefetch_stage[0]) != 0;
+        for (uint32_t k = 0; k < got; k++) {
+            BlockBuffer* buffer = victims[k];
+            buffer->pins = 0;
+            if (failed) {
+                buffer->block = BLOCK_CACHE_NONE;
+                continue;
+            }
+            memcpy(buffer_data(buffer), block_cache_prefetch_stage[k], TAGFS_BLOCK_SIZE);
+            buffer->referenced = 0;
+            buffer->prefetched = 1;
+            buffer->dirty = 0;
+            buffer->hash_next = block_cache_hash[BLOCK_CACHE_HASH(buffer->block)];
+            block_cache_hash[BLOCK_CACHE_HASH(buffer->block)] = buffer;
+        }
+
+        if (failed) {
+            atomic_increment_u64(&block_cache_stats.io_errors);
+            kprintf("[BCACHE] %[E]Prefetch of blocks %lu-%lu failed%[D]\n",
+                    start + i, start + i + got - 1);
+            break;
+        }
+        fetched += got;
+        if (got < run) {
+            break;  // Чистых буферов больше нет
+        }
+        i += got;
+    }
+    spin_unlock(&block_cache_lock);
+
+    atomic_add_u64(&block_cache_stats.prefetched, fetched);
+    return fetched;
+}
+
+// ============================================================================
+// ASYNC FETCH - DMA прямо в буферы cache через block queue, завершение
+// из block_queue_reap()
+// ============================================================================
+
+static BlockCacheIo* cache_io_alloc(void) {
+    for (uint32_t i = 0; i < BLOCK_CACHE_ASYNC_MAX; i++) {
+        if (!block_cache_io[i].in_use) {
+            block_cache_io[i].in_use = 1;
+            return &block_cache_io[i];
+        }
+    }
+    return 0;
+}
+
+// Снять буфер с async fetch, который так и не ушёл на устройство
+static void cache_io_unwind(BlockCacheIo* io, uint32_t count) {
+    for (uint32_t k = 0; k < count; k++) {
+        io->buffers[k]->pins = 0;
+        io->buffers[k]->io_pending = 0;
+        cache_unhash(io->buffers[k]);
+    }
+    io->in_use = 0;
+}
+
+int block_cache_fetch_async(uint64_t start, uint32_t count, BlockCacheIoDone done, void* context) {
+    if (!ata_async_available()) {
+        return -1;
+    }
+
+    int submitted = 0;
+
+    spin_lock(&block_cache_lock);
+    for (uint32_t i = 0; i < count; ) {
+        // io_pending блок уже читается - его тоже не ждём здесь
+        if (cache_lookup(start + i)) {
+            i++;
+            continue;
+        }
+
+        uint32_t run = 1;
+        while (i + run < count && run < BLOCK_CACHE_PREFETCH_MAX && !cache_lookup(start + i + run)) {
+            run++;
+        }
+
+        BlockCacheIo* io = cache_io_alloc();
+        if (!io) {
+            break;  // Все команды в полёте
+        }
+
+        // Как prefetch: только чистые victims. Буфер хешируется сразу -
+        // lookup увидит io_pending и подождёт, а не прочитает блок второй раз
+        uint32_t got = 0;
+        while (got < run) {
+            BlockBuffer* buffer = cache_select_victim();
+            if (!buffer || buffer->dirty) {
+                break;
+            }
+            if (buffer->block != BLOCK_CACHE_NONE) {
+                cache_unhash(buffer);
+                atomic_increment_u64(&block_cache_stats.evictions);
+            }
+            buffer->block = start + i + got;
+            buffer->pins = 1;
+            buffer->io_pending = 1;
+            buffer->referenced = 0;
+            buffer->dirty = 0;
+            buffer->hash_next = block_cache_hash[BLOCK_CACHE_HASH(buffer->block)];
+            block_cache_hash[BLOCK_CACHE_HASH(buffer->block)] = buffer;
+
+            io->buffers[got] = buffer;
+            io->request.chunks[got] = buffer_data(buffer);
+            got++;
+        }
+        if (got == 0) {
+            io->in_use = 0;
+            break;  // Чистых буферов больше нет
+        }
+
+        io->count = got;
+        io->done = done;
+        io->context = context;
+        io->request.is_master = 1;
+        io->request.write = 0;
+        io->request.lba = (start + i) * 8;
+        io->request.count = got * 8;
+        io->request.chunk_sectors = 8;
+        io->request.done = cache_io_done;
+        io->request.context = io;
+
+        if (block_queue_submit(&io->request) != 0) {
+            cache_io_unwind(io, got);
+            break;
+        }
+        submitted++;
+        atomic_increment_u64(&block_cache_stats.async_commands);
+
+        if (got < run) {
+            break;
+        }
+        i += got;
+    }
+    spin_unlock(&block_cache_lock);
+
+    return submitted;
+}
+
+static void cache_io_done(ATARequest* request) {
+    BlockCacheIo* io = (BlockCacheIo*)request->context;
+    int status = request->status;
+    uint32_t count = io->count;
+    uint64_t first = io->buffers[0]->block;
+
+    spin_lock(&block_cache_lock);
+    for (uint32_t k = 0; k < count; k++) {
+        BlockBuffer* buffer = io->buffers[k];
+        buffer->pins = 0;
+        buffer->io_pending = 0;
+        if (status != 0) {
+            cache_unhash(buffer);
+        } else {
+            buffer->prefetched = 1;
+        }
+    }
+    BlockCacheIoDone done = io->done;
+    void* context = io->context;
+    io->in_use = 0;
+    spin_unlock(&block_cache_lock);
+
+    if (status != 0) {
+        atomic_increment_u64(&block_cache_stats.io_errors);
+        kprintf("[BCACHE] %[E]Async fetch of blocks %lu-%lu failed%[D]\n",
+                first, first + count - 1);
+    } else {
+        atomic_add_u64(&block_cache_stats.prefetched, count);
+    }
+
+    if (done) {
+        done(context, status);
+    }
+}
+
+int block_cache_write_span(uint64_t start, uint64_t count, const uint8_t* buffer) {
+    spin_lock(&block_cache_lock);
+
+    // CRITICAL: async fetch, закончившийся после записи, вернул бы в cache старые данные
+    for (uint64_t i = 0; i < count; i++) {
+        cache_lookup_ready(start + i);
+    }
+
+    if (ata_write_blocks(start, count, buffer) != 0) {
+        spin_unlock(&block_cache_lock);
+        atomic_increment_u64(&block_cache_stats.io_errors);
+        kprintf("[BCACHE] %[E]Span write of blocks %lu-%lu failed%[D]\n",
+                start, start + count - 1);
+        return -1;
+    }
+
+    // Закешированные копии совпадают с диском
+    for (uint64_t i = 0; i < count; i++) {
+        BlockBuffer* cached = cache_lookup(start + i);
+        if (cached) {
+            memcpy(buffer_data(cached), buffer + i * TAGFS_BLOCK_SIZE, TAGFS_BLOCK_SIZE);
+            cache_mark_clean(cached);
+        }
+    }
+    spin_unlock(&block_cache_lock);
+
+    atomic_add_u64(&block_cache_stats.direct, count);
+    return 0;
+}
+
+void block_cache_invalidate(uint64_t block) {
+    spin_lock(&block_cache_lock);
+
+    BlockBuffer* buffer = cache_lookup_ready(block);
+    if (buffer) {
+        cache_mark_clean(buffer);
+        if (buffer->pins == 0) {
+            cache_unhash(buffer);
+        }
+    }
+
+    spin_unlock(&block_cache_lock);
+}
+
+// ============================================================================
+// WRITE-BACK
+// ============================================================================
+
+// Пишет list (сортируется по номеру блока): подряд идущие блоки - одной
+// multi-sector командой. Возвращает записанные буферы, -1 в *error при ошибке
+static uint64_t cache_write_runs(BlockBuffer** list, uint32_t count, int* error) {
+    for (uint32_t i = 1; i < count; i++) {
+        BlockBuffer* buffer = list[i];
+        uint32_t j = i;
+        while (j > 0 && list[j - 1]->block > buffer->block) {
+            list[j] = list[j - 1];
+            j--;
+        }
+        list[j] = buffer;
+    }
+
+    const uint8_t* run_data[BLOCK_CACHE_BUFFERS];
+    uint64_t written = 0;
+
+    for (uint32_t first = 0; first < count; ) {
+        uint32_t length = 1;
+        run_data[0] = buffer_data(list[first]);
+        while (first + length < count &&
+               list[first + length]->block == list[first]->block + length) {
+            run_data[length] = buffer_data(list[first + length]);
+            length++;
+        }
+
+        if (ata_write_blocks_gather(list[first]->block, length, run_data) != 0) {
+            atomic_increment_u64(&block_cache_stats.io_errors);
+            kprintf("[BCACHE] %[E]Write-back of blocks %lu-%lu failed%[D]\n",
+                    list[first]->block, list[first]->block + length - 1);
+            *error = -1;
+        } else {
+            for (uint32_t i = 0; i < length; i++) {
+                cache_mark_clean(list[first + i]);
+            }
+            written += length;
+            atomic_increment_u64(&block_cache_stats.runs);
+        }
+        first += length;
+    }
+    return written;
+}
+
+int block_cache_flush(void) {
+    BlockBuffer* list[BLOCK_CACHE_BUFFERS];
+    uint32_t count = 0;
+    int error = 0;
+
+    spin_lock(&block_cache_lock);
+    for (uint32_t i = 0; i < BLOCK_CACHE_BUFFERS; i++) {
+        BlockBuffer* buffer = &block_cache_buffers[i];
+        if (buffer->block != BLOCK_CACHE_NONE && buffer->dirty) {
+            list[count++] = buffer;
+        }
+    }
+    uint64_t written = cache_write_runs(list, count, &error);
+    spin_unlock(&block_cache_lock);
+
+    atomic_add_u64(&block_cache_stats.flushed, written);
+    return error;
+}
+
+void block_cache_flush_idle(void) {
+    // Вызывается из deck loop (в том числе из timer IRQ) - не ждём
+    if (block_cache_dirty_count == 0 || !spin_trylock(&block_cache_lock)) {
+        return;
+    }
+
+    BlockBuffer* list[BLOCK_CACHE_BUFFERS];
+    uint32_t count = 0;
+    uint64_t now = clock_ticks();
+    int error = 0;
+
+    for (uint32_t i = 0; i < BLOCK_CACHE_BUFFERS && count < BLOCK_CACHE_FLUSH_BATCH; i++) {
+        BlockBuffer* buffer = &block_cache_buffers[i];
+        if (buffer->block != BLOCK_CACHE_NONE && buffer->dirty && buffer->pins == 0 &&
+            now - buffer->dirty_since >= BLOCK_CACHE_DIRTY_AGE) {
+            list[count++] = buffer;
+        }
+    }
+    uint64_t written = cache_write_runs(list, count, &error);
+    spin_unlock(&block_cache_lock);
+
+    atomic_add_u64(&block_cache_stats.flushed, written);
+}
+
+void block_cache_print_stats(void) {
+    uint64_t hits = atomic_load_u64(&block_cache_stats.hits);
+    uint64_t misses = atomic_load_u64(&block_cache_stats.misses);
+    uint64_t total = hits + misses;
+
+    kprintf("  Block cache:     hits=%lu misses=%lu (%lu%% hit) dirty=%u/%d\n",
+            hits, misses, total ? hits * 100 / total : 0,
+            block_cache_dirty_count, BLOCK_CACHE_BUFFERS);
+    kprintf("                   span blocks=%lu\n", atomic_load_u64(&block_cache_stats.direct));
+    kprintf("                   prefetched=%lu used=%lu wasted=%lu async=%lu io_waits=%lu\n",
+            atomic_load_u64(&block_cache_stats.prefetched),
+            atomic_load_u64(&block_cache_stats.prefetch_hits),
+            atomic_load_u64(&block_cache_stats.prefetch_wasted),
+            atomic_load_u64(&block_cache_stats.async_commands),
+            atomic_load_u64(&block_cache_stats.io_waits));
+    kprintf("                   evictions=%lu writebacks=%lu flushed=%lu in %lu runs io_errors=%lu\n",
+            atomic_load_u64(&block_cache_stats.evictions),
+            atomic_load_u64(&block_cache_stats.writebacks),
+            atomic_load_u64(&block_cache_stats.flushed),
+            atomic_load_u64(&block_cache_stats.runs),
+            atomic_load_u64(&block_cache_stats.io_errors));
+}
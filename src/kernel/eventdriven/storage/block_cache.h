@@ -0,0 +1,92 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// BLOCK CACHE - write-back буферы 4KB блоков между TagFS и ATA
+// ============================================================================
+//
+// Только disk mode. Блоки data region (data_blocks_start..total_blocks)
+// TagFS берёт через cache: hit - без PIO, miss - один ata_read_block.
+// Metadata (superblock, inode table) живут в tagfs_storage постоянно.
+//
+//   lookup    - hash по номеру блока
+//   eviction  - CLOCK (second chance) среди непривязанных буферов;
+//               dirty victim пишется на диск перед переиспользованием
+//   write     - put(dirty) только помечает буфер, на диск - позже:
+//               background flusher (блоки старше BLOCK_CACHE_DIRTY_AGE,
+//               из idle прохода Storage Deck) или block_cache_flush()
+//               из tagfs_sync. Подряд идущие dirty блоки - одна
+//               multi-sector команда (ata_write_blocks_gather)
+//
+// Буфер привязан (pin) между get и put - пока привязан, не вытесняется.
+// TagFS держит одновременно не больше одного буфера.
+//
+// Prefetch (read-ahead) - блоки, которых нет в cache, одной multi-sector
+// командой в чистые непривязанные буферы, referenced = 0: не прочитанные
+// вытесняются первыми. Dirty victims prefetch не трогает - спекулятивное
+// чтение не вызывает write-back.
+//
+// Async fetch - то же, что prefetch, но без ожидания: буферы получают
+// блоки сразу (io_pending, привязаны), команды идут через block queue
+// (сортировка и склейка с соседними), DMA пишет прямо в буферы, завершение -
+// IRQ / опрос диска, колбэк - из block_queue_reap(). Кто наткнулся на
+// io_pending буфер (get, span, invalidate), ждёт его, доводя I/O сам.
+//
+// Span (read_span / write_span) - выровненные полные блоки extent: одна
+// multi-sector передача мимо буферов, cache не вытесняется потоковым I/O.
+// Закешированные блоки span берутся из cache (read) / обновляются (write).
+//
+// ============================================================================
+
+#define BLOCK_CACHE_BUFFERS         64      // 256KB
+#define BLOCK_CACHE_HASH_BUCKETS    128     // Степень 2
+#define BLOCK_CACHE_DIRTY_AGE       50      // Clock ticks (~500ms) до write-back
+#define BLOCK_CACHE_FLUSH_BATCH     4       // Блоков за один проход flusher
+#define BLOCK_CACHE_PREFETCH_MAX    16      // Блоков за одну команду prefetch (staging 64KB)
+#define BLOCK_CACHE_ASYNC_MAX       8       // Async fetch команд в полёте
+
+// Режим get при miss
+#define BLOCK_CACHE_READ            0       // Содержимое с диска
+#define BLOCK_CACHE_ZERO            1       // Новый блок: нули без чтения
+
+void block_cache_init(void);
+
+// Данные блока (TAGFS_BLOCK_SIZE), буфер привязан до block_cache_put().
+// 0 = ошибка чтения / все буферы привязаны
+uint8_t* block_cache_get(uint64_t block, uint32_t mode);
+void block_cache_put(uint64_t block, int dirty);
+
+// [start, start + count) целиком. 0 = успех, -1 = ошибка I/O.
+// write_span - write-through: блоки на диске сразу
+int block_cache_read_span(uint64_t start, uint64_t count, uint8_t* buffer);
+int block_cache_write_span(uint64_t start, uint64_t count, const uint8_t* buffer);
+
+// [start, start + count) в cache. Возвращает блоков прочитано с диска
+// (уже закешированные пропускаются); меньше недостающих - кончились чистые
+// буферы или ошибка I/O
+uint32_t block_cache_prefetch(uint64_t start, uint32_t count);
+
+// Завершение одной команды async fetch: status 0 = блоки в cache
+typedef void (*BlockCacheIoDone)(void* context, int status);
+
+// Недостающие блоки [start, start + count) - async командами (по одной на
+// run, до BLOCK_CACHE_PREFETCH_MAX блоков). Возвращает команд отправлено:
+// done(context, status) будет вызван столько раз. 0 - ждать нечего (всё в
+// cache / уже читается, нет буферов), -1 - async недоступен (нет DMA)
+int block_cache_fetch_async(uint64_t start, uint32_t count, BlockCacheIoDone done, void* context);
+
+// Блок освобождён в FS: буфер отбрасывается без записи
+void block_cache_invalidate(uint64_t block);
+
+// Все dirty буферы на диск. 0 = успех, -1 = ошибка записи (буфер остаётся dirty)
+int block_cache_flush(void);
+
+// Background flusher: до BLOCK_CACHE_FLUSH_BATCH старых непривязанных dirty буферов.
+// Не ждёт lock - занят, пропускает проход
+void block_cache_flush_idle(void);
+
+void block_cache_print_stats(void);
+
+#endif // BLOCK_CACHE_H
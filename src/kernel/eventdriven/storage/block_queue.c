@@ -0,0 +1,339 @@
+#include "block_queue.h"
+#include "atomics.h"
+#include "klib.h"
+#include "clock.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+// Команда устройства: один или несколько склеенных запросов caller'ов
+// (members, по LBA, связаны через ATARequest.next)
+typedef struct BlockQueueCommand {
+    ATARequest request;
+    ATARequest* members;
+    ATARequest* members_tail;
+    uint32_t member_count;
+    uint64_t queued_at;             // clock_ticks() самого старого member
+    struct BlockQueueCommand* next;
+    uint8_t in_use;
+} BlockQueueCommand;
+
+static BlockQueueCommand block_queue_commands[BLOCK_QUEUE_COMMANDS];
+static BlockQueueCommand* block_queue_waiting = NULL;  // По LBA
+static BlockQueueCommand* block_queue_failed = NULL;   // Драйвер отверг, done(-1) из reap
+static uint32_t block_queue_waiting_count = 0;
+static uint32_t block_queue_inflight = 0;
+static uint32_t block_queue_plugged = 0;
+static uint64_t block_queue_position = 0;              // LBA за последней отправленной
+static spinlock_t block_queue_lock;
+
+static struct {
+    volatile uint64_t submitted;    // Запросов принято
+    volatile uint64_t merged;       // Из них склеено с соседним
+    volatile uint64_t dispatched;   // Команд отдано драйверу
+    volatile uint64_t expired;      // Из них по deadline, вне C-SCAN
+    volatile uint64_t failed;       // Драйвер отверг при отправке
+    volatile uint64_t max_waiting;
+} block_queue_stats;
+
+static void queue_command_done(ATARequest* request);
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void block_queue_init(void) {
+    spinlock_init(&block_queue_lock);
+    memset(block_queue_commands, 0, sizeof(block_queue_commands));
+    block_queue_waiting = NULL;
+    block_queue_failed = NULL;
+    block_queue_waiting_count = 0;
+    block_queue_inflight = 0;
+    block_queue_plugged = 0;
+    block_queue_position = 0;
+
+    kprintf("[BQUEUE] %d commands, merge up to %d sectors, C-SCAN, deadline %d ticks\n",
+            BLOCK_QUEUE_COMMANDS, BLOCK_QUEUE_MAX_SECTORS, BLOCK_QUEUE_EXPIRE);
+}
+
+// ============================================================================
+// COMMANDS (под block_queue_lock)
+// ============================================================================
+
+static BlockQueueCommand* queue_command_alloc(void) {
+    for (uint32_t i = 0; i < BLOCK_QUEUE_COMMANDS; i++) {
+        if (!block_queue_commands[i].in_use) {
+            block_queue_commands[i].in_use = 1;
+            return &block_queue_commands[i];
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t queue_chunks(const ATARequest* request) {
+    return (request->count + request->chunk_sectors - 1) / request->chunk_sectors;
+}
+
+// low и high подряд по LBA - одна команда? merged = склеенная
+static int queue_can_merge(const ATARequest* low, const ATARequest* high, ATARequest* merged) {
+    if (low->write != high->write || low->is_master != high->is_master ||
+        low->chunk_sectors != high->chunk_sectors ||
+        low->lba + low->count != high->lba ||
+        low->count % low->chunk_sectors != 0 ||  // Хвост low - целый chunk
+        low->count + high->count > BLOCK_QUEUE_MAX_SECTORS) {
+        return 0;
+    }
+
+    uint32_t low_chunks = queue_chunks(low);
+    uint32_t high_chunks = queue_chunks(high);
+    if (low_chunks + high_chunks > ATA_REQUEST_MAX_CHUNKS) {
+        return 0;
+    }
+
+    *merged = *low;
+    merged->count = low->count + high->count;
+    for (uint32_t k = 0; k < high_chunks; k++) {
+        merged->chunks[low_chunks + k] = high->chunks[k];
+    }
+
+    // Лимиты драйвера (сектора на команду, DMA границы) - его решение
+    return ata_request_valid(merged);
+}
+
+// high целиком в low, high освобождается. 0 = не склеились
+static int queue_merge(BlockQueueCommand* low, BlockQueueCommand* high) {
+    ATARequest merged;
+    if (!queue_can_merge(&low->request, &high->request, &merged)) {
+        return 0;
+    }
+
+    low->request = merged;
+    low->members_tail->next = high->members;
+    low->members_tail = high->members_tail;
+    low->member_count += high->member_count;
+    if (high->queued_at < low->queued_at) {
+        low->queued_at = high->queued_at;
+    }
+    high->in_use = 0;
+    return 1;
+}
+
+static void queue_unlink(BlockQueueCommand* command) {
+    BlockQueueCommand** link = &block_queue_waiting;
+    while (*link != command) {
+        link = &(*link)->next;
+    }
+    *link = command->next;
+    block_queue_waiting_count--;
+}
+
+// Следующая команда: просроченная (самая старая) или C-SCAN от позиции
+static BlockQueueCommand* queue_select(void) {
+    BlockQueueCommand* oldest = block_queue_waiting;
+    BlockQueueCommand* ahead = NULL;
+    for (BlockQueueCommand* c = block_queue_waiting; c; c = c->next) {
+        if (c->queued_at < oldest->queued_at) {
+            oldest = c;
+        }
+        if (!ahead && c->request.lba >= block_queue_position) {
+            ahead = c;
+        }
+    }
+
+    if (clock_ticks() - oldest->queued_at >= BLOCK_QUEUE_EXPIRE) {
+        atomic_increment_u64(&block_queue_stats.expired);
+        return oldest;
+    }
+    return ahead ? ahead : block_queue_waiting;  // Дошли до конца - с начала
+}
+
+// Ждущие - драйверу, пока у устройства есть место. force - и под plug
+static void queue_dispatch(int force) {
+    if (block_queue_plugged && !force) {
+        return;
+    }
+
+    uint32_t limit = ata_queue_depth();
+    if (limit > BLOCK_QUEUE_COMMANDS) {
+        limit = BLOCK_QUEUE_COMMANDS;
+    }
+
+    while (block_queue_waiting && block_queue_inflight < limit) {
+        BlockQueueCommand* command = queue_select();
+        queue_unlink(command);
+        block_queue_position = command->request.lba + command->request.count;
+
+        command->request.done = queue_command_done;
+        command->request.context = command;
+        command->request.next = NULL;
+        if (ata_submit(&command->request) != 0) {
+            // Проверка при submit прошла - устройство пропало (reset и т.п.)
+            command->next = block_queue_failed;
+            block_queue_failed = command;
+            atomic_increment_u64(&block_queue_stats.failed);
+            continue;
+        }
+        block_queue_inflight++;
+        atomic_increment_u64(&block_queue_stats.dispatched);
+    }
+}
+
+// ============================================================================
+// SUBMIT / PLUG
+// ============================================================================
+
+int block_queue_submit(ATARequest* req) {
+    if (!ata_async_available() || !ata_request_valid(req)) {
+        return -1;
+    }
+
+    spin_lock(&block_queue_lock);
+    BlockQueueCommand* command = queue_command_alloc();
+    if (!command) {
+        spin_unlock(&block_queue_lock);
+        return -1;
+    }
+
+    command->request = *req;
+    req->next = NULL;
+    command->members = req;
+    command->members_tail = req;
+    command->member_count = 1;
+    command->queued_at = clock_ticks();
+
+    // Место по LBA: prev < req <= next
+    BlockQueueCommand* prev = NULL;
+    BlockQueueCommand* next = block_queue_waiting;
+    while (next && next->request.lba < req->lba) {
+        prev = next;
+        next = next->next;
+    }
+
+    if (prev && queue_merge(prev, command)) {
+        // req закрыл дыру между prev и next - все три одной командой
+        if (next && queue_merge(prev, next)) {
+            prev->next = next->next;
+            block_queue_waiting_count--;
+        }
+        atomic_increment_u64(&block_queue_stats.merged);
+    } else if (next && queue_merge(command, next)) {
+        // next поглощён: command встаёт на его место
+        command->next = next->next;
+        if (prev) {
+            prev->next = command;
+        } else {
+            block_queue_waiting = command;
+        }
+        atomic_increment_u64(&block_queue_stats.merged);
+    } else {
+        command->next = next;
+        if (prev) {
+            prev->next = command;
+        } else {
+            block_queue_waiting = command;
+        }
+        block_queue_waiting_count++;
+        if (block_queue_waiting_count > block_queue_stats.max_waiting) {
+            block_queue_stats.max_waiting = block_queue_waiting_count;
+        }
+    }
+    atomic_increment_u64(&block_queue_stats.submitted);
+
+    queue_dispatch(0);
+    spin_unlock(&block_queue_lock);
+    return 0;
+}
+
+void block_queue_plug(void) {
+    spin_lock(&block_queue_lock);
+    block_queue_plugged++;
+    spin_unlock(&block_queue_lock);
+}
+
+void block_queue_unplug(void) {
+    spin_lock(&block_queue_lock);
+    if (block_queue_plugged > 0) {
+        block_queue_plugged--;
+    }
+    queue_dispatch(0);
+    spin_unlock(&block_queue_lock);
+}
+
+// ============================================================================
+// COMPLETION
+// ============================================================================
+
+// done() каждого member - без block_queue_lock: колбэк берёт свои lock'и
+// (block_cache_lock), а под ним вызывается block_queue_submit
+static void queue_complete_members(ATARequest* member, int status) {
+    while (member) {
+        ATARequest* next = member->next;  // done() может переиспользовать запрос
+        member->next = NULL;
+        member->status = status;
+        if (member->done) {
+            member->done(member);
+        }
+        member = next;
+    }
+}
+
+// Из ata_async_reap()
+static void queue_command_done(ATARequest* request) {
+    BlockQueueCommand* command = (BlockQueueCommand*)request->context;
+    int status = request->status;
+
+    spin_lock(&block_queue_lock);
+    ATARequest* members = command->members;
+    command->in_use = 0;
+    block_queue_inflight--;
+    queue_dispatch(0);
+    spin_unlock(&block_queue_lock);
+
+    queue_complete_members(members, status);
+}
+
+int block_queue_poll(void) {
+    spin_lock(&block_queue_lock);
+    queue_dispatch(1);
+    spin_unlock(&block_queue_lock);
+
+    return ata_async_poll();
+}
+
+uint32_t block_queue_reap(void) {
+    uint32_t reaped = ata_async_reap();
+
+    spin_lock(&block_queue_lock);
+    ATARequest* members = NULL;
+    ATARequest* tail = NULL;
+    for (BlockQueueCommand* c = block_queue_failed; c; c = c->next) {
+        if (tail) {
+            tail->next = c->members;
+        } else {
+            members = c->members;
+        }
+        tail = c->members_tail;
+        c->in_use = 0;
+        reaped++;
+    }
+    block_queue_failed = NULL;
+    spin_unlock(&block_queue_lock);
+
+    queue_complete_members(members, -1);
+    return reaped;
+}
+
+void block_queue_print_stats(void) {
+    uint64_t submitted = atomic_load_u64(&block_queue_stats.submitted);
+    uint64_t merged = atomic_load_u64(&block_queue_stats.merged);
+
+    kprintf("  Block queue:     submitted=%lu merged=%lu (%lu%%) dispatched=%lu\n",
+            submitted, merged, submitted ? merged * 100 / submitted : 0,
+            atomic_load_u64(&block_queue_stats.dispatched));
+    kprintf("                   expired=%lu failed=%lu max_waiting=%lu depth=%u\n",
+            atomic_load_u64(&block_queue_stats.expired),
+            atomic_load_u64(&block_queue_stats.failed),
+            atomic_load_u64(&block_queue_stats.max_waiting),
+            ata_queue_depth());
+}
@@ -0,0 +1,57 @@
+#ifndef BLOCK_QUEUE_H
+#define BLOCK_QUEUE_H
+
+#include "ktypes.h"
+#include "ata.h"  // ATARequest
+
+// ============================================================================
+// BLOCK QUEUE - планировщик async I/O между block cache и драйвером диска
+// ============================================================================
+//
+// Async запросы (block_cache_fetch_async) не уходят в драйвер сразу, а
+// ждут здесь, пока у устройства нет свободного места (ata_queue_depth:
+// legacy канал - 1 команда, AHCI NCQ / virtio - до 32):
+//
+//   merge     - запрос, продолжающий ждущий (или продолжаемый им) по LBA,
+//               в том же направлении - одна команда устройства
+//               (до BLOCK_QUEUE_MAX_SECTORS, chunks подряд)
+//   elevator  - C-SCAN: следующая команда - первая по LBA от позиции
+//               после прошлой, дошли до конца - с начала
+//   deadline  - ждущая дольше BLOCK_QUEUE_EXPIRE ticks идёт вне очереди
+//   plug      - между block_queue_plug() и block_queue_unplug() (batch
+//               Storage Deck) запросы только копятся: чтения нескольких
+//               файлов сортируются и склеиваются до отправки
+//
+// Кто ждёт конкретный запрос (cache_lookup_ready), вызывает
+// block_queue_poll(): он отправляет накопленное и под plug.
+//
+// Синхронные передачи (span, write-back) идут мимо: подряд идущие блоки
+// они уже склеивают сами (ata_write_blocks_gather).
+//
+// ============================================================================
+
+#define BLOCK_QUEUE_COMMANDS        32      // Команд (ждущих + в полёте)
+#define BLOCK_QUEUE_MAX_SECTORS     256     // Секторов в склеенной команде (128KB)
+#define BLOCK_QUEUE_EXPIRE          10      // Clock ticks (~100ms) до deadline
+
+void block_queue_init(void);
+
+// Как ata_submit(): 0 = принят (done() будет вызван из block_queue_reap),
+// -1 = async недоступен / драйвер запрос не примет / очередь полна
+int block_queue_submit(ATARequest* req);
+
+// Копить запросы до unplug (вложенные пары допустимы)
+void block_queue_plug(void);
+void block_queue_unplug(void);
+
+// Отправить ждущие (в том числе под plug) и опросить драйвер.
+// 1 = что-то завершилось
+int block_queue_poll(void);
+
+// ata_async_reap() + запросы, которые драйвер отверг при отправке (-1).
+// Вне IRQ и без удержания lock'ов, которые берут колбэки
+uint32_t block_queue_reap(void);
+
+void block_queue_print_stats(void);
+
+#endif // BLOCK_QUEUE_H
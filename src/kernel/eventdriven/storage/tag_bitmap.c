@@ -0,0 +1,560 @@
+#include "tag_bitmap.h"
+#include "klib.h"
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+#define VALUE_KEY(v)        ((v) >> 16)
+#define VALUE_LOW(v)        ((uint16_t)((v) & 0xFFFF))
+#define MAKE_VALUE(k, low)  (((k) << 16) | (uint64_t)(low))
+
+#define ARRAY_MIN_CAPACITY  4
+
+static inline int container_is_bitmap(const TagBitmapContainer* c) {
+    return c->capacity == 0;
+}
+
+// Позиция первого container с key >= key (count - если нет)
+static uint32_t container_lower_bound(const TagBitmap* bitmap, uint64_t key) {
+    uint32_t lo = 0, hi = bitmap->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (bitmap->containers[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static TagBitmapContainer* container_find(const TagBitmap* bitmap, uint64_t key) {
+    uint32_t pos = container_lower_bound(bitmap, key);
+    if (pos < bitmap->count && bitmap->containers[pos].key == key) {
+        return &bitmap->containers[pos];
+    }
+    return NULL;
+}
+
+static uint32_t array_lower_bound(const uint16_t* values, uint32_t count, uint16_t low) {
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (values[mid] < low) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static uint32_t words_cardinality(const uint64_t* words) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < TAG_BITMAP_WORDS; i++) {
+        count += __builtin_popcountll(words[i]);
+    }
+    return count;
+}
+
+// Место под container на позиции pos (содержимое заполняет caller)
+static TagBitmapContainer* container_open_slot(TagBitmap* bitmap, uint32_t pos) {
+    if (bitmap->count == bitmap->capacity) {
+        uint32_t new_capacity = bitmap->capacity ? bitmap->capacity * 2 : 4;
+        TagBitmapContainer* containers =
+            (TagBitmapContainer*)kmalloc(new_capacity * sizeof(TagBitmapContainer));
+        if (!containers) {
+            return NULL;
+        }
+        if (bitmap->containers) {
+            memcpy(containers, bitmap->containers, bitmap->count * sizeof(TagBitmapContainer));
+            kfree(bitmap->containers);
+        }
+        bitmap->containers = containers;
+        bitmap->capacity = new_capacity;
+    }
+
+    memmove(&bitmap->containers[pos + 1], &bitmap->containers[pos],
+            (bitmap->count - pos) * sizeof(TagBitmapContainer));
+    bitmap->count++;
+    return &bitmap->containers[pos];
+}
+
+// Пустой array container на позиции pos
+static TagBitmapContainer* container_insert(TagBitmap* bitmap, uint32_t pos, uint64_t key) {
+    uint16_t* values = (uint16_t*)kmalloc(ARRAY_MIN_CAPACITY * sizeof(uint16_t));
+    if (!values) {
+        return NULL;
+    }
+
+    TagBitmapContainer* c = container_open_slot(bitmap, pos);
+    if (!c) {
+        kfree(values);
+        return NULL;
+    }
+    c->key = key;
+    c->cardinality = 0;
+    c->capacity = ARRAY_MIN_CAPACITY;
+    c->data = values;
+    return c;
+}
+
+static void container_remove(TagBitmap* bitmap, uint32_t pos) {
+    kfree(bitmap->containers[pos].data);
+    memmove(&bitmap->containers[pos], &bitmap->containers[pos + 1],
+            (bitmap->count - pos - 1) * sizeof(TagBitmapContainer));
+    bitmap->count--;
+}
+
+// Array → bitmap. 0 = нет памяти (container не изменён)
+static int container_to_bitmap(TagBitmapContainer* c) {
+    uint64_t* words = (uint64_t*)kmalloc(TAG_BITMAP_WORDS * sizeof(uint64_t));
+    if (!words) {
+        return 0;
+    }
+    memset(words, 0, TAG_BITMAP_WORDS * sizeof(uint64_t));
+
+    const uint16_t* values = (const uint16_t*)c->data;
+    for (uint32_t i = 0; i < c->cardinality; i++) {
+        words[values[i] / 64] |= 1ULL << (values[i] % 64);
+    }
+
+    kfree(c->data);
+    c->data = words;
+    c->capacity = 0;
+    return 1;
+}
+
+// Bitmap → array (cardinality <= TAG_BITMAP_ARRAY_MAX). 0 = нет памяти
+static int container_to_array(TagBitmapContainer* c) {
+    uint32_t capacity = c->cardinality > ARRAY_MIN_CAPACITY ? c->cardinality : ARRAY_MIN_CAPACITY;
+    uint16_t* values = (uint16_t*)kmalloc(capacity * sizeof(uint16_t));
+    if (!values) {
+        return 0;
+    }
+
+    const uint64_t* words = (const uint64_t*)c->data;
+    uint32_t n = 0;
+    for (uint32_t w = 0; w < TAG_BITMAP_WORDS; w++) {
+        uint64_t word = words[w];
+        while (word) {
+            values[n++] = (uint16_t)(w * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+
+    kfree(c->data);
+    c->data = values;
+    c->capacity = capacity;
+    return 1;
+}
+
+// Почти пустой bitmap container - обратно в array (не вышло - остаётся bitmap)
+static void container_shrink(TagBitmapContainer* c) {
+    if (container_is_bitmap(c) && c->cardinality <= TAG_BITMAP_ARRAY_MAX / 2) {
+        container_to_array(c);
+    }
+}
+
+static int container_clone(TagBitmapContainer* dst, const TagBitmapContainer* src) {
+    size_t size = container_is_bitmap(src) ? TAG_BITMAP_WORDS * sizeof(uint64_t)
+                                           : src->capacity * sizeof(uint16_t);
+    void* data = kmalloc(size);
+    if (!data) {
+        return 0;
+    }
+    memcpy(data, src->data, size);
+    *dst = *src;
+    dst->data = data;
+    return 1;
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void tag_bitmap_init(TagBitmap* bitmap) {
+    memset(bitmap, 0, sizeof(TagBitmap));
+}
+
+void tag_bitmap_free(TagBitmap* bitmap) {
+    for (uint32_t i = 0; i < bitmap->count; i++) {
+        kfree(bitmap->containers[i].data);
+    }
+    if (bitmap->containers) {
+        kfree(bitmap->containers);
+    }
+    tag_bitmap_init(bitmap);
+}
+
+// ============================================================================
+// SINGLE VALUES
+// ============================================================================
+
+int tag_bitmap_add(TagBitmap* bitmap, uint64_t value) {
+    uint64_t key = VALUE_KEY(value);
+    uint16_t low = VALUE_LOW(value);
+
+    uint32_t pos = container_lower_bound(bitmap, key);
+    TagBitmapContainer* c;
+    if (pos < bitmap->count && bitmap->containers[pos].key == key) {
+        c = &bitmap->containers[pos];
+    } else {
+        c = container_insert(bitmap, pos, key);
+        if (!c) {
+            return -1;
+        }
+    }
+
+    if (!container_is_bitmap(c)) {
+        uint16_t* values = (uint16_t*)c->data;
+        uint32_t i = array_lower_bound(values, c->cardinality, low);
+        if (i < c->cardinality && values[i] == low) {
+            return 0;
+        }
+
+        if (c->cardinality < TAG_BITMAP_ARRAY_MAX) {
+            if (c->cardinality == c->capacity) {
+                uint32_t new_capacity = c->capacity * 2;
+                if (new_capacity > TAG_BITMAP_ARRAY_MAX) {
+                    new_capacity = TAG_BITMAP_ARRAY_MAX;
+                }
+                uint16_t* grown = (uint16_t*)kmalloc(new_capacity * sizeof(uint16_t));
+                if (!grown) {
+                    return -1;
+                }
+                memcpy(grown, values, c->cardinality * sizeof(uint16_t));
+                kfree(values);
+                c->data = values = grown;
+                c->capacity = new_capacity;
+            }
+
+            memmove(&values[i + 1], &values[i], (c->cardinality - i) * sizeof(uint16_t));
+            values[i] = low;
+            c->cardinality++;
+            bitmap->cardinality++;
+            return 1;
+        }
+
+        // Array полон - переходим на bitmap
+        if (!container_to_bitmap(c)) {
+            return -1;
+        }
+    }
+
+    uint64_t* words = (uint64_t*)c->data;
+    uint64_t mask = 1ULL << (low % 64);
+    if (words[low / 64] & mask) {
+        return 0;
+    }
+    words[low / 64] |= mask;
+    c->cardinality++;
+    bitmap->cardinality++;
+    return 1;
+}
+
+int tag_bitmap_remove(TagBitmap* bitmap, uint64_t value) {
+    uint64_t key = VALUE_KEY(value);
+    uint16_t low = VALUE_LOW(value);
+
+    uint32_t pos = container_lower_bound(bitmap, key);
+    if (pos >= bitmap->count || bitmap->containers[pos].key != key) {
+        return 0;
+    }
+    TagBitmapContainer* c = &bitmap->containers[pos];
+
+    if (container_is_bitmap(c)) {
+        uint64_t* words = (uint64_t*)c->data;
+        uint64_t mask = 1ULL << (low % 64);
+        if (!(words[low / 64] & mask)) {
+            return 0;
+        }
+        words[low / 64] &= ~mask;
+    } else {
+        uint16_t* values = (uint16_t*)c->data;
+        uint32_t i = array_lower_bound(values, c->cardinality, low);
+        if (i >= c->cardinality || values[i] != low) {
+            return 0;
+        }
+        memmove(&values[i], &values[i + 1], (c->cardinality - i - 1) * sizeof(uint16_t));
+    }
+
+    c->cardinality--;
+    bitmap->cardinality--;
+    if (c->cardinality == 0) {
+        container_remove(bitmap, pos);
+    } else {
+        container_shrink(c);
+    }
+    return 1;
+}
+
+int tag_bitmap_contains(const TagBitmap* bitmap, uint64_t value) {
+    const TagBitmapContainer* c = container_find(bitmap, VALUE_KEY(value));
+    if (!c) {
+        return 0;
+    }
+
+    uint16_t low = VALUE_LOW(value);
+    if (container_is_bitmap(c)) {
+        return (((const uint64_t*)c->data)[low / 64] >> (low % 64)) & 1;
+    }
+    const uint16_t* values = (const uint16_t*)c->data;
+    uint32_t i = array_lower_bound(values, c->cardinality, low);
+    return i < c->cardinality && values[i] == low;
+}
+
+int tag_bitmap_next(const TagBitmap* bitmap, uint64_t value, uint64_t* found_out) {
+    uint64_t key = VALUE_KEY(value);
+
+    for (uint32_t pos = container_lower_bound(bitmap, key); pos < bitmap->count; pos++) {
+        const TagBitmapContainer* c = &bitmap->containers[pos];
+        uint32_t start = c->key == key ? VALUE_LOW(value) : 0;
+
+        if (container_is_bitmap(c)) {
+            const uint64_t* words = (const uint64_t*)c->data;
+            uint32_t w = start / 64;
+            uint64_t word = words[w] & (~0ULL << (start % 64));
+            while (!word && ++w < TAG_BITMAP_WORDS) {
+                word = words[w];
+            }
+            if (word) {
+                *found_out = MAKE_VALUE(c->key, w * 64 + __builtin_ctzll(word));
+                return 1;
+            }
+        } else {
+            const uint16_t* values = (const uint16_t*)c->data;
+            uint32_t i = array_lower_bound(values, c->cardinality, (uint16_t)start);
+            if (i < c->cardinality) {
+                *found_out = MAKE_VALUE(c->key, values[i]);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// SET OPERATIONS
+// ============================================================================
+
+int tag_bitmap_copy(TagBitmap* dst, const TagBitmap* src) {
+    tag_bitmap_init(dst);
+    if (src->count == 0) {
+        return 0;
+    }
+
+    dst->containers = (TagBitmapContainer*)kmalloc(src->count * sizeof(TagBitmapContainer));
+    if (!dst->containers) {
+        return -1;
+    }
+    dst->capacity = src->count;
+
+    for (uint32_t i = 0; i < src->count; i++) {
+        if (!container_clone(&dst->containers[i], &src->containers[i])) {
+            return -1;
+        }
+        dst->count++;
+        dst->cardinality += src->containers[i].cardinality;
+    }
+    return 0;
+}
+
+// dst container |= src container (тот же key)
+static int container_or(TagBitmapContainer* dst, const TagBitmapContainer* src) {
+    if (!container_is_bitmap(dst) && !container_is_bitmap(src) &&
+        dst->cardinality + src->cardinality <= TAG_BITMAP_ARRAY_MAX) {
+        // Array | array - слияние двух отсортированных
+        uint32_t capacity = dst->cardinality + src->cardinality;
+        uint16_t* merged = (uint16_t*)kmalloc(capacity * sizeof(uint16_t));
+        if (!merged) {
+            return 0;
+        }
+
+        const uint16_t* a = (const uint16_t*)dst->data;
+        const uint16_t* b = (const uint16_t*)src->data;
+        uint32_t i = 0, j = 0, n = 0;
+        while (i < dst->cardinality && j < src->cardinality) {
+            if (a[i] < b[j]) {
+                merged[n++] = a[i++];
+            } else if (a[i] > b[j]) {
+                merged[n++] = b[j++];
+            } else {
+                merged[n++] = a[i++];
+                j++;
+            }
+        }
+        while (i < dst->cardinality) {
+            merged[n++] = a[i++];
+        }
+        while (j < src->cardinality) {
+            merged[n++] = b[j++];
+        }
+
+        kfree(dst->data);
+        dst->data = merged;
+        dst->capacity = capacity;
+        dst->cardinality = n;
+        return 1;
+    }
+
+    if (!container_is_bitmap(dst) && !container_to_bitmap(dst)) {
+        return 0;
+    }
+
+    uint64_t* words = (uint64_t*)dst->data;
+    if (container_is_bitmap(src)) {
+        const uint64_t* other = (const uint64_t*)src->data;
+        for (uint32_t w = 0; w < TAG_BITMAP_WORDS; w++) {
+            words[w] |= other[w];
+        }
+    } else {
+        const uint16_t* values = (const uint16_t*)src->data;
+        for (uint32_t i = 0; i < src->cardinality; i++) {
+            words[values[i] / 64] |= 1ULL << (values[i] % 64);
+        }
+    }
+    dst->cardinality = words_cardinality(words);
+    return 1;
+}
+
+int tag_bitmap_or(TagBitmap* dst, const TagBitmap* src) {
+    for (uint32_t s = 0; s < src->count; s++) {
+        const TagBitmapContainer* other = &src->containers[s];
+        uint32_t pos = container_lower_bound(dst, other->key);
+
+        if (pos < dst->count && dst->containers[pos].key == other->key) {
+            TagBitmapContainer* c = &dst->containers[pos];
+            uint32_t before = c->cardinality;
+            if (!container_or(c, other)) {
+                return -1;
+            }
+            dst->cardinality += c->cardinality - before;
+            continue;
+        }
+
+        // Такого key в dst нет - копия container целиком
+        TagBitmapContainer copy;
+        if (!container_clone(&copy, other)) {
+            return -1;
+        }
+        TagBitmapContainer* c = container_open_slot(dst, pos);
+        if (!c) {
+            kfree(copy.data);
+            return -1;
+        }
+        *c = copy;
+        dst->cardinality += copy.cardinality;
+    }
+    return 0;
+}
+
+// dst container &= ~src container (тот же key)
+static void container_andnot(TagBitmapContainer* dst, const TagBitmapContainer* src) {
+    if (container_is_bitmap(dst)) {
+        uint64_t* words = (uint64_t*)dst->data;
+        if (container_is_bitmap(src)) {
+            const uint64_t* other = (const uint64_t*)src->data;
+            for (uint32_t w = 0; w < TAG_BITMAP_WORDS; w++) {
+                words[w] &= ~other[w];
+            }
+        } else {
+            const uint16_t* values = (const uint16_t*)src->data;
+            for (uint32_t i = 0; i < src->cardinality; i++) {
+                words[values[i] / 64] &= ~(1ULL << (values[i] % 64));
+            }
+        }
+        dst->cardinality = words_cardinality(words);
+        return;
+    }
+
+    // Array - сжатие на месте, оставляем значения, которых нет в src
+    uint16_t* values = (uint16_t*)dst->data;
+    uint32_t n = 0;
+    if (container_is_bitmap(src)) {
+        const uint64_t* other = (const uint64_t*)src->data;
+        for (uint32_t i = 0; i < dst->cardinality; i++) {
+            if (!((other[values[i] / 64] >> (values[i] % 64)) & 1)) {
+                values[n++] = values[i];
+            }
+        }
+    } else {
+        const uint16_t* other = (const uint16_t*)src->data;
+        uint32_t j = 0;
+        for (uint32_t i = 0; i < dst->cardinality; i++) {
+            while (j < src->cardinality && other[j] < values[i]) {
+                j++;
+            }
+            if (j >= src->cardinality || other[j] != values[i]) {
+                values[n++] = values[i];
+            }
+        }
+    }
+    dst->cardinality = n;
+}
+
+int tag_bitmap_andnot(TagBitmap* dst, const TagBitmap* src) {
+    uint32_t pos = 0;
+    for (uint32_t s = 0; s < src->count && pos < dst->count; s++) {
+        const TagBitmapContainer* other = &src->containers[s];
+        while (pos < dst->count && dst->containers[pos].key < other->key) {
+            pos++;
+        }
+        if (pos >= dst->count || dst->containers[pos].key != other->key) {
+            continue;
+        }
+
+        TagBitmapContainer* c = &dst->containers[pos];
+        uint32_t before = c->cardinality;
+        container_andnot(c, other);
+        dst->cardinality -= before - c->cardinality;
+
+        if (c->cardinality == 0) {
+            container_remove(dst, pos);
+        } else {
+            container_shrink(c);
+            pos++;
+        }
+    }
+    return 0;
+}
+
+int tag_bitmap_add_array(TagBitmap* dst, const uint64_t* ids, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (tag_bitmap_add(dst, ids[i]) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void tag_bitmap_remove_array(TagBitmap* dst, const uint64_t* ids, uint32_t count) {
+    for (uint32_t i = 0; i < count && dst->cardinality > 0; i++) {
+        tag_bitmap_remove(dst, ids[i]);
+    }
+}
+
+uint32_t tag_bitmap_to_array(const TagBitmap* bitmap, uint64_t* out, uint32_t max) {
+    uint32_t n = 0;
+    for (uint32_t pos = 0; pos < bitmap->count && n < max; pos++) {
+        const TagBitmapContainer* c = &bitmap->containers[pos];
+
+        if (container_is_bitmap(c)) {
+            const uint64_t* words = (const uint64_t*)c->data;
+            for (uint32_t w = 0; w < TAG_BITMAP_WORDS && n < max; w++) {
+                uint64_t word = words[w];
+                while (word && n < max) {
+                    out[n++] = MAKE_VALUE(c->key, w * 64 + __builtin_ctzll(word));
+                    word &= word - 1;
+                }
+            }
+        } else {
+            const uint16_t* values = (const uint16_t*)c->data;
+            for (uint32_t i = 0; i < c->cardinality && n < max; i++) {
+                out[n++] = MAKE_VALUE(c->key, values[i]);
+            }
+        }
+    }
+    return n;
+}
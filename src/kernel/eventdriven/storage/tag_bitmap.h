@@ -0,0 +1,72 @@
+#ifndef TAG_BITMAP_H
+#define TAG_BITMAP_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// TAG BITMAP - сжатое множество inode ID (Roaring-style) для posting lists
+// ============================================================================
+//
+// Значение делится на key (старшие биты, value >> 16) и low (16 бит).
+// На каждый key - container, containers отсортированы по key:
+//
+//   array   - отсортированный uint16_t[], пока cardinality <= TAG_BITMAP_ARRAY_MAX
+//   bitmap  - uint64_t[1024] (65536 бит), выше порога
+//
+// Array container на 4096 значений и bitmap container - оба 8KB, так что
+// память растёт с числом значений, а не с диапазоном ID. OR / AND-NOT над
+// двумя bitmap containers - по 64 бита за шаг (цикл без ветвлений,
+// компилятор векторизует), cardinality - popcount.
+//
+// Lock - забота caller (TagFS держит global_tagfs.index_lock).
+//
+// ============================================================================
+
+#define TAG_BITMAP_ARRAY_MAX    4096    // Array container → bitmap выше
+#define TAG_BITMAP_WORDS        1024    // uint64_t в bitmap container
+
+typedef struct {
+    uint64_t key;                       // value >> 16
+    uint32_t cardinality;
+    uint32_t capacity;                  // Array: вместимость в uint16_t, 0 = bitmap container
+    void* data;                         // uint16_t[capacity] / uint64_t[TAG_BITMAP_WORDS]
+} TagBitmapContainer;
+
+typedef struct {
+    TagBitmapContainer* containers;     // По возрастанию key
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t cardinality;               // Значений всего
+} TagBitmap;
+
+void tag_bitmap_init(TagBitmap* bitmap);
+void tag_bitmap_free(TagBitmap* bitmap);   // Пустое множество, память отдана
+
+// 1 = добавлено / удалено, 0 = уже было / не было, -1 = нет памяти
+int tag_bitmap_add(TagBitmap* bitmap, uint64_t value);
+int tag_bitmap_remove(TagBitmap* bitmap, uint64_t value);
+int tag_bitmap_contains(const TagBitmap* bitmap, uint64_t value);
+
+// Наименьшее значение >= value в *found_out. 0 = нет таких
+int tag_bitmap_next(const TagBitmap* bitmap, uint64_t value, uint64_t* found_out);
+
+// dst = копия src / dst |= src / dst &= ~src. 0 = успех, -1 = нет памяти
+// (dst остаётся корректным множеством, но неполным)
+int tag_bitmap_copy(TagBitmap* dst, const TagBitmap* src);
+int tag_bitmap_or(TagBitmap* dst, const TagBitmap* src);
+int tag_bitmap_andnot(TagBitmap* dst, const TagBitmap* src);
+
+// dst |= { ids[0..count) } (ids - отсортированный posting list)
+int tag_bitmap_add_array(TagBitmap* dst, const uint64_t* ids, uint32_t count);
+
+// dst &= ~{ ids[0..count) }
+void tag_bitmap_remove_array(TagBitmap* dst, const uint64_t* ids, uint32_t count);
+
+// Первые max значений по возрастанию. Возвращает сколько записано
+uint32_t tag_bitmap_to_array(const TagBitmap* bitmap, uint64_t* out, uint32_t max);
+
+static inline uint64_t tag_bitmap_cardinality(const TagBitmap* bitmap) {
+    return bitmap->cardinality;
+}
+
+#endif // TAG_BITMAP_H
@@ -1,6 +1,10 @@
 #include "tagfs.h"
 #include "klib.h"  // Для kprintf, memset, strcmp, и т.д.
 #include "ata.h"    // Для работы с диском
+#include "block_cache.h"
+#include "block_queue.h"
+#include "operations_crc32.h"
+#include "clock.h"
 
 // ============================================================================
 // GLOBAL STATE
@@ -8,13 +12,92 @@
 
 TagFSContext global_tagfs;
 
-// Простое хранилище блоков в памяти (fallback если диск недоступен)
-#define TAGFS_MEM_BLOCKS 128  // 512MB виртуального диска (128 * 4KB)
+// Блоки в памяти: memory mode - весь том (fallback если диск недоступен),
+// disk mode - резидентная metadata (superblock..journal). Data region на
+// диске идёт только через block cache, до конца устройства
+#define TAGFS_MEM_BLOCKS 128  // 512KB (128 * 4KB)
 static uint8_t tagfs_storage[TAGFS_MEM_BLOCKS][TAGFS_BLOCK_SIZE];
 
 // Использовать реальный диск или память?
 static int use_disk = 0;  // 0 = память, 1 = диск
 
+// Изменённые блоки metadata в tagfs_storage (superblock, inode table) с
+// последнего sync. Data region отслеживает block cache
+static uint8_t tagfs_meta_dirty[(TAGFS_MEM_BLOCKS + 7) / 8];
+
+// Блок metadata → блок журнала (от journal_block) с последним committed
+// образом, 0 = с checkpoint не журналировался. Checkpoint пишет на место
+// образы из журнала, а не tagfs_storage, где могут быть незакоммиченные изменения
+static uint8_t tagfs_journal_slot[TAGFS_MEM_BLOCKS];
+
+// Последняя версия с Tag целиком в inode - мигрируется в tag IDs при mount
+#define TAGFS_VERSION_INLINE_TAGS   3
+
+// Direct/indirect block pointers вместо extents. Миграции нет (образы v2
+// писались с неверным TAGFS_INODE_SIZE) - такой том не монтируется и не
+// форматируется
+#define TAGFS_VERSION_BLOCK_POINTERS 2
+
+// ============================================================================
+// LOCKING
+// ============================================================================
+//
+// Порядок взятия (никогда в обратную сторону):
+//
+//   commit_lock  read - любое изменение metadata (inodes, словарь, списки,
+//                bitmaps); write - commit / checkpoint / rebuild: журнал
+//                получает согласованный снимок
+//   inode lock   read - чтение файла / его тегов, write - запись, теги, erase.
+//                Два inode lock одновременно не держит никто
+//   index_lock   read - queries и lookup, write - intern, posting lists и
+//                user context (его view меняется вместе со списками)
+//   alloc_lock   spinlock: bitmaps блоков / inodes, счётчики superblock
+//   block cache  spinlock внутри block_cache.c
+//
+// Чтения разных файлов и queries не ждут друг друга. rwlock не запрещает
+// IRQ, поэтому берётся только без spinlocks на руках (alloc_lock и block
+// cache - самые внутренние).
+//
+// Tag ID не удаляются (entries только растут) - ID, полученный под
+// index_lock, остаётся верным и после его отпускания.
+
+#define TAGFS_INODE_LOCKS   1024    // Степень 2; слот & (N - 1) - для слотов < N lock свой
+
+static rwlock_t tagfs_inode_locks[TAGFS_INODE_LOCKS];
+
+static inline rwlock_t* tagfs_inode_lock(const FileInode* inode) {
+    return &tagfs_inode_locks[(uint64_t)(inode - global_tagfs.inode_table) & (TAGFS_INODE_LOCKS - 1)];
+}
+
+// Tag dictionary (раздел TAG DICTIONARY ниже)
+static void tagfs_tag_dict_reset(void);
+static int tagfs_tag_dict_load(void);
+static const Tag* tagfs_tag_get(uint32_t tag_id);
+static void tagfs_index_add_id(uint64_t inode_id, uint32_t tag_id);
+static void tagfs_index_remove_id(uint64_t inode_id, uint32_t tag_id);
+static void tagfs_name_insert(uint32_t tag_id);
+
+// Materialized view контекста (раздел USER CONTEXT OPERATIONS ниже)
+static void tagfs_view_tag_inserted(uint32_t tag_id);
+static void tagfs_view_tag_changed(uint64_t inode_id, uint32_t tag_id);
+static void tagfs_view_update(uint64_t inode_id);
+static void tagfs_view_rebuild_locked(void);
+
+// Образ posting lists на диске (раздел POSTING IMAGE ниже)
+static int tagfs_posting_store(void);
+static int tagfs_posting_load(void);
+
+// Journal recovery (раздел JOURNAL ниже)
+static void tagfs_journal_replay(void);
+
+// Inode под его lock (раздел FILE OPERATIONS ниже)
+static FileInode* tagfs_inode_acquire(uint64_t inode_id, int write);
+static void tagfs_inode_release(FileInode* inode, int write);
+static uint32_t tagfs_tag_intern_locked(const Tag* tag);
+static void tagfs_index_remove_inode(const FileInode* inode);
+static void tagfs_index_rebuild_locked(void);
+static void tagfs_free_extents(FileInode* inode);
+
 // ============================================================================
 // HELPER FUNCTIONS - Работа с битмапами
 // ============================================================================
@@ -23,6 +106,11 @@ static inline void bitmap_set_bit(uint8_t* bitmap, uint64_t bit) {
     bitmap[bit / 8] |= (1 << (bit % 8));
 }
 
+// tagfs_meta_dirty: inodes разных файлов помечают соседние биты параллельно
+static inline void bitmap_set_bit_atomic(uint8_t* bitmap, uint64_t bit) {
+    __sync_fetch_and_or(&bitmap[bit / 8], (uint8_t)(1 << (bit % 8)));
+}
+
 static inline void bitmap_clear_bit(uint8_t* bitmap, uint64_t bit) {
     bitmap[bit / 8] &= ~(1 << (bit % 8));
 }
@@ -31,14 +119,22 @@ static inline int bitmap_test_bit(uint8_t* bitmap, uint64_t bit) {
     return (bitmap[bit / 8] & (1 << (bit % 8))) != 0;
 }
 
-// Найти первый свободный бит
-static uint64_t bitmap_find_free(uint8_t* bitmap, uint64_t max_bits) {
-    for (uint64_t i = 0; i < max_bits; i++) {
-        if (!bitmap_test_bit(bitmap, i)) {
-            return i;
-        }
-    }
-    return (uint64_t)-1;  // Не найдено
+// ============================================================================
+// DIRTY TRACKING - что писать при следующем sync
+// ============================================================================
+
+static inline void tagfs_mark_superblock_dirty(void) {
+    bitmap_set_bit_atomic(tagfs_meta_dirty, 0);
+}
+
+// Inode может пересекать границу блоков - помечаем оба
+static void tagfs_mark_inode_dirty(const FileInode* inode) {
+    uint64_t offset = (uint64_t)((const uint8_t*)inode - (const uint8_t*)global_tagfs.inode_table);
+    uint64_t first = global_tagfs.superblock->inode_table_block + offset / TAGFS_BLOCK_SIZE;
+    uint64_t last = global_tagfs.superblock->inode_table_block +
+                    (offset + sizeof(FileInode) - 1) / TAGFS_BLOCK_SIZE;
+    bitmap_set_bit_atomic(tagfs_meta_dirty, first);
+    bitmap_set_bit_atomic(tagfs_meta_dirty, last);
 }
 
 // ============================================================================
@@ -79,20 +175,47 @@ static int tagfs_write_block_raw(uint64_t block_num, const uint8_t* buffer) {
     }
 }
 
+// Data region в disk mode идёт через block cache (block_cache.h),
+// metadata и memory mode - напрямую tagfs_storage
+static inline int tagfs_block_cached(uint64_t block_num) {
+    return use_disk && block_num >= global_tagfs.superblock->data_blocks_start;
+}
+
+// Данные блока до tagfs_block_put(). 0 = ошибка I/O / cache переполнен
+static uint8_t* tagfs_block_get(uint64_t block_num, uint32_t mode) {
+    if (tagfs_block_cached(block_num)) {
+        return block_cache_get(block_num, mode);
+    }
+    if (mode == BLOCK_CACHE_ZERO) {
+        memset(tagfs_storage[block_num], 0, TAGFS_BLOCK_SIZE);
+    }
+    return tagfs_storage[block_num];
+}
+
+static void tagfs_block_put(uint64_t block_num, int dirty) {
+    if (tagfs_block_cached(block_num)) {
+        block_cache_put(block_num, dirty);
+    }
+}
+
 // ============================================================================
 // PERSISTENCE - Синхронизация метаданных с диском
 // ============================================================================
 
 // Записать superblock на диск
 int tagfs_sync_superblock(void) {
-    if (!use_disk) {
-        return 0;  // В режиме памяти ничего не делаем
+    if (!use_disk || !bitmap_test_bit(tagfs_meta_dirty, 0)) {
+        return 0;  // Память или не менялся с последнего sync
     }
 
     kprintf("[TAGFS] Syncing superblock to disk...\n");
 
     // Superblock всегда в блоке 0
-    return tagfs_write_block_raw(0, (const uint8_t*)global_tagfs.superblock);
+    if (tagfs_write_block_raw(0, (const uint8_t*)global_tagfs.superblock) != 0) {
+        return -1;
+    }
+    bitmap_clear_bit(tagfs_meta_dirty, 0);
+    return 0;
 }
 
 // Загрузить superblock с диска
@@ -107,30 +230,48 @@ int tagfs_load_superblock(void) {
     return tagfs_read_block_raw(0, (uint8_t*)tagfs_storage[0]);
 }
 
-// Записать inode table на диск
+// Записать inode table и tag dictionary на диск
 int tagfs_sync_inode_table(void) {
     if (!use_disk) {
         return 0;
     }
 
-    kprintf("[TAGFS] Syncing inode table to disk...\n");
-
-    // Inode table начинается с блока inode_table_block
+    // Inode table с блока inode_table_block, за ней tag dictionary до data region
     uint64_t start_block = global_tagfs.superblock->inode_table_block;
-    uint64_t end_block = global_tagfs.superblock->tag_index_block;
+    uint64_t end_block = global_tagfs.superblock->data_blocks_start;
+    uint64_t written = 0;
+
+    // Только изменённые блоки; подряд идущие - одной multi-sector командой
+    for (uint64_t block = start_block; block < end_block; ) {
+        if (!bitmap_test_bit(tagfs_meta_dirty, block)) {
+            block++;
+            continue;
+        }
 
-    // Пишем все блоки inode table
-    for (uint64_t block = start_block; block < end_block; block++) {
-        if (tagfs_write_block_raw(block, tagfs_storage[block]) != 0) {
-            kprintf("[TAGFS] ERROR: Failed to sync inode table block %lu\n", block);
+        uint64_t run = 1;
+        while (block + run < end_block && bitmap_test_bit(tagfs_meta_dirty, block + run)) {
+            run++;
+        }
+
+        if (ata_write_blocks(block, run, tagfs_storage[block]) != 0) {
+            kprintf("[TAGFS] ERROR: Failed to sync inode table blocks %lu-%lu\n",
+                    block, block + run - 1);
             return -1;
         }
+        for (uint64_t i = 0; i < run; i++) {
+            bitmap_clear_bit(tagfs_meta_dirty, block + i);
+        }
+        written += run;
+        block += run;
     }
 
+    if (written > 0) {
+        kprintf("[TAGFS] Synced %lu metadata block(s)\n", written);
+    }
     return 0;
 }
 
-// Загрузить inode table с диска
+// Загрузить inode table и tag dictionary с диска
 int tagfs_load_inode_table(void) {
     if (!use_disk) {
         return 0;
@@ -139,338 +280,627 @@ int tagfs_load_inode_table(void) {
     kprintf("[TAGFS] Loading inode table from disk...\n");
 
     uint64_t start_block = global_tagfs.superblock->inode_table_block;
-    uint64_t end_block = global_tagfs.superblock->tag_index_block;
+    uint64_t end_block = global_tagfs.superblock->data_blocks_start;
 
-    for (uint64_t block = start_block; block < end_block; block++) {
-        if (tagfs_read_block_raw(block, tagfs_storage[block]) != 0) {
-            kprintf("[TAGFS] ERROR: Failed to load inode table block %lu\n", block);
-            return -1;
-        }
+    if (end_block > TAGFS_MEM_BLOCKS || start_block >= end_block) {
+        kprintf("[TAGFS] ERROR: Invalid inode table range %lu-%lu\n", start_block, end_block);
+        return -1;
+    }
+
+    if (ata_read_blocks(start_block, end_block - start_block, tagfs_storage[start_block]) != 0) {
+        kprintf("[TAGFS] ERROR: Failed to load inode table blocks %lu-%lu\n",
+                start_block, end_block - 1);
+        return -1;
     }
 
+    // Образ совпадает с диском; committed транзакции журнала - поверх
+    memset(tagfs_meta_dirty, 0, sizeof(tagfs_meta_dirty));
+    memset(tagfs_journal_slot, 0, sizeof(tagfs_journal_slot));
+    tagfs_journal_replay();
     return 0;
 }
 
-// Полная синхронизация файловой системы с диском
-int tagfs_sync(void) {
-    if (!use_disk) {
-        kprintf("[TAGFS] Sync skipped (memory mode)\n");
+// ============================================================================
+// JOURNAL - write-ahead лог metadata, group commit
+// ============================================================================
+//
+// Commit: dirty блоки metadata (superblock всегда) копируются в журнал в
+// tagfs_storage и уходят на диск одной последовательной командой. Журнал
+// линейный: не хватает места - сначала checkpoint (образы на место,
+// journal_sequence вперёд, head = 0). Транзакция больше журнала (format,
+// миграция) - checkpoint и прямая запись на место, как до журнала.
+//
+// Recovery при mount: транзакции с journal_sequence подряд, пока magic,
+// sequence и CRC сходятся, проигрываются в tagfs_storage и сразу
+// checkpoint'ятся.
+//
+// ============================================================================
+
+static int tagfs_journal_valid(const TagFSSuperblock* sb) {
+    return sb->journal_block != 0 && sb->journal_blocks >= 2 &&
+           sb->journal_blocks <= 255 &&  // Слот - uint8_t
+           sb->journal_block >= sb->tag_index_block &&
+           sb->journal_block + sb->journal_blocks <= sb->data_blocks_start &&
+           sb->data_blocks_start <= TAGFS_MEM_BLOCKS;
+}
+
+static inline int tagfs_journal_contains(const TagFSSuperblock* sb, uint64_t block) {
+    return block >= sb->journal_block && block < sb->journal_block + sb->journal_blocks;
+}
+
+// Образы из журнала на место, затем superblock с новым journal_sequence.
+// Под commit_lock (write). 0 = успех, -1 = ошибка записи (журнал остаётся, recovery повторит)
+static int tagfs_journal_checkpoint(void) {
+    TagFSSuperblock* sb = global_tagfs.superblock;
+    if (global_tagfs.journal_head == 0) {
         return 0;
     }
 
-    kprintf("[TAGFS] Full sync to disk...\n");
+    uint64_t end = sb->data_blocks_start;
+    const uint8_t* images[TAGFS_MEM_BLOCKS];
+    uint64_t written = 0;
 
-    // 1. Sync superblock
-    if (tagfs_sync_superblock() != 0) {
-        kprintf("[TAGFS] ERROR: Failed to sync superblock\n");
-        return -1;
+    // Блоки 1.. подряд идущими runs (ata_write_blocks_gather), superblock - последним
+    for (uint64_t block = 1; block < end; ) {
+        if (!tagfs_journal_slot[block]) {
+            block++;
+            continue;
+        }
+
+        uint32_t run = 0;
+        while (block + run < end && tagfs_journal_slot[block + run]) {
+            images[run] = tagfs_storage[sb->journal_block + tagfs_journal_slot[block + run]];
+            run++;
+        }
+        if (ata_write_blocks_gather(block, run, images) != 0) {
+            kprintf("[TAGFS] ERROR: Checkpoint failed at blocks %lu-%lu\n", block, block + run - 1);
+            return -1;
+        }
+        written += run;
+        block += run;
     }
 
-    // 2. Sync inode table
-    if (tagfs_sync_inode_table() != 0) {
-        kprintf("[TAGFS] ERROR: Failed to sync inode table\n");
+    // Superblock всегда в транзакции. Новый journal_sequence - конец журнала:
+    // пока этот блок не записан, recovery проиграет журнал ещё раз (идемпотентно)
+    TagFSSuperblock* image = (TagFSSuperblock*)tagfs_storage[sb->journal_block + tagfs_journal_slot[0]];
+    image->journal_sequence = global_tagfs.journal_sequence;
+    if (tagfs_write_block_raw(0, (const uint8_t*)image) != 0) {
+        kprintf("[TAGFS] ERROR: Checkpoint failed at superblock\n");
         return -1;
     }
+    sb->journal_sequence = global_tagfs.journal_sequence;
 
-    // 3. Sync data blocks (все блоки с данными)
-    uint64_t data_start = global_tagfs.superblock->data_blocks_start;
-    uint64_t total_blocks = global_tagfs.superblock->total_blocks;
+    memset(tagfs_journal_slot, 0, sizeof(tagfs_journal_slot));
+    global_tagfs.journal_head = 0;
+    atomic_increment_u64(&global_tagfs.journal_checkpoints);
+
+    kprintf("[TAGFS] Checkpoint: %lu block(s) + superblock\n", written);
+    return 0;
+}
 
-    kprintf("[TAGFS] Syncing data blocks (%lu-%lu)...\n", data_start, total_blocks - 1);
+// Все dirty блоки metadata - одна транзакция. Под commit_lock (write)
+static int tagfs_journal_commit(void) {
+    TagFSSuperblock* sb = global_tagfs.superblock;
+    uint64_t end = sb->data_blocks_start;
 
-    for (uint64_t block = data_start; block < total_blocks; block++) {
-        // Проверяем bitmap - пишем только занятые блоки
-        if (bitmap_test_bit(global_tagfs.block_bitmap, block)) {
-            if (tagfs_write_block_raw(block, tagfs_storage[block]) != 0) {
-                kprintf("[TAGFS] ERROR: Failed to sync data block %lu\n", block);
-                return -1;
-            }
+    // Superblock - в каждой транзакции (checkpoint берёт его образ из журнала)
+    bitmap_set_bit(tagfs_meta_dirty, 0);
+
+    uint64_t count = 0;
+    for (uint64_t block = 0; block < end; block++) {
+        if (bitmap_test_bit(tagfs_meta_dirty, block) && !tagfs_journal_contains(sb, block)) {
+            count++;
         }
     }
+    // Не влезает в журнал целиком - прямая запись на место
+    if (count + 1 > sb->journal_blocks) {
+        if (tagfs_journal_checkpoint() != 0) {
+            return -1;
+        }
+        kprintf("[TAGFS] Transaction of %lu blocks exceeds journal, writing in place\n", count);
+        if (tagfs_sync_superblock() != 0 || tagfs_sync_inode_table() != 0) {
+            return -1;
+        }
+        return 0;
+    }
 
-    kprintf("[TAGFS] Sync complete!\n");
-    return 0;
-}
+    if (global_tagfs.journal_head + count + 1 > sb->journal_blocks &&
+        tagfs_journal_checkpoint() != 0) {
+        return -1;
+    }
 
-// ============================================================================
-// DISK MODE CONTROL
-// ============================================================================
+    uint64_t head = global_tagfs.journal_head;
+    uint64_t header_block = sb->journal_block + head;
+    TagFSJournalHeader* header = (TagFSJournalHeader*)tagfs_storage[header_block];
+    memset(header, 0, TAGFS_BLOCK_SIZE);
+    header->magic = TAGFS_JOURNAL_MAGIC;
+    header->sequence = global_tagfs.journal_sequence;
+    header->block_count = (uint32_t)count;
 
-// Включить/выключить режим работы с диском
-void tagfs_set_disk_mode(int enable) {
-    use_disk = enable;
-    if (enable) {
-        kprintf("[TAGFS] Disk mode ENABLED - using ATA driver\n");
-    } else {
-        kprintf("[TAGFS] Disk mode DISABLED - using memory storage\n");
+    uint32_t n = 0;
+    for (uint64_t block = 0; block < end; block++) {
+        if (!bitmap_test_bit(tagfs_meta_dirty, block) || tagfs_journal_contains(sb, block)) {
+            continue;
+        }
+        header->blocks[n] = block;
+        memcpy(tagfs_storage[header_block + 1 + n], tagfs_storage[block], TAGFS_BLOCK_SIZE);
+        n++;
+    }
+    header->crc = crc32c_compute(tagfs_storage[header_block], (count + 1) * TAGFS_BLOCK_SIZE);
+
+    if (ata_write_blocks(header_block, count + 1, tagfs_storage[header_block]) != 0) {
+        kprintf("[TAGFS] ERROR: Journal write failed (%lu blocks)\n", count + 1);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        tagfs_journal_slot[header->blocks[i]] = (uint8_t)(head + 1 + i);
+        bitmap_clear_bit(tagfs_meta_dirty, header->blocks[i]);
     }
+    if (head == 0) {
+        global_tagfs.journal_first_tick = clock_ticks();
+    }
+    global_tagfs.journal_head = head + count + 1;
+    global_tagfs.journal_sequence++;
+
+    atomic_increment_u64(&global_tagfs.journal_commits);
+    atomic_add_u64(&global_tagfs.journal_blocks_logged, count);
+    return 0;
 }
 
-// ============================================================================
-// BLOCK ALLOCATION - Аллокация блоков данных
-// ============================================================================
+// Mount: committed транзакции после последнего checkpoint → tagfs_storage,
+// затем checkpoint. Вызывается после tagfs_load_inode_table (журнал уже в памяти)
+static void tagfs_journal_replay(void) {
+    TagFSSuperblock* sb = global_tagfs.superblock;
+    if (!tagfs_journal_valid(sb)) {
+        return;
+    }
+
+    // Superblock из журнала перезапишет tagfs_storage[0] - layout до проигрыша
+    uint64_t journal_block = sb->journal_block;
+    uint64_t journal_blocks = sb->journal_blocks;
+    uint64_t end = sb->data_blocks_start;
+    uint64_t sequence = sb->journal_sequence;
+    uint64_t pos = 0, replayed = 0;
+
+    while (pos < journal_blocks) {
+        TagFSJournalHeader* header = (TagFSJournalHeader*)tagfs_storage[journal_block + pos];
+        uint64_t count = header->block_count;
+        if (header->magic != TAGFS_JOURNAL_MAGIC || header->sequence != sequence ||
+            count == 0 || pos + 1 + count > journal_blocks) {
+            break;
+        }
+
+        uint32_t crc = header->crc;
+        header->crc = 0;
+        uint32_t actual = crc32c_compute((const uint8_t*)header, (count + 1) * TAGFS_BLOCK_SIZE);
+        header->crc = crc;
+        if (actual != crc) {
+            break;  // Оборванная последняя транзакция
+        }
 
-static uint64_t tagfs_alloc_block(void) {
-    uint64_t block = bitmap_find_free(global_tagfs.block_bitmap, global_tagfs.superblock->total_blocks);
-    if (block != (uint64_t)-1) {
-        // Bounds check to prevent out-of-bounds access
-        if (block >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Block allocation out of bounds (%lu >= %u)\n",
-                    block, TAGFS_MEM_BLOCKS);
-            return (uint64_t)-1;
+        int valid = 1;
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t home = header->blocks[i];
+            // DEFENSIVE: только metadata вне самого журнала
+            if (home >= end || (home >= journal_block && home < journal_block + journal_blocks)) {
+                valid = 0;
+            }
+        }
+        if (!valid) {
+            kprintf("[TAGFS] %[W]WARNING: Journal transaction %lu references invalid blocks%[D]\n",
+                    sequence);
+            break;
         }
 
-        bitmap_set_bit(global_tagfs.block_bitmap, block);
-        global_tagfs.superblock->free_blocks--;
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t home = header->blocks[i];
+            memcpy(tagfs_storage[home], tagfs_storage[journal_block + pos + 1 + i], TAGFS_BLOCK_SIZE);
+            tagfs_journal_slot[home] = (uint8_t)(pos + 1 + i);
+        }
+        pos += count + 1;
+        sequence++;
+        replayed++;
+    }
 
-        // Очищаем блок
-        memset(tagfs_storage[block], 0, TAGFS_BLOCK_SIZE);
+    global_tagfs.journal_head = pos;
+    global_tagfs.journal_sequence = sequence;
+    if (replayed == 0) {
+        return;
     }
-    return block;
-}
 
-static void tagfs_free_block(uint64_t block) {
-    if (block < global_tagfs.superblock->total_blocks && block < TAGFS_MEM_BLOCKS) {
-        bitmap_clear_bit(global_tagfs.block_bitmap, block);
-        global_tagfs.superblock->free_blocks++;
-    } else if (block >= TAGFS_MEM_BLOCKS) {
-        kprintf("[TAGFS] ERROR: Attempt to free invalid block %lu (>= %u)\n",
-                block, TAGFS_MEM_BLOCKS);
+    kprintf("[TAGFS] Journal recovery: replayed %lu transaction(s)\n", replayed);
+    if (tagfs_journal_checkpoint() != 0) {
+        kprintf("[TAGFS] %[W]WARNING: Recovery checkpoint failed, journal kept%[D]\n");
     }
 }
 
-// ============================================================================
-// INDIRECT BLOCKS - Поддержка файлов > 48KB
-// ============================================================================
+// Под commit_lock (write)
+static int tagfs_commit_locked(void) {
+    // 1. Dirty data blocks из block cache - до metadata, которая на них ссылается
+    if (block_cache_flush() != 0) {
+        kprintf("[TAGFS] ERROR: Failed to flush data blocks\n");
+        return -1;
+    }
 
-// Количество указателей в одном indirect блоке
-#define PTRS_PER_BLOCK (TAGFS_BLOCK_SIZE / sizeof(uint64_t))  // 4096 / 8 = 512
+    // 2. Образ posting lists → tagfs_storage (только изменённые блоки dirty)
+    if (tagfs_posting_store() != 0) {
+        kprintf("[TAGFS] %[W]WARNING: Posting lists not saved, next mount rebuilds index%[D]\n");
+    }
 
-// Получить блок данных по глобальному индексу (с учётом direct/indirect/double_indirect)
-// Возвращает номер блока или 0 если блок не выделен
-static uint64_t tagfs_get_block_by_index(FileInode* inode, uint64_t block_idx) {
-    // Direct blocks: 0-11 (48KB)
-    if (block_idx < 12) {
-        return inode->direct_blocks[block_idx];
+    // 3. Metadata: транзакция журнала, на томе без журнала - на место.
+    // Без журнала superblock (CRC образа) пишется раньше образа: оборванный
+    // sync - mismatch и rebuild
+    if (!tagfs_journal_valid(global_tagfs.superblock)) {
+        if (tagfs_sync_superblock() != 0) {
+            kprintf("[TAGFS] ERROR: Failed to sync superblock\n");
+            return -1;
+        }
+        if (tagfs_sync_inode_table() != 0) {
+            kprintf("[TAGFS] ERROR: Failed to sync inode table\n");
+            return -1;
+        }
+        return 0;
     }
 
-    block_idx -= 12;
+    int result = tagfs_journal_commit();
+    if (result != 0) {
+        kprintf("[TAGFS] ERROR: Journal commit failed\n");
+    }
+    return result;
+}
 
-    // Single indirect: 12-523 (512 blocks, до 2MB)
-    if (block_idx < PTRS_PER_BLOCK) {
-        if (inode->indirect_block == 0) {
-            return 0;  // Indirect block не выделен
-        }
+int tagfs_commit(void) {
+    if (!use_disk) {
+        return 0;
+    }
 
-        // Проверка bounds
-        if (inode->indirect_block >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Invalid indirect_block %lu\n", inode->indirect_block);
-            return 0;
-        }
+    write_lock(&global_tagfs.commit_lock);
+    int result = tagfs_commit_locked();
+    write_unlock(&global_tagfs.commit_lock);
+    return result;
+}
 
-        // Читаем указатель из indirect блока
-        uint64_t* indirect_table = (uint64_t*)tagfs_storage[inode->indirect_block];
-        return indirect_table[block_idx];
+// Полная синхронизация файловой системы с диском
+int tagfs_sync(void) {
+    if (!use_disk) {
+        kprintf("[TAGFS] Sync skipped (memory mode)\n");
+        return 0;
     }
 
-    block_idx -= PTRS_PER_BLOCK;
+    kprintf("[TAGFS] Full sync to disk...\n");
 
-    // Double indirect: 524-262667 (512*512 blocks, до 1GB)
-    if (block_idx < PTRS_PER_BLOCK * PTRS_PER_BLOCK) {
-        if (inode->double_indirect_block == 0) {
-            return 0;  // Double indirect block не выделен
-        }
+    write_lock(&global_tagfs.commit_lock);
+    int result = tagfs_commit_locked();
 
-        // Проверка bounds
-        if (inode->double_indirect_block >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Invalid double_indirect_block %lu\n", inode->double_indirect_block);
-            return 0;
-        }
+    // Журнал пуст - всё на месте
+    if (result == 0 && tagfs_journal_valid(global_tagfs.superblock)) {
+        result = tagfs_journal_checkpoint();
+    }
+    write_unlock(&global_tagfs.commit_lock);
+
+    if (result != 0) {
+        return -1;
+    }
 
-        // Первый уровень
-        uint64_t level1_idx = block_idx / PTRS_PER_BLOCK;
-        uint64_t level2_idx = block_idx % PTRS_PER_BLOCK;
+    kprintf("[TAGFS] Sync complete!\n");
+    return 0;
+}
 
-        uint64_t* level1_table = (uint64_t*)tagfs_storage[inode->double_indirect_block];
-        uint64_t level2_block = level1_table[level1_idx];
+void tagfs_checkpoint_idle(void) {
+    if (!use_disk || global_tagfs.journal_head == 0 || !write_trylock(&global_tagfs.commit_lock)) {
+        return;
+    }
 
-        if (level2_block == 0) {
-            return 0;  // Level2 block не выделен
-        }
+    uint64_t age = clock_ticks() - global_tagfs.journal_first_tick;
+    if (age >= TAGFS_JOURNAL_CHECKPOINT_AGE ||
+        global_tagfs.journal_head * 2 >= global_tagfs.superblock->journal_blocks) {
+        tagfs_journal_checkpoint();
+    }
+    write_unlock(&global_tagfs.commit_lock);
+}
 
-        if (level2_block >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Invalid level2_block %lu\n", level2_block);
-            return 0;
-        }
+// ============================================================================
+// DISK MODE CONTROL
+// ============================================================================
 
-        // Второй уровень
-        uint64_t* level2_table = (uint64_t*)tagfs_storage[level2_block];
-        return level2_table[level2_idx];
+// Включить/выключить режим работы с диском
+void tagfs_set_disk_mode(int enable) {
+    use_disk = enable;
+    if (enable) {
+        kprintf("[TAGFS] Disk mode ENABLED - using ATA driver\n");
+    } else {
+        kprintf("[TAGFS] Disk mode DISABLED - using memory storage\n");
     }
+}
 
-    kprintf("[TAGFS] ERROR: Block index %lu too large (file too big)\n", block_idx + 12 + PTRS_PER_BLOCK);
-    return 0;
+// Максимальный размер тома в блоках: memory mode - tagfs_storage, disk
+// mode - устройство (LBA28), не больше TAGFS_MAX_VOLUME_BLOCKS
+static uint64_t tagfs_volume_blocks(void) {
+    if (!use_disk) {
+        return TAGFS_MEM_BLOCKS;
+    }
+    uint64_t blocks = ata_block_device()->total_sectors / (TAGFS_BLOCK_SIZE / ATA_SECTOR_SIZE);
+    return blocks < TAGFS_MAX_VOLUME_BLOCKS ? blocks : TAGFS_MAX_VOLUME_BLOCKS;
 }
 
-// Выделить блок данных по глобальному индексу (создаёт indirect блоки при необходимости)
-// Возвращает номер блока или (uint64_t)-1 при ошибке
-static uint64_t tagfs_alloc_block_by_index(FileInode* inode, uint64_t block_idx) {
-    // Direct blocks: 0-11
-    if (block_idx < 12) {
-        if (inode->direct_blocks[block_idx] == 0) {
-            inode->direct_blocks[block_idx] = tagfs_alloc_block();
-        }
-        return inode->direct_blocks[block_idx];
+// ============================================================================
+// BLOCK ALLOCATION - Extents (непрерывные runs блоков данных)
+// ============================================================================
+
+// Конец data region. total_blocks проверен при mount (<= tagfs_volume_blocks)
+static inline uint64_t tagfs_data_end(void) {
+    uint64_t end = global_tagfs.superblock->total_blocks;
+    if (!use_disk && end > TAGFS_MEM_BLOCKS) {
+        end = TAGFS_MEM_BLOCKS;
     }
+    return end;
+}
 
-    block_idx -= 12;
+// Extent block_num+run целиком в data region
+static inline int tagfs_extent_in_volume(uint64_t block_num, uint64_t run) {
+    uint64_t end = tagfs_data_end();
+    return block_num >= global_tagfs.superblock->data_blocks_start && block_num < end &&
+           run <= end - block_num;
+}
 
-    // Single indirect: 12-523
-    if (block_idx < PTRS_PER_BLOCK) {
-        // Выделяем indirect block если ещё нет
-        if (inode->indirect_block == 0) {
-            inode->indirect_block = tagfs_alloc_block();
-            if (inode->indirect_block == (uint64_t)-1) {
-                return (uint64_t)-1;
-            }
-        }
+// Длина свободного run от start (не больше limit), по 64 блока за шаг
+static uint64_t tagfs_free_run_length(uint64_t start, uint64_t end, uint64_t limit) {
+    if (start >= end) {
+        return 0;
+    }
+    if (limit > end - start) {
+        limit = end - start;
+    }
+    return bitmap_alloc_run_length(&global_tagfs.block_alloc, start, limit);
+}
 
-        if (inode->indirect_block >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Invalid indirect_block %lu\n", inode->indirect_block);
-            return (uint64_t)-1;
-        }
+// Выделить до want блоков подряд. goal - блок сразу за последним extent
+// файла: свободен - файл растёт на месте. Иначе (если anywhere) best-fit:
+// наименьший свободный run >= want, нет такого - наибольший (остаток
+// получит следующий extent). Содержимое не обнуляется - это делает запись.
+// Возвращает первый блок, (uint64_t)-1 = нет места
+static uint64_t tagfs_alloc_extent(uint64_t want, uint64_t goal, int anywhere, uint64_t* length_out) {
+    uint64_t data_start = global_tagfs.superblock->data_blocks_start;
+    uint64_t end = tagfs_data_end();
+    uint64_t start = (uint64_t)-1;
+    uint64_t length = 0;
 
-        uint64_t* indirect_table = (uint64_t*)tagfs_storage[inode->indirect_block];
+    spin_lock(&global_tagfs.alloc_lock);
 
-        // Выделяем data block если ещё нет
-        if (indirect_table[block_idx] == 0) {
-            indirect_table[block_idx] = tagfs_alloc_block();
+    if (goal >= data_start && goal < end) {
+        length = tagfs_free_run_length(goal, end, want);
+        if (length > 0) {
+            start = goal;
         }
-
-        return indirect_table[block_idx];
     }
 
-    block_idx -= PTRS_PER_BLOCK;
+    if (start == (uint64_t)-1 && anywhere) {
+        uint64_t best_start = 0, best_length = 0;
+        uint64_t largest_start = 0, largest_length = 0;
 
-    // Double indirect: 524-262667
-    if (block_idx < PTRS_PER_BLOCK * PTRS_PER_BLOCK) {
-        // Выделяем double indirect block если ещё нет
-        if (inode->double_indirect_block == 0) {
-            inode->double_indirect_block = tagfs_alloc_block();
-            if (inode->double_indirect_block == (uint64_t)-1) {
-                return (uint64_t)-1;
+        for (uint64_t block = data_start; block < end; ) {
+            // Занятые блоки перескакиваем сразу до следующего свободного
+            block = bitmap_alloc_next_free(&global_tagfs.block_alloc, block, end);
+            if (block == BITMAP_ALLOC_NONE) {
+                break;
+            }
+            uint64_t run = tagfs_free_run_length(block, end, end);
+            if (run >= want && (best_length == 0 || run < best_length)) {
+                best_start = block;
+                best_length = run;
+                if (run == want) {
+                    break;  // Точное совпадение - лучше не будет
+                }
             }
+            if (run > largest_length) {
+                largest_start = block;
+                largest_length = run;
+            }
+            block += run;
         }
 
-        if (inode->double_indirect_block >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Invalid double_indirect_block %lu\n", inode->double_indirect_block);
-            return (uint64_t)-1;
+        if (best_length > 0) {
+            start = best_start;
+            length = want;
+        } else if (largest_length > 0) {
+            start = largest_start;
+            length = largest_length;
         }
+    }
 
-        uint64_t level1_idx = block_idx / PTRS_PER_BLOCK;
-        uint64_t level2_idx = block_idx % PTRS_PER_BLOCK;
+    if (start == (uint64_t)-1) {
+        spin_unlock(&global_tagfs.alloc_lock);
+        return (uint64_t)-1;
+    }
 
-        uint64_t* level1_table = (uint64_t*)tagfs_storage[inode->double_indirect_block];
+    bitmap_alloc_set(&global_tagfs.block_alloc, start, length);
+    global_tagfs.superblock->free_blocks -= length;
+    tagfs_mark_superblock_dirty();
 
-        // Выделяем level2 block если ещё нет
-        if (level1_table[level1_idx] == 0) {
-            level1_table[level1_idx] = tagfs_alloc_block();
-            if (level1_table[level1_idx] == (uint64_t)-1) {
-                return (uint64_t)-1;
-            }
-        }
+    spin_unlock(&global_tagfs.alloc_lock);
+
+    *length_out = length;
+    return start;
+}
 
-        uint64_t level2_block = level1_table[level1_idx];
+static void tagfs_free_block(uint64_t block) {
+    if (tagfs_extent_in_volume(block, 1)) {
+        spin_lock(&global_tagfs.alloc_lock);
+        bitmap_alloc_clear(&global_tagfs.block_alloc, block, 1);
+        global_tagfs.superblock->free_blocks++;
+        tagfs_mark_superblock_dirty();
+        spin_unlock(&global_tagfs.alloc_lock);
 
-        if (level2_block >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Invalid level2_block %lu\n", level2_block);
-            return (uint64_t)-1;
+        // Dirty содержимое свободного блока писать незачем
+        if (tagfs_block_cached(block)) {
+            block_cache_invalidate(block);
         }
+    } else {
+        kprintf("[TAGFS] ERROR: Attempt to free invalid block %lu (data %lu-%lu)\n",
+                block, global_tagfs.superblock->data_blocks_start, tagfs_data_end());
+    }
+}
 
-        uint64_t* level2_table = (uint64_t*)tagfs_storage[level2_block];
+// ============================================================================
+// EXTENT MAP - логический блок файла → физический
+// ============================================================================
 
-        // Выделяем data block если ещё нет
-        if (level2_table[level2_idx] == 0) {
-            level2_table[level2_idx] = tagfs_alloc_block();
+// Физический блок для логического block_idx и сколько блоков подряд за ним
+// в том же extent (*run_out). 0 = за концом выделенного
+static uint64_t tagfs_map_block(const FileInode* inode, uint64_t block_idx, uint64_t* run_out) {
+    for (uint32_t i = 0; i < inode->extent_count && i < TAGFS_MAX_EXTENTS; i++) {
+        const TagFSExtent* extent = &inode->extents[i];
+        if (block_idx < extent->length) {
+            *run_out = extent->length - block_idx;
+            return extent->start + block_idx;
         }
-
-        return level2_table[level2_idx];
+        block_idx -= extent->length;
     }
+    *run_out = 0;
+    return 0;
+}
 
-    kprintf("[TAGFS] ERROR: Block index %lu too large (max file size exceeded)\n", block_idx + 12 + PTRS_PER_BLOCK);
-    return (uint64_t)-1;
+static uint64_t tagfs_inode_blocks(const FileInode* inode) {
+    uint64_t blocks = 0;
+    for (uint32_t i = 0; i < inode->extent_count && i < TAGFS_MAX_EXTENTS; i++) {
+        blocks += inode->extents[i].length;
+    }
+    return blocks;
 }
 
-// Освободить все indirect блоки файла
-static void tagfs_free_indirect_blocks(FileInode* inode) {
-    // Освобождаем single indirect
-    if (inode->indirect_block != 0 && inode->indirect_block < TAGFS_MEM_BLOCKS) {
-        uint64_t* indirect_table = (uint64_t*)tagfs_storage[inode->indirect_block];
+// Дорастить файл до blocks блоков: сначала на месте за последним extent,
+// потом новыми extents. Возвращает 1, 0 = нет места / extents кончились
+// (выделенное до ошибки остаётся у файла)
+static int tagfs_inode_grow(FileInode* inode, uint64_t blocks) {
+    uint64_t have = tagfs_inode_blocks(inode);
 
-        // Освобождаем все data blocks
-        for (uint32_t i = 0; i < PTRS_PER_BLOCK; i++) {
-            if (indirect_table[i] != 0) {
-                tagfs_free_block(indirect_table[i]);
-            }
+    while (have < blocks) {
+        TagFSExtent* last = inode->extent_count ? &inode->extents[inode->extent_count - 1] : 0;
+        uint64_t goal = last ? last->start + last->length : 0;
+        int anywhere = inode->extent_count < TAGFS_MAX_EXTENTS;
+
+        uint64_t length = 0;
+        uint64_t start = tagfs_alloc_extent(blocks - have, goal, anywhere, &length);
+        if (start == (uint64_t)-1) {
+            return 0;
         }
 
-        // Освобождаем сам indirect block
-        tagfs_free_block(inode->indirect_block);
-        inode->indirect_block = 0;
+        if (last && start == goal) {
+            last->length += length;
+        } else {
+            inode->extents[inode->extent_count].start = start;
+            inode->extents[inode->extent_count].length = length;
+            inode->extent_count++;
+        }
+        have += length;
     }
+    return 1;
+}
 
-    // Освобождаем double indirect
-    if (inode->double_indirect_block != 0 && inode->double_indirect_block < TAGFS_MEM_BLOCKS) {
-        uint64_t* level1_table = (uint64_t*)tagfs_storage[inode->double_indirect_block];
+// ============================================================================
+// INLINE DATA - маленький файл в месте extents
+// ============================================================================
 
-        // Проходим по всем level2 блокам
-        for (uint32_t i = 0; i < PTRS_PER_BLOCK; i++) {
-            uint64_t level2_block = level1_table[i];
+_Static_assert(sizeof(((FileInode*)0)->inline_data) == sizeof(((FileInode*)0)->extents),
+               "inline_data occupies exactly the extent array");
 
-            if (level2_block != 0 && level2_block < TAGFS_MEM_BLOCKS) {
-                uint64_t* level2_table = (uint64_t*)tagfs_storage[level2_block];
+static inline int tagfs_inode_is_inline(const FileInode* inode) {
+    return (inode->flags & TAGFS_INODE_INLINE) != 0;
+}
 
-                // Освобождаем все data blocks
-                for (uint32_t j = 0; j < PTRS_PER_BLOCK; j++) {
-                    if (level2_table[j] != 0) {
-                        tagfs_free_block(level2_table[j]);
-                    }
-                }
+// Inline данные → первый блок файла (запись выходит за inline_data).
+// Возвращает 1, 0 = нет места / I/O (inode остаётся inline, данные целы)
+static int tagfs_inline_promote(FileInode* inode) {
+    uint8_t data[TAGFS_INLINE_DATA_SIZE];
+    uint64_t size = inode->size < TAGFS_INLINE_DATA_SIZE ? inode->size : TAGFS_INLINE_DATA_SIZE;
+    memcpy(data, inode->inline_data, size);
+
+    inode->flags &= ~TAGFS_INODE_INLINE;
+    memset(inode->extents, 0, sizeof(inode->extents));
+    inode->extent_count = 0;
+
+    uint8_t* block_data = 0;
+    uint64_t run = 0;
+    uint64_t block = 0;
+    if (tagfs_inode_grow(inode, 1)) {
+        block = tagfs_map_block(inode, 0, &run);
+        block_data = tagfs_block_get(block, BLOCK_CACHE_ZERO);
+    }
+    if (!block_data) {
+        tagfs_free_extents(inode);
+        memcpy(inode->inline_data, data, size);
+        inode->flags |= TAGFS_INODE_INLINE;
+        return 0;
+    }
 
-                // Освобождаем level2 block
-                tagfs_free_block(level2_block);
-            }
+    memcpy(block_data, data, size);
+    tagfs_block_put(block, 1);
+    tagfs_mark_inode_dirty(inode);
+    return 1;
+}
+
+static void tagfs_free_extents(FileInode* inode) {
+    for (uint32_t i = 0; i < inode->extent_count && i < TAGFS_MAX_EXTENTS; i++) {
+        for (uint64_t j = 0; j < inode->extents[i].length; j++) {
+            tagfs_free_block(inode->extents[i].start + j);
         }
+    }
+    memset(inode->extents, 0, sizeof(inode->extents));
+    inode->extent_count = 0;
+}
+
+// Полные блоки [start, start + count) одной передачей (disk mode - мимо cache)
+static int tagfs_read_span(uint64_t start, uint64_t count, uint8_t* buffer) {
+    if (tagfs_block_cached(start)) {
+        return block_cache_read_span(start, count, buffer);
+    }
+    memcpy(buffer, tagfs_storage[start], count * TAGFS_BLOCK_SIZE);
+    return 0;
+}
 
-        // Освобождаем level1 block
-        tagfs_free_block(inode->double_indirect_block);
-        inode->double_indirect_block = 0;
+static int tagfs_write_span(uint64_t start, uint64_t count, const uint8_t* buffer) {
+    if (tagfs_block_cached(start)) {
+        return block_cache_write_span(start, count, buffer);
     }
+    memcpy(tagfs_storage[start], buffer, count * TAGFS_BLOCK_SIZE);
+    return 0;
 }
 
 // ============================================================================
 // INODE ALLOCATION
 // ============================================================================
 
-static uint64_t tagfs_alloc_inode(void) {
-    // Safely cap to prevent overflow
-    uint64_t safe_total = global_tagfs.superblock->total_inodes;
-    if (safe_total > TAGFS_MAX_FILES) {
-        safe_total = TAGFS_MAX_FILES;
-    }
-
-    uint64_t inode_num = bitmap_find_free(global_tagfs.inode_bitmap, safe_total);
-    if (inode_num != (uint64_t)-1) {
-        bitmap_set_bit(global_tagfs.inode_bitmap, inode_num);
+// Свободный слот inode_table (*slot_out) + новый inode ID.
+// Поиск от inode_hint: только что освобождённые слоты не перебираются первыми
+static uint64_t tagfs_alloc_inode(uint32_t* slot_out) {
+    spin_lock(&global_tagfs.alloc_lock);
+    uint64_t inode_num = bitmap_alloc_find(&global_tagfs.inode_alloc, global_tagfs.inode_hint);
+    if (inode_num != BITMAP_ALLOC_NONE) {
+        bitmap_alloc_set(&global_tagfs.inode_alloc, inode_num, 1);
+        global_tagfs.inode_hint = inode_num + 1;
+        *slot_out = (uint32_t)inode_num;
         global_tagfs.superblock->free_inodes--;
+        tagfs_mark_superblock_dirty();
+        spin_unlock(&global_tagfs.alloc_lock);
 
         // Генерируем уникальный ID (комбинация номера и timestamp)
         uint64_t inode_id = atomic_increment_u64(&global_tagfs.next_inode_id);
         return inode_id;
     }
+    spin_unlock(&global_tagfs.alloc_lock);
     return TAGFS_INVALID_INODE;
 }
 
+// Слот обратно в inode bitmap (inode уже очищен под своим lock)
+static void tagfs_release_inode_slot(uint64_t slot) {
+    spin_lock(&global_tagfs.alloc_lock);
+    bitmap_alloc_clear(&global_tagfs.inode_alloc, slot, 1);
+    global_tagfs.superblock->free_inodes++;
+    tagfs_mark_superblock_dirty();
+    spin_unlock(&global_tagfs.alloc_lock);
+}
+
 static void tagfs_free_inode(uint64_t inode_id) {
     // Safely cap to prevent overflow
     uint32_t safe_max = global_tagfs.superblock->total_inodes;
@@ -483,19 +913,12 @@ static void tagfs_free_inode(uint64_t inode_id) {
         if (global_tagfs.inode_table[i].inode_id == inode_id) {
             FileInode* inode = &global_tagfs.inode_table[i];
 
-            // Освобождаем все direct blocks
-            for (uint32_t j = 0; j < 12; j++) {
-                if (inode->direct_blocks[j] != 0) {
-                    tagfs_free_block(inode->direct_blocks[j]);
-                }
-            }
+            // Освобождаем все extents
+            tagfs_free_extents(inode);
 
-            // Освобождаем indirect и double indirect blocks
-            tagfs_free_indirect_blocks(inode);
-
-            bitmap_clear_bit(global_tagfs.inode_bitmap, i);
-            global_tagfs.superblock->free_inodes++;
             memset(inode, 0, sizeof(FileInode));
+            tagfs_mark_inode_dirty(inode);
+            tagfs_release_inode_slot(i);
             break;
         }
     }
@@ -537,42 +960,230 @@ int tagfs_tag_equal(const Tag* a, const Tag* b) {
 }
 
 // ============================================================================
-// INITIALIZATION
+// MIGRATION - v3 (Tag целиком в inode) → v4 (tag IDs)
 // ============================================================================
 
-void tagfs_init(void) {
-    kprintf("[TAGFS] Initializing tag-based filesystem...\n");
+// Inode формата v3, только для чтения при миграции
+typedef struct {
+    uint64_t inode_id;
+    uint64_t size;
+    uint64_t creation_time;
+    uint64_t modification_time;
+    uint32_t tag_count;
+    uint32_t flags;
+    Tag tags[TAGFS_MAX_TAGS_PER_FILE];
+    uint32_t extent_count;
+    uint32_t reserved;
+    TagFSExtent extents[TAGFS_MAX_EXTENTS];
+    uint8_t padding[8];
+} TagFSInlineTagsInode;
+
+_Static_assert(sizeof(TagFSInlineTagsInode) == 3352, "v3 inode layout");
+_Static_assert(sizeof(FileInode) < sizeof(TagFSInlineTagsInode), "In-place migration needs smaller inodes");
+
+// Переписать загруженную inode table на месте: теги → tag dictionary,
+// inode i v4 лежит не дальше начала inode i v3, поэтому проход вперёд
+// не затирает ещё не прочитанные inodes. Освободившееся место в регионе -
+// новые inodes. Всё помечается dirty, на диск - при следующем sync
+static int tagfs_migrate_inline_tags(void) {
+    TagFSSuperblock* sb = global_tagfs.superblock;
+    if (sb->tag_index_block <= sb->inode_table_block || sb->data_blocks_start > TAGFS_MEM_BLOCKS ||
+        sb->data_blocks_start < sb->tag_index_block) {
+        return -1;
+    }
+
+    uint64_t region = (sb->tag_index_block - sb->inode_table_block) * TAGFS_BLOCK_SIZE;
+    uint64_t old_total = sb->total_inodes;
+    if (old_total * sizeof(TagFSInlineTagsInode) > region) {
+        return -1;
+    }
+
+    TagFSInlineTagsInode* old = (TagFSInlineTagsInode*)kmalloc(sizeof(TagFSInlineTagsInode));
+    if (!old) {
+        return -1;
+    }
+
+    kprintf("[TAGFS] Migrating version %u filesystem to tag IDs...\n", sb->version);
+
+    // v3 tag index region не записывал - словарь с нуля
+    memset(tagfs_storage[sb->tag_index_block], 0,
+           (sb->data_blocks_start - sb->tag_index_block) * TAGFS_BLOCK_SIZE);
+    sb->tag_count = 0;
+
+    // Региона под образ posting lists у v3 нет - только rebuild при mount
+    sb->posting_block = 0;
+    sb->posting_blocks = 0;
+    sb->posting_size = 0;
+    sb->journal_block = 0;
+    sb->journal_blocks = 0;
+    tagfs_tag_dict_reset();
+
+    uint8_t* table = tagfs_storage[sb->inode_table_block];
+    uint64_t migrated = 0, dropped_tags = 0;
+
+    for (uint64_t i = 0; i < old_total; i++) {
+        memcpy(old, table + i * sizeof(TagFSInlineTagsInode), sizeof(TagFSInlineTagsInode));
+
+        FileInode* inode = (FileInode*)table + i;
+        memset(inode, 0, sizeof(FileInode));
+        if (old->inode_id == 0) {
+            continue;
+        }
+
+        inode->inode_id = old->inode_id;
+        inode->size = old->size;
+        inode->creation_time = old->creation_time;
+        inode->modification_time = old->modification_time;
+        inode->flags = old->flags & ~TAGFS_INODE_INLINE;  // v3 inline data не знал
+        for (uint32_t t = 0; t < old->tag_count && t < TAGFS_MAX_TAGS_PER_FILE; t++) {
+            uint32_t tag_id = tagfs_tag_intern_locked(&old->tags[t]);
+            if (tag_id == TAGFS_INVALID_TAG_ID) {
+                dropped_tags++;
+                continue;
+            }
+            inode->tag_ids[inode->tag_count++] = tag_id;
+        }
+        inode->extent_count = old->extent_count;
+        memcpy(inode->extents, old->extents, sizeof(inode->extents));
+        migrated++;
+    }
+    kfree(old);
+
+    // Хвост региона за новыми inodes - остатки v3
+    uint64_t used = old_total * sizeof(FileInode);
+    memset(table + used, 0, region - used);
+
+    uint64_t new_total = region / sizeof(FileInode);
+    if (new_total > TAGFS_MAX_FILES) {
+        new_total = TAGFS_MAX_FILES;
+    }
+    if (new_total > old_total) {
+        sb->free_inodes += new_total - old_total;
+        sb->total_inodes = new_total;
+    }
+    sb->version = TAGFS_VERSION;
+
+    tagfs_mark_superblock_dirty();
+    for (uint64_t block = sb->inode_table_block; block < sb->tag_index_block; block++) {
+        bitmap_set_bit(tagfs_meta_dirty, block);
+    }
+
+    kprintf("[TAGFS] Migrated %lu files, %u unique tags, %lu inodes total\n",
+            migrated, global_tagfs.tag_index.entry_count, sb->total_inodes);
+    if (dropped_tags > 0) {
+        kprintf("[TAGFS] %[W]WARNING: %lu tags dropped (tag dictionary full)%[D]\n", dropped_tags);
+    }
+    return 0;
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+// Layout superblock с диска в пределах tagfs_storage и устройства.
+// 0 = можно монтировать, -1 = битые metadata (том не трогаем)
+static int tagfs_superblock_check(uint64_t volume_blocks) {
+    TagFSSuperblock* sb = global_tagfs.superblock;
+
+    if (sb->inode_table_block >= TAGFS_MEM_BLOCKS) {
+        kprintf("[TAGFS] ERROR: Invalid inode_table_block (%lu >= %u)\n",
+                sb->inode_table_block, TAGFS_MEM_BLOCKS);
+        return -1;
+    }
+    if (sb->data_blocks_start > TAGFS_MEM_BLOCKS) {
+        kprintf("[TAGFS] ERROR: Invalid data_blocks_start (%lu > %u)\n",
+                sb->data_blocks_start, TAGFS_MEM_BLOCKS);
+        return -1;
+    }
+    if (sb->total_blocks > volume_blocks) {
+        kprintf("[TAGFS] ERROR: Invalid total_blocks (%lu > %lu)\n",
+                sb->total_blocks, volume_blocks);
+        return -1;
+    }
+
+    uint64_t available_inode_blocks = 0;
+    if (sb->tag_index_block > sb->inode_table_block) {
+        available_inode_blocks = sb->tag_index_block - sb->inode_table_block;
+    }
+    uint64_t max_possible_inodes = (available_inode_blocks * TAGFS_BLOCK_SIZE) / TAGFS_INODE_SIZE;
+    if (sb->total_inodes > max_possible_inodes) {
+        kprintf("[TAGFS] ERROR: Invalid total_inodes (%lu > max %lu)\n",
+                sb->total_inodes, max_possible_inodes);
+        return -1;
+    }
+    return 0;
+}
+
+void tagfs_init(void) {
+    kprintf("[TAGFS] Initializing tag-based filesystem...\n");
 
     memset(&global_tagfs, 0, sizeof(TagFSContext));
+    rwlock_init(&global_tagfs.commit_lock);
+    rwlock_init(&global_tagfs.index_lock);
+    spinlock_init(&global_tagfs.alloc_lock);
+    for (uint32_t i = 0; i < TAGFS_INODE_LOCKS; i++) {
+        rwlock_init(&tagfs_inode_locks[i]);
+    }
+    block_cache_init();
+    block_queue_init();
+
+    // CRC32C образа posting lists - до operations deck, который init'ит engine позже
+    crc32_engine_init();
 
     // Allocate superblock in memory
     global_tagfs.superblock = (TagFSSuperblock*)tagfs_storage[0];
 
     // Проверяем наличие ATA диска
     int disk_available = 0;
-    if (ata_primary_master.exists) {
-        kprintf("[TAGFS] ATA disk detected: %s (%lu MB)\n",
-                ata_primary_master.model, ata_primary_master.size_mb);
+    const ATADevice* disk = ata_block_device();
+    if (disk->exists) {
+        kprintf("[TAGFS] ATA disk detected: %s (%lu MB)\n", disk->model, disk->size_mb);
         disk_available = 1;
     }
 
-    // Если диск доступен, пытаемся загрузить ФС с диска
+    // Если диск доступен, пытаемся загрузить ФС с диска.
+    // CRITICAL: том, который не смонтировали (чужая версия, битые metadata,
+    // ошибка чтения), не форматируется - диск не трогаем, работаем в памяти
     int loaded_from_disk = 0;
+    int refused = 0;
     if (disk_available) {
         tagfs_set_disk_mode(1);  // Включаем режим диска
 
         kprintf("[TAGFS] Attempting to load filesystem from disk...\n");
         if (tagfs_load_superblock() == 0) {
-            if (global_tagfs.superblock->magic == TAGFS_MAGIC) {
+            if (global_tagfs.superblock->magic == TAGFS_MAGIC &&
+                global_tagfs.superblock->version == TAGFS_VERSION_BLOCK_POINTERS) {
+                kprintf("[TAGFS] Version %u filesystem (block pointers) is not migrated to %u\n",
+                        TAGFS_VERSION_BLOCK_POINTERS, TAGFS_VERSION);
+                refused = 1;
+            } else if (global_tagfs.superblock->magic == TAGFS_MAGIC &&
+                       global_tagfs.superblock->version != TAGFS_VERSION &&
+                       global_tagfs.superblock->version != TAGFS_VERSION_INLINE_TAGS) {
+                kprintf("[TAGFS] Incompatible filesystem version %u (need %u)\n",
+                        global_tagfs.superblock->version, TAGFS_VERSION);
+                refused = 1;
+            } else if (global_tagfs.superblock->magic == TAGFS_MAGIC) {
                 kprintf("[TAGFS] Valid superblock found on disk (version %u)\n",
                         global_tagfs.superblock->version);
 
-                // Загружаем таблицу inodes
-                if (tagfs_load_inode_table() == 0) {
+                // Layout проверяем до загрузки (inode table читается по нему),
+                // затем таблица inodes и tag dictionary (v3 - переводим в tag IDs)
+                if (tagfs_superblock_check(tagfs_volume_blocks()) != 0) {
+                    refused = 1;
+                } else if (tagfs_load_inode_table() != 0) {
+                    kprintf("[TAGFS] Failed to load inode table from disk\n");
+                    refused = 1;
+                } else if (global_tagfs.superblock->version == TAGFS_VERSION_INLINE_TAGS &&
+                           tagfs_migrate_inline_tags() != 0) {
+                    kprintf("[TAGFS] Failed to migrate version %u filesystem\n",
+                            TAGFS_VERSION_INLINE_TAGS);
+                    refused = 1;
+                } else if (tagfs_tag_dict_load() != 0) {
+                    kprintf("[TAGFS] Failed to load tag dictionary\n");
+                    refused = 1;
+                } else {
                     kprintf("[TAGFS] Successfully loaded filesystem from disk!\n");
                     loaded_from_disk = 1;
-                } else {
-                    kprintf("[TAGFS] Failed to load inode table from disk\n");
                 }
             } else {
                 kprintf("[TAGFS] No valid filesystem on disk (magic=0x%lx)\n",
@@ -580,57 +1191,54 @@ void tagfs_init(void) {
             }
         } else {
             kprintf("[TAGFS] Failed to read superblock from disk\n");
+            refused = 1;
         }
     }
 
-    // Если не загрузили с диска, форматируем
+    if (refused) {
+        kprintf("[TAGFS] %[E]Volume on disk NOT mounted and left untouched - using memory storage%[D]\n");
+        tagfs_set_disk_mode(0);
+        // В tagfs_storage мог остаться образ metadata с диска
+        memset(tagfs_storage, 0, sizeof(tagfs_storage));
+    }
+
+    // Disk mode - весь диск, metadata по-прежнему в первых TAGFS_MEM_BLOCKS
+    uint64_t volume_blocks = tagfs_volume_blocks();
+
+    // Если не загрузили с диска, форматируем (пустой диск или память)
     if (!loaded_from_disk) {
         kprintf("[TAGFS] Creating new filesystem...\n");
-        tagfs_format(TAGFS_MEM_BLOCKS);
+        tagfs_format(volume_blocks);
 
         // PRODUCTION: Don't sync empty filesystem - это долго и не нужно
         // Disk sync будет при первой записи файла
         kprintf("[TAGFS] Filesystem formatted (disk sync deferred)\n");
     }
 
-    // Validate superblock values to prevent out-of-bounds access
-    if (global_tagfs.superblock->inode_table_block >= TAGFS_MEM_BLOCKS) {
-        kprintf("[TAGFS] ERROR: Invalid inode_table_block (%lu >= %u), reformatting...\n",
-                global_tagfs.superblock->inode_table_block, TAGFS_MEM_BLOCKS);
-        tagfs_format(TAGFS_MEM_BLOCKS);
-    }
-
-    if (global_tagfs.superblock->data_blocks_start > TAGFS_MEM_BLOCKS) {
-        kprintf("[TAGFS] ERROR: Invalid data_blocks_start (%lu > %u), reformatting...\n",
-                global_tagfs.superblock->data_blocks_start, TAGFS_MEM_BLOCKS);
-        tagfs_format(TAGFS_MEM_BLOCKS);
-    }
-
-    if (global_tagfs.superblock->total_blocks > TAGFS_MEM_BLOCKS) {
-        kprintf("[TAGFS] ERROR: Invalid total_blocks (%lu > %u), reformatting...\n",
-                global_tagfs.superblock->total_blocks, TAGFS_MEM_BLOCKS);
-        tagfs_format(TAGFS_MEM_BLOCKS);
+    // Том меньше устройства (отформатирован до large volume или на меньшем
+    // диске) - блоки за total_blocks TagFS не использовал, отдаём data region.
+    // Bitmap на диске не хранится - меняется только superblock
+    if (use_disk && global_tagfs.superblock->total_blocks < volume_blocks) {
+        uint64_t grow = volume_blocks - global_tagfs.superblock->total_blocks;
+        kprintf("[TAGFS] Growing volume %lu -> %lu blocks\n",
+                global_tagfs.superblock->total_blocks, volume_blocks);
+        global_tagfs.superblock->total_blocks = volume_blocks;
+        global_tagfs.superblock->free_blocks += grow;
+        tagfs_mark_superblock_dirty();
     }
 
-    // Validate total_inodes doesn't exceed available space
-    uint64_t available_inode_blocks = 0;
-    if (global_tagfs.superblock->tag_index_block > global_tagfs.superblock->inode_table_block) {
-        available_inode_blocks = global_tagfs.superblock->tag_index_block - global_tagfs.superblock->inode_table_block;
-    }
-    uint64_t max_possible_inodes = (available_inode_blocks * TAGFS_BLOCK_SIZE) / TAGFS_INODE_SIZE;
-
-    if (global_tagfs.superblock->total_inodes > max_possible_inodes) {
-        kprintf("[TAGFS] ERROR: Invalid total_inodes (%lu > max %lu), reformatting...\n",
-                global_tagfs.superblock->total_inodes, max_possible_inodes);
-        tagfs_format(TAGFS_MEM_BLOCKS);
-    }
 
     // Setup inode table (starts at block 1)
     global_tagfs.inode_table = (FileInode*)tagfs_storage[global_tagfs.superblock->inode_table_block];
 
-    // Allocate bitmaps
-    uint64_t block_bitmap_size = (global_tagfs.superblock->total_blocks + 7) / 8;
-    uint64_t inode_bitmap_size = (global_tagfs.superblock->total_inodes + 7) / 8;
+    // Allocate bitmaps (кратно 8 байтам - поиск идёт словами)
+    uint64_t block_bits = global_tagfs.superblock->total_blocks;
+    uint64_t inode_bits = global_tagfs.superblock->total_inodes;
+    if (inode_bits > TAGFS_MAX_FILES) {
+        inode_bits = TAGFS_MAX_FILES;
+    }
+    uint64_t block_bitmap_size = BITMAP_ALLOC_BYTES(block_bits);
+    uint64_t inode_bitmap_size = BITMAP_ALLOC_BYTES(inode_bits);
 
     kprintf("[TAGFS] Allocating bitmaps: block_bitmap=%lu bytes, inode_bitmap=%lu bytes\n",
             block_bitmap_size, inode_bitmap_size);
@@ -646,26 +1254,46 @@ void tagfs_init(void) {
         panic("[TAGFS] FATAL: Failed to allocate inode_bitmap (%lu bytes)", inode_bitmap_size);
     }
 
+    uint32_t* block_summary = (uint32_t*)kmalloc(BITMAP_ALLOC_SUMMARY_BYTES(block_bits));
+    uint32_t* inode_summary = (uint32_t*)kmalloc(BITMAP_ALLOC_SUMMARY_BYTES(inode_bits));
+    if (!block_summary || !inode_summary) {
+        panic("[TAGFS] FATAL: Failed to allocate bitmap summaries");
+    }
+
     memset(global_tagfs.block_bitmap, 0, block_bitmap_size);
     memset(global_tagfs.inode_bitmap, 0, inode_bitmap_size);
+    bitmap_alloc_init(&global_tagfs.block_alloc, global_tagfs.block_bitmap, block_summary, block_bits);
+    bitmap_alloc_init(&global_tagfs.inode_alloc, global_tagfs.inode_bitmap, inode_summary, inode_bits);
+    global_tagfs.inode_hint = 0;
 
     // Mark reserved blocks as used
-    for (uint64_t i = 0; i < global_tagfs.superblock->data_blocks_start; i++) {
-        bitmap_set_bit(global_tagfs.block_bitmap, i);
-    }
+    bitmap_alloc_set(&global_tagfs.block_alloc, 0, global_tagfs.superblock->data_blocks_start);
 
-    // Initialize tag index
-    global_tagfs.tag_index.entry_count = 0;
-    global_tagfs.tag_index.capacity = TAGFS_MAX_TAG_INDEX;
+    // Extents существующих файлов (bitmap на диске не хранится)
+    for (uint64_t i = 0; i < inode_bits; i++) {
+        FileInode* inode = &global_tagfs.inode_table[i];
+        if (inode->inode_id == 0) {
+            continue;
+        }
+        bitmap_alloc_set(&global_tagfs.inode_alloc, i, 1);
+        if (tagfs_inode_is_inline(inode)) {
+            continue;  // В inline_data не extents
+        }
+        for (uint32_t e = 0; e < inode->extent_count && e < TAGFS_MAX_EXTENTS; e++) {
+            // DEFENSIVE: set обрезает extent по концу bitmap
+            bitmap_alloc_set(&global_tagfs.block_alloc, inode->extents[e].start,
+                             inode->extents[e].length);
+        }
+    }
 
-    // Rebuild index from existing files
-    tagfs_index_rebuild();
+    // Tag dictionary уже в памяти (load / migrate / format). Списки файлов -
+    // из образа на диске, rebuild по inodes - только если образа нет или он битый
+    if (!loaded_from_disk || tagfs_posting_load() != 0) {
+        tagfs_index_rebuild();
+    }
 
     global_tagfs.next_inode_id = 1;
 
-    // Initialize spinlock for thread-safe access
-    spinlock_init(&global_tagfs.lock);
-
     kprintf("[TAGFS] Initialized: %lu blocks (%lu free), %lu inodes (%lu free)\n",
             global_tagfs.superblock->total_blocks,
             global_tagfs.superblock->free_blocks,
@@ -689,14 +1317,18 @@ void tagfs_format(uint64_t total_blocks) {
     // Layout: [SB][Inode Table][Tag Index][Data Blocks]
     sb->inode_table_block = 1;
 
-    // Reserve space for tag index (64 blocks)
+    // Reserve space for tag index (64 blocks): dictionary + образ posting lists
     uint64_t tag_index_blocks = 64;
 
+    // Metadata резидентна в tagfs_storage - layout считается по первым
+    // TAGFS_MEM_BLOCKS, остаток большого тома целиком уходит в data region
+    uint64_t layout_blocks = total_blocks < TAGFS_MEM_BLOCKS ? total_blocks : TAGFS_MEM_BLOCKS;
+
     // Calculate available blocks for inodes
-    // total_blocks - superblock(1) - tag_index(64) - minimum_data_blocks(10)
+    // layout_blocks - superblock(1) - tag_index(64) - journal(16) - minimum_data_blocks(10)
     uint64_t available_for_inodes = 0;
-    if (total_blocks > (1 + tag_index_blocks + 10)) {
-        available_for_inodes = total_blocks - 1 - tag_index_blocks - 10;
+    if (layout_blocks > (1 + tag_index_blocks + TAGFS_JOURNAL_BLOCKS + 10)) {
+        available_for_inodes = layout_blocks - 1 - tag_index_blocks - TAGFS_JOURNAL_BLOCKS - 10;
     } else {
         kprintf("[TAGFS] ERROR: Not enough blocks for filesystem!\n");
         available_for_inodes = 1;  // Minimum
@@ -717,7 +1349,21 @@ void tagfs_format(uint64_t total_blocks) {
     uint64_t inode_blocks = (max_inodes * TAGFS_INODE_SIZE + TAGFS_BLOCK_SIZE - 1) / TAGFS_BLOCK_SIZE;
 
     sb->tag_index_block = sb->inode_table_block + inode_blocks;
-    sb->data_blocks_start = sb->tag_index_block + tag_index_blocks;
+    sb->journal_block = sb->tag_index_block + tag_index_blocks;
+    sb->journal_blocks = TAGFS_JOURNAL_BLOCKS;
+    sb->data_blocks_start = sb->journal_block + TAGFS_JOURNAL_BLOCKS;
+    sb->posting_block = sb->journal_block - TAGFS_POSTING_BLOCKS;
+    sb->posting_blocks = TAGFS_POSTING_BLOCKS;
+    sb->posting_size = 0;
+    sb->posting_tags = 0;
+    sb->posting_crc = 0;
+
+    // На диске в регионе журнала могут остаться транзакции прошлой ФС -
+    // sequence с TSC, чтобы recovery их не принял
+    sb->journal_sequence = rdtsc();
+    global_tagfs.journal_sequence = sb->journal_sequence;
+    global_tagfs.journal_head = 0;
+    memset(tagfs_journal_slot, 0, sizeof(tagfs_journal_slot));
 
     // Ensure data_blocks_start doesn't exceed total_blocks
     if (sb->data_blocks_start > total_blocks) {
@@ -730,8 +1376,18 @@ void tagfs_format(uint64_t total_blocks) {
 
     sb->free_inodes = max_inodes;
 
-    kprintf("[TAGFS] Format complete: inodes=%lu (in %lu blocks), tag_index=%lu, data_start=%lu\n",
-            max_inodes, inode_blocks, sb->tag_index_block, sb->data_blocks_start);
+    // Пустой tag dictionary (записи в регионе без tag_count не читаются)
+    sb->tag_count = 0;
+    tagfs_tag_dict_reset();
+
+    // Первый sync пишет весь новый layout metadata
+    tagfs_mark_superblock_dirty();
+    for (uint64_t block = sb->inode_table_block; block < sb->tag_index_block && block < TAGFS_MEM_BLOCKS; block++) {
+        bitmap_set_bit(tagfs_meta_dirty, block);
+    }
+
+    kprintf("[TAGFS] Format complete: inodes=%lu (in %lu blocks), tag_index=%lu, journal=%lu, data_start=%lu\n",
+            max_inodes, inode_blocks, sb->tag_index_block, sb->journal_block, sb->data_blocks_start);
 }
 
 // ============================================================================
@@ -744,57 +1400,64 @@ uint64_t tagfs_create_file(Tag* tags, uint32_t tag_count) {
         return TAGFS_INVALID_INODE;
     }
 
-    spin_lock(&global_tagfs.lock);
+    read_lock(&global_tagfs.commit_lock);
 
-    // Allocate inode
-    uint64_t inode_id = tagfs_alloc_inode();
-    if (inode_id == TAGFS_INVALID_INODE) {
-        spin_unlock(&global_tagfs.lock);
-        kprintf("[TAGFS] Error: no free inodes\n");
-        return TAGFS_INVALID_INODE;
-    }
-
-    // Find inode slot
-    // Safely cap to prevent overflow
-    uint32_t safe_max = global_tagfs.superblock->total_inodes;
-    if (safe_max > TAGFS_MAX_FILES) {
-        safe_max = TAGFS_MAX_FILES;
-    }
-
-    FileInode* inode = NULL;
-    for (uint32_t i = 0; i < safe_max; i++) {
-        if (global_tagfs.inode_table[i].inode_id == 0) {
-            inode = &global_tagfs.inode_table[i];
-            break;
+    // Tag IDs до выделения inode: словарь полон - файл не создаём.
+    // index_lock отпускается до inode lock (порядок inode → index)
+    uint32_t tag_ids[TAGFS_MAX_TAGS_PER_FILE];
+    write_lock(&global_tagfs.index_lock);
+    for (uint32_t i = 0; i < tag_count; i++) {
+        tag_ids[i] = tagfs_tag_intern_locked(&tags[i]);
+        if (tag_ids[i] == TAGFS_INVALID_TAG_ID) {
+            write_unlock(&global_tagfs.index_lock);
+            read_unlock(&global_tagfs.commit_lock);
+            kprintf("[TAGFS] Error: cannot intern tag %s:%s\n", tags[i].key, tags[i].value);
+            return TAGFS_INVALID_INODE;
         }
     }
+    write_unlock(&global_tagfs.index_lock);
 
-    if (!inode) {
-        spin_unlock(&global_tagfs.lock);
-        kprintf("[TAGFS] Error: inode table full\n");
+    // Allocate inode (слот inode_table - по inode bitmap)
+    uint32_t slot = 0;
+    uint64_t inode_id = tagfs_alloc_inode(&slot);
+    if (inode_id == TAGFS_INVALID_INODE) {
+        read_unlock(&global_tagfs.commit_lock);
+        kprintf("[TAGFS] Error: no free inodes\n");
         return TAGFS_INVALID_INODE;
     }
 
-    // Initialize inode
+    FileInode* inode = &global_tagfs.inode_table[slot];
+    write_lock(tagfs_inode_lock(inode));
+
+    // Initialize inode. inode_id - последним: tagfs_get_inode не найдёт
+    // слот, пока он не готов
     memset(inode, 0, sizeof(FileInode));
-    inode->inode_id = inode_id;
     inode->size = 0;
     inode->creation_time = rdtsc();
     inode->modification_time = inode->creation_time;
     inode->tag_count = tag_count;
 
-    // Copy tags
+    // Copy tag IDs
+    memcpy(inode->tag_ids, tag_ids, tag_count * sizeof(uint32_t));
+    __sync_synchronize();
+    inode->inode_id = inode_id;
+    tagfs_mark_inode_dirty(inode);
+
+    // Add to tag index
+    write_lock(&global_tagfs.index_lock);
+    tag_bitmap_add(&global_tagfs.tag_index.files, inode_id);
+    global_tagfs.posting_dirty = 1;
     for (uint32_t i = 0; i < tag_count; i++) {
-        inode->tags[i] = tags[i];
+        tagfs_index_add_id(inode_id, tag_ids[i]);
     }
+    tagfs_view_update(inode_id);  // Контекст без тегов - view по files
+    write_unlock(&global_tagfs.index_lock);
 
-    // Add to tag index
-    tagfs_index_add_file(inode_id, tags, tag_count);
+    tagfs_inode_release(inode, 1);
+    read_unlock(&global_tagfs.commit_lock);
 
     atomic_increment_u64(&global_tagfs.files_created);
 
-    spin_unlock(&global_tagfs.lock);
-
     kprintf("[TAGFS] Created file inode=%lu with %u tags\n", inode_id, tag_count);
     return inode_id;
 }
@@ -833,17 +1496,53 @@ FileInode* tagfs_get_inode(uint64_t inode_id) {
     return NULL;
 }
 
-int tagfs_read_file(uint64_t inode_id, uint64_t offset, uint8_t* buffer, uint64_t size) {
-    spin_lock(&global_tagfs.lock);
+// Inode по ID под его lock (write = эксклюзивно). NULL = нет такого файла
+static FileInode* tagfs_inode_acquire(uint64_t inode_id, int write) {
+    if (inode_id == TAGFS_INVALID_INODE) {
+        return NULL;  // Иначе совпадёт первый свободный слот
+    }
 
-    FileInode* inode = tagfs_get_inode(inode_id);
+    for (;;) {
+        FileInode* inode = tagfs_get_inode(inode_id);
+        if (!inode) {
+            return NULL;
+        }
+
+        rwlock_t* lock = tagfs_inode_lock(inode);
+        if (write) {
+            write_lock(lock);
+        } else {
+            read_lock(lock);
+        }
+        if (inode->inode_id == inode_id) {
+            return inode;
+        }
+
+        // Erase / переиспользование слота, пока ждали lock - ищем заново
+        if (write) {
+            write_unlock(lock);
+        } else {
+            read_unlock(lock);
+        }
+    }
+}
+
+static void tagfs_inode_release(FileInode* inode, int write) {
+    if (write) {
+        write_unlock(tagfs_inode_lock(inode));
+    } else {
+        read_unlock(tagfs_inode_lock(inode));
+    }
+}
+
+int tagfs_read_file(uint64_t inode_id, uint64_t offset, uint8_t* buffer, uint64_t size) {
+    FileInode* inode = tagfs_inode_acquire(inode_id, 0);
     if (!inode) {
-        spin_unlock(&global_tagfs.lock);
         return -1;
     }
 
     if (offset >= inode->size) {
-        spin_unlock(&global_tagfs.lock);
+        tagfs_inode_release(inode, 0);
         return 0;  // EOF
     }
 
@@ -851,19 +1550,25 @@ int tagfs_read_file(uint64_t inode_id, uint64_t offset, uint8_t* buffer, uint64_
         size = inode->size - offset;
     }
 
+    if (tagfs_inode_is_inline(inode)) {
+        memcpy(buffer, inode->inline_data + offset, size);
+        tagfs_inode_release(inode, 0);
+        return size;
+    }
+
     uint64_t bytes_read = 0;
     uint64_t current_offset = offset;
 
-    // Полная реализация с поддержкой indirect blocks
     while (bytes_read < size && current_offset < inode->size) {
         uint64_t block_idx = current_offset / TAGFS_BLOCK_SIZE;
         uint64_t block_offset = current_offset % TAGFS_BLOCK_SIZE;
 
-        // Получаем блок (поддерживает direct/indirect/double_indirect)
-        uint64_t block_num = tagfs_get_block_by_index(inode, block_idx);
+        // Физический блок и остаток его extent
+        uint64_t run = 0;
+        uint64_t block_num = tagfs_map_block(inode, block_idx, &run);
 
         if (block_num == 0) {
-            // Sparse file - читаем нули
+            // За концом выделенного - читаем нули
             uint64_t to_read = TAGFS_BLOCK_SIZE - block_offset;
             if (to_read > size - bytes_read) {
                 to_read = size - bytes_read;
@@ -875,64 +1580,211 @@ int tagfs_read_file(uint64_t inode_id, uint64_t offset, uint8_t* buffer, uint64_
         }
 
         // Bounds check
-        if (block_num >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Invalid block number %lu in read (>= %u)\n",
-                    block_num, TAGFS_MEM_BLOCKS);
+        if (!tagfs_extent_in_volume(block_num, run)) {
+            kprintf("[TAGFS] ERROR: Invalid extent %lu+%lu in read (end %lu)\n",
+                    block_num, run, tagfs_data_end());
             break;
         }
 
+        // Выровненные полные блоки - одной передачей на весь остаток extent
+        uint64_t full_blocks = (size - bytes_read) / TAGFS_BLOCK_SIZE;
+        if (block_offset == 0 && full_blocks > 0) {
+            if (full_blocks > run) {
+                full_blocks = run;
+            }
+            if (tagfs_read_span(block_num, full_blocks, buffer + bytes_read) != 0) {
+                break;
+            }
+            bytes_read += full_blocks * TAGFS_BLOCK_SIZE;
+            current_offset += full_blocks * TAGFS_BLOCK_SIZE;
+            continue;
+        }
+
         uint64_t to_read = TAGFS_BLOCK_SIZE - block_offset;
         if (to_read > size - bytes_read) {
             to_read = size - bytes_read;
         }
 
-        memcpy(buffer + bytes_read, tagfs_storage[block_num] + block_offset, to_read);
+        uint8_t* data = tagfs_block_get(block_num, BLOCK_CACHE_READ);
+        if (!data) {
+            break;
+        }
+        memcpy(buffer + bytes_read, data + block_offset, to_read);
+        tagfs_block_put(block_num, 0);
         bytes_read += to_read;
         current_offset += to_read;
     }
 
-    spin_unlock(&global_tagfs.lock);
+    tagfs_inode_release(inode, 0);
     return bytes_read;
 }
 
+// Блоки [offset, offset + size) файла в block cache: prefetch (ждёт) или
+// async fetch (done на каждую отправленную команду)
+static int tagfs_cache_range(uint64_t inode_id, uint64_t offset, uint64_t size,
+                             BlockCacheIoDone done, void* context, int async) {
+    if (!use_disk) {
+        return 0;  // Memory mode - данные уже в tagfs_storage
+    }
+
+    FileInode* inode = tagfs_inode_acquire(inode_id, 0);
+    if (!inode) {
+        return -1;
+    }
+
+    if (offset >= inode->size || tagfs_inode_is_inline(inode)) {
+        tagfs_inode_release(inode, 0);
+        return 0;
+    }
+    if (offset + size > inode->size) {
+        size = inode->size - offset;
+    }
+
+    uint64_t block_idx = offset / TAGFS_BLOCK_SIZE;
+    uint64_t end_idx = (offset + size + TAGFS_BLOCK_SIZE - 1) / TAGFS_BLOCK_SIZE;
+    int fetched = 0;
+
+    while (block_idx < end_idx) {
+        uint64_t run = 0;
+        uint64_t block_num = tagfs_map_block(inode, block_idx, &run);
+        if (block_num == 0) {
+            break;  // Дальше не выделено - читать нечего
+        }
+        if (!tagfs_extent_in_volume(block_num, run) || !tagfs_block_cached(block_num)) {
+            break;
+        }
+        if (run > end_idx - block_idx) {
+            run = end_idx - block_idx;
+        }
+
+        if (async) {
+            int submitted = block_cache_fetch_async(block_num, (uint32_t)run, done, context);
+            if (submitted < 0) {
+                fetched = fetched > 0 ? fetched : -1;
+                break;
+            }
+            fetched += submitted;
+        } else {
+            fetched += block_cache_prefetch(block_num, (uint32_t)run);
+        }
+        block_idx += run;
+    }
+
+    tagfs_inode_release(inode, 0);
+    return fetched;
+}
+
+int tagfs_readahead(uint64_t inode_id, uint64_t offset, uint64_t size) {
+    return tagfs_cache_range(inode_id, offset, size, 0, 0, 0);
+}
+
+int tagfs_fetch_async(uint64_t inode_id, uint64_t offset, uint64_t size,
+                      void (*done)(void* context, int status), void* context) {
+    return tagfs_cache_range(inode_id, offset, size, done, context, 1);
+}
+
 int tagfs_write_file(uint64_t inode_id, uint64_t offset, const uint8_t* buffer, uint64_t size) {
-    spin_lock(&global_tagfs.lock);
+    read_lock(&global_tagfs.commit_lock);
 
-    FileInode* inode = tagfs_get_inode(inode_id);
+    FileInode* inode = tagfs_inode_acquire(inode_id, 1);
     if (!inode) {
-        spin_unlock(&global_tagfs.lock);
+        read_unlock(&global_tagfs.commit_lock);
         return -1;
     }
 
+    // Влезает в inline_data (файл inline или ещё пустой) - без блоков
+    if (offset + size <= TAGFS_INLINE_DATA_SIZE &&
+        (tagfs_inode_is_inline(inode) || (inode->size == 0 && inode->extent_count == 0))) {
+        if (offset > inode->size) {
+            memset(inode->inline_data + inode->size, 0, offset - inode->size);
+        }
+        memcpy(inode->inline_data + offset, buffer, size);
+        inode->flags |= TAGFS_INODE_INLINE;
+        if (offset + size > inode->size) {
+            inode->size = offset + size;
+        }
+        inode->modification_time = rdtsc();
+        tagfs_mark_inode_dirty(inode);
+
+        tagfs_inode_release(inode, 1);
+        read_unlock(&global_tagfs.commit_lock);
+        return size;
+    }
+
+    if (tagfs_inode_is_inline(inode) && !tagfs_inline_promote(inode)) {
+        kprintf("[TAGFS] Error: no space to move inline data to a block (inode=%lu)\n", inode_id);
+        tagfs_inode_release(inode, 1);
+        read_unlock(&global_tagfs.commit_lock);
+        return 0;
+    }
+
     uint64_t bytes_written = 0;
     uint64_t current_offset = offset;
 
-    // Полная реализация с поддержкой indirect blocks
+    // Выделяем весь диапазон сразу: непрерывные extents, а не блок за блоком
+    uint64_t old_blocks = tagfs_inode_blocks(inode);
+    uint64_t end_blocks = (offset + size + TAGFS_BLOCK_SIZE - 1) / TAGFS_BLOCK_SIZE;
+    if (size > 0 && end_blocks > old_blocks && !tagfs_inode_grow(inode, end_blocks)) {
+        kprintf("[TAGFS] Error: no space for %lu blocks (inode=%lu, %u extents)\n",
+                end_blocks - old_blocks, inode_id, inode->extent_count);
+    }
+
+    // Новые блоки перед offset (запись за концом файла) читаются как нули
+    for (uint64_t idx = old_blocks; idx < offset / TAGFS_BLOCK_SIZE; idx++) {
+        uint64_t run = 0;
+        uint64_t block_num = tagfs_map_block(inode, idx, &run);
+        if (block_num == 0 || !tagfs_block_get(block_num, BLOCK_CACHE_ZERO)) {
+            break;
+        }
+        tagfs_block_put(block_num, 1);
+    }
+
     while (bytes_written < size) {
         uint64_t block_idx = current_offset / TAGFS_BLOCK_SIZE;
         uint64_t block_offset = current_offset % TAGFS_BLOCK_SIZE;
 
-        // Выделяем блок если нужно (поддерживает direct/indirect/double_indirect)
-        uint64_t block_num = tagfs_alloc_block_by_index(inode, block_idx);
+        uint64_t run = 0;
+        uint64_t block_num = tagfs_map_block(inode, block_idx, &run);
 
-        if (block_num == (uint64_t)-1) {
-            kprintf("[TAGFS] Error: failed to allocate block at index %lu\n", block_idx);
+        if (block_num == 0) {
+            kprintf("[TAGFS] Error: no block allocated at index %lu\n", block_idx);
             break;
         }
 
         // Bounds check
-        if (block_num >= TAGFS_MEM_BLOCKS) {
-            kprintf("[TAGFS] ERROR: Invalid block number %lu in write (>= %u)\n",
-                    block_num, TAGFS_MEM_BLOCKS);
+        if (!tagfs_extent_in_volume(block_num, run)) {
+            kprintf("[TAGFS] ERROR: Invalid extent %lu+%lu in write (end %lu)\n",
+                    block_num, run, tagfs_data_end());
             break;
         }
 
+        // Выровненные полные блоки - одной передачей на весь остаток extent
+        uint64_t full_blocks = (size - bytes_written) / TAGFS_BLOCK_SIZE;
+        if (block_offset == 0 && full_blocks > 0) {
+            if (full_blocks > run) {
+                full_blocks = run;
+            }
+            if (tagfs_write_span(block_num, full_blocks, buffer + bytes_written) != 0) {
+                break;
+            }
+            bytes_written += full_blocks * TAGFS_BLOCK_SIZE;
+            current_offset += full_blocks * TAGFS_BLOCK_SIZE;
+            continue;
+        }
+
         uint64_t to_write = TAGFS_BLOCK_SIZE - block_offset;
         if (to_write > size - bytes_written) {
             to_write = size - bytes_written;
         }
 
-        memcpy(tagfs_storage[block_num] + block_offset, buffer + bytes_written, to_write);
+        // Только что выделенный блок: с диска читать нечего
+        uint8_t* data = tagfs_block_get(block_num, block_idx >= old_blocks ? BLOCK_CACHE_ZERO
+                                                                          : BLOCK_CACHE_READ);
+        if (!data) {
+            break;
+        }
+        memcpy(data + block_offset, buffer + bytes_written, to_write);
+        tagfs_block_put(block_num, 1);
         bytes_written += to_write;
         current_offset += to_write;
     }
@@ -942,8 +1794,10 @@ int tagfs_write_file(uint64_t inode_id, uint64_t offset, const uint8_t* buffer,
         inode->size = current_offset;
     }
     inode->modification_time = rdtsc();
+    tagfs_mark_inode_dirty(inode);
 
-    spin_unlock(&global_tagfs.lock);
+    tagfs_inode_release(inode, 1);
+    read_unlock(&global_tagfs.commit_lock);
     return bytes_written;
 }
 
@@ -951,197 +1805,808 @@ int tagfs_write_file(uint64_t inode_id, uint64_t offset, const uint8_t* buffer,
 // TAG OPERATIONS
 // ============================================================================
 
+// Проверка членства - сравнение целых, без строк
+static int tagfs_inode_has_tag_id(const FileInode* inode, uint32_t tag_id) {
+    for (uint32_t i = 0; i < inode->tag_count && i < TAGFS_MAX_TAGS_PER_FILE; i++) {
+        if (inode->tag_ids[i] == tag_id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int tagfs_add_tag(uint64_t inode_id, const Tag* tag) {
-    FileInode* inode = tagfs_get_inode(inode_id);
+    read_lock(&global_tagfs.commit_lock);
+
+    FileInode* inode = tagfs_inode_acquire(inode_id, 1);
     if (!inode) {
+        read_unlock(&global_tagfs.commit_lock);
         return 0;
     }
 
+    int result = 0;
     if (inode->tag_count >= TAGFS_MAX_TAGS_PER_FILE) {
         kprintf("[TAGFS] Error: max tags reached for inode=%lu\n", inode_id);
+        tagfs_inode_release(inode, 1);
+        read_unlock(&global_tagfs.commit_lock);
         return 0;
     }
 
-    // Check if tag already exists
-    for (uint32_t i = 0; i < inode->tag_count; i++) {
-        if (tagfs_tag_equal(&inode->tags[i], tag)) {
-            kprintf("[TAGFS] Tag already exists on inode=%lu\n", inode_id);
-            return 1;  // Already exists - success
-        }
-    }
+    write_lock(&global_tagfs.index_lock);
 
-    // Add tag
-    inode->tags[inode->tag_count] = *tag;
-    inode->tag_count++;
-    inode->modification_time = rdtsc();
+    // Словарь полон - TAGFS_INVALID_TAG_ID, result = 0
+    uint32_t tag_id = tagfs_tag_intern_locked(tag);
+    if (tag_id == TAGFS_INVALID_TAG_ID) {
+        result = 0;
+    } else if (tagfs_inode_has_tag_id(inode, tag_id)) {
+        kprintf("[TAGFS] Tag already exists on inode=%lu\n", inode_id);
+        result = 1;  // Already exists - success
+    } else {
+        // Add tag
+        inode->tag_ids[inode->tag_count] = tag_id;
+        inode->tag_count++;
+        inode->modification_time = rdtsc();
+        tagfs_mark_inode_dirty(inode);
 
-    // Update index
-    tagfs_index_add_file(inode_id, tag, 1);
+        // Update index
+        tagfs_index_add_id(inode_id, tag_id);
+        atomic_increment_u64(&global_tagfs.tags_added);
+        result = 1;
+    }
 
-    atomic_increment_u64(&global_tagfs.tags_added);
-    return 1;
+    write_unlock(&global_tagfs.index_lock);
+    tagfs_inode_release(inode, 1);
+    read_unlock(&global_tagfs.commit_lock);
+    return result;
 }
 
 int tagfs_remove_tag(uint64_t inode_id, const char* key) {
-    FileInode* inode = tagfs_get_inode(inode_id);
+    read_lock(&global_tagfs.commit_lock);
+
+    FileInode* inode = tagfs_inode_acquire(inode_id, 1);
     if (!inode) {
+        read_unlock(&global_tagfs.commit_lock);
         return 0;
     }
 
+    int result = 0;
+    write_lock(&global_tagfs.index_lock);
+
     // Find and remove tag
     for (uint32_t i = 0; i < inode->tag_count; i++) {
-        if (strcmp(inode->tags[i].key, key) == 0) {
+        uint32_t tag_id = inode->tag_ids[i];
+        const Tag* existing = tagfs_tag_get(tag_id);
+        if (existing && strcmp(existing->key, key) == 0) {
             // Shift remaining tags
             for (uint32_t j = i; j < inode->tag_count - 1; j++) {
-                inode->tags[j] = inode->tags[j + 1];
+                inode->tag_ids[j] = inode->tag_ids[j + 1];
             }
             inode->tag_count--;
             inode->modification_time = rdtsc();
+            tagfs_mark_inode_dirty(inode);
 
             atomic_increment_u64(&global_tagfs.tags_removed);
 
-            // NOTE: Индекс не обновляем - произойдет при следующем rebuild
-            return 1;
+            // Posting list должен совпадать с inodes - AND не перепроверяет файлы
+            tagfs_index_remove_id(inode_id, tag_id);
+            result = 1;
+            break;
         }
     }
 
-    return 0;
+    write_unlock(&global_tagfs.index_lock);
+    tagfs_inode_release(inode, 1);
+    read_unlock(&global_tagfs.commit_lock);
+    return result;
 }
 
 int tagfs_get_tags(uint64_t inode_id, Tag* tags_out, uint32_t* count_out) {
-    FileInode* inode = tagfs_get_inode(inode_id);
+    FileInode* inode = tagfs_inode_acquire(inode_id, 0);
     if (!inode) {
         return 0;
     }
 
+    // entries могут переехать при росте словаря - копируем под index_lock
+    read_lock(&global_tagfs.index_lock);
+    uint32_t count = 0;
     for (uint32_t i = 0; i < inode->tag_count; i++) {
-        tags_out[i] = inode->tags[i];
+        const Tag* tag = tagfs_tag_get(inode->tag_ids[i]);
+        if (tag) {
+            tags_out[count++] = *tag;
+        }
     }
-    *count_out = inode->tag_count;
+    read_unlock(&global_tagfs.index_lock);
+    tagfs_inode_release(inode, 0);
+    *count_out = count;
 
     return 1;
 }
 
 int tagfs_file_has_tag(uint64_t inode_id, const Tag* tag) {
-    FileInode* inode = tagfs_get_inode(inode_id);
+    // Тега нет в словаре - его нет ни у одного файла
+    uint32_t tag_id = tagfs_tag_lookup(tag);
+    if (tag_id == TAGFS_INVALID_TAG_ID) {
+        return 0;
+    }
+
+    FileInode* inode = tagfs_inode_acquire(inode_id, 0);
     if (!inode) {
         return 0;
     }
+    int result = tagfs_inode_has_tag_id(inode, tag_id);
+    tagfs_inode_release(inode, 0);
+    return result;
+}
 
-    for (uint32_t i = 0; i < inode->tag_count; i++) {
-        if (tagfs_tag_equal(&inode->tags[i], tag)) {
-            return 1;
+// ============================================================================
+// TAG DICTIONARY - key:value → tag ID (hash, цепочки через entry->next)
+// ============================================================================
+
+#define TAGFS_FNV_OFFSET    2166136261u
+#define TAGFS_FNV_PRIME     16777619u
+
+// FNV-1a по key, ':' и value - те же байты, что сравнивает tagfs_tag_equal
+static uint32_t tagfs_tag_hash(const Tag* tag) {
+    uint32_t hash = TAGFS_FNV_OFFSET;
+    for (uint32_t i = 0; i < TAGFS_TAG_KEY_SIZE && tag->key[i]; i++) {
+        hash = (hash ^ (uint8_t)tag->key[i]) * TAGFS_FNV_PRIME;
+    }
+    hash = (hash ^ (uint8_t)':') * TAGFS_FNV_PRIME;
+    for (uint32_t i = 0; i < TAGFS_TAG_VALUE_SIZE && tag->value[i]; i++) {
+        hash = (hash ^ (uint8_t)tag->value[i]) * TAGFS_FNV_PRIME;
+    }
+    return hash;
+}
+
+static inline TagIndexEntry* tagfs_tag_entry(uint32_t tag_id) {
+    return &global_tagfs.tag_index.entries[tag_id - 1];
+}
+
+static uint32_t tagfs_tag_find(const Tag* tag, uint32_t hash) {
+    TagIndex* index = &global_tagfs.tag_index;
+    if (!index->buckets) {
+        return TAGFS_INVALID_TAG_ID;
+    }
+
+    uint32_t tag_id = index->buckets[hash & (index->bucket_count - 1)];
+    while (tag_id != TAGFS_INVALID_TAG_ID) {
+        TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+        // strcmp только при совпавшем hash
+        if (entry->hash == hash && tagfs_tag_equal(&entry->tag, tag)) {
+            return tag_id;
         }
+        tag_id = entry->next;
+    }
+    return TAGFS_INVALID_TAG_ID;
+}
+
+// Разложить все entries по bucket_count buckets. 0 = нет памяти (старые остаются)
+static int tagfs_tag_rehash(uint32_t bucket_count) {
+    TagIndex* index = &global_tagfs.tag_index;
+    uint32_t* buckets = (uint32_t*)kmalloc(bucket_count * sizeof(uint32_t));
+    if (!buckets) {
+        return 0;
+    }
+    memset(buckets, 0, bucket_count * sizeof(uint32_t));
+
+    for (uint32_t tag_id = 1; tag_id <= index->entry_count; tag_id++) {
+        TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+        uint32_t bucket = entry->hash & (bucket_count - 1);
+        entry->next = buckets[bucket];
+        buckets[bucket] = tag_id;
+    }
+
+    if (index->buckets) {
+        kfree(index->buckets);
+    }
+    index->buckets = buckets;
+    index->bucket_count = bucket_count;
+    return 1;
+}
+
+// Удвоить entries (ID = позиция, так что копия сохраняет все ID)
+static int tagfs_tag_index_grow(void) {
+    TagIndex* index = &global_tagfs.tag_index;
+    uint32_t new_capacity = index->capacity ? index->capacity * 2 : TAGFS_TAG_INDEX_INITIAL;
+
+    TagIndexEntry* entries = (TagIndexEntry*)kmalloc(new_capacity * sizeof(TagIndexEntry));
+    if (!entries) {
+        kprintf("[TAGFS] ERROR: Failed to grow tag index (capacity %u -> %u)\n",
+                index->capacity, new_capacity);
+        return 0;
     }
+
+    if (index->entries) {
+        memcpy(entries, index->entries, index->entry_count * sizeof(TagIndexEntry));
+        kfree(index->entries);
+    }
+    index->entries = entries;
+    index->capacity = new_capacity;
+    return 1;
+}
+
+// Записей tag dictionary в регионе tag_index_block..data_blocks_start
+static uint64_t tagfs_tag_dict_capacity(void) {
+    uint64_t start = global_tagfs.superblock->tag_index_block;
+    uint64_t end = global_tagfs.superblock->posting_block ? global_tagfs.superblock->posting_block
+                                                          : global_tagfs.superblock->data_blocks_start;
+    if (end > TAGFS_MEM_BLOCKS) {
+        end = TAGFS_MEM_BLOCKS;
+    }
+    return end > start ? (end - start) * TAGFS_TAGS_PER_BLOCK : 0;
+}
+
+// Запись tag ID в регионе (записи не пересекают границу блока)
+static inline Tag* tagfs_tag_record(uint32_t tag_id, uint64_t* block_out) {
+    uint64_t block = global_tagfs.superblock->tag_index_block + (tag_id - 1) / TAGFS_TAGS_PER_BLOCK;
+    *block_out = block;
+    return (Tag*)tagfs_storage[block] + (tag_id - 1) % TAGFS_TAGS_PER_BLOCK;
+}
+
+// Новый entry с ID = entry_count + 1 (только память)
+static uint32_t tagfs_tag_insert(const Tag* tag, uint32_t hash) {
+    TagIndex* index = &global_tagfs.tag_index;
+
+    if (!index->buckets && !tagfs_tag_rehash(TAGFS_TAG_INDEX_BUCKETS)) {
+        return TAGFS_INVALID_TAG_ID;
+    }
+    if (index->entry_count >= index->capacity && !tagfs_tag_index_grow()) {
+        return TAGFS_INVALID_TAG_ID;
+    }
+
+    TagIndexEntry* entry = &index->entries[index->entry_count];
+    entry->tag = *tag;
+    entry->hash = hash;
+    entry->file_count = 0;
+    entry->bitmap = NULL;
+    entry->capacity = 16;  // Start small
+    entry->inode_ids = (uint64_t*)kmalloc(entry->capacity * sizeof(uint64_t));
+
+    if (!entry->inode_ids) {
+        kprintf("[TAGFS] ERROR: Failed to allocate inode_ids array for tag %s:%s\n",
+                tag->key, tag->value);
+        return TAGFS_INVALID_TAG_ID;
+    }
+
+    uint32_t tag_id = ++index->entry_count;
+    uint32_t bucket = hash & (index->bucket_count - 1);
+    entry->next = index->buckets[bucket];
+    index->buckets[bucket] = tag_id;
+
+    // Load factor > 1 - удваиваем buckets. Нет памяти - работаем с длинными цепочками
+    if (index->entry_count > index->bucket_count) {
+        tagfs_tag_rehash(index->bucket_count * 2);
+    }
+    tagfs_name_insert(tag_id);
+    tagfs_view_tag_inserted(tag_id);
+    return tag_id;
+}
+
+static const Tag* tagfs_tag_get(uint32_t tag_id) {
+    if (tag_id == TAGFS_INVALID_TAG_ID || tag_id > global_tagfs.tag_index.entry_count) {
+        return NULL;
+    }
+    return &tagfs_tag_entry(tag_id)->tag;
+}
+
+// Под index_lock (read)
+static inline uint32_t tagfs_tag_lookup_locked(const Tag* tag) {
+    return tagfs_tag_find(tag, tagfs_tag_hash(tag));
+}
+
+uint32_t tagfs_tag_lookup(const Tag* tag) {
+    read_lock(&global_tagfs.index_lock);
+    uint32_t tag_id = tagfs_tag_lookup_locked(tag);
+    read_unlock(&global_tagfs.index_lock);
+    return tag_id;
+}
+
+uint32_t tagfs_tag_intern(const Tag* tag) {
+    read_lock(&global_tagfs.commit_lock);
+    write_lock(&global_tagfs.index_lock);
+    uint32_t tag_id = tagfs_tag_intern_locked(tag);
+    write_unlock(&global_tagfs.index_lock);
+    read_unlock(&global_tagfs.commit_lock);
+    return tag_id;
+}
+
+// Под commit_lock (read) + index_lock (write)
+static uint32_t tagfs_tag_intern_locked(const Tag* tag) {
+    uint32_t hash = tagfs_tag_hash(tag);
+
+    uint32_t tag_id = tagfs_tag_find(tag, hash);
+    if (tag_id != TAGFS_INVALID_TAG_ID) {
+        return tag_id;
+    }
+
+    // ID должен поместиться в регион на диске - иначе inode сошлётся в никуда
+    if (global_tagfs.tag_index.entry_count >= tagfs_tag_dict_capacity()) {
+        kprintf("[TAGFS] Warning: tag dictionary full (%u tags)\n",
+                global_tagfs.tag_index.entry_count);
+        return TAGFS_INVALID_TAG_ID;
+    }
+
+    tag_id = tagfs_tag_insert(tag, hash);
+    if (tag_id == TAGFS_INVALID_TAG_ID) {
+        return TAGFS_INVALID_TAG_ID;
+    }
+
+    uint64_t block = 0;
+    Tag* record = tagfs_tag_record(tag_id, &block);
+    memset(record, 0, sizeof(Tag));
+    strncpy(record->key, tag->key, TAGFS_TAG_KEY_SIZE - 1);
+    strncpy(record->value, tag->value, TAGFS_TAG_VALUE_SIZE - 1);
+    bitmap_set_bit_atomic(tagfs_meta_dirty, block);
+
+    global_tagfs.superblock->tag_count = tag_id;
+    tagfs_mark_superblock_dirty();
+    return tag_id;
+}
+
+// Словарь пуст: entries остаются выделенными, ID начинаются с 1
+static void tagfs_tag_dict_reset(void) {
+    TagIndex* index = &global_tagfs.tag_index;
+    for (uint32_t i = 0; i < index->entry_count; i++) {
+        if (index->entries[i].inode_ids) {
+            kfree(index->entries[i].inode_ids);
+        }
+        if (index->entries[i].bitmap) {
+            tag_bitmap_free(index->entries[i].bitmap);
+            kfree(index->entries[i].bitmap);
+        }
+    }
+    tag_bitmap_free(&index->files);
+    index->entry_count = 0;
+    if (index->buckets) {
+        memset(index->buckets, 0, index->bucket_count * sizeof(uint32_t));
+    }
+    if (index->name_slots) {
+        memset(index->name_slots, 0, index->name_slot_count * sizeof(uint32_t));
+    }
+    index->name_count = 0;
+    index->name_overflow = 0;
+
+    // ID тегов контекста больше не верны - найдутся заново при intern
+    TagFSUserContext* context = &global_tagfs.user_context;
+    memset(context->tag_ids, 0, sizeof(context->tag_ids));
+    context->trash_id = TAGFS_INVALID_TAG_ID;
+    tag_bitmap_free(&context->view);
+}
+
+// Записи с диска (tagfs_storage) → entries. Уже загруженные ID пропускаются
+// (после миграции словарь построен intern). 0 = успех, -1 = нет памяти
+static int tagfs_tag_dict_load(void) {
+    uint64_t count = global_tagfs.superblock->tag_count;
+    uint64_t capacity = tagfs_tag_dict_capacity();
+    if (count > capacity) {
+        kprintf("[TAGFS] %[W]WARNING: tag_count %lu > dictionary capacity %lu%[D]\n",
+                count, capacity);
+        count = capacity;
+    }
+
+    for (uint32_t tag_id = global_tagfs.tag_index.entry_count + 1; tag_id <= count; tag_id++) {
+        uint64_t block = 0;
+        Tag tag = *tagfs_tag_record(tag_id, &block);
+        // DEFENSIVE: строки с диска
+        tag.key[TAGFS_TAG_KEY_SIZE - 1] = '\0';
+        tag.value[TAGFS_TAG_VALUE_SIZE - 1] = '\0';
+        if (tagfs_tag_insert(&tag, tagfs_tag_hash(&tag)) != tag_id) {
+            return -1;
+        }
+    }
+
+    kprintf("[TAGFS] Tag dictionary: %u tags\n", global_tagfs.tag_index.entry_count);
     return 0;
 }
 
-// ============================================================================
-// TAG INDEX MANAGEMENT
-// ============================================================================
+// ============================================================================
+// NAME INDEX - value тега name:* → tag ID (open addressing)
+// ============================================================================
+//
+// fs_open / fs_stat ищут по имени: hash только по value, без сборки Tag и
+// копирования posting list. Слот хранит tag ID, файл - первый в его списке.
+// Entries живут до format, поэтому удаления слотов нет: списки пустеют и
+// наполняются сами, name index их не дублирует.
+//
+
+static inline int tagfs_tag_is_name(const Tag* tag) {
+    return strcmp(tag->key, "name") == 0;
+}
+
+// Имя длиннее value хранится обрезанным - сравниваем по тем же байтам
+static uint32_t tagfs_name_hash(const char* name) {
+    uint32_t hash = TAGFS_FNV_OFFSET;
+    for (uint32_t i = 0; i < TAGFS_TAG_VALUE_SIZE - 1 && name[i]; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * TAGFS_FNV_PRIME;
+    }
+    return hash;
+}
+
+static void tagfs_name_place(uint32_t* slots, uint32_t slot_count, uint32_t tag_id) {
+    uint32_t slot = tagfs_name_hash(tagfs_tag_entry(tag_id)->tag.value) & (slot_count - 1);
+    while (slots[slot] != TAGFS_INVALID_TAG_ID) {
+        slot = (slot + 1) & (slot_count - 1);
+    }
+    slots[slot] = tag_id;
+}
+
+// Разложить все name:* entries по slot_count слотам. 0 = нет памяти (старые остаются)
+static int tagfs_name_rehash(uint32_t slot_count) {
+    TagIndex* index = &global_tagfs.tag_index;
+    uint32_t* slots = (uint32_t*)kmalloc(slot_count * sizeof(uint32_t));
+    if (!slots) {
+        return 0;
+    }
+    memset(slots, 0, slot_count * sizeof(uint32_t));
+
+    uint32_t count = 0;
+    for (uint32_t tag_id = 1; tag_id <= index->entry_count; tag_id++) {
+        if (tagfs_tag_is_name(&tagfs_tag_entry(tag_id)->tag)) {
+            tagfs_name_place(slots, slot_count, tag_id);
+            count++;
+        }
+    }
+
+    if (index->name_slots) {
+        kfree(index->name_slots);
+    }
+    index->name_slots = slots;
+    index->name_slot_count = slot_count;
+    index->name_count = count;
+    index->name_overflow = 0;
+    return 1;
+}
+
+// Новый entry (из tagfs_tag_insert). Заполнено больше половины - удваиваем;
+// нет памяти - пробы длиннее, пока остаётся пустой слот (конец цепочки)
+static void tagfs_name_insert(uint32_t tag_id) {
+    TagIndex* index = &global_tagfs.tag_index;
+    if (!tagfs_tag_is_name(&tagfs_tag_entry(tag_id)->tag)) {
+        return;
+    }
+
+    if (!index->name_slots || (index->name_count + 1) * 2 > index->name_slot_count) {
+        uint32_t slot_count = index->name_slots ? index->name_slot_count * 2 : TAGFS_NAME_INDEX_SLOTS;
+        if (tagfs_name_rehash(slot_count)) {
+            return;  // Rehash разложил и новый entry
+        }
+    }
+    if (!index->name_slots || index->name_count + 1 >= index->name_slot_count) {
+        kprintf("[TAGFS] %[W]WARNING: name index full, '%s' only via tag dictionary%[D]\n",
+                tagfs_tag_entry(tag_id)->tag.value);
+        index->name_overflow++;
+        return;
+    }
+
+    tagfs_name_place(index->name_slots, index->name_slot_count, tag_id);
+    index->name_count++;
+}
+
+// Tag ID name:name. Под index_lock (read)
+static uint32_t tagfs_name_find(const char* name) {
+    TagIndex* index = &global_tagfs.tag_index;
+    if (index->name_slots) {
+        uint32_t slot = tagfs_name_hash(name) & (index->name_slot_count - 1);
+        while (index->name_slots[slot] != TAGFS_INVALID_TAG_ID) {
+            uint32_t tag_id = index->name_slots[slot];
+            if (strncmp(tagfs_tag_entry(tag_id)->tag.value, name, TAGFS_TAG_VALUE_SIZE - 1) == 0) {
+                return tag_id;
+            }
+            slot = (slot + 1) & (index->name_slot_count - 1);
+        }
+        if (index->name_overflow == 0) {
+            return TAGFS_INVALID_TAG_ID;
+        }
+    }
+
+    // Не все name:* в слотах - обычный lookup по dictionary
+    Tag tag;
+    memset(&tag, 0, sizeof(Tag));
+    strcpy(tag.key, "name");
+    strncpy(tag.value, name, TAGFS_TAG_VALUE_SIZE - 1);
+    return tagfs_tag_lookup_locked(&tag);
+}
+
+// До max_results файлов с именем name (по возрастанию ID)
+static uint32_t tagfs_name_files(const char* name, uint64_t* result_inodes, uint32_t max_results) {
+    uint32_t count = 0;
+
+    read_lock(&global_tagfs.index_lock);
+    uint32_t tag_id = tagfs_name_find(name);
+    if (tag_id != TAGFS_INVALID_TAG_ID) {
+        TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+        if (entry->bitmap) {
+            count = tag_bitmap_to_array(entry->bitmap, result_inodes, max_results);
+        } else {
+            count = entry->file_count < max_results ? entry->file_count : max_results;
+            memcpy(result_inodes, entry->inode_ids, count * sizeof(uint64_t));
+        }
+    }
+    read_unlock(&global_tagfs.index_lock);
+
+    atomic_increment_u64(&global_tagfs.name_lookups);
+    return count;
+}
+
+uint64_t tagfs_lookup_name(const char* name) {
+    uint64_t inode_id = TAGFS_INVALID_INODE;
+    if (!name || tagfs_name_files(name, &inode_id, 1) == 0) {
+        return TAGFS_INVALID_INODE;
+    }
+    return inode_id;
+}
+
+// ============================================================================
+// TAG INDEX MANAGEMENT
+// ============================================================================
+
+// ============================================================================
+// POSTING LISTS - inode_ids каждого entry отсортированы по возрастанию
+// ============================================================================
+//
+// С TAGFS_POSTING_BITMAP_MIN файлов список переезжает в TagBitmap: у тегов
+// вроде trashed:false / type:* OR и NOT идут по containers (64 ID за шаг),
+// а не по ID. Ниже половины порога - обратно в массив (без гистерезиса
+// add/remove на границе гоняли бы конверсию туда-обратно).
+//
+
+// Первая позиция в [lo, hi) с ids[pos] >= inode_id (hi - если нет)
+static uint32_t tagfs_posting_lower_bound(const uint64_t* ids, uint32_t lo, uint32_t hi,
+                                          uint64_t inode_id) {
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ids[mid] < inode_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Galloping от from: шаги 1, 2, 4... до первого ids >= inode_id, потом
+// бинарный поиск в последнем интервале. Для пересечения короткого списка с
+// длинным - O(log расстояния) вместо O(log длины) на каждый шаг
+static uint32_t tagfs_posting_gallop(const uint64_t* ids, uint32_t from, uint32_t count,
+                                     uint64_t inode_id) {
+    uint32_t bound = 1;
+    while (from + bound < count && ids[from + bound] < inode_id) {
+        bound *= 2;
+    }
+    uint32_t hi = from + bound + 1 < count ? from + bound + 1 : count;
+    return tagfs_posting_lower_bound(ids, from + bound / 2, hi, inode_id);
+}
+
+// Массив → bitmap. Нет памяти - список остаётся массивом
+static void tagfs_posting_to_bitmap(TagIndexEntry* entry) {
+    TagBitmap* bitmap = (TagBitmap*)kmalloc(sizeof(TagBitmap));
+    if (!bitmap) {
+        return;
+    }
+    tag_bitmap_init(bitmap);
+    if (tag_bitmap_add_array(bitmap, entry->inode_ids, entry->file_count) != 0) {
+        tag_bitmap_free(bitmap);
+        kfree(bitmap);
+        return;
+    }
+
+    kfree(entry->inode_ids);
+    entry->inode_ids = NULL;
+    entry->capacity = 0;
+    entry->bitmap = bitmap;
+}
+
+// Bitmap → массив. Нет памяти - список остаётся bitmap
+static void tagfs_posting_to_array(TagIndexEntry* entry) {
+    uint32_t capacity = 16;
+    while (capacity < entry->file_count) {
+        capacity *= 2;
+    }
+    uint64_t* ids = (uint64_t*)kmalloc(capacity * sizeof(uint64_t));
+    if (!ids) {
+        return;
+    }
+    tag_bitmap_to_array(entry->bitmap, ids, entry->file_count);
+
+    tag_bitmap_free(entry->bitmap);
+    kfree(entry->bitmap);
+    entry->bitmap = NULL;
+    entry->inode_ids = ids;
+    entry->capacity = capacity;
+}
+
+// Наименьший ID >= inode_id в списке. Массив - galloping от *cursor
+// (cursor только растёт), bitmap - по containers. 0 = таких нет
+static int tagfs_posting_seek(const TagIndexEntry* entry, uint32_t* cursor,
+                              uint64_t inode_id, uint64_t* found_out) {
+    if (entry->bitmap) {
+        return tag_bitmap_next(entry->bitmap, inode_id, found_out);
+    }
+    *cursor = tagfs_posting_gallop(entry->inode_ids, *cursor, entry->file_count, inode_id);
+    if (*cursor == entry->file_count) {
+        return 0;
+    }
+    *found_out = entry->inode_ids[*cursor];
+    return 1;
+}
+
+// dst |= список / dst &= ~список. 0 = успех, -1 = нет памяти
+static int tagfs_posting_or(TagBitmap* dst, const TagIndexEntry* entry) {
+    if (entry->bitmap) {
+        return tag_bitmap_or(dst, entry->bitmap);
+    }
+    return tag_bitmap_add_array(dst, entry->inode_ids, entry->file_count);
+}
+
+static void tagfs_posting_andnot(TagBitmap* dst, const TagIndexEntry* entry) {
+    if (entry->bitmap) {
+        tag_bitmap_andnot(dst, entry->bitmap);
+    } else {
+        tag_bitmap_remove_array(dst, entry->inode_ids, entry->file_count);
+    }
+}
+
+// Файл в список tag ID (на своё место по порядку)
+static void tagfs_posting_add(uint64_t inode_id, uint32_t tag_id) {
+    if (!tagfs_tag_get(tag_id)) {
+        return;
+    }
+    TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+    global_tagfs.posting_dirty = 1;
+
+    if (entry->bitmap) {
+        int added = tag_bitmap_add(entry->bitmap, inode_id);
+        if (added > 0) {
+            entry->file_count++;
+        } else if (added < 0) {
+            kprintf("[TAGFS] ERROR: Failed to add inode %lu to bitmap of %s:%s\n",
+                    inode_id, entry->tag.key, entry->tag.value);
+        }
+        return;
+    }
+
+    // Check if file already in list
+    uint32_t pos = tagfs_posting_lower_bound(entry->inode_ids, 0, entry->file_count, inode_id);
+    if (pos < entry->file_count && entry->inode_ids[pos] == inode_id) {
+        return;
+    }
 
-void tagfs_index_add_file(uint64_t inode_id, const Tag* tags, uint32_t tag_count) {
-    for (uint32_t i = 0; i < tag_count; i++) {
-        const Tag* tag = &tags[i];
+    // Resize if needed
+    if (entry->file_count >= entry->capacity) {
+        uint32_t new_capacity = entry->capacity * 2;
+        uint64_t* new_array = (uint64_t*)kmalloc(new_capacity * sizeof(uint64_t));
 
-        // Find or create index entry for this tag
-        TagIndexEntry* entry = NULL;
-        for (uint32_t j = 0; j < global_tagfs.tag_index.entry_count; j++) {
-            if (tagfs_tag_equal(&global_tagfs.tag_index.entries[j].tag, tag)) {
-                entry = &global_tagfs.tag_index.entries[j];
-                break;
-            }
+        if (!new_array) {
+            kprintf("[TAGFS] ERROR: Failed to resize inode_ids array (capacity %u -> %u)\n",
+                    entry->capacity, new_capacity);
+            return;  // Skip adding this file to avoid corruption
         }
 
-        if (!entry) {
-            // Create new entry
-            if (global_tagfs.tag_index.entry_count >= TAGFS_MAX_TAG_INDEX) {
-                kprintf("[TAGFS] Warning: tag index full\n");
-                continue;
-            }
+        memcpy(new_array, entry->inode_ids, entry->file_count * sizeof(uint64_t));
+        kfree(entry->inode_ids);
+        entry->inode_ids = new_array;
+        entry->capacity = new_capacity;
+    }
 
-            entry = &global_tagfs.tag_index.entries[global_tagfs.tag_index.entry_count];
-            global_tagfs.tag_index.entry_count++;
+    memmove(&entry->inode_ids[pos + 1], &entry->inode_ids[pos],
+            (entry->file_count - pos) * sizeof(uint64_t));
+    entry->inode_ids[pos] = inode_id;
+    entry->file_count++;
 
-            entry->tag = *tag;
-            entry->file_count = 0;
-            entry->capacity = 16;  // Start small
-            entry->inode_ids = (uint64_t*)kmalloc(entry->capacity * sizeof(uint64_t));
+    if (entry->file_count >= TAGFS_POSTING_BITMAP_MIN) {
+        tagfs_posting_to_bitmap(entry);
+    }
+}
 
-            if (!entry->inode_ids) {
-                kprintf("[TAGFS] ERROR: Failed to allocate inode_ids array for tag %s:%s\n",
-                        tag->key, tag->value);
-                global_tagfs.tag_index.entry_count--;  // Rollback
-                continue;
-            }
-        }
+static void tagfs_posting_remove(uint64_t inode_id, uint32_t tag_id) {
+    if (!tagfs_tag_get(tag_id)) {
+        return;
+    }
+    TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+    global_tagfs.posting_dirty = 1;
 
-        // Check if file already in list
-        int found = 0;
-        for (uint32_t j = 0; j < entry->file_count; j++) {
-            if (entry->inode_ids[j] == inode_id) {
-                found = 1;
-                break;
+    if (entry->bitmap) {
+        if (tag_bitmap_remove(entry->bitmap, inode_id) > 0) {
+            entry->file_count--;
+            if (entry->file_count < TAGFS_POSTING_BITMAP_MIN / 2) {
+                tagfs_posting_to_array(entry);
             }
         }
+        return;
+    }
 
-        if (!found) {
-            // Resize if needed
-            if (entry->file_count >= entry->capacity) {
-                uint32_t new_capacity = entry->capacity * 2;
-                uint64_t* new_array = (uint64_t*)kmalloc(new_capacity * sizeof(uint64_t));
+    uint32_t pos = tagfs_posting_lower_bound(entry->inode_ids, 0, entry->file_count, inode_id);
+    if (pos < entry->file_count && entry->inode_ids[pos] == inode_id) {
+        memmove(&entry->inode_ids[pos], &entry->inode_ids[pos + 1],
+                (entry->file_count - pos - 1) * sizeof(uint64_t));
+        entry->file_count--;
+    }
+}
 
-                if (!new_array) {
-                    kprintf("[TAGFS] ERROR: Failed to resize inode_ids array (capacity %u -> %u)\n",
-                            entry->capacity, new_capacity);
-                    continue;  // Skip adding this file to avoid corruption
-                }
+// Список меняется - view контекста следом. Под index_lock (write)
+static void tagfs_index_add_id(uint64_t inode_id, uint32_t tag_id) {
+    tagfs_posting_add(inode_id, tag_id);
+    tagfs_view_tag_changed(inode_id, tag_id);
+}
 
-                memcpy(new_array, entry->inode_ids, entry->file_count * sizeof(uint64_t));
-                kfree(entry->inode_ids);
-                entry->inode_ids = new_array;
-                entry->capacity = new_capacity;
-            }
+static void tagfs_index_remove_id(uint64_t inode_id, uint32_t tag_id) {
+    tagfs_posting_remove(inode_id, tag_id);
+    tagfs_view_tag_changed(inode_id, tag_id);
+}
 
-            entry->inode_ids[entry->file_count] = inode_id;
-            entry->file_count++;
+void tagfs_index_add_file(uint64_t inode_id, const Tag* tags, uint32_t tag_count) {
+    read_lock(&global_tagfs.commit_lock);
+    write_lock(&global_tagfs.index_lock);
+    for (uint32_t i = 0; i < tag_count; i++) {
+        // Find or create index entry for this tag
+        uint32_t tag_id = tagfs_tag_intern_locked(&tags[i]);
+        if (tag_id != TAGFS_INVALID_TAG_ID) {
+            tagfs_index_add_id(inode_id, tag_id);
         }
     }
+    write_unlock(&global_tagfs.index_lock);
+    read_unlock(&global_tagfs.commit_lock);
+}
+
+// Теги inode из его списков. Под inode lock + index_lock (write)
+static void tagfs_index_remove_inode(const FileInode* inode) {
+    for (uint32_t i = 0; i < inode->tag_count && i < TAGFS_MAX_TAGS_PER_FILE; i++) {
+        tagfs_index_remove_id(inode->inode_id, inode->tag_ids[i]);
+    }
 }
 
 void tagfs_index_remove_file(uint64_t inode_id) {
-    // Remove file from all tag index entries
-    for (uint32_t i = 0; i < global_tagfs.tag_index.entry_count; i++) {
-        TagIndexEntry* entry = &global_tagfs.tag_index.entries[i];
+    read_lock(&global_tagfs.commit_lock);
 
-        for (uint32_t j = 0; j < entry->file_count; j++) {
-            if (entry->inode_ids[j] == inode_id) {
-                // Shift remaining entries
-                for (uint32_t k = j; k < entry->file_count - 1; k++) {
-                    entry->inode_ids[k] = entry->inode_ids[k + 1];
-                }
-                entry->file_count--;
-                break;
-            }
+    // Inode ещё на месте - только его теги
+    FileInode* inode = tagfs_inode_acquire(inode_id, 0);
+    write_lock(&global_tagfs.index_lock);
+    if (inode) {
+        tagfs_index_remove_inode(inode);
+    } else {
+        // Remove file from all tag index entries
+        for (uint32_t tag_id = 1; tag_id <= global_tagfs.tag_index.entry_count; tag_id++) {
+            tagfs_index_remove_id(inode_id, tag_id);
         }
     }
+    write_unlock(&global_tagfs.index_lock);
+
+    if (inode) {
+        tagfs_inode_release(inode, 0);
+    }
+    read_unlock(&global_tagfs.commit_lock);
 }
 
+// Inodes читаются без своих locks - commit_lock (write) исключает всех,
+// кто их меняет
 void tagfs_index_rebuild(void) {
+    write_lock(&global_tagfs.commit_lock);
+    write_lock(&global_tagfs.index_lock);
+    tagfs_index_rebuild_locked();
+    write_unlock(&global_tagfs.index_lock);
+    write_unlock(&global_tagfs.commit_lock);
+}
+
+static void tagfs_index_rebuild_locked(void) {
     kprintf("[TAGFS] Rebuilding tag index...\n");
 
-    // Clear existing index
+    // Clear file lists (tag IDs в inodes - словарь не трогаем)
     for (uint32_t i = 0; i < global_tagfs.tag_index.entry_count; i++) {
-        if (global_tagfs.tag_index.entries[i].inode_ids) {
-            kfree(global_tagfs.tag_index.entries[i].inode_ids);
+        TagIndexEntry* entry = &global_tagfs.tag_index.entries[i];
+        entry->file_count = 0;
+        if (entry->bitmap) {
+            tag_bitmap_free(entry->bitmap);
+            tagfs_posting_to_array(entry);
         }
     }
-    global_tagfs.tag_index.entry_count = 0;
+    tag_bitmap_free(&global_tagfs.tag_index.files);
+    global_tagfs.posting_dirty = 1;
 
     // OPTIMIZATION: Skip scanning for freshly formatted filesystem
     if (global_tagfs.superblock->free_inodes == global_tagfs.superblock->total_inodes) {
         kprintf("[TAGFS] Filesystem is empty, skipping inode scan\n");
-        kprintf("[TAGFS] Index rebuilt: 0 unique tags\n");
+        kprintf("[TAGFS] Index rebuilt: %u unique tags\n", global_tagfs.tag_index.entry_count);
+        tagfs_view_rebuild_locked();
         return;
     }
 
@@ -1175,122 +2640,380 @@ void tagfs_index_rebuild(void) {
     for (uint64_t i = 0; i < inodes_to_scan && scanned < 10000; i++) {
         FileInode* inode = &global_tagfs.inode_table[i];
         if (inode->inode_id != 0) {
-            tagfs_index_add_file(inode->inode_id, inode->tags, inode->tag_count);
+            tag_bitmap_add(&global_tagfs.tag_index.files, inode->inode_id);
+            for (uint32_t t = 0; t < inode->tag_count && t < TAGFS_MAX_TAGS_PER_FILE; t++) {
+                tagfs_posting_add(inode->inode_id, inode->tag_ids[t]);
+            }
         }
         scanned++;
     }
 
+    tagfs_view_rebuild_locked();
     kprintf("[TAGFS] Index rebuilt: %u unique tags\n", global_tagfs.tag_index.entry_count);
 }
 
 // ============================================================================
-// QUERY OPERATIONS
+// POSTING IMAGE - posting lists на диске, mount без скана inodes
+// ============================================================================
+//
+// Образ в [posting_block, +posting_blocks): список живых файлов, затем
+// списки tag ID 1..posting_tags. Список - varint(count), затем varint
+// разностей соседних ID (первый - от 0): ID растут, разности маленькие,
+// обычно 1-2 байта на файл.
+//
+// Sync кодирует образ заново, но dirty помечает только блоки, где байты
+// реально изменились, - меняется один файл, на диск идут 1-2 блока.
+// Mount: CRC32C из superblock совпал и образ разобрался - списки из него,
+// иначе tagfs_index_rebuild().
+//
 // ============================================================================
 
-int tagfs_query_single(const Tag* tag, uint64_t* result_inodes, uint32_t* count_out, uint32_t max_results) {
-    *count_out = 0;
+// Кодирование блоками через staging буфер (под commit_lock (write) - списки
+// никто не меняет)
+typedef struct {
+    uint64_t block;                     // Следующий блок образа в tagfs_storage
+    uint64_t end_block;
+    uint32_t pos;                       // Байт в staging
+    uint64_t size;                      // Байт образа всего
+    uint32_t crc;
+    uint32_t changed;                   // Блоков помечено dirty
+    int overflow;                       // Образ не влез в регион
+} TagFSPostingWriter;
+
+static uint8_t tagfs_posting_stage[TAGFS_BLOCK_SIZE];
+
+static int tagfs_posting_region_valid(const TagFSSuperblock* sb) {
+    return sb->posting_block != 0 && sb->posting_blocks != 0 &&
+           sb->posting_block >= sb->tag_index_block &&
+           sb->posting_block + sb->posting_blocks <= sb->data_blocks_start &&
+           sb->data_blocks_start <= TAGFS_MEM_BLOCKS;
+}
 
-    // Find tag in index
-    for (uint32_t i = 0; i < global_tagfs.tag_index.entry_count; i++) {
-        TagIndexEntry* entry = &global_tagfs.tag_index.entries[i];
-        if (tagfs_tag_equal(&entry->tag, tag)) {
-            uint32_t to_copy = entry->file_count;
-            if (to_copy > max_results) {
-                to_copy = max_results;
-            }
+static void tagfs_posting_flush(TagFSPostingWriter* writer) {
+    if (writer->pos == 0) {
+        return;
+    }
+    if (writer->block >= writer->end_block) {
+        writer->overflow = 1;
+        writer->pos = 0;
+        return;
+    }
 
-            memcpy(result_inodes, entry->inode_ids, to_copy * sizeof(uint64_t));
-            *count_out = to_copy;
+    // Хвост последнего блока - нули, чтобы сравнение не зависело от мусора
+    memset(tagfs_posting_stage + writer->pos, 0, TAGFS_BLOCK_SIZE - writer->pos);
+    if (memcmp(tagfs_storage[writer->block], tagfs_posting_stage, TAGFS_BLOCK_SIZE) != 0) {
+        memcpy(tagfs_storage[writer->block], tagfs_posting_stage, TAGFS_BLOCK_SIZE);
+        bitmap_set_bit(tagfs_meta_dirty, writer->block);
+        writer->changed++;
+    }
+    writer->crc = crc32c_update(writer->crc, tagfs_posting_stage, writer->pos);
+    writer->block++;
+    writer->pos = 0;
+}
 
-            atomic_increment_u64(&global_tagfs.queries_executed);
-            return 1;
+static void tagfs_posting_put(TagFSPostingWriter* writer, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        tagfs_posting_stage[writer->pos++] = byte | (value ? 0x80 : 0);
+        writer->size++;
+        if (writer->pos == TAGFS_BLOCK_SIZE) {
+            tagfs_posting_flush(writer);
         }
-    }
+    } while (value);
+}
+
+static void tagfs_posting_put_list(TagFSPostingWriter* writer, const TagIndexEntry* entry) {
+    tagfs_posting_put(writer, entry->file_count);
 
-    return 0;  // Tag not found
+    uint32_t cursor = 0;
+    uint64_t prev = 0, inode_id = 0;
+    while (tagfs_posting_seek(entry, &cursor, prev + 1, &inode_id)) {
+        tagfs_posting_put(writer, inode_id - prev);
+        prev = inode_id;
+    }
 }
 
-int tagfs_query(TagQuery* query) {
-    if (query->tag_count == 0) {
+static int tagfs_posting_store(void) {
+    TagFSSuperblock* sb = global_tagfs.superblock;
+    if (!use_disk || !global_tagfs.posting_dirty || !tagfs_posting_region_valid(sb)) {
         return 0;
     }
 
-    query->result_count = 0;
+    TagFSPostingWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.block = sb->posting_block;
+    writer.end_block = sb->posting_block + sb->posting_blocks;
 
-    if (query->op == QUERY_OP_AND) {
-        // AND: файл должен иметь ВСЕ теги
-        // Стратегия: начинаем с первого тега, затем фильтруем
+    // Живые файлы - тот же формат, что у списка тега
+    TagIndexEntry files;
+    memset(&files, 0, sizeof(files));
+    files.bitmap = &global_tagfs.tag_index.files;
+    files.file_count = (uint32_t)tag_bitmap_cardinality(&global_tagfs.tag_index.files);
+    tagfs_posting_put_list(&writer, &files);
+
+    uint32_t tag_count = global_tagfs.tag_index.entry_count;
+    for (uint32_t tag_id = 1; tag_id <= tag_count && !writer.overflow; tag_id++) {
+        tagfs_posting_put_list(&writer, tagfs_tag_entry(tag_id));
+    }
+    tagfs_posting_flush(&writer);
+
+    int result = 0;
+    if (writer.overflow) {
+        // Не влез - на mount rebuild; dirty остаётся, пробуем на каждом sync
+        sb->posting_size = 0;
+        result = -1;
+    } else {
+        sb->posting_size = writer.size;
+        sb->posting_tags = tag_count;
+        sb->posting_crc = writer.crc;
+        global_tagfs.posting_dirty = 0;
+    }
+    tagfs_mark_superblock_dirty();
+
+    if (result == 0) {
+        kprintf("[TAGFS] Posting lists: %lu bytes, %u block(s) changed\n", writer.size, writer.changed);
+    } else {
+        kprintf("[TAGFS] %[W]WARNING: Posting lists exceed %lu blocks%[D]\n", sb->posting_blocks);
+    }
+    return result;
+}
 
-        uint64_t* candidates = (uint64_t*)kmalloc(TAGFS_MAX_FILES * sizeof(uint64_t));
-        if (!candidates) {
-            kprintf("[TAGFS] ERROR: Failed to allocate candidates array for AND query\n");
+// Чтение varint из образа. 0 = образ кончился / переполнение
+static int tagfs_posting_get(const uint8_t* image, uint64_t size, uint64_t* pos, uint64_t* value_out) {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (*pos >= size) {
             return 0;
         }
+        uint8_t byte = image[(*pos)++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value_out = value;
+            return 1;
+        }
+    }
+    return 0;
+}
 
-        uint32_t candidate_count = 0;
+// Список из образа: tag_id = 0 - живые файлы. 0 = образ повреждён
+static int tagfs_posting_get_list(const uint8_t* image, uint64_t size, uint64_t* pos, uint32_t tag_id) {
+    uint64_t count = 0;
+    if (!tagfs_posting_get(image, size, pos, &count) || count > TAGFS_MAX_FILES) {
+        return 0;
+    }
 
-        // Get files with first tag
-        tagfs_query_single(&query->tags[0], candidates, &candidate_count, TAGFS_MAX_FILES);
+    uint64_t inode_id = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t delta = 0;
+        // DEFENSIVE: ID строго растут (delta 0 - дубликат)
+        if (!tagfs_posting_get(image, size, pos, &delta) || delta == 0) {
+            return 0;
+        }
+        inode_id += delta;
 
-        // Filter by remaining tags
-        for (uint32_t i = 1; i < query->tag_count && candidate_count > 0; i++) {
-            uint32_t filtered_count = 0;
-            for (uint32_t j = 0; j < candidate_count; j++) {
-                if (tagfs_file_has_tag(candidates[j], &query->tags[i])) {
-                    candidates[filtered_count++] = candidates[j];
-                }
+        if (tag_id == TAGFS_INVALID_TAG_ID) {
+            if (tag_bitmap_add(&global_tagfs.tag_index.files, inode_id) < 0) {
+                return 0;
             }
-            candidate_count = filtered_count;
+        } else {
+            tagfs_posting_add(inode_id, tag_id);
         }
+    }
+    return 1;
+}
+
+// 0 = списки загружены из образа, -1 = образа нет / не подходит (нужен rebuild)
+static int tagfs_posting_load(void) {
+    TagFSSuperblock* sb = global_tagfs.superblock;
+    if (!tagfs_posting_region_valid(sb) || sb->posting_size == 0) {
+        return -1;
+    }
+    if (sb->posting_size > sb->posting_blocks * TAGFS_BLOCK_SIZE ||
+        sb->posting_tags != global_tagfs.tag_index.entry_count) {
+        kprintf("[TAGFS] %[W]WARNING: Posting image does not match tag dictionary, rebuilding%[D]\n");
+        return -1;
+    }
+
+    const uint8_t* image = tagfs_storage[sb->posting_block];
+    if (crc32c_compute(image, sb->posting_size) != sb->posting_crc) {
+        kprintf("[TAGFS] %[W]WARNING: Posting image checksum mismatch, rebuilding%[D]\n");
+        return -1;
+    }
+
+    uint64_t pos = 0;
+    int ok = tagfs_posting_get_list(image, sb->posting_size, &pos, TAGFS_INVALID_TAG_ID);
+    for (uint32_t tag_id = 1; ok && tag_id <= sb->posting_tags; tag_id++) {
+        ok = tagfs_posting_get_list(image, sb->posting_size, &pos, tag_id);
+    }
+    if (!ok || pos != sb->posting_size) {
+        kprintf("[TAGFS] %[W]WARNING: Posting image corrupted, rebuilding%[D]\n");
+        return -1;  // Rebuild сам очистит частично загруженные списки
+    }
+
+    // Списки совпадают с образом на диске
+    global_tagfs.posting_dirty = 0;
+    tagfs_view_rebuild_locked();
+    kprintf("[TAGFS] Tag index loaded from disk: %lu files, %u tags (%lu bytes)\n",
+            tag_bitmap_cardinality(&global_tagfs.tag_index.files), sb->posting_tags, sb->posting_size);
+    return 0;
+}
 
-        // Copy results
-        uint32_t to_copy = candidate_count;
-        if (to_copy > query->result_capacity) {
-            to_copy = query->result_capacity;
+// ============================================================================
+// QUERY OPERATIONS
+// ============================================================================
+
+// Queries целиком под index_lock (read): параллельно друг с другом и с
+// чтением файлов, ждут только intern / изменение списков
+static int tagfs_query_single_locked(const Tag* tag, uint64_t* result_inodes, uint32_t* count_out, uint32_t max_results) {
+    *count_out = 0;
+
+    // Find tag in index
+    uint32_t tag_id = tagfs_tag_lookup_locked(tag);
+    if (tag_id == TAGFS_INVALID_TAG_ID) {
+        return 0;  // Tag not found
+    }
+
+    TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+    if (entry->bitmap) {
+        *count_out = tag_bitmap_to_array(entry->bitmap, result_inodes, max_results);
+    } else {
+        uint32_t to_copy = entry->file_count;
+        if (to_copy > max_results) {
+            to_copy = max_results;
         }
-        memcpy(query->result_inodes, candidates, to_copy * sizeof(uint64_t));
-        query->result_count = to_copy;
+        memcpy(result_inodes, entry->inode_ids, to_copy * sizeof(uint64_t));
+        *count_out = to_copy;
+    }
+
+    atomic_increment_u64(&global_tagfs.queries_executed);
+    return 1;
+}
+
+int tagfs_query_single(const Tag* tag, uint64_t* result_inodes, uint32_t* count_out, uint32_t max_results) {
+    read_lock(&global_tagfs.index_lock);
+    int result = tagfs_query_single_locked(tag, result_inodes, count_out, max_results);
+    read_unlock(&global_tagfs.index_lock);
+    return result;
+}
 
-        kfree(candidates);
+static int tagfs_query_locked(TagQuery* query) {
+    if (query->tag_count == 0) {
+        return 0;
+    }
 
-    } else if (query->op == QUERY_OP_OR) {
-        // OR: файл должен иметь ХОТЯ БЫ ОДИН тег
+    query->result_count = 0;
 
-        uint8_t* seen = (uint8_t*)kmalloc(TAGFS_MAX_FILES);
-        if (!seen) {
-            kprintf("[TAGFS] ERROR: Failed to allocate seen array for OR query\n");
-            return 0;
+    if (query->op == QUERY_OP_AND) {
+        // AND: пересечение posting lists от самого короткого. Массивы -
+        // galloping от позиции предыдущего совпадения, bitmap - поиск по
+        // containers. Результаты - сразу в буфер caller
+
+        // DEFENSIVE: больше тегов, чем у файла может быть, - совпадений нет
+        if (query->tag_count > TAGFS_MAX_TAGS_PER_FILE) {
+            atomic_increment_u64(&global_tagfs.queries_executed);
+            return 1;
         }
 
-        memset(seen, 0, TAGFS_MAX_FILES);
+        TagIndexEntry* lists[TAGFS_MAX_TAGS_PER_FILE];
+        uint32_t cursors[TAGFS_MAX_TAGS_PER_FILE];
+        for (uint32_t i = 0; i < query->tag_count; i++) {
+            uint32_t tag_id = tagfs_tag_lookup_locked(&query->tags[i]);
+            if (tag_id == TAGFS_INVALID_TAG_ID) {
+                atomic_increment_u64(&global_tagfs.queries_executed);
+                return 1;  // Тега нет ни у кого - пустой результат
+            }
+
+            // Insertion sort по длине списка
+            TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+            uint32_t pos = i;
+            while (pos > 0 && lists[pos - 1]->file_count > entry->file_count) {
+                lists[pos] = lists[pos - 1];
+                pos--;
+            }
+            lists[pos] = entry;
+            cursors[i] = 0;
+        }
 
+        // Leapfrog: кандидат - следующий ID самого короткого списка, каждый
+        // следующий список либо подтверждает его, либо сдвигает вперёд
         uint32_t result_count = 0;
+        uint64_t candidate = 0;
+
+        while (result_count < query->result_capacity &&
+               tagfs_posting_seek(lists[0], &cursors[0], candidate, &candidate)) {
+            int match = 1;
+            int exhausted = 0;
+
+            for (uint32_t l = 1; l < query->tag_count; l++) {
+                uint64_t found = 0;
+                if (!tagfs_posting_seek(lists[l], &cursors[l], candidate, &found)) {
+                    exhausted = 1;  // Дальше в этом списке нет - совпадений больше не будет
+                    break;
+                }
+                if (found != candidate) {
+                    candidate = found;
+                    match = 0;
+                    break;
+                }
+            }
+
+            if (exhausted) {
+                break;
+            }
+            if (match) {
+                query->result_inodes[result_count++] = candidate++;
+            }
+        }
+        query->result_count = result_count;
+
+    } else {
+        // OR: объединение списков в TagBitmap. NOT: все живые файлы минус
+        // списки тегов. Полный результат без ограничения на тег, затем
+        // первые result_capacity ID по возрастанию
+        TagBitmap result;
+        if (query->op == QUERY_OP_NOT) {
+            if (tag_bitmap_copy(&result, &global_tagfs.tag_index.files) != 0) {
+                tag_bitmap_free(&result);
+                kprintf("[TAGFS] ERROR: Failed to allocate bitmap for NOT query\n");
+                return 0;
+            }
+        } else {
+            tag_bitmap_init(&result);
+        }
 
         for (uint32_t i = 0; i < query->tag_count; i++) {
-            uint64_t temp_results[256];
-            uint32_t temp_count = 0;
-
-            tagfs_query_single(&query->tags[i], temp_results, &temp_count, 256);
-
-            for (uint32_t j = 0; j < temp_count; j++) {
-                uint64_t inode_id = temp_results[j];
-                if (inode_id < TAGFS_MAX_FILES && !seen[inode_id]) {
-                    seen[inode_id] = 1;
-                    if (result_count < query->result_capacity) {
-                        query->result_inodes[result_count++] = inode_id;
-                    }
-                }
+            uint32_t tag_id = tagfs_tag_lookup_locked(&query->tags[i]);
+            if (tag_id == TAGFS_INVALID_TAG_ID) {
+                continue;
+            }
+
+            TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+            if (query->op == QUERY_OP_NOT) {
+                tagfs_posting_andnot(&result, entry);
+            } else if (tagfs_posting_or(&result, entry) != 0) {
+                tag_bitmap_free(&result);
+                kprintf("[TAGFS] ERROR: Failed to allocate bitmap for OR query\n");
+                return 0;
             }
         }
 
-        query->result_count = result_count;
-        kfree(seen);
+        query->result_count = tag_bitmap_to_array(&result, query->result_inodes,
+                                                  query->result_capacity);
+        tag_bitmap_free(&result);
     }
 
     atomic_increment_u64(&global_tagfs.queries_executed);
     return 1;
 }
 
+int tagfs_query(TagQuery* query) {
+    read_lock(&global_tagfs.index_lock);
+    int result = tagfs_query_locked(query);
+    read_unlock(&global_tagfs.index_lock);
+    return result;
+}
+
 // Convenient wrappers
 int tagfs_find_by_type(const char* type, uint64_t* result_inodes, uint32_t* count_out, uint32_t max_results) {
     char tag_str[128];
@@ -1307,27 +3030,20 @@ int tagfs_find_by_date(const char* date, uint64_t* result_inodes, uint32_t* coun
 }
 
 int tagfs_find_not_trashed(uint64_t* result_inodes, uint32_t* count_out, uint32_t max_results) {
-    // Возвращаем все файлы БЕЗ тега "trashed:true"
-    uint32_t result_count = 0;
-
-    // Safely cap iteration to prevent buffer overflow
-    uint32_t safe_max_inodes = global_tagfs.superblock->total_inodes;
-    if (safe_max_inodes > TAGFS_MAX_FILES) {
-        safe_max_inodes = TAGFS_MAX_FILES;
-    }
+    // Возвращаем все файлы БЕЗ тега "trashed:true" - NOT по bitmap, без скана inodes
+    Tag trash_tag = tagfs_tag_from_string("trashed:true");
 
-    for (uint32_t i = 0; i < safe_max_inodes && result_count < max_results; i++) {
-        FileInode* inode = &global_tagfs.inode_table[i];
-        if (inode->inode_id != 0) {
-            Tag trash_tag = tagfs_tag_from_string("trashed:true");
-            if (!tagfs_file_has_tag(inode->inode_id, &trash_tag)) {
-                result_inodes[result_count++] = inode->inode_id;
-            }
-        }
-    }
+    TagQuery query;
+    memset(&query, 0, sizeof(query));
+    query.tags = &trash_tag;
+    query.tag_count = 1;
+    query.op = QUERY_OP_NOT;
+    query.result_inodes = result_inodes;
+    query.result_capacity = max_results;
 
-    *count_out = result_count;
-    return 1;
+    int result = tagfs_query(&query);
+    *count_out = query.result_count;
+    return result;
 }
 
 // ============================================================================
@@ -1339,15 +3055,29 @@ void tagfs_print_stats(void) {
     kprintf("  Files created:   %lu\n", global_tagfs.files_created);
     kprintf("  Files deleted:   %lu\n", global_tagfs.files_deleted);
     kprintf("  Queries executed: %lu\n", global_tagfs.queries_executed);
+    kprintf("  Name lookups:    %lu (%u names)\n", global_tagfs.name_lookups,
+            global_tagfs.tag_index.name_count);
     kprintf("  Tags added:      %lu\n", global_tagfs.tags_added);
     kprintf("  Tags removed:    %lu\n", global_tagfs.tags_removed);
-    kprintf("  Unique tags:     %u\n", global_tagfs.tag_index.entry_count);
+    kprintf("  Unique tags:     %u (capacity %u, %u buckets)\n",
+            global_tagfs.tag_index.entry_count,
+            global_tagfs.tag_index.capacity,
+            global_tagfs.tag_index.bucket_count);
     kprintf("  Free blocks:     %lu / %lu\n",
             global_tagfs.superblock->free_blocks,
             global_tagfs.superblock->total_blocks);
     kprintf("  Free inodes:     %lu / %lu\n",
             global_tagfs.superblock->free_inodes,
             global_tagfs.superblock->total_inodes);
+    kprintf("  Journal:         %lu commits, %lu blocks logged, %lu checkpoints\n",
+            global_tagfs.journal_commits,
+            global_tagfs.journal_blocks_logged,
+            global_tagfs.journal_checkpoints);
+    if (use_disk) {
+        block_cache_print_stats();
+        block_queue_print_stats();
+        ata_print_async_stats();
+    }
 }
 
 void tagfs_print_file_info(uint64_t inode_id) {
@@ -1361,28 +3091,169 @@ void tagfs_print_file_info(uint64_t inode_id) {
     kprintf("  Size:         %lu bytes\n", inode->size);
     kprintf("  Created:      %lu\n", inode->creation_time);
     kprintf("  Modified:     %lu\n", inode->modification_time);
+    if (tagfs_inode_is_inline(inode)) {
+        kprintf("  Data:         inline\n");
+    } else {
+        kprintf("  Data:         %u extent(s)\n", inode->extent_count);
+    }
     kprintf("  Tags (%u):\n", inode->tag_count);
 
     for (uint32_t i = 0; i < inode->tag_count; i++) {
-        kprintf("    %s:%s\n", inode->tags[i].key, inode->tags[i].value);
+        const Tag* tag = tagfs_tag_get(inode->tag_ids[i]);
+        if (tag) {
+            kprintf("    %s:%s\n", tag->key, tag->value);
+        } else {
+            kprintf("    <invalid tag id %u>\n", inode->tag_ids[i]);
+        }
     }
 }
 
 void tagfs_print_tag_index(void) {
+    read_lock(&global_tagfs.index_lock);
     kprintf("[TAGFS] === Tag Index (%u entries) ===\n", global_tagfs.tag_index.entry_count);
 
     for (uint32_t i = 0; i < global_tagfs.tag_index.entry_count; i++) {
         TagIndexEntry* entry = &global_tagfs.tag_index.entries[i];
-        kprintf("  %s:%s -> %u files\n",
-                entry->tag.key,
-                entry->tag.value,
-                entry->file_count);
+        if (entry->bitmap) {
+            kprintf("  %s:%s -> %u files (bitmap, %u containers)\n",
+                    entry->tag.key,
+                    entry->tag.value,
+                    entry->file_count,
+                    entry->bitmap->count);
+        } else {
+            kprintf("  %s:%s -> %u files\n",
+                    entry->tag.key,
+                    entry->tag.value,
+                    entry->file_count);
+        }
     }
+    read_unlock(&global_tagfs.index_lock);
 }
 
 // ============================================================================
 // USER CONTEXT OPERATIONS - NEW!
 // ============================================================================
+//
+// view (TagFSUserContext) - результат контекста: set / clear считают его
+// один раз пересечением posting lists, дальше каждое изменение списка тега
+// контекста или trashed:true (add / remove tag, trash / restore, create,
+// erase) перепроверяет только этот файл. Listing - копия view.
+//
+
+// Файл в списке (массив - бинарный поиск, bitmap - container)
+static int tagfs_posting_contains(uint32_t tag_id, uint64_t inode_id) {
+    if (!tagfs_tag_get(tag_id)) {
+        return 0;
+    }
+    const TagIndexEntry* entry = tagfs_tag_entry(tag_id);
+    if (entry->bitmap) {
+        return tag_bitmap_contains(entry->bitmap, inode_id);
+    }
+    uint32_t pos = tagfs_posting_lower_bound(entry->inode_ids, 0, entry->file_count, inode_id);
+    return pos < entry->file_count && entry->inode_ids[pos] == inode_id;
+}
+
+// Файл в результате контекста. Под index_lock
+static int tagfs_view_member(uint64_t inode_id) {
+    TagFSUserContext* context = &global_tagfs.user_context;
+    if (!tag_bitmap_contains(&global_tagfs.tag_index.files, inode_id) ||
+        tagfs_posting_contains(context->trash_id, inode_id)) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < context->tag_count; i++) {
+        if (!tagfs_posting_contains(context->tag_ids[i], inode_id)) {
+            return 0;  // Тега нет (или его нет и в dictionary)
+        }
+    }
+    return 1;
+}
+
+// Перепроверить один файл. Под index_lock (write)
+static void tagfs_view_update(uint64_t inode_id) {
+    TagFSUserContext* context = &global_tagfs.user_context;
+    if (tagfs_view_member(inode_id)) {
+        if (tag_bitmap_add(&context->view, inode_id) < 0) {
+            kprintf("[TAGFS] %[W]WARNING: Context view out of memory (inode %lu)%[D]\n", inode_id);
+        }
+    } else {
+        tag_bitmap_remove(&context->view, inode_id);
+    }
+}
+
+// Список tag_id изменился для inode_id - view касается, только если тег в контексте
+static void tagfs_view_tag_changed(uint64_t inode_id, uint32_t tag_id) {
+    TagFSUserContext* context = &global_tagfs.user_context;
+    if (tag_id == TAGFS_INVALID_TAG_ID) {
+        return;
+    }
+    if (tag_id == context->trash_id) {
+        tagfs_view_update(inode_id);
+        return;
+    }
+    for (uint32_t i = 0; i < context->tag_count; i++) {
+        if (context->tag_ids[i] == tag_id) {
+            tagfs_view_update(inode_id);
+            return;
+        }
+    }
+}
+
+// Новый entry - может быть тегом контекста, которого раньше не было.
+// Список у него пока пустой, view не меняется
+static void tagfs_view_tag_inserted(uint32_t tag_id) {
+    TagFSUserContext* context = &global_tagfs.user_context;
+    const Tag* tag = &tagfs_tag_entry(tag_id)->tag;
+
+    if (context->trash_id == TAGFS_INVALID_TAG_ID &&
+        strcmp(tag->key, "trashed") == 0 && strcmp(tag->value, "true") == 0) {
+        context->trash_id = tag_id;
+    }
+    for (uint32_t i = 0; i < context->tag_count; i++) {
+        if (context->tag_ids[i] == TAGFS_INVALID_TAG_ID && tagfs_tag_equal(&context->tags[i], tag)) {
+            context->tag_ids[i] = tag_id;
+        }
+    }
+}
+
+// View заново: кандидаты - кратчайший список тега контекста (без тегов -
+// все файлы), каждый проверяется по остальным. Под index_lock (write)
+static void tagfs_view_rebuild_locked(void) {
+    TagFSUserContext* context = &global_tagfs.user_context;
+    Tag trash_tag = tagfs_tag_from_string("trashed:true");
+
+    tag_bitmap_free(&context->view);
+    context->trash_id = tagfs_tag_lookup_locked(&trash_tag);
+
+    const TagIndexEntry* shortest = NULL;
+    int empty = 0;
+    for (uint32_t i = 0; i < context->tag_count; i++) {
+        context->tag_ids[i] = tagfs_tag_lookup_locked(&context->tags[i]);
+        if (context->tag_ids[i] == TAGFS_INVALID_TAG_ID) {
+            empty = 1;  // Ни у одного файла такого тега
+            continue;
+        }
+        const TagIndexEntry* entry = tagfs_tag_entry(context->tag_ids[i]);
+        if (!shortest || entry->file_count < shortest->file_count) {
+            shortest = entry;
+        }
+    }
+    if (empty) {
+        return;
+    }
+
+    const TagBitmap* candidates = shortest ? shortest->bitmap : &global_tagfs.tag_index.files;
+    if (candidates) {
+        uint64_t inode_id = 0;
+        while (tag_bitmap_next(candidates, inode_id, &inode_id)) {
+            tagfs_view_update(inode_id);
+            inode_id++;
+        }
+    } else {
+        for (uint32_t i = 0; i < shortest->file_count; i++) {
+            tagfs_view_update(shortest->inode_ids[i]);
+        }
+    }
+}
 
 // Установить контекст пользователя
 int tagfs_context_set(Tag* tags, uint32_t tag_count) {
@@ -1392,7 +3263,7 @@ int tagfs_context_set(Tag* tags, uint32_t tag_count) {
         return -1;
     }
 
-    spin_lock(&global_tagfs.lock);
+    write_lock(&global_tagfs.index_lock);
 
     // Копируем теги
     for (uint32_t i = 0; i < tag_count; i++) {
@@ -1400,10 +3271,12 @@ int tagfs_context_set(Tag* tags, uint32_t tag_count) {
     }
     global_tagfs.user_context.tag_count = tag_count;
     global_tagfs.user_context.enabled = true;
+    tagfs_view_rebuild_locked();
+    uint64_t matched = tag_bitmap_cardinality(&global_tagfs.user_context.view);
 
-    spin_unlock(&global_tagfs.lock);
+    write_unlock(&global_tagfs.index_lock);
 
-    kprintf("[TAGFS] Context set: %u tags\n", tag_count);
+    kprintf("[TAGFS] Context set: %u tags, %lu files\n", tag_count, matched);
     for (uint32_t i = 0; i < tag_count; i++) {
         kprintf("  - %s:%s\n", tags[i].key, tags[i].value);
     }
@@ -1413,10 +3286,11 @@ int tagfs_context_set(Tag* tags, uint32_t tag_count) {
 
 // Очистить контекст
 void tagfs_context_clear(void) {
-    spin_lock(&global_tagfs.lock);
+    write_lock(&global_tagfs.index_lock);
     global_tagfs.user_context.enabled = false;
     global_tagfs.user_context.tag_count = 0;
-    spin_unlock(&global_tagfs.lock);
+    tagfs_view_rebuild_locked();  // Все файлы не в корзине
+    write_unlock(&global_tagfs.index_lock);
 
     kprintf("[TAGFS] Context cleared (showing all files)\n");
 }
@@ -1447,33 +3321,11 @@ bool tagfs_context_matches(uint64_t inode_id) {
     return true;  // Все теги есть - подходит!
 }
 
-// Получить список файлов в текущем контексте
+// Получить список файлов в текущем контексте (не в корзине) - копия view
 int tagfs_context_list_files(uint64_t* result_inodes, uint32_t* count_out, uint32_t max_results) {
-    uint32_t result_count = 0;
-
-    uint32_t safe_max_inodes = global_tagfs.superblock->total_inodes;
-    if (safe_max_inodes > TAGFS_MAX_FILES) {
-        safe_max_inodes = TAGFS_MAX_FILES;
-    }
-
-    // Перебираем все файлы и фильтруем по контексту
-    for (uint32_t i = 0; i < safe_max_inodes && result_count < max_results; i++) {
-        FileInode* inode = &global_tagfs.inode_table[i];
-        if (inode->inode_id != 0) {
-            // Пропускаем удаленные файлы
-            Tag trash_tag = tagfs_tag_from_string("trashed:true");
-            if (tagfs_file_has_tag(inode->inode_id, &trash_tag)) {
-                continue;
-            }
-
-            // Проверяем соответствие контексту
-            if (tagfs_context_matches(inode->inode_id)) {
-                result_inodes[result_count++] = inode->inode_id;
-            }
-        }
-    }
-
-    *count_out = result_count;
+    read_lock(&global_tagfs.index_lock);
+    *count_out = tag_bitmap_to_array(&global_tagfs.user_context.view, result_inodes, max_results);
+    read_unlock(&global_tagfs.index_lock);
     return 0;
 }
 
@@ -1539,38 +3391,38 @@ int tagfs_restore_file(uint64_t inode_id) {
 
 // Полностью удалить файл с диска (жесткое удаление)
 int tagfs_erase_file(uint64_t inode_id) {
-    FileInode* inode = tagfs_get_inode(inode_id);
+    read_lock(&global_tagfs.commit_lock);
+
+    FileInode* inode = tagfs_inode_acquire(inode_id, 1);
     if (!inode) {
+        read_unlock(&global_tagfs.commit_lock);
         kprintf("[TAGFS] ERROR: File not found (inode=%lu)\n", inode_id);
         return -1;
     }
 
-    spin_lock(&global_tagfs.lock);
-
     // Освобождаем все блоки данных
-    for (int i = 0; i < 12; i++) {
-        if (inode->direct_blocks[i] != 0) {
-            bitmap_clear_bit(global_tagfs.block_bitmap, inode->direct_blocks[i]);
-            global_tagfs.superblock->free_blocks++;
-            inode->direct_blocks[i] = 0;
-        }
-    }
-
-    // TODO: Освободить indirect и double_indirect блоки
+    tagfs_free_extents(inode);
 
     // Удаляем из индекса тегов
-    tagfs_index_remove_file(inode_id);
-
-    // Очищаем inode
+    write_lock(&global_tagfs.index_lock);
+    tagfs_index_remove_inode(inode);
+    tag_bitmap_remove(&global_tagfs.tag_index.files, inode_id);
+    tagfs_view_update(inode_id);
+    global_tagfs.posting_dirty = 1;
+    write_unlock(&global_tagfs.index_lock);
+
+    // Очищаем inode (inode_id = 0 - ждущие его lock перепроверят и не найдут)
     memset(inode, 0, sizeof(FileInode));
+    tagfs_mark_inode_dirty(inode);
 
-    // Освобождаем inode bitmap
-    bitmap_clear_bit(global_tagfs.inode_bitmap, inode_id);
-    global_tagfs.superblock->free_inodes++;
+    // Освобождаем inode bitmap (бит - слот, не inode ID) - только после
+    // очистки: иначе create может занять слот раньше memset
+    tagfs_release_inode_slot((uint64_t)(inode - global_tagfs.inode_table));
 
-    global_tagfs.files_deleted++;
+    atomic_increment_u64(&global_tagfs.files_deleted);
 
-    spin_unlock(&global_tagfs.lock);
+    tagfs_inode_release(inode, 1);
+    read_unlock(&global_tagfs.commit_lock);
 
     kprintf("[TAGFS] File erased completely (inode=%lu)\n", inode_id);
     return 0;
@@ -1629,24 +3481,18 @@ int tagfs_write_file_content(uint64_t inode_id, const uint8_t* data, uint64_t si
 
 // Найти файл по имени (тегу name:xxx) в текущем контексте
 uint64_t tagfs_find_by_name(const char* name) {
-    // Создаем тег name:xxx
-    char tag_str[128];
-    ksnprintf(tag_str, sizeof(tag_str), "name:%s", name);
-    Tag name_tag = tagfs_tag_from_string(tag_str);
-
-    // Ищем файлы с этим тегом
+    // Файлы с тегом name:xxx - через name index
     uint64_t result_inodes[256];
-    uint32_t count = 0;
-    int result = tagfs_query_single(&name_tag, result_inodes, &count, 256);
+    uint32_t count = tagfs_name_files(name, result_inodes, 256);
 
-    if (result != 0 || count == 0) {
+    if (count == 0) {
         return TAGFS_INVALID_INODE;  // Не найдено
     }
 
     // Фильтруем по контексту
+    Tag trash_tag = tagfs_tag_from_string("trashed:true");
     for (uint32_t i = 0; i < count; i++) {
         // Пропускаем удаленные файлы
-        Tag trash_tag = tagfs_tag_from_string("trashed:true");
         if (tagfs_file_has_tag(result_inodes[i], &trash_tag)) {
             continue;
         }
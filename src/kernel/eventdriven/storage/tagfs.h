@@ -3,6 +3,8 @@
 
 #include "klib.h"  // Для spinlock_t и других типов
 #include "../core/atomics.h"
+#include "bitmap_alloc.h"
+#include "tag_bitmap.h"
 
 // ============================================================================
 // TagFS - Tag-Based Filesystem для BoxOS
@@ -29,17 +31,32 @@
 // ============================================================================
 
 #define TAGFS_MAGIC             0x54414746535632  // "TAGFSV2"
-#define TAGFS_VERSION           2
+#define TAGFS_VERSION           4      // 4: tag IDs в inode (3: extents, мигрируется при mount;
+                                       // 2: block pointers - не мигрируется, mount отказывает)
 #define TAGFS_BLOCK_SIZE        4096
 
 #define TAGFS_MAX_TAGS_PER_FILE 32     // Максимум тегов на файл
 #define TAGFS_TAG_KEY_SIZE      32     // Размер ключа тега (например "type")
 #define TAGFS_TAG_VALUE_SIZE    64     // Размер значения тега (например "image")
-#define TAGFS_MAX_TAG_INDEX     1024   // Максимум уникальных тегов в индексе
+#define TAGFS_TAG_INDEX_INITIAL 64     // Начальная вместимость индекса тегов (растёт x2)
+#define TAGFS_TAGS_PER_BLOCK    (TAGFS_BLOCK_SIZE / sizeof(Tag))  // Записей tag dictionary в блоке
+#define TAGFS_TAG_INDEX_BUCKETS 128    // Начальное число hash buckets (степень 2, растёт x2)
+#define TAGFS_NAME_INDEX_SLOTS  256    // Начальные слоты name index (степень 2, растёт x2)
+#define TAGFS_POSTING_BLOCKS    16     // Хвост региона tag index под образ posting lists
+#define TAGFS_JOURNAL_BLOCKS    16     // Metadata journal между tag index и data region
+#define TAGFS_JOURNAL_MAGIC     0x4C4E524A53464754ULL  // "TGFSJRNL"
+#define TAGFS_JOURNAL_CHECKPOINT_AGE 100  // Clock ticks (~1s) до background checkpoint
+#define TAGFS_INVALID_TAG_ID    0
 
 #define TAGFS_MAX_FILES         65536  // Максимум файлов
 #define TAGFS_MAX_FILE_SIZE     (1ULL << 32)  // 4GB на файл
-#define TAGFS_INODE_SIZE        512    // Размер структуры FileInode на диске
+#define TAGFS_MAX_VOLUME_BLOCKS (1ULL << 23)  // 32GB том: block bitmap 1MB в heap
+#define TAGFS_INODE_SIZE        sizeof(FileInode)  // Размер FileInode на диске (не кратен блоку)
+#define TAGFS_MAX_EXTENTS       14     // Extents на файл (в месте бывших block pointers)
+#define TAGFS_INLINE_DATA_SIZE  (TAGFS_MAX_EXTENTS * 16)  // Байт данных в месте extents (224)
+
+// FileInode.flags
+#define TAGFS_INODE_INLINE      0x1    // Данные в inline_data, extent_count = 0
 
 #define TAGFS_INVALID_INODE     0
 
@@ -56,6 +73,13 @@ typedef struct {
 // FILE INODE - Метаданные файла
 // ============================================================================
 
+// Непрерывный run блоков данных. Extents идут в порядке файла:
+// логический блок i - в extent, где сумма длин предыдущих <= i
+typedef struct {
+    uint64_t start;                     // Первый физический блок
+    uint64_t length;                    // Блоков
+} TagFSExtent;
+
 typedef struct {
     uint64_t inode_id;                  // Уникальный ID файла (аналог inode number)
     uint64_t size;                      // Размер файла в байтах
@@ -63,35 +87,61 @@ typedef struct {
     uint64_t modification_time;         // Время последней модификации
 
     uint32_t tag_count;                 // Количество тегов
-    uint32_t flags;                     // Флаги (reserved)
-
-    Tag tags[TAGFS_MAX_TAGS_PER_FILE];  // Массив тегов
-
-    // Указатели на блоки данных (простая схема - для v1)
-    uint64_t direct_blocks[12];         // Прямые указатели (12 * 4KB = 48KB)
-    uint64_t indirect_block;            // Косвенный указатель (для файлов > 48KB)
-    uint64_t double_indirect_block;     // Двойная косвенность (для файлов > 2MB)
-
-    uint8_t padding[128];               // Padding до 512 байт
+    uint32_t flags;                     // TAGFS_INODE_*
+
+    uint32_t tag_ids[TAGFS_MAX_TAGS_PER_FILE];  // Tag IDs из tag dictionary (целые вместо строк)
+
+    // Данные: extents (start, length), выделяются best-fit целыми runs.
+    // Файл до TAGFS_INLINE_DATA_SIZE байт (TAGFS_INODE_INLINE) - прямо в
+    // inode: ни блока данных, ни лишнего I/O, на диск - вместе с metadata.
+    // Запись за пределы inline_data переносит данные в блок
+    uint32_t extent_count;
+    uint32_t reserved;
+    union {
+        TagFSExtent extents[TAGFS_MAX_EXTENTS];
+        uint8_t inline_data[TAGFS_INLINE_DATA_SIZE];
+    };
+
+    uint8_t padding[8];
 } FileInode;
 
 // ============================================================================
 // TAG INDEX - Индекс для быстрого поиска по тегам
 // ============================================================================
 
-// Entry в индексе тегов - список файлов с определенным тегом
+// Entry в индексе тегов - список файлов с определенным тегом.
+// Tag ID = позиция в entries + 1 = номер записи tag dictionary на диске
+// (блоки tag_index_block..data_blocks_start). Inodes хранят ID, поэтому
+// entries не удаляются и не перенумеровываются (rebuild чистит только списки).
+// Posting list - отсортированный inode_ids, а с TAGFS_POSTING_BITMAP_MIN
+// файлов - TagBitmap (OR / NOT по containers, а не по ID)
+#define TAGFS_POSTING_BITMAP_MIN    256
+
 typedef struct {
     Tag tag;                            // Тег (key:value)
+    uint32_t hash;                      // FNV-1a по key:value (сравнение до strcmp)
+    uint32_t next;                      // Следующий tag ID в bucket, 0 = конец
     uint32_t file_count;                // Количество файлов с этим тегом
     uint32_t capacity;                  // Вместимость массива
     uint64_t* inode_ids;                // Массив ID файлов с этим тегом (динамический)
+    TagBitmap* bitmap;                  // != NULL - список здесь, inode_ids = NULL
 } TagIndexEntry;
 
-// Глобальный индекс тегов
+// Глобальный индекс тегов - hash dictionary key:value → tag ID
 typedef struct {
     uint32_t entry_count;               // Количество уникальных тегов
-    uint32_t capacity;                  // Вместимость массива
-    TagIndexEntry entries[TAGFS_MAX_TAG_INDEX];  // Массив индексов
+    uint32_t capacity;                  // Вместимость entries
+    TagIndexEntry* entries;             // kmalloc, растёт x2
+    uint32_t* buckets;                  // Первый tag ID цепочки, 0 = пусто
+    uint32_t bucket_count;              // Степень 2, растёт при entry_count > bucket_count
+    TagBitmap files;                    // Все живые inode ID (база для NOT)
+
+    // Name index: value → tag ID тегов name:*, open addressing по FNV-1a
+    // value. Entries не удаляются - слоты тоже, файл берётся из posting list
+    uint32_t* name_slots;               // Tag ID, 0 = пусто
+    uint32_t name_slot_count;           // Степень 2, заполнено не больше половины
+    uint32_t name_count;                // Занятых слотов
+    uint32_t name_overflow;             // name:* entries вне слотов (нет памяти) - промах проверяет dictionary
 } TagIndex;
 
 // ============================================================================
@@ -115,9 +165,43 @@ typedef struct {
 
     uint64_t root_flags;                // Флаги корня ФС
 
-    uint8_t padding[4000];              // Padding до 4096 байт
+    uint64_t tag_count;                 // Записей tag dictionary (с tag_index_block)
+
+    // Образ posting lists [posting_block, +posting_blocks) - dictionary до
+    // posting_block. posting_block = 0 (том до образа) - dictionary до
+    // data_blocks_start, списки - rebuild при mount
+    uint64_t posting_block;
+    uint64_t posting_blocks;
+    uint64_t posting_size;              // Байт образа, 0 = не записан / не влез
+    uint32_t posting_tags;              // Tag IDs в образе (tag_count на момент записи)
+    uint32_t posting_crc;               // CRC32C образа
+
+    // Write-ahead journal metadata [journal_block, +journal_blocks), 0 = нет
+    // (том до журнала - sync пишет блоки на место напрямую). Recovery
+    // начинает с транзакции journal_sequence, checkpoint его сдвигает
+    uint64_t journal_block;
+    uint64_t journal_blocks;
+    uint64_t journal_sequence;
+
+    uint8_t padding[3936];              // Padding до 4096 байт
 } TagFSSuperblock;
 
+// ============================================================================
+// JOURNAL TRANSACTION - заголовок, за ним block_count образов блоков metadata
+// ============================================================================
+//
+// Транзакция - один последовательный write: [заголовок][образ 1]..[образ N].
+// Отдельного commit блока нет: CRC32C по заголовку и всем образам - оборванная
+// запись не проходит проверку и не проигрывается.
+
+typedef struct {
+    uint64_t magic;                     // TAGFS_JOURNAL_MAGIC
+    uint64_t sequence;                  // Подряд с journal_sequence superblock
+    uint32_t block_count;               // Образов за заголовком
+    uint32_t crc;                       // CRC32C заголовка (crc = 0) и образов
+    uint64_t blocks[(TAGFS_BLOCK_SIZE - 24) / sizeof(uint64_t)];  // Home блок каждого образа
+} TagFSJournalHeader;
+
 // ============================================================================
 // USER CONTEXT - Контекст пользователя для фильтрации файлов
 // ============================================================================
@@ -131,10 +215,18 @@ typedef struct {
 
 #define TAGFS_MAX_CONTEXT_TAGS 16
 
+// Materialized view: файлы не в корзине и со всеми тегами контекста
+// (контекст выключен - все не в корзине). Считается при set / clear и
+// rebuild индекса, дальше поддерживается по изменениям posting lists -
+// список файлов контекста за O(результата). Под index_lock
 typedef struct {
     Tag tags[TAGFS_MAX_CONTEXT_TAGS];   // Теги контекста
     uint32_t tag_count;                  // Количество тегов в контексте
     bool enabled;                        // Включен ли контекст
+
+    uint32_t tag_ids[TAGFS_MAX_CONTEXT_TAGS];  // 0 = тега ещё нет в dictionary
+    uint32_t trash_id;                   // trashed:true, 0 = ещё нет
+    TagBitmap view;                      // Inode IDs результата
 } TagFSUserContext;
 
 // ============================================================================
@@ -147,21 +239,37 @@ typedef struct {
     TagIndex tag_index;                 // Индекс тегов в памяти
 
     uint8_t* block_bitmap;              // Bitmap занятых блоков (для аллокации)
-    uint8_t* inode_bitmap;              // Bitmap занятых inodes
+    uint8_t* inode_bitmap;              // Bitmap занятых inodes (бит = слот inode_table)
+    BitmapAlloc block_alloc;            // Поиск по block_bitmap (64 бита за шаг)
+    BitmapAlloc inode_alloc;            // Поиск по inode_bitmap
+    uint64_t inode_hint;                // Следующий слот для поиска свободного inode
 
     volatile uint64_t next_inode_id;    // Счётчик для генерации inode ID
+    int posting_dirty;                  // Списки менялись после записи образа
+
+    uint64_t journal_head;              // Следующий свободный блок журнала (от journal_block)
+    uint64_t journal_sequence;          // Sequence следующей транзакции
+    uint64_t journal_first_tick;        // Первый commit после checkpoint (для idle checkpoint)
 
-    spinlock_t lock;                    // Spinlock для синхронизации доступа
+    // Locks (порядок взятия сверху вниз, см. LOCKING в tagfs.c). Inode locks -
+    // отдельная таблица по слоту inode_table
+    rwlock_t commit_lock;               // read - изменение metadata, write - commit / checkpoint
+    rwlock_t index_lock;                // Tag dictionary, posting lists, files
+    spinlock_t alloc_lock;              // Block / inode bitmaps, счётчики superblock
 
-    // User Context для фильтрации (NEW!)
+    // User Context для фильтрации (NEW!) - под index_lock
     TagFSUserContext user_context;      // Текущий контекст пользователя
 
     // Статистика
     volatile uint64_t files_created;
     volatile uint64_t files_deleted;
     volatile uint64_t queries_executed;
+    volatile uint64_t name_lookups;
     volatile uint64_t tags_added;
     volatile uint64_t tags_removed;
+    volatile uint64_t journal_commits;
+    volatile uint64_t journal_blocks_logged;
+    volatile uint64_t journal_checkpoints;
 } TagFSContext;
 
 // ============================================================================
@@ -171,7 +279,7 @@ typedef struct {
 typedef enum {
     QUERY_OP_AND,    // Все теги должны совпадать
     QUERY_OP_OR,     // Хотя бы один тег должен совпадать
-    QUERY_OP_NOT,    // Исключить файлы с тегом
+    QUERY_OP_NOT,    // Файлы без всех перечисленных тегов
 } QueryOperator;
 
 typedef struct {
@@ -199,9 +307,19 @@ void tagfs_format(uint64_t total_blocks);  // Форматирование но
 // Включить режим работы с диском (0 = память, 1 = диск)
 void tagfs_set_disk_mode(int enable);
 
-// Синхронизировать всю ФС на диск
+// Синхронизировать всю ФС на диск: commit + checkpoint (журнал пуст,
+// все блоки metadata на месте)
 int tagfs_sync(void);
 
+// Group commit: dirty data blocks, затем все изменения metadata с прошлого
+// commit - одной транзакцией журнала. Durable, но блоки на место - позже
+// (checkpoint). 0 = успех, -1 = ошибка записи
+int tagfs_commit(void);
+
+// Background checkpoint из idle прохода Storage Deck: журнал старше
+// TAGFS_JOURNAL_CHECKPOINT_AGE или заполнен наполовину. Lock занят - пропуск
+void tagfs_checkpoint_idle(void);
+
 // Синхронизировать superblock на диск
 int tagfs_sync_superblock(void);
 
@@ -237,6 +355,16 @@ int tagfs_restore_file(uint64_t inode_id);
 // Чтение данных файла
 int tagfs_read_file(uint64_t inode_id, uint64_t offset, uint8_t* buffer, uint64_t size);
 
+// Read-ahead: блоки [offset, offset + size) файла в block cache (disk mode).
+// Возвращает блоков прочитано с диска (0 = всё уже в cache), -1 = нет файла
+int tagfs_readahead(uint64_t inode_id, uint64_t offset, uint64_t size);
+
+// То же без ожидания (block_cache_fetch_async): возвращает отправленных ATA
+// команд, done(context, status) придёт на каждую из ata_async_reap().
+// 0 = ждать нечего, -1 = async недоступен (memory mode это 0) / нет файла
+int tagfs_fetch_async(uint64_t inode_id, uint64_t offset, uint64_t size,
+                      void (*done)(void* context, int status), void* context);
+
 // Запись данных в файл
 int tagfs_write_file(uint64_t inode_id, uint64_t offset, const uint8_t* buffer, uint64_t size);
 
@@ -246,7 +374,8 @@ uint8_t* tagfs_read_file_content(uint64_t inode_id, uint64_t* size_out);
 // Записать весь контент файла (удобная обертка)
 int tagfs_write_file_content(uint64_t inode_id, const uint8_t* data, uint64_t size);
 
-// Получить метаданные файла
+// Получить метаданные файла. Без lock - поля читаются как есть, запись
+// в файл может менять их параллельно
 FileInode* tagfs_get_inode(uint64_t inode_id);
 
 // ============================================================================
@@ -281,10 +410,16 @@ int tagfs_find_not_trashed(uint64_t* result_inodes, uint32_t* count_out, uint32_
 // TAG INDEX MANAGEMENT
 // ============================================================================
 
+// Берут commit_lock и index_lock сами - не вызывать под locks TagFS
 void tagfs_index_add_file(uint64_t inode_id, const Tag* tags, uint32_t tag_count);
 void tagfs_index_remove_file(uint64_t inode_id);
 void tagfs_index_rebuild(void);  // Пересборка индекса (если повреждён)
 
+// Tag ID для key:value: lookup - TAGFS_INVALID_TAG_ID если тега нет,
+// intern - создаёт entry при необходимости (TAGFS_INVALID_TAG_ID = нет памяти)
+uint32_t tagfs_tag_lookup(const Tag* tag);
+uint32_t tagfs_tag_intern(const Tag* tag);
+
 // ============================================================================
 // USER CONTEXT OPERATIONS (NEW!)
 // ============================================================================
@@ -322,6 +457,10 @@ int tagfs_file_has_tag(uint64_t inode_id, const Tag* tag);
 // Найти файл по имени (тегу name:xxx) в текущем контексте
 uint64_t tagfs_find_by_name(const char* name);
 
+// Файл с тегом name:name (наименьший inode ID) через name index, без учёта
+// контекста и корзины. TAGFS_INVALID_INODE - нет такого
+uint64_t tagfs_lookup_name(const char* name);
+
 // ============================================================================
 // STATISTICS & DEBUGGING
 // ============================================================================
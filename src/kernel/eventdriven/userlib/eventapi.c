@@ -8,11 +8,23 @@
 static EventRingBuffer* to_kernel_ring = 0;
 static ResponseRingBuffer* from_kernel_ring = 0;
 
-// Локальный кэш ответов (простая реализация)
-// Уменьшено для экономии памяти (Response = 4KB, 32 * 4KB = 128KB)
-#define RESPONSE_CACHE_SIZE 32
-static Response response_cache[RESPONSE_CACHE_SIZE];
-static int response_cache_valid[RESPONSE_CACHE_SIZE];
+// Индекс ответов: event_id -> позиция в ResponseRingBuffer.
+// Ответы НЕ копируются (Response = 4KB) - остаются в ring, пока их не
+// заберут. Open addressing + linear probing, размер = 2x глубины ring
+// (load factor <= 0.5), удаление backward shift - без tombstones.
+#define RESPONSE_INDEX_SIZE (RING_BUFFER_SIZE * 2)
+#define RESPONSE_INDEX_MASK (RESPONSE_INDEX_SIZE - 1)
+
+typedef struct {
+    uint64_t event_id;        // 0 = пусто
+    uint64_t pos;             // Позиция в ring (не индекс слота)
+} ResponseIndexEntry;
+
+static ResponseIndexEntry response_index[RESPONSE_INDEX_SIZE];
+static uint8_t response_taken[RING_BUFFER_SIZE];   // Слот забран, head может пройти
+static uint64_t response_scan = 0;                 // Первая ещё не индексированная позиция
+static uint64_t response_last = 0;                 // Последний отданный ответ + 1 (0 = нет)
+static int response_pending = 0;                   // Индексированы, но не забраны
 
 // PID текущего процесса (для заполнения событий)
 static uint64_t current_user_id = 1;  // TODO: получать реальный PID
@@ -25,10 +37,12 @@ void eventapi_init(EventRingBuffer* to_kernel, ResponseRingBuffer* from_kernel)
     to_kernel_ring = to_kernel;
     from_kernel_ring = from_kernel;
 
-    // Очищаем кэш ответов
-    for (int i = 0; i < RESPONSE_CACHE_SIZE; i++) {
-        response_cache_valid[i] = 0;
-    }
+    // Очищаем индекс ответов
+    memset(response_index, 0, sizeof(response_index));
+    memset(response_taken, 0, sizeof(response_taken));
+    response_scan = from_kernel ? atomic_load_u64(&from_kernel->head) : 0;
+    response_last = 0;
+    response_pending = 0;
 
     kprintf("[EVENTAPI] Initialized (user_id=%lu)\n", current_user_id);
 }
@@ -43,8 +57,11 @@ uint64_t eventapi_submit_event(Event* event) {
         return 0;
     }
 
-    // Заполняем метаданные
-    event->id = 0;  // ВАЖНО! User НЕ устанавливает ID
+    // Event API линкуется в kernel - id берём из того же счётчика, что и
+    // ingest EventRing, заранее: consumer ненулевой id сохраняет
+    // (routing_table_add_workflow_event), ответ придёт с ним же
+    extern volatile uint64_t global_event_id_counter;
+    event->id = atomic_increment_u64(&global_event_id_counter);
     event->user_id = current_user_id;
     event->timestamp = 0;  // Kernel установит timestamp
 
@@ -54,12 +71,7 @@ uint64_t eventapi_submit_event(Event* event) {
         cpu_pause();
     }
 
-    // NOTE: Мы НЕ ЗНАЕМ ID события! Kernel его установит.
-    // В реальной системе нужен механизм получения ID обратно.
-    // Сейчас для простоты возвращаем фиктивный ID.
-
-    // TODO: правильная синхронизация для получения реального ID
-    return 0;  // Placeholder
+    return event->id;
 }
 
 // ============================================================================
@@ -151,33 +163,80 @@ uint64_t eventapi_file_write(int fd, const void* data, uint64_t size) {
 // RESPONSE POLLING
 // ============================================================================
 
+static void response_index_insert(uint64_t event_id, uint64_t pos) {
+    uint32_t h = event_id & RESPONSE_INDEX_MASK;
+    while (response_index[h].event_id != 0) {
+        h = (h + 1) & RESPONSE_INDEX_MASK;
+    }
+    response_index[h].event_id = event_id;
+    response_index[h].pos = pos;
+}
+
+// Найти и удалить. 0 = нет, иначе позиция + 1
+static uint64_t response_index_take(uint64_t event_id) {
+    uint32_t h = event_id & RESPONSE_INDEX_MASK;
+    while (response_index[h].event_id != event_id) {
+        if (response_index[h].event_id == 0) {
+            return 0;
+        }
+        h = (h + 1) & RESPONSE_INDEX_MASK;
+    }
+    uint64_t pos = response_index[h].pos;
+
+    // Backward shift: подтягиваем записи, чья цепочка проходила через h
+    uint32_t hole = h;
+    for (uint32_t next = (h + 1) & RESPONSE_INDEX_MASK; response_index[next].event_id != 0;
+         next = (next + 1) & RESPONSE_INDEX_MASK) {
+        uint32_t home = response_index[next].event_id & RESPONSE_INDEX_MASK;
+        if (((next - home) & RESPONSE_INDEX_MASK) >= ((next - hole) & RESPONSE_INDEX_MASK)) {
+            response_index[hole] = response_index[next];
+            hole = next;
+        }
+    }
+    response_index[hole].event_id = 0;
+    return pos + 1;
+}
+
+// Вернуть kernel слоты, забранные подряд от head
+static void response_release_taken(void) {
+    uint64_t head = atomic_load_u64(&from_kernel_ring->head);
+    while (head != response_scan && response_taken[head & RING_BUFFER_MASK]) {
+        response_taken[head & RING_BUFFER_MASK] = 0;
+        head++;
+    }
+    COMPILER_BARRIER();
+    atomic_store_u64(&from_kernel_ring->head, head);
+}
+
 Response* eventapi_poll_response(uint64_t event_id) {
-    if (!from_kernel_ring) {
+    if (!from_kernel_ring || event_id == 0) {
         return 0;
     }
 
-    // Проверяем кэш
-    int cache_index = event_id % RESPONSE_CACHE_SIZE;
-    if (response_cache_valid[cache_index] &&
-        response_cache[cache_index].event_id == event_id) {
-        return &response_cache[cache_index];
+    // Прошлый отданный ответ больше не нужен вызывающему - слот можно вернуть
+    if (response_last) {
+        response_taken[(response_last - 1) & RING_BUFFER_MASK] = 1;
+        response_last = 0;
+        response_release_taken();
     }
 
-    // Проверяем ring buffer
-    Response temp;
-    while (response_ring_pop(from_kernel_ring, &temp)) {
-        // Сохраняем в кэш
-        int idx = temp.event_id % RESPONSE_CACHE_SIZE;
-        response_cache[idx] = temp;
-        response_cache_valid[idx] = 1;
-
-        // Если это тот ответ, что мы ищем
-        if (temp.event_id == event_id) {
-            return &response_cache[idx];
-        }
+    // Индексируем новые ответы (каждый ровно один раз)
+    uint64_t tail = atomic_load_u64(&from_kernel_ring->tail);
+    while (response_scan != tail) {
+        Response* slot = &from_kernel_ring->responses[response_scan & RING_BUFFER_MASK];
+        response_index_insert(slot->event_id, response_scan);
+        response_pending++;
+        response_scan++;
     }
 
-    return 0;  // Ответ ещё не готов
+    uint64_t found = response_index_take(event_id);
+    if (!found) {
+        return 0;  // Ответ ещё не готов
+    }
+
+    response_pending--;
+    response_last = found;
+    return &from_kernel_ring->responses[(found - 1) & RING_BUFFER_MASK];
 }
 
 Response* eventapi_wait_response(uint64_t event_id) {
@@ -194,12 +253,6 @@ Response* eventapi_wait_response(uint64_t event_id) {
 // ============================================================================
 
 int eventapi_pending_count(void) {
-    // Подсчитываем valid entries в кэше
-    int count = 0;
-    for (int i = 0; i < RESPONSE_CACHE_SIZE; i++) {
-        if (response_cache_valid[i]) {
-            count++;
-        }
-    }
-    return count;
+    // Ответы в ring, которые ещё никто не забрал
+    return response_pending;
 }
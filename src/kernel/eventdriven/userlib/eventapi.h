@@ -50,15 +50,16 @@ uint64_t eventapi_file_close(int fd);
 uint64_t eventapi_file_read(int fd, uint64_t size);
 uint64_t eventapi_file_write(int fd, const void* data, uint64_t size);
 
-// Generic event submission
+// Generic event submission. Возвращает назначенный event_id (ответ придёт с ним)
 uint64_t eventapi_submit_event(Event* event);
 
 // ============================================================================
 // RESPONSE POLLING - Проверка результатов
 // ============================================================================
 
-// Проверяет наличие ответа для данного event_id
-// Возвращает NULL если ответ ещё не готов
+// Проверяет наличие ответа для данного event_id - O(1), ответы в любом порядке
+// Возвращает NULL если ответ ещё не готов. Указатель - прямо в слот ring,
+// действителен до следующего eventapi_poll_response / eventapi_wait_response
 Response* eventapi_poll_response(uint64_t event_id);
 
 // Ждёт ответа (blocking!) - НЕ РЕКОМЕНДУЕТСЯ
@@ -68,7 +69,7 @@ Response* eventapi_wait_response(uint64_t event_id);
 // HELPERS
 // ============================================================================
 
-// Возвращает количество pending событий
+// Возвращает количество пришедших, но ещё не забранных ответов
 int eventapi_pending_count(void);
 
 #endif // EVENTAPI_H
@@ -2,6 +2,25 @@
 #include "klib.h"
 #include "routing_table.h"
 #include "workflow_rings.h"  // For RingEvent structure
+#include "process.h"         // process_find_by_pid() - получатель результатов
+#include "latency_stats.h"   // История задержек по EventType (critical path)
+#include "result_buffer.h"   // Результаты nodes (zero-copy input successors)
+#include "operations_cipher.h"  // Ключи в payload nodes: cache schedules, wipe
+
+// ready_mask - один бит на node
+_Static_assert(WORKFLOW_MAX_EVENTS <= 32, "ready_mask holds one bit per workflow node");
+
+// Node index - младшие 8 бит workflow_tag
+_Static_assert(WORKFLOW_MAX_EVENTS <= 256, "workflow_tag holds node index in 8 bits");
+
+// Стоимость node без истории задержек (когда нет ни одного измерения в workflow)
+#define WORKFLOW_DEFAULT_NODE_COST 1
+
+// Завершённый instance живёт для чтения результата (~1 секунда при 2.4GHz)
+#define WORKFLOW_INSTANCE_RETAIN_CYCLES 2400000000ULL
+
+// Каждая N-я активация подбирает просроченные instances (без отдельного таймера)
+#define WORKFLOW_CLEANUP_INTERVAL 64
 
 // ============================================================================
 // GLOBAL STATE
@@ -9,6 +28,9 @@
 
 static WorkflowRegistry registry;
 
+// Fused successors с прошлого workflow_take_fused() (все шаблоны)
+static volatile uint64_t workflow_fused_pending = 0;
+
 // External reference to global routing table
 extern RoutingTable global_routing_table;
 extern uint64_t global_event_id_counter;  // For assigning unique event IDs
@@ -26,15 +48,89 @@ void workflow_engine_init(void) {
 
     kprintf("[WORKFLOW] Setting next_workflow_id...\n");
     registry.next_workflow_id = 1;  // Start from 1 (0 = invalid)
+    registry.next_instance_id = 0;  // Первый instance_id = 1 (0 = invalid)
 
     kprintf("[WORKFLOW] Initializing spinlock...\n");
     spinlock_init(&registry.lock);
 
     kprintf("[WORKFLOW] Engine initialized\n");
-    kprintf("[WORKFLOW] Workflows: UNLIMITED (linked list, allocated on-demand)\n");
+    kprintf("[WORKFLOW] Workflows: UNLIMITED (hash registry, %d buckets, allocated on-demand)\n",
+            WORKFLOW_REGISTRY_BUCKETS);
+    kprintf("[WORKFLOW] Instances: UNLIMITED (%d buckets, %lu bytes each)\n",
+            WORKFLOW_INSTANCE_BUCKETS, sizeof(WorkflowInstance));
     kprintf("[WORKFLOW] Max events per workflow: %d\n", WORKFLOW_MAX_EVENTS);
 }
 
+// ============================================================================
+// REGISTRY HASH TABLES
+// ============================================================================
+
+static inline Workflow** workflow_bucket(uint64_t workflow_id) {
+    return &registry.buckets[workflow_id & (WORKFLOW_REGISTRY_BUCKETS - 1)];
+}
+
+static inline WorkflowInstance** workflow_instance_bucket(uint64_t instance_id) {
+    return &registry.instances[instance_id & (WORKFLOW_INSTANCE_BUCKETS - 1)];
+}
+
+// Вызывать под registry.lock
+static WorkflowInstance* workflow_instance_find_locked(uint64_t instance_id) {
+    WorkflowInstance* current = *workflow_instance_bucket(instance_id);
+    while (current) {
+        if (current->instance_id == instance_id) {
+            return current;
+        }
+        current = current->next;
+    }
+    return NULL;
+}
+
+// ============================================================================
+// NODE RESULTS
+// ============================================================================
+
+// Освободить результат node по его типу (VALUE/STATIC - не память)
+static void workflow_node_release_result(WorkflowNodeState* node) {
+    if (node->result) {
+        if (node->result_type == RESULT_TYPE_BUFFER) {
+            result_buffer_release((ResultBuffer*)node->result);
+        } else if (node->result_type == RESULT_TYPE_KMALLOC) {
+            kfree(node->result);
+        }
+    }
+
+    node->result = 0;
+    node->result_size = 0;
+    node->result_type = RESULT_TYPE_NONE;
+}
+
+// Instance уже вынут из таблицы: результаты nodes + final_result + сам instance
+static void workflow_instance_free(WorkflowInstance* instance) {
+    // Лимит процесса (pid проверяет find - слот таблицы мог переиспользоваться)
+    process_t* owner = instance->owner_pid ? process_find_by_pid(instance->owner_pid) : NULL;
+    if (owner && atomic_load_u64(&owner->workflow_instances) > 0) {
+        atomic_decrement_u64(&owner->workflow_instances);
+    }
+
+    for (uint32_t i = 0; i < WORKFLOW_MAX_EVENTS; i++) {
+        workflow_node_release_result(&instance->nodes[i]);
+    }
+    if (instance->context.final_result) {
+        kfree(instance->context.final_result);
+    }
+    cipher_wipe(instance->params, sizeof(instance->params));
+    kfree(instance);
+}
+
+// Шаблон уже вынут из таблицы (или не попал в неё). Payload nodes может
+// нести ключи (EVENT_OP_ENCRYPT / DECRYPT) - в heap они не остаются
+static void workflow_template_free(Workflow* workflow) {
+    for (uint32_t i = 0; i < workflow->event_count; i++) {
+        cipher_wipe(workflow->events[i].data, sizeof(workflow->events[i].data));
+    }
+    kfree(workflow);
+}
+
 // ============================================================================
 // WORKFLOW REGISTRATION
 // ============================================================================
@@ -57,11 +153,6 @@ uint64_t workflow_register(const char* name,
     }
     memset(workflow, 0, sizeof(Workflow));
 
-    spin_lock(&registry.lock);
-
-    // Set identity
-    workflow->workflow_id = atomic_increment_u64(&registry.next_workflow_id);
-
     int i = 0;
     while (name[i] && i < WORKFLOW_NAME_MAX - 1) {
         workflow->name[i] = name[i];
@@ -76,15 +167,10 @@ uint64_t workflow_register(const char* name,
         workflow->route[j] = route[j];
     }
 
-    // Copy DAG
+    // Copy DAG (шаблон: дальше только читается)
     workflow->event_count = event_count;
     for (uint32_t j = 0; j < event_count; j++) {
         workflow->events[j] = events[j];
-        workflow->events[j].ready = 0;
-        workflow->events[j].completed = 0;
-        workflow->events[j].error = 0;
-        workflow->events[j].event_id = 0;
-        workflow->events[j].result = 0;
     }
 
     // Set state
@@ -93,8 +179,18 @@ uint64_t workflow_register(const char* name,
     workflow->activation_count = 0;
     workflow->total_execution_time = 0;
 
-    // Analyze DAG for optimization
-    workflow_analyze_dag(workflow);
+    // Set identity
+    workflow->workflow_id = atomic_increment_u64(&registry.next_workflow_id);
+
+    // Validate + compile DAG: циклический граф никогда не завершится
+    // (до lock - шаблон ещё никому не виден)
+    if (workflow_analyze_dag(workflow) != 0) {
+        kprintf("[WORKFLOW] ERROR: Workflow '%s' rejected - invalid DAG\n", name);
+        workflow_template_free(workflow);
+        return 0;
+    }
+
+    workflow->priority = EVENT_PRIORITY_NORMAL;
 
     // Set default error handling configuration
     workflow->error_policy = ERROR_POLICY_ABORT;  // Default: abort on error
@@ -103,9 +199,14 @@ uint64_t workflow_register(const char* name,
     workflow->retry_config.base_delay_ms = 100;    // 100ms base delay
     workflow->retry_config.exponential_backoff = 1; // Use exponential backoff
 
-    // DYNAMIC WORKFLOW REGISTRY: Add to head of linked list (O(1) insertion)
-    workflow->next = registry.head;
-    registry.head = workflow;
+    spin_lock(&registry.lock);
+
+    // Add to head of bucket chain (O(1) insertion).
+    // CRITICAL: шаблон полностью заполнен до публикации - workflow_get без lock
+    Workflow** bucket = workflow_bucket(workflow->workflow_id);
+    workflow->next = *bucket;
+    MEMORY_BARRIER();
+    *bucket = workflow;
     registry.workflow_count++;
 
     spin_unlock(&registry.lock);
@@ -120,46 +221,59 @@ uint64_t workflow_register(const char* name,
 int workflow_unregister(uint64_t workflow_id) {
     spin_lock(&registry.lock);
 
-    // DYNAMIC WORKFLOW REGISTRY: Walk linked list to find and remove
-    Workflow* current = registry.head;
-    Workflow* prev = NULL;
-
-    while (current) {
+    Workflow** link = workflow_bucket(workflow_id);
+    while (*link) {
+        Workflow* current = *link;
         if (current->workflow_id == workflow_id) {
-            // Found - remove from list
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                registry.head = current->next;
+            // Instances ссылаются на шаблон - сначала они должны завершиться
+            if (atomic_load_u64(&current->active_instances) > 0) {
+                spin_unlock(&registry.lock);
+                kprintf("[WORKFLOW] ERROR: Workflow ID=%lu has %lu active instance(s)\n",
+                        workflow_id, current->active_instances);
+                return -2;
             }
 
-            registry.workflow_count--;
-            spin_unlock(&registry.lock);
-
-            // Clean up execution context if exists
-            if (current->context) {
-                if (current->context->final_result) {
-                    kfree(current->context->final_result);
+            // Завершённые instances (ждут cleanup) тоже держат указатель -
+            // переносим их в локальный список через тот же next
+            WorkflowInstance* finished = NULL;
+            for (uint32_t b = 0; b < WORKFLOW_INSTANCE_BUCKETS; b++) {
+                WorkflowInstance** inst_link = &registry.instances[b];
+                while (*inst_link) {
+                    WorkflowInstance* inst = *inst_link;
+                    if (inst->workflow == current) {
+                        *inst_link = inst->next;
+                        registry.instance_count--;
+                        inst->next = finished;
+                        finished = inst;
+                        continue;
+                    }
+                    inst_link = &inst->next;
                 }
-                kfree(current->context);
             }
 
-            // Clean up event results
-            for (uint32_t j = 0; j < current->event_count; j++) {
-                if (current->events[j].result) {
-                    kfree(current->events[j].result);
-                }
+            // Found - remove from chain
+            *link = current->next;
+            registry.workflow_count--;
+            spin_unlock(&registry.lock);
+
+            // Clean up finished instances (results of their nodes)
+            while (finished) {
+                WorkflowInstance* next = finished->next;
+                workflow_instance_free(finished);
+                finished = next;
             }
 
             // CRITICAL: Free the workflow itself
-            kfree(current);
+            workflow_template_free(current);
+
+            // Кешированные key schedules workflow не переживают его
+            cipher_key_flush_workflow(workflow_id);
 
             kprintf("[WORKFLOW] Unregistered workflow ID=%lu\n", workflow_id);
             return 0;
         }
 
-        prev = current;
-        current = current->next;
+        link = &current->next;
     }
 
     spin_unlock(&registry.lock);
@@ -168,8 +282,8 @@ int workflow_unregister(uint64_t workflow_id) {
 }
 
 Workflow* workflow_get(uint64_t workflow_id) {
-    // DYNAMIC WORKFLOW REGISTRY: Walk linked list to find workflow
-    Workflow* current = registry.head;
+    // O(1): bucket = id & mask, короткая цепочка
+    Workflow* current = *workflow_bucket(workflow_id);
     while (current) {
         if (current->workflow_id == workflow_id) {
             return current;
@@ -179,14 +293,57 @@ Workflow* workflow_get(uint64_t workflow_id) {
     return NULL;
 }
 
+int workflow_set_priority(uint64_t workflow_id, uint8_t priority) {
+    Workflow* workflow = workflow_get(workflow_id);
+    if (!workflow || priority >= EVENT_PRIORITY_CLASSES) {
+        return -1;
+    }
+
+    // Nodes в полёте остаются в своих lanes - класс читает следующий submit
+    workflow->priority = priority;
+    kprintf("[WORKFLOW] Workflow ID=%lu priority: %s\n", workflow_id, event_priority_name(priority));
+    return 0;
+}
+
+int workflow_set_prefetch(uint64_t workflow_id, int enabled) {
+    Workflow* workflow = workflow_get(workflow_id);
+    if (!workflow) {
+        return -1;
+    }
+
+    workflow->prefetch_enabled = enabled ? 1 : 0;
+    return 0;
+}
+
+WorkflowInstance* workflow_instance_get(uint64_t instance_id) {
+    spin_lock(&registry.lock);
+    WorkflowInstance* instance = workflow_instance_find_locked(instance_id);
+    spin_unlock(&registry.lock);
+    return instance;
+}
+
 // ============================================================================
 // HELPER FUNCTIONS
 // ============================================================================
 
+// Payload node: параметры активации заменяют data node 0
+static const uint8_t* workflow_node_payload(WorkflowInstance* instance, uint32_t event_index,
+                                            uint64_t* size) {
+    WorkflowNode* node = &instance->workflow->events[event_index];
+
+    if (event_index == 0 && instance->param_size > 0) {
+        *size = instance->param_size;
+        return instance->params;
+    }
+    *size = node->data_size;
+    return node->data;
+}
+
 // Submit a single WorkflowNode as RingEvent to the event-driven system
 // Returns: event_id on success, 0 on failure
-static uint64_t workflow_submit_event(Workflow* workflow, uint32_t event_index) {
-    if (!workflow || event_index >= workflow->event_count) {
+static uint64_t workflow_submit_event(WorkflowInstance* instance, uint32_t event_index) {
+    Workflow* workflow = instance->workflow;
+    if (event_index >= workflow->event_count) {
         return 0;
     }
 
@@ -201,14 +358,18 @@ static uint64_t workflow_submit_event(Workflow* workflow, uint32_t event_index)
     ring_event.workflow_id = workflow->workflow_id;
     ring_event.type = node->type;
     ring_event.timestamp = 0;  // Will be assigned by kernel
+    ring_event.priority = workflow->priority;
 
-    // Copy routing path from workflow
+    // Copy routing path: свой маршрут node или общий маршрут workflow
+    const uint8_t* route = node->route[0] != DECK_PREFIX_NONE ? node->route : workflow->route;
     for (int i = 0; i < MAX_ROUTING_STEPS; i++) {
-        ring_event.route[i] = workflow->route[i];
+        ring_event.route[i] = route[i];
     }
 
-    // Copy payload from WorkflowNode
-    uint64_t copy_size = node->data_size;
+    // Copy payload from WorkflowNode (параметры активации - вместо data node 0)
+    uint64_t copy_size;
+    const uint8_t* data = workflow_node_payload(instance, event_index, &copy_size);
+
     if (copy_size > EVENT_PAYLOAD_SIZE) {
         kprintf("[WORKFLOW] WARNING: Event %u data size %lu exceeds payload limit %d, truncating\n",
                 event_index, copy_size, EVENT_PAYLOAD_SIZE);
@@ -216,185 +377,607 @@ static uint64_t workflow_submit_event(Workflow* workflow, uint32_t event_index)
     }
 
     if (copy_size > 0) {
-        memcpy(ring_event.payload, node->data, copy_size);
+        memcpy(ring_event.payload, data, copy_size);
     }
     ring_event.payload_size = copy_size;
 
+    if (node->flags & WORKFLOW_NODE_FLAG_MEMOIZE) {
+        ring_event.buf_flags |= RING_EVENT_MEMOIZE;
+    }
+
+    // ZERO-COPY: результат первой зависимости - input события (entry retain'ит его)
+    ResultBuffer* input = 0;
+    if ((node->flags & WORKFLOW_NODE_FLAG_INPUT_FROM_DEP) && node->dependency_count > 0) {
+        WorkflowNodeState* dep = &instance->nodes[node->dependencies[0]];
+        if (dep->result_type == RESULT_TYPE_BUFFER && dep->result) {
+            input = (ResultBuffer*)dep->result;
+            result_buffer_note_consumed();
+        } else {
+            kprintf("[WORKFLOW] %[W]Event %u: dependency %u has no result buffer - using payload%[D]\n",
+                    event_index, node->dependencies[0]);
+        }
+    }
+
     // Submit to routing table (this creates RoutingEntry and starts processing!)
-    // routing_table_add_event() will assign unique event_id
-    int result = routing_table_add_event(&global_routing_table, &ring_event);
+    // routing_table_add_workflow_event() will assign unique event_id
+    // Результат - процессу-владельцу instance (owner_pid = 0 → kernel workflow)
+    process_t* owner = instance->owner_pid ? process_find_by_pid(instance->owner_pid) : NULL;
+
+    // CRITICAL: владелец умер - без owner результат ушёл бы текущему
+    // процессу (execution_resolve_owner), т.е. чужому. Node не запускаем
+    if (instance->owner_pid && !owner) {
+        kprintf("[WORKFLOW] ERROR: Owner PID=%lu of instance %lu is gone, event %u not submitted\n",
+                instance->owner_pid, instance->instance_id, event_index);
+        cipher_wipe(ring_event.payload, copy_size);
+        return 0;
+    }
+
+    // CRITICAL: до submit - completion может прийти раньше возврата
+    instance->nodes[event_index].submitted_at = rdtsc();
+    int result = routing_table_add_workflow_event(&global_routing_table, &ring_event, owner, input,
+                                                  WORKFLOW_TAG(instance->instance_id, event_index));
+    // Копия в entry уже сделана - стековая не должна хранить ключ
+    cipher_wipe(ring_event.payload, copy_size);
 
-    if (result != 0) {
+    if (!result) {
         kprintf("[WORKFLOW] ERROR: Failed to submit event %u (type=%d) to routing table\n",
                 event_index, node->type);
         return 0;
     }
 
-    // routing_table_add_event() assigns the ID, retrieve it
+    // routing_table_add_workflow_event() assigns the ID, retrieve it
     // The event is now in the routing table and being processed asynchronously!
     uint64_t assigned_event_id = ring_event.id;
 
-    kprintf("[WORKFLOW] Submitted event %u (type=%d, event_id=%lu) to event-driven system\n",
-            event_index, node->type, assigned_event_id);
+    kprintf("[WORKFLOW] Submitted event %u (type=%d, event_id=%lu, instance=%lu) to event-driven system\n",
+            event_index, node->type, assigned_event_id, instance->instance_id);
 
     return assigned_event_id;
 }
 
 // ============================================================================
-// WORKFLOW ACTIVATION & EXECUTION
+// PROFILE-GUIDED OPTIMIZATION
 // ============================================================================
 
-int workflow_activate(uint64_t workflow_id, void* params, uint64_t param_size) {
-    Workflow* workflow = workflow_get(workflow_id);
-    if (!workflow) {
-        kprintf("[WORKFLOW] ERROR: Workflow ID=%lu not found\n", workflow_id);
-        return -1;
+// Успешный node: cycles submit → completion в профиль шаблона
+static void workflow_profile_record(WorkflowInstance* instance, uint32_t event_index) {
+    WorkflowNodeProfile* profile = &instance->workflow->profile[event_index];
+    uint64_t cycles = rdtsc() - instance->nodes[event_index].submitted_at;
+
+    instance->context.total_cycles += cycles;
+
+    atomic_increment_u64(&profile->samples);
+    atomic_add_u64(&profile->total_cycles, cycles);
+
+    // EWMA без lock: гонка двух completions теряет один замер, не больше
+    uint64_t ewma = profile->ewma_cycles;
+    if (ewma == 0) {
+        ewma = cycles;
+    } else if (cycles >= ewma) {
+        ewma += (cycles - ewma) >> WORKFLOW_PROFILE_EWMA_SHIFT;
+    } else {
+        ewma -= (ewma - cycles) >> WORKFLOW_PROFILE_EWMA_SHIFT;
+    }
+    profile->ewma_cycles = ewma;
+
+    if (cycles > profile->max_cycles) {
+        profile->max_cycles = cycles;
+    }
+}
+
+// Маршрут, которым node реально идёт (свой или общий workflow)
+static const uint8_t* workflow_node_route(Workflow* workflow, uint32_t event_index) {
+    const uint8_t* route = workflow->events[event_index].route;
+    return route[0] != DECK_PREFIX_NONE ? route : workflow->route;
+}
+
+// FILE_READ nodes из prefetch_mask: окно [позиция fd + чтения того же fd
+// раньше в топологическом порядке, + size). Storage deck читает его в idle
+// проходе, пока выполняются зависимости node
+static void workflow_prefetch_reads(WorkflowInstance* instance) {
+    extern int storage_prefetch_hint(uint64_t owner_pid, int fd, uint64_t skip, uint64_t size);
+
+    Workflow* workflow = instance->workflow;
+    WorkflowSchedule* schedule = &workflow->schedule;
+    int read_fds[WORKFLOW_MAX_EVENTS];
+    uint64_t read_sizes[WORKFLOW_MAX_EVENTS];
+    uint32_t reads = 0;
+
+    for (uint32_t k = 0; k < workflow->event_count; k++) {
+        uint32_t i = schedule->order[k];
+        if (workflow->events[i].type != EVENT_FILE_READ) {
+            continue;
+        }
+
+        // Payload: [fd:4][size:8]
+        uint64_t payload_size;
+        const uint8_t* payload = workflow_node_payload(instance, i, &payload_size);
+        if (payload_size < 12) {
+            continue;
+        }
+        int fd = *(const int*)payload;
+        uint64_t size = *(const uint64_t*)(payload + 4);
+
+        uint64_t skip = 0;
+        for (uint32_t r = 0; r < reads; r++) {
+            if (read_fds[r] == fd) {
+                skip += read_sizes[r];
+            }
+        }
+        read_fds[reads] = fd;
+        read_sizes[reads++] = size;
+
+        // Storage deck откроет FD node в пространстве владельца instance
+        // (0 = kernel workflow) - окно заказываем там же
+        if ((workflow->prefetch_mask & (1u << i)) &&
+            storage_prefetch_hint(instance->owner_pid, fd, skip, size)) {
+            atomic_increment_u64(&workflow->prefetch_hints);
+        }
     }
+}
 
-    if (workflow->state == WORKFLOW_STATE_RUNNING) {
-        kprintf("[WORKFLOW] ERROR: Workflow '%s' already running\n", workflow->name);
-        return -2;
+void workflow_optimize(Workflow* workflow) {
+    WorkflowSchedule* schedule = &workflow->schedule;
+    uint32_t count = workflow->event_count;
+    uint64_t cost_sum = 0;
+    uint32_t measured = 0;
+
+    // 1. Стоимость node - его EWMA (critical path следующих активаций)
+    for (uint32_t i = 0; i < count; i++) {
+        if (workflow->profile[i].samples > 0) {
+            uint64_t cost = workflow->profile[i].ewma_cycles;
+            workflow->node_cost[i] = cost ? cost : WORKFLOW_DEFAULT_NODE_COST;
+            cost_sum += workflow->node_cost[i];
+            measured++;
+        }
     }
+    uint64_t mean_cost = measured ? cost_sum / measured : 0;
 
-    // Create execution context
-    workflow->context = (ExecutionContext*)kmalloc(sizeof(ExecutionContext));
-    memset(workflow->context, 0, sizeof(ExecutionContext));
+    // 2. Fused цепочки: A - единственная зависимость своего единственного
+    //    successor'а B, и оба идут через одни и те же decks
+    uint32_t fused = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (schedule->successor_start[i + 1] - schedule->successor_start[i] != 1) {
+            continue;
+        }
 
-    workflow->context->workflow_id = workflow_id;
-    workflow->context->activation_time = rdtsc();
-    workflow->context->total_events = workflow->event_count;
-    workflow->context->completed_events = 0;
-    workflow->context->running_events = 0;
+        uint32_t next = schedule->successors[schedule->successor_start[i]];
+        if (workflow->events[next].dependency_count == 1 &&
+            memcmp(workflow_node_route(workflow, i), workflow_node_route(workflow, next),
+                   MAX_ROUTING_STEPS) == 0) {
+            fused |= 1u << i;
+        }
+    }
+
+    // 3. Prefetch: чтения, которые ждут зависимостей и дороже среднего node
+    uint32_t prefetch = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (workflow->events[i].type == EVENT_FILE_READ && schedule->node_level[i] > 0 &&
+            workflow->node_cost[i] != 0 && workflow->node_cost[i] >= mean_cost) {
+            prefetch |= 1u << i;
+        }
+    }
+
+    workflow->fused_mask = fused;
+    workflow->prefetch_mask = prefetch;
+    workflow->optimize_passes++;
+
+    // Среднее время прогона за окно - видно, что дали прошлые решения
+    uint64_t completed_cycles = atomic_load_u64(&workflow->completed_cycles);
+    uint64_t window_avg = (completed_cycles - workflow->window_base_cycles) / WORKFLOW_OPTIMIZE_INTERVAL;
+    kprintf("[WORKFLOW] Optimized '%s' (ID=%lu, pass %lu): avg %lu cycles/run (prev %lu), "
+            "fused=0x%x prefetch=0x%x%s\n",
+            workflow->name, workflow->workflow_id, workflow->optimize_passes,
+            window_avg, workflow->window_avg_cycles, fused, prefetch,
+            workflow->prefetch_enabled ? "" : " (prefetch disabled)");
+    workflow->window_base_cycles = completed_cycles;
+    workflow->window_avg_cycles = window_avg;
+}
+
+uint64_t workflow_take_fused(void) {
+    if (atomic_load_u64(&workflow_fused_pending) == 0) {
+        return 0;
+    }
+    return atomic_exchange_u64(&workflow_fused_pending, 0);
+}
+
+// ============================================================================
+// CRITICAL-PATH DISPATCH
+// ============================================================================
+
+// Critical path node = его стоимость + самый длинный путь через successors.
+// Стоимость - замер самого node (node_cost, workflow_optimize), до первого
+// прохода optimizer'а - средняя end-to-end задержка его EventType из
+// latency_stats; nodes без истории получают среднее по известным nodes
+static void workflow_compute_critical_path(WorkflowInstance* instance) {
+    Workflow* workflow = instance->workflow;
+    ExecutionContext* ctx = &instance->context;
+    WorkflowSchedule* schedule = &workflow->schedule;
+    uint64_t cost[WORKFLOW_MAX_EVENTS];
+    uint64_t known_sum = 0;
+    uint32_t known_count = 0;
 
-    // Reset event states
     for (uint32_t i = 0; i < workflow->event_count; i++) {
-        workflow->events[i].ready = 0;
-        workflow->events[i].completed = 0;
-        workflow->events[i].error = 0;
-        workflow->events[i].event_id = 0;
+        cost[i] = workflow->node_cost[i] ? workflow->node_cost[i]
+                                         : latency_stats_type_mean_cycles(workflow->events[i].type);
+        if (cost[i]) {
+            known_sum += cost[i];
+            known_count++;
+        }
+    }
 
-        // Clean up old results
-        if (workflow->events[i].result) {
-            kfree(workflow->events[i].result);
-            workflow->events[i].result = 0;
+    uint64_t fallback = known_count ? known_sum / known_count : WORKFLOW_DEFAULT_NODE_COST;
+
+    // Обратный топологический порядок: successors уже посчитаны
+    for (uint32_t k = workflow->event_count; k-- > 0; ) {
+        uint32_t i = schedule->order[k];
+        uint64_t longest = 0;
+
+        for (uint32_t e = schedule->successor_start[i]; e < schedule->successor_start[i + 1]; e++) {
+            uint64_t path = ctx->critical_path[schedule->successors[e]];
+            if (path > longest) {
+                longest = path;
+            }
+        }
+        ctx->critical_path[i] = (cost[i] ? cost[i] : fallback) + longest;
+    }
+}
+
+// Insertion sort по убыванию critical path (<= WORKFLOW_MAX_EVENTS элементов)
+static void workflow_sort_by_critical_path(WorkflowInstance* instance, uint32_t* indices, uint32_t count) {
+    const uint64_t* path = instance->context.critical_path;
+
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t node = indices[i];
+        uint32_t j = i;
+        while (j > 0 && path[indices[j - 1]] < path[node]) {
+            indices[j] = indices[j - 1];
+            j--;
+        }
+        indices[j] = node;
+    }
+}
+
+static inline void workflow_mark_ready(WorkflowInstance* instance, uint32_t event_index) {
+    instance->context.ready_mask |= 1u << event_index;
+}
+
+// Отправить готовые nodes: самый длинный оставшийся путь первым - он задаёт
+// время всего workflow. Независимые nodes уходят вместе и перекрываются
+// в decks (work-stealing workers). parallel_safe == 0 - по одному в полёте
+static void workflow_dispatch_ready(WorkflowInstance* instance) {
+    Workflow* workflow = instance->workflow;
+    ExecutionContext* ctx = &instance->context;
+    uint32_t candidates[WORKFLOW_MAX_EVENTS];
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < workflow->event_count; i++) {
+        if (ctx->ready_mask & (1u << i)) {
+            candidates[count++] = i;
         }
     }
+    workflow_sort_by_critical_path(instance, candidates, count);
+
+    for (uint32_t k = 0; k < count; k++) {
+        if (!workflow->parallel_safe && ctx->running_events > 0) {
+            break;  // Остальные ждут в ready_mask до следующего completion
+        }
+
+        uint32_t i = candidates[k];
+        ctx->ready_mask &= ~(1u << i);
+        instance->nodes[i].ready = 1;
+
+        // REAL IMPLEMENTATION: Submit event to event-driven system!
+        uint64_t event_id = workflow_submit_event(instance, i);
+
+        if (event_id == 0) {
+            // Submission failed - mark as error
+            kprintf("[WORKFLOW] ERROR: Failed to submit event %u\n", i);
+            instance->nodes[i].error = 1;
+            ctx->error_count++;
+            continue;
+        }
+
+        // Store event_id for tracking
+        instance->nodes[i].event_id = event_id;
+        ctx->running_events++;
+
+        // NOTE: Event is now being processed ASYNCHRONOUSLY by Guide → Decks!
+        // Completion will be signaled by workflow_on_event_completed() callback
+    }
+}
+
+// Больше ничего не произойдёт: в полёте и в ready_mask пусто. Node становится
+// готовым только из completion, поэтому nodes за упавшей зависимостью
+// (CONTINUE, неудачный submit) так и останутся ждать - instance не станет complete
+static int workflow_instance_settled(WorkflowInstance* instance) {
+    return instance->context.running_events == 0 && instance->context.ready_mask == 0;
+}
+
+// Instance закончил (COMPLETED или ERROR): учёт в шаблоне ровно один раз
+static void workflow_instance_finish(WorkflowInstance* instance, WorkflowState state) {
+    instance->state = state;
+    if (instance->finished) {
+        return;
+    }
+
+    Workflow* workflow = instance->workflow;
+    uint64_t exec_time = rdtsc() - instance->context.activation_time;
+
+    instance->finished = 1;
+    instance->finished_at = rdtsc();
+    atomic_add_u64(&workflow->total_execution_time, exec_time);
+
+    // Профиль набирается только успешными прогонами
+    if (state == WORKFLOW_STATE_COMPLETED) {
+        atomic_add_u64(&workflow->completed_cycles, exec_time);
+        if (atomic_increment_u64(&workflow->completed_runs) % WORKFLOW_OPTIMIZE_INTERVAL == 0) {
+            workflow_optimize(workflow);
+        }
+    }
+
+    // Последний активный instance определяет сводное состояние шаблона
+    if (atomic_decrement_u64(&workflow->active_instances) == 0) {
+        workflow->state = state;
+    }
+
+    kprintf("[WORKFLOW] Workflow '%s' (ID=%lu, instance=%lu) %s (time=%lu cycles, errors=%u)\n",
+            workflow->name, workflow->workflow_id, instance->instance_id,
+            state == WORKFLOW_STATE_COMPLETED ? "COMPLETED" : "FAILED",
+            exec_time, instance->context.error_count);
+
+    // WAIT по instance: последний результат мог разбудить владельца раньше,
+    // чем instance завершился (publish идёт до callback) - будим ещё раз
+    process_t* owner = instance->owner_pid ? process_find_by_pid(instance->owner_pid) : NULL;
+    if (owner) {
+        extern void scheduler_notify_completion(uint64_t pid, uint64_t workflow_id);
+        atomic_store_u32(&owner->completion_ready, 1);
+        scheduler_notify_completion(owner->pid, workflow->workflow_id);
+        asm volatile("int $0x81");
+    }
+}
+
+// ============================================================================
+// WORKFLOW ACTIVATION & EXECUTION
+// ============================================================================
+
+uint64_t workflow_activate(uint64_t workflow_id, const void* params, uint64_t param_size,
+                           uint64_t owner_pid) {
+    Workflow* workflow = workflow_get(workflow_id);
+    if (!workflow) {
+        kprintf("[WORKFLOW] ERROR: Workflow ID=%lu not found\n", workflow_id);
+        return 0;
+    }
+
+    // Лимит на процесс: instance держит память, пока его не освободят
+    // (POLL/WAIT по instance или cleanup)
+    uint64_t effective_owner = owner_pid ? owner_pid : workflow->owner_pid;
+    process_t* owner = effective_owner ? process_find_by_pid(effective_owner) : NULL;
+    if (effective_owner && !owner) {
+        kprintf("[WORKFLOW] ERROR: Owner PID=%lu of '%s' is gone\n", effective_owner, workflow->name);
+        return 0;
+    }
+    if (owner && atomic_increment_u64(&owner->workflow_instances) > WORKFLOW_MAX_INSTANCES_PER_PROCESS) {
+        atomic_decrement_u64(&owner->workflow_instances);
+        kprintf("[WORKFLOW] ERROR: PID=%lu has %d live instances (limit)\n",
+                effective_owner, WORKFLOW_MAX_INSTANCES_PER_PROCESS);
+        return 0;
+    }
+
+    // Create instance: свой ExecutionContext и состояние nodes
+    WorkflowInstance* instance = (WorkflowInstance*)kmalloc(sizeof(WorkflowInstance));
+    if (!instance) {
+        kprintf("[WORKFLOW] ERROR: Out of memory for instance of '%s'\n", workflow->name);
+        if (owner) {
+            atomic_decrement_u64(&owner->workflow_instances);
+        }
+        return 0;
+    }
+    memset(instance, 0, sizeof(WorkflowInstance));
+
+    instance->workflow = workflow;
+    instance->owner_pid = effective_owner;
+    instance->state = WORKFLOW_STATE_READY;
+
+    ExecutionContext* ctx = &instance->context;
+    ctx->workflow_id = workflow_id;
+    ctx->activation_time = rdtsc();
+    ctx->total_events = workflow->event_count;
+    ctx->completed_events = 0;
+    ctx->running_events = 0;
+    memcpy(ctx->pending_deps, workflow->schedule.initial_pending, sizeof(ctx->pending_deps));
+    workflow_compute_critical_path(instance);
 
     // Apply parameters to first event if provided
-    if (params && param_size > 0 && workflow->event_count > 0) {
+    if (params && param_size > 0) {
         uint64_t copy_size = param_size;
         if (copy_size > EVENT_DATA_SIZE) {
             copy_size = EVENT_DATA_SIZE;
         }
-        memcpy(workflow->events[0].data, params, copy_size);
-        workflow->events[0].data_size = copy_size;
+        memcpy(instance->params, params, copy_size);
+        instance->param_size = copy_size;
     }
 
-    // Set state
-    workflow->state = WORKFLOW_STATE_READY;
-    workflow->activation_count++;
+    if (workflow->prefetch_enabled && workflow->prefetch_mask) {
+        workflow_prefetch_reads(instance);
+    }
+
+    // Шаблон не освобождается, пока active_instances > 0 (workflow_unregister).
+    // CRITICAL: счётчик и публикация под lock - unregister проверяет его там же
+    spin_lock(&registry.lock);
+    if (workflow_get(workflow_id) != workflow) {
+        spin_unlock(&registry.lock);
+        workflow_instance_free(instance);
+        kprintf("[WORKFLOW] ERROR: Workflow ID=%lu unregistered during activation\n", workflow_id);
+        return 0;
+    }
 
-    kprintf("[WORKFLOW] Activated workflow '%s' (ID=%lu, activation #%lu)\n",
-            workflow->name, workflow_id, workflow->activation_count);
+    instance->instance_id = atomic_increment_u64(&registry.next_instance_id);
+    WorkflowInstance** bucket = workflow_instance_bucket(instance->instance_id);
+    instance->next = *bucket;
+    *bucket = instance;
+    registry.instance_count++;
+
+    atomic_increment_u64(&workflow->active_instances);
+    workflow->state = WORKFLOW_STATE_RUNNING;
+    uint64_t activation = atomic_increment_u64(&workflow->activation_count);
+    spin_unlock(&registry.lock);
+
+    if ((instance->instance_id % WORKFLOW_CLEANUP_INTERVAL) == 0) {
+        workflow_cleanup_completed();
+    }
+
+    kprintf("[WORKFLOW] Activated workflow '%s' (ID=%lu, instance=%lu, activation #%lu)\n",
+            workflow->name, workflow_id, instance->instance_id, activation);
 
     // CRITICAL: Process workflow to submit initial events (those with no dependencies)
     // This starts the workflow execution!
-    int result = workflow_process(workflow);
+    uint64_t instance_id = instance->instance_id;
+    int result = workflow_process(instance);
     if (result < 0) {
-        kprintf("[WORKFLOW] ERROR: Failed to process workflow %lu\n", workflow_id);
-        return -3;
+        kprintf("[WORKFLOW] ERROR: Failed to process instance %lu\n", instance_id);
+        return 0;
     }
 
     kprintf("[WORKFLOW] Workflow processing started, initial events submitted\n");
 
-    return 0;
+    return instance_id;
 }
 
-int workflow_process(Workflow* workflow) {
-    if (!workflow || !workflow->context) {
+int workflow_instance_release(uint64_t instance_id) {
+    spin_lock(&registry.lock);
+
+    WorkflowInstance** link = workflow_instance_bucket(instance_id);
+    while (*link) {
+        WorkflowInstance* current = *link;
+        if (current->instance_id == instance_id) {
+            // В полёте ещё есть события - их completion обращается к instance
+            if (!current->finished || current->context.running_events > 0) {
+                spin_unlock(&registry.lock);
+                return -1;
+            }
+
+            *link = current->next;
+            registry.instance_count--;
+            spin_unlock(&registry.lock);
+
+            workflow_instance_free(current);
+            return 0;
+        }
+        link = &current->next;
+    }
+
+    spin_unlock(&registry.lock);
+    return -1;
+}
+
+int64_t workflow_instance_poll(uint64_t instance_id, uint64_t owner_pid, uint64_t* workflow_id) {
+    spin_lock(&registry.lock);
+
+    WorkflowInstance* instance = workflow_instance_find_locked(instance_id);
+
+    // Чужой instance - как несуществующий
+    if (!instance || instance->owner_pid != owner_pid) {
+        spin_unlock(&registry.lock);
         return -1;
     }
 
-    if (workflow->state != WORKFLOW_STATE_READY &&
-        workflow->state != WORKFLOW_STATE_RUNNING) {
-        return 0;  // Nothing to do
+    *workflow_id = instance->workflow->workflow_id;
+    if (!instance->finished) {
+        spin_unlock(&registry.lock);
+        return 1;
     }
 
-    workflow->state = WORKFLOW_STATE_RUNNING;
+    int64_t status = instance->state == WORKFLOW_STATE_COMPLETED ? 0 : 2;
+    spin_unlock(&registry.lock);
 
-    // Find events ready to execute (dependencies met)
-    for (uint32_t i = 0; i < workflow->event_count; i++) {
-        if (workflow->events[i].completed || workflow->events[i].error) {
-            continue;  // Skip completed/errored events
-        }
+    // Результат отдан владельцу - instance больше не нужен (-1 = ещё есть
+    // события в полёте после ABORT, освободит cleanup)
+    workflow_instance_release(instance_id);
+    return status;
+}
 
-        // Check if dependencies are met
-        if (workflow_dependencies_met(workflow, i)) {
-            workflow->events[i].ready = 1;
+int workflow_process(WorkflowInstance* instance) {
+    if (!instance) {
+        return -1;
+    }
 
-            // REAL IMPLEMENTATION: Submit event to event-driven system!
-            uint64_t event_id = workflow_submit_event(workflow, i);
+    if (instance->state != WORKFLOW_STATE_READY &&
+        instance->state != WORKFLOW_STATE_RUNNING) {
+        return 0;  // Nothing to do
+    }
 
-            if (event_id == 0) {
-                // Submission failed - mark as error
-                kprintf("[WORKFLOW] ERROR: Failed to submit event %u\n", i);
-                workflow->events[i].error = 1;
-                workflow->context->error_count++;
-                continue;
-            }
+    instance->state = WORKFLOW_STATE_RUNNING;
 
-            // Store event_id for tracking
-            workflow->events[i].event_id = event_id;
-            workflow->context->running_events++;
+    // Find events ready to execute (pending_deps == 0), в топологическом порядке
+    Workflow* workflow = instance->workflow;
+    WorkflowSchedule* schedule = &workflow->schedule;
+    for (uint32_t k = 0; k < workflow->event_count; k++) {
+        uint32_t i = schedule->order[k];
+        if (instance->nodes[i].completed || instance->nodes[i].error ||
+            instance->nodes[i].ready) {
+            continue;  // Skip completed/errored/already submitted events
+        }
 
-            // NOTE: Event is now being processed ASYNCHRONOUSLY by Guide → Decks!
-            // Completion will be signaled by workflow_on_event_completed() callback
-            // DO NOT mark as completed here - that's done by the callback!
+        // Check if dependencies are met
+        if (workflow_dependencies_met(instance, i)) {
+            workflow_mark_ready(instance, i);
         }
     }
 
-    // Check if workflow is complete
-    if (workflow_is_complete(workflow)) {
-        workflow->state = WORKFLOW_STATE_COMPLETED;
-
-        uint64_t exec_time = rdtsc() - workflow->context->activation_time;
-        workflow->total_execution_time += exec_time;
-
-        kprintf("[WORKFLOW] Workflow '%s' completed (time=%lu cycles)\n",
-                workflow->name, exec_time);
+    // DO NOT mark as completed here - that's done by the callback!
+    workflow_dispatch_ready(instance);
 
+    // Check if workflow is complete
+    if (workflow_is_complete(instance)) {
+        workflow_instance_finish(instance, WORKFLOW_STATE_COMPLETED);
         return 1;  // Workflow complete
     }
 
+    // Ни один node не ушёл (submit failed) - completion не придёт
+    if (workflow_instance_settled(instance)) {
+        workflow_instance_finish(instance, WORKFLOW_STATE_ERROR);
+    }
+
     return 0;  // Still running
 }
 
-int workflow_is_complete(Workflow* workflow) {
-    if (!workflow || !workflow->context) {
+int workflow_is_complete(WorkflowInstance* instance) {
+    if (!instance) {
         return 0;
     }
 
-    return workflow->context->completed_events >= workflow->context->total_events;
+    return instance->context.completed_events >= instance->context.total_events;
 }
 
-void* workflow_get_result(Workflow* workflow, uint64_t* result_size) {
-    if (!workflow || !workflow->context) {
+void* workflow_get_result(WorkflowInstance* instance, uint64_t* result_size) {
+    if (!instance) {
         if (result_size) *result_size = 0;
         return 0;
     }
 
-    if (!workflow_is_complete(workflow)) {
+    if (!workflow_is_complete(instance)) {
         if (result_size) *result_size = 0;
         return 0;  // Not complete yet
     }
 
-    // Return result from last event in DAG
-    if (workflow->event_count > 0) {
-        uint32_t last_idx = workflow->event_count - 1;
+    // Результат последнего node в топологическом порядке (sink DAG)
+    Workflow* workflow = instance->workflow;
+    uint32_t event_count = workflow->event_count;
+    if (event_count > 0) {
+        uint32_t last_idx = workflow->schedule.compiled ? workflow->schedule.order[event_count - 1]
+                                                        : event_count - 1;
+        WorkflowNodeState* node = &instance->nodes[last_idx];
+
+        // BUFFER: сами данные, а не ResultBuffer-заголовок
+        void* data = node->result;
+        if (data && node->result_type == RESULT_TYPE_BUFFER) {
+            data = ((ResultBuffer*)data)->data;
+        }
         if (result_size) {
-            *result_size = workflow->events[last_idx].result_size;
+            *result_size = data ? node->result_size : 0;
         }
-        return workflow->events[last_idx].result;
+        return data;
     }
 
     if (result_size) *result_size = 0;
@@ -407,45 +990,51 @@ void* workflow_get_result(Workflow* workflow, uint64_t* result_size) {
 
 // Called by Execution Deck when an event completes
 // This is the CRITICAL integration point between event system and workflow system!
-void workflow_on_event_completed(uint64_t workflow_id, uint64_t event_id,
-                                  void* result, uint64_t result_size,
-                                  int32_t error_code) {
-    Workflow* workflow = workflow_get(workflow_id);
-    if (!workflow) {
-        kprintf("[WORKFLOW] WARNING: Event %lu completed but workflow %lu not found\n",
-                event_id, workflow_id);
-        // NOTE: Do NOT free result here - execution_deck owns it and handles cleanup
-        return;
+int workflow_on_event_completed(uint64_t workflow_tag, uint64_t event_id,
+                                void* result, uint64_t result_size,
+                                ResultType result_type, int32_t error_code) {
+    // This is normal for direct events submitted via EventRing (not workflow activation)
+    // NOTE: Do NOT free result here - ownership is execution_deck's responsibility!
+    // execution_deck will properly cleanup based on result_type (VALUE vs MEMORY_MAPPED)
+    if (workflow_tag == 0) {
+        return 0;
     }
 
-    if (!workflow->context) {
-        // This is normal for direct events submitted via EventRing (not workflow activation)
-        // Workflows can be registered but not activated - events are sent directly
-        // NOTE: Do NOT free result here - ownership is execution_deck's responsibility!
-        // execution_deck will properly cleanup based on result_type (VALUE vs MEMORY_MAPPED)
-        return;
+    uint64_t instance_id = WORKFLOW_TAG_INSTANCE(workflow_tag);
+    uint32_t event_index = WORKFLOW_TAG_NODE(workflow_tag);
+
+    WorkflowInstance* instance = workflow_instance_get(instance_id);
+    if (!instance) {
+        kprintf("[WORKFLOW] WARNING: Event %lu completed but instance %lu not found\n",
+                event_id, instance_id);
+        // NOTE: Do NOT free result here - execution_deck owns it and handles cleanup
+        return 0;
     }
 
-    // Find which WorkflowNode this event_id belongs to
-    uint32_t event_index = (uint32_t)-1;
-    for (uint32_t i = 0; i < workflow->event_count; i++) {
-        if (workflow->events[i].event_id == event_id) {
-            event_index = i;
-            break;
-        }
+    Workflow* workflow = instance->workflow;
+    ExecutionContext* ctx = &instance->context;
+
+    // 1 = result теперь принадлежит node (освобождается workflow_node_release_result)
+    int taken = 0;
+
+    // DEFENSIVE: tag и event_id должны указывать на один и тот же node
+    // (устаревшая попытка retry или битый tag)
+    if (event_index >= workflow->event_count || instance->nodes[event_index].event_id != event_id) {
+        kprintf("[WORKFLOW] WARNING: Event %lu completed but not found in instance %lu\n",
+                event_id, instance_id);
+        return 0;  // execution_deck освободит result по его типу
     }
 
-    if (event_index == (uint32_t)-1) {
-        kprintf("[WORKFLOW] WARNING: Event %lu completed but not found in workflow %lu\n",
-                event_id, workflow_id);
-        if (result) {
-            kfree(result);
+    WorkflowNodeState* node = &instance->nodes[event_index];
+
+    // ABORT уже остановил instance - события в полёте только досчитываются
+    if (instance->finished) {
+        if (ctx->running_events > 0) {
+            ctx->running_events--;
         }
-        return;
+        return 0;
     }
 
-    WorkflowNode* node = &workflow->events[event_index];
-
     // Update node state
     if (error_code != 0) {
         // Event failed - check if we should retry
@@ -454,10 +1043,7 @@ void workflow_on_event_completed(uint64_t workflow_id, uint64_t event_id,
         kprintf("[WORKFLOW] Event %u (id=%lu) FAILED with error 0x%04x (%s)\n",
                 event_index, event_id, error_code, error_to_string(error_code));
 
-        // Clean up result if provided
-        if (result) {
-            kfree(result);
-        }
+        // Result упавшего события не берём - execution_deck освободит его по типу
 
         // Determine if we should retry based on error policy and error type
         bool should_retry = false;
@@ -494,32 +1080,42 @@ void workflow_on_event_completed(uint64_t workflow_id, uint64_t event_id,
 
             // Immediate retry (simplified for now)
             node->ready = 1;
-            uint64_t new_event_id = workflow_submit_event(workflow, event_index);
+            uint64_t new_event_id = workflow_submit_event(instance, event_index);
 
             if (new_event_id == 0) {
                 kprintf("[WORKFLOW] ERROR: Failed to submit retry for event %u\n", event_index);
                 node->error = 1;
-                workflow->context->error_count++;
-                workflow->context->failed_event_index = event_index;
+                ctx->error_count++;
+                ctx->failed_event_index = event_index;
+                ctx->running_events--;
+
+                // Слот в полёте освободился - отложенные nodes (parallel_safe == 0)
+                workflow_dispatch_ready(instance);
+
+                // Это мог быть последний node в полёте
+                if (workflow_instance_settled(instance)) {
+                    workflow_instance_finish(instance, WORKFLOW_STATE_ERROR);
+                }
             } else {
+                // Node остаётся в полёте: running_events не меняется
                 node->event_id = new_event_id;
-                workflow->context->running_events++;
             }
 
-            return;  // Don't continue with normal error handling
+            return 0;  // Don't continue with normal error handling
         }
 
         // No retry - permanent failure
         node->error = 1;
-        workflow->context->error_count++;
-        workflow->context->failed_event_index = event_index;
+        ctx->error_count++;
+        ctx->failed_event_index = event_index;
 
         // Apply error policy
         switch (workflow->error_policy) {
             case ERROR_POLICY_ABORT:
                 kprintf("[WORKFLOW] ERROR POLICY: ABORT - stopping workflow\n");
-                workflow->state = WORKFLOW_STATE_ERROR;
-                return;  // Stop processing
+                ctx->running_events--;
+                workflow_instance_finish(instance, WORKFLOW_STATE_ERROR);
+                return 0;  // Stop processing
 
             case ERROR_POLICY_CONTINUE:
                 kprintf("[WORKFLOW] ERROR POLICY: CONTINUE - proceeding with other events\n");
@@ -528,21 +1124,17 @@ void workflow_on_event_completed(uint64_t workflow_id, uint64_t event_id,
 
             case ERROR_POLICY_SKIP:
                 kprintf("[WORKFLOW] ERROR POLICY: SKIP - skipping dependent events\n");
-                // Mark all dependent events as skipped (error)
-                for (uint32_t i = 0; i < workflow->event_count; i++) {
-                    if (workflow->events[i].completed || workflow->events[i].error) {
+                // Mark all dependent events as skipped (error) - reverse edges
+                for (uint32_t k = workflow->schedule.successor_start[event_index];
+                     k < workflow->schedule.successor_start[event_index + 1]; k++) {
+                    uint32_t i = workflow->schedule.successors[k];
+                    if (instance->nodes[i].completed || instance->nodes[i].error) {
                         continue;
                     }
 
-                    // Check if this event depends on the failed event
-                    for (uint32_t j = 0; j < workflow->events[i].dependency_count; j++) {
-                        if (workflow->events[i].dependencies[j] == event_index) {
-                            workflow->events[i].error = 1;
-                            workflow->events[i].last_error_code = ERROR_WORKFLOW_DEPENDENCY_FAILED;
-                            kprintf("[WORKFLOW] Event %u skipped (dependency %u failed)\n", i, event_index);
-                            break;
-                        }
-                    }
+                    instance->nodes[i].error = 1;
+                    instance->nodes[i].last_error_code = ERROR_WORKFLOW_DEPENDENCY_FAILED;
+                    kprintf("[WORKFLOW] Event %u skipped (dependency %u failed)\n", i, event_index);
                 }
                 break;
 
@@ -557,58 +1149,76 @@ void workflow_on_event_completed(uint64_t workflow_id, uint64_t event_id,
     } else {
         // Event succeeded
         node->completed = 1;
+
+        // DEFENSIVE: результат прошлой попытки не теряется
+        workflow_node_release_result(node);
         node->result = result;  // Transfer ownership to workflow
         node->result_size = result_size;
+        node->result_type = result ? result_type : RESULT_TYPE_NONE;
+        taken = result && (result_type == RESULT_TYPE_KMALLOC || result_type == RESULT_TYPE_BUFFER);
 
-        workflow->context->completed_events++;
+        ctx->completed_events++;
+        workflow_profile_record(instance, event_index);
 
         kprintf("[WORKFLOW] Event %u (id=%lu) COMPLETED (result=%p, size=%lu)\n",
                 event_index, event_id, result, result_size);
     }
 
-    workflow->context->running_events--;
+    ctx->running_events--;
 
     // CRITICAL: Check if new events can be activated (dependency chain)!
-    // Find events whose dependencies are now met
-    for (uint32_t i = 0; i < workflow->event_count; i++) {
-        if (workflow->events[i].completed || workflow->events[i].error) {
+    // Только successors завершённого node: декремент pending, O(out-degree).
+    // Ошибка не освобождает successors - они ждут (CONTINUE) или уже skipped
+    WorkflowSchedule* schedule = &workflow->schedule;
+    int fused = node->completed && (workflow->fused_mask & (1u << event_index));
+    uint32_t succ_begin = node->completed ? schedule->successor_start[event_index] : 0;
+    uint32_t succ_end = node->completed ? schedule->successor_start[event_index + 1] : 0;
+
+    for (uint32_t k = succ_begin; k < succ_end; k++) {
+        uint32_t i = schedule->successors[k];
+
+        // DEFENSIVE: счётчик не уходит ниже нуля
+        if (ctx->pending_deps[i] > 0) {
+            ctx->pending_deps[i]--;
+        }
+
+        if (instance->nodes[i].completed || instance->nodes[i].error) {
             continue;  // Skip already processed events
         }
 
-        if (workflow->events[i].ready) {
+        if (instance->nodes[i].ready) {
             continue;  // Already submitted
         }
 
         // Check if this event's dependencies are now met
-        if (workflow_dependencies_met(workflow, i)) {
-            kprintf("[WORKFLOW] Event %u dependencies now met, submitting...\n", i);
-
-            workflow->events[i].ready = 1;
-
-            uint64_t new_event_id = workflow_submit_event(workflow, i);
+        if (workflow_dependencies_met(instance, i)) {
+            kprintf("[WORKFLOW] Event %u dependencies now met (critical path %lu)\n",
+                    i, ctx->critical_path[i]);
+            workflow_mark_ready(instance, i);
+        }
+    }
 
-            if (new_event_id == 0) {
-                kprintf("[WORKFLOW] ERROR: Failed to submit dependent event %u\n", i);
-                workflow->events[i].error = 1;
-                workflow->context->error_count++;
-                continue;
-            }
+    // Новые готовые + отложенные (parallel_safe == 0) - по critical path
+    workflow_dispatch_ready(instance);
 
-            workflow->events[i].event_id = new_event_id;
-            workflow->context->running_events++;
+    // Единственный successor ушёл в Guide - пусть дойдёт до deck в этом же
+    // проходе guide_process_all()
+    if (fused && succ_end > succ_begin) {
+        WorkflowNodeState* next = &instance->nodes[schedule->successors[succ_begin]];
+        if (next->ready && !next->completed && !next->error) {
+            atomic_increment_u64(&workflow->fused_submits);
+            atomic_increment_u64(&workflow_fused_pending);
         }
     }
 
     // Check if workflow is complete
-    if (workflow_is_complete(workflow)) {
-        workflow->state = WORKFLOW_STATE_COMPLETED;
-
-        uint64_t exec_time = rdtsc() - workflow->context->activation_time;
-        workflow->total_execution_time += exec_time;
-
-        kprintf("[WORKFLOW] Workflow '%s' (ID=%lu) COMPLETED! (time=%lu cycles, errors=%u)\n",
-                workflow->name, workflow_id, exec_time, workflow->context->error_count);
+    if (workflow_is_complete(instance)) {
+        workflow_instance_finish(instance, WORKFLOW_STATE_COMPLETED);
+    } else if (workflow_instance_settled(instance)) {
+        workflow_instance_finish(instance, WORKFLOW_STATE_ERROR);
     }
+
+    return taken;
 }
 
 // ============================================================================
@@ -670,6 +1280,78 @@ static int workflow_dfs_cycle_check(Workflow* workflow, uint32_t node_idx,
     return 0;
 }
 
+// Kahn's algorithm по уровням: order, level_start, successors (CSR), initial_pending.
+// Зависимости уже провалидированы. Возвращает 0 при успехе, -1 если остался цикл
+static int workflow_compile_schedule(Workflow* workflow) {
+    WorkflowSchedule* schedule = &workflow->schedule;
+    uint32_t count = workflow->event_count;
+    uint8_t remaining[WORKFLOW_MAX_EVENTS];
+
+    memset(schedule, 0, sizeof(WorkflowSchedule));
+
+    // 1. Out-degree каждого node -> границы CSR
+    for (uint32_t i = 0; i < count; i++) {
+        WorkflowNode* node = &workflow->events[i];
+        schedule->initial_pending[i] = (uint8_t)node->dependency_count;
+        for (uint32_t j = 0; j < node->dependency_count; j++) {
+            schedule->successor_start[node->dependencies[j] + 1]++;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        schedule->successor_start[i + 1] += schedule->successor_start[i];
+    }
+
+    // 2. Обратные рёбра: dep -> node
+    uint8_t fill[WORKFLOW_MAX_EVENTS];
+    memcpy(fill, schedule->successor_start, sizeof(fill));
+    for (uint32_t i = 0; i < count; i++) {
+        WorkflowNode* node = &workflow->events[i];
+        for (uint32_t j = 0; j < node->dependency_count; j++) {
+            schedule->successors[fill[node->dependencies[j]]++] = (uint8_t)i;
+        }
+    }
+
+    // 3. Уровни: level 0 = без зависимостей, дальше фронт за фронтом
+    uint32_t tail = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        remaining[i] = schedule->initial_pending[i];
+        if (remaining[i] == 0) {
+            schedule->order[tail++] = (uint8_t)i;
+        }
+    }
+
+    uint32_t head = 0;
+    uint32_t level = 0;
+    while (head < tail) {
+        uint32_t level_end = tail;
+        schedule->level_start[level] = (uint8_t)head;
+
+        for (; head < level_end; head++) {
+            uint32_t n = schedule->order[head];
+            schedule->node_level[n] = (uint8_t)level;
+
+            for (uint32_t k = schedule->successor_start[n]; k < schedule->successor_start[n + 1]; k++) {
+                uint32_t succ = schedule->successors[k];
+                if (--remaining[succ] == 0) {
+                    schedule->order[tail++] = (uint8_t)succ;
+                }
+            }
+        }
+        level++;
+    }
+    schedule->level_start[level] = (uint8_t)tail;
+    schedule->level_count = (uint8_t)level;
+
+    // DEFENSIVE: DFS уже поймал бы цикл - недостижимые nodes значит ошибка
+    if (tail != count) {
+        kprintf("[WORKFLOW] ERROR: %u node(s) unreachable in topological order\n", count - tail);
+        return -1;
+    }
+
+    schedule->compiled = 1;
+    return 0;
+}
+
 int workflow_analyze_dag(Workflow* workflow) {
     if (!workflow) {
         kprintf("[WORKFLOW] ERROR: analyze_dag called with NULL workflow\n");
@@ -755,22 +1437,35 @@ int workflow_analyze_dag(Workflow* workflow) {
     kprintf("[WORKFLOW] Cycle check PASSED - DAG is acyclic\n");
 
     // ========================================================================
-    // STEP 3: PARALLELISM ANALYSIS
+    // STEP 3: COMPILE SCHEDULE (levels + reverse edges)
     // ========================================================================
-    int independent_count = 0;
+    if (workflow_compile_schedule(workflow) != 0) {
+        kprintf("[WORKFLOW] DAG validation FAILED: Schedule compilation error\n");
+        return -1;
+    }
+
+    // ========================================================================
+    // STEP 4: PARALLELISM ANALYSIS
+    // ========================================================================
+    WorkflowSchedule* schedule = &workflow->schedule;
+    int independent_count = schedule->level_start[1] - schedule->level_start[0];
     int max_parallel = 0;
 
-    // Count nodes with no dependencies (can start immediately)
-    for (uint32_t i = 0; i < workflow->event_count; i++) {
-        if (workflow->events[i].dependency_count == 0) {
-            independent_count++;
+    // Самый широкий уровень - верхняя граница одновременно готовых nodes
+    for (uint32_t l = 0; l < schedule->level_count; l++) {
+        int width = schedule->level_start[l + 1] - schedule->level_start[l];
+        if (width > max_parallel) {
+            max_parallel = width;
         }
     }
 
-    if (independent_count > 1) {
+    kprintf("[WORKFLOW] Schedule: %u level(s), widest level %d node(s)\n",
+            schedule->level_count, max_parallel);
+
+    if (max_parallel > 1) {
         workflow->parallel_safe = 1;
-        max_parallel = independent_count;
-        kprintf("[WORKFLOW] Parallelism: %d nodes can run in parallel\n", max_parallel);
+        kprintf("[WORKFLOW] Parallelism: up to %d nodes can run in parallel (%d at start)\n",
+                max_parallel, independent_count);
     } else {
         workflow->parallel_safe = 0;
         kprintf("[WORKFLOW] Parallelism: Sequential execution required\n");
@@ -780,9 +1475,9 @@ int workflow_analyze_dag(Workflow* workflow) {
     return 0;
 }
 
-int workflow_find_parallel_events(Workflow* workflow, uint32_t* event_indices,
+int workflow_find_parallel_events(WorkflowInstance* instance, uint32_t* event_indices,
                                    uint32_t max_events) {
-    if (!workflow || !event_indices) return 0;
+    if (!instance || !event_indices) return 0;
 
     uint32_t count = 0;
 
@@ -791,23 +1486,34 @@ int workflow_find_parallel_events(Workflow* workflow, uint32_t* event_indices,
     // 2. Have dependencies met
     // 3. Are not currently running
 
-    for (uint32_t i = 0; i < workflow->event_count && count < max_events; i++) {
-        if (!workflow->events[i].completed &&
-            !workflow->events[i].error &&
-            workflow_dependencies_met(workflow, i)) {
+    uint32_t ready[WORKFLOW_MAX_EVENTS];
+    uint32_t ready_count = 0;
+
+    for (uint32_t i = 0; i < instance->workflow->event_count; i++) {
+        if (!instance->nodes[i].completed &&
+            !instance->nodes[i].error &&
+            workflow_dependencies_met(instance, i)) {
 
-            event_indices[count++] = i;
+            ready[ready_count++] = i;
         }
     }
 
+    // Самый длинный critical path первым
+    workflow_sort_by_critical_path(instance, ready, ready_count);
+
+    for (uint32_t i = 0; i < ready_count && count < max_events; i++) {
+        event_indices[count++] = ready[i];
+    }
+
     return count;
 }
 
-int workflow_dependencies_met(Workflow* workflow, uint32_t event_index) {
-    if (!workflow || event_index >= workflow->event_count) {
+int workflow_dependencies_met(WorkflowInstance* instance, uint32_t event_index) {
+    if (!instance || event_index >= instance->workflow->event_count) {
         return 0;
     }
 
+    Workflow* workflow = instance->workflow;
     WorkflowNode* node = &workflow->events[event_index];
 
     // No dependencies? Always ready
@@ -815,6 +1521,11 @@ int workflow_dependencies_met(Workflow* workflow, uint32_t event_index) {
         return 1;
     }
 
+    // O(1) по счётчику (декрементируется только успехом)
+    if (workflow->schedule.compiled) {
+        return instance->context.pending_deps[event_index] == 0;
+    }
+
     // Check all dependencies are completed
     for (uint32_t i = 0; i < node->dependency_count; i++) {
         uint32_t dep_idx = node->dependencies[i];
@@ -824,11 +1535,11 @@ int workflow_dependencies_met(Workflow* workflow, uint32_t event_index) {
             return 0;
         }
 
-        if (!workflow->events[dep_idx].completed) {
+        if (!instance->nodes[dep_idx].completed) {
             return 0;  // Dependency not met
         }
 
-        if (workflow->events[dep_idx].error) {
+        if (instance->nodes[dep_idx].error) {
             return 0;  // Dependency failed
         }
     }
@@ -853,29 +1564,55 @@ void workflow_print_stats(uint64_t workflow_id) {
     kprintf("  Events: %u\n", workflow->event_count);
     kprintf("  State: %d\n", workflow->state);
     kprintf("  Activations: %lu\n", workflow->activation_count);
+    kprintf("  Active instances: %lu\n", workflow->active_instances);
     kprintf("  Total execution time: %lu cycles\n", workflow->total_execution_time);
     kprintf("  Parallel safe: %s\n", workflow->parallel_safe ? "yes" : "no");
+    kprintf("  Schedule levels: %u\n", workflow->schedule.level_count);
+    kprintf("  Priority: %s\n", event_priority_name(workflow->priority));
+    kprintf("  Optimizer: passes=%lu fused=0x%x (submits=%lu) prefetch=0x%x%s (hints=%lu)\n",
+            workflow->optimize_passes, workflow->fused_mask, workflow->fused_submits,
+            workflow->prefetch_mask, workflow->prefetch_enabled ? "" : " off",
+            workflow->prefetch_hints);
 
-    if (workflow->context) {
-        kprintf("  Execution context:\n");
-        kprintf("    Completed: %u / %u\n",
-                workflow->context->completed_events, workflow->context->total_events);
-        kprintf("    Running: %u\n", workflow->context->running_events);
-        kprintf("    Errors: %u\n", workflow->context->error_count);
+    for (uint32_t i = 0; i < workflow->event_count; i++) {
+        WorkflowNodeProfile* profile = &workflow->profile[i];
+        if (profile->samples == 0) {
+            continue;
+        }
+        kprintf("  Node %u (type=%d): n=%lu avg=%lu ewma=%lu max=%lu cycles\n",
+                i, workflow->events[i].type, profile->samples,
+                profile->total_cycles / profile->samples, profile->ewma_cycles,
+                profile->max_cycles);
     }
+
+    // Instances этого шаблона
+    spin_lock(&registry.lock);
+    for (uint32_t b = 0; b < WORKFLOW_INSTANCE_BUCKETS; b++) {
+        for (WorkflowInstance* inst = registry.instances[b]; inst; inst = inst->next) {
+            if (inst->workflow != workflow) {
+                continue;
+            }
+            kprintf("  Instance %lu: state=%d completed=%u/%u running=%u errors=%u\n",
+                    inst->instance_id, inst->state,
+                    inst->context.completed_events, inst->context.total_events,
+                    inst->context.running_events, inst->context.error_count);
+        }
+    }
+    spin_unlock(&registry.lock);
 }
 
 void workflow_print_all(void) {
-    kprintf("\n[WORKFLOW] Registered workflows: %lu\n", registry.workflow_count);
+    kprintf("\n[WORKFLOW] Registered workflows: %lu (instances: %lu)\n",
+            registry.workflow_count, registry.instance_count);
 
-    // DYNAMIC WORKFLOW REGISTRY: Walk linked list
-    Workflow* current = registry.head;
     uint64_t index = 0;
-    while (current) {
-        kprintf("  [%lu] '%s' (ID=%lu, events=%u, state=%d)\n",
-                index, current->name, current->workflow_id, current->event_count, current->state);
-        current = current->next;
-        index++;
+    for (uint32_t b = 0; b < WORKFLOW_REGISTRY_BUCKETS; b++) {
+        for (Workflow* current = registry.buckets[b]; current; current = current->next) {
+            kprintf("  [%lu] '%s' (ID=%lu, events=%u, state=%d, active=%lu)\n",
+                    index, current->name, current->workflow_id, current->event_count,
+                    current->state, current->active_instances);
+            index++;
+        }
     }
 }
 
@@ -884,35 +1621,41 @@ void workflow_print_all(void) {
 // ============================================================================
 
 void workflow_cleanup_completed(void) {
-    // Clean up workflows in COMPLETED state
+    // Clean up instances in COMPLETED/ERROR state
     // (Keep them for a while for result retrieval)
 
     uint64_t cleaned = 0;
+    uint64_t now = rdtsc();
+    WorkflowInstance* expired = NULL;
 
-    // DYNAMIC WORKFLOW REGISTRY: Walk linked list
-    Workflow* current = registry.head;
-    while (current) {
-        if (current->state == WORKFLOW_STATE_COMPLETED && current->context) {
-            // Check if result has been retrieved
-            // For now, just clean up old contexts
-
-            uint64_t age = rdtsc() - current->context->activation_time;
-
-            // If older than ~1 second (2.4B cycles on 2.4GHz), clean up
-            if (age > 2400000000ULL) {
-                if (current->context->final_result) {
-                    kfree(current->context->final_result);
-                }
-                kfree(current->context);
-                current->context = NULL;
-                current->state = WORKFLOW_STATE_REGISTERED;
-                cleaned++;
+    spin_lock(&registry.lock);
+    for (uint32_t b = 0; b < WORKFLOW_INSTANCE_BUCKETS; b++) {
+        WorkflowInstance** link = &registry.instances[b];
+        while (*link) {
+            WorkflowInstance* current = *link;
+
+            // If older than ~1 second, clean up (events в полёте ещё обращаются к нему)
+            if (current->finished && current->context.running_events == 0 &&
+                now - current->finished_at > WORKFLOW_INSTANCE_RETAIN_CYCLES) {
+                *link = current->next;
+                registry.instance_count--;
+                current->next = expired;
+                expired = current;
+                continue;
             }
+            link = &current->next;
         }
-        current = current->next;
+    }
+    spin_unlock(&registry.lock);
+
+    while (expired) {
+        WorkflowInstance* next = expired->next;
+        workflow_instance_free(expired);
+        expired = next;
+        cleaned++;
     }
 
     if (cleaned > 0) {
-        kprintf("[WORKFLOW] Cleaned up %lu completed workflows\n", cleaned);
+        kprintf("[WORKFLOW] Cleaned up %lu completed instances\n", cleaned);
     }
 }
@@ -21,6 +21,12 @@
 // - Execution context tracking
 // - Automatic prefetching and optimization
 //
+// Registered Workflow - неизменяемый шаблон (DAG + скомпилированный
+// schedule). workflow_activate() создаёт WorkflowInstance: свой
+// ExecutionContext и состояние nodes, шаблон не трогается - активации
+// одного workflow идут параллельно. Шаблоны и instances - в hash-таблицах
+// по ID (id & mask, цепочки через next).
+//
 // ============================================================================
 
 // Maximum limits
@@ -29,6 +35,31 @@
 #define WORKFLOW_NAME_MAX        32    // Max workflow name length
 #define WORKFLOW_MAX_DEPENDENCIES 8    // Max dependencies per event
 
+// Hash-таблицы registry (степени 2; ID последовательные - цепочки короткие)
+#define WORKFLOW_REGISTRY_BUCKETS 256   // Шаблоны
+#define WORKFLOW_INSTANCE_BUCKETS 1024  // Активации
+
+// Живых instances (включая завершённые, но не освобождённые) на процесс
+#define WORKFLOW_MAX_INSTANCES_PER_PROCESS 256
+
+_Static_assert((WORKFLOW_REGISTRY_BUCKETS & (WORKFLOW_REGISTRY_BUCKETS - 1)) == 0,
+               "WORKFLOW_REGISTRY_BUCKETS must be power of 2");
+_Static_assert((WORKFLOW_INSTANCE_BUCKETS & (WORKFLOW_INSTANCE_BUCKETS - 1)) == 0,
+               "WORKFLOW_INSTANCE_BUCKETS must be power of 2");
+
+// RoutingEntry.workflow_tag: instance + node события (0 = не workflow node)
+#define WORKFLOW_TAG(instance_id, node)   (((instance_id) << 8) | (node))
+#define WORKFLOW_TAG_INSTANCE(tag)        ((tag) >> 8)
+#define WORKFLOW_TAG_NODE(tag)            ((uint32_t)((tag) & 0xFF))
+
+// WorkflowNode.flags
+// INPUT_FROM_DEP: результат dependencies[0] (ResultBuffer) становится input
+// события - decks читают его как entry->buffer, без копии в 224-байтный data
+#define WORKFLOW_NODE_FLAG_INPUT_FROM_DEP  0x01
+// MEMOIZE: чистый operations node - одинаковый вход между активациями
+// берётся из memo cache (EVENT_FLAG_MEMOIZE)
+#define WORKFLOW_NODE_FLAG_MEMOIZE         0x02
+
 // ============================================================================
 // WORKFLOW STATE
 // ============================================================================
@@ -47,6 +78,7 @@ typedef enum {
 // ============================================================================
 
 // Each node in the DAG represents an event to be executed
+// (часть шаблона - после регистрации не меняется)
 typedef struct {
     // Event definition
     EventType type;                             // Type of event
@@ -57,6 +89,15 @@ typedef struct {
     uint32_t dependency_count;                  // Number of dependencies
     uint32_t dependencies[WORKFLOW_MAX_DEPENDENCIES];  // Indices of dependent events
 
+    // Маршрут node (route[0] == 0 → маршрут workflow): read → transform → write
+    // проходят через разные decks
+    uint8_t route[MAX_ROUTING_STEPS];
+    uint8_t flags;                              // WORKFLOW_NODE_FLAG_*
+
+} WorkflowNode;
+
+// Состояние node в одной активации (WorkflowInstance.nodes)
+typedef struct {
     // Execution state
     uint8_t ready;                              // 1 if dependencies met
     uint8_t completed;                          // 1 if execution done
@@ -66,16 +107,76 @@ typedef struct {
 
     // Results
     uint64_t event_id;                          // Event ID when submitted
-    void* result;                               // Pointer to result data
-    uint64_t result_size;                       // Size of result
+    uint64_t submitted_at;                      // RDTSC submit (профиль node)
+    void* result;                               // Pointer to result data (BUFFER: ResultBuffer*)
+    uint64_t result_size;                       // Size of result (байт данных для BUFFER)
+    ResultType result_type;                     // Как освобождать result
 
-} WorkflowNode;
+} WorkflowNodeState;
+
+// ============================================================================
+// COMPILED SCHEDULE
+// ============================================================================
+//
+// workflow_analyze_dag() компилирует DAG при регистрации:
+//   - топологический порядок, сгруппированный по уровням (level 0 = без
+//     зависимостей, level N зависит только от уровней < N)
+//   - обратные рёбра (successors) в CSR-виде: successors[start[i]..start[i+1])
+//   - initial_pending = число входящих рёбер
+// Завершение node - декремент pending у его successors: O(out-degree)
+// вместо пересканирования dependency lists всех nodes.
+//
+// ============================================================================
+
+typedef struct {
+    uint8_t order[WORKFLOW_MAX_EVENTS];                       // Nodes по уровням
+    uint8_t level_start[WORKFLOW_MAX_EVENTS + 1];             // order[level_start[l]..level_start[l+1])
+    uint8_t node_level[WORKFLOW_MAX_EVENTS];
+    uint8_t successor_start[WORKFLOW_MAX_EVENTS + 1];
+    uint8_t successors[WORKFLOW_MAX_EVENTS * WORKFLOW_MAX_DEPENDENCIES];
+    uint8_t initial_pending[WORKFLOW_MAX_EVENTS];             // Входящие рёбра
+    uint8_t level_count;
+    uint8_t compiled;                                         // 1 = DAG валиден
+} WorkflowSchedule;
+
+// ============================================================================
+// PROFILE - Замеры nodes между активациями (workflow_optimize)
+// ============================================================================
+//
+// Успешный node пишет в профиль шаблона cycles submit → completion. Каждые
+// WORKFLOW_OPTIMIZE_INTERVAL успешных активаций workflow_optimize() обновляет:
+//   - node_cost     наблюдаемая стоимость node вместо средней по EventType:
+//                   critical path и порядок независимых nodes
+//   - fused_mask    цепочка A → B (у A один successor, у B одна зависимость,
+//                   маршрут через те же decks): B проходит свой deck в том же
+//                   вызове guide_process_all(), что и завершение A, а не на
+//                   следующем tick
+//   - prefetch_mask (prefetch_enabled) FILE_READ nodes не из level 0, которые
+//                   дороже среднего node: при активации их блоки заказываются
+//                   Storage deck'у (storage_prefetch_hint)
+// Поля - слова, шаблон не блокируется: instances читают их при активации
+// и completion, устаревшее значение - только упущенная оптимизация.
+//
+// ============================================================================
+
+// Первый проход optimizer'а и период между проходами (успешных активаций)
+#define WORKFLOW_OPTIMIZE_INTERVAL   8
+
+// EWMA стоимости node: новый замер с весом 1/2^SHIFT
+#define WORKFLOW_PROFILE_EWMA_SHIFT  3
+
+typedef struct {
+    volatile uint64_t samples;                  // Успешных выполнений
+    volatile uint64_t total_cycles;             // Сумма submit → completion
+    uint64_t ewma_cycles;                       // Скользящее среднее
+    uint64_t max_cycles;
+} WorkflowNodeProfile;
 
 // ============================================================================
 // EXECUTION CONTEXT
 // ============================================================================
 
-// Tracks execution state of a workflow
+// Tracks execution state of a workflow instance
 typedef struct {
     uint64_t workflow_id;                       // Workflow being executed
     uint64_t activation_time;                   // RDTSC when activated
@@ -97,6 +198,13 @@ typedef struct {
     uint32_t error_count;                       // Number of errors
     uint32_t failed_event_index;                // Which event failed
 
+    // Dependency counters (из WorkflowSchedule.initial_pending при активации)
+    uint8_t pending_deps[WORKFLOW_MAX_EVENTS];  // Незавершённые зависимости node
+
+    // Critical-path dispatch
+    uint32_t ready_mask;                        // Готовы, но ещё не отправлены (bit = node)
+    uint64_t critical_path[WORKFLOW_MAX_EVENTS];  // Cycles от старта node до конца DAG
+
 } ExecutionContext;
 
 // ============================================================================
@@ -117,43 +225,86 @@ typedef struct Workflow {
     // DAG structure
     uint32_t event_count;                       // Number of events
     WorkflowNode events[WORKFLOW_MAX_EVENTS];   // DAG nodes
+    WorkflowSchedule schedule;                  // Скомпилированный DAG
 
-    // State
+    // State (сводное по instances: RUNNING пока есть активные,
+    // иначе итог последней завершившейся)
     WorkflowState state;                        // Current state
-    ExecutionContext* context;                  // Execution context (if active)
+    volatile uint64_t active_instances;         // Instances в работе
 
     // Metadata
     uint64_t registration_time;                 // RDTSC when registered
-    uint64_t activation_count;                  // Times activated
-    uint64_t total_execution_time;              // Cumulative execution time
+    volatile uint64_t activation_count;         // Times activated
+    volatile uint64_t total_execution_time;     // Cumulative execution time
 
     // Optimization hints
-    uint8_t parallel_safe;                      // Can events run in parallel?
+    uint8_t parallel_safe;                      // Can events run in parallel? (0 = по одному)
     uint8_t prefetch_enabled;                   // Enable data prefetching?
+    uint8_t priority;                           // EVENT_PRIORITY_* событий instances (QoS lane)
+
+    // Profile-guided optimization (см. PROFILE)
+    WorkflowNodeProfile profile[WORKFLOW_MAX_EVENTS];
+    uint64_t node_cost[WORKFLOW_MAX_EVENTS];    // Cycles (0 = ещё не оптимизирован)
+    uint32_t fused_mask;                        // Bit = node, чей successor идёт fused
+    uint32_t prefetch_mask;                     // Bit = FILE_READ node с prefetch
+    volatile uint64_t completed_runs;           // Активации, завершённые COMPLETED
+    volatile uint64_t completed_cycles;         // Их суммарное время
+    uint64_t window_base_cycles;                // completed_cycles на прошлом проходе
+    uint64_t window_avg_cycles;                 // Среднее время прогона в прошлом окне
+    uint64_t optimize_passes;                   // Проходов workflow_optimize()
+    volatile uint64_t fused_submits;            // Successors, отправленные fused
+    volatile uint64_t prefetch_hints;           // Окон заказано Storage deck'у
 
     // Error handling configuration
     ErrorPolicy error_policy;                   // How to handle errors (abort/continue/retry/skip)
     RetryConfig retry_config;                   // Retry configuration for transient errors
 
-    // DYNAMIC WORKFLOW REGISTRY FIX: Linked list for unlimited workflows
-    struct Workflow* next;                      // Next workflow in registry (NULL if last)
+    // Hash chain: следующий шаблон в bucket'е registry (NULL if last)
+    struct Workflow* next;
 
 } Workflow;
 
+// ============================================================================
+// WORKFLOW INSTANCE - Одна активация шаблона
+// ============================================================================
+
+typedef struct WorkflowInstance {
+    uint64_t instance_id;                       // Unique instance ID (> 0)
+    Workflow* workflow;                         // Шаблон (жив, пока active_instances > 0)
+    uint64_t owner_pid;                         // Получатель результатов (0 = kernel)
+
+    WorkflowState state;
+    uint8_t finished;                           // 1 = учтён в шаблоне (COMPLETED/ERROR)
+    uint64_t finished_at;                       // RDTSC завершения (cleanup)
+
+    ExecutionContext context;
+    WorkflowNodeState nodes[WORKFLOW_MAX_EVENTS];
+
+    // Параметры активации вместо data node 0 (шаблон не меняется)
+    uint8_t params[EVENT_DATA_SIZE];
+    uint64_t param_size;                        // 0 = data шаблона
+
+    struct WorkflowInstance* next;              // Hash chain
+} WorkflowInstance;
+
 // ============================================================================
 // WORKFLOW REGISTRY
 // ============================================================================
 //
-// DYNAMIC WORKFLOW REGISTRY FIX:
-// Changed from fixed array to linked list for unlimited capacity!
-// Workflows are now allocated on-demand via kmalloc.
+// Шаблоны и instances - chained hash-таблицы по ID, allocated on-demand
+// via kmalloc. workflow_get() - без блокировки (шаблон публикуется после
+// полной инициализации и не освобождается, пока у него есть instances);
+// instances меняются под lock.
 //
 // ============================================================================
 
 typedef struct {
-    Workflow* head;                     // Head of linked list (NULL if empty)
+    Workflow* buckets[WORKFLOW_REGISTRY_BUCKETS];
+    WorkflowInstance* instances[WORKFLOW_INSTANCE_BUCKETS];
     uint64_t workflow_count;            // Number of registered workflows
+    uint64_t instance_count;            // Живые instances (включая завершённые)
     volatile uint64_t next_workflow_id; // Next workflow ID to assign
+    volatile uint64_t next_instance_id; // Next instance ID to assign
     spinlock_t lock;                    // Registry protection
 } WorkflowRegistry;
 
@@ -172,49 +323,86 @@ uint64_t workflow_register(const char* name,
                            const WorkflowNode* events,
                            uint64_t owner_pid);
 
-// Unregister a workflow
+// Unregister a workflow (0 = OK, -1 = not found, -2 = есть активные instances)
 int workflow_unregister(uint64_t workflow_id);
 
-// Get workflow by ID
+// Get workflow by ID (O(1), без блокировки)
 Workflow* workflow_get(uint64_t workflow_id);
 
+// QoS class событий следующих активаций (EVENT_PRIORITY_*, default NORMAL)
+// 0 = OK, -1 = нет workflow или неизвестный класс
+int workflow_set_priority(uint64_t workflow_id, uint8_t priority);
+
 // === ACTIVATION & EXECUTION ===
-// Activate a workflow (called by kernel_notify syscall)
-int workflow_activate(uint64_t workflow_id, void* params, uint64_t param_size);
+// Activate a workflow (kernel_notify NOTIFY_ACTIVATE / kernel code):
+// новый instance, параметры заменяют data node 0.
+// owner_pid = получатель результатов (0 = owner шаблона).
+// Returns instance_id, or 0 on error
+uint64_t workflow_activate(uint64_t workflow_id, const void* params, uint64_t param_size,
+                           uint64_t owner_pid);
+
+// Get instance by ID (NULL если нет или уже освобождён)
+WorkflowInstance* workflow_instance_get(uint64_t instance_id);
+
+// Освободить завершённый instance (результаты nodes). 0 = OK, -1 = нет/ещё работает
+int workflow_instance_release(uint64_t instance_id);
+
+// POLL/WAIT по instance (kernel_notify RDX = instance_id).
+// 0 = COMPLETED, 1 = ещё работает, 2 = ERROR, -1 = нет instance у owner_pid.
+// Завершённый instance освобождается (события в полёте - его подберёт cleanup).
+// *workflow_id - ключ ожидания (шаблон instance)
+int64_t workflow_instance_poll(uint64_t instance_id, uint64_t owner_pid, uint64_t* workflow_id);
 
-// Process workflow execution (called by Guide)
-int workflow_process(Workflow* workflow);
+// Submit ready events of an instance
+int workflow_process(WorkflowInstance* instance);
 
-// Check if workflow is complete
-int workflow_is_complete(Workflow* workflow);
+// Check if instance is complete
+int workflow_is_complete(WorkflowInstance* instance);
 
-// Get workflow result
-void* workflow_get_result(Workflow* workflow, uint64_t* result_size);
+// Get instance result: данные последнего node (BUFFER - payload ResultBuffer)
+// и их размер в байтах. Валиден до workflow_instance_release()
+void* workflow_get_result(WorkflowInstance* instance, uint64_t* result_size);
 
 // === DAG ANALYSIS ===
-// Analyze DAG for parallel execution opportunities
+// Validate DAG and compile workflow->schedule (0 = OK, -1 = invalid/cyclic)
 int workflow_analyze_dag(Workflow* workflow);
 
 // Find events that can execute in parallel
-int workflow_find_parallel_events(Workflow* workflow, uint32_t* event_indices,
+int workflow_find_parallel_events(WorkflowInstance* instance, uint32_t* event_indices,
                                    uint32_t max_events);
 
 // Check if event dependencies are met
-int workflow_dependencies_met(Workflow* workflow, uint32_t event_index);
+int workflow_dependencies_met(WorkflowInstance* instance, uint32_t event_index);
 
 // === EVENT COMPLETION CALLBACK ===
 // Called by Execution Deck when event completes
 // This integrates the event-driven system with the workflow system!
-void workflow_on_event_completed(uint64_t workflow_id, uint64_t event_id,
-                                  void* result, uint64_t result_size,
-                                  int32_t error_code);
+// workflow_tag = RoutingEntry.workflow_tag (0 = событие не из workflow).
+// Возвращает 1, если workflow забрал result (KMALLOC/BUFFER) - вызывающий
+// его больше не освобождает; 0 - cleanup остаётся за Execution Deck
+int workflow_on_event_completed(uint64_t workflow_tag, uint64_t event_id,
+                                void* result, uint64_t result_size,
+                                ResultType result_type, int32_t error_code);
+
+// === PROFILE-GUIDED OPTIMIZATION ===
+// Пересчитать node_cost / fused_mask / prefetch_mask по профилю (вызывается
+// сам каждые WORKFLOW_OPTIMIZE_INTERVAL успешных активаций)
+void workflow_optimize(Workflow* workflow);
+
+// Prefetch блоков FILE_READ nodes при активации (prefetch_mask).
+// 0 = OK, -1 = нет workflow
+int workflow_set_prefetch(uint64_t workflow_id, int enabled);
+
+// Fused successors, отправленные с прошлого вызова (guide_process_all:
+// ещё один проход, чтобы они дошли до deck сразу). Сбрасывает счётчик
+uint64_t workflow_take_fused(void);
 
 // === STATISTICS & MONITORING ===
 void workflow_print_stats(uint64_t workflow_id);
 void workflow_print_all(void);
 
 // === CLEANUP ===
-// Clean up completed workflows
+// Освободить instances, завершённые больше ~1 секунды назад
 void workflow_cleanup_completed(void);
 
 #endif  // WORKFLOW_H
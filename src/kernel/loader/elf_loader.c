@@ -6,6 +6,7 @@
 #include "elf.h"
 #include "klib.h"
 #include "vmm.h"
+#include "pmm.h"
 
 // ============================================================================
 // ERROR MESSAGES
@@ -198,6 +199,238 @@ uint64_t elf_load(const void* data, size_t size, uint64_t load_base, ElfLoadInfo
     return entry;
 }
 
+// ============================================================================
+// IMAGE CACHE
+// ============================================================================
+
+typedef struct {
+    uint64_t vaddr;           // Первая страница сегмента (после relocation)
+    uint64_t phys;            // Страницы образа (identity mapped)
+    uint64_t pages;
+    uint64_t file_offset;     // Данные файла - с vaddr + page_offset
+    uint64_t file_size;
+    uint32_t page_offset;
+    uint32_t writable;        // PF_W: отображается COW
+} ElfImageSegment;
+
+struct ElfImage {
+    uint64_t hash;            // FNV-1a файла
+    size_t size;
+    uint32_t refs;            // Процессов с этим образом
+    uint64_t last_used;       // elf_image_clock на последнем release
+    uint32_t segment_count;
+    ElfImageSegment segments[ELF_IMAGE_MAX_SEGMENTS];
+    struct ElfImage* next;
+};
+
+static ElfImage* elf_image_list = NULL;
+static uint64_t elf_image_clock = 0;
+static spinlock_t elf_image_lock = {0};
+
+static uint64_t elf_image_hash(const uint8_t* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Сегменты файла (без страниц). Проверяет границы файла и окно образов
+static int elf_image_layout(const uint8_t* file, size_t size, int64_t reloc_offset,
+                            ElfImage* image) {
+    const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*)file;
+    const uint8_t* phdr_base = file + ehdr->e_phoff;
+
+    for (uint16_t i = 0; i < ehdr->e_phnum; i++) {
+        const Elf64_Phdr* phdr = (const Elf64_Phdr*)(phdr_base + i * ehdr->e_phentsize);
+        if (phdr->p_type != PT_LOAD || phdr->p_memsz == 0) {
+            continue;
+        }
+
+        if (phdr->p_filesz > phdr->p_memsz || phdr->p_offset > size ||
+            phdr->p_filesz > size - phdr->p_offset) {
+            kprintf("[ELF] Segment %u outside of file\n", i);
+            return ELF_ERR_LOAD;
+        }
+
+        uint64_t seg_vaddr = phdr->p_vaddr + reloc_offset;
+        uint64_t page_start = seg_vaddr & ~0xFFFULL;
+        uint64_t page_end = (seg_vaddr + phdr->p_memsz + 0xFFF) & ~0xFFFULL;
+        if (page_start < VMM_USER_BASE || page_end > VMM_USER_IMAGE_END || page_end <= page_start) {
+            kprintf("[ELF] Segment %u at 0x%lx outside of user image window 0x%lx-0x%lx\n",
+                    i, seg_vaddr, VMM_USER_BASE, VMM_USER_IMAGE_END);
+            return ELF_ERR_LOAD;
+        }
+
+        // Страница - ровно одного сегмента: у каждого свои физические страницы
+        for (uint32_t k = 0; k < image->segment_count; k++) {
+            const ElfImageSegment* other = &image->segments[k];
+            if (page_start < other->vaddr + other->pages * 4096 && other->vaddr < page_end) {
+                kprintf("[ELF] Segment %u shares a page with another segment\n", i);
+                return ELF_ERR_LOAD;
+            }
+        }
+
+        if (image->segment_count == ELF_IMAGE_MAX_SEGMENTS) {
+            kprintf("[ELF] More than %d loadable segments\n", ELF_IMAGE_MAX_SEGMENTS);
+            return ELF_ERR_LOAD;
+        }
+
+        ElfImageSegment* seg = &image->segments[image->segment_count++];
+        seg->vaddr = page_start;
+        seg->phys = 0;
+        seg->pages = (page_end - page_start) / 4096;
+        seg->file_offset = phdr->p_offset;
+        seg->file_size = phdr->p_filesz;
+        seg->page_offset = (uint32_t)(seg_vaddr - page_start);
+        seg->writable = (phdr->p_flags & PF_W) != 0;
+    }
+
+    return image->segment_count ? ELF_OK : ELF_ERR_NO_SEGMENTS;
+}
+
+// Тот же файл: ключ, раскладка сегментов и их содержимое
+static bool elf_image_matches(const ElfImage* cached, const ElfImage* layout, const uint8_t* file) {
+    if (cached->hash != layout->hash || cached->size != layout->size ||
+        cached->segment_count != layout->segment_count) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < cached->segment_count; i++) {
+        const ElfImageSegment* a = &cached->segments[i];
+        const ElfImageSegment* b = &layout->segments[i];
+        if (a->vaddr != b->vaddr || a->pages != b->pages || a->page_offset != b->page_offset ||
+            a->file_size != b->file_size || a->writable != b->writable ||
+            memcmp((const uint8_t*)a->phys + a->page_offset, file + b->file_offset, b->file_size) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void elf_image_free_pages(ElfImage* image) {
+    for (uint32_t i = 0; i < image->segment_count; i++) {
+        if (image->segments[i].phys) {
+            pmm_free((void*)image->segments[i].phys, image->segments[i].pages);
+            image->segments[i].phys = 0;
+        }
+    }
+}
+
+// Страницы сегментов: данные файла + нулевой BSS и края страниц
+static bool elf_image_populate(ElfImage* image, const uint8_t* file) {
+    for (uint32_t i = 0; i < image->segment_count; i++) {
+        ElfImageSegment* seg = &image->segments[i];
+        void* pages = pmm_alloc_zero(seg->pages);
+        if (!pages) {
+            kprintf("[ELF] Failed to allocate %lu pages for segment\n", seg->pages);
+            elf_image_free_pages(image);
+            return false;
+        }
+        memcpy((uint8_t*)pages + seg->page_offset, file + seg->file_offset, seg->file_size);
+        seg->phys = (uint64_t)pages;
+    }
+    return true;
+}
+
+static ElfImage* elf_image_lookup(const ElfImage* layout, const uint8_t* file) {
+    for (ElfImage* image = elf_image_list; image; image = image->next) {
+        if (elf_image_matches(image, layout, file)) {
+            image->refs++;
+            return image;
+        }
+    }
+    return NULL;
+}
+
+// Образ файла с reloc_offset (+1 ссылка). NULL - *err
+static ElfImage* elf_image_get(const void* data, size_t size, int64_t reloc_offset, int* err) {
+    const uint8_t* file = (const uint8_t*)data;
+
+    ElfImage* image = (ElfImage*)kmalloc(sizeof(ElfImage));
+    if (!image) {
+        *err = ELF_ERR_MEMORY;
+        return NULL;
+    }
+    memset(image, 0, sizeof(ElfImage));
+
+    *err = elf_image_layout(file, size, reloc_offset, image);
+    if (*err != ELF_OK) {
+        kfree(image);
+        return NULL;
+    }
+    image->hash = elf_image_hash(file, size);
+    image->size = size;
+
+    spin_lock(&elf_image_lock);
+    ElfImage* cached = elf_image_lookup(image, file);
+    spin_unlock(&elf_image_lock);
+    if (cached) {
+        kfree(image);
+        return cached;
+    }
+
+    // Копирование - вне lock'а
+    if (!elf_image_populate(image, file)) {
+        kfree(image);
+        *err = ELF_ERR_MEMORY;
+        return NULL;
+    }
+
+    spin_lock(&elf_image_lock);
+    cached = elf_image_lookup(image, file);  // Другой CPU успел раньше
+    if (!cached) {
+        image->refs = 1;
+        image->next = elf_image_list;
+        elf_image_list = image;
+    }
+    spin_unlock(&elf_image_lock);
+
+    if (cached) {
+        elf_image_free_pages(image);
+        kfree(image);
+        return cached;
+    }
+
+    kprintf("[ELF] Image cached (%u segments, %lu bytes)\n", image->segment_count, (uint64_t)size);
+    return image;
+}
+
+void elf_image_release(ElfImage* image) {
+    if (!image) {
+        return;
+    }
+
+    ElfImage* evict = NULL;
+
+    spin_lock(&elf_image_lock);
+    if (image->refs > 0 && --image->refs == 0) {
+        image->last_used = ++elf_image_clock;
+
+        // Сверх ELF_IMAGE_CACHE_IDLE образов без процессов - самый давний
+        uint32_t idle = 0;
+        ElfImage** oldest = NULL;
+        for (ElfImage** link = &elf_image_list; *link; link = &(*link)->next) {
+            if ((*link)->refs == 0) {
+                idle++;
+                if (!oldest || (*link)->last_used < (*oldest)->last_used) {
+                    oldest = link;
+                }
+            }
+        }
+        if (idle > ELF_IMAGE_CACHE_IDLE) {
+            evict = *oldest;
+            *oldest = evict->next;
+        }
+    }
+    spin_unlock(&elf_image_lock);
+
+    if (evict) {
+        elf_image_free_pages(evict);
+        kfree(evict);
+    }
+}
+
 // ============================================================================
 // LOAD ELF INTO PROCESS (with VMM)
 // ============================================================================
@@ -220,7 +453,6 @@ uint64_t elf_load_process(const void* data, size_t size, void* vmm_context, ElfL
     }
 
     const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*)data;
-    const uint8_t* file_data = (const uint8_t*)data;
 
     // For PIE executables, we can relocate to any base
     // For regular executables, we must use the specified addresses
@@ -228,68 +460,42 @@ uint64_t elf_load_process(const void* data, size_t size, void* vmm_context, ElfL
     int64_t reloc_offset = 0;
 
     if (info->flags & ELF_FLAG_PIE) {
-        // Load PIE at user space base (e.g., 0x400000)
-        load_base = 0x400000;
+        // PIE - в начало окна образов, над identity map
+        load_base = VMM_USER_BASE;
         reloc_offset = (int64_t)load_base - (int64_t)info->base_addr;
     }
 
     kprintf("[ELF] Loading into process (base=0x%lx, segments=%u)\n",
             load_base, info->segment_count);
 
-    // Load each PT_LOAD segment
-    const uint8_t* phdr_base = file_data + ehdr->e_phoff;
-
-    for (uint16_t i = 0; i < ehdr->e_phnum; i++) {
-        const Elf64_Phdr* phdr = (const Elf64_Phdr*)(phdr_base + i * ehdr->e_phentsize);
-
-        if (phdr->p_type != PT_LOAD) {
-            continue;
-        }
-
-        // Calculate load address
-        uint64_t seg_vaddr = phdr->p_vaddr + reloc_offset;
-        uint64_t seg_size = phdr->p_memsz;
+    ElfImage* image = elf_image_get(data, size, reloc_offset, &err);
+    if (!image) {
+        kprintf("[ELF] Failed to load image: %s\n", elf_error_string(err));
+        return 0;
+    }
 
-        // Align to page boundaries
-        uint64_t page_start = seg_vaddr & ~0xFFF;
-        uint64_t page_end = (seg_vaddr + seg_size + 0xFFF) & ~0xFFF;
-        size_t page_count = (page_end - page_start) / 4096;
+    // Страницы образа - общие: read-only как есть, writable - COW.
+    // Уже отображённые при ошибке сегменты уходят с контекстом (SHARED не освобождается)
+    for (uint32_t i = 0; i < image->segment_count; i++) {
+        const ElfImageSegment* seg = &image->segments[i];
 
-        // Determine VMM flags from segment flags
-        uint64_t vmm_flags = VMM_FLAGS_USER_RO;  // User accessible, read-only
-        if (phdr->p_flags & PF_W) {
-            vmm_flags = VMM_FLAGS_USER_RW;  // User accessible, writable
-        }
         // Note: NX bit is handled separately if CPU supports it
-
-        // Allocate pages for this segment
-        void* pages = vmm_alloc_pages(vmm_context, page_count, vmm_flags);
-        if (!pages) {
-            kprintf("[ELF] Failed to allocate %lu pages for segment\n", page_count);
-            return 0;
+        uint64_t vmm_flags = VMM_FLAGS_USER_RO | VMM_FLAG_SHARED;
+        if (seg->writable) {
+            vmm_flags |= VMM_FLAG_COW;
         }
 
-        // Map pages at the correct virtual address
-        // Note: vmm_alloc_pages returns the virtual address, so we need to
-        // ensure it's at the right location or use vmm_map_pages instead
-
-        // For now, copy data to allocated pages
-        // (This assumes vmm_alloc_pages returns usable kernel-mapped memory)
-
-        uint64_t offset_in_page = seg_vaddr - page_start;
-
-        // Zero the pages first
-        memset(pages, 0, page_count * 4096);
-
-        // Copy file data
-        if (phdr->p_filesz > 0) {
-            memcpy((uint8_t*)pages + offset_in_page,
-                   file_data + phdr->p_offset,
-                   phdr->p_filesz);
+        vmm_map_result_t result = vmm_map_pages(vmm_context, seg->vaddr, seg->phys,
+                                                seg->pages, vmm_flags);
+        if (!result.success) {
+            kprintf("[ELF] Failed to map segment at 0x%lx: %s\n", seg->vaddr,
+                    result.error_msg ? result.error_msg : "unknown error");
+            elf_image_release(image);
+            return 0;
         }
 
-        kprintf("[ELF]   Segment: 0x%lx-%lx (%lu pages, flags=%x)\n",
-                seg_vaddr, seg_vaddr + seg_size, page_count, phdr->p_flags);
+        kprintf("[ELF]   Segment: 0x%lx (%lu pages, %s)\n",
+                seg->vaddr, seg->pages, seg->writable ? "COW" : "shared");
     }
 
     // Calculate final entry point
@@ -299,6 +505,7 @@ uint64_t elf_load_process(const void* data, size_t size, void* vmm_context, ElfL
     info->entry_point = entry;
     info->base_addr = load_base;
     info->end_addr = load_base + info->total_size;
+    info->image = image;
 
     kprintf("[ELF] Process load complete. Entry: 0x%lx\n", entry);
 
@@ -22,6 +22,30 @@
 #define ELF_ERR_MEMORY      7   // Memory allocation failed
 #define ELF_ERR_LOAD        8   // Failed to load segment
 
+// ============================================================================
+// IMAGE CACHE
+// ============================================================================
+//
+// elf_load_process не копирует файл в каждый процесс: PT_LOAD сегменты
+// готовятся один раз на содержимое (ключ - FNV-1a + размер, совпадение
+// подтверждается сравнением сегментов) и отображаются всем процессам с
+// VMM_FLAG_SHARED. Read-only сегменты - общие, writable - read-only +
+// VMM_FLAG_COW: первая запись даёт процессу свою копию страницы.
+//
+// Образ живёт, пока есть процессы (ElfLoadInfo.image -> elf_image_release).
+// Без процессов до ELF_IMAGE_CACHE_IDLE образов остаются в кэше для
+// следующего запуска, сверх этого самый давний возвращается в PMM.
+//
+// Сегменты должны лежать в [VMM_USER_BASE, VMM_USER_IMAGE_END): ниже -
+// identity map ядра, PIE грузится в VMM_USER_BASE.
+//
+// ============================================================================
+
+#define ELF_IMAGE_MAX_SEGMENTS  8   // PT_LOAD сегментов в образе
+#define ELF_IMAGE_CACHE_IDLE    4   // Образов без процессов в кэше
+
+typedef struct ElfImage ElfImage;
+
 // ============================================================================
 // LOADED ELF INFO
 // ============================================================================
@@ -33,6 +57,7 @@ typedef struct {
     uint64_t total_size;      // Total memory size
     uint32_t segment_count;   // Number of loaded segments
     uint32_t flags;           // Flags (executable type, etc.)
+    ElfImage* image;          // Образ в кэше (elf_load_process), отпустить elf_image_release
 } ElfLoadInfo;
 
 // Flags
@@ -53,10 +78,13 @@ int elf_get_info(const void* data, size_t size, ElfLoadInfo* info);
 // Returns entry point on success, 0 on failure
 uint64_t elf_load(const void* data, size_t size, uint64_t load_base, ElfLoadInfo* info);
 
-// Load ELF into new process address space
-// Uses VMM to allocate pages and map segments
+// Load ELF into new process address space: сегменты образа из кэша
+// отображаются в vmm_context, info->image держит ссылку на образ
 uint64_t elf_load_process(const void* data, size_t size, void* vmm_context, ElfLoadInfo* info);
 
+// Процесс больше не использует образ (его контекст уже уничтожен). NULL - no-op
+void elf_image_release(ElfImage* image);
+
 // Get human-readable error message
 const char* elf_error_string(int error);
 
@@ -11,6 +11,7 @@
 #include "ata.h"
 #include "tagfs.h"
 #include "pit.h"
+#include "clock.h"
 #include "keyboard.h"
 #include "eventdriven_system.h"
 #include "serial.h"
@@ -18,6 +19,10 @@
 #include "workflow.h"
 #include "events.h"
 #include "elf_loader.h"
+#include "smp.h"
+#include "trace.h"
+#include "bench.h"
+#include "boot_profile.h"
 
 // Linker-provided symbols for BSS section
 extern char __bss_start[];
@@ -34,17 +39,16 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
     // Use linker-provided symbols for BSS (automatic, no manual updates needed)
     // This ensures ALL BSS is cleared, regardless of kernel size
 
-    volatile uint64_t* bss_ptr = (volatile uint64_t*)__bss_start;
-    volatile uint64_t* bss_end = (volatile uint64_t*)__bss_end;
-
-    // Zero BSS in 8-byte chunks for efficiency (may be several MB)
-    while (bss_ptr < bss_end) {
-        *bss_ptr++ = 0;
-    }
+    // Several MB: memset идёт через rep stosq (ERMS ещё не проверен,
+    // mem_use_erms сам лежит в BSS)
+    memset(__bss_start, 0, (size_t)(__bss_end - __bss_start));
 
     // NOTE: BSS cleared - all global variables now zeroed
     // (ring buffers, workflow contexts, decks, routing table, tagfs_storage)
 
+    // Stamps stage2 из boot info - до того, как pmm раздаст low memory
+    boot_profile_init();
+
     // ========================================================================
     // PHASE 1: EARLY INITIALIZATION
     // ========================================================================
@@ -64,24 +68,30 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
 
     kprintf("[1] Enabling FPU...\n");
     enable_fpu();
+    klib_mem_init();    // memcpy/memset: rep movsb при ERMS
     kprintf("[1] OK\n");
+    boot_mark("kernel.fpu");
 
     kprintf("[2] E820 map (%lu entries)...\n", e820_count);
     e820_set_entries(e820_map, e820_count);
     kprintf("[2] OK\n");
+    boot_mark("kernel.e820");
 
     kprintf("[3] Physical memory manager...\n");
     pmm_init();
     kprintf("[3] OK\n");
+    boot_mark("kernel.pmm");
 
     kprintf("[4] Memory allocator (from PMM)...\n");
     mem_init();
     kprintf("[4] OK\n");
+    boot_mark("kernel.heap");
 
     kprintf("[5] Virtual memory manager...\n");
     vmm_init();
     vmm_test_basic();  // TEMP: Disabled - causing panic
     kprintf("[5] OK\n");
+    boot_mark("kernel.vmm");
 
     // ========================================================================
     // PHASE 3: STORAGE SYSTEM
@@ -91,10 +101,12 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
     kprintf("[6] ATA disk driver...\n");
     ata_init();
     kprintf("[6] OK\n");
+    boot_mark("kernel.disk");
 
     kprintf("[7] TagFS filesystem...\n");
     tagfs_init();
     kprintf("[7] OK\n");
+    boot_mark("kernel.tagfs");
 
     // ========================================================================
     // PHASE 4: CPU PROTECTION & INTERRUPTS
@@ -105,22 +117,29 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
     kprintf("[8] GDT (Kernel + User segments)...\n");
     gdt_init();
     kprintf("[8] OK\n");
+    boot_mark("kernel.gdt");
 
     kprintf("[9] IDT (256 vectors)...\n");
     idt_init();
     kprintf("[9] OK\n");
+    boot_mark("kernel.idt");
 
     kprintf("[10] TSS (IST stacks)...\n");
     tss_init();
     kprintf("[10] OK\n");
+    boot_mark("kernel.tss");
 
     kprintf("[11] PIC (IRQs remapped)...\n");
     pic_init();
     kprintf("[11] OK\n");
+    boot_mark("kernel.pic");
 
-    kprintf("[12] PIT timer (100 Hz)...\n");
-    pit_init(100);  // 100 Hz = 10ms per tick
+    kprintf("[12] Clock (TSC calibration) + PIT timer (100 Hz until LAPIC timer)...\n");
+    clock_init();
+    pit_init(CLOCK_TICK_HZ);  // 100 Hz = 10ms per tick
+    ata_enable_irq();  // Async DMA completions (TagFS mount уже прошёл синхронно)
     kprintf("[12] OK\n");
+    boot_mark("kernel.clock");
 
     // ========================================================================
     // PHASE 5: EVENT-DRIVEN WORKFLOW SYSTEM
@@ -128,23 +147,40 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
 
     kprintf("\n=== Event-Driven Workflow System ===\n");
     kprintf("[13] Initializing event-driven system...\n");
+    trace_init();
     eventdriven_system_init();
     eventdriven_system_start();
     kprintf("[13] OK\n");
+    boot_mark("kernel.eventdriven");
 
     kprintf("[14] Initializing workflow engine...\n");
     extern void workflow_engine_init(void);
     workflow_engine_init();
     kprintf("[14] OK - Workflow Engine ready!\n");
+    boot_mark("kernel.workflow");
 
     kprintf("[15] Initializing process management...\n");
     process_init();
     kprintf("[15] OK - Process system ready!\n");
+    boot_mark("kernel.process");
 
     kprintf("[16] Initializing scheduler...\n");
     extern void scheduler_init(void);
     scheduler_init();
     kprintf("[16] OK - Scheduler ready!\n");
+    boot_mark("kernel.scheduler");
+
+    #ifdef USE_BENCH
+    // make bench: один CPU, без прерываний - замеры до SMP и sti. Не возвращается
+    bench_run_all();
+    #endif
+
+    kprintf("[17] SMP (LAPIC/IOAPIC, APs, deck placement)...\n");
+    smp_init();
+    smp_place_decks();
+    clock_event_init();  // LAPIC timer вместо PIT IRQ 0 - tickless idle
+    kprintf("[17] OK - %u CPU(s) online\n", smp_online_count());
+    boot_mark("kernel.smp");
 
     // ========================================================================
     // PHASE 6: ENABLE INTERRUPTS
@@ -162,6 +198,7 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
     kprintf("\n");
 
     cpu_print_detailed_info();
+    smp_print_info();
 
     kprintf("\nSystem is ready to process workflows!\n");
     kprintf("NOTE: Interrupts will be enabled AFTER process creation\n\n");
@@ -174,12 +211,10 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
 
     // Create a simple workflow that user program can activate
     WorkflowNode test_nodes[1];
+    memset(test_nodes, 0, sizeof(test_nodes));  // route/flags по умолчанию
     test_nodes[0].type = EVENT_TIMER_CREATE;  // Simple timer event
     test_nodes[0].data_size = 0;
     test_nodes[0].dependency_count = 0;
-    test_nodes[0].ready = 1;
-    test_nodes[0].completed = 0;
-    test_nodes[0].error = 0;
 
     // Route: Operations Deck → Execution Deck
     uint8_t route[MAX_ROUTING_STEPS] = {1, 0, 0, 0, 0, 0, 0, 0};
@@ -212,8 +247,15 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
         panic("Invalid shell ELF!");
     }
 
-    // Create process from ELF
-    process_t* shell_proc = process_create_elf(shell_binary, shell_binary_len);
+    // Create process from ELF. Shell (ulib) работает с COMPACT rings: формат
+    // ulib узнаёт из header ring, геометрия - kernel default
+    process_ring_config_t shell_rings = {
+        .format = PROCESS_RING_FORMAT_COMPACT,
+        .event_ring_units = 0,
+        .result_ring_units = 0,
+        .max_entry_size = 0,
+    };
+    process_t* shell_proc = process_create_elf(shell_binary, shell_binary_len, &shell_rings);
     if (!shell_proc) {
         panic("Failed to create shell process!");
     }
@@ -234,14 +276,14 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
     #include "concurrent_test_binary.h"
 
     process_t* proc1 = process_create(user_storage_test_binary,
-                                      user_storage_test_binary_len, 0);
+                                      user_storage_test_binary_len, 0, NULL);
     if (!proc1) {
         panic("Failed to create process 1!");
     }
     kprintf("[KERNEL] Process 1 created (PID=%lu)\n", proc1->pid);
 
     process_t* proc2 = process_create(concurrent_test_binary,
-                                      concurrent_test_binary_len, 0);
+                                      concurrent_test_binary_len, 0, NULL);
     if (!proc2) {
         panic("Failed to create process 2!");
     }
@@ -255,8 +297,12 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
     kprintf("[KERNEL] Transitioning to Ring 3...\n\n");
     #endif
 
+    boot_mark("kernel.userspace");
+    boot_profile_report();
+
     // CRITICAL: Enable interrupts NOW (processes are created and ready!)
     // Scheduler will automatically pick first process from ready queue on first timer tick
+    serial_enable_irq();  // kprintf в serial - через TX ring и IRQ 4
     kprintf("[KERNEL] Enabling interrupts - scheduler will pick first process...\n");
     asm volatile("sti");
 
@@ -264,6 +310,7 @@ void kernel_main(e820_entry_t* e820_map, uint64_t e820_count, uint64_t mem_start
     // First timer tick will pick a process from ready queue and start execution
     kprintf("[KERNEL] Entering idle loop - scheduler is now in control\n\n");
     while (1) {
+        pmm_zero_idle();      // Pre-zeroed pages для pmm_alloc_zero
         asm volatile("hlt");  // Wait for interrupts
     }
 
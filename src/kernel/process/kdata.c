@@ -0,0 +1,80 @@
+#include "kdata.h"
+#include "clock.h"
+#include "scheduler.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "atomics.h"
+#include "klib.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+static kdata_page_t* kdata = NULL;      // Identity mapping физической страницы
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void kdata_init(void) {
+    kdata = (kdata_page_t*)pmm_alloc_zero(1);
+    if (!kdata) {
+        kprintf("[KDATA] %[W]No memory for kernel data page - ulib_now() unavailable%[D]\n");
+        return;
+    }
+
+    kdata->version = KDATA_VERSION;
+    kdata->tsc_hz = clock_tsc_hz() ? clock_tsc_hz() : CLOCK_TSC_HZ_FALLBACK;
+    kdata->tsc_base = clock_tsc_base();
+    kdata->tick_hz = CLOCK_TICK_HZ;
+    kdata->tsc_per_tick = kdata->tsc_hz / CLOCK_TICK_HZ;
+    kdata->flags = clock_tsc_invariant() ? KDATA_FLAG_TSC_INVARIANT : 0;
+    kdata->ns_mult = (1000000000ULL << 32) / kdata->tsc_hz;
+    kdata_update();
+
+    kprintf("[KDATA] Kernel data page phys=0x%p -> user 0x%lx (read-only)\n",
+            (void*)kdata, KDATA_USER_VADDR);
+}
+
+int kdata_map(void* vmm_context) {
+    if (!kdata) {
+        return 0;  // Без страницы процесс работает, ulib_now() видит seq/version = 0
+    }
+
+    // SHARED: страница общая, vmm_destroy_context не возвращает её в PMM
+    vmm_map_result_t result = vmm_map_pages((vmm_context_t*)vmm_context, KDATA_USER_VADDR,
+                                            (uint64_t)kdata, 1,
+                                            VMM_FLAGS_USER_RO | VMM_FLAG_SHARED);
+    if (!result.success) {
+        kprintf("[KDATA] ERROR: Failed to map kernel data page: %s\n",
+                result.error_msg ? result.error_msg : "unknown");
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// UPDATE
+// ============================================================================
+
+void kdata_update(void) {
+    if (!kdata) {
+        return;
+    }
+
+    uint64_t tsc = rdtsc();
+
+    kdata->seq++;  // Нечётный: читатели повторят
+    COMPILER_BARRIER();
+
+    kdata->ns_base_tsc = tsc;
+    kdata->ns_base = clock_tsc_to_ns(tsc);
+    kdata->context_switches = scheduler_stats.context_switches;
+    kdata->preemptions = scheduler_stats.preemptions;
+    kdata->voluntary_yields = scheduler_stats.voluntary_yields;
+    kdata->scheduler_ticks = scheduler_stats.total_ticks;
+    kdata->updates++;
+
+    COMPILER_BARRIER();
+    kdata->seq++;
+}
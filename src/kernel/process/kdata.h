@@ -0,0 +1,69 @@
+#ifndef KDATA_H
+#define KDATA_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// KERNEL DATA PAGE - общая read-only страница для всех процессов (vDSO-style)
+// ============================================================================
+//
+// Одна физическая страница, отображается в каждый процесс по KDATA_USER_VADDR
+// (User, read-only). Время читается без kernel_notify и без события через
+// Guide / Hardware deck / Execution deck:
+//
+//   ns    = ns_base + ((rdtsc() - ns_base_tsc) * ns_mult) >> 32
+//   ticks = (rdtsc() - tsc_base) / tsc_per_tick      (= clock_ticks())
+//
+// ns_mult округлён вниз, поэтому внутри интервала оценка не обгоняет
+// clock_ns(), а следующий снимок её не откатывает - время монотонно.
+// Формула верна, пока rdtsc() - ns_base_tsc < tsc_hz (~1 s, без переполнения);
+// дальше - деление от tsc_base, как clock_ns(). Снимок обновляет timer
+// interrupt на BSP (kdata_update), то есть не реже CLOCK_IDLE_MAX_MS.
+//
+// Согласованность - seqlock: seq нечётный, пока kernel пишет; читатель
+// повторяет, если seq был нечётный или изменился. User процессы работают
+// только на BSP, TSC для них один.
+//
+// Layout - ABI с userspace (ulib.h), поля только дописываются в конец.
+//
+// ============================================================================
+
+#define KDATA_USER_VADDR    0x20C00000ULL   // После registered buffers (514MB + 8MB)
+#define KDATA_VERSION       1
+
+#define KDATA_FLAG_TSC_INVARIANT  0x01      // TSC не стоит в C-states
+
+typedef struct {
+    volatile uint32_t seq;          // Seqlock
+    uint32_t version;               // KDATA_VERSION
+
+    // Clocksource (не меняется после kdata_init)
+    uint64_t tsc_hz;                // clock_tsc_hz()
+    uint64_t tsc_base;              // TSC в момент clock_init (ns = 0, tick = 0)
+    uint64_t tsc_per_tick;          // tsc_hz / tick_hz
+    uint32_t tick_hz;               // CLOCK_TICK_HZ
+    uint32_t flags;                 // KDATA_FLAG_*
+
+    // Снимок времени (kdata_update)
+    uint64_t ns_base_tsc;           // TSC снимка
+    uint64_t ns_base;               // clock_ns() в ns_base_tsc
+    uint64_t ns_mult;               // (1e9 << 32) / tsc_hz
+
+    // Scheduler (копия scheduler_stats на момент снимка)
+    uint64_t context_switches;
+    uint64_t preemptions;
+    uint64_t voluntary_yields;
+    uint64_t scheduler_ticks;
+    uint64_t updates;               // Число снимков
+} kdata_page_t;
+
+// Страница и постоянные поля (после clock_init)
+void kdata_init(void);
+
+// Отобразить страницу в контекст процесса (vmm_context_t*). 0 = ok
+int kdata_map(void* vmm_context);
+
+// Новый снимок времени и scheduler stats (timer interrupt, BSP)
+void kdata_update(void);
+
+#endif // KDATA_H
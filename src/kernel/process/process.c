@@ -6,6 +6,9 @@
 #include "gdt.h"
 #include "atomics.h"
 #include "elf_loader.h"
+#include "fpu.h"
+#include "smp.h"
+#include "kdata.h"
 
 // ============================================================================
 // GLOBAL STATE
@@ -27,13 +30,116 @@ void process_init(void) {
     current_process = 0;
 
     kprintf("[PROCESS] Process table initialized (max %d processes)\n", PROCESS_MAX_COUNT);
+
+    kdata_init();
+}
+
+// ============================================================================
+// RING NEGOTIATION
+// ============================================================================
+
+// Итоговая геометрия rings процесса (после clamp запроса)
+typedef struct {
+    uint32_t format;
+    uint32_t event_units;
+    uint32_t result_units;
+    uint32_t max_entry_units;
+    uint64_t event_bytes;
+    uint64_t result_bytes;
+} process_ring_layout_t;
+
+// Степень 2 в [COMPACT_RING_MIN_UNITS, COMPACT_RING_MAX_UNITS]
+static uint32_t process_ring_units_clamp(uint32_t requested) {
+    if (requested == 0) {
+        requested = COMPACT_RING_DEFAULT_UNITS;
+    }
+    uint32_t units = COMPACT_RING_MIN_UNITS;
+    while (units < requested && units < COMPACT_RING_MAX_UNITS) {
+        units <<= 1;
+    }
+    return units;
+}
+
+static void process_ring_negotiate(const process_ring_config_t* config,
+                                   process_ring_layout_t* layout) {
+    if (!config || config->format != PROCESS_RING_FORMAT_COMPACT) {
+        layout->format = PROCESS_RING_FORMAT_FIXED;
+        layout->event_units = EVENT_RING_SIZE;
+        layout->result_units = RESULT_RING_SIZE;
+        layout->max_entry_units = 0;
+        layout->event_bytes = sizeof(EventRing);
+        layout->result_bytes = sizeof(ResultRing);
+        return;
+    }
+
+    layout->format = PROCESS_RING_FORMAT_COMPACT;
+    layout->event_units = process_ring_units_clamp(config->event_ring_units);
+    layout->result_units = process_ring_units_clamp(config->result_ring_units);
+
+    // Максимум записи: от одного unit до полного payload, и не больше
+    // половины меньшего ring (иначе PAD при wrap может не оставить места)
+    uint64_t max_size = config->max_entry_size ? config->max_entry_size
+                                               : sizeof(CompactEvent) + EVENT_PAYLOAD_SIZE;
+    uint32_t max_units = (uint32_t)wf_compact_units(max_size);
+    uint32_t limit = (uint32_t)wf_compact_units(sizeof(CompactEvent) + EVENT_PAYLOAD_SIZE);
+    uint32_t smaller = layout->event_units < layout->result_units ? layout->event_units
+                                                                  : layout->result_units;
+    if (limit > smaller / 2) {
+        limit = smaller / 2;
+    }
+    if (max_units > limit) {
+        max_units = limit;
+    }
+    if (max_units == 0) {
+        max_units = 1;
+    }
+    layout->max_entry_units = max_units;
+
+    layout->event_bytes = wf_compact_ring_bytes(layout->event_units);
+    layout->result_bytes = wf_compact_ring_bytes(layout->result_units);
+}
+
+// Обнулить rings, записать согласованную геометрию, заполнить process_t
+static void process_rings_setup(process_t* proc, uint64_t rings_phys,
+                                const process_ring_layout_t* layout) {
+    // Kernel can access rings directly via identity mapping (physical == virtual in low memory)
+    void* event_ring = (void*)rings_phys;
+    void* result_ring = (void*)(rings_phys + layout->event_bytes);
+
+    memset(event_ring, 0, layout->event_bytes);
+    memset(result_ring, 0, layout->result_bytes);
+
+    if (layout->format == PROCESS_RING_FORMAT_COMPACT) {
+        CompactRing* events = (CompactRing*)event_ring;
+        CompactRing* results = (CompactRing*)result_ring;
+        events->size_units = layout->event_units;
+        events->max_entry_units = layout->max_entry_units;
+        results->size_units = layout->result_units;
+        results->max_entry_units = layout->max_entry_units;
+    }
+
+    proc->event_ring = event_ring;
+    proc->result_ring = result_ring;
+    proc->ring_format = layout->format;
+    proc->event_ring_units = layout->event_units;
+    proc->result_ring_units = layout->result_units;
+    proc->ring_max_entry_units = layout->max_entry_units;
+    proc->event_ring_consumed = 0;
+    memset(proc->event_slot_done, 0, sizeof(proc->event_slot_done));
+
+    kprintf("[PROCESS] Rings: %s, events=%u result=%u %s, max entry=%u units\n",
+            layout->format == PROCESS_RING_FORMAT_COMPACT ? "COMPACT" : "FIXED",
+            layout->event_units, layout->result_units,
+            layout->format == PROCESS_RING_FORMAT_COMPACT ? "units" : "slots",
+            layout->max_entry_units);
 }
 
 // ============================================================================
 // PROCESS CREATION
 // ============================================================================
 
-process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset) {
+process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset,
+                          const process_ring_config_t* rings) {
     // Find free slot (check PID, not state, because PROCESS_STATE_READY == 0!)
     process_t* proc = 0;
     for (int i = 0; i < PROCESS_MAX_COUNT; i++) {
@@ -52,14 +158,8 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
     proc->pid = next_pid++;
     proc->state = PROCESS_STATE_READY;
 
-    // Allocate user stack (16KB)
+    // User stack - lazy (demand paging), см. ниже после создания контекста
     uint64_t stack_pages = USER_STACK_SIZE / PMM_PAGE_SIZE;
-    uint64_t stack_phys = (uint64_t)pmm_alloc(stack_pages);
-
-    if (!stack_phys) {
-        kprintf("[PROCESS] ERROR: Failed to allocate user stack!\n");
-        return 0;
-    }
 
     // Allocate user code pages
     uint64_t code_pages = (code_size + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE;
@@ -67,7 +167,6 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
 
     if (!code_phys) {
         kprintf("[PROCESS] ERROR: Failed to allocate user code!\n");
-        pmm_free((void*)stack_phys, stack_pages);
         return 0;
     }
 
@@ -93,7 +192,6 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
     if (!ctx) {
         kprintf("[PROCESS] ERROR: Failed to create VMM context!\n");
         pmm_free((void*)code_phys, code_pages);
-        pmm_free((void*)stack_phys, stack_pages);
         return 0;
     }
 
@@ -105,7 +203,6 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
     // This ensures user mappings never overlap with kernel's identity mapping,
     // preventing protection faults when transitioning to Ring 3.
     uint64_t user_code_virt = 0x20000000ULL;                    // 512MB
-    uint64_t user_stack_virt = 0x20100000ULL;                   // 513MB
     uint64_t user_rings_virt = 0x20200000ULL;                   // 514MB
 
     // Map user code (Present + User, executable)
@@ -116,20 +213,25 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
         kprintf("[PROCESS] ERROR: Failed to map user code: %s\n",
                 code_result.error_msg ? code_result.error_msg : "unknown");
         pmm_free((void*)code_phys, code_pages);
-        pmm_free((void*)stack_phys, stack_pages);
         return 0;
     }
 
-    // Map user stack (Present + User + Writable)
-    vmm_map_result_t stack_result = vmm_map_pages(ctx, user_stack_virt, stack_phys,
-                                                   stack_pages, VMM_FLAGS_USER_RW);
+    // User stack (Present + User + Writable): только адреса в дереве регионов
+    // контекста, страницы - нулевые из page fault при первом push. Свободные
+    // при destroy - вместе с контекстом
+    uint64_t user_stack_virt = (uint64_t)vmm_alloc_pages_lazy(ctx, stack_pages, VMM_FLAGS_USER_RW);
+
+    if (!user_stack_virt) {
+        kprintf("[PROCESS] ERROR: Failed to reserve user stack: %s\n", vmm_get_last_error());
+        vmm_unmap_pages(ctx, user_code_virt, code_pages);
+        pmm_free((void*)code_phys, code_pages);
+        return 0;
+    }
 
-    if (!stack_result.success) {
-        kprintf("[PROCESS] ERROR: Failed to map user stack: %s\n",
-                stack_result.error_msg ? stack_result.error_msg : "unknown");
+    // Kernel data page (время и scheduler stats без kernel_notify, kdata.h)
+    if (kdata_map(ctx) != 0) {
         vmm_unmap_pages(ctx, user_code_virt, code_pages);
         pmm_free((void*)code_phys, code_pages);
-        pmm_free((void*)stack_phys, stack_pages);
         return 0;
     }
 
@@ -137,8 +239,10 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
     // ALLOCATE SHARED RING BUFFERS (EventRing + ResultRing)
     // ========================================================================
 
-    // Calculate pages needed dynamically based on ring buffer sizes
-    size_t total_rings_size = sizeof(EventRing) + sizeof(ResultRing);
+    // Calculate pages needed dynamically based on negotiated ring geometry
+    process_ring_layout_t layout;
+    process_ring_negotiate(rings, &layout);
+    size_t total_rings_size = layout.event_bytes + layout.result_bytes;
     uint64_t rings_pages = (total_rings_size + 4095) / 4096;  // Round up to pages
 
     kprintf("[PROCESS] Ring buffers: %zu bytes (%lu pages)\n",
@@ -147,20 +251,13 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
 
     if (!rings_phys) {
         kprintf("[PROCESS] ERROR: Failed to allocate ring buffers!\n");
-        vmm_unmap_pages(ctx, user_stack_virt, stack_pages);
         vmm_unmap_pages(ctx, user_code_virt, code_pages);
         pmm_free((void*)code_phys, code_pages);
-        pmm_free((void*)stack_phys, stack_pages);
         return 0;
     }
 
-    // Kernel can access rings directly via identity mapping (physical == virtual in low memory)
-    EventRing* event_ring = (EventRing*)rings_phys;
-    ResultRing* result_ring = (ResultRing*)(rings_phys + sizeof(EventRing));
-
-    // Initialize rings (zero-initialize)
-    memset(event_ring, 0, sizeof(EventRing));
-    memset(result_ring, 0, sizeof(ResultRing));
+    // Initialize rings (zero-initialize + negotiated geometry)
+    process_rings_setup(proc, rings_phys, &layout);
 
     kprintf("[PROCESS] Initialized ring buffers (phys=0x%lx, %lu pages)\n",
             rings_phys, rings_pages);
@@ -173,10 +270,8 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
         kprintf("[PROCESS] ERROR: Failed to map ring buffers to user space: %s\n",
                 rings_result.error_msg ? rings_result.error_msg : "unknown");
         pmm_free((void*)rings_phys, rings_pages);
-        vmm_unmap_pages(ctx, user_stack_virt, stack_pages);
         vmm_unmap_pages(ctx, user_code_virt, code_pages);
         pmm_free((void*)code_phys, code_pages);
-        pmm_free((void*)stack_phys, stack_pages);
         return 0;
     }
 
@@ -189,16 +284,16 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
     proc->code_phys = code_phys;
     proc->code_size = code_size;
     proc->stack_base = user_stack_virt;
-    proc->stack_phys = stack_phys;
+    proc->stack_phys = 0;  // Lazy: страниц ещё нет
     proc->rsp = user_stack_virt + USER_STACK_SIZE - 16;  // Top of stack
     proc->rbp = proc->rsp;
 
-    // Ring buffers
-    proc->event_ring = event_ring;
-    proc->result_ring = result_ring;
+    // Ring buffers (event_ring/result_ring - process_rings_setup)
     proc->rings_phys = rings_phys;
     proc->rings_user_vaddr = user_rings_virt;
     proc->rings_pages = rings_pages;
+    spinlock_init(&proc->event_ring_lock);
+    proc->event_ring_throttled = 0;
 
     // Set entry point to VIRTUAL address
     proc->rip = user_code_virt + entry_offset;
@@ -218,17 +313,25 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
     // Statistics
     proc->syscall_count = 0;
     proc->current_workflow_id = 0;
+    proc->sqpoll_active = 0;
+    proc->sqpoll_workflow_id = 0;
+    proc->sqpoll_last_active = 0;
     proc->creation_time = rdtsc();
     proc->last_syscall_tick = 0;  // Will be set on first syscall
+    proc->watchdog_mark = 0;
+    proc->watchdog_ticks = 0;
+
+    // Scheduling: средний приоритет, runqueue создающего CPU
+    proc->priority = PROCESS_PRIORITY_DEFAULT;
+    proc->run_cpu = smp_current_cpu();
 
     kprintf("[PROCESS] Created process PID=%lu\n", proc->pid);
     kprintf("[PROCESS]   Code: 0x%p -> 0x%p (phys: 0x%p, %lu bytes)\n",
             (void*)proc->code_base, (void*)(proc->code_base + proc->code_size),
             (void*)code_phys, proc->code_size);
     kprintf("[PROCESS]   Entry: 0x%p\n", (void*)proc->rip);
-    kprintf("[PROCESS]   Stack: 0x%p -> 0x%p (phys: 0x%p)\n",
-            (void*)proc->stack_base, (void*)(proc->stack_base + USER_STACK_SIZE),
-            (void*)stack_phys);
+    kprintf("[PROCESS]   Stack: 0x%p -> 0x%p (demand paged)\n",
+            (void*)proc->stack_base, (void*)(proc->stack_base + USER_STACK_SIZE));
     kprintf("[PROCESS]   Rings: user=0x%p, phys=0x%p (%lu pages)\n",
             (void*)proc->rings_user_vaddr, (void*)proc->rings_phys, rings_pages);
     kprintf("[PROCESS]     EventRing: kernel=0x%p\n", proc->event_ring);
@@ -242,7 +345,8 @@ process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset)
 // PROCESS CREATION FROM ELF
 // ============================================================================
 
-process_t* process_create_elf(const void* elf_data, uint64_t elf_size) {
+process_t* process_create_elf(const void* elf_data, uint64_t elf_size,
+                              const process_ring_config_t* rings) {
     if (!elf_data || elf_size == 0) {
         kprintf("[PROCESS] ERROR: Invalid ELF data\n");
         return 0;
@@ -301,79 +405,73 @@ process_t* process_create_elf(const void* elf_data, uint64_t elf_size) {
         return 0;
     }
 
-    // Allocate user stack (16KB)
+    // User stack (16KB) - lazy, как в process_create
     uint64_t stack_pages = USER_STACK_SIZE / PMM_PAGE_SIZE;
-    uint64_t stack_phys = (uint64_t)pmm_alloc(stack_pages);
-
-    if (!stack_phys) {
-        kprintf("[PROCESS] ERROR: Failed to allocate user stack!\n");
+    uint64_t user_stack_virt = (uint64_t)vmm_alloc_pages_lazy(ctx, stack_pages, VMM_FLAGS_USER_RW);
+    if (!user_stack_virt) {
+        kprintf("[PROCESS] ERROR: Failed to reserve stack!\n");
         vmm_destroy_context(ctx);
+        elf_image_release(info.image);
         proc->pid = 0;
         return 0;
     }
 
-    // Map stack into process address space
-    uint64_t user_stack_virt = 0x7FFFFFFF0000ULL;  // High address, below canonical hole
-    vmm_map_result_t map_result = vmm_map_pages(ctx, user_stack_virt, stack_phys, stack_pages,
-                                                VMM_FLAGS_USER_RW);
-    if (!map_result.success) {
-        kprintf("[PROCESS] ERROR: Failed to map stack!\n");
-        pmm_free((void*)stack_phys, stack_pages);
+    // Kernel data page - как в process_create
+    if (kdata_map(ctx) != 0) {
         vmm_destroy_context(ctx);
+        elf_image_release(info.image);
         proc->pid = 0;
         return 0;
     }
 
     // Allocate and map ring buffers (same as in process_create)
-    size_t event_ring_size = sizeof(EventRing);
-    size_t result_ring_size = sizeof(ResultRing);
-    size_t rings_total = event_ring_size + result_ring_size;
+    process_ring_layout_t layout;
+    process_ring_negotiate(rings, &layout);
+    size_t rings_total = layout.event_bytes + layout.result_bytes;
     uint64_t rings_pages = (rings_total + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE;
     uint64_t rings_phys = (uint64_t)pmm_alloc(rings_pages);
 
     if (!rings_phys) {
         kprintf("[PROCESS] ERROR: Failed to allocate ring buffers!\n");
-        pmm_free((void*)stack_phys, stack_pages);
         vmm_destroy_context(ctx);
+        elf_image_release(info.image);
         proc->pid = 0;
         return 0;
     }
 
-    // Clear ring buffers
+    // Clear ring buffers (хвост последней страницы тоже)
     memset((void*)rings_phys, 0, rings_pages * PMM_PAGE_SIZE);
-
-    // Get kernel virtual addresses for rings
-    EventRing* event_ring = (EventRing*)rings_phys;
-    ResultRing* result_ring = (ResultRing*)(rings_phys + event_ring_size);
+    process_rings_setup(proc, rings_phys, &layout);
 
     // Map rings to user space
     uint64_t user_rings_virt = 0x20200000;
-    map_result = vmm_map_pages(ctx, user_rings_virt, rings_phys, rings_pages,
-                               VMM_FLAGS_USER_RW);
+    vmm_map_result_t map_result = vmm_map_pages(ctx, user_rings_virt, rings_phys, rings_pages,
+                                                VMM_FLAGS_USER_RW);
     if (!map_result.success) {
         kprintf("[PROCESS] ERROR: Failed to map ring buffers!\n");
         pmm_free((void*)rings_phys, rings_pages);
-        pmm_free((void*)stack_phys, stack_pages);
         vmm_destroy_context(ctx);
+        elf_image_release(info.image);
         proc->pid = 0;
         return 0;
     }
 
     // Store addresses
     proc->code_base = info.base_addr;
-    proc->code_phys = 0;  // ELF loader handles this
+    proc->code_phys = 0;  // Страницы кэша образов (elf_image)
     proc->code_size = info.total_size;
+    proc->elf_image = info.image;
     proc->stack_base = user_stack_virt;
-    proc->stack_phys = stack_phys;
+    proc->stack_phys = 0;  // Lazy
     proc->rsp = user_stack_virt + USER_STACK_SIZE - 16;
     proc->rbp = proc->rsp;
 
-    // Ring buffers
-    proc->event_ring = event_ring;
-    proc->result_ring = result_ring;
+    // Ring buffers (event_ring/result_ring - process_rings_setup)
     proc->rings_phys = rings_phys;
     proc->rings_user_vaddr = user_rings_virt;
     proc->rings_pages = rings_pages;
+    spinlock_init(&proc->event_ring_lock);
+    proc->event_ring_throttled = 0;
 
     // Entry point from ELF
     proc->rip = entry;
@@ -391,8 +489,17 @@ process_t* process_create_elf(const void* elf_data, uint64_t elf_size) {
     // Statistics
     proc->syscall_count = 0;
     proc->current_workflow_id = 0;
+    proc->sqpoll_active = 0;
+    proc->sqpoll_workflow_id = 0;
+    proc->sqpoll_last_active = 0;
     proc->creation_time = rdtsc();
     proc->last_syscall_tick = 0;
+    proc->watchdog_mark = 0;
+    proc->watchdog_ticks = 0;
+
+    // Scheduling: средний приоритет, runqueue создающего CPU
+    proc->priority = PROCESS_PRIORITY_DEFAULT;
+    proc->run_cpu = smp_current_cpu();
 
     kprintf("[PROCESS] Created ELF process PID=%lu\n", proc->pid);
     kprintf("[PROCESS]   Entry: 0x%lx\n", proc->rip);
@@ -427,7 +534,10 @@ void process_enter_usermode(process_t* proc) {
     // CRITICAL: Switch to process page directory BEFORE entering user mode!
     // User code/stack are mapped in process's page tables, not kernel's
     kprintf("[PROCESS] Switching to process CR3...\n");
-    asm volatile("mov %0, %%cr3" : : "r"(proc->cr3) : "memory");
+    vmm_switch_context((vmm_context_t*)proc->vmm_context);
+
+    // Lazy FPU: первое SIMD обращение процесса выделит и загрузит его state
+    fpu_switch_to(proc);
 
     // Update TSS RSP0 for this process (kernel stack for syscalls)
     extern void tss_set_rsp0(uint64_t rsp0);
@@ -494,14 +604,51 @@ void process_destroy(process_t* proc) {
     uint64_t cr3 = proc->cr3;
     uint64_t code_phys = proc->code_phys;
     uint64_t code_pages = proc->code_size > 0 ? (proc->code_size + 4095) / 4096 : 0;
-    uint64_t stack_phys = proc->stack_phys;
+    uint64_t stack_base = proc->stack_base;
     uint64_t stack_pages = USER_STACK_SIZE / 4096;
     uint64_t rings_phys = proc->rings_phys;
     uint64_t rings_pages = proc->rings_pages;
 
     kprintf("[PROCESS] Destroying process PID=%lu (exit_code=%d)...\n", pid, proc->exit_code);
+
+    // SQPOLL poller (AP) читает EventRing без syscall'а процесса: дождаться,
+    // пока он выйдет из ingestion, и отцепить ring до освобождения страниц
+    spin_lock(&proc->event_ring_lock);
+    atomic_store_u32(&proc->sqpoll_active, 0);
+    proc->event_ring = NULL;
+    spin_unlock(&proc->event_ring_lock);
+
+    // Процесс мог умереть в WAIT - убрать из wait queue до memset
+    extern void scheduler_wait_cancel(process_t* proc);
+    scheduler_wait_cancel(proc);
+
+    // И из runqueue (watchdog / exit могли застать его готовым)
+    extern void scheduler_remove_process(process_t* proc);
+    scheduler_remove_process(proc);
+
+    // Parked results (ResultRing был полон) больше некому читать
+    extern void execution_deck_drop_overflow(process_t* proc);
+    execution_deck_drop_overflow(proc);
+
+    // FPU state (и владение регистрами, если процесс был owner)
+    fpu_process_release(proc);
+
+    // Streaming sessions Operations deck (running state, ключи шифрования)
+    extern void operations_stream_release_owner(uint64_t owner_pid);
+    operations_stream_release_owner(pid);
+
+    // Открытые файлы Storage deck (FD процесса больше никто не закроет)
+    extern void storage_deck_release_owner(uint64_t owner_pid);
+    storage_deck_release_owner(pid);
+
+    // Ждущие события Hardware / Network decks (console read, NET_RECV) -
+    // иначе они забрали бы клавиши и кадры живых процессов
+    extern void hardware_deck_release_owner(uint64_t owner_pid);
+    hardware_deck_release_owner(pid);
+    extern void network_deck_release_owner(uint64_t owner_pid);
+    network_deck_release_owner(pid);
     kprintf("[PROCESS]   Code: 0x%lx (%lu pages)\n", code_phys, code_pages);
-    kprintf("[PROCESS]   Stack: 0x%lx (%lu pages)\n", stack_phys, stack_pages);
+    kprintf("[PROCESS]   Stack: 0x%lx (%lu pages, demand paged)\n", stack_base, stack_pages);
     kprintf("[PROCESS]   Rings: 0x%lx (%lu pages)\n", rings_phys, rings_pages);
     kprintf("[PROCESS]   CR3: 0x%lx\n", cr3);
 
@@ -516,7 +663,7 @@ void process_destroy(process_t* proc) {
         panic("process_destroy: no kernel context");
     }
 
-    asm volatile("mov %0, %%cr3" : : "r"(kernel_ctx->pml4_phys) : "memory");
+    vmm_switch_context(kernel_ctx);
 
     // ========================================================================
     // CLEANUP: VMM Context (page tables + all mapped memory)
@@ -531,6 +678,17 @@ void process_destroy(process_t* proc) {
         kprintf("[PROCESS]   WARNING: Process had no VMM context\n");
     }
 
+    // Образ ELF - только когда его страницы больше нигде не отображены
+    elf_image_release((ElfImage*)proc->elf_image);
+    proc->elf_image = NULL;
+
+    // Registered buffers (SHARED - context их не освободил): страницы уйдут,
+    // когда их отпустит последний entry в полёте
+    for (uint32_t i = 0; i < proc->reg_buffer_count; i++) {
+        process_reg_pin_release(proc->reg_buffers[i].pin);
+    }
+    proc->reg_buffer_count = 0;
+
     // ========================================================================
     // CLEANUP: Ring buffers (EventRing + ResultRing are in rings_phys)
     // ========================================================================
@@ -717,6 +875,113 @@ process_t* process_get_by_index(int index) {
     return &process_table[index];
 }
 
+// Find live process by PID (NULL if none / ZOMBIE)
+process_t* process_find_by_pid(uint64_t pid) {
+    if (pid == 0) {
+        return NULL;
+    }
+    for (int i = 0; i < PROCESS_MAX_COUNT; i++) {
+        process_t* proc = &process_table[i];
+        if (proc->pid == pid && proc->state != PROCESS_STATE_ZOMBIE) {
+            return proc;
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// REGISTERED BUFFERS
+// ============================================================================
+
+// Буфер выделяется один раз и отображён до смерти процесса. Страницы
+// отображены VMM_FLAG_SHARED - vmm_destroy_context() их не освобождает:
+// ими владеет pin (процесс + entries, которые ещё читают буфер)
+int64_t process_register_buffer(process_t* proc, uint64_t size) {
+    // DEFENSIVE: Validate input
+    if (!proc || !proc->vmm_context) {
+        return -1;
+    }
+    if (size == 0 || size > REG_BUFFER_MAX_SIZE) {
+        kprintf("[PROCESS] ERROR: PID=%lu register buffer: bad size %lu (max %u)\n",
+                proc->pid, size, REG_BUFFER_MAX_SIZE);
+        return -1;
+    }
+    if (proc->reg_buffer_count >= REG_BUFFER_MAX_COUNT) {
+        kprintf("[PROCESS] ERROR: PID=%lu register buffer: limit %d reached\n",
+                proc->pid, REG_BUFFER_MAX_COUNT);
+        return -1;
+    }
+
+    uint64_t pages = (size + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE;
+    uint64_t phys = (uint64_t)pmm_alloc_zero(pages);
+    if (!phys) {
+        kprintf("[PROCESS] ERROR: PID=%lu register buffer: no memory (%lu pages)\n",
+                proc->pid, pages);
+        return -1;
+    }
+
+    process_reg_pin_t* pin = (process_reg_pin_t*)kmalloc(sizeof(process_reg_pin_t));
+    if (!pin) {
+        pmm_free((void*)phys, pages);
+        return -1;
+    }
+    pin->refs = 1;  // Процесс
+    pin->phys = phys;
+    pin->pages = pages;
+
+    uint32_t index = proc->reg_buffer_count;
+    uint64_t user_vaddr = REG_BUFFER_USER_BASE + (uint64_t)index * REG_BUFFER_MAX_SIZE;
+
+    vmm_map_result_t result = vmm_map_pages((vmm_context_t*)proc->vmm_context, user_vaddr,
+                                            phys, pages, VMM_FLAGS_USER_RW | VMM_FLAG_SHARED);
+    if (!result.success) {
+        kprintf("[PROCESS] ERROR: PID=%lu register buffer: map failed: %s\n",
+                proc->pid, result.error_msg ? result.error_msg : "unknown");
+        kfree(pin);
+        pmm_free((void*)phys, pages);
+        return -1;
+    }
+
+    process_reg_buffer_t* buffer = &proc->reg_buffers[index];
+    buffer->phys = phys;
+    buffer->size = pages * PMM_PAGE_SIZE;
+    buffer->user_vaddr = user_vaddr;
+    buffer->pin = pin;
+    proc->reg_buffer_count = index + 1;
+
+    kprintf("[PROCESS] PID=%lu registered buffer %u: %lu bytes at 0x%lx (phys=0x%lx)\n",
+            proc->pid, index, buffer->size, user_vaddr, phys);
+    return index;
+}
+
+void* process_reg_buffer_pin(process_t* proc, uint32_t index, uint64_t offset, uint64_t length,
+                             process_reg_pin_t** pin) {
+    if (!proc || index >= proc->reg_buffer_count) {
+        return NULL;
+    }
+
+    process_reg_buffer_t* buffer = &proc->reg_buffers[index];
+
+    // DEFENSIVE: offset + length без переполнения
+    if (offset > buffer->size || length > buffer->size - offset) {
+        return NULL;
+    }
+
+    atomic_increment_u64(&buffer->pin->refs);
+    *pin = buffer->pin;
+
+    // Kernel видит страницы буфера через identity mapping
+    return (void*)(uintptr_t)(buffer->phys + offset);
+}
+
+void process_reg_pin_release(process_reg_pin_t* pin) {
+    if (!pin || atomic_decrement_u64(&pin->refs) != 0) {
+        return;
+    }
+    pmm_free((void*)pin->phys, pin->pages);
+    kfree(pin);
+}
+
 // Get all processes (for watchdog and monitoring)
 process_t* process_get_all(uint64_t* count) {
     if (count) {
@@ -2,6 +2,8 @@
 #define PROCESS_H
 
 #include "ktypes.h"
+#include "klib.h"
+#include "workflow_rings.h"
 
 // ============================================================================
 // PROCESS MANAGEMENT - User Mode Support
@@ -16,6 +18,44 @@
 #define PROCESS_MAX_COUNT   64
 #define USER_STACK_SIZE     (16 * 1024)  // 16KB user stack
 
+// Уровни приоритета scheduler (0 = высший). Новый процесс - в середине,
+// wake после WAIT поднимает наверх, выработанный time slice опускает на уровень
+#define PROCESS_PRIORITY_LEVELS   8
+#define PROCESS_PRIORITY_DEFAULT  3
+
+// Страницы registered buffer и их держатели: процесс + entries в полёте
+// (RoutingEntry.buffer_pin). Последний release возвращает страницы в PMM -
+// entry, которому процесс отдал буфер, может пережить его смерть
+typedef struct {
+    volatile uint64_t refs;
+    uint64_t phys;
+    uint64_t pages;
+} process_reg_pin_t;
+
+// Registered buffer (NOTIFY_REGISTER_BUFFER) - физически непрерывные страницы,
+// kernel видит их через identity mapping, user - по REG_BUFFER_USER_BASE
+typedef struct {
+    uint64_t phys;                  // Физический адрес (= kernel адрес)
+    uint64_t size;                  // Размер в байтах (кратен странице)
+    uint64_t user_vaddr;            // Адрес в user space
+    process_reg_pin_t* pin;         // Владение страницами (не vmm context)
+} process_reg_buffer_t;
+
+// Формат shared rings (согласуется при создании процесса)
+#define PROCESS_RING_FORMAT_FIXED    0   // RingEvent/RingResult по 576 байт (default)
+#define PROCESS_RING_FORMAT_COMPACT  1   // CompactRing: variable-length записи по 64 байта
+
+// Запрос геометрии rings в process_create / process_create_elf (NULL = FIXED).
+// Kernel округляет до степени 2 и ограничивает COMPACT_RING_MIN/MAX_UNITS,
+// итог пишется в CompactRing.size_units / max_entry_units (по ним ulib
+// узнаёт формат, у FIXED там нули)
+typedef struct {
+    uint32_t format;                // PROCESS_RING_FORMAT_*
+    uint32_t event_ring_units;      // 0 = COMPACT_RING_DEFAULT_UNITS
+    uint32_t result_ring_units;     // 0 = COMPACT_RING_DEFAULT_UNITS
+    uint32_t max_entry_size;        // Байт на запись с header (0 = header + EVENT_PAYLOAD_SIZE)
+} process_ring_config_t;
+
 // Process state
 typedef enum {
     PROCESS_STATE_READY = 0,
@@ -25,7 +65,7 @@ typedef enum {
 } process_state_t;
 
 // Process structure
-typedef struct {
+typedef struct process {
     uint64_t pid;                   // Process ID
     process_state_t state;          // Current state
 
@@ -44,10 +84,11 @@ typedef struct {
     uint64_t cr3;                   // Page directory base (physical address)
     void* vmm_context;              // VMM context (vmm_context_t*) - per-process page tables
     uint64_t stack_base;            // User stack base (virtual)
-    uint64_t stack_phys;            // User stack base (physical)
+    uint64_t stack_phys;            // User stack base (physical), 0 - lazy (demand paging)
     uint64_t code_base;             // User code base (virtual)
     uint64_t code_phys;             // User code base (physical)
     uint64_t code_size;             // User code size
+    void* elf_image;                // ElfImage* (process_create_elf): общие страницы кода, отпускается после контекста
 
     // Shared ring buffers (async workflow communication)
     void* event_ring;               // EventRing* (kernel virtual address)
@@ -56,14 +97,58 @@ typedef struct {
     uint64_t rings_user_vaddr;      // User virtual address of ring buffers
     uint64_t rings_pages;           // Number of pages allocated for ring buffers
 
+    // Согласованная геометрия rings (kernel-private копия, header не доверяем)
+    uint32_t ring_format;           // PROCESS_RING_FORMAT_*
+    uint32_t event_ring_units;      // FIXED: EVENT_RING_SIZE слотов
+    uint32_t result_ring_units;     // FIXED: RESULT_RING_SIZE слотов
+    uint32_t ring_max_entry_units;  // COMPACT: максимум units на запись
+
+    // Registered buffers (bulk data для событий без копирования через ring)
+    process_reg_buffer_t reg_buffers[REG_BUFFER_MAX_COUNT];
+    uint32_t reg_buffer_count;
+
+    // Zero-copy EventRing consumption (kernel-private, NOT in shared page!)
+    // EventRing.head двигается только когда слот освобождён (in-order).
+    uint64_t event_ring_consumed;   // Next EventRing position kernel will read (COMPACT: в units)
+    spinlock_t event_ring_lock;     // Consumer EventRing: SUBMIT (BSP) или SQPOLL poller (AP)
+    uint32_t event_ring_throttled;  // 1 = ingestion ждёт ResultRing credit (trace раз на эпизод)
+    uint64_t event_slot_done[COMPACT_RING_MAX_UNITS / 64];  // Bitmap: slot/unit released out of order
+
+    // FPU/SSE/AVX state (fpu.c): страница pmm, NULL пока процесс не трогал SIMD
+    void* fpu_state;
+
     // Workflow integration
     uint64_t current_workflow_id;   // Currently executing workflow
     volatile uint32_t completion_ready;  // Flag: workflow completed (for WAIT)
+    volatile uint64_t workflow_instances;  // Живые WorkflowInstance (WORKFLOW_MAX_INSTANCES_PER_PROCESS)
+
+    // Result credits (backpressure ResultRing → submission)
+    volatile uint64_t results_outstanding;  // Ingested события без записанного результата
+    void* result_overflow_head;          // Parked results (ResultRing был полон), FIFO
+    void* result_overflow_tail;
+    volatile uint32_t result_overflow_count;
+
+    // Wait queue (scheduler): ключ (pid, current_workflow_id)
+    struct process* wait_next;           // Следующий в bucket wait queue
+    uint32_t wait_queued;                // 1 = стоит в wait queue
+
+    // Runqueue (scheduler): FIFO уровня priority в runqueue CPU run_cpu
+    struct process* run_next;            // Следующий на том же уровне
+    uint32_t run_queued;                 // 1 = стоит в runqueue
+    uint32_t run_cpu;                    // Runqueue процесса (wake, yield возвращают сюда)
+    uint32_t priority;                   // 0..PROCESS_PRIORITY_LEVELS-1, 0 = высший
+
+    // SQPOLL: Guide polls EventRing.tail instead of waiting for SUBMIT
+    volatile uint32_t sqpoll_active;     // 1 = Guide polls this process's EventRing
+    uint64_t sqpoll_workflow_id;         // Workflow registered with NOTIFY_SQPOLL
+    uint64_t sqpoll_last_active;         // TSC поллера: последний непустой EventRing (0 = ещё нет)
 
     // Statistics
     uint64_t syscall_count;         // Number of syscalls made
     uint64_t creation_time;         // RDTSC at creation
     uint64_t last_syscall_tick;     // Timer tick at last syscall (for watchdog)
+    uint64_t watchdog_mark;         // last_syscall_tick, от которого идёт отсчёт watchdog
+    uint64_t watchdog_ticks;        // Тиков на CPU с последнего syscall
     int exit_code;                  // Exit code (when ZOMBIE)
 
 } process_t;
@@ -76,11 +161,13 @@ typedef struct {
 void process_init(void);
 
 // === PROCESS CREATION ===
-// Create a new user process from raw code buffer
-process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset);
+// Create a new user process from raw code buffer (rings = NULL: FIXED format)
+process_t* process_create(void* code, uint64_t code_size, uint64_t entry_offset,
+                          const process_ring_config_t* rings);
 
-// Create a new user process from ELF binary
-process_t* process_create_elf(const void* elf_data, uint64_t elf_size);
+// Create a new user process from ELF binary (rings = NULL: FIXED format)
+process_t* process_create_elf(const void* elf_data, uint64_t elf_size,
+                              const process_ring_config_t* rings);
 
 // === EXECUTION ===
 // Enter user mode and start executing process
@@ -93,6 +180,18 @@ void process_save_context(process_t* proc, void* interrupt_frame);
 // Called by syscall handler to restore process context
 void process_restore_context(process_t* proc, void* interrupt_frame);
 
+// === REGISTERED BUFFERS ===
+// Выделить и отобразить буфер размером size (округляется до страницы,
+// max REG_BUFFER_MAX_SIZE). Возвращает индекс или -1
+int64_t process_register_buffer(process_t* proc, uint64_t size);
+
+// Kernel-указатель на [offset, offset + length) буфера index (NULL если вне
+// границ). *pin - +1 держатель страниц буфера, отпускается
+// process_reg_pin_release(): до этого страницы не уйдут даже после exit
+void* process_reg_buffer_pin(process_t* proc, uint32_t index, uint64_t offset, uint64_t length,
+                             process_reg_pin_t** pin);
+void process_reg_pin_release(process_reg_pin_t* pin);
+
 // === SCHEDULING ===
 // Get current running process
 process_t* process_get_current(void);
@@ -118,6 +217,9 @@ void process_print_all(void);
 // Get process by index (for iteration through process table)
 process_t* process_get_by_index(int index);
 
+// Find live process by PID (NULL if not found or ZOMBIE)
+process_t* process_find_by_pid(uint64_t pid);
+
 // Get all processes (returns process_table pointer and count)
 // Used by watchdog and monitoring systems
 process_t* process_get_all(uint64_t* count);
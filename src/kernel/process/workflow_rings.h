@@ -27,13 +27,29 @@
 #define MAX_ROUTING_STEPS  8
 #define EVENT_PAYLOAD_SIZE 512
 
+// Registered buffers (NOTIFY_REGISTER_BUFFER): kernel выделяет страницы и
+// отображает буфер i по REG_BUFFER_USER_BASE + i * REG_BUFFER_MAX_SIZE
+#define REG_BUFFER_MAX_COUNT  8
+#define REG_BUFFER_MAX_SIZE   (1024 * 1024)          // 1MB на буфер
+#define REG_BUFFER_USER_BASE  0x20400000ULL          // После rings (514MB)
+
+// RingEvent.buf_flags
+#define RING_EVENT_BUF_REGISTERED  0x01   // Данные в registered buffer, не в payload
+#define RING_EVENT_MEMOIZE         0x02   // Результат можно взять из memo cache (чистые operations)
+
+// RingEvent.id после ingest: kernel пишет назначенный id в слот (FIXED формат),
+// ответ в ResultRing придёт с тем же event_id. Отклонённое событие (workflow_id,
+// payload_size, нет RoutingEntry) ответа не получит - в id пишется этот маркер.
+// Ingest идёт строго по порядку слотов, id виден раньше сдвига EventRing.head
+#define RING_EVENT_ID_REJECTED     0xFFFFFFFFFFFFFFFFULL
+
 // ============================================================================
 // RING_EVENT - User submits to Kernel via EventRing
 // ============================================================================
 // Size: 576 bytes (9 cache lines)
 typedef struct {
     // Identity (kernel fills id and timestamp)
-    uint64_t id;              // 0 при submit, kernel assigns
+    uint64_t id;              // 0 при submit, kernel assigns (см. RING_EVENT_ID_REJECTED)
     uint64_t workflow_id;     // Which workflow this event belongs to
     uint32_t type;            // EVENT_TIMER_CREATE, EVENT_FILE_READ, etc.
     uint64_t timestamp;       // rdtsc() когда kernel принял event
@@ -47,8 +63,17 @@ typedef struct {
     uint8_t payload[EVENT_PAYLOAD_SIZE];
     uint32_t payload_size;
 
+    // Bulk data: (buffer index, offset, length) в registered buffer.
+    // payload при этом несёт только параметры операции (fd, ключ и т.п.)
+    uint16_t buf_index;       // Индекс из NOTIFY_REGISTER_BUFFER
+    uint16_t buf_flags;       // RING_EVENT_BUF_* (0 = буфер не используется)
+    uint32_t buf_offset;      // Смещение в буфере
+    uint32_t buf_length;      // Длина данных
+
+    uint8_t priority;         // EVENT_PRIORITY_* (0 = NORMAL)
+
     // Padding to 576 bytes (9 * 64)
-    uint8_t _padding[20];
+    uint8_t _padding[7];
 } RingEvent __attribute__((aligned(64)));
 
 // ============================================================================
@@ -74,9 +99,15 @@ typedef struct {
 // ============================================================================
 // EVENT_RING - User → Kernel (submission queue)
 // ============================================================================
+
+// EventRing.flags (kernel пишет, user читает)
+// NEED_WAKEUP: SQPOLL-поллер ушёл в idle, нужен kernel_notify(SUBMIT|SQPOLL)
+#define EVENT_RING_FLAG_NEED_WAKEUP  0x01
+
 typedef struct {
     // Synchronization (cache-aligned to avoid false sharing)
     volatile uint64_t head __attribute__((aligned(64)));  // Kernel reads
+    volatile uint32_t flags;                              // EVENT_RING_FLAG_* (same line as head)
     volatile uint64_t tail __attribute__((aligned(64)));  // User writes
 
     // Events array (RingEvent itself is already aligned(64))
@@ -95,6 +126,108 @@ typedef struct {
     RingResult results[RESULT_RING_SIZE];
 } ResultRing;
 
+// ============================================================================
+// COMPACT RINGS - Variable-length records (PROCESS_RING_FORMAT_COMPACT)
+// ============================================================================
+//
+// Альтернатива фиксированным 576-байтным слотам, выбирается при создании
+// процесса (process_ring_config_t). Ring - массив 64-байтных units, запись
+// занимает ceil((header + payload) / 64) units:
+//   - fd / tick count / указатель результата = 1 cache line вместо 9
+//   - максимум записи согласуется при создании (max_entry_units)
+//
+// head/tail считаются в units. Запись никогда не переходит через конец
+// ring: если не помещается, producer пишет PAD запись до конца и начинает
+// с нуля. Первые 128 байт совпадают с EventRing/ResultRing (head, flags,
+// tail на тех же смещениях) - SQPOLL и NEED_WAKEUP работают без изменений.
+//
+// Геометрию kernel пишет в header, но сам использует только копию в process_t.
+//
+// ============================================================================
+
+#define COMPACT_UNIT_SIZE          64
+#define COMPACT_RING_MIN_UNITS     16
+#define COMPACT_RING_MAX_UNITS     2048        // 128KB на ring
+#define COMPACT_RING_DEFAULT_UNITS 256         // 16KB на ring
+
+// CompactHeader.flags
+#define COMPACT_FLAG_BUF_REGISTERED RING_EVENT_BUF_REGISTERED  // Event: данные в registered buffer
+#define COMPACT_FLAG_MEMOIZE        RING_EVENT_MEMOIZE         // Event: memoizable
+#define COMPACT_FLAG_PAD            0x8000                     // Пропуск до конца ring
+
+typedef struct {
+    uint16_t units;           // Длина записи в units, включая header
+    uint16_t flags;           // COMPACT_FLAG_*
+    uint32_t type;            // Event: тип события. Result: status
+} CompactHeader;
+
+// Event запись: 48 байт header, payload сразу следом (до 16 байт в 1 unit).
+// id: 0 при submit, kernel пишет назначенный id или RING_EVENT_ID_REJECTED
+// до того, как EventRing.head отпустит запись (как RingEvent.id)
+typedef struct {
+    CompactHeader header;
+    uint64_t id;
+    uint64_t workflow_id;
+    uint8_t route[MAX_ROUTING_STEPS];
+    uint32_t payload_size;
+    uint16_t buf_index;       // Registered buffer (COMPACT_FLAG_BUF_REGISTERED)
+    uint8_t priority;         // EVENT_PRIORITY_* (0 = NORMAL)
+    uint8_t _reserved;
+    uint32_t buf_offset;
+    uint32_t buf_length;
+    uint8_t payload[];
+} CompactEvent;
+
+// Result запись: 40 байт header, result сразу следом
+typedef struct {
+    CompactHeader header;     // header.type = status
+    uint64_t event_id;
+    uint64_t workflow_id;
+    uint64_t completion_time;
+    uint32_t error_code;
+    uint32_t result_size;
+    uint8_t result[];
+} CompactResult;
+
+_Static_assert(sizeof(CompactEvent) == 48, "CompactEvent header must be 48 bytes");
+_Static_assert(sizeof(CompactResult) == 40, "CompactResult header must be 40 bytes");
+
+typedef struct {
+    volatile uint64_t head __attribute__((aligned(64)));  // Consumer
+    volatile uint32_t flags;                              // EVENT_RING_FLAG_* (EventRing)
+    uint32_t size_units;                                  // Согласованный размер (степень 2)
+    uint32_t max_entry_units;                             // Согласованный максимум записи
+    volatile uint64_t tail __attribute__((aligned(64)));  // Producer
+
+    uint8_t data[] __attribute__((aligned(64)));          // size_units * COMPACT_UNIT_SIZE
+} CompactRing;
+
+_Static_assert(__builtin_offsetof(CompactRing, tail) == __builtin_offsetof(EventRing, tail),
+               "CompactRing must share EventRing header layout");
+_Static_assert(__builtin_offsetof(CompactRing, data) == __builtin_offsetof(EventRing, events),
+               "CompactRing data must start where EventRing events do");
+
+// Позиция события для release (syscall_release_event_slot): у COMPACT в
+// старших битах длина записи, чтобы освободить все её units. FIXED = 1 unit
+#define COMPACT_SLOT_UNITS_SHIFT  48
+#define COMPACT_SLOT(pos, units)  ((pos) | ((uint64_t)(units) << COMPACT_SLOT_UNITS_SHIFT))
+#define COMPACT_SLOT_POS(slot)    ((slot) & ((1ULL << COMPACT_SLOT_UNITS_SHIFT) - 1))
+#define COMPACT_SLOT_UNITS(slot)  ((uint32_t)((slot) >> COMPACT_SLOT_UNITS_SHIFT) ? \
+                                   (uint32_t)((slot) >> COMPACT_SLOT_UNITS_SHIFT) : 1)
+
+static inline uint64_t wf_compact_units(uint64_t bytes) {
+    return (bytes + COMPACT_UNIT_SIZE - 1) / COMPACT_UNIT_SIZE;
+}
+
+static inline uint64_t wf_compact_ring_bytes(uint32_t size_units) {
+    return sizeof(CompactRing) + (uint64_t)size_units * COMPACT_UNIT_SIZE;
+}
+
+// Запись по позиции pos (size_units передаётся явно: kernel не верит header)
+static inline void* wf_compact_at(CompactRing* ring, uint32_t size_units, uint64_t pos) {
+    return ring->data + (pos & (size_units - 1)) * COMPACT_UNIT_SIZE;
+}
+
 // ============================================================================
 // RING BUFFER OPERATIONS - Lock-free SPSC queues
 // ============================================================================
@@ -165,6 +298,23 @@ static inline int wf_result_ring_push(ResultRing* ring, RingResult* result) {
     return 1;  // Success
 }
 
+// Batch publish (kernel): пишем results прямо в слоты после tail,
+// потом один barrier и одно обновление tail на весь batch
+
+static inline uint64_t wf_result_ring_space(ResultRing* ring) {
+    return RESULT_RING_SIZE - (ring->tail - ring->head);
+}
+
+// Слот tail + offset (offset < wf_result_ring_space)
+static inline RingResult* wf_result_ring_slot(ResultRing* ring, uint64_t offset) {
+    return &ring->results[(ring->tail + offset) % RESULT_RING_SIZE];
+}
+
+static inline void wf_result_ring_publish(ResultRing* ring, uint64_t count) {
+    __sync_synchronize();  // Слоты видны раньше нового tail
+    ring->tail = ring->tail + count;
+}
+
 static inline RingResult* wf_result_ring_pop(ResultRing* ring) {
     uint64_t head = ring->head;
     uint64_t tail = ring->tail;
@@ -190,6 +340,76 @@ static inline int wf_result_ring_is_full(ResultRing* ring) {
     return (ring->tail - ring->head) >= RESULT_RING_SIZE;
 }
 
+// Compact rings: producer резервирует units (с PAD до конца ring при wrap),
+// пишет запись и публикует tail. Возвращает запись или NULL если нет места
+
+static inline void* wf_compact_reserve(CompactRing* ring, uint32_t size_units,
+                                       uint64_t tail, uint64_t head, uint32_t units,
+                                       uint64_t* pad_out) {
+    uint64_t offset = tail & (size_units - 1);
+    uint64_t pad = (offset + units > size_units) ? size_units - offset : 0;
+
+    if (units == 0 || units > size_units || (tail - head) + pad + units > size_units) {
+        return NULL;
+    }
+    *pad_out = pad;
+
+    if (pad) {
+        CompactHeader* skip = (CompactHeader*)wf_compact_at(ring, size_units, tail);
+        skip->units = (uint16_t)pad;
+        skip->flags = COMPACT_FLAG_PAD;
+        skip->type = 0;
+    }
+    return wf_compact_at(ring, size_units, tail + pad);
+}
+
+// User: push event (payload копируется в запись)
+static inline int wf_compact_event_push(CompactRing* ring, const CompactEvent* event,
+                                        const void* payload) {
+    uint32_t units = (uint32_t)wf_compact_units(sizeof(CompactEvent) + event->payload_size);
+    if (units > ring->max_entry_units) {
+        return 0;  // Больше согласованного максимума
+    }
+
+    uint64_t tail = ring->tail;
+    uint64_t pad = 0;
+    CompactEvent* slot = (CompactEvent*)wf_compact_reserve(ring, ring->size_units,
+                                                          tail, ring->head, units, &pad);
+    if (!slot) {
+        return 0;  // Full
+    }
+
+    *slot = *event;
+    slot->header.units = (uint16_t)units;
+    slot->id = 0;                          // Kernel assigns
+    const uint8_t* src = (const uint8_t*)payload;
+    for (uint32_t i = 0; i < event->payload_size; i++) {
+        slot->payload[i] = src[i];
+    }
+
+    __sync_synchronize();  // Запись видна раньше нового tail
+    ring->tail = tail + pad + units;
+    return 1;
+}
+
+// User: pop result (PAD пропускается). Как wf_result_ring_pop - head
+// сдвигается сразу, запись валидна до следующего оборота ring
+static inline CompactResult* wf_compact_result_pop(CompactRing* ring) {
+    while (ring->head != ring->tail) {
+        uint64_t head = ring->head;
+        CompactResult* result = (CompactResult*)wf_compact_at(ring, ring->size_units, head);
+        uint32_t units = result->header.units ? result->header.units : 1;
+
+        __sync_synchronize();  // Memory barrier
+        ring->head = head + units;
+
+        if (!(result->header.flags & COMPACT_FLAG_PAD)) {
+            return result;
+        }
+    }
+    return NULL;  // Empty
+}
+
 #endif // WORKFLOW_RING_FUNCTIONS_DEFINED
 
 #endif // WORKFLOW_RINGS_H
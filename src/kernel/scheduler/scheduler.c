@@ -2,6 +2,11 @@
 #include "klib.h"
 #include "process.h"
 #include "idt.h"  // For interrupt_frame_t
+#include "fpu.h"  // Lazy FPU switching
+#include "pmm.h"  // Zeroing pages while idle
+#include "vmm.h"  // vmm_switch_context
+#include "smp.h"  // Runqueue на CPU
+#include "clock.h"  // Kick BSP timer при wake
 #include "../eventdriven/storage/tagfs.h"  // For graceful shutdown sync
 
 // ============================================================================
@@ -27,22 +32,44 @@
 // SCHEDULER STATE
 // ============================================================================
 
-// Ready queue (simple circular list for round-robin)
-static process_t* ready_queue[PROCESS_MAX_COUNT];
-static int ready_queue_head = 0;
-static int ready_queue_tail = 0;
-static int ready_queue_count = 0;
-
-// Current running process
-static process_t* current_running = NULL;
-
-// Time slice counter (protection against infinite loops)
-static int time_slice_remaining = 0;
+// Runqueue одного CPU: FIFO каждого уровня приоритета + bitmap непустых.
+// Lock - на runqueue: wake приходит из completion IRQ на ядре Execution
+// Deck, steal - с другого CPU
+typedef struct {
+    process_t* head[PROCESS_PRIORITY_LEVELS];
+    process_t* tail[PROCESS_PRIORITY_LEVELS];
+    volatile uint32_t bitmap;                // Бит уровня = его FIFO не пуст
+    volatile uint32_t count;
+    int slice;                               // Остаток time slice текущего процесса
+    spinlock_t lock;
+} __attribute__((aligned(64))) scheduler_runqueue_t;
+
+static scheduler_runqueue_t runqueues[SMP_MAX_CPUS];
+
+// Time slice уровня: наверху короткие (интерактивные), внизу - полный
 static const int TIME_SLICE_TICKS = 10;  // 10 ticks = 100ms at 100Hz (LARGE!)
+static const int scheduler_slice_ticks[PROCESS_PRIORITY_LEVELS] = {
+    2, 2, 4, 4, 6, 6, 8, 10
+};
 
 // Statistics (exported for watchdog and other subsystems)
 scheduler_stats_t scheduler_stats = {0};
 
+// Wait queues: bucket по pid, в цепочке сравниваем (pid, workflow_id)
+#define SCHEDULER_WAIT_BUCKETS   16          // Степень 2
+#define SCHEDULER_PENDING_WAKES  64
+
+typedef struct {
+    uint64_t pid;
+    uint64_t workflow_id;                    // 0 = любой workflow
+} pending_wake_t;
+
+static process_t* wait_buckets[SCHEDULER_WAIT_BUCKETS];
+static pending_wake_t pending_wakes[SCHEDULER_PENDING_WAKES];
+static uint32_t pending_wake_count = 0;
+static int pending_wake_overflow = 0;        // Переполнение → будим всех (как раньше)
+static spinlock_t wait_lock;
+
 // ============================================================================
 // INITIALIZATION
 // ============================================================================
@@ -50,94 +77,394 @@ scheduler_stats_t scheduler_stats = {0};
 void scheduler_init(void) {
     kprintf("[SCHEDULER] Initializing event-driven hybrid scheduler...\n");
 
-    ready_queue_head = 0;
-    ready_queue_tail = 0;
-    ready_queue_count = 0;
-    current_running = NULL;
-    time_slice_remaining = TIME_SLICE_TICKS;
+    memset(runqueues, 0, sizeof(runqueues));
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        spinlock_init(&runqueues[cpu].lock);
+        runqueues[cpu].slice = TIME_SLICE_TICKS;
+    }
 
     memset(&scheduler_stats, 0, sizeof(scheduler_stats));
 
-    kprintf("[SCHEDULER] Ready queue size: %d processes\n", PROCESS_MAX_COUNT);
-    kprintf("[SCHEDULER] Time slice: %d ticks (%d ms at 100Hz) - PROTECTION ONLY\n",
-            TIME_SLICE_TICKS, TIME_SLICE_TICKS * 10);
+    memset(wait_buckets, 0, sizeof(wait_buckets));
+    pending_wake_count = 0;
+    pending_wake_overflow = 0;
+    spinlock_init(&wait_lock);
+
+    kprintf("[SCHEDULER] Runqueues: %d CPUs x %d priority levels\n",
+            SMP_MAX_CPUS, PROCESS_PRIORITY_LEVELS);
+    kprintf("[SCHEDULER] Time slice: %d-%d ticks (up to %d ms at 100Hz) - PROTECTION ONLY\n",
+            scheduler_slice_ticks[0], TIME_SLICE_TICKS, TIME_SLICE_TICKS * 10);
     kprintf("[SCHEDULER] Primary scheduling: WORKFLOW-DRIVEN (cooperative)\n");
     kprintf("[SCHEDULER] Secondary scheduling: TIMER-BASED (preemptive fallback)\n");
     kprintf("[SCHEDULER] Initialized successfully!\n");
 }
 
+// ============================================================================
+// RUNQUEUES (под rq->lock)
+// ============================================================================
+
+static void runqueue_push(scheduler_runqueue_t* rq, process_t* proc) {
+    uint32_t level = proc->priority;
+
+    proc->run_next = NULL;
+    if (rq->tail[level]) {
+        rq->tail[level]->run_next = proc;
+    } else {
+        rq->head[level] = proc;
+    }
+    rq->tail[level] = proc;
+    rq->bitmap |= 1u << level;
+    rq->count++;
+    proc->run_queued = 1;
+}
+
+// Голова высшего непустого уровня. priority процесса - уровень, с которого
+// он снят (aging сдвигает очереди, не трогая процессы)
+static process_t* runqueue_pop(scheduler_runqueue_t* rq) {
+    if (!rq->bitmap) {
+        return NULL;
+    }
+
+    uint32_t level = (uint32_t)__builtin_ctz(rq->bitmap);
+    process_t* proc = rq->head[level];
+
+    rq->head[level] = proc->run_next;
+    if (!rq->head[level]) {
+        rq->tail[level] = NULL;
+        rq->bitmap &= ~(1u << level);
+    }
+    rq->count--;
+
+    proc->run_next = NULL;
+    proc->run_queued = 0;
+    proc->priority = level;
+    return proc;
+}
+
+static int runqueue_unlink(scheduler_runqueue_t* rq, process_t* proc) {
+    for (uint32_t level = 0; level < PROCESS_PRIORITY_LEVELS; level++) {
+        process_t* prev = NULL;
+        for (process_t* p = rq->head[level]; p; prev = p, p = p->run_next) {
+            if (p != proc) {
+                continue;
+            }
+            if (prev) {
+                prev->run_next = p->run_next;
+            } else {
+                rq->head[level] = p->run_next;
+            }
+            if (rq->tail[level] == p) {
+                rq->tail[level] = prev;
+            }
+            if (!rq->head[level]) {
+                rq->bitmap &= ~(1u << level);
+            }
+            rq->count--;
+            proc->run_next = NULL;
+            proc->run_queued = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Aging: каждый уровень дописывается в конец уровня выше - batch процесс
+// под постоянным потоком wakeups всё равно дойдёт до CPU
+static void runqueue_age(scheduler_runqueue_t* rq) {
+    for (uint32_t level = 1; level < PROCESS_PRIORITY_LEVELS; level++) {
+        if (!rq->head[level]) {
+            continue;
+        }
+        if (rq->tail[level - 1]) {
+            rq->tail[level - 1]->run_next = rq->head[level];
+        } else {
+            rq->head[level - 1] = rq->head[level];
+        }
+        rq->tail[level - 1] = rq->tail[level];
+        rq->head[level] = NULL;
+        rq->tail[level] = NULL;
+    }
+    rq->bitmap = (rq->bitmap >> 1) | (rq->bitmap & 1);
+}
+
+static inline scheduler_runqueue_t* runqueue_local(void) {
+    return &runqueues[smp_current_cpu()];
+}
+
+// Готов ли хоть один процесс (без lock - для idle loop)
+static int scheduler_has_ready(void) {
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (runqueues[cpu].count > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int scheduler_needs_tick(void) {
+    return process_get_current() != NULL || scheduler_has_ready();
+}
+
+static uint32_t scheduler_ready_count(void) {
+    uint32_t total = 0;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        total += runqueues[cpu].count;
+    }
+    return total;
+}
+
+// Новый time slice текущего процесса - по его уровню
+static void scheduler_start_slice(process_t* proc) {
+    runqueue_local()->slice = scheduler_slice_ticks[proc->priority];
+}
+
 // ============================================================================
 // READY QUEUE MANAGEMENT
 // ============================================================================
 
-// Add process to ready queue (FIFO for round-robin)
+// Add process to its CPU runqueue (FIFO within priority level)
 void scheduler_add_process(process_t* proc) {
     if (!proc) {
         kprintf("[SCHEDULER] ERROR: NULL process!\n");
         return;
     }
 
-    if (ready_queue_count >= PROCESS_MAX_COUNT) {
-        kprintf("[SCHEDULER] ERROR: Ready queue full!\n");
-        return;
+    if (proc->run_cpu >= SMP_MAX_CPUS) {
+        proc->run_cpu = 0;
     }
+    if (proc->priority >= PROCESS_PRIORITY_LEVELS) {
+        proc->priority = PROCESS_PRIORITY_LEVELS - 1;
+    }
+
+    scheduler_runqueue_t* rq = &runqueues[proc->run_cpu];
+    spin_lock(&rq->lock);
 
-    // Add to tail
-    ready_queue[ready_queue_tail] = proc;
-    ready_queue_tail = (ready_queue_tail + 1) % PROCESS_MAX_COUNT;
-    ready_queue_count++;
+    if (proc->run_queued) {
+        spin_unlock(&rq->lock);
+        kprintf("[SCHEDULER] ERROR: PID=%lu already in runqueue!\n", proc->pid);
+        return;
+    }
 
+    runqueue_push(rq, proc);
     proc->state = PROCESS_STATE_READY;
+    uint32_t count = rq->count;
 
-    kprintf("[SCHEDULER] Added process PID=%lu to ready queue (count=%d)\n",
-            proc->pid, ready_queue_count);
+    spin_unlock(&rq->lock);
+
+    kprintf("[SCHEDULER] Added process PID=%lu to CPU %u runqueue (prio=%u, count=%u)\n",
+            proc->pid, proc->run_cpu, proc->priority, count);
 }
 
-// Remove process from ready queue
+// Remove process from its runqueue
 void scheduler_remove_process(process_t* proc) {
+    if (!proc || !proc->run_queued || proc->run_cpu >= SMP_MAX_CPUS) {
+        return;
+    }
+
+    scheduler_runqueue_t* rq = &runqueues[proc->run_cpu];
+    spin_lock(&rq->lock);
+    int found = proc->run_queued && runqueue_unlink(rq, proc);
+    uint32_t count = rq->count;
+    spin_unlock(&rq->lock);
+
+    if (found) {
+        kprintf("[SCHEDULER] Removed process PID=%lu from CPU %u runqueue (count=%u)\n",
+                proc->pid, proc->run_cpu, count);
+    }
+}
+
+// ============================================================================
+// WAIT QUEUES
+// ============================================================================
+//
+// kernel_notify(WAIT) ставит процесс в bucket под ключом (pid, workflow_id).
+// Execution Deck после публикации результата вызывает
+// scheduler_notify_completion(), completion IRQ будит только процессы,
+// чей ключ совпал, - без прохода по всей таблице процессов.
+//
+// ============================================================================
+
+static inline uint32_t wait_bucket_index(uint64_t pid) {
+    return (uint32_t)(pid & (SCHEDULER_WAIT_BUCKETS - 1));
+}
+
+// Вызывать под wait_lock
+static void wait_bucket_remove(process_t* proc) {
+    process_t** link = &wait_buckets[wait_bucket_index(proc->pid)];
+
+    while (*link) {
+        if (*link == proc) {
+            *link = proc->wait_next;
+            break;
+        }
+        link = &(*link)->wait_next;
+    }
+
+    proc->wait_next = NULL;
+    proc->wait_queued = 0;
+}
+
+int scheduler_wait_enqueue(process_t* proc, uint64_t workflow_id) {
+    if (!proc) {
+        return 0;
+    }
+
+    spin_lock(&wait_lock);
+
+    // CRITICAL: Повторная проверка под lock - результат мог прийти
+    // между проверкой в syscall и постановкой в очередь
+    if (atomic_load_u32(&proc->completion_ready)) {
+        spin_unlock(&wait_lock);
+        return 0;
+    }
+
+    proc->current_workflow_id = workflow_id;
+    proc->state = PROCESS_STATE_WAITING;
+
+    if (!proc->wait_queued) {
+        uint32_t bucket = wait_bucket_index(proc->pid);
+        proc->wait_next = wait_buckets[bucket];
+        wait_buckets[bucket] = proc;
+        proc->wait_queued = 1;
+    }
+
+    spin_unlock(&wait_lock);
+    return 1;
+}
+
+void scheduler_wait_cancel(process_t* proc) {
     if (!proc) {
         return;
     }
 
-    // Linear search and remove (inefficient but simple)
-    int found = 0;
-    for (int i = 0; i < ready_queue_count; i++) {
-        int idx = (ready_queue_head + i) % PROCESS_MAX_COUNT;
-        if (ready_queue[idx] == proc) {
-            found = 1;
-            // Shift all following processes forward
-            for (int j = i; j < ready_queue_count - 1; j++) {
-                int cur = (ready_queue_head + j) % PROCESS_MAX_COUNT;
-                int next = (ready_queue_head + j + 1) % PROCESS_MAX_COUNT;
-                ready_queue[cur] = ready_queue[next];
+    spin_lock(&wait_lock);
+    if (proc->wait_queued) {
+        wait_bucket_remove(proc);
+    }
+    spin_unlock(&wait_lock);
+}
+
+void scheduler_notify_completion(uint64_t pid, uint64_t workflow_id) {
+    spin_lock(&wait_lock);
+
+    // Тот же ключ уже ждёт wake в этом batch
+    for (uint32_t i = 0; i < pending_wake_count; i++) {
+        if (pending_wakes[i].pid == pid &&
+            (pending_wakes[i].workflow_id == 0 || pending_wakes[i].workflow_id == workflow_id)) {
+            spin_unlock(&wait_lock);
+            return;
+        }
+    }
+
+    if (pending_wake_count < SCHEDULER_PENDING_WAKES) {
+        pending_wakes[pending_wake_count].pid = pid;
+        pending_wakes[pending_wake_count].workflow_id = workflow_id;
+        pending_wake_count++;
+    } else {
+        pending_wake_overflow = 1;
+    }
+
+    spin_unlock(&wait_lock);
+}
+
+static int wait_key_matches(process_t* proc, uint64_t workflow_id) {
+    return workflow_id == 0 || proc->current_workflow_id == workflow_id;
+}
+
+int scheduler_wake_pending(void) {
+    process_t* woken[PROCESS_MAX_COUNT];
+    int woken_count = 0;
+
+    spin_lock(&wait_lock);
+
+    if (pending_wake_overflow) {
+        // DEFENSIVE: ключи потеряны - будим всех ожидающих
+        for (uint32_t b = 0; b < SCHEDULER_WAIT_BUCKETS; b++) {
+            while (wait_buckets[b] && woken_count < PROCESS_MAX_COUNT) {
+                process_t* proc = wait_buckets[b];
+                wait_bucket_remove(proc);
+                woken[woken_count++] = proc;
+            }
+        }
+    } else {
+        for (uint32_t i = 0; i < pending_wake_count; i++) {
+            process_t* proc = wait_buckets[wait_bucket_index(pending_wakes[i].pid)];
+
+            while (proc && woken_count < PROCESS_MAX_COUNT) {
+                process_t* next = proc->wait_next;
+                if (proc->pid == pending_wakes[i].pid &&
+                    wait_key_matches(proc, pending_wakes[i].workflow_id)) {
+                    wait_bucket_remove(proc);
+                    woken[woken_count++] = proc;
+                }
+                proc = next;
             }
-            ready_queue_count--;
-            ready_queue_tail = (ready_queue_tail - 1 + PROCESS_MAX_COUNT) % PROCESS_MAX_COUNT;
-            break;
         }
     }
 
-    if (found) {
-        kprintf("[SCHEDULER] Removed process PID=%lu from ready queue (count=%d)\n",
-                proc->pid, ready_queue_count);
+    pending_wake_count = 0;
+    pending_wake_overflow = 0;
+
+    spin_unlock(&wait_lock);
+
+    // Runqueue - вне wait_lock. Дождался события - наверх: короткая
+    // обработка результата не ждёт процессов, вырабатывающих slice
+    for (int i = 0; i < woken_count; i++) {
+        if (woken[i]->state == PROCESS_STATE_WAITING) {
+            woken[i]->priority = 0;
+            scheduler_add_process(woken[i]);
+            scheduler_stats.targeted_wakeups++;
+            kprintf("[SCHEDULER] Woke PID=%lu (workflow %lu)\n",
+                    woken[i]->pid, woken[i]->current_workflow_id);
+        }
+    }
+
+    // Tickless: простаивающий BSP иначе ждал бы своего срока
+    if (woken_count > 0) {
+        clock_event_kick();
     }
+
+    return woken_count;
 }
 
 // ============================================================================
 // SCHEDULING DECISIONS
 // ============================================================================
 
-// Pick next process to run (round-robin)
+// Pick next process to run (priority, FIFO within level)
 process_t* scheduler_pick_next(void) {
-    if (ready_queue_count == 0) {
-        return NULL;  // No processes to run
-    }
+    uint32_t self = smp_current_cpu();
+    scheduler_runqueue_t* rq = &runqueues[self];
+
+    spin_lock(&rq->lock);
+    process_t* next = runqueue_pop(rq);
+    spin_unlock(&rq->lock);
+
+    if (!next) {
+        // Load balancing: своя пуста - взять у самой загруженной
+        uint32_t victim = self;
+        uint32_t most = 0;
+        for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+            if (cpu != self && runqueues[cpu].count > most) {
+                most = runqueues[cpu].count;
+                victim = cpu;
+            }
+        }
+        if (victim == self) {
+            return NULL;  // No processes to run
+        }
 
-    // Get from head (FIFO)
-    process_t* next = ready_queue[ready_queue_head];
-    ready_queue_head = (ready_queue_head + 1) % PROCESS_MAX_COUNT;
-    ready_queue_count--;
+        spin_lock(&runqueues[victim].lock);
+        next = runqueue_pop(&runqueues[victim]);
+        spin_unlock(&runqueues[victim].lock);
 
+        if (!next) {
+            return NULL;
+        }
+        scheduler_stats.steals++;
+    }
+
+    next->run_cpu = self;
     return next;
 }
 
@@ -177,7 +504,7 @@ void scheduler_yield_cooperative(interrupt_frame_t* frame) {
             next->state = PROCESS_STATE_RUNNING;
             process_set_current(next);
             scheduler_stats.context_switches++;
-            time_slice_remaining = TIME_SLICE_TICKS;
+            scheduler_start_slice(next);
             kprintf("[SCHEDULER] Context switch after cleanup: destroyed -> PID %lu\n", next->pid);
         } else {
             // No processes left - graceful shutdown
@@ -206,7 +533,7 @@ void scheduler_yield_cooperative(interrupt_frame_t* frame) {
             process_set_current(next);
 
             scheduler_stats.context_switches++;
-            time_slice_remaining = TIME_SLICE_TICKS;
+            scheduler_start_slice(next);
 
             kprintf("[SCHEDULER] Context switch (waiting->ready): PID %lu (WAITING) -> PID %lu (RUNNING)\n",
                     current->pid, next->pid);
@@ -219,10 +546,11 @@ void scheduler_yield_cooperative(interrupt_frame_t* frame) {
 
         // Idle loop - wait for interrupts (completion IRQ will wake us)
         while (1) {
+            pmm_zero_idle();
             asm volatile("hlt");  // Wait for interrupt
 
             // After IRQ, check if any processes became ready
-            if (ready_queue_count > 0) {
+            if (scheduler_has_ready()) {
                 kprintf("[SCHEDULER] Woke from idle - processes available\n");
                 process_t* next = scheduler_pick_next();
                 if (next) {
@@ -230,7 +558,7 @@ void scheduler_yield_cooperative(interrupt_frame_t* frame) {
                     next->state = PROCESS_STATE_RUNNING;
                     process_set_current(next);
                     scheduler_stats.context_switches++;
-                    time_slice_remaining = TIME_SLICE_TICKS;
+                    scheduler_start_slice(next);
                     kprintf("[SCHEDULER] Context switch (idle->ready): -> PID %lu\n", next->pid);
                     return;
                 }
@@ -249,7 +577,7 @@ void scheduler_yield_cooperative(interrupt_frame_t* frame) {
         process_set_current(next);
 
         scheduler_stats.context_switches++;
-        time_slice_remaining = TIME_SLICE_TICKS;  // Reset time slice
+        scheduler_start_slice(next);  // Reset time slice
 
         kprintf("[SCHEDULER] Context switch (cooperative): PID %lu -> PID %lu\n",
                 current->pid, next->pid);
@@ -268,7 +596,8 @@ void scheduler_yield_cooperative(interrupt_frame_t* frame) {
         }
         // Restore current process (it's still viable)
         scheduler_restore_context(current, frame);
-        time_slice_remaining = TIME_SLICE_TICKS;
+        current->state = PROCESS_STATE_RUNNING;
+        scheduler_start_slice(current);
     }
 }
 
@@ -286,69 +615,66 @@ void scheduler_tick(interrupt_frame_t* frame) {
         return;
     }
 
-    // PRODUCTION: WATCHDOG - Check for hung processes (every 100 ticks = 1 second)
-    if (scheduler_stats.total_ticks % 100 == 0) {
-        extern process_t* process_get_all(uint64_t* count);
-        uint64_t process_count = 0;
-        process_t* all_processes = process_get_all(&process_count);
-
-        for (uint64_t i = 0; i < process_count; i++) {
-            process_t* proc = &all_processes[i];
+    scheduler_runqueue_t* rq = runqueue_local();
+    process_t* current = process_get_current();
 
-            // Skip zombie and waiting processes
-            if (proc->state == PROCESS_STATE_ZOMBIE || proc->state == PROCESS_STATE_WAITING) {
-                continue;
-            }
+    // Aging этой runqueue (только её lock - O(уровней))
+    if (scheduler_stats.total_ticks % SCHEDULER_AGING_TICKS == 0) {
+        spin_lock(&rq->lock);
+        runqueue_age(rq);
+        spin_unlock(&rq->lock);
+    }
 
-            // Check if process has EVER made a syscall (last_syscall_tick == 0 means never)
-            if (proc->last_syscall_tick == 0) {
-                // New process that hasn't made any syscalls yet - give it grace period
-                // Check if it's been alive for > 1000 ticks (10 seconds) without ANY syscall
-                continue;  // Skip for now - process might be initializing
-            }
+    // PRODUCTION: WATCHDOG - hung process = текущий, который слишком долго
+    // на CPU без syscall. Проверяется только он: остальные не выполняются
+    if (current && current->state == PROCESS_STATE_RUNNING &&
+        current->last_syscall_tick != 0) {  // 0 = ещё не было syscall (инициализация)
+        if (current->watchdog_mark != current->last_syscall_tick) {
+            current->watchdog_mark = current->last_syscall_tick;
+            current->watchdog_ticks = 0;
+        }
 
-            // WATCHDOG: If no syscall in 1000 ticks (10 seconds) → KILL
-            uint64_t ticks_since_syscall = scheduler_stats.total_ticks - proc->last_syscall_tick;
-            if (ticks_since_syscall > 1000) {
-                kprintf("\n%[E]=== WATCHDOG: HUNG PROCESS DETECTED ===%[D]\n");
-                kprintf("%[E]PID: %lu%[D]\n", proc->pid);
-                kprintf("%[E]State: %d%[D]\n", proc->state);
-                kprintf("%[E]Last syscall: %lu ticks ago (%.1f seconds)%[D]\n",
-                        ticks_since_syscall, (double)ticks_since_syscall / 100.0);
-                kprintf("%[E]RIP: 0x%llx%[D]\n", proc->rip);
-                kprintf("%[E]RSP: 0x%llx%[D]\n", proc->rsp);
-                kprintf("%[E]Killing hung process...%[D]\n\n");
-
-                // Mark as zombie - will be cleaned up on next context switch
-                proc->state = PROCESS_STATE_ZOMBIE;
-            }
+        // WATCHDOG: 1000 ticks (10 seconds) на CPU без syscall → KILL
+        if (++current->watchdog_ticks > SCHEDULER_WATCHDOG_TICKS) {
+            uint64_t ticks_since_syscall = scheduler_stats.total_ticks - current->last_syscall_tick;
+            kprintf("\n%[E]=== WATCHDOG: HUNG PROCESS DETECTED ===%[D]\n");
+            kprintf("%[E]PID: %lu%[D]\n", current->pid);
+            kprintf("%[E]State: %d%[D]\n", current->state);
+            kprintf("%[E]Last syscall: %lu ticks ago (%lu.%lu seconds), %lu ticks on CPU%[D]\n",
+                    ticks_since_syscall, ticks_since_syscall / 100, (ticks_since_syscall / 10) % 10,
+                    current->watchdog_ticks);
+            kprintf("%[E]RIP: 0x%llx%[D]\n", current->rip);
+            kprintf("%[E]RSP: 0x%llx%[D]\n", current->rsp);
+            kprintf("%[E]Killing hung process...%[D]\n\n");
+
+            // Mark as zombie - cleaned up below (slice обнулён)
+            current->state = PROCESS_STATE_ZOMBIE;
+            rq->slice = 0;
         }
     }
 
-    process_t* current = process_get_current();
-
     // DEBUG: Log scheduler activity (first 20 ticks only)
     static int debug_ticks = 0;
     if (debug_ticks < 20) {
-        kprintf("[SCHEDULER] Tick %lu: current=%s ready_queue=%d time_slice=%d\n",
+        kprintf("[SCHEDULER] Tick %lu: current=%s ready=%u time_slice=%d\n",
                 scheduler_stats.total_ticks,
                 current ? "YES" : "NULL",
-                ready_queue_count,
-                time_slice_remaining);
+                rq->count,
+                rq->slice);
         debug_ticks++;
     }
 
     if (!current) {
         // No current process - check if there are any ready processes
         // DEFENSIVE: This can happen if timer IRQ fires during system init
-        if (ready_queue_count == 0) {
+        if (!scheduler_has_ready()) {
             // System not fully initialized - no processes yet
             return;  // Silently return (this is expected during boot)
         }
 
         // There ARE ready processes - pick one and start it
-        kprintf("[SCHEDULER] No current process, but %d in ready queue - picking one\n",
-                ready_queue_count);
+        kprintf("[SCHEDULER] No current process, but %u in runqueues - picking one\n",
+                scheduler_ready_count());
 
         process_t* next = scheduler_pick_next();
         if (next) {
@@ -356,27 +682,40 @@ void scheduler_tick(interrupt_frame_t* frame) {
             next->state = PROCESS_STATE_RUNNING;
             process_set_current(next);
             scheduler_stats.context_switches++;
-            time_slice_remaining = TIME_SLICE_TICKS;
+            scheduler_start_slice(next);
             kprintf("[SCHEDULER] Started process PID=%lu from idle\n", next->pid);
         }
         return;  // Done
     }
 
     // Decrement time slice
-    time_slice_remaining--;
-
-    if (time_slice_remaining <= 0) {
-        // Time slice expired - preempt! (This should be RARE!)
-        scheduler_stats.preemptions++;
-
-        kprintf("[SCHEDULER] Timer preemption of PID=%lu (protection mechanism)\n",
-                current->pid);
+    rq->slice--;
+
+    // Готов процесс выше уровнем (разбуженный handler) - не ждёт конца slice
+    int expired = rq->slice <= 0;
+    int outranked = !expired && current->priority < PROCESS_PRIORITY_LEVELS &&
+                    (rq->bitmap & ((1u << current->priority) - 1)) != 0;
+
+    if (expired || outranked) {
+        if (expired) {
+            // Time slice expired - preempt! (This should be RARE!)
+            scheduler_stats.preemptions++;
+            kprintf("[SCHEDULER] Timer preemption of PID=%lu (protection mechanism)\n",
+                    current->pid);
+        } else {
+            scheduler_stats.priority_preemptions++;
+        }
 
         // Save current process context from interrupt frame
         scheduler_save_context(current, frame);
 
         // Add current back to ready queue (if not waiting or terminated)
         if (current->state == PROCESS_STATE_RUNNING) {
+            // Выработал slice целиком - CPU-bound, уровнем ниже
+            if (expired && current->priority + 1 < PROCESS_PRIORITY_LEVELS) {
+                current->priority++;
+                scheduler_stats.demotions++;
+            }
             scheduler_add_process(current);
         } else if (current->state == PROCESS_STATE_ZOMBIE) {
             kprintf("[SCHEDULER] Timer tick on ZOMBIE process PID=%lu - cleaning up\n", current->pid);
@@ -390,7 +729,7 @@ void scheduler_tick(interrupt_frame_t* frame) {
                 next->state = PROCESS_STATE_RUNNING;
                 process_set_current(next);
                 scheduler_stats.context_switches++;
-                time_slice_remaining = TIME_SLICE_TICKS;
+                scheduler_start_slice(next);
                 kprintf("[SCHEDULER] Context switch (timer after cleanup): destroyed -> PID %lu\n", next->pid);
             } else {
                 // No processes left - graceful shutdown
@@ -414,7 +753,7 @@ void scheduler_tick(interrupt_frame_t* frame) {
                 next->state = PROCESS_STATE_RUNNING;
                 process_set_current(next);
                 scheduler_stats.context_switches++;
-                time_slice_remaining = TIME_SLICE_TICKS;
+                scheduler_start_slice(next);
                 kprintf("[SCHEDULER] Context switch (timer waiting->ready): PID %lu (WAITING) -> PID %lu\n",
                         current->pid, next->pid);
                 return;
@@ -425,14 +764,14 @@ void scheduler_tick(interrupt_frame_t* frame) {
             process_set_current(NULL);
             while (1) {
                 asm volatile("hlt");
-                if (ready_queue_count > 0) {
+                if (scheduler_has_ready()) {
                     process_t* next = scheduler_pick_next();
                     if (next) {
                         scheduler_restore_context(next, frame);
                         next->state = PROCESS_STATE_RUNNING;
                         process_set_current(next);
                         scheduler_stats.context_switches++;
-                        time_slice_remaining = TIME_SLICE_TICKS;
+                        scheduler_start_slice(next);
                         return;
                     }
                 }
@@ -450,7 +789,7 @@ void scheduler_tick(interrupt_frame_t* frame) {
             process_set_current(next);
 
             scheduler_stats.context_switches++;
-            time_slice_remaining = TIME_SLICE_TICKS;  // Reset time slice
+            scheduler_start_slice(next);  // Reset time slice
 
             kprintf("[SCHEDULER] Context switch (preemptive): PID %lu -> PID %lu\n",
                     current->pid, next->pid);
@@ -469,7 +808,8 @@ void scheduler_tick(interrupt_frame_t* frame) {
             }
             // Restore current process (it's still viable)
             scheduler_restore_context(current, frame);
-            time_slice_remaining = TIME_SLICE_TICKS;
+            current->state = PROCESS_STATE_RUNNING;
+            scheduler_start_slice(current);
         }
     }
 }
@@ -544,8 +884,11 @@ void scheduler_restore_context(process_t* proc, void* interrupt_frame) {
     frame->ss = proc->ss;
 
     // Switch to process page table (CR3)
-    // CRITICAL for address space isolation!
-    asm volatile("mov %0, %%cr3" : : "r"(proc->cr3) : "memory");
+    // CRITICAL for address space isolation! С PCID TLB процесса переживает переключение
+    vmm_switch_context((vmm_context_t*)proc->vmm_context);
+
+    // Lazy FPU: чужие SIMD регистры → TS, state загрузится по #NM
+    fpu_switch_to(proc);
 
     // Update TSS RSP0 for kernel stack
     // This ensures syscalls/interrupts use kernel stack, not user stack
@@ -575,7 +918,11 @@ void scheduler_print_stats(void) {
     kprintf("Preemptions:       %lu (timer-based, should be rare!)\n", scheduler_stats.preemptions);
     kprintf("Voluntary yields:  %lu (workflow-driven, primary mechanism)\n", scheduler_stats.voluntary_yields);
     kprintf("Total ticks:       %lu\n", scheduler_stats.total_ticks);
-    kprintf("Ready queue count: %d\n", ready_queue_count);
+    kprintf("Targeted wakeups:  %lu\n", scheduler_stats.targeted_wakeups);
+    kprintf("Priority preempt:  %lu (higher level became ready)\n", scheduler_stats.priority_preemptions);
+    kprintf("Demotions:         %lu\n", scheduler_stats.demotions);
+    kprintf("Steals:            %lu (load balancing)\n", scheduler_stats.steals);
+    kprintf("Ready processes:   %u\n", scheduler_ready_count());
 
     process_t* current = process_get_current();
     if (current) {
@@ -584,13 +931,25 @@ void scheduler_print_stats(void) {
     } else {
         kprintf("Current process:   None\n");
     }
+
+    fpu_print_stats();
 }
 
 void scheduler_print_queue(void) {
-    kprintf("[SCHEDULER] Ready queue (%d processes):\n", ready_queue_count);
-    for (int i = 0; i < ready_queue_count; i++) {
-        int idx = (ready_queue_head + i) % PROCESS_MAX_COUNT;
-        process_t* proc = ready_queue[idx];
-        kprintf("  [%d] PID=%lu state=%d\n", i, proc->pid, proc->state);
+    kprintf("[SCHEDULER] Runqueues (%u processes):\n", scheduler_ready_count());
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        scheduler_runqueue_t* rq = &runqueues[cpu];
+        if (rq->count == 0) {
+            continue;
+        }
+
+        spin_lock(&rq->lock);
+        kprintf("  CPU %u: %u ready, bitmap=0x%x\n", cpu, rq->count, rq->bitmap);
+        for (uint32_t level = 0; level < PROCESS_PRIORITY_LEVELS; level++) {
+            for (process_t* proc = rq->head[level]; proc; proc = proc->run_next) {
+                kprintf("    [prio %u] PID=%lu state=%d\n", level, proc->pid, proc->state);
+            }
+        }
+        spin_unlock(&rq->lock);
     }
 }
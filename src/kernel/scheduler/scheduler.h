@@ -20,14 +20,30 @@
 //   - Large time slice (100ms) to prevent infinite loops
 //   - Not the primary scheduling mechanism
 //
+// RUNQUEUES: у каждого CPU - FIFO на каждый из PROCESS_PRIORITY_LEVELS
+// уровней и bitmap непустых уровней, pick_next - один ctz, O(1).
+//   - wake после WAIT → уровень 0 (request handler не ждёт batch workers)
+//   - выработал time slice → на уровень ниже, slice там длиннее
+//   - готовый процесс выше по приоритету вытесняет текущий на ближайшем tick
+//   - aging: раз в SCHEDULER_AGING_TICKS все уровни поднимаются на один
+//   - wake возвращает процесс в runqueue его CPU, CPU с пустой
+//     runqueue забирает процесс у самой загруженной
+//
 // ============================================================================
 
+#define SCHEDULER_AGING_TICKS     100   // Период подъёма уровней (против голодания)
+#define SCHEDULER_WATCHDOG_TICKS  1000  // Тиков на CPU без syscall → процесс убит
+
 // Scheduler statistics
 typedef struct {
     uint64_t context_switches;      // Total context switches
     uint64_t preemptions;            // Timer-based preemptions (should be rare!)
     uint64_t voluntary_yields;       // Workflow-driven yields (primary mechanism)
     uint64_t total_ticks;            // Total scheduler ticks
+    uint64_t targeted_wakeups;       // Процессы, разбуженные своим результатом
+    uint64_t priority_preemptions;   // Вытеснен готовым процессом выше уровнем
+    uint64_t demotions;              // Выработал slice - уровень ниже
+    uint64_t steals;                 // Взят из runqueue другого CPU
 } scheduler_stats_t;
 
 // Global scheduler statistics (accessible for watchdog and monitoring)
@@ -41,14 +57,16 @@ extern scheduler_stats_t scheduler_stats;
 void scheduler_init(void);
 
 // === PROCESS MANAGEMENT ===
-// Add process to ready queue (called after process_create)
+// Add process to ready queue (called after process_create):
+// runqueue proc->run_cpu, уровень proc->priority
 void scheduler_add_process(process_t* proc);
 
 // Remove process from scheduling (called on exit)
 void scheduler_remove_process(process_t* proc);
 
 // === SCHEDULING DECISIONS ===
-// Pick next process to run (round-robin)
+// Pick next process to run: высший непустой уровень своей runqueue,
+// пустая - процесс из самой загруженной runqueue другого CPU
 process_t* scheduler_pick_next(void);
 
 // === COOPERATIVE SCHEDULING (PRIMARY) ===
@@ -56,11 +74,31 @@ process_t* scheduler_pick_next(void);
 // Saves context from interrupt_frame, switches to next process
 void scheduler_yield_cooperative(interrupt_frame_t* frame);
 
+// === WAIT QUEUES (kernel_notify WAIT) ===
+// Поставить процесс в wait queue под ключом (pid, workflow_id) и перевести
+// в WAITING. Возвращает 0 если результат уже пришёл (completion_ready)
+int scheduler_wait_enqueue(process_t* proc, uint64_t workflow_id);
+
+// Убрать процесс из wait queue (process_destroy)
+void scheduler_wait_cancel(process_t* proc);
+
+// Execution Deck: результат workflow_id опубликован в ResultRing процесса pid.
+// workflow_id = 0 - любой workflow этого процесса. Wake срабатывает в
+// completion IRQ (scheduler_wake_pending)
+void scheduler_notify_completion(uint64_t pid, uint64_t workflow_id);
+
+// Completion IRQ: разбудить только процессы с совпавшим ключом
+int scheduler_wake_pending(void);
+
 // === TIMER-BASED SCHEDULING (SECONDARY - PROTECTION ONLY) ===
 // Called from timer IRQ - only for protection against infinite loops
 // Large time slice (100ms) ensures this is rarely triggered
 void scheduler_tick(interrupt_frame_t* frame);
 
+// Нужен ли periodic tick: есть текущий или готовый процесс (иначе timer
+// interrupt может спать до ближайшего таймера - tickless idle, clock.h)
+int scheduler_needs_tick(void);
+
 // === CONTEXT SWITCHING ===
 // Save current process context (registers, etc) from interrupt frame
 void scheduler_save_context(process_t* proc, void* interrupt_frame);
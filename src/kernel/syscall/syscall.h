@@ -2,6 +2,7 @@
 #define SYSCALL_H
 
 #include "ktypes.h"
+#include "process.h"
 
 // ============================================================================
 // KERNEL_NOTIFY SYSCALL - Single System Call Interface
@@ -13,7 +14,10 @@
 //
 // ============================================================================
 
-// Syscall vector (INT 0x80)
+// Syscall vector (INT 0x80). Тот же ABI - через SYSCALL (LSTAR = syscall_entry):
+// RDI = workflow_id, RSI = flags, RDX = arg, результат в RAX, RCX/R11 портятся.
+// SUBMIT/POLL/WAIT/YIELD там обрабатываются коротким путём и выходят SYSRET,
+// остальное - тот же syscall_handler и выход через iretq
 #define SYSCALL_VECTOR 0x80
 
 // ============================================================================
@@ -25,6 +29,44 @@
 #define NOTIFY_POLL    0x04  // Check workflow status (non-blocking)
 #define NOTIFY_YIELD   0x08  // Cooperative yield (give up CPU voluntarily)
 #define NOTIFY_EXIT    0x10  // Terminate current process (cleanup and exit)
+#define NOTIFY_SQPOLL  0x20  // Enable kernel-side polling of EventRing.tail
+#define NOTIFY_REGISTER_BUFFER 0x40  // Register shared buffer (RDX = size)
+#define NOTIFY_ACTIVATE 0x80  // New workflow instance (returns instance_id)
+
+// ============================================================================
+// SQPOLL MODE
+// ============================================================================
+//
+// kernel_notify(workflow_id, NOTIFY_SQPOLL [| NOTIFY_SUBMIT]) регистрирует
+// процесс у поллера Guide: он крутится на своём AP (guide_sqpoll_run),
+// постоянно смотрит EventRing.tail и забирает новые события сразу после
+// публикации - без int 0x80 на каждый batch. Без свободного AP поллит
+// timer interrupt BSP (каждый tick, пока есть SQPOLL процессы).
+//
+// Если ring пуст дольше порога по TSC (guide_set_sqpoll_idle_us), поллер
+// выключается и ставит EVENT_RING_FLAG_NEED_WAKEUP в EventRing.flags.
+// User после публикации события проверяет флаг:
+//
+//   push event; mfence;
+//   if (ring->flags & EVENT_RING_FLAG_NEED_WAKEUP)
+//       kernel_notify(wf, NOTIFY_SUBMIT | NOTIFY_SQPOLL);
+//
+
+// ============================================================================
+// REGISTERED BUFFERS
+// ============================================================================
+//
+// Payload события - 512 байт и копируется через EventRing. Для bulk данных
+// процесс один раз регистрирует буфер:
+//
+//   index = kernel_notify(0, NOTIFY_REGISTER_BUFFER) с RDX = size
+//
+// Kernel выделяет страницы и отображает их по REG_BUFFER_USER_BASE +
+// index * REG_BUFFER_MAX_SIZE. Событие ссылается на данные тройкой
+// (buf_index, buf_offset, buf_length) и флагом RING_EVENT_BUF_REGISTERED;
+// decks читают/пишут эти страницы напрямую, без копии в payload.
+// Границы проверяются при ingestion - невалидное событие отбрасывается.
+//
 
 // ============================================================================
 // KERNEL_NOTIFY SYSCALL
@@ -40,7 +82,24 @@
 //   NOTIFY_SUBMIT: number of events processed (0 if none)
 //   NOTIFY_WAIT:   0 on success, -1 on error
 //   NOTIFY_POLL:   0 if completed, 1 if in progress, -1 on error
+//   NOTIFY_SQPOLL: 0 (or SUBMIT count when combined with NOTIFY_SUBMIT)
+//   NOTIFY_REGISTER_BUFFER: buffer index, -6 on error
 //
 // ============================================================================
 
+// Drain EventRing into the routing table (shared by SUBMIT and SQPOLL poller)
+// Returns number of events accepted
+uint64_t syscall_ingest_event_ring(process_t* proc, uint64_t workflow_id);
+
+// Same, caller already holds proc->event_ring_lock
+uint64_t syscall_ingest_event_ring_locked(process_t* proc, uint64_t workflow_id);
+
+// 1 if EventRing has published events the kernel has not ingested yet
+// (caller holds proc->event_ring_lock)
+int syscall_event_ring_pending(process_t* proc);
+
+// ZERO-COPY: release EventRing slot once its RoutingEntry is gone.
+// EventRing.head advances over every contiguous released slot.
+void syscall_release_event_slot(process_t* proc, uint64_t pid, uint64_t slot);
+
 #endif // SYSCALL_H
@@ -0,0 +1,204 @@
+#include "bitmap_alloc.h"
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+#define CHUNK_WORDS (BITMAP_ALLOC_CHUNK_BITS / 64)
+
+// Биты [lo, hi) одного слова, hi <= 64
+static inline uint64_t word_mask(uint32_t lo, uint32_t hi) {
+    uint64_t upper = hi == 64 ? ~0ULL : ((1ULL << hi) - 1);
+    return upper & ~((1ULL << lo) - 1);
+}
+
+// Бит в chunk (последний chunk может быть неполным)
+static inline uint64_t chunk_capacity(const BitmapAlloc* map, uint64_t chunk) {
+    uint64_t first = chunk * BITMAP_ALLOC_CHUNK_BITS;
+    uint64_t rest = map->bits - first;
+    return rest < BITMAP_ALLOC_CHUNK_BITS ? rest : BITMAP_ALLOC_CHUNK_BITS;
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void bitmap_alloc_init(BitmapAlloc* map, void* words, uint32_t* chunk_free, uint64_t bits) {
+    map->words = (uint64_t*)words;
+    map->chunk_free = chunk_free;
+    map->bits = bits;
+    map->free = 0;
+
+    uint64_t word_count = (bits + 63) / 64;
+    if (bits % 64) {
+        // DEFENSIVE: хвост последнего слова никогда не выдаётся
+        map->words[word_count - 1] |= ~word_mask(0, bits % 64);
+    }
+
+    for (uint64_t chunk = 0; chunk < BITMAP_ALLOC_CHUNKS(bits); chunk++) {
+        uint64_t first = chunk * CHUNK_WORDS;
+        uint64_t last = first + CHUNK_WORDS < word_count ? first + CHUNK_WORDS : word_count;
+        uint32_t free = 0;
+        for (uint64_t w = first; w < last; w++) {
+            free += __builtin_popcountll(~map->words[w]);
+        }
+        map->chunk_free[chunk] = free;
+        map->free += free;
+    }
+}
+
+// ============================================================================
+// SET / CLEAR
+// ============================================================================
+
+int bitmap_alloc_test(const BitmapAlloc* map, uint64_t bit) {
+    if (bit >= map->bits) {
+        return 1;
+    }
+    return (map->words[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void bitmap_alloc_update(BitmapAlloc* map, uint64_t first, uint64_t count, int set) {
+    if (first >= map->bits) {
+        return;
+    }
+    if (count > map->bits - first) {
+        count = map->bits - first;
+    }
+
+    while (count > 0) {
+        uint64_t w = first / 64;
+        uint32_t lo = first % 64;
+        uint32_t n = count < 64 - lo ? (uint32_t)count : 64 - lo;
+        uint64_t mask = word_mask(lo, lo + n);
+
+        // Только биты, которые реально меняют состояние
+        uint64_t changed = set ? (~map->words[w] & mask) : (map->words[w] & mask);
+        if (changed) {
+            uint32_t k = __builtin_popcountll(changed);
+            map->words[w] ^= changed;
+            if (set) {
+                map->chunk_free[w / CHUNK_WORDS] -= k;
+                map->free -= k;
+            } else {
+                map->chunk_free[w / CHUNK_WORDS] += k;
+                map->free += k;
+            }
+        }
+        first += n;
+        count -= n;
+    }
+}
+
+void bitmap_alloc_set(BitmapAlloc* map, uint64_t first, uint64_t count) {
+    bitmap_alloc_update(map, first, count, 1);
+}
+
+void bitmap_alloc_clear(BitmapAlloc* map, uint64_t first, uint64_t count) {
+    bitmap_alloc_update(map, first, count, 0);
+}
+
+// ============================================================================
+// SEARCH
+// ============================================================================
+
+uint64_t bitmap_alloc_next_free(const BitmapAlloc* map, uint64_t from, uint64_t end) {
+    if (end > map->bits) {
+        end = map->bits;
+    }
+
+    while (from < end) {
+        uint64_t w = from / 64;
+        uint64_t chunk = w / CHUNK_WORDS;
+
+        // Целиком занятый chunk - пропускаем одним шагом
+        if (map->chunk_free[chunk] == 0) {
+            from = (chunk + 1) * BITMAP_ALLOC_CHUNK_BITS;
+            continue;
+        }
+
+        uint64_t candidates = ~map->words[w] & ~word_mask(0, from % 64);
+        if (candidates) {
+            uint64_t bit = w * 64 + __builtin_ctzll(candidates);
+            return bit < end ? bit : BITMAP_ALLOC_NONE;
+        }
+        from = (w + 1) * 64;
+    }
+    return BITMAP_ALLOC_NONE;
+}
+
+uint64_t bitmap_alloc_next_used(const BitmapAlloc* map, uint64_t from, uint64_t end) {
+    if (end > map->bits) {
+        end = map->bits;
+    }
+
+    while (from < end) {
+        uint64_t w = from / 64;
+        uint64_t chunk = w / CHUNK_WORDS;
+
+        // Целиком свободный chunk
+        if (map->chunk_free[chunk] == chunk_capacity(map, chunk)) {
+            from = (chunk + 1) * BITMAP_ALLOC_CHUNK_BITS;
+            continue;
+        }
+
+        uint64_t candidates = map->words[w] & ~word_mask(0, from % 64);
+        if (candidates) {
+            uint64_t bit = w * 64 + __builtin_ctzll(candidates);
+            return bit < end ? bit : BITMAP_ALLOC_NONE;
+        }
+        from = (w + 1) * 64;
+    }
+    return BITMAP_ALLOC_NONE;
+}
+
+uint64_t bitmap_alloc_run_length(const BitmapAlloc* map, uint64_t start, uint64_t limit) {
+    if (start >= map->bits) {
+        return 0;
+    }
+    uint64_t end = limit > map->bits - start ? map->bits : start + limit;
+    uint64_t used = bitmap_alloc_next_used(map, start, end);
+    return (used == BITMAP_ALLOC_NONE ? end : used) - start;
+}
+
+uint64_t bitmap_alloc_find(const BitmapAlloc* map, uint64_t hint) {
+    if (hint >= map->bits) {
+        hint = 0;
+    }
+    uint64_t bit = bitmap_alloc_next_free(map, hint, map->bits);
+    if (bit == BITMAP_ALLOC_NONE && hint > 0) {
+        bit = bitmap_alloc_next_free(map, 0, hint);
+    }
+    return bit;
+}
+
+// Run с началом в [from, end) (сам run может выходить за end)
+static uint64_t bitmap_alloc_find_run_in(const BitmapAlloc* map, uint64_t count,
+                                         uint64_t from, uint64_t end) {
+    while (from < end) {
+        uint64_t start = bitmap_alloc_next_free(map, from, end);
+        if (start == BITMAP_ALLOC_NONE) {
+            return BITMAP_ALLOC_NONE;
+        }
+        uint64_t length = bitmap_alloc_run_length(map, start, count);
+        if (length >= count) {
+            return start;
+        }
+        from = start + length;  // Следующий кандидат - после занятого бита
+    }
+    return BITMAP_ALLOC_NONE;
+}
+
+uint64_t bitmap_alloc_find_run(const BitmapAlloc* map, uint64_t count, uint64_t hint) {
+    if (count == 0 || count > map->free) {
+        return BITMAP_ALLOC_NONE;
+    }
+    if (hint >= map->bits) {
+        hint = 0;
+    }
+    uint64_t start = bitmap_alloc_find_run_in(map, count, hint, map->bits);
+    if (start == BITMAP_ALLOC_NONE && hint > 0) {
+        start = bitmap_alloc_find_run_in(map, count, 0, hint);
+    }
+    return start;
+}
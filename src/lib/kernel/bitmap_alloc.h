@@ -0,0 +1,58 @@
+#ifndef BITMAP_ALLOC_H
+#define BITMAP_ALLOC_H
+
+#include "ktypes.h"
+
+// ============================================================================
+// BITMAP ALLOCATOR - поиск свободных бит по 64 за шаг (PMM frames, TagFS)
+// ============================================================================
+//
+// Bitmap - массив uint64_t, бит = 1 - занят (порядок бит как у байтового
+// bitmap: бит i - байт i / 8, бит i % 8). Поверх - summary: свободных бит
+// на каждый chunk в 4KB bitmap (BITMAP_ALLOC_CHUNK_BITS). Поиск пропускает
+// целиком занятые chunks, внутри chunk - tzcnt по инвертированному слову,
+// поэтому почти полный bitmap сканируется не дольше пустого.
+//
+// Hint - у каждого caller свой (поле / static): поиск идёт от hint к концу,
+// потом с начала. Lock - забота caller.
+//
+// ============================================================================
+
+#define BITMAP_ALLOC_CHUNK_BITS     (4096 * 8)
+#define BITMAP_ALLOC_NONE           ((uint64_t)-1)
+
+// Байт под bitmap / summary для bits бит (bitmap кратен 8 байтам)
+#define BITMAP_ALLOC_BYTES(bits)    ((((bits) + 63) / 64) * 8)
+#define BITMAP_ALLOC_CHUNKS(bits)   (((bits) + BITMAP_ALLOC_CHUNK_BITS - 1) / BITMAP_ALLOC_CHUNK_BITS)
+#define BITMAP_ALLOC_SUMMARY_BYTES(bits) (BITMAP_ALLOC_CHUNKS(bits) * sizeof(uint32_t))
+
+typedef struct {
+    uint64_t* words;                // BITMAP_ALLOC_BYTES(bits)
+    uint32_t* chunk_free;           // BITMAP_ALLOC_SUMMARY_BYTES(bits)
+    uint64_t bits;
+    uint64_t free;                  // Свободных бит всего
+} BitmapAlloc;
+
+// Берёт текущее содержимое words (биты за концом помечаются занятыми)
+// и строит summary
+void bitmap_alloc_init(BitmapAlloc* map, void* words, uint32_t* chunk_free, uint64_t bits);
+
+int bitmap_alloc_test(const BitmapAlloc* map, uint64_t bit);
+
+// [first, first + count) - занят / свободен (уже в этом состоянии - не считается)
+void bitmap_alloc_set(BitmapAlloc* map, uint64_t first, uint64_t count);
+void bitmap_alloc_clear(BitmapAlloc* map, uint64_t first, uint64_t count);
+
+// Первый свободный / занятый бит в [from, end), BITMAP_ALLOC_NONE = нет
+uint64_t bitmap_alloc_next_free(const BitmapAlloc* map, uint64_t from, uint64_t end);
+uint64_t bitmap_alloc_next_used(const BitmapAlloc* map, uint64_t from, uint64_t end);
+
+// Длина свободного run от start (не больше limit)
+uint64_t bitmap_alloc_run_length(const BitmapAlloc* map, uint64_t start, uint64_t limit);
+
+// Первый свободный бит / run из count свободных: от hint, потом с начала.
+// Не помечает - bitmap_alloc_set() делает caller
+uint64_t bitmap_alloc_find(const BitmapAlloc* map, uint64_t hint);
+uint64_t bitmap_alloc_find_run(const BitmapAlloc* map, uint64_t count, uint64_t hint);
+
+#endif // BITMAP_ALLOC_H
@@ -2,215 +2,23 @@
 #include "vga.h"
 #include "io.h"
 #include "serial.h"
-#include "pmm.h"  // For physical memory allocation
+#include "cpu.h"
 
 // NO STDLIB DEPENDENCIES - all types from ktypes.h and kstdarg.h
 
 // ========== Внутренние переменные ==========
-static uint8_t* memory_pool = NULL;  // Allocated dynamically from PMM
-static size_t memory_pool_size = 0;  // Actual heap size (calculated dynamically)
-static mem_block_t* free_list = NULL;
-static spinlock_t heap_lock = {0};
 
 static uint8_t current_attr = TEXT_ATTR_DEFAULT;
 
 // Символы для преобразования чисел
 static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
 
-// ========== Инициализация памяти ==========
-void mem_init(void) {
-    // Get total available RAM from PMM
-    extern size_t pmm_total_pages(void);
-    size_t total_pages = pmm_total_pages();
-    size_t total_ram = total_pages * 4096;  // 4KB per page
-
-    // Calculate heap size: KLIB_HEAP_RAM_PERCENT% of RAM, clamped to [MIN, MAX]
-    size_t heap_size = (total_ram * KLIB_HEAP_RAM_PERCENT) / 100;
-
-    if (heap_size < KLIB_HEAP_MIN_SIZE) {
-        heap_size = KLIB_HEAP_MIN_SIZE;
-    } else if (heap_size > KLIB_HEAP_MAX_SIZE) {
-        heap_size = KLIB_HEAP_MAX_SIZE;
-    }
-
-    // TEMPORARY: Until VMM initializes and maps all 510MB, bootloader only maps 128MB
-    // Cap heap to 4MB to ensure allocation fits in bootloader's identity mapping
-    // After VMM init, kernel can use kmalloc/kfree from the 4MB pool + vmalloc for larger allocations
-    #define BOOTLOADER_SAFE_HEAP_SIZE (4 * 1024 * 1024)  // 4MB max before VMM
-    if (heap_size > BOOTLOADER_SAFE_HEAP_SIZE) {
-        kprintf("[KLIB] Heap size capped at 4MB (bootloader mapping limit), will be %zu MB after VMM init\n",
-                heap_size / (1024*1024));
-        heap_size = BOOTLOADER_SAFE_HEAP_SIZE;
-    }
-
-    // Round up to page boundary
-    heap_size = ALIGN_UP(heap_size, 4096);
-    memory_pool_size = heap_size;
-
-    // Calculate number of pages needed
-    size_t pages_needed = heap_size / 4096;
-
-    kprintf("[KLIB] Total RAM: %zu MB, Kernel heap: %zu MB (%zu pages)\n",
-            total_ram / (1024*1024), heap_size / (1024*1024), pages_needed);
-
-    kprintf("[KLIB] Allocating memory pool from PMM...\n");
-    // Allocate memory pool from PMM (already zeroed)
-    memory_pool = (uint8_t*)pmm_alloc_zero(pages_needed);
-    if (!memory_pool) {
-        panic("Failed to allocate kernel memory pool from PMM!");
-    }
-    kprintf("[KLIB] Memory pool allocated at %p\n", memory_pool);
-
-    // Initialize free list
-    kprintf("[KLIB] Initializing free list...\n");
-    free_list = (mem_block_t*)memory_pool;
-    free_list->size = heap_size - sizeof(mem_block_t);
-    free_list->next = NULL;
-    free_list->magic = KLIB_MAGIC_NUMBER;
-    kprintf("[KLIB] Free list initialized\n");
-}
-
-// ========== Аллокация памяти ==========
-void* kmalloc(size_t size) {
-    if (size == 0) return NULL;
-
-    // Выравнивание размера
-    size = (size + KLIB_BLOCK_ALIGNMENT - 1) & ~(KLIB_BLOCK_ALIGNMENT - 1);
-
-    spin_lock(&heap_lock);
-
-    mem_block_t *curr = free_list, *prev = NULL;
-    void* result = NULL;
-
-    while (curr) {
-        if (curr->magic != KLIB_MAGIC_NUMBER) {
-            panic("Memory corruption detected in kmalloc!");
-        }
-
-        if (curr->size >= size) {
-            // Достаточно места для разделения блока
-            if (curr->size > size + sizeof(mem_block_t) + KLIB_BLOCK_ALIGNMENT) {
-                mem_block_t* new_block = (mem_block_t*)((char*)curr + sizeof(mem_block_t) + size);
-                new_block->size = curr->size - size - sizeof(mem_block_t);
-                new_block->next = curr->next;
-                new_block->magic = KLIB_MAGIC_NUMBER;
-                curr->size = size;
-                curr->next = new_block;
-            }
-
-            // Удаляем блок из свободного списка
-            if (prev) {
-                prev->next = curr->next;
-            } else {
-                free_list = curr->next;
-            }
-
-            curr->magic = KLIB_MAGIC_NUMBER;
-            result = (void*)((char*)curr + sizeof(mem_block_t));
-            break;
-        }
-
-        prev = curr;
-        curr = curr->next;
-    }
-
-    spin_unlock(&heap_lock);
-
-    if (!result) {
-        panic("Out of kernel memory!");
-    }
-    return result;
-}
-
-// ========== Освобождение памяти ==========
-void kfree(void* ptr) {
-    if (!ptr) return;
-
-    mem_block_t* block = (mem_block_t*)((char*)ptr - sizeof(mem_block_t));
-
-    // Проверки корректности (исправленные для устранения warning'ов)
-    if ((uintptr_t)block < (uintptr_t)memory_pool ||
-        (uintptr_t)block >= (uintptr_t)memory_pool + memory_pool_size) {
-        panic("Invalid free: pointer out of range!");
-    }
-
-    if (block->magic != KLIB_MAGIC_NUMBER) {
-        panic("Invalid free: bad magic number!");
-    }
-
-    spin_lock(&heap_lock);
-
-    // Проверка на двойное освобождение
-    for (mem_block_t* curr = free_list; curr; curr = curr->next) {
-        if (curr == block) {
-            panic("Double free detected!");
-        }
-    }
-
-    // Поиск места для вставки
-    mem_block_t *curr = free_list, *prev = NULL;
-    while (curr && curr < block) {
-        prev = curr;
-        curr = curr->next;
-    }
-
-    // Попытка объединения с предыдущим блоком
-    if (prev && (char*)prev + sizeof(mem_block_t) + prev->size == (char*)block) {
-        prev->size += sizeof(mem_block_t) + block->size;
-        block = prev;
-    } else {
-        block->next = curr;
-        if (prev) {
-            prev->next = block;
-        } else {
-            free_list = block;
-        }
-    }
-
-    // Попытка объединения со следующим блоком
-    if (block->next && (char*)block + sizeof(mem_block_t) + block->size == (char*)block->next) {
-        block->size += sizeof(mem_block_t) + block->next->size;
-        block->next = block->next->next;
-    }
-
-    spin_unlock(&heap_lock);
-}
-
-// ========== Статистика памяти ==========
-void mem_stats(void) {
-    spin_lock(&heap_lock);
-    
-    size_t free_blocks = 0;
-    size_t free_memory = 0;
-    size_t largest_block = 0;
-    
-    mem_block_t* curr = free_list;
-    while (curr) {
-        free_blocks++;
-        free_memory += curr->size;
-        if (curr->size > largest_block) {
-            largest_block = curr->size;
-        }
-        curr = curr->next;
-    }
-    
-    size_t used_memory = memory_pool_size - free_memory - free_blocks * sizeof(mem_block_t);
-
-    kprintf("Memory Statistics:\n");
-    kprintf("  Total memory: %zu bytes\n", memory_pool_size);
-    kprintf("  Used memory:  %zu bytes\n", used_memory);
-    kprintf("  Free memory:  %zu bytes\n", free_memory);
-    kprintf("  Free blocks:  %zu\n", free_blocks);
-    kprintf("  Largest free: %zu bytes\n", largest_block);
-    
-    spin_unlock(&heap_lock);
-}
-
 // ========== Отладочные функции ==========
 __attribute__((noreturn)) void panic(const char* message, ...) {
     va_list args;
     va_start(args, message);
 
+    kprintf_mute(0);
     kprintf("\nDon't panic, friend! I just broke something, forget it :-)");
 
     kprintf("\n%[E]KERNEL PANIC:%[D] ");
@@ -227,8 +35,9 @@ __attribute__((noreturn)) void panic(const char* message, ...) {
     
     va_end(args);
     
-    // Отключаем прерывания и зависаем
+    // Отключаем прерывания и зависаем (TX ring больше некому разгребать)
     asm volatile ("cli");
+    serial_flush();
     while(1) {
         asm volatile ("hlt");
     }
@@ -318,11 +127,12 @@ bool isspace(int c) {
 int kputnl(void) {
     vga_clear_to_eol();
     vga_print_newline();
-    vga_update_cursor();
     return 1;
 }
 
 // ========== Форматированный вывод ==========
+// Serial - в TX ring (serial.h), VGA - в теневой буфер; на экран всё
+// уходит одним vga_update_cursor() в конце kprintf
 void kputchar(char c) {
     // Output to serial port (for debugging with -serial stdio)
     if (c == '\n') {
@@ -342,7 +152,36 @@ void kputchar(char c) {
     }
 }
 
+// SMP: сериализация вывода между CPU (VGA cursor/serial не reentrant).
+// Lock ждём без ограничения - строка без lock портила бы чужую. Вложенный
+// вызов на том же CPU (fault внутри kprintf → panic → kprintf) печатает
+// без lock: иначе он ждал бы сам себя.
+static volatile uint32_t kprintf_owner = 0;    // smp_current_cpu() + 1, 0 = свободен
+
+static volatile int kprintf_muted = 0;
+
+void kprintf_mute(int muted) {
+    kprintf_muted = muted;
+}
+
 int kprintf(const char* format, ...) {
+    if (kprintf_muted) {
+        return 0;
+    }
+
+    uint64_t irq_flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(irq_flags) :: "memory");
+
+    extern uint32_t smp_current_cpu(void);
+    uint32_t self = smp_current_cpu() + 1;
+    int locked = 0;
+    if (kprintf_owner != self) {
+        while (!__sync_bool_compare_and_swap(&kprintf_owner, 0, self)) {
+            asm volatile("pause");
+        }
+        locked = 1;
+    }
+
     va_list args;
     va_start(args, format);
     int count = 0;
@@ -568,18 +407,6 @@ int kprintf(const char* format, ...) {
                     }
                     break;
                 }
-                case 'f': {
-                    double num = va_arg(args, double);
-                    char buf[64];
-                    ftoa(num, buf, 6);
-                    int len = strlen(buf);
-                    for (int i = len; i < pad_width; ++i) {
-                        kputchar(' ');
-                        ++count;
-                    }
-                    for (char* p = buf; *p; ++p) { kputchar(*p); ++count; }
-                    break;
-                }
                 case 'c': {
                     char c = (char)va_arg(args, int);
                     kputchar(c);
@@ -613,6 +440,14 @@ int kprintf(const char* format, ...) {
         ++format;
     }
     va_end(args);
+
+    // Batch: изменённые строки на экран + cursor один раз на вызов
+    vga_update_cursor();
+
+    if (locked) {
+        __sync_lock_release(&kprintf_owner);
+    }
+    asm volatile("push %0; popfq" :: "r"(irq_flags) : "memory", "cc");
     return count;
 }
 
@@ -677,20 +512,23 @@ void spin_lock(spinlock_t* lock) {
     // This prevents deadlock if IRQ handler tries to acquire same lock
     uint64_t flags;
     asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
-    lock->saved_flags = flags;
 
     // Now acquire the lock (busy-wait with pause)
     while (__sync_lock_test_and_set(&lock->locked, 1)) {
         asm volatile("pause");  // CPU-friendly spin
     }
+
+    // SMP: saved_flags пишем только владея lock'ом - иначе затрём
+    // флаги CPU, который держит его сейчас
+    lock->saved_flags = flags;
 }
 
 void spin_unlock(spinlock_t* lock) {
-    // Release the lock first
+    // Читаем флаги ДО release: после него lock может взять другой CPU
+    uint64_t flags = lock->saved_flags;
     __sync_lock_release(&lock->locked);
 
     // CRITICAL FIX: Restore IRQ state (may re-enable interrupts)
-    uint64_t flags = lock->saved_flags;
     asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
 }
 
@@ -710,6 +548,49 @@ bool spin_trylock(spinlock_t* lock) {
     }
 }
 
+#define RWLOCK_WRITER   0x80000000u
+#define RWLOCK_WAITING  0x40000000u
+#define RWLOCK_READERS  0x3FFFFFFFu
+
+void rwlock_init(rwlock_t* lock) {
+    lock->state = 0;
+}
+
+void read_lock(rwlock_t* lock) {
+    for (;;) {
+        uint32_t state = lock->state;
+        if (!(state & (RWLOCK_WRITER | RWLOCK_WAITING)) &&
+            __sync_bool_compare_and_swap(&lock->state, state, state + 1)) {
+            return;
+        }
+        asm volatile("pause");
+    }
+}
+
+void read_unlock(rwlock_t* lock) {
+    __sync_fetch_and_sub(&lock->state, 1);
+}
+
+void write_lock(rwlock_t* lock) {
+    for (;;) {
+        // WAITING ставим каждый круг: его снимает писатель, взявший lock
+        __sync_fetch_and_or(&lock->state, RWLOCK_WAITING);
+        if (__sync_bool_compare_and_swap(&lock->state, RWLOCK_WAITING, RWLOCK_WRITER)) {
+            return;
+        }
+        asm volatile("pause");
+    }
+}
+
+void write_unlock(rwlock_t* lock) {
+    __sync_fetch_and_and(&lock->state, ~RWLOCK_WRITER);
+}
+
+bool write_trylock(rwlock_t* lock) {
+    return __sync_bool_compare_and_swap(&lock->state, 0, RWLOCK_WRITER) ||
+           __sync_bool_compare_and_swap(&lock->state, RWLOCK_WAITING, RWLOCK_WRITER);
+}
+
 // ========== Реализация списка ==========
 void list_init(list_t* list) {
     if (!list) return;
@@ -1049,47 +930,201 @@ char* strpbrk(const char* s, const char* accept) {
 }
 
 // ========== Работа с памятью ==========
-void* memset(void* s, int c, size_t n) {
-    unsigned char* p = (unsigned char*)s;
-    unsigned char uc = (unsigned char)c;
+//
+// Диспетчеризация по размеру:
+//   n < 16                 → пара перекрывающихся 1/2/4/8-байтных доступов
+//   n < MEM_REP_THRESHOLD  → 8-байтный цикл (unroll x4) + перекрывающийся хвост
+//   больше                 → rep movsb/stosb при ERMS, иначе rep movsq/stosq
+//
+// SSE здесь нет: memcpy зовут из IRQ handlers и из самого fpu.c (#NM),
+// где kernel_fpu_begin невозможен, а на больших копиях ERMS и так упирается
+// в пропускную способность памяти.
+
+// Невыровненные 8/4/2-байтные доступы без нарушения strict aliasing
+typedef uint64_t __attribute__((may_alias, aligned(1))) mem_u64;
+typedef uint32_t __attribute__((may_alias, aligned(1))) mem_u32;
+typedef uint16_t __attribute__((may_alias, aligned(1))) mem_u16;
+
+#define MEM_REP_THRESHOLD   256             // Ниже - старт rep дороже цикла
+#define MEM_BYTE_PATTERN    0x0101010101010101ULL
+#define CPUID7_EBX_ERMS     (1 << 9)        // Enhanced REP MOVSB/STOSB
+
+static int mem_use_erms = 0;                // До klib_mem_init - rep movsq
+
+void klib_mem_init(void) {
+    uint32_t a, b, c, d;
+    cpu_cpuid(0, 0, &a, &b, &c, &d);
+    if (a >= 7) {
+        cpu_cpuid(7, 0, &a, &b, &c, &d);
+        mem_use_erms = (b & CPUID7_EBX_ERMS) != 0;
+    }
+}
+
+// n < 16. Всё читается до записи - годится и для memmove
+static inline void mem_copy_small(uint8_t* d, const uint8_t* s, size_t n) {
+    if (n >= 8) {
+        uint64_t head = *(const mem_u64*)s;
+        uint64_t tail = *(const mem_u64*)(s + n - 8);
+        *(mem_u64*)d = head;
+        *(mem_u64*)(d + n - 8) = tail;
+    } else if (n >= 4) {
+        uint32_t head = *(const mem_u32*)s;
+        uint32_t tail = *(const mem_u32*)(s + n - 4);
+        *(mem_u32*)d = head;
+        *(mem_u32*)(d + n - 4) = tail;
+    } else if (n >= 2) {
+        uint16_t head = *(const mem_u16*)s;
+        uint16_t tail = *(const mem_u16*)(s + n - 2);
+        *(mem_u16*)d = head;
+        *(mem_u16*)(d + n - 2) = tail;
+    } else if (n) {
+        *d = *s;
+    }
+}
+
+// n >= 8, вперёд. Хвост читается первым - безопасно и при d < s с перекрытием
+static inline void mem_copy_forward(uint8_t* d, const uint8_t* s, size_t n) {
+    uint64_t tail = *(const mem_u64*)(s + n - 8);
+    uint8_t* tail_dst = d + n - 8;
+
+    while (n >= 32) {
+        uint64_t w0 = ((const mem_u64*)s)[0];
+        uint64_t w1 = ((const mem_u64*)s)[1];
+        uint64_t w2 = ((const mem_u64*)s)[2];
+        uint64_t w3 = ((const mem_u64*)s)[3];
+        ((mem_u64*)d)[0] = w0;
+        ((mem_u64*)d)[1] = w1;
+        ((mem_u64*)d)[2] = w2;
+        ((mem_u64*)d)[3] = w3;
+        d += 32;
+        s += 32;
+        n -= 32;
+    }
+    while (n >= 8) {
+        *(mem_u64*)d = *(const mem_u64*)s;
+        d += 8;
+        s += 8;
+        n -= 8;
+    }
+    *(mem_u64*)tail_dst = tail;
+}
+
+// n >= 8, назад (memmove при d > s с перекрытием). Голова читается первой
+static inline void mem_copy_backward(uint8_t* d, const uint8_t* s, size_t n) {
+    uint64_t head = *(const mem_u64*)s;
+    uint8_t* head_dst = d;
+
+    d += n;
+    s += n;
+    while (n >= 32) {
+        d -= 32;
+        s -= 32;
+        n -= 32;
+        uint64_t w3 = ((const mem_u64*)s)[3];
+        uint64_t w2 = ((const mem_u64*)s)[2];
+        uint64_t w1 = ((const mem_u64*)s)[1];
+        uint64_t w0 = ((const mem_u64*)s)[0];
+        ((mem_u64*)d)[3] = w3;
+        ((mem_u64*)d)[2] = w2;
+        ((mem_u64*)d)[1] = w1;
+        ((mem_u64*)d)[0] = w0;
+    }
+    while (n >= 8) {
+        d -= 8;
+        s -= 8;
+        n -= 8;
+        *(mem_u64*)d = *(const mem_u64*)s;
+    }
+    *(mem_u64*)head_dst = head;
+}
+
+// Непересекающиеся буферы, n >= MEM_REP_THRESHOLD
+static inline void mem_copy_rep(uint8_t* d, const uint8_t* s, size_t n) {
+    if (mem_use_erms) {
+        __asm__ volatile("rep movsb"
+                         : "+D"(d), "+S"(s), "+c"(n)
+                         :
+                         : "memory");
+        return;
+    }
+
+    size_t words = n >> 3;
+    __asm__ volatile("rep movsq"
+                     : "+D"(d), "+S"(s), "+c"(words)
+                     :
+                     : "memory");
+    mem_copy_small(d, s, n & 7);
+}
 
-    // For small sizes, just do byte-by-byte
-    if (n < 8) {
-        while (n--) *p++ = uc;
+void* memset(void* s, int c, size_t n) {
+    uint8_t* p = (uint8_t*)s;
+    uint64_t pattern = (uint8_t)c * MEM_BYTE_PATTERN;
+
+    if (n < 16) {
+        if (n >= 8) {
+            *(mem_u64*)p = pattern;
+            *(mem_u64*)(p + n - 8) = pattern;
+        } else if (n >= 4) {
+            *(mem_u32*)p = (uint32_t)pattern;
+            *(mem_u32*)(p + n - 4) = (uint32_t)pattern;
+        } else if (n >= 2) {
+            *(mem_u16*)p = (uint16_t)pattern;
+            *(mem_u16*)(p + n - 2) = (uint16_t)pattern;
+        } else if (n) {
+            *p = (uint8_t)c;
+        }
         return s;
     }
 
-    // Align to 8-byte boundary
-    while (((uintptr_t)p & 7) && n > 0) {
-        *p++ = uc;
-        n--;
-    }
-
-    // Fill 8 bytes at a time
-    if (n >= 8) {
-        uint64_t pattern = (uint64_t)uc | ((uint64_t)uc << 8) |
-                          ((uint64_t)uc << 16) | ((uint64_t)uc << 24) |
-                          ((uint64_t)uc << 32) | ((uint64_t)uc << 40) |
-                          ((uint64_t)uc << 48) | ((uint64_t)uc << 56);
-
-        uint64_t* p64 = (uint64_t*)p;
-        while (n >= 8) {
-            *p64++ = pattern;
-            n -= 8;
+    if (n >= MEM_REP_THRESHOLD) {
+        if (mem_use_erms) {
+            __asm__ volatile("rep stosb"
+                             : "+D"(p), "+c"(n)
+                             : "a"(c)
+                             : "memory");
+            return s;
         }
-        p = (unsigned char*)p64;
+
+        uint8_t* tail = p + n - 8;
+        size_t words = n >> 3;
+        __asm__ volatile("rep stosq"
+                         : "+D"(p), "+c"(words)
+                         : "a"(pattern)
+                         : "memory");
+        *(mem_u64*)tail = pattern;
+        return s;
     }
 
-    // Fill remaining bytes
-    while (n--) *p++ = uc;
+    uint8_t* tail = p + n - 8;
+    while (n >= 32) {
+        ((mem_u64*)p)[0] = pattern;
+        ((mem_u64*)p)[1] = pattern;
+        ((mem_u64*)p)[2] = pattern;
+        ((mem_u64*)p)[3] = pattern;
+        p += 32;
+        n -= 32;
+    }
+    while (n >= 8) {
+        *(mem_u64*)p = pattern;
+        p += 8;
+        n -= 8;
+    }
+    *(mem_u64*)tail = pattern;
 
     return s;
 }
 
 void* memcpy(void* dest, const void* src, size_t n) {
-    unsigned char* d = dest;
-    const unsigned char* s = src;
-    while (n--) *d++ = *s++;
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (n < 16) {
+        mem_copy_small(d, s, n);
+    } else if (n < MEM_REP_THRESHOLD) {
+        mem_copy_forward(d, s, n);
+    } else {
+        mem_copy_rep(d, s, n);
+    }
     return dest;
 }
 
@@ -1109,21 +1144,46 @@ void* memmem(const void* haystack, size_t haystacklen, const void* needle, size_
 }
 
 void* memmove(void* dest, const void* src, size_t n) {
-    unsigned char* d = dest;
-    const unsigned char* s = src;
-    
-    if (d < s) {
-        while (n--) *d++ = *s++;
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (d == s) {
+        return dest;
+    }
+    if (n < 16) {
+        mem_copy_small(d, s, n);
+        return dest;
+    }
+
+    // d вне [s, s + n): копия вперёд ничего не затирает заранее
+    if ((uintptr_t)(d - s) >= n) {
+        if (n >= MEM_REP_THRESHOLD && (uintptr_t)(s - d) >= n) {
+            mem_copy_rep(d, s, n);
+        } else {
+            mem_copy_forward(d, s, n);
+        }
     } else {
-        d += n;
-        s += n;
-        while (n--) *--d = *--s;
+        mem_copy_backward(d, s, n);
     }
     return dest;
 }
 
 int memcmp(const void* s1, const void* s2, size_t n) {
-    const unsigned char* p1 = s1, *p2 = s2;
+    const uint8_t* p1 = (const uint8_t*)s1;
+    const uint8_t* p2 = (const uint8_t*)s2;
+
+    while (n >= 8) {
+        uint64_t a = *(const mem_u64*)p1;
+        uint64_t b = *(const mem_u64*)p2;
+        if (a != b) {
+            // Little-endian: младший различающийся байт идёт первым в памяти
+            uint32_t shift = (uint32_t)__builtin_ctzll(a ^ b) & ~7u;
+            return (int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF);
+        }
+        p1 += 8;
+        p2 += 8;
+        n -= 8;
+    }
     while (n--) {
         if (*p1 != *p2) return *p1 - *p2;
         p1++, p2++;
@@ -1344,38 +1404,6 @@ char* ulltoa(unsigned long long value, char* str, int base) {
     return utoa64((uint64_t)value, str, base);
 }
 
-// Преобразование числа с плавающей точкой в строку
-void ftoa(double num, char* buf, int precision) {
-    int i = 0;
-
-    if (num < 0) {
-        buf[i++] = '-';
-        num = -num;
-    }
-
-    int int_part = (int)num;
-    double fractional_part = num - (double)int_part;
-
-    char intbuf[32];
-    itoa(int_part, intbuf, 10);
-    for (char* p = intbuf; *p; ++p) {
-        buf[i++] = *p;
-    }
-
-    if (precision > 0) {
-        buf[i++] = '.';
-
-        for (int j = 0; j < precision; j++) {
-            fractional_part *= 10.0;
-            int digit = (int)fractional_part;
-            buf[i++] = '0' + digit;
-            fractional_part -= digit;
-        }
-    }
-
-    buf[i] = '\0';
-}
-
 // ========== Утилиты ==========
 int atoi(const char* str) {
     int result = 0;
@@ -18,29 +18,20 @@ extern uintptr_t _kernel_start;
 #define ALIGN_UP(addr, align) (((addr) + (align) - 1) & ~((align) - 1))
 #define ALIGN_DOWN(addr, align) ((addr) & ~((align) - 1))
 
-// ========== Конфигурация ==========
-// Kernel heap size: DYNAMIC (calculated at runtime based on available RAM)
-// Formula: 3% of total RAM, clamped to [2MB, 16MB]
-#define KLIB_HEAP_MIN_SIZE    (2 * 1024 * 1024)   // 2MB minimum
-#define KLIB_HEAP_MAX_SIZE    (16 * 1024 * 1024)  // 16MB maximum
-#define KLIB_HEAP_RAM_PERCENT 3  // Use 3% of total RAM for kernel heap
-
-//QUESTION как настроить это правильно?
-#define KLIB_BLOCK_ALIGNMENT  32 //BUG: ЕСЛИ СНОВА ПОСТАВИТЬ 16 КАК БЫЛО ТО General page fault при команде ls!!! (почему?)
-#define KLIB_MAGIC_NUMBER     0xDEADBEEF
-
 // ========== Структуры данных ==========
-typedef struct mem_block {
-    size_t size;
-    struct mem_block *next;
-    uint32_t magic;
-} mem_block_t;
-
 typedef struct {
     uint32_t locked;
     uint64_t saved_flags;  // Saved RFLAGS (for IRQ state)
 } spinlock_t;
 
+// Reader/writer spinlock: читатели параллельно, писатель один. Ждущий
+// писатель закрывает вход новым читателям (не голодает). IRQ НЕ запрещает -
+// не для IRQ handlers и не брать под spin_lock (holder мог быть вытеснен
+// на этом CPU)
+typedef struct {
+    volatile uint32_t state;    // RWLOCK_WRITER | RWLOCK_WAITING | число читателей
+} rwlock_t;
+
 // Узел списка
 typedef struct list_node {
     void* data;
@@ -71,6 +62,7 @@ void list_remove(list_t* list, void* data, bool (*cmp)(void*, void*));
 void list_for_each(list_t* list, void (*func)(void*));
 
 // ========== Управление памятью ==========
+// Slab allocator (slab.c): size classes, per-CPU caches, большие - страницами
 void mem_init(void);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
@@ -79,6 +71,8 @@ void mem_stats(void);
 // ========== Отладка и вывод ==========
 __attribute__((noreturn)) void panic(const char* message, ...);
 int kprintf(const char* format, ...);
+// Глушит kprintf (bench: deck'и логируют каждое событие). panic печатает всегда
+void kprintf_mute(int muted);
 int ksnprintf(char* buf, size_t size, const char* fmt, ...);
 void kputchar(char c);
 int kputnl(void);
@@ -89,6 +83,13 @@ void spin_lock(spinlock_t* lock);
 void spin_unlock(spinlock_t* lock);
 bool spin_trylock(spinlock_t* lock);
 
+void rwlock_init(rwlock_t* lock);
+void read_lock(rwlock_t* lock);
+void read_unlock(rwlock_t* lock);
+void write_lock(rwlock_t* lock);
+void write_unlock(rwlock_t* lock);
+bool write_trylock(rwlock_t* lock);
+
 // ========== Строковые функции ==========
 size_t strlen(const char* s);
 size_t strnlen(const char* s, size_t maxlen);
@@ -103,6 +104,8 @@ char* strcat(char* dest, const char* src);
 char* strncat(char* dest, const char* src, size_t n);
 
 // ========== Работа с памятью ==========
+// Выбор rep movsb/stosb по CPUID (ERMS). До вызова работает rep movsq
+void klib_mem_init(void);
 void* memset(void* s, int c, size_t n);
 void* memcpy(void* dest, const void* src, size_t n);
 void* memmem(const void* haystack, size_t haystacklen, const void* needle, size_t needlelen);
@@ -134,7 +137,6 @@ long long atoll(const char* str);
 void delay(uint32_t milliseconds);
 
 // ========== Вспомогательные функции для форматирования ==========
-void ftoa(double num, char* buf, int precision);
 int toupper(int c);
 int tolower(int c);
 bool isdigit(int c);
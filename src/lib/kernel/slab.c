@@ -0,0 +1,370 @@
+#include "slab.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "atomics.h"
+
+// ============================================================================
+// GLOBAL STATE
+// ============================================================================
+
+#define SLAB_MAGIC          0x534C4142      // "SLAB"
+#define SLAB_LARGE_MAGIC    0x4C415247      // "LARG"
+
+// Заголовок slab - в начале его SLAB_SIZE блока
+typedef struct Slab {
+    uint32_t magic;
+    uint32_t in_use;                // Объектов выдано из slab
+    SlabCache* cache;
+    void* free;                     // Free list объектов
+    struct Slab* next;              // Partial list cache
+    struct Slab* prev;
+    uint8_t on_partial;
+} Slab;
+
+// Большой kmalloc: заголовок в начале страниц, данные - с SLAB_HEADER_SIZE
+typedef struct {
+    uint32_t magic;
+    uint32_t vmalloc;               // 1 = vmalloc, 0 = страницы PMM
+    size_t pages;
+} SlabLarge;
+
+_Static_assert(sizeof(Slab) <= SLAB_HEADER_SIZE, "Slab header must fit before the first object");
+
+static SlabCache kmalloc_caches[SLAB_KMALLOC_CLASSES];
+static const char* const kmalloc_names[SLAB_KMALLOC_CLASSES] = {
+    "kmalloc-32", "kmalloc-64", "kmalloc-128", "kmalloc-256",
+    "kmalloc-512", "kmalloc-1024", "kmalloc-2048", "kmalloc-4096"
+};
+
+static SlabCache* slab_caches = NULL;
+static spinlock_t slab_caches_lock;
+
+static volatile uint64_t slab_large_allocs = 0;
+static volatile uint64_t slab_large_pages = 0;      // Сейчас
+static volatile uint64_t slab_large_vmalloc = 0;    // Из них ушло в vmalloc
+
+static inline uint64_t slab_irq_save(void) {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void slab_irq_restore(uint64_t flags) {
+    asm volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+static inline void** slab_link(SlabCache* cache, void* object) {
+    return (void**)((uint8_t*)object + cache->link_offset);
+}
+
+static inline Slab* slab_of(const void* object) {
+    return (Slab*)ALIGN_DOWN((uintptr_t)object, SLAB_SIZE);
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+void slab_cache_init(SlabCache* cache, const char* name, uint32_t object_size, slab_ctor_t ctor) {
+    memset(cache, 0, sizeof(SlabCache));
+    cache->name = name;
+    cache->object_size = ALIGN_UP(MAX(object_size, (uint32_t)sizeof(void*)), 8);
+    cache->ctor = ctor;
+
+    // С ctor ссылка free list - за объектом: сконструированное состояние
+    // переживает free
+    cache->link_offset = ctor ? cache->object_size : 0;
+    cache->stride = cache->object_size + (ctor ? sizeof(void*) : 0);
+    cache->objects_per_slab = (SLAB_SIZE - SLAB_HEADER_SIZE) / cache->stride;
+    if (cache->objects_per_slab == 0) {
+        panic("slab_cache_init: %s object of %u bytes does not fit a slab", name, object_size);
+    }
+    spinlock_init(&cache->lock);
+
+    spin_lock(&slab_caches_lock);
+    cache->next = slab_caches;
+    slab_caches = cache;
+    spin_unlock(&slab_caches_lock);
+}
+
+void slab_init(void) {
+    spinlock_init(&slab_caches_lock);
+    for (uint32_t i = 0; i < SLAB_KMALLOC_CLASSES; i++) {
+        slab_cache_init(&kmalloc_caches[i], kmalloc_names[i], 1u << (SLAB_MIN_SHIFT + i), NULL);
+    }
+
+    kprintf("[SLAB] %d kmalloc classes %d..%d bytes, %dKB slabs, %d objects per CPU magazine\n",
+            SLAB_KMALLOC_CLASSES, SLAB_MIN_SIZE, SLAB_MAX_SIZE, SLAB_SIZE / 1024, SLAB_CPU_OBJECTS);
+}
+
+// ============================================================================
+// SLABS (под cache->lock)
+// ============================================================================
+
+static void slab_partial_push(SlabCache* cache, Slab* slab, int tail) {
+    slab->on_partial = 1;
+    if (!cache->partial) {
+        slab->next = slab->prev = slab;
+        cache->partial = slab;
+        return;
+    }
+    // Кольцо: tail = перед головой
+    Slab* head = cache->partial;
+    slab->next = head;
+    slab->prev = head->prev;
+    head->prev->next = slab;
+    head->prev = slab;
+    if (!tail) {
+        cache->partial = slab;
+    }
+}
+
+static void slab_partial_remove(SlabCache* cache, Slab* slab) {
+    slab->on_partial = 0;
+    if (slab->next == slab) {
+        cache->partial = NULL;
+        return;
+    }
+    slab->prev->next = slab->next;
+    slab->next->prev = slab->prev;
+    if (cache->partial == slab) {
+        cache->partial = slab->next;
+    }
+}
+
+static Slab* slab_grow(SlabCache* cache) {
+    // pmm_alloc(SLAB_PAGES) - buddy блок порядка 2, выровнен на SLAB_SIZE
+    Slab* slab = (Slab*)pmm_alloc(SLAB_PAGES);
+    if (!slab) {
+        return NULL;
+    }
+    if ((uintptr_t)slab & (SLAB_SIZE - 1)) {
+        panic("slab_grow: PMM returned unaligned slab %p", slab);
+    }
+
+    slab->magic = SLAB_MAGIC;
+    slab->in_use = 0;
+    slab->cache = cache;
+    slab->free = NULL;
+
+    uint8_t* objects = (uint8_t*)slab + SLAB_HEADER_SIZE;
+    for (uint32_t i = cache->objects_per_slab; i-- > 0; ) {
+        void* object = objects + i * cache->stride;
+        if (cache->ctor) {
+            cache->ctor(object);
+        }
+        *slab_link(cache, object) = slab->free;
+        slab->free = object;
+    }
+
+    slab_partial_push(cache, slab, 0);
+    cache->empty_slabs++;
+    cache->slabs++;
+    return slab;
+}
+
+static void* slab_take(SlabCache* cache) {
+    Slab* slab = cache->partial;
+    if (!slab && !(slab = slab_grow(cache))) {
+        return NULL;
+    }
+
+    void* object = slab->free;
+    slab->free = *slab_link(cache, object);
+    if (slab->in_use++ == 0) {
+        cache->empty_slabs--;
+    }
+    if (!slab->free) {
+        slab_partial_remove(cache, slab);
+    }
+    cache->in_use++;
+    return object;
+}
+
+static void slab_put(SlabCache* cache, void* object) {
+    Slab* slab = slab_of(object);
+    *slab_link(cache, object) = slab->free;
+    slab->free = object;
+    cache->in_use--;
+
+    if (!slab->on_partial) {
+        slab_partial_push(cache, slab, 0);  // Был полный: первым и заполнится
+    }
+    if (--slab->in_use > 0) {
+        return;
+    }
+
+    if (cache->empty_slabs >= SLAB_EMPTY_KEEP) {
+        slab_partial_remove(cache, slab);
+        slab->magic = 0;
+        cache->slabs--;
+        pmm_free(slab, SLAB_PAGES);
+    } else {
+        // Пустой - в хвост: объекты берутся из заполненных slabs
+        slab_partial_remove(cache, slab);
+        slab_partial_push(cache, slab, 1);
+        cache->empty_slabs++;
+    }
+}
+
+// ============================================================================
+// CACHE API (magazine CPU, lock cache - только на refill / drain)
+// ============================================================================
+
+void* slab_cache_alloc(SlabCache* cache) {
+    uint64_t flags = slab_irq_save();
+    SlabCpuCache* cpu = &cache->cpu[smp_current_cpu()];
+
+    if (cpu->count == 0) {
+        spin_lock(&cache->lock);
+        while (cpu->count < SLAB_CPU_BATCH) {
+            void* object = slab_take(cache);
+            if (!object) {
+                break;
+            }
+            cpu->objects[cpu->count++] = object;
+        }
+        spin_unlock(&cache->lock);
+        atomic_increment_u64(&cache->refills);
+    }
+
+    void* object = cpu->count > 0 ? cpu->objects[--cpu->count] : NULL;
+    slab_irq_restore(flags);
+
+    if (object) {
+        atomic_increment_u64(&cache->allocs);
+    }
+    return object;
+}
+
+void slab_cache_free(SlabCache* cache, void* object) {
+    uint64_t flags = slab_irq_save();
+    SlabCpuCache* cpu = &cache->cpu[smp_current_cpu()];
+
+    if (cpu->count == SLAB_CPU_OBJECTS) {
+        // Самые старые - в slabs, свежие (ещё в L1) остаются
+        spin_lock(&cache->lock);
+        for (uint32_t i = 0; i < SLAB_CPU_BATCH; i++) {
+            slab_put(cache, cpu->objects[i]);
+        }
+        spin_unlock(&cache->lock);
+        cpu->count -= SLAB_CPU_BATCH;
+        memmove(cpu->objects, cpu->objects + SLAB_CPU_BATCH, cpu->count * sizeof(void*));
+    }
+    cpu->objects[cpu->count++] = object;
+
+    slab_irq_restore(flags);
+}
+
+// ============================================================================
+// KMALLOC / KFREE
+// ============================================================================
+
+static void* slab_large_alloc(size_t size) {
+    // Не меньше SLAB_PAGES: блок buddy порядка >= 2 выровнен на SLAB_SIZE,
+    // kfree находит заголовок так же, как у slab
+    size_t pages = (size + SLAB_HEADER_SIZE + 4095) / 4096;
+    if (pages < SLAB_PAGES) {
+        pages = SLAB_PAGES;
+    }
+
+    uint32_t vmalloced = 0;
+    SlabLarge* large = (SlabLarge*)pmm_alloc(pages);
+    if (!large) {
+        // Подряд идущих страниц нет - vmalloc (NULL до vmm_init)
+        large = (SlabLarge*)vmalloc(pages * 4096);
+        vmalloced = 1;
+    }
+    if (!large) {
+        return NULL;
+    }
+
+    large->magic = SLAB_LARGE_MAGIC;
+    large->vmalloc = vmalloced;
+    large->pages = pages;
+
+    atomic_increment_u64(&slab_large_allocs);
+    atomic_add_u64(&slab_large_pages, pages);
+    if (vmalloced) {
+        atomic_increment_u64(&slab_large_vmalloc);
+    }
+    return (uint8_t*)large + SLAB_HEADER_SIZE;
+}
+
+void mem_init(void) {
+    slab_init();
+}
+
+void* kmalloc(size_t size) {
+    if (size == 0) return NULL;
+
+    if (size <= SLAB_MAX_SIZE) {
+        uint32_t shift = SLAB_MIN_SHIFT;
+        while ((1ULL << shift) < size) {
+            shift++;
+        }
+        return slab_cache_alloc(&kmalloc_caches[shift - SLAB_MIN_SHIFT]);
+    }
+    return slab_large_alloc(size);
+}
+
+void kfree(void* ptr) {
+    if (!ptr) return;
+
+    // vmalloc - в верхней половине, выровнен только на страницу
+    SlabLarge* large = (uintptr_t)ptr >= VMM_KERNEL_BASE
+                       ? (SlabLarge*)ALIGN_DOWN((uintptr_t)ptr, 4096)
+                       : (SlabLarge*)slab_of(ptr);
+
+    if (large->magic == SLAB_MAGIC) {
+        Slab* slab = (Slab*)large;
+        if (((uintptr_t)ptr - (uintptr_t)slab - SLAB_HEADER_SIZE) % slab->cache->stride != 0) {
+            panic("Invalid free: %p is not a start of %s object", ptr, slab->cache->name);
+        }
+        slab_cache_free(slab->cache, ptr);
+        return;
+    }
+
+    if (large->magic != SLAB_LARGE_MAGIC || (uint8_t*)ptr != (uint8_t*)large + SLAB_HEADER_SIZE) {
+        panic("Invalid free: bad magic number at %p!", ptr);
+    }
+
+    size_t pages = large->pages;
+    uint32_t vmalloced = large->vmalloc;
+    large->magic = 0;
+    atomic_add_u64(&slab_large_pages, -(uint64_t)pages);
+    if (vmalloced) {
+        vfree(large);
+    } else {
+        pmm_free(large, pages);
+    }
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+void slab_print_stats(void) {
+    kprintf("Slab caches:\n");
+    kprintf("  %-14s %6s %6s %8s %10s %8s\n", "cache", "size", "slabs", "in_use", "allocs", "refills");
+
+    spin_lock(&slab_caches_lock);
+    for (SlabCache* cache = slab_caches; cache; cache = cache->next) {
+        kprintf("  %-14s %6u %6lu %8lu %10lu %8lu\n",
+                cache->name, cache->object_size,
+                atomic_load_u64(&cache->slabs),
+                atomic_load_u64(&cache->in_use),
+                atomic_load_u64(&cache->allocs),
+                atomic_load_u64(&cache->refills));
+    }
+    spin_unlock(&slab_caches_lock);
+
+    kprintf("  large: allocs=%lu pages=%lu vmalloc=%lu\n",
+            atomic_load_u64(&slab_large_allocs),
+            atomic_load_u64(&slab_large_pages),
+            atomic_load_u64(&slab_large_vmalloc));
+}
+
+void mem_stats(void) {
+    slab_print_stats();
+}
@@ -0,0 +1,88 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "ktypes.h"
+#include "klib.h"  // spinlock_t
+#include "smp.h"   // SMP_MAX_CPUS
+
+// ============================================================================
+// SLAB ALLOCATOR - kmalloc size classes и caches объектов с constructor
+// ============================================================================
+//
+// Slab - SLAB_PAGES страниц из PMM (identity mapped, выровнен на SLAB_SIZE:
+// buddy отдаёт блок по его порядку): заголовок Slab, за ним объекты.
+// Свободные объекты - список через слово в объекте. kfree находит slab
+// по ALIGN_DOWN(ptr, SLAB_SIZE) - без поиска и общего lock'а.
+//
+// Каждый CPU держит magazine из SLAB_CPU_OBJECTS объектов каждого cache:
+// alloc/free - без lock'ов (IF = 0 на время операции), пустой / полный
+// magazine - SLAB_CPU_BATCH объектов за один захват lock'а cache.
+//
+// Constructor вызывается один раз, когда slab создаётся: объект
+// возвращается в cache в сконструированном состоянии (ссылка free list
+// у таких caches - за объектом, не поверх него).
+//
+// kmalloc: степени двойки SLAB_MIN_SIZE..SLAB_MAX_SIZE. Больше - отдельная
+// выделенная область страниц PMM с заголовком, без места в PMM -
+// vmalloc (после vmm_init). Heap растёт по требованию: slabs берутся из
+// PMM когда угодно, фиксированного пула нет.
+//
+// ============================================================================
+
+#define SLAB_PAGES          4
+#define SLAB_SIZE           (SLAB_PAGES * 4096)     // 16KB
+#define SLAB_HEADER_SIZE    64                      // Первый объект - со смещения 64
+
+#define SLAB_MIN_SHIFT      5                       // 32 байта (выравнивание kmalloc)
+#define SLAB_MAX_SHIFT      12                      // 4096 байт (3 объекта в slab)
+#define SLAB_MIN_SIZE       (1 << SLAB_MIN_SHIFT)
+#define SLAB_MAX_SIZE       (1 << SLAB_MAX_SHIFT)
+#define SLAB_KMALLOC_CLASSES (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+
+#define SLAB_CPU_OBJECTS    16                      // Объектов в magazine CPU
+#define SLAB_CPU_BATCH      8                       // Refill / drain за раз
+#define SLAB_EMPTY_KEEP     1                       // Пустых slabs в cache, остальные - в PMM
+
+typedef void (*slab_ctor_t)(void* object);
+
+typedef struct {
+    uint32_t count;
+    void* objects[SLAB_CPU_OBJECTS];                // [0] - самый старый
+} __attribute__((aligned(64))) SlabCpuCache;
+
+typedef struct SlabCache {
+    const char* name;
+    uint32_t object_size;
+    uint32_t stride;                                // object_size + ссылка free list (с ctor)
+    uint32_t link_offset;                           // Где в объекте ссылка free list
+    uint32_t objects_per_slab;
+    slab_ctor_t ctor;
+
+    spinlock_t lock;
+    struct Slab* partial;                           // Есть свободные объекты (в т.ч. пустые)
+    uint32_t empty_slabs;
+
+    volatile uint64_t slabs;                        // Slabs сейчас
+    volatile uint64_t in_use;                       // Объектов выдано (включая magazines)
+    volatile uint64_t allocs;
+    volatile uint64_t refills;                      // Захватов lock'а cache
+
+    SlabCpuCache cpu[SMP_MAX_CPUS];
+    struct SlabCache* next;                         // Все caches - для mem_stats
+} SlabCache;
+
+// kmalloc caches (вызывается из mem_init)
+void slab_init(void);
+
+// Cache объектов одного размера. ctor может быть NULL.
+// cache - память caller (static): без аллокаций
+void slab_cache_init(SlabCache* cache, const char* name, uint32_t object_size, slab_ctor_t ctor);
+
+// NULL = PMM исчерпан
+void* slab_cache_alloc(SlabCache* cache);
+void slab_cache_free(SlabCache* cache, void* object);
+
+// Статистика всех caches
+void slab_print_stats(void);
+
+#endif // SLAB_H
@@ -152,6 +152,14 @@ static void cmd_help(void) {
     newline();
     print_attr("System Commands:\n", VGA_SUCCESS);
 
+    print("  ");
+    print_attr("stats", VGA_LIGHT_CYAN);
+    print(" [deck]            Latency report / deck p99\n");
+
+    print("  ");
+    print_attr("trace", VGA_LIGHT_CYAN);
+    print(" [count]           Dump kernel trace\n");
+
     print("  ");
     print_attr("reboot", VGA_LIGHT_CYAN);
     print("                  Reboot system\n");
@@ -331,6 +339,44 @@ static void cmd_untag(void) {
     print_attr("(TagFS untag not yet implemented in user-space)\n", VGA_HINT);
 }
 
+// stats [deck] - Latency histograms, or p99 of one deck (1-4, 0 = Execution)
+static void cmd_stats(void) {
+    if (arg_count < 2) {
+        latency_report();
+        return;
+    }
+
+    int deck = atoi(args[1]);
+    if (deck < 0 || deck > 4) {
+        print_attr("Usage: stats [deck 0-4]\n", VGA_ERROR);
+        return;
+    }
+
+    char buf[16];
+    print("Deck ");
+    print(args[1]);
+    print(" p99 service: ");
+    itoa((int)latency_p99_ns((uint32_t)deck), buf);
+    print(buf);
+    print(" ns\n");
+}
+
+// trace [count] - Dump kernel trace records (oldest first, default all)
+static void cmd_trace(void) {
+    uint32_t max_records = 0;
+    if (arg_count >= 2) {
+        int count = atoi(args[1]);
+        if (count > 0) {
+            max_records = (uint32_t)count;
+        }
+    }
+
+    char buf[16];
+    itoa((int)trace_dump(max_records), buf);
+    print(buf);
+    print(" trace record(s)\n");
+}
+
 // reboot - Reboot system (stub)
 static void cmd_reboot(void) {
     print_attr("Reboot not yet implemented (needs ACPI)\n", VGA_WARNING);
@@ -401,6 +447,12 @@ static void parse_and_execute(char* line) {
     else if (strcmp(cmd, "untag") == 0) {
         cmd_untag();
     }
+    else if (strcmp(cmd, "stats") == 0) {
+        cmd_stats();
+    }
+    else if (strcmp(cmd, "trace") == 0) {
+        cmd_trace();
+    }
     else if (strcmp(cmd, "reboot") == 0) {
         cmd_reboot();
     }
@@ -11,8 +11,14 @@
 static EventRing* event_ring = (EventRing*)EVENT_RING_ADDR;
 static ResponseRing* response_ring = (ResponseRing*)RESULT_RING_ADDR;
 
-// Global event ID counter
-static uint64_t next_event_id = 1;
+// COMPACT rings: геометрию kernel пишет в header при создании процесса.
+// compact_results != NULL - процесс работает на COMPACT rings
+static CompactRing* compact_events = (CompactRing*)EVENT_RING_ADDR;
+static CompactRing* compact_results = NULL;
+static uint32_t compact_event_units = 0;
+static uint32_t compact_result_units = 0;
+static uint32_t compact_max_payload = 0;
+static int async_rings_ready = 0;
 
 // Static buffers
 static char readline_buffer[256];
@@ -20,63 +26,445 @@ static char strtok_buffer[256];
 static char* strtok_pos = NULL;
 
 // ============================================================================
-// INTERNAL: Event submission
+// ASYNC SUBMISSION
 // ============================================================================
+//
+// Ticket = порядковый номер события + 1, запись в таблице тикетов - по
+// (номер & 255). В FIXED номер совпадает с позицией слота в EventRing: слот
+// не переиспользуется, пока тикет не отпущен, поэтому таблица не
+// переполняется раньше ring. В COMPACT событие - запись из нескольких
+// units, её позиция хранится в тикете.
+//
+// Kernel при ingest пишет в слот/запись свой event id или
+// RING_EVENT_ID_REJECTED, ответ в ResponseRing приходит с тем же id. Ingest
+// идёт по порядку, поэтому id снимаются курсором async_ident_pos (до того,
+// как место в ring будет переписано), а ответ находит тикет через
+// open-addressed таблицу id -> тикет за O(1): сотни событий в полёте,
+// ответы в любом порядке, без пересканирования.
+
+#define ASYNC_WORKFLOW_ID 1             // Default workflow ID
+#define ASYNC_RING_MASK   (ASYNC_MAX_TICKETS - 1)
+#define ASYNC_ID_TABLE_SIZE (ASYNC_MAX_TICKETS * 2)    // Load factor <= 0.5
+#define ASYNC_ID_TABLE_MASK (ASYNC_ID_TABLE_SIZE - 1)
+
+enum {
+    TICKET_FREE = 0,
+    TICKET_QUEUED,              // В ring, tail ещё не опубликован
+    TICKET_SUBMITTED,           // Отдан kernel, ждём ответ
+    TICKET_DONE,                // Ответ получен, ждёт poll/wait
+    TICKET_DISCARDED,           // Ответ не нужен - освободить по приходу
+};
+
+typedef struct {
+    ticket_t ticket;
+    uint32_t state;
+    uint64_t pos;               // Позиция события в EventRing (COMPACT - в units)
+    Response response;
+} AsyncTicket;
+
+typedef struct {
+    uint64_t id;                // 0 = пусто
+    uint32_t index;             // Индекс в async_tickets
+} AsyncIdEntry;
+
+static AsyncTicket async_tickets[ASYNC_MAX_TICKETS];
+static AsyncIdEntry async_ids[ASYNC_ID_TABLE_SIZE];
+static uint64_t async_tail = 0;         // Номер следующего тикета
+static uint64_t async_published = 0;    // Номер первого неопубликованного тикета
+static uint64_t async_ident_pos = 0;    // Номер первого тикета, чей id ещё не снят
+static uint64_t async_ring_tail = 0;    // Локальная копия EventRing.tail (FIXED = async_tail)
+
+// Формат rings один раз из header: у FIXED size_units (на месте padding) = 0
+static void async_rings_init(void) {
+    if (async_rings_ready) {
+        return;
+    }
+    async_rings_ready = 1;
+
+    uint32_t units = compact_events->size_units;
+    if (units == 0) {
+        return;
+    }
+    compact_event_units = units;
+    compact_max_payload = compact_events->max_entry_units * COMPACT_UNIT_SIZE - sizeof(CompactEvent);
+    compact_results = (CompactRing*)(EVENT_RING_ADDR + sizeof(CompactRing) +
+                                     (uint64_t)units * COMPACT_UNIT_SIZE);
+    compact_result_units = compact_results->size_units;
+}
 
-static int push_event(Event* ev) {
-    uint64_t tail = event_ring->tail;
-    uint64_t head = event_ring->head;
+static inline void* compact_at(CompactRing* ring, uint32_t size_units, uint64_t pos) {
+    return ring->data + (pos & (size_units - 1)) * COMPACT_UNIT_SIZE;
+}
 
-    // Check if full
-    if (tail - head >= 256) {
-        return 0;  // Ring full
+// id события тикета (kernel пишет при ingest, 0 = ещё не принято)
+static uint64_t async_event_id(const AsyncTicket* t) {
+    if (compact_results) {
+        CompactEvent* ev = (CompactEvent*)compact_at(compact_events, compact_event_units, t->pos);
+        return ev->id;
     }
+    return *(volatile uint64_t*)&event_ring->events[t->pos & ASYNC_RING_MASK].id;
+}
 
-    // Copy event to ring
-    uint64_t idx = tail & 0xFF;
-    Event* slot = &event_ring->events[idx];
+static AsyncTicket* async_lookup(ticket_t ticket) {
+    if (ticket == 0) {
+        return NULL;
+    }
+    AsyncTicket* t = &async_tickets[(ticket - 1) & ASYNC_RING_MASK];
+    return (t->ticket == ticket && t->state != TICKET_FREE) ? t : NULL;
+}
+
+static void async_release(AsyncTicket* t) {
+    t->state = TICKET_FREE;
+    t->ticket = 0;
+}
 
-    // Copy 256 bytes
-    uint64_t* src = (uint64_t*)ev;
-    uint64_t* dst = (uint64_t*)slot;
-    for (int i = 0; i < 32; i++) {  // 256/8 = 32 qwords
-        dst[i] = src[i];
+// Kernel id последовательные - младшие биты уже хорошо распределены
+static void async_id_insert(uint64_t id, uint32_t index) {
+    uint32_t h = id & ASYNC_ID_TABLE_MASK;
+    while (async_ids[h].id != 0) {
+        h = (h + 1) & ASYNC_ID_TABLE_MASK;
     }
+    async_ids[h].id = id;
+    async_ids[h].index = index;
+}
 
-    // Memory barrier and update tail
-    __asm__ volatile("mfence" ::: "memory");
-    event_ring->tail = tail + 1;
+// Найти и удалить (backward shift - без tombstones)
+static int async_id_take(uint64_t id) {
+    uint32_t h = id & ASYNC_ID_TABLE_MASK;
+    while (async_ids[h].id != id) {
+        if (async_ids[h].id == 0) {
+            return -1;
+        }
+        h = (h + 1) & ASYNC_ID_TABLE_MASK;
+    }
+    int index = (int)async_ids[h].index;
+
+    uint32_t hole = h;
+    for (uint32_t next = (h + 1) & ASYNC_ID_TABLE_MASK; async_ids[next].id != 0;
+         next = (next + 1) & ASYNC_ID_TABLE_MASK) {
+        uint32_t home = async_ids[next].id & ASYNC_ID_TABLE_MASK;
+        // Сдвигаем, если hole лежит между home и next (циклически)
+        if (((next - home) & ASYNC_ID_TABLE_MASK) >= ((next - hole) & ASYNC_ID_TABLE_MASK)) {
+            async_ids[hole] = async_ids[next];
+            hole = next;
+        }
+    }
+    async_ids[hole].id = 0;
+    return index;
+}
 
-    return 1;
+// Снять kernel id принятых событий из их слотов (по порядку ingest)
+static void async_identify(void) {
+    while (async_ident_pos != async_published) {
+        uint32_t index = async_ident_pos & ASYNC_RING_MASK;
+        AsyncTicket* t = &async_tickets[index];
+        uint64_t id = async_event_id(t);
+        if (id == 0) {
+            break;  // Kernel ещё не принял (credit / SQPOLL не дошёл)
+        }
+
+        if (id == RING_EVENT_ID_REJECTED) {
+            // Ответа не будет - завершаем тикет ошибкой, а не ждём вечно
+            if (t->state == TICKET_DISCARDED) {
+                async_release(t);
+            } else if (t->state == TICKET_SUBMITTED) {
+                memset(&t->response, 0, sizeof(Response));
+                t->response.status = 1;
+                t->state = TICKET_DONE;
+            }
+        } else {
+            async_id_insert(id, index);
+        }
+        async_ident_pos++;
+    }
 }
 
-static int pop_response(Response* resp) {
+// Тикет для ответа на event_id (DISCARDED освобождается сразу). NULL = не наш
+static AsyncTicket* async_match(uint64_t event_id) {
+    int index = async_id_take(event_id);
+    if (index < 0) {
+        async_identify();  // Ответ обогнал наш снимок id
+        index = async_id_take(event_id);
+    }
+    if (index < 0) {
+        return NULL;
+    }
+
+    AsyncTicket* t = &async_tickets[index];
+    if (t->state == TICKET_DISCARDED) {
+        async_release(t);
+        return NULL;
+    }
+    t->state = TICKET_DONE;
+    return t;
+}
+
+// COMPACT: записи переменной длины, PAD пропускаем. В Response - первые
+// 8 байт результата (указатель или значение, как в FIXED слоте)
+static void async_reap_compact(void) {
+    uint64_t head = compact_results->head;
+    uint64_t tail = compact_results->tail;
+    if (head == tail) {
+        return;
+    }
+    __asm__ volatile("" ::: "memory");
+
+    while (head != tail) {
+        CompactResult* rec = (CompactResult*)compact_at(compact_results, compact_result_units, head);
+        uint32_t units = rec->header.units ? rec->header.units : 1;
+
+        if (!(rec->header.flags & COMPACT_FLAG_PAD)) {
+            AsyncTicket* t = async_match(rec->event_id);
+            if (t) {
+                Response* r = &t->response;
+                memset(r, 0, sizeof(Response));
+                r->event_id = rec->event_id;
+                r->workflow_id = rec->workflow_id;
+                r->status = rec->header.type;
+                r->error_code = rec->error_code;
+                r->timestamp = rec->completion_time;
+                r->result_size = rec->result_size;
+                memcpy(&r->result_data, rec->result,
+                       rec->result_size < sizeof(void*) ? rec->result_size : sizeof(void*));
+            }
+        }
+        head += units;
+    }
+
+    __asm__ volatile("mfence" ::: "memory");
+    compact_results->head = head;
+}
+
+// Разобрать все ответы из ResponseRing по тикетам
+static void async_reap(void) {
+    if (compact_results) {
+        async_reap_compact();
+        return;
+    }
+
     uint64_t head = response_ring->head;
-    uint64_t tail = response_ring->tail;
+    uint64_t tail = *(volatile uint64_t*)&response_ring->tail;
+    if (head == tail) {
+        return;
+    }
+    __asm__ volatile("" ::: "memory");
 
-    // Check if empty
-    if (head >= tail) {
-        return 0;
+    while (head != tail) {
+        Response* slot = &response_ring->responses[head & 0xFF];
+        AsyncTicket* t = async_match(slot->event_id);
+        if (t) {
+            memcpy(&t->response, slot, sizeof(Response));
+        }
+        head++;
     }
 
-    // Copy response from ring
-    uint64_t idx = head & 0xFF;
-    Response* slot = &response_ring->responses[idx];
+    __asm__ volatile("mfence" ::: "memory");
+    response_ring->head = head;
+}
+
+// COMPACT: запись ceil((header + payload) / 64) units, не через конец ring -
+// иначе PAD до конца и запись с нуля. NULL = места нет
+static CompactEvent* async_compact_reserve(size_t payload_size, uint64_t* pos_out) {
+    uint32_t size = compact_event_units;
+    uint32_t units = (uint32_t)((sizeof(CompactEvent) + payload_size + COMPACT_UNIT_SIZE - 1) /
+                                COMPACT_UNIT_SIZE);
+    uint64_t tail = async_ring_tail;
+    uint64_t offset = tail & (size - 1);
+    uint64_t pad = (offset + units > size) ? size - offset : 0;
+
+    if ((tail - compact_events->head) + pad + units > size) {
+        return NULL;
+    }
+
+    if (pad) {
+        CompactHeader* skip = (CompactHeader*)compact_at(compact_events, size, tail);
+        skip->units = (uint16_t)pad;
+        skip->flags = COMPACT_FLAG_PAD;
+        skip->type = 0;
+    }
 
-    // Copy response structure
-    uint64_t* src = (uint64_t*)slot;
-    uint64_t* dst = (uint64_t*)resp;
-    for (int i = 0; i < sizeof(Response)/8; i++) {
-        dst[i] = src[i];
+    CompactEvent* ev = (CompactEvent*)compact_at(compact_events, size, tail + pad);
+    ev->header.units = (uint16_t)units;
+    *pos_out = tail + pad;
+    async_ring_tail = tail + pad + units;
+    return ev;
+}
+
+ticket_t async_submit(uint32_t type, uint8_t deck_prefix, const void* payload, size_t payload_size) {
+    async_rings_init();
+
+    uint64_t seq = async_tail;
+    AsyncTicket* t = &async_tickets[seq & ASYNC_RING_MASK];
+    if (t->state != TICKET_FREE) {
+        return 0;  // Тикет ещё не отпущен
+    }
+    if (!payload) {
+        payload_size = 0;
     }
+    if (payload_size > EVENT_DATA_SIZE) {
+        payload_size = EVENT_DATA_SIZE;
+    }
+
+    uint64_t pos;
+    if (compact_results) {
+        // Место от уже принятых записей переиспользуется - их id снимаем до записи
+        async_identify();
+        if (payload_size > compact_max_payload) {
+            payload_size = compact_max_payload;
+        }
 
-    // Update head
+        CompactEvent* ev = async_compact_reserve(payload_size, &pos);
+        if (!ev) {
+            return 0;  // Нет места в ring
+        }
+        ev->header.flags = 0;
+        ev->header.type = type;
+        ev->id = 0;                     // Kernel assigns
+        ev->workflow_id = ASYNC_WORKFLOW_ID;
+        *(volatile uint64_t*)ev->route = deck_prefix;
+        ev->payload_size = (uint32_t)payload_size;
+        ev->buf_index = 0;
+        ev->priority = 0;
+        ev->_reserved = 0;
+        ev->buf_offset = 0;
+        ev->buf_length = 0;
+        memcpy(ev->payload, payload, payload_size);
+    } else {
+        pos = seq;
+        // Слот занят kernel
+        if (pos - event_ring->head >= ASYNC_MAX_TICKETS) {
+            return 0;
+        }
+        // Прошлый id этого слота должен попасть в таблицу раньше, чем его затрём
+        if (pos - async_ident_pos >= ASYNC_MAX_TICKETS) {
+            async_identify();
+        }
+
+        // Прямо в слот, без промежуточного Event на стеке
+        Event* ev = &event_ring->events[pos & ASYNC_RING_MASK];
+        ev->id = 0;                     // Kernel assigns
+        ev->user_id = ASYNC_WORKFLOW_ID;
+        ev->type = type;
+        ev->timestamp = 0;              // Kernel fills this
+        // Route: deck_prefix → 0 (execution), одним store
+        *(volatile uint64_t*)ev->route = deck_prefix;
+
+        memcpy(ev->data, payload, payload_size);
+        // Хвост слота от прошлого события - decks ждут нули после payload
+        memset(ev->data + payload_size, 0, EVENT_DATA_SIZE - payload_size);
+        async_ring_tail = pos + 1;
+    }
+
+    t->ticket = seq + 1;
+    t->state = TICKET_QUEUED;
+    t->pos = pos;
+    async_tail = seq + 1;
+    return t->ticket;
+}
+
+int async_flush(void) {
+    uint64_t pos = async_published;
+    if (pos == async_tail) {
+        return 0;
+    }
+
+    // Memory barrier and update tail - один раз на batch (у COMPACT tail
+    // на том же смещении)
     __asm__ volatile("mfence" ::: "memory");
-    response_ring->head = head + 1;
+    event_ring->tail = async_ring_tail;
+    async_published = async_tail;
+
+    int count = 0;
+    for (; pos != async_tail; pos++) {
+        AsyncTicket* t = &async_tickets[pos & ASYNC_RING_MASK];
+        if (t->state == TICKET_QUEUED) {
+            t->state = TICKET_SUBMITTED;
+        }
+        count++;
+    }
 
+    kernel_notify(ASYNC_WORKFLOW_ID, NOTIFY_SUBMIT);
+    async_identify();
+    return count;
+}
+
+int async_poll(ticket_t ticket, Response* out) {
+    AsyncTicket* t = async_lookup(ticket);
+    if (!t) {
+        return -1;
+    }
+    if (t->state != TICKET_DONE) {
+        async_reap();
+        if (t->state != TICKET_DONE) {
+            return 0;
+        }
+    }
+
+    if (out) {
+        memcpy(out, &t->response, sizeof(Response));
+    }
+    async_release(t);
     return 1;
 }
 
+int async_wait(ticket_t ticket, Response* out) {
+    return async_wait_any(&ticket, 1, out) == 0 ? 1 : -1;
+}
+
+int async_wait_any(const ticket_t* tickets, int count, Response* out) {
+    async_flush();
+
+    while (1) {
+        int valid = 0;
+        for (int i = 0; i < count; i++) {
+            int r = async_poll(tickets[i], out);
+            if (r == 1) {
+                return i;
+            }
+            valid += (r == 0);
+        }
+        if (valid == 0) {
+            return -1;
+        }
+
+        // Wait for completion (результат между poll и WAIT - WAIT вернётся сразу)
+        kernel_notify(ASYNC_WORKFLOW_ID, NOTIFY_WAIT);
+    }
+}
+
+int async_wait_all(const ticket_t* tickets, int count, Response* out) {
+    async_flush();
+
+    int done = 0;
+    for (int i = 0; i < count; i++) {
+        while (1) {
+            int r = async_poll(tickets[i], out ? &out[i] : NULL);
+            if (r != 0) {
+                done += (r == 1);
+                break;
+            }
+            kernel_notify(ASYNC_WORKFLOW_ID, NOTIFY_WAIT);
+        }
+    }
+    return done;
+}
+
+void async_discard(ticket_t ticket) {
+    AsyncTicket* t = async_lookup(ticket);
+    if (!t) {
+        return;
+    }
+    if (t->state == TICKET_DONE) {
+        async_release(t);
+    } else {
+        // QUEUED тоже: станет SUBMITTED при flush - не отменяем, только забываем
+        if (t->state == TICKET_QUEUED) {
+            async_flush();
+        }
+        t->state = TICKET_DISCARDED;
+    }
+}
+
 // ============================================================================
 // INTERNAL: Simple event execution
 // ============================================================================
@@ -85,47 +473,13 @@ static int pop_response(Response* resp) {
 static int execute_event(uint32_t type, uint8_t deck_prefix,
                          void* payload, size_t payload_size,
                          Response* out_response) {
-    // Build event
-    Event ev;
-    memset(&ev, 0, sizeof(ev));
-
-    ev.id = next_event_id++;
-    ev.user_id = 1;  // Default workflow ID
-    ev.type = type;
-    ev.timestamp = 0;  // Kernel fills this
-
-    // Route: deck_prefix → 0 (execution)
-    ev.route[0] = deck_prefix;
-    ev.route[1] = 0;  // Execution deck
-
-    // Copy payload
-    if (payload && payload_size > 0) {
-        if (payload_size > EVENT_DATA_SIZE) {
-            payload_size = EVENT_DATA_SIZE;
-        }
-        memcpy(ev.data, payload, payload_size);
-    }
-
-    // Push event
-    if (!push_event(&ev)) {
+    ticket_t ticket = async_submit(type, deck_prefix, payload, payload_size);
+    if (!ticket) {
         return 0;  // Failed to push
     }
 
-    // Notify kernel to process
-    kernel_notify(1, NOTIFY_SUBMIT);
-
-    // Wait for completion
-    kernel_notify(1, NOTIFY_WAIT);
-
-    // Get response
-    if (out_response) {
-        return pop_response(out_response);
-    }
-
-    // Drain response even if not needed
     Response dummy;
-    pop_response(&dummy);
-    return 1;
+    return async_wait(ticket, out_response ? out_response : &dummy) == 1;
 }
 
 // ============================================================================
@@ -244,16 +598,64 @@ char* strncpy(char* dest, const char* src, size_t n) {
     return dest;
 }
 
+// Word-at-a-time memset/memcpy: overlapping head/tail stores for short
+// sizes, 8-byte loop for medium, rep stosq/movsq for large. Payload
+// packing (sizeof(Response), EVENT_DATA_SIZE) lands in the first two.
+typedef uint64_t __attribute__((may_alias, aligned(1))) ulib_u64;
+typedef uint32_t __attribute__((may_alias, aligned(1))) ulib_u32;
+
+#define ULIB_REP_THRESHOLD 256
+
 void* memset(void* s, int c, size_t n) {
-    unsigned char* p = s;
-    while (n--) *p++ = (unsigned char)c;
+    uint8_t* p = s;
+    uint64_t pattern = (uint8_t)c * 0x0101010101010101ULL;
+
+    if (n < 8) {
+        if (n >= 4) {
+            *(ulib_u32*)p = (uint32_t)pattern;
+            *(ulib_u32*)(p + n - 4) = (uint32_t)pattern;
+        } else {
+            while (n--) *p++ = (uint8_t)c;
+        }
+        return s;
+    }
+
+    uint8_t* tail = p + n - 8;
+    if (n >= ULIB_REP_THRESHOLD) {
+        size_t words = n >> 3;
+        __asm__ volatile("rep stosq" : "+D"(p), "+c"(words) : "a"(pattern) : "memory");
+    } else {
+        for (; n >= 8; n -= 8, p += 8) *(ulib_u64*)p = pattern;
+    }
+    *(ulib_u64*)tail = pattern;
     return s;
 }
 
 void* memcpy(void* dest, const void* src, size_t n) {
-    unsigned char* d = dest;
-    const unsigned char* s = src;
-    while (n--) *d++ = *s++;
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+
+    if (n < 8) {
+        if (n >= 4) {
+            uint32_t head = *(const ulib_u32*)s;
+            uint32_t tail = *(const ulib_u32*)(s + n - 4);
+            *(ulib_u32*)d = head;
+            *(ulib_u32*)(d + n - 4) = tail;
+        } else {
+            while (n--) *d++ = *s++;
+        }
+        return dest;
+    }
+
+    uint64_t tail = *(const ulib_u64*)(s + n - 8);
+    uint8_t* tail_dst = d + n - 8;
+    if (n >= ULIB_REP_THRESHOLD) {
+        size_t words = n >> 3;
+        __asm__ volatile("rep movsq" : "+D"(d), "+S"(s), "+c"(words) : : "memory");
+    } else {
+        for (; n >= 8; n -= 8, d += 8, s += 8) *(ulib_u64*)d = *(const ulib_u64*)s;
+    }
+    *(ulib_u64*)tail_dst = tail;
     return dest;
 }
 
@@ -364,6 +766,227 @@ void itoa(int value, char* str) {
     }
 }
 
+// ============================================================================
+// HEAP
+// ============================================================================
+//
+// Chunk (kernel выравнивает его на HEAP_CHUNK_SIZE) начинается с HeapChunk.
+// Small chunk принадлежит одному size class: блоки - из free list, затем
+// bump'ом из нетронутой части, так что lazy страницы за bump не трогаются.
+// Large - отдельный регион на один блок с тем же header. Блок → chunk:
+// ptr & ~(HEAP_CHUNK_SIZE - 1), header всегда в первых 64KB региона.
+
+#define HEAP_MIN_SHIFT    4                     // Класс 0 = 16 байт
+#define HEAP_CLASSES      9                     // 16 .. 4096
+#define HEAP_HEADER_SIZE  64                    // Блоки выровнены на 16
+#define HEAP_PAGE_SIZE    4096
+#define HEAP_LARGE        0xFFFFFFFF            // size_class large региона
+#define HEAP_LARGE_MAX    (16 * 1024 * 1024 - HEAP_HEADER_SIZE) // Предел Storage deck на регион
+
+typedef struct HeapChunk {
+    struct HeapChunk* next;         // Partial list класса
+    struct HeapChunk* prev;
+    void* free_list;                // Освобождённые блоки
+    uint8_t* bump;                  // Начало ни разу не выданной части
+    uint64_t region_size;           // Байт, полученных от kernel
+    uint32_t size_class;            // HEAP_LARGE = регион одного блока
+    uint32_t block_size;
+    uint32_t used;                  // Выданных блоков
+    uint32_t capacity;
+} HeapChunk;
+
+typedef struct {
+    HeapChunk* partial;             // Chunks со свободными блоками, голова - текущий
+    HeapChunk* spare;               // Пустой chunk в запасе
+} HeapClass;
+
+static HeapClass heap_classes[HEAP_CLASSES];
+
+static void* heap_map(uint64_t size) {
+    Response resp;
+    if (!execute_event(EVENT_MEMORY_ALLOC, 2, &size, 8, &resp) || resp.status != 0) {
+        return NULL;
+    }
+    return resp.result_data;
+}
+
+static void heap_unmap(void* addr, uint64_t size) {
+    uint64_t payload[2] = { (uint64_t)addr, size };
+    execute_event(EVENT_MEMORY_FREE, 2, payload, sizeof(payload), NULL);
+}
+
+static inline HeapChunk* heap_chunk_of(void* ptr) {
+    return (HeapChunk*)((uint64_t)ptr & ~(uint64_t)(HEAP_CHUNK_SIZE - 1));
+}
+
+// size 1..HEAP_SMALL_MAX → класс с блоком 16 << class
+static inline uint32_t heap_class_of(size_t size) {
+    if (size <= (1u << HEAP_MIN_SHIFT)) {
+        return 0;
+    }
+    return (uint32_t)(64 - __builtin_clzll(size - 1)) - HEAP_MIN_SHIFT;
+}
+
+static void heap_link(HeapClass* cls, HeapChunk* chunk) {
+    chunk->prev = NULL;
+    chunk->next = cls->partial;
+    if (cls->partial) {
+        cls->partial->prev = chunk;
+    }
+    cls->partial = chunk;
+}
+
+static void heap_unlink(HeapClass* cls, HeapChunk* chunk) {
+    if (chunk->prev) {
+        chunk->prev->next = chunk->next;
+    } else {
+        cls->partial = chunk->next;
+    }
+    if (chunk->next) {
+        chunk->next->prev = chunk->prev;
+    }
+}
+
+static void heap_chunk_reset(HeapChunk* chunk) {
+    chunk->free_list = NULL;
+    chunk->bump = (uint8_t*)chunk + HEAP_HEADER_SIZE;
+    chunk->used = 0;
+}
+
+static HeapChunk* heap_chunk_new(uint32_t size_class) {
+    HeapClass* cls = &heap_classes[size_class];
+    HeapChunk* chunk = cls->spare;
+
+    if (chunk) {
+        cls->spare = NULL;
+    } else {
+        chunk = (HeapChunk*)heap_map(HEAP_CHUNK_SIZE);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->region_size = HEAP_CHUNK_SIZE;
+        chunk->size_class = size_class;
+        chunk->block_size = (1u << HEAP_MIN_SHIFT) << size_class;
+        chunk->capacity = (HEAP_CHUNK_SIZE - HEAP_HEADER_SIZE) / chunk->block_size;
+    }
+
+    heap_chunk_reset(chunk);
+    heap_link(cls, chunk);
+    return chunk;
+}
+
+static void* heap_large_alloc(size_t size) {
+    uint64_t region = (HEAP_HEADER_SIZE + size + HEAP_PAGE_SIZE - 1) & ~(uint64_t)(HEAP_PAGE_SIZE - 1);
+    HeapChunk* chunk = (HeapChunk*)heap_map(region);
+    if (!chunk) {
+        return NULL;
+    }
+
+    chunk->region_size = region;
+    chunk->size_class = HEAP_LARGE;
+    return (uint8_t*)chunk + HEAP_HEADER_SIZE;
+}
+
+void* malloc(size_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+    if (size > HEAP_SMALL_MAX) {
+        return size > HEAP_LARGE_MAX ? NULL : heap_large_alloc(size);
+    }
+
+    HeapClass* cls = &heap_classes[heap_class_of(size)];
+    HeapChunk* chunk = cls->partial;
+    if (!chunk) {
+        chunk = heap_chunk_new(heap_class_of(size));
+        if (!chunk) {
+            return NULL;
+        }
+    }
+
+    void* block = chunk->free_list;
+    if (block) {
+        chunk->free_list = *(void**)block;
+    } else {
+        block = chunk->bump;
+        chunk->bump += chunk->block_size;
+    }
+
+    // Полный chunk уходит из partial list до первого free
+    if (++chunk->used == chunk->capacity) {
+        heap_unlink(cls, chunk);
+    }
+    return block;
+}
+
+void free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    HeapChunk* chunk = heap_chunk_of(ptr);
+    if (chunk->size_class == HEAP_LARGE) {
+        heap_unmap(chunk, chunk->region_size);
+        return;
+    }
+
+    HeapClass* cls = &heap_classes[chunk->size_class];
+    *(void**)ptr = chunk->free_list;
+    chunk->free_list = ptr;
+
+    if (chunk->used-- == chunk->capacity) {
+        heap_link(cls, chunk);
+    }
+    if (chunk->used > 0) {
+        return;
+    }
+
+    // Пустой chunk: один остаётся в запасе, остальные - обратно kernel
+    heap_unlink(cls, chunk);
+    if (!cls->spare) {
+        cls->spare = chunk;
+    } else {
+        heap_unmap(chunk, chunk->region_size);
+    }
+}
+
+void* calloc(size_t count, size_t size) {
+    if (size && count > (size_t)-1 / size) {
+        return NULL;
+    }
+
+    void* ptr = malloc(count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (!ptr) {
+        return malloc(size);
+    }
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    HeapChunk* chunk = heap_chunk_of(ptr);
+    size_t usable = chunk->size_class == HEAP_LARGE
+                  ? chunk->region_size - HEAP_HEADER_SIZE
+                  : chunk->block_size;
+    if (size <= usable) {
+        return ptr;
+    }
+
+    void* grown = malloc(size);
+    if (grown) {
+        memcpy(grown, ptr, usable);
+        free(ptr);
+    }
+    return grown;
+}
+
 // ============================================================================
 // PROCESS CONTROL
 // ============================================================================
@@ -373,3 +996,96 @@ void sleep_ms(uint32_t ms) {
     uint64_t payload = ms;
     execute_event(EVENT_TIMER_SLEEP, 3, &payload, 8, NULL);
 }
+
+// ============================================================================
+// TIME
+// ============================================================================
+
+#define KDATA ((const KernelData*)KDATA_ADDR)
+#define KDATA_BARRIER() __asm__ volatile("" ::: "memory")
+
+static inline uint64_t ulib_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+uint64_t ulib_now(void) {
+    if (KDATA->version != KDATA_VERSION) {
+        return 0;
+    }
+
+    uint32_t seq;
+    uint64_t hz, base, ns_base_tsc, ns_base, mult, tsc;
+    do {
+        seq = KDATA->seq;
+        KDATA_BARRIER();
+        hz = KDATA->tsc_hz;
+        base = KDATA->tsc_base;
+        ns_base_tsc = KDATA->ns_base_tsc;
+        ns_base = KDATA->ns_base;
+        mult = KDATA->ns_mult;
+        tsc = ulib_rdtsc();
+        KDATA_BARRIER();
+    } while ((seq & 1) || seq != KDATA->seq);
+
+    uint64_t delta = tsc - ns_base_tsc;
+    if (delta < hz) {
+        return ns_base + ((delta * mult) >> 32);
+    }
+
+    // Snapshot too old for mult (overflow) - divide from boot, like kernel clock_ns()
+    delta = tsc - base;
+    return (delta / hz) * 1000000000ULL + ((delta % hz) * 1000000000ULL) / hz;
+}
+
+uint64_t ulib_ticks(void) {
+    if (KDATA->version != KDATA_VERSION || KDATA->tsc_per_tick == 0) {
+        return 0;
+    }
+    // Clocksource fields never change after boot - no seqlock needed
+    return (ulib_rdtsc() - KDATA->tsc_base) / KDATA->tsc_per_tick;
+}
+
+int ulib_kdata(KernelData* out) {
+    if (KDATA->version != KDATA_VERSION) {
+        return 0;
+    }
+
+    // Seqlock read: retry while kernel is mid-update
+    uint32_t seq;
+    do {
+        seq = KDATA->seq;
+        KDATA_BARRIER();
+        memcpy(out, (const void*)KDATA, sizeof(*out));
+        KDATA_BARRIER();
+    } while ((seq & 1) || seq != KDATA->seq);
+    return 1;
+}
+
+// ============================================================================
+// DIAGNOSTICS
+// ============================================================================
+
+uint32_t trace_dump(uint32_t max_records) {
+    // Build payload: [max_records:4]
+    Response resp;
+    if (!execute_event(EVENT_SYSTEM_TRACE, 3, &max_records, 4, &resp)) {
+        return 0;
+    }
+    return (uint32_t)(uint64_t)resp.result_data;
+}
+
+void latency_report(void) {
+    uint32_t query = LATENCY_STATS_QUERY_ALL;
+    execute_event(EVENT_SYSTEM_STATS, 3, &query, 4, NULL);
+}
+
+uint64_t latency_p99_ns(uint32_t deck) {
+    // Build payload: [deck:4]
+    Response resp;
+    if (!execute_event(EVENT_SYSTEM_STATS, 3, &deck, 4, &resp)) {
+        return 0;
+    }
+    return (uint64_t)resp.result_data;
+}
@@ -35,11 +35,27 @@ typedef uint64_t           size_t;
 #define NOTIFY_POLL    0x04  // Non-blocking check for results
 #define NOTIFY_YIELD   0x08  // Yield CPU to other processes
 #define NOTIFY_EXIT    0x10  // Exit process
+#define NOTIFY_SQPOLL  0x20  // Kernel polls EventRing (no SUBMIT per batch)
+#define NOTIFY_REGISTER_BUFFER 0x40  // Register shared buffer (returns index)
+#define NOTIFY_ACTIVATE 0x80  // New workflow instance (returns instance_id)
+#define NOTIFY_INSTANCE 0x100 // With WAIT/POLL: RDX = instance_id
+
+// NOTIFY_INSTANCE results (a finished instance is released by the kernel)
+#define INSTANCE_COMPLETED 0
+#define INSTANCE_RUNNING   1
+#define INSTANCE_FAILED    2
+
+// EventRing.flags: kernel poller went idle, re-arm with SUBMIT|SQPOLL
+#define EVENT_RING_FLAG_NEED_WAKEUP 0x01
 
 // ============================================================================
 // EVENT TYPES (must match kernel events.h)
 // ============================================================================
 
+// Memory operations (Storage Deck) - use malloc/free, not these directly
+#define EVENT_MEMORY_ALLOC       1      // [size:8] -> address (64KB-aligned, lazy pages)
+#define EVENT_MEMORY_FREE        2      // [addr:8][size:8] - whole region only
+
 // Console operations (Hardware Deck)
 #define EVENT_CONSOLE_WRITE      70
 #define EVENT_CONSOLE_WRITE_ATTR 71
@@ -61,9 +77,23 @@ typedef uint64_t           size_t;
 #define EVENT_FILE_TAG_REMOVE    18
 #define EVENT_FILE_TAG_GET       19
 
+// Network operations (Network Deck) - raw Ethernet frames via virtio-net
+#define EVENT_NET_SEND           22     // [size:8][frame] or registered buffer
+#define EVENT_NET_RECV           23     // [flags:4] -> frame (waits unless NOWAIT)
+#define EVENT_NET_POLL           24     // -> frames waiting
+
+#define NET_RECV_NOWAIT          0x01
+
 // Timer operations (Hardware Deck)
 #define EVENT_TIMER_SLEEP        52
 
+// System diagnostics (Hardware Deck)
+#define EVENT_SYSTEM_TRACE       77
+#define EVENT_SYSTEM_STATS       78
+
+// EVENT_SYSTEM_STATS: full report instead of one deck's p99
+#define LATENCY_STATS_QUERY_ALL  0xFFFFFFFF
+
 // ============================================================================
 // VGA COLOR ATTRIBUTES (must match kernel vga.h)
 // ============================================================================
@@ -103,6 +133,18 @@ typedef uint64_t           size_t;
 #define EVENT_RING_ADDR   0x20200000
 #define RESULT_RING_ADDR  0x202400A0
 
+// Registered buffers (must match kernel workflow_rings.h)
+#define REG_BUFFER_USER_BASE   0x20400000ULL
+#define REG_BUFFER_MAX_SIZE    (1024 * 1024)
+#define REG_BUFFER_ADDR(index) ((void*)(REG_BUFFER_USER_BASE + (uint64_t)(index) * REG_BUFFER_MAX_SIZE))
+
+// RingEvent.buf_flags: data lives in registered buffer (buf_index/offset/length)
+#define RING_EVENT_BUF_REGISTERED 0x01
+// RingEvent.buf_flags: pure operations step may be served from the kernel memo cache
+#define RING_EVENT_MEMOIZE        0x02
+// RingEvent.id after ingest: kernel-assigned id, or this marker if the event was rejected
+#define RING_EVENT_ID_REJECTED    0xFFFFFFFFFFFFFFFFULL
+
 // ============================================================================
 // EVENT STRUCTURE (256 bytes, must match kernel)
 // ============================================================================
@@ -142,6 +184,7 @@ typedef struct __attribute__((packed)) {
 
 typedef struct {
     uint64_t head __attribute__((aligned(64)));
+    volatile uint32_t flags;    // EVENT_RING_FLAG_* (kernel writes)
     uint64_t tail __attribute__((aligned(64)));
     Event    events[256];
 } EventRing;
@@ -152,6 +195,91 @@ typedef struct {
     Response responses[256];
 } ResponseRing;
 
+// ============================================================================
+// COMPACT RINGS (must match kernel workflow_rings.h)
+// ============================================================================
+//
+// The loader may create a process with variable-length rings instead of the
+// fixed slots above (kernel process_ring_config_t). Both rings are arrays of
+// COMPACT_UNIT_SIZE-byte units. A record never wraps: when it does not fit
+// before the end of the ring, the producer fills the rest with a PAD record.
+//
+// The kernel writes the negotiated geometry into the ring header. size_units
+// is 0 for fixed-slot rings, and the async_* API checks it on first use.
+// Only the first 8 bytes of a result are copied into Response.result_data.
+//
+// ============================================================================
+
+#define COMPACT_UNIT_SIZE  64
+#define COMPACT_FLAG_PAD   0x8000       // Skip to the end of the ring
+
+typedef struct {
+    uint16_t units;             // Record length in units, header included
+    uint16_t flags;             // RING_EVENT_BUF_* / COMPACT_FLAG_PAD
+    uint32_t type;              // Event: event type. Result: status
+} CompactHeader;
+
+typedef struct {
+    CompactHeader header;
+    volatile uint64_t id;       // 0 on submit; kernel id or RING_EVENT_ID_REJECTED
+    uint64_t workflow_id;
+    uint8_t  route[MAX_ROUTING_STEPS];
+    uint32_t payload_size;
+    uint16_t buf_index;
+    uint8_t  priority;
+    uint8_t  _reserved;
+    uint32_t buf_offset;
+    uint32_t buf_length;
+    uint8_t  payload[];
+} CompactEvent;
+
+typedef struct {
+    CompactHeader header;       // header.type = status
+    uint64_t event_id;
+    uint64_t workflow_id;
+    uint64_t completion_time;
+    uint32_t error_code;
+    uint32_t result_size;
+    uint8_t  result[];
+} CompactResult;
+
+typedef struct {
+    volatile uint64_t head __attribute__((aligned(64)));
+    volatile uint32_t flags;    // EVENT_RING_FLAG_* (event ring)
+    uint32_t size_units;        // Ring size in units (0 = fixed-slot rings)
+    uint32_t max_entry_units;   // Largest record the kernel accepts
+    volatile uint64_t tail __attribute__((aligned(64)));
+    uint8_t  data[] __attribute__((aligned(64)));
+} CompactRing;
+
+_Static_assert(sizeof(CompactEvent) == 48, "CompactEvent header must be 48 bytes");
+_Static_assert(sizeof(CompactResult) == 40, "CompactResult header must be 40 bytes");
+
+// ============================================================================
+// KERNEL DATA PAGE (read-only, must match kernel kdata.h)
+// ============================================================================
+
+#define KDATA_ADDR        0x20C00000
+#define KDATA_VERSION     1
+
+typedef struct {
+    volatile uint32_t seq;          // Seqlock: odd while kernel updates
+    uint32_t version;
+    uint64_t tsc_hz;
+    uint64_t tsc_base;              // TSC at boot clock init (ns = 0, tick = 0)
+    uint64_t tsc_per_tick;
+    uint32_t tick_hz;
+    uint32_t flags;
+    uint64_t ns_base_tsc;           // Snapshot: ns = ns_base + ((tsc - ns_base_tsc) * ns_mult) >> 32
+    uint64_t ns_base;
+    uint64_t ns_mult;
+    uint64_t context_switches;
+    uint64_t preemptions;
+    uint64_t voluntary_yields;
+    uint64_t scheduler_ticks;
+    uint64_t updates;
+} KernelData;
+
 // ============================================================================
 // TAG STRUCTURE (for TagFS)
 // ============================================================================
@@ -169,17 +297,104 @@ typedef struct {
 // ============================================================================
 
 // The ONE and ONLY syscall in BoxOS!
+// Инструкция SYSCALL (быстрый путь, выход через SYSRET); int $0x80 - тот же
+// ABI, остаётся для совместимости. SYSCALL портит RCX и R11
 static inline uint64_t kernel_notify(uint64_t workflow_id, uint64_t flags) {
     uint64_t result;
     __asm__ volatile(
-        "int $0x80"
+        "syscall"
         : "=a"(result)
         : "D"(workflow_id), "S"(flags)
-        : "memory"
+        : "rcx", "r11", "memory"
     );
     return result;
 }
 
+// kernel_notify with extra argument in RDX (NOTIFY_REGISTER_BUFFER size)
+static inline uint64_t kernel_notify_arg(uint64_t workflow_id, uint64_t flags, uint64_t arg) {
+    uint64_t result;
+    __asm__ volatile(
+        "syscall"
+        : "=a"(result)
+        : "D"(workflow_id), "S"(flags), "d"(arg)
+        : "rcx", "r11", "memory"
+    );
+    return result;
+}
+
+// Register buffer of `size` bytes (max REG_BUFFER_MAX_SIZE).
+// Returns index (buffer at REG_BUFFER_ADDR(index)) or -1
+static inline int64_t register_buffer(uint64_t size) {
+    int64_t index = (int64_t)kernel_notify_arg(0, NOTIFY_REGISTER_BUFFER, size);
+    return index < 0 ? -1 : index;
+}
+
+// Start a new instance of a registered workflow. Returns instance_id or 0
+static inline uint64_t workflow_activate(uint64_t workflow_id) {
+    return kernel_notify(workflow_id, NOTIFY_ACTIVATE);
+}
+
+// Non-blocking instance state: INSTANCE_*, or -1 if not our instance
+static inline int64_t workflow_instance_poll(uint64_t workflow_id, uint64_t instance_id) {
+    return (int64_t)kernel_notify_arg(workflow_id, NOTIFY_POLL | NOTIFY_INSTANCE, instance_id);
+}
+
+// Block until the instance finishes: INSTANCE_COMPLETED / INSTANCE_FAILED, or -1
+static inline int64_t workflow_instance_wait(uint64_t workflow_id, uint64_t instance_id) {
+    int64_t status;
+    do {
+        status = (int64_t)kernel_notify_arg(workflow_id, NOTIFY_WAIT | NOTIFY_INSTANCE, instance_id);
+    } while (status == INSTANCE_RUNNING);
+    return status;
+}
+
+// ============================================================================
+// ASYNC SUBMISSION (tickets)
+// ============================================================================
+//
+// async_submit() only writes the event into the EventRing and returns a
+// ticket - no syscall. async_flush() publishes everything queued with ONE
+// kernel_notify(SUBMIT). Completions are matched to tickets as responses
+// are reaped from the ResponseRing:
+//
+//   ticket_t t[3];
+//   t[0] = async_submit(EVENT_CONSOLE_WRITE, 3, p0, n0);
+//   t[1] = async_submit(EVENT_CONSOLE_WRITE, 3, p1, n1);
+//   t[2] = async_submit(EVENT_CONSOLE_WRITE, 3, p2, n2);
+//   async_wait_all(t, 3, responses);   // flushes, then one WAIT per wakeup
+//
+// A ticket owns its ring slot until its response is consumed (poll/wait)
+// or it is discarded - at most ASYNC_MAX_TICKETS in flight.
+//
+// ============================================================================
+
+typedef uint64_t ticket_t;             // 0 = invalid / ring full
+
+#define ASYNC_MAX_TICKETS 256          // = EventRing slots
+
+// Queue one event (route: deck_prefix -> Execution). 0 = no free slot
+ticket_t async_submit(uint32_t type, uint8_t deck_prefix, const void* payload, size_t payload_size);
+
+// One SUBMIT for all queued events. Returns number of events published
+int async_flush(void);
+
+// Non-blocking: 1 = done (*out filled, ticket released), 0 = pending,
+// -1 = unknown ticket. Event rejected by the kernel completes with status != 0
+int async_poll(ticket_t ticket, Response* out);
+
+// Block until done (flushes first if needed). 1 = done, -1 = unknown ticket
+int async_wait(ticket_t ticket, Response* out);
+
+// Block until any ticket is done. Returns its index, -1 = none valid
+int async_wait_any(const ticket_t* tickets, int count, Response* out);
+
+// Block until all are done. out[i] for tickets[i] (out may be NULL).
+// Returns number completed
+int async_wait_all(const ticket_t* tickets, int count, Response* out);
+
+// Fire-and-forget: response is dropped when it arrives
+void async_discard(ticket_t ticket);
+
 // ============================================================================
 // CONSOLE API (High-level wrappers)
 // ============================================================================
@@ -223,6 +438,33 @@ int contains_char(const char* s, char c);
 int atoi(const char* str);
 void itoa(int value, char* str);
 
+// ============================================================================
+// HEAP (malloc/free)
+// ============================================================================
+//
+// Small requests (up to HEAP_SMALL_MAX) are served from power-of-two size
+// classes carved out of HEAP_CHUNK_SIZE chunks. The Storage deck maps each
+// chunk into this process with one EVENT_MEMORY_ALLOC (lazy pages: only
+// touched memory is backed). After that, malloc/free of small blocks are
+// local list operations - no event, no syscall.
+//
+// Larger requests get a region of their own. A chunk goes back to the kernel
+// only when every block in it is free, and each class keeps one empty chunk
+// so alloc/free churn at the boundary does not round-trip.
+//
+// Processes are single-threaded: the class lists are the thread cache.
+// Returned pointers are 16-byte aligned.
+//
+// ============================================================================
+
+#define HEAP_CHUNK_SIZE   (64 * 1024)   // = kernel alignment of EVENT_MEMORY_ALLOC
+#define HEAP_SMALL_MAX    4096
+
+void* malloc(size_t size);
+void* calloc(size_t count, size_t size);
+void* realloc(void* ptr, size_t size);
+void free(void* ptr);
+
 // ============================================================================
 // PROCESS CONTROL
 // ============================================================================
@@ -242,4 +484,32 @@ static inline void exit(int code) {
 // Sleep for milliseconds (via timer event)
 void sleep_ms(uint32_t ms);
 
+// ============================================================================
+// TIME (kernel data page - no syscall, no event)
+// ============================================================================
+
+// Nanoseconds since boot (0 if the kernel did not map the data page)
+uint64_t ulib_now(void);
+
+// Kernel clock ticks since boot (tick_hz per second)
+uint64_t ulib_ticks(void);
+
+// Consistent copy of the kernel data page (scheduler stats etc.).
+// Returns 0 if the page is not mapped
+int ulib_kdata(KernelData* out);
+
+// ============================================================================
+// DIAGNOSTICS
+// ============================================================================
+
+// Dump up to max_records kernel trace records to console (0 = all).
+// Returns number of records printed
+uint32_t trace_dump(uint32_t max_records);
+
+// Print kernel latency histograms (per deck, per event type, end-to-end)
+void latency_report(void);
+
+// p99 service time of a deck in ns (deck prefix 1-4, 0 = Execution)
+uint64_t latency_p99_ns(uint32_t deck);
+
 #endif // ULIB_H